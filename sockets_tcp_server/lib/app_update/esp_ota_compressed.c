@@ -0,0 +1,227 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_ota_compressed.h"
+#include "sdkconfig.h"
+
+#if CONFIG_IDF_TARGET_ESP32
+#include "esp32/rom/miniz.h"
+#elif CONFIG_IDF_TARGET_ESP32S2
+#include "esp32s2/rom/miniz.h"
+#endif
+
+#define INFLATE_FLAGS (TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_COMPUTE_ADLER32 | TINFL_FLAG_HAS_MORE_INPUT)
+
+static const char *TAG = "esp_ota_compressed";
+
+struct esp_ota_decompress {
+    tinfl_decompressor inflator;
+    uint8_t window[TINFL_LZ_DICT_SIZE];     /* Output buffer, wrapping around, also the deflate dictionary */
+    size_t window_ofs;
+    esp_ota_compressed_header_t header;
+    size_t header_received;                 /* Bytes of the container header received, up to header.header_size */
+    size_t data_received;
+    size_t image_written;
+    tinfl_status status;
+    esp_err_t err;                          /* First error, the following writes are ignored */
+    esp_ota_decompress_write_cb_t write_cb;
+    void *ctx;
+};
+
+static const uint8_t s_magic[4] = {
+    ESP_OTA_COMPRESSED_MAGIC & 0xff, (ESP_OTA_COMPRESSED_MAGIC >> 8) & 0xff,
+    (ESP_OTA_COMPRESSED_MAGIC >> 16) & 0xff, ESP_OTA_COMPRESSED_MAGIC >> 24
+};
+
+bool esp_ota_is_compressed_image(const void *data, size_t size)
+{
+    return data != NULL && size > 0 && memcmp(data, s_magic, size < sizeof(s_magic) ? size : sizeof(s_magic)) == 0;
+}
+
+static esp_err_t check_header(const esp_ota_compressed_header_t *header)
+{
+    if (header->magic != ESP_OTA_COMPRESSED_MAGIC) {
+        ESP_LOGE(TAG, "Invalid compressed image magic 0x%08x", header->magic);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    if (header->version != ESP_OTA_COMPRESSED_VERSION || header->compression != ESP_OTA_COMPRESSION_ZLIB
+        || header->header_size < sizeof(esp_ota_compressed_header_t)) {
+        ESP_LOGE(TAG, "Unsupported compressed image version %d, compression %d", header->version, header->compression);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    return ESP_OK;
+}
+
+esp_ota_decompress_handle_t esp_ota_decompress_begin(esp_ota_decompress_write_cb_t write_cb, void *ctx)
+{
+    if (write_cb == NULL) {
+        return NULL;
+    }
+    esp_ota_decompress_handle_t handle = calloc(1, sizeof(struct esp_ota_decompress));
+    if (handle == NULL) {
+        ESP_LOGE(TAG, "Couldn't allocate memory for decompression");
+        return NULL;
+    }
+    tinfl_init(&handle->inflator);
+    handle->status = TINFL_STATUS_NEEDS_MORE_INPUT;
+    handle->write_cb = write_cb;
+    handle->ctx = ctx;
+    return handle;
+}
+
+/* Consumes the container header, returns the number of bytes used */
+static size_t receive_header(esp_ota_decompress_handle_t handle, const uint8_t *data, size_t size)
+{
+    size_t used = 0;
+    if (handle->header_received < sizeof(handle->header)) {
+        used = sizeof(handle->header) - handle->header_received;
+        if (used > size) {
+            used = size;
+        }
+        memcpy((uint8_t *)&handle->header + handle->header_received, data, used);
+        handle->header_received += used;
+        if (handle->header_received < sizeof(handle->header)) {
+            return used;
+        }
+        handle->err = check_header(&handle->header);
+        if (handle->err != ESP_OK) {
+            return used;
+        }
+    }
+    /* Skip the fields added by later versions */
+    size_t skip = handle->header.header_size - handle->header_received;
+    if (skip > size - used) {
+        skip = size - used;
+    }
+    handle->header_received += skip;
+    return used + skip;
+}
+
+esp_err_t esp_ota_decompress_write(esp_ota_decompress_handle_t handle, const void *data, size_t size)
+{
+    const uint8_t *in = (const uint8_t *)data;
+
+    if (handle == NULL || data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (handle->err != ESP_OK) {
+        return handle->err;
+    }
+
+    if (handle->header_received < sizeof(handle->header) || handle->header_received < handle->header.header_size) {
+        size_t used = receive_header(handle, in, size);
+        in += used;
+        size -= used;
+        if (handle->err != ESP_OK) {
+            return handle->err;
+        }
+    }
+
+    while ((size > 0 || handle->status == TINFL_STATUS_HAS_MORE_OUTPUT) && handle->status != TINFL_STATUS_DONE) {
+        size_t in_size = size;
+        size_t out_size = TINFL_LZ_DICT_SIZE - handle->window_ofs;
+        handle->status = tinfl_decompress(&handle->inflator, in, &in_size, handle->window,
+                                          handle->window + handle->window_ofs, &out_size, INFLATE_FLAGS);
+        in += in_size;
+        size -= in_size;
+        handle->data_received += in_size;
+        if (handle->status < TINFL_STATUS_DONE) {
+            ESP_LOGE(TAG, "Decompression failed (%d) at offset %d", handle->status, (int)handle->data_received);
+            handle->err = ESP_ERR_OTA_VALIDATE_FAILED;
+            return handle->err;
+        }
+        if (out_size > 0) {
+            if (handle->image_written + out_size > handle->header.image_size) {
+                ESP_LOGE(TAG, "Decompressed image is larger than %d bytes", handle->header.image_size);
+                handle->err = ESP_ERR_OTA_VALIDATE_FAILED;
+                return handle->err;
+            }
+            handle->err = handle->write_cb(handle->ctx, handle->window + handle->window_ofs, out_size);
+            if (handle->err != ESP_OK) {
+                return handle->err;
+            }
+            handle->image_written += out_size;
+            handle->window_ofs = (handle->window_ofs + out_size) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+    }
+
+    if (size > 0) {
+        ESP_LOGE(TAG, "%d bytes after the end of the compressed image", (int)size);
+        handle->err = ESP_ERR_OTA_VALIDATE_FAILED;
+        return handle->err;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_decompress_end(esp_ota_decompress_handle_t handle)
+{
+    if (handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = handle->err;
+    if (err == ESP_OK) {
+        if (handle->status != TINFL_STATUS_DONE || handle->image_written != handle->header.image_size
+            || handle->data_received != handle->header.data_size) {
+            ESP_LOGE(TAG, "Compressed image is incomplete: %d of %d bytes decompressed",
+                     (int)handle->image_written, handle->header.image_size);
+            err = ESP_ERR_OTA_VALIDATE_FAILED;
+        }
+    } else if (err != ESP_ERR_OTA_VALIDATE_FAILED) {
+        /* write_cb failed: the image can't be valid */
+        err = ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    free(handle);
+    return err;
+}
+
+esp_err_t esp_ota_decompress_peek(const void *data, size_t size, void *out, size_t out_size)
+{
+    esp_ota_compressed_header_t header;
+
+    if (data == NULL || out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (size < sizeof(header)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(&header, data, sizeof(header));
+    esp_err_t err = check_header(&header);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (size <= header.header_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    tinfl_decompressor *inflator = malloc(sizeof(tinfl_decompressor));
+    if (inflator == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    /* Decompressing from the start of the image, so the output buffer can be smaller than the dictionary */
+    size_t in_size = size - header.header_size;
+    size_t produced = out_size;
+    tinfl_init(inflator);
+    tinfl_status status = tinfl_decompress(inflator, (const uint8_t *)data + header.header_size, &in_size,
+                                           out, out, &produced, INFLATE_FLAGS | TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+    free(inflator);
+    if (produced == out_size) {
+        return ESP_OK;
+    }
+    /* The image is corrupted, or it ended before `out` was filled */
+    return status == TINFL_STATUS_NEEDS_MORE_INPUT ? ESP_ERR_INVALID_SIZE : ESP_ERR_OTA_VALIDATE_FAILED;
+}
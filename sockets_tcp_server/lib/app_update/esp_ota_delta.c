@@ -0,0 +1,397 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_ota_delta.h"
+
+#define DELTA_BUF_SIZE          4096
+#define DELTA_CONTROL_SIZE      12
+/* Limit of the patch decompressed by esp_ota_delta_peek() */
+#define DELTA_PEEK_PATCH_MAX    8192
+
+static const char *TAG = "esp_ota_delta";
+
+struct esp_ota_delta {
+    const esp_partition_t *source;
+    esp_ota_delta_header_t header;
+    size_t header_received;                 /* Bytes of the header received, up to header.header_size */
+    esp_ota_decompress_handle_t decompress;
+    uint8_t control[DELTA_CONTROL_SIZE];    /* Control block of the current record */
+    size_t control_received;
+    uint32_t diff_left;                     /* Bytes of the current record still to be applied */
+    uint32_t extra_left;
+    int32_t seek;
+    uint32_t source_pos;
+    size_t image_written;
+    esp_err_t err;                          /* First error, the following writes are ignored */
+    esp_ota_decompress_write_cb_t write_cb;
+    void *ctx;
+    uint8_t buf[DELTA_BUF_SIZE];            /* Source image data, patched in place */
+};
+
+static const uint8_t s_magic[4] = {
+    ESP_OTA_DELTA_MAGIC & 0xff, (ESP_OTA_DELTA_MAGIC >> 8) & 0xff,
+    (ESP_OTA_DELTA_MAGIC >> 16) & 0xff, ESP_OTA_DELTA_MAGIC >> 24
+};
+
+bool esp_ota_is_delta_image(const void *data, size_t size)
+{
+    return data != NULL && size > 0 && memcmp(data, s_magic, size < sizeof(s_magic) ? size : sizeof(s_magic)) == 0;
+}
+
+static esp_err_t check_header(const esp_ota_delta_header_t *header)
+{
+    if (header->magic != ESP_OTA_DELTA_MAGIC) {
+        ESP_LOGE(TAG, "Invalid delta image magic 0x%08x", header->magic);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    if (header->version != ESP_OTA_DELTA_VERSION || header->header_size < sizeof(esp_ota_delta_header_t)) {
+        ESP_LOGE(TAG, "Unsupported delta image version %d", header->version);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    return ESP_OK;
+}
+
+/* Checks that the delta was made from the app image of the source partition */
+static esp_err_t check_source(const esp_partition_t *source, const esp_ota_delta_header_t *header)
+{
+    uint8_t sha256[32];
+
+    if (header->source_size > source->size) {
+        ESP_LOGE(TAG, "Source image of %d bytes doesn't fit partition %s", header->source_size, source->label);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    esp_err_t err = esp_partition_get_sha256(source, sha256);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "No valid app image in partition %s", source->label);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    if (memcmp(sha256, header->source_sha256, sizeof(sha256)) != 0) {
+        ESP_LOGE(TAG, "Delta image was made from another app image than the one in partition %s", source->label);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    return ESP_OK;
+}
+
+static esp_ota_delta_handle_t delta_alloc(const esp_partition_t *source, esp_ota_decompress_write_cb_t write_cb, void *ctx)
+{
+    esp_ota_delta_handle_t handle = calloc(1, sizeof(struct esp_ota_delta));
+    if (handle == NULL) {
+        ESP_LOGE(TAG, "Couldn't allocate memory for delta image");
+        return NULL;
+    }
+    handle->source = source;
+    handle->write_cb = write_cb;
+    handle->ctx = ctx;
+    return handle;
+}
+
+/* Parses the control block of the next record */
+static esp_err_t start_record(esp_ota_delta_handle_t handle)
+{
+    const uint8_t *c = handle->control;
+    uint32_t diff_len = c[0] | (c[1] << 8) | (c[2] << 16) | ((uint32_t)c[3] << 24);
+    uint32_t extra_len = c[4] | (c[5] << 8) | (c[6] << 16) | ((uint32_t)c[7] << 24);
+    int32_t seek = (int32_t)(c[8] | (c[9] << 8) | (c[10] << 16) | ((uint32_t)c[11] << 24));
+
+    size_t image_left = handle->header.image_size - handle->image_written;
+    if (diff_len > image_left || extra_len > image_left - diff_len) {
+        ESP_LOGE(TAG, "Patch record at image offset %d exceeds the image size", (int)handle->image_written);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    if (diff_len > handle->header.source_size - handle->source_pos) {
+        ESP_LOGE(TAG, "Patch record at image offset %d reads beyond the source image", (int)handle->image_written);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    int64_t seek_pos = (int64_t)handle->source_pos + diff_len + seek;
+    if (seek_pos < 0 || seek_pos > handle->header.source_size) {
+        ESP_LOGE(TAG, "Patch record at image offset %d seeks out of the source image", (int)handle->image_written);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    handle->diff_left = diff_len;
+    handle->extra_left = extra_len;
+    handle->seek = seek;
+    handle->control_received = 0;
+    return ESP_OK;
+}
+
+/* Receives the decompressed patch and writes the new image */
+static esp_err_t apply_patch(void *ctx, const void *data, size_t size)
+{
+    esp_ota_delta_handle_t handle = (esp_ota_delta_handle_t)ctx;
+    const uint8_t *in = (const uint8_t *)data;
+    esp_err_t err;
+
+    while (size > 0) {
+        if (handle->diff_left == 0 && handle->extra_left == 0) {
+            if (handle->image_written == handle->header.image_size) {
+                ESP_LOGE(TAG, "%d bytes after the end of the patch", (int)size);
+                return ESP_ERR_OTA_VALIDATE_FAILED;
+            }
+            size_t len = DELTA_CONTROL_SIZE - handle->control_received;
+            if (len > size) {
+                len = size;
+            }
+            memcpy(handle->control + handle->control_received, in, len);
+            handle->control_received += len;
+            in += len;
+            size -= len;
+            if (handle->control_received < DELTA_CONTROL_SIZE) {
+                break;
+            }
+            err = start_record(handle);
+            if (err != ESP_OK) {
+                return err;
+            }
+        } else if (handle->diff_left > 0) {
+            size_t len = handle->diff_left;
+            if (len > size) {
+                len = size;
+            }
+            if (len > DELTA_BUF_SIZE) {
+                len = DELTA_BUF_SIZE;
+            }
+            err = esp_partition_read(handle->source, handle->source_pos, handle->buf, len);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Reading the source image at 0x%x failed (0x%x)", handle->source_pos, err);
+                return err;
+            }
+            for (size_t i = 0; i < len; i++) {
+                handle->buf[i] += in[i];
+            }
+            err = handle->write_cb(handle->ctx, handle->buf, len);
+            if (err != ESP_OK) {
+                return err;
+            }
+            handle->source_pos += len;
+            handle->diff_left -= len;
+            handle->image_written += len;
+            in += len;
+            size -= len;
+        } else {
+            size_t len = handle->extra_left;
+            if (len > size) {
+                len = size;
+            }
+            err = handle->write_cb(handle->ctx, in, len);
+            if (err != ESP_OK) {
+                return err;
+            }
+            handle->extra_left -= len;
+            handle->image_written += len;
+            in += len;
+            size -= len;
+        }
+        if (handle->diff_left == 0 && handle->extra_left == 0) {
+            /* start_record() checked that the result is within the source image */
+            handle->source_pos += handle->seek;
+            handle->seek = 0;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_ota_delta_handle_t esp_ota_delta_begin(const esp_partition_t *source, esp_ota_decompress_write_cb_t write_cb, void *ctx)
+{
+    if (source == NULL || write_cb == NULL) {
+        return NULL;
+    }
+    esp_ota_delta_handle_t handle = delta_alloc(source, write_cb, ctx);
+    if (handle == NULL) {
+        return NULL;
+    }
+    handle->decompress = esp_ota_decompress_begin(apply_patch, handle);
+    if (handle->decompress == NULL) {
+        free(handle);
+        return NULL;
+    }
+    return handle;
+}
+
+/* Consumes the delta image header, returns the number of bytes used */
+static size_t receive_header(esp_ota_delta_handle_t handle, const uint8_t *data, size_t size)
+{
+    size_t used = 0;
+    if (handle->header_received < sizeof(handle->header)) {
+        used = sizeof(handle->header) - handle->header_received;
+        if (used > size) {
+            used = size;
+        }
+        memcpy((uint8_t *)&handle->header + handle->header_received, data, used);
+        handle->header_received += used;
+        if (handle->header_received < sizeof(handle->header)) {
+            return used;
+        }
+        handle->err = check_header(&handle->header);
+        if (handle->err == ESP_OK) {
+            handle->err = check_source(handle->source, &handle->header);
+        }
+        if (handle->err != ESP_OK) {
+            return used;
+        }
+        ESP_LOGI(TAG, "Applying delta image to the %d bytes app image in partition %s",
+                 handle->header.source_size, handle->source->label);
+    }
+    /* Skip the fields added by later versions */
+    size_t skip = handle->header.header_size - handle->header_received;
+    if (skip > size - used) {
+        skip = size - used;
+    }
+    handle->header_received += skip;
+    return used + skip;
+}
+
+esp_err_t esp_ota_delta_write(esp_ota_delta_handle_t handle, const void *data, size_t size)
+{
+    const uint8_t *in = (const uint8_t *)data;
+
+    if (handle == NULL || data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (handle->err != ESP_OK) {
+        return handle->err;
+    }
+
+    if (handle->header_received < sizeof(handle->header) || handle->header_received < handle->header.header_size) {
+        size_t used = receive_header(handle, in, size);
+        in += used;
+        size -= used;
+        if (handle->err != ESP_OK) {
+            return handle->err;
+        }
+    }
+
+    if (size > 0) {
+        handle->err = esp_ota_decompress_write(handle->decompress, in, size);
+    }
+    return handle->err;
+}
+
+esp_err_t esp_ota_delta_end(esp_ota_delta_handle_t handle)
+{
+    if (handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = esp_ota_decompress_end(handle->decompress);
+    if (err == ESP_OK && handle->err != ESP_OK) {
+        err = ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    if (err == ESP_OK && (handle->image_written != handle->header.image_size || handle->control_received > 0
+                          || handle->diff_left > 0 || handle->extra_left > 0)) {
+        ESP_LOGE(TAG, "Patch is incomplete: %d of %d bytes of the image made",
+                 (int)handle->image_written, handle->header.image_size);
+        err = ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    free(handle);
+    return err;
+}
+
+typedef struct {
+    uint8_t *out;
+    size_t out_size;
+    size_t written;
+} peek_ctx_t;
+
+static esp_err_t peek_write(void *ctx, const void *data, size_t size)
+{
+    peek_ctx_t *peek = (peek_ctx_t *)ctx;
+    if (size > peek->out_size - peek->written) {
+        size = peek->out_size - peek->written;
+    }
+    memcpy(peek->out + peek->written, data, size);
+    peek->written += size;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_delta_peek(const void *data, size_t size, const esp_partition_t *source, void *out, size_t out_size)
+{
+    esp_ota_delta_header_t header;
+    esp_ota_compressed_header_t patch_header;
+
+    if (data == NULL || source == NULL || out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (size < sizeof(header)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(&header, data, sizeof(header));
+    esp_err_t err = check_header(&header);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (header.source_size > source->size || out_size > header.image_size) {
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    if (size < header.header_size + sizeof(patch_header)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(&patch_header, (const uint8_t *)data + header.header_size, sizeof(patch_header));
+
+    peek_ctx_t peek = {
+        .out = out,
+        .out_size = out_size,
+    };
+    esp_ota_delta_handle_t handle = delta_alloc(source, peek_write, &peek);
+    if (handle == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(&handle->header, &header, sizeof(header));
+
+    /* Each record of the patch takes a control block, so the start of the image needs a larger start of the patch */
+    size_t patch_size = out_size + 16 * DELTA_CONTROL_SIZE;
+    uint8_t *patch = NULL;
+    do {
+        if (patch_size > patch_header.image_size) {
+            patch_size = patch_header.image_size;
+        }
+        uint8_t *new_patch = realloc(patch, patch_size);
+        if (new_patch == NULL) {
+            err = ESP_ERR_NO_MEM;
+            break;
+        }
+        patch = new_patch;
+        err = esp_ota_decompress_peek((const uint8_t *)data + header.header_size, size - header.header_size, patch, patch_size);
+        if (err != ESP_OK) {
+            break;
+        }
+        /* Start again from the first record */
+        handle->control_received = 0;
+        handle->diff_left = handle->extra_left = 0;
+        handle->seek = 0;
+        handle->source_pos = 0;
+        handle->image_written = 0;
+        peek.written = 0;
+        err = apply_patch(handle, patch, patch_size);
+        if (err != ESP_OK || peek.written == out_size) {
+            break;
+        }
+        if (patch_size == patch_header.image_size || patch_size == DELTA_PEEK_PATCH_MAX) {
+            ESP_LOGE(TAG, "Patch doesn't make the first %d bytes of the image", (int)out_size);
+            err = ESP_ERR_OTA_VALIDATE_FAILED;
+            break;
+        }
+        patch_size = patch_size * 2 > DELTA_PEEK_PATCH_MAX ? DELTA_PEEK_PATCH_MAX : patch_size * 2;
+    } while (true);
+
+    free(patch);
+    free(handle);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_SIZE && err != ESP_ERR_NO_MEM) {
+        /* Including flash read errors, as a corrupted patch can seek anywhere in the source partition */
+        err = ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    return err;
+}
@@ -32,6 +32,8 @@
 #include "sdkconfig.h"
 
 #include "esp_ota_ops.h"
+#include "esp_ota_compressed.h"
+#include "esp_ota_delta.h"
 #include "sys/queue.h"
 #include "esp32/rom/crc.h"
 #include "esp_log.h"
@@ -51,6 +53,9 @@ typedef struct ota_ops_entry_ {
     uint32_t wrote_size;
     uint8_t partial_bytes;
     uint8_t partial_data[16];
+    esp_ota_decompress_handle_t decompress;
+    esp_ota_delta_handle_t delta;
+    esp_image_stream_handle_t verify;
     LIST_ENTRY(ota_ops_entry_) entries;
 } ota_ops_entry_t;
 
@@ -120,16 +125,10 @@ static esp_ota_img_states_t set_new_state_otadata(void)
 #endif
 }
 
-esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+/* Checks that an update can be written to the partition, returns the partition found in the partition table */
+static esp_err_t check_update_partition(const esp_partition_t **out_partition)
 {
-    ota_ops_entry_t *new_entry;
-    esp_err_t ret = ESP_OK;
-
-    if ((partition == NULL) || (out_handle == NULL)) {
-        return ESP_ERR_INVALID_ARG;
-    }
-
-    partition = esp_partition_verify(partition);
+    const esp_partition_t *partition = esp_partition_verify(*out_partition);
     if (partition == NULL) {
         return ESP_ERR_NOT_FOUND;
     }
@@ -152,6 +151,23 @@ esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp
         }
     }
 #endif
+    *out_partition = partition;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+{
+    ota_ops_entry_t *new_entry;
+    esp_err_t ret = ESP_OK;
+
+    if ((partition == NULL) || (out_handle == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ret = check_update_partition(&partition);
+    if (ret != ESP_OK) {
+        return ret;
+    }
 
     // If input image size is 0 or OTA_SIZE_UNKNOWN, erase entire partition
     if ((image_size == 0) || (image_size == OTA_SIZE_UNKNOWN)) {
@@ -179,15 +195,92 @@ esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp
     }
 
     new_entry->part = partition;
+#if CONFIG_APP_OTA_VERIFY_ON_WRITE
+    const esp_partition_pos_t part_pos = {
+        .offset = partition->address,
+        .size = partition->size,
+    };
+    // without it (out of memory, signed images), esp_ota_end() verifies the image from flash
+    esp_image_verify_stream_begin(&part_pos, &new_entry->verify);
+#endif
     new_entry->handle = ++s_ota_ops_last_handle;
     *out_handle = new_entry->handle;
     return ESP_OK;
 }
 
-esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+static esp_err_t ota_write_flash(ota_ops_entry_t *it, const void *data, size_t size)
 {
     const uint8_t *data_bytes = (const uint8_t *)data;
     esp_err_t ret;
+
+    if (it->wrote_size == 0 && it->partial_bytes == 0 && size > 0 && data_bytes[0] != ESP_IMAGE_HEADER_MAGIC) {
+        ESP_LOGE(TAG, "OTA image has invalid magic byte (expected 0xE9, saw 0x%02x)", data_bytes[0]);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+
+    if (esp_flash_encryption_enabled()) {
+        /* Can only write 16 byte blocks to flash, so need to cache anything else */
+        size_t copy_len;
+
+        /* check if we have partially written data from earlier */
+        if (it->partial_bytes != 0) {
+            copy_len = MIN(16 - it->partial_bytes, size);
+            memcpy(it->partial_data + it->partial_bytes, data_bytes, copy_len);
+            it->partial_bytes += copy_len;
+            if (it->partial_bytes != 16) {
+                return ESP_OK; /* nothing to write yet, just filling buffer */
+            }
+            /* write 16 byte to partition */
+            ret = esp_partition_write(it->part, it->wrote_size, it->partial_data, 16);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+            it->partial_bytes = 0;
+            memset(it->partial_data, 0xFF, 16);
+            it->wrote_size += 16;
+            data_bytes += copy_len;
+            size -= copy_len;
+        }
+
+        /* check if we need to save trailing data that we're about to write */
+        it->partial_bytes = size % 16;
+        if (it->partial_bytes != 0) {
+            size -= it->partial_bytes;
+            memcpy(it->partial_data, data_bytes + size, it->partial_bytes);
+        }
+    }
+
+    ret = esp_partition_write(it->part, it->wrote_size, data_bytes, size);
+    if(ret == ESP_OK){
+        it->wrote_size += size;
+    }
+    return ret;
+}
+
+/* Writes the app image to the partition, verifying it on the way when possible */
+static esp_err_t ota_write_plain(ota_ops_entry_t *it, const void *data, size_t size)
+{
+    esp_err_t ret = ota_write_flash(it, data, size);
+    if (it->verify) {
+        if (ret == ESP_OK) {
+            // an invalid image is reported by esp_ota_end(), once esp_image_verify() has logged why
+            esp_image_verify_stream_data(it->verify, data, size);
+        } else {
+            esp_image_verify_stream_end(it->verify, NULL);
+            it->verify = NULL;
+        }
+    }
+    return ret;
+}
+
+/* Receives the image decompressed from a compressed OTA image, or made from a delta OTA image */
+static esp_err_t ota_write_decompressed(void *ctx, const void *data, size_t size)
+{
+    return ota_write_plain((ota_ops_entry_t *)ctx, data, size);
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
     ota_ops_entry_t *it;
 
     if (data == NULL) {
@@ -200,48 +293,32 @@ esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
         if (it->handle == handle) {
             // must erase the partition before writing to it
             assert(it->erased_size > 0 && "must erase the partition before writing to it");
-            if (it->wrote_size == 0 && it->partial_bytes == 0 && size > 0 && data_bytes[0] != ESP_IMAGE_HEADER_MAGIC) {
-                ESP_LOGE(TAG, "OTA image has invalid magic byte (expected 0xE9, saw 0x%02x)", data_bytes[0]);
-                return ESP_ERR_OTA_VALIDATE_FAILED;
-            }
-
-            if (esp_flash_encryption_enabled()) {
-                /* Can only write 16 byte blocks to flash, so need to cache anything else */
-                size_t copy_len;
-
-                /* check if we have partially written data from earlier */
-                if (it->partial_bytes != 0) {
-                    copy_len = MIN(16 - it->partial_bytes, size);
-                    memcpy(it->partial_data + it->partial_bytes, data_bytes, copy_len);
-                    it->partial_bytes += copy_len;
-                    if (it->partial_bytes != 16) {
-                        return ESP_OK; /* nothing to write yet, just filling buffer */
-                    }
-                    /* write 16 byte to partition */
-                    ret = esp_partition_write(it->part, it->wrote_size, it->partial_data, 16);
-                    if (ret != ESP_OK) {
-                        return ret;
-                    }
-                    it->partial_bytes = 0;
-                    memset(it->partial_data, 0xFF, 16);
-                    it->wrote_size += 16;
-                    data_bytes += copy_len;
-                    size -= copy_len;
+#if CONFIG_APP_OTA_COMPRESSED_IMAGE
+            // a compressed image is decompressed on the fly, only the app image is written to the partition
+            if (it->wrote_size == 0 && it->partial_bytes == 0 && it->decompress == NULL && it->delta == NULL
+                && esp_ota_is_compressed_image(data, size)) {
+                it->decompress = esp_ota_decompress_begin(ota_write_decompressed, it);
+                if (it->decompress == NULL) {
+                    return ESP_ERR_NO_MEM;
                 }
-
-                /* check if we need to save trailing data that we're about to write */
-                it->partial_bytes = size % 16;
-                if (it->partial_bytes != 0) {
-                    size -= it->partial_bytes;
-                    memcpy(it->partial_data, data_bytes + size, it->partial_bytes);
+            }
+            if (it->decompress) {
+                return esp_ota_decompress_write(it->decompress, data, size);
+            }
+#endif
+#if CONFIG_APP_OTA_DELTA_IMAGE
+            // a delta image is applied on the fly to the running app image, only the new app image is written to the partition
+            if (it->wrote_size == 0 && it->partial_bytes == 0 && it->delta == NULL && esp_ota_is_delta_image(data, size)) {
+                it->delta = esp_ota_delta_begin(esp_ota_get_running_partition(), ota_write_decompressed, it);
+                if (it->delta == NULL) {
+                    return ESP_ERR_NO_MEM;
                 }
             }
-
-            ret = esp_partition_write(it->part, it->wrote_size, data_bytes, size);
-            if(ret == ESP_OK){
-                it->wrote_size += size;
+            if (it->delta) {
+                return esp_ota_delta_write(it->delta, data, size);
             }
-            return ret;
+#endif
+            return ota_write_plain(it, data, size);
         }
     }
 
@@ -267,6 +344,22 @@ esp_err_t esp_ota_end(esp_ota_handle_t handle)
 
     /* 'it' holds the ota_ops_entry_t for 'handle' */
 
+    if (it->decompress) {
+        ret = esp_ota_decompress_end(it->decompress);
+        it->decompress = NULL;
+        if (ret != ESP_OK) {
+            goto cleanup;
+        }
+    }
+
+    if (it->delta) {
+        ret = esp_ota_delta_end(it->delta);
+        it->delta = NULL;
+        if (ret != ESP_OK) {
+            goto cleanup;
+        }
+    }
+
     // esp_ota_end() is only valid if some data was written to this handle
     if ((it->erased_size == 0) || (it->wrote_size == 0)) {
         ret = ESP_ERR_INVALID_ARG;
@@ -290,17 +383,138 @@ esp_err_t esp_ota_end(esp_ota_handle_t handle)
       .size = it->part->size,
     };
 
+    if (it->verify) {
+        // the image was verified as it was written, no need to read it back
+        esp_err_t verify_ret = esp_image_verify_stream_end(it->verify, &data);
+        it->verify = NULL;
+        if (verify_ret == ESP_OK) {
+            goto cleanup;
+        }
+    }
+
     if (esp_image_verify(ESP_IMAGE_VERIFY, &part_pos, &data) != ESP_OK) {
         ret = ESP_ERR_OTA_VALIDATE_FAILED;
         goto cleanup;
     }
 
  cleanup:
+    if (it->verify) {
+        esp_image_verify_stream_end(it->verify, NULL);
+    }
     LIST_REMOVE(it, entries);
     free(it);
     return ret;
 }
 
+#define OTA_RESUME_STATE_MAGIC 0x52544f45  /* "EOTR" */
+
+/* Saved by esp_ota_get_resume_state(), followed by the saved image verification if any */
+typedef struct {
+    uint32_t magic;
+    uint32_t partition_address;
+    uint32_t wrote_size;
+    uint32_t verify_size;
+} ota_resume_state_t;
+
+_Static_assert(sizeof(ota_resume_state_t) + ESP_IMAGE_STREAM_STATE_MAX_SIZE <= ESP_OTA_RESUME_STATE_MAX_SIZE,
+               "ESP_OTA_RESUME_STATE_MAX_SIZE is too small");
+
+esp_err_t esp_ota_get_resume_state(esp_ota_handle_t handle, void *state, size_t *size)
+{
+    ota_ops_entry_t *it;
+
+    if (state == NULL || size == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (it = LIST_FIRST(&s_ota_ops_entries_head); it != NULL; it = LIST_NEXT(it, entries)) {
+        if (it->handle == handle) {
+            break;
+        }
+    }
+    if (it == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    // the inflater state of compressed and delta images is too large to be saved
+    if (it->decompress || it->delta) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    // the update continues by erasing the sectors after the data written
+    if (it->partial_bytes != 0 || it->wrote_size % SPI_FLASH_SEC_SIZE != 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (*size < sizeof(ota_resume_state_t)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    ota_resume_state_t *saved = (ota_resume_state_t *)state;
+    saved->magic = OTA_RESUME_STATE_MAGIC;
+    saved->partition_address = it->part->address;
+    saved->wrote_size = it->wrote_size;
+    saved->verify_size = 0;
+    if (it->verify) {
+        size_t verify_size = *size - sizeof(ota_resume_state_t);
+        esp_err_t ret = esp_image_verify_stream_save(it->verify, saved + 1, &verify_size);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        saved->verify_size = verify_size;
+    }
+    *size = sizeof(ota_resume_state_t) + saved->verify_size;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_resume(const esp_partition_t *partition, const void *state, size_t size, esp_ota_handle_t *out_handle)
+{
+    const ota_resume_state_t *saved = (const ota_resume_state_t *)state;
+    esp_err_t ret;
+
+    if (partition == NULL || state == NULL || out_handle == NULL || size < sizeof(ota_resume_state_t)
+            || size != sizeof(ota_resume_state_t) + saved->verify_size || saved->magic != OTA_RESUME_STATE_MAGIC) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ret = check_update_partition(&partition);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (saved->partition_address != partition->address || saved->wrote_size == 0
+            || saved->wrote_size % SPI_FLASH_SEC_SIZE != 0 || saved->wrote_size > partition->size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ota_ops_entry_t *new_entry = (ota_ops_entry_t *) calloc(sizeof(ota_ops_entry_t), 1);
+    if (new_entry == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    const esp_partition_pos_t part_pos = {
+        .offset = partition->address,
+        .size = partition->size,
+    };
+    if (saved->verify_size) {
+        // without it, esp_ota_end() verifies the image from flash
+        esp_image_verify_stream_restore(&part_pos, saved + 1, saved->verify_size, &new_entry->verify);
+    }
+
+    // data may have been written after the state was saved
+    ret = esp_partition_erase_range(partition, saved->wrote_size, partition->size - saved->wrote_size);
+    if (ret != ESP_OK) {
+        if (new_entry->verify) {
+            esp_image_verify_stream_end(new_entry->verify, NULL);
+        }
+        free(new_entry);
+        return ret;
+    }
+
+    LIST_INSERT_HEAD(&s_ota_ops_entries_head, new_entry, entries);
+    new_entry->erased_size = partition->size;
+    new_entry->wrote_size = saved->wrote_size;
+    new_entry->part = partition;
+    new_entry->handle = ++s_ota_ops_last_handle;
+    *out_handle = new_entry->handle;
+    ESP_LOGI(TAG, "Resuming update of partition at 0x%x from offset 0x%x", partition->address, saved->wrote_size);
+    return ESP_OK;
+}
+
 static esp_err_t rewrite_ota_seq(esp_ota_select_entry_t *two_otadata, uint32_t seq, uint8_t sec_id, const esp_partition_t *ota_data_partition)
 {
     if (two_otadata == NULL || sec_id > 1) {
@@ -0,0 +1,143 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ * Compressed OTA image container, as made by esptool_py/ota_compress.py:
+ * an esp_ota_compressed_header_t followed by the app image compressed as a zlib stream.
+ * All the fields are little endian.
+ */
+#define ESP_OTA_COMPRESSED_MAGIC        0x5a544f45  /*!< "EOTZ" */
+#define ESP_OTA_COMPRESSED_VERSION      1
+
+/**
+ * @brief Compression of the data following the container header
+ */
+typedef enum {
+    ESP_OTA_COMPRESSION_ZLIB = 1,   /*!< zlib stream (RFC 1950), decompressed with the ROM miniz inflater */
+} esp_ota_compression_t;
+
+/**
+ * @brief Header of a compressed OTA image
+ */
+typedef struct {
+    uint32_t magic;         /*!< ESP_OTA_COMPRESSED_MAGIC */
+    uint8_t version;        /*!< ESP_OTA_COMPRESSED_VERSION */
+    uint8_t compression;    /*!< esp_ota_compression_t */
+    uint16_t header_size;   /*!< Size of the header, the compressed data starts at this offset */
+    uint32_t image_size;    /*!< Size of the decompressed app image */
+    uint32_t data_size;     /*!< Size of the compressed data */
+} __attribute__((packed)) esp_ota_compressed_header_t;
+
+/**
+ * @brief Opaque handle for a streaming decompression of a compressed OTA image
+ */
+typedef struct esp_ota_decompress *esp_ota_decompress_handle_t;
+
+/**
+ * @brief Function receiving the decompressed image, in order
+ *
+ * @param ctx   Context passed to esp_ota_decompress_begin()
+ * @param data  Decompressed data, valid only during the call
+ * @param size  Size of data in bytes
+ *
+ * @return ESP_OK to continue, any other value is returned by esp_ota_decompress_write()
+ */
+typedef esp_err_t (*esp_ota_decompress_write_cb_t)(void *ctx, const void *data, size_t size);
+
+/**
+ * @brief   Check if data starts like a compressed OTA image
+ *
+ * @param data  Start of the image
+ * @param size  Size of data in bytes, only the first bytes of the magic are compared if it is shorter
+ *
+ * @return true if data starts with the container magic
+ */
+bool esp_ota_is_compressed_image(const void *data, size_t size);
+
+/**
+ * @brief   Start decompressing a compressed OTA image
+ *
+ * The decompression window is the 32 KB deflate dictionary, allocated with the inflater state
+ * (about 43 KB in total) until esp_ota_decompress_end() is called.
+ *
+ * @param write_cb  Function receiving the decompressed image
+ * @param ctx       Context passed to write_cb
+ *
+ * @return Handle for esp_ota_decompress_write() and esp_ota_decompress_end(), NULL if out of memory
+ */
+esp_ota_decompress_handle_t esp_ota_decompress_begin(esp_ota_decompress_write_cb_t write_cb, void *ctx);
+
+/**
+ * @brief   Decompress the next part of a compressed OTA image
+ *
+ * The container can be passed in pieces of any size, starting with its header.
+ * write_cb is called with the decompressed data as soon as it is available.
+ *
+ * @param handle  Handle obtained from esp_ota_decompress_begin()
+ * @param data    Next part of the compressed image
+ * @param size    Size of data in bytes
+ *
+ * @return
+ *    - ESP_OK: Data was decompressed and passed to write_cb
+ *    - ESP_ERR_INVALID_ARG: handle or data is NULL
+ *    - ESP_ERR_OTA_VALIDATE_FAILED: Invalid container header, corrupted compressed data, or data beyond the end of the image
+ *    - Error returned by write_cb
+ */
+esp_err_t esp_ota_decompress_write(esp_ota_decompress_handle_t handle, const void *data, size_t size);
+
+/**
+ * @brief   Finish decompressing a compressed OTA image and free the handle
+ *
+ * @param handle  Handle obtained from esp_ota_decompress_begin()
+ *
+ * @return
+ *    - ESP_OK: The whole image was decompressed, its size and checksum match the container
+ *    - ESP_ERR_INVALID_ARG: handle is NULL
+ *    - ESP_ERR_OTA_VALIDATE_FAILED: The image is truncated or a previous write failed
+ */
+esp_err_t esp_ota_decompress_end(esp_ota_decompress_handle_t handle);
+
+/**
+ * @brief   Decompress the start of a compressed OTA image, to read its app description
+ *
+ * Only the inflater state is allocated (about 11 KB) during the call, no dictionary is needed.
+ *
+ * @param data      Start of the compressed image, including the container header
+ * @param size      Size of data in bytes
+ * @param out       Buffer receiving the first out_size bytes of the decompressed image
+ * @param out_size  Size of out in bytes
+ *
+ * @return
+ *    - ESP_OK: out is filled
+ *    - ESP_ERR_INVALID_SIZE: More compressed data is needed to fill out
+ *    - ESP_ERR_NO_MEM: Cannot allocate the inflater state
+ *    - ESP_ERR_OTA_VALIDATE_FAILED: Invalid container header or corrupted compressed data
+ */
+esp_err_t esp_ota_decompress_peek(const void *data, size_t size, void *out, size_t out_size);
+
+#ifdef __cplusplus
+}
+#endif
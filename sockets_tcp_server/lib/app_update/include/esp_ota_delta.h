@@ -0,0 +1,137 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "esp_ota_compressed.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ * Delta OTA image, as made by esptool_py/ota_delta.py from the app image running on the device (the source)
+ * and the new app image: an esp_ota_delta_header_t followed by a compressed container (see esp_ota_compressed.h)
+ * of the patch.
+ *
+ * The patch is a sequence of records, each made of a control block of three 32 bit little endian fields
+ * `diff_len`, `extra_len` and `seek` followed by `diff_len` diff bytes and `extra_len` extra bytes:
+ * - each diff byte is added to the next byte of the source image to make the next byte of the new image
+ * - the extra bytes are copied to the new image
+ * - then the source image position moves by `seek` (signed) bytes
+ * The patch ends when the whole new image is made.
+ */
+#define ESP_OTA_DELTA_MAGIC             0x44544f45  /*!< "EOTD" */
+#define ESP_OTA_DELTA_VERSION           1
+
+/**
+ * @brief Header of a delta OTA image
+ */
+typedef struct {
+    uint32_t magic;                 /*!< ESP_OTA_DELTA_MAGIC */
+    uint8_t version;                /*!< ESP_OTA_DELTA_VERSION */
+    uint8_t reserved;               /*!< Reserved, 0 */
+    uint16_t header_size;           /*!< Size of the header, the compressed patch starts at this offset */
+    uint32_t source_size;           /*!< Size of the source app image */
+    uint8_t source_sha256[32];      /*!< SHA-256 of the source app image, as returned by esp_partition_get_sha256() */
+    uint32_t image_size;            /*!< Size of the new app image */
+} __attribute__((packed)) esp_ota_delta_header_t;
+
+/**
+ * @brief Opaque handle for applying a delta OTA image
+ */
+typedef struct esp_ota_delta *esp_ota_delta_handle_t;
+
+/**
+ * @brief   Check if data starts like a delta OTA image
+ *
+ * @param data  Start of the image
+ * @param size  Size of data in bytes, only the first bytes of the magic are compared if it is shorter
+ *
+ * @return true if data starts with the delta image magic
+ */
+bool esp_ota_is_delta_image(const void *data, size_t size);
+
+/**
+ * @brief   Start applying a delta OTA image
+ *
+ * Besides the decompression state (see esp_ota_decompress_begin()), a 4 KB buffer is allocated
+ * for the source image data until esp_ota_delta_end() is called.
+ *
+ * @param source    Partition holding the source app image, usually esp_ota_get_running_partition()
+ * @param write_cb  Function receiving the new app image
+ * @param ctx       Context passed to write_cb
+ *
+ * @return Handle for esp_ota_delta_write() and esp_ota_delta_end(), NULL if out of memory
+ */
+esp_ota_delta_handle_t esp_ota_delta_begin(const esp_partition_t *source, esp_ota_decompress_write_cb_t write_cb, void *ctx);
+
+/**
+ * @brief   Apply the next part of a delta OTA image
+ *
+ * The delta image can be passed in pieces of any size, starting with its header.
+ * Once the header is received, the SHA-256 of the source app image is checked against it.
+ *
+ * @param handle  Handle obtained from esp_ota_delta_begin()
+ * @param data    Next part of the delta image
+ * @param size    Size of data in bytes
+ *
+ * @return
+ *    - ESP_OK: Data was applied and the new image passed to write_cb
+ *    - ESP_ERR_INVALID_ARG: handle or data is NULL
+ *    - ESP_ERR_OTA_VALIDATE_FAILED: Invalid header, delta made from another source image, or corrupted patch
+ *    - Error returned by write_cb or reading the source partition
+ */
+esp_err_t esp_ota_delta_write(esp_ota_delta_handle_t handle, const void *data, size_t size);
+
+/**
+ * @brief   Finish applying a delta OTA image and free the handle
+ *
+ * @param handle  Handle obtained from esp_ota_delta_begin()
+ *
+ * @return
+ *    - ESP_OK: The whole new image was made
+ *    - ESP_ERR_INVALID_ARG: handle is NULL
+ *    - ESP_ERR_OTA_VALIDATE_FAILED: The delta image is truncated or a previous write failed
+ */
+esp_err_t esp_ota_delta_end(esp_ota_delta_handle_t handle);
+
+/**
+ * @brief   Make the start of the new app image of a delta OTA image, to read its app description
+ *
+ * The source app image is not checked, esp_ota_delta_write() does it.
+ *
+ * @param data      Start of the delta image, including its header
+ * @param size      Size of data in bytes
+ * @param source    Partition holding the source app image
+ * @param out       Buffer receiving the first out_size bytes of the new image, at most 1 KB
+ * @param out_size  Size of out in bytes
+ *
+ * @return
+ *    - ESP_OK: out is filled
+ *    - ESP_ERR_INVALID_SIZE: More data is needed to fill out
+ *    - ESP_ERR_NO_MEM: Cannot allocate memory
+ *    - ESP_ERR_OTA_VALIDATE_FAILED: Invalid header or corrupted patch
+ */
+esp_err_t esp_ota_delta_peek(const void *data, size_t size, const esp_partition_t *source, void *out, size_t out_size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -104,6 +104,11 @@ esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t image_size, esp
  * data is received during the OTA operation. Data is written
  * sequentially to the partition.
  *
+ * If CONFIG_APP_OTA_COMPRESSED_IMAGE is enabled and the data starts with the header of a compressed
+ * OTA image (see esp_ota_compressed.h), the data is decompressed and the app image is written to the partition.
+ * If CONFIG_APP_OTA_DELTA_IMAGE is enabled and the data starts with the header of a delta OTA image
+ * (see esp_ota_delta.h), the new app image is made from the running app image and written to the partition.
+ *
  * @param handle  Handle obtained from esp_ota_begin
  * @param data    Data buffer to write
  * @param size    Size of data buffer in bytes.
@@ -111,7 +116,9 @@ esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t image_size, esp
  * @return
  *    - ESP_OK: Data was written to flash successfully.
  *    - ESP_ERR_INVALID_ARG: handle is invalid.
- *    - ESP_ERR_OTA_VALIDATE_FAILED: First byte of image contains invalid app image magic byte.
+ *    - ESP_ERR_OTA_VALIDATE_FAILED: First byte of image contains invalid app image magic byte, compressed image is corrupted,
+ *      or delta image is corrupted or was not made from the running app image.
+ *    - ESP_ERR_NO_MEM: Cannot allocate memory to decompress a compressed image or apply a delta image.
  *    - ESP_ERR_FLASH_OP_TIMEOUT or ESP_ERR_FLASH_OP_FAIL: Flash write failed.
  *    - ESP_ERR_OTA_SELECT_INFO_INVALID: OTA data partition has invalid contents
  */
@@ -124,15 +131,64 @@ esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size);
  *
  * @note After calling esp_ota_end(), the handle is no longer valid and any memory associated with it is freed (regardless of result).
  *
+ * @note With CONFIG_APP_OTA_VERIFY_ON_WRITE, the image is verified as esp_ota_write() writes it and is not read back from flash,
+ *       unless it is found invalid (to log why) or its signature must be verified.
+ *
  * @return
  *    - ESP_OK: Newly written OTA app image is valid.
  *    - ESP_ERR_NOT_FOUND: OTA handle was not found.
  *    - ESP_ERR_INVALID_ARG: Handle was never written to.
- *    - ESP_ERR_OTA_VALIDATE_FAILED: OTA image is invalid (either not a valid app image, or - if secure boot is enabled - signature failed to verify.)
+ *    - ESP_ERR_OTA_VALIDATE_FAILED: OTA image is invalid (either not a valid app image, or - if secure boot is enabled - signature failed to verify,
+ *      or a compressed or delta image is truncated.)
  *    - ESP_ERR_INVALID_STATE: If flash encryption is enabled, this result indicates an internal error writing the final encrypted bytes to flash.
  */
 esp_err_t esp_ota_end(esp_ota_handle_t handle);
 
+/* Size of a state saved by esp_ota_get_resume_state() at most */
+#define ESP_OTA_RESUME_STATE_MAX_SIZE 576
+
+/**
+ * @brief Save the progress of an OTA update, to continue it with esp_ota_resume() after a restart.
+ *
+ * The state holds the number of bytes written and, with CONFIG_APP_OTA_VERIFY_ON_WRITE, the state of the
+ * verification of the image, including the running SHA-256 of the data written.
+ * It can only be saved when the data written so far ends at a flash sector boundary (a multiple of 4 KB).
+ *
+ * @param handle  Handle obtained from esp_ota_begin() or esp_ota_resume().
+ * @param state   Buffer receiving the state.
+ * @param[inout] size  Size of the state buffer in bytes, set to the size of the state.
+ *
+ * @return
+ *    - ESP_OK: State saved.
+ *    - ESP_ERR_INVALID_ARG: state or size is NULL.
+ *    - ESP_ERR_NOT_FOUND: OTA handle was not found.
+ *    - ESP_ERR_NOT_SUPPORTED: A compressed or delta image is written, the update can't be resumed.
+ *    - ESP_ERR_INVALID_STATE: The data written doesn't end at a flash sector boundary.
+ *    - ESP_ERR_INVALID_SIZE: The buffer is too small, ESP_OTA_RESUME_STATE_MAX_SIZE bytes are always enough.
+ */
+esp_err_t esp_ota_get_resume_state(esp_ota_handle_t handle, void *state, size_t *size);
+
+/**
+ * @brief Continue an OTA update from a state saved by esp_ota_get_resume_state().
+ *
+ * The partition is erased from the end of the data written when the state was saved, the next esp_ota_write()
+ * writes the image data following it. The state is only valid in the app which saved it, and as long as the
+ * partition isn't written by something else.
+ *
+ * @param partition  Partition the update was written to.
+ * @param state      Saved state.
+ * @param size       Size of the saved state in bytes.
+ * @param out_handle On success, returns a handle for esp_ota_write() and esp_ota_end().
+ *
+ * @return
+ *    - ESP_OK: OTA operation resumed.
+ *    - ESP_ERR_INVALID_ARG: An argument is NULL, the state is invalid, or was saved for another partition.
+ *    - ESP_ERR_NO_MEM: Cannot allocate memory for OTA operation.
+ *    - ESP_ERR_OTA_PARTITION_CONFLICT, ESP_ERR_NOT_FOUND, ESP_ERR_OTA_ROLLBACK_INVALID_STATE: As for esp_ota_begin().
+ *    - ESP_ERR_FLASH_OP_TIMEOUT or ESP_ERR_FLASH_OP_FAIL: Flash erase failed.
+ */
+esp_err_t esp_ota_resume(const esp_partition_t *partition, const void *state, size_t size, esp_ota_handle_t *out_handle);
+
 /**
  * @brief Configure OTA data for a new boot partition
  *
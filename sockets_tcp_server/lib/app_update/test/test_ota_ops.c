@@ -9,6 +9,8 @@
 #include <test_utils.h>
 #include <esp_ota_ops.h>
 #include "bootloader_common.h"
+#include "esp_image_format.h"
+#include <sys/param.h>
 
 /* These OTA tests currently don't assume an OTA partition exists
    on the device, so they're a bit limited
@@ -107,3 +109,51 @@ TEST_CASE("esp_ota_get_partition_description", "[ota]")
     };
     TEST_ESP_ERR(ESP_ERR_NOT_FOUND, bootloader_common_get_partition_description(&not_app_pos, &app_desc1));
 }
+
+TEST_CASE("esp_ota_resume() continues an update from a saved state", "[ota]")
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    const esp_partition_t *update = esp_ota_get_next_update_partition(NULL);
+    TEST_ASSERT_NOT_NULL(running);
+    TEST_ASSERT_NOT_NULL(update);
+    esp_image_metadata_t data;
+    const esp_partition_pos_t running_pos = {
+        .offset = running->address,
+        .size = running->size,
+    };
+    TEST_ESP_OK(esp_image_verify(ESP_IMAGE_VERIFY, &running_pos, &data));
+
+    /* Copy the running app to the update partition, the first part before a "restart" */
+    const uint32_t first_part = 3 * SPI_FLASH_SEC_SIZE;
+    const uint32_t chunk_size = 1000;
+    uint8_t *buf = malloc(chunk_size);
+    TEST_ASSERT_NOT_NULL(buf);
+    uint8_t *state = malloc(ESP_OTA_RESUME_STATE_MAX_SIZE);
+    TEST_ASSERT_NOT_NULL(state);
+    size_t state_size = ESP_OTA_RESUME_STATE_MAX_SIZE;
+    esp_ota_handle_t handle;
+    TEST_ESP_OK(esp_ota_begin(update, OTA_SIZE_UNKNOWN, &handle));
+    for (uint32_t offset = 0; offset < data.image_len; offset += chunk_size) {
+        uint32_t size = MIN(chunk_size, data.image_len - offset);
+        TEST_ESP_OK(esp_partition_read(running, offset, buf, size));
+        if (offset < first_part && offset + size > first_part) {
+            /* The data written ends at a sector boundary */
+            TEST_ESP_ERR(ESP_ERR_INVALID_STATE, esp_ota_get_resume_state(handle, state, &state_size));
+            TEST_ESP_OK(esp_ota_write(handle, buf, first_part - offset));
+            TEST_ESP_OK(esp_ota_get_resume_state(handle, state, &state_size));
+            /* Written data after the saved state is erased when resumed */
+            TEST_ESP_OK(esp_ota_write(handle, buf + first_part - offset, size - (first_part - offset)));
+            TEST_ESP_ERR(ESP_ERR_OTA_VALIDATE_FAILED, esp_ota_end(handle));
+
+            TEST_ESP_ERR(ESP_ERR_INVALID_ARG, esp_ota_resume(update, state, state_size - 1, &handle));
+            TEST_ESP_ERR(ESP_ERR_INVALID_ARG, esp_ota_resume(update, state, state_size, NULL));
+            TEST_ESP_OK(esp_ota_resume(update, state, state_size, &handle));
+            TEST_ESP_OK(esp_ota_write(handle, buf + first_part - offset, size - (first_part - offset)));
+        } else {
+            TEST_ESP_OK(esp_ota_write(handle, buf, size));
+        }
+    }
+    TEST_ESP_OK(esp_ota_end(handle));
+    free(state);
+    free(buf);
+}
@@ -0,0 +1,6 @@
+#pragma once
+/* Host build: only the error codes of app_update are used by esp_ota_compressed.c */
+#include "esp_err.h"
+
+#define ESP_ERR_OTA_BASE                         0x1500
+#define ESP_ERR_OTA_VALIDATE_FAILED              (ESP_ERR_OTA_BASE + 0x03)
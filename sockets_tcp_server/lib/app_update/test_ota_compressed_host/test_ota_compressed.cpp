@@ -0,0 +1,243 @@
+#include "catch.hpp"
+#include "esp_ota_ops.h"
+#include "esp_ota_compressed.h"
+#include "esp32/rom/miniz.h"
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define IMAGES_DIR  "../../esptool_py/esptool/test/images/"
+
+typedef std::vector<uint8_t> bytes;
+
+static bytes read_file(const std::string &path)
+{
+    std::ifstream f(path.c_str(), std::ios::binary);
+    REQUIRE(f.good());
+    return bytes(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const std::string &path, const bytes &data)
+{
+    std::ofstream f(path.c_str(), std::ios::binary);
+    f.write((const char *)data.data(), data.size());
+    REQUIRE(f.good());
+}
+
+/* Builds the container the same way as esptool_py/ota_compress.py */
+static bytes pack(const bytes &image, int probes = 128)
+{
+    tdefl_compressor *comp = new tdefl_compressor;
+    bytes data(image.size() + image.size() / 8 + 1024);
+    size_t in_size = image.size();
+    size_t out_size = data.size();
+    REQUIRE(tdefl_init(comp, NULL, NULL, TDEFL_WRITE_ZLIB_HEADER | probes) == TDEFL_STATUS_OKAY);
+    REQUIRE(tdefl_compress(comp, image.data(), &in_size, data.data(), &out_size, TDEFL_FINISH) == TDEFL_STATUS_DONE);
+    delete comp;
+    data.resize(out_size);
+
+    esp_ota_compressed_header_t header = {};
+    header.magic = ESP_OTA_COMPRESSED_MAGIC;
+    header.version = ESP_OTA_COMPRESSED_VERSION;
+    header.compression = ESP_OTA_COMPRESSION_ZLIB;
+    header.header_size = sizeof(header);
+    header.image_size = image.size();
+    header.data_size = data.size();
+    bytes container(sizeof(header) + data.size());
+    memcpy(container.data(), &header, sizeof(header));
+    memcpy(container.data() + sizeof(header), data.data(), data.size());
+    return container;
+}
+
+static bytes make_image(size_t size, unsigned seed)
+{
+    /* Code-like contents: repeated words with some random bytes */
+    static const char *words[] = { "\x36\x41\x00", "\x1d\xf0", "\x0c\x02", "esp_", "_task", "\xff\xff\x00\x00" };
+    bytes image;
+    srand(seed);
+    image.push_back(0xe9);
+    while (image.size() < size) {
+        if (rand() % 4 == 0) {
+            image.push_back(rand());
+        } else {
+            const char *w = words[rand() % 6];
+            image.insert(image.end(), w, w + strlen(w) + (w[0] == '\xff' ? 3 : 0));
+        }
+    }
+    image.resize(size);
+    return image;
+}
+
+struct output {
+    bytes data;
+    size_t max_write;
+    int writes;
+    esp_err_t fail_with;
+};
+
+static esp_err_t collect(void *ctx, const void *data, size_t size)
+{
+    output *out = static_cast<output *>(ctx);
+    if (out->fail_with != ESP_OK) {
+        return out->fail_with;
+    }
+    out->data.insert(out->data.end(), (const uint8_t *)data, (const uint8_t *)data + size);
+    out->max_write = size > out->max_write ? size : out->max_write;
+    out->writes++;
+    return ESP_OK;
+}
+
+/* Feeds the container in pieces of random size up to max_piece, returns the result of esp_ota_decompress_end() */
+static esp_err_t decompress(const bytes &container, size_t max_piece, output &out, esp_err_t *write_err = NULL)
+{
+    esp_ota_decompress_handle_t h = esp_ota_decompress_begin(collect, &out);
+    REQUIRE(h != NULL);
+    esp_err_t err = ESP_OK;
+    size_t pos = 0;
+    while (pos < container.size() && err == ESP_OK) {
+        size_t n = 1 + rand() % max_piece;
+        if (n > container.size() - pos) {
+            n = container.size() - pos;
+        }
+        err = esp_ota_decompress_write(h, container.data() + pos, n);
+        pos += n;
+    }
+    if (write_err) {
+        *write_err = err;
+    }
+    return esp_ota_decompress_end(h);
+}
+
+TEST_CASE("compressed image is decompressed whatever the write sizes", "[esp_ota_compressed]")
+{
+    bytes image = make_image(300 * 1024 + 17, 1);
+    bytes container = pack(image);
+    CHECK(esp_ota_is_compressed_image(container.data(), container.size()));
+    CHECK(esp_ota_is_compressed_image(container.data(), 2));
+    CHECK_FALSE(esp_ota_is_compressed_image(image.data(), image.size()));
+
+    for (size_t max_piece : { (size_t)1, (size_t)7, (size_t)289, (size_t)4096, container.size() }) {
+        output out = {};
+        srand(max_piece);
+        CHECK(decompress(container, max_piece, out) == ESP_OK);
+        CHECK(out.data == image);
+        /* The RAM window is the deflate dictionary */
+        CHECK(out.max_write <= TINFL_LZ_DICT_SIZE);
+    }
+}
+
+TEST_CASE("app images of esptool tests are restored", "[esp_ota_compressed]")
+{
+    printf("image                       size  compressed  ratio\n");
+    for (const char *name : { "bootloader.bin", "esp8266_deepsleep.bin", "nodemcu-master-7-modules-2017-01-19-11-10-03-integer.bin" }) {
+        bytes image = read_file(std::string(IMAGES_DIR) + name);
+        bytes container = pack(image, 0xfff);
+        output out = {};
+        CHECK(decompress(container, 1460, out) == ESP_OK);
+        CHECK(out.data == image);
+        printf("%-24.24s %7zu  %10zu  %4.1f%%\n", name, image.size(), container.size(), 100.0 * container.size() / image.size());
+    }
+}
+
+TEST_CASE("corrupted compressed images are rejected", "[esp_ota_compressed]")
+{
+    bytes image = make_image(64 * 1024, 2);
+    bytes container = pack(image);
+    output out;
+    esp_err_t write_err;
+
+    SECTION("truncated") {
+        bytes c(container.begin(), container.end() - 100);
+        CHECK(decompress(c, 512, out) == ESP_ERR_OTA_VALIDATE_FAILED);
+    }
+    SECTION("missing adler32") {
+        bytes c(container.begin(), container.end() - 1);
+        CHECK(decompress(c, 512, out) == ESP_ERR_OTA_VALIDATE_FAILED);
+    }
+    SECTION("data after the end") {
+        bytes c = container;
+        c.push_back(0);
+        CHECK(decompress(c, 512, out, &write_err) == ESP_ERR_OTA_VALIDATE_FAILED);
+        CHECK(write_err == ESP_ERR_OTA_VALIDATE_FAILED);
+    }
+    SECTION("corrupted data") {
+        bytes c = container;
+        c[c.size() / 2] ^= 0x55;
+        CHECK(decompress(c, 512, out) == ESP_ERR_OTA_VALIDATE_FAILED);
+    }
+    SECTION("image larger than in the header") {
+        bytes c = container;
+        esp_ota_compressed_header_t *header = (esp_ota_compressed_header_t *)c.data();
+        header->image_size -= 1;
+        CHECK(decompress(c, 512, out, &write_err) == ESP_ERR_OTA_VALIDATE_FAILED);
+        CHECK(write_err == ESP_ERR_OTA_VALIDATE_FAILED);
+    }
+    SECTION("unsupported version") {
+        bytes c = container;
+        c[4] = ESP_OTA_COMPRESSED_VERSION + 1;
+        CHECK(decompress(c, 512, out, &write_err) == ESP_ERR_OTA_VALIDATE_FAILED);
+        CHECK(write_err == ESP_ERR_OTA_VALIDATE_FAILED);
+        CHECK(out.data.empty());
+    }
+    SECTION("write error") {
+        out.fail_with = ESP_FAIL;
+        CHECK(decompress(container, 512, out, &write_err) == ESP_ERR_OTA_VALIDATE_FAILED);
+        CHECK(write_err == ESP_FAIL);
+    }
+}
+
+TEST_CASE("longer headers of later versions are skipped", "[esp_ota_compressed]")
+{
+    bytes image = make_image(10000, 3);
+    bytes container = pack(image);
+    esp_ota_compressed_header_t *header = (esp_ota_compressed_header_t *)container.data();
+    header->header_size += 8;
+    container.insert(container.begin() + sizeof(*header), 8, 0xaa);
+    output out = {};
+    CHECK(decompress(container, 5, out) == ESP_OK);
+    CHECK(out.data == image);
+}
+
+TEST_CASE("image header is peeked from the start of the compressed image", "[esp_ota_compressed]")
+{
+    bytes image = make_image(100 * 1024, 4);
+    bytes container = pack(image);
+    uint8_t header[289];
+    size_t needed = 0;
+
+    for (size_t size = 0; size <= container.size(); size++) {
+        esp_err_t err = esp_ota_decompress_peek(container.data(), size, header, sizeof(header));
+        if (err == ESP_OK) {
+            needed = size;
+            break;
+        }
+        REQUIRE(err == ESP_ERR_INVALID_SIZE);
+    }
+    REQUIRE(needed > 0);
+    CHECK(memcmp(header, image.data(), sizeof(header)) == 0);
+    CHECK(esp_ota_decompress_peek(image.data(), image.size(), header, sizeof(header)) == ESP_ERR_OTA_VALIDATE_FAILED);
+}
+
+TEST_CASE("images packed by ota_compress.py are decompressed", "[esp_ota_compressed][packer]")
+{
+    bytes image = make_image(200 * 1024, 5);
+    write_file("image.bin", image);
+    REQUIRE(system("python " OTA_COMPRESS_PY " pack image.bin image_compressed.bin > /dev/null") == 0);
+    bytes container = read_file("image_compressed.bin");
+    output out = {};
+    CHECK(decompress(container, 1460, out) == ESP_OK);
+    CHECK(out.data == image);
+
+    /* and the other way round */
+    write_file("image_compressed.bin", pack(image));
+    REQUIRE(system("python " OTA_COMPRESS_PY " unpack image_compressed.bin image_unpacked.bin > /dev/null") == 0);
+    CHECK(read_file("image_unpacked.bin") == image);
+    remove("image.bin");
+    remove("image_compressed.bin");
+    remove("image_unpacked.bin");
+}
@@ -0,0 +1,2 @@
+/* Host build: the ROM miniz functions come from the esptool flasher stub copy of miniz */
+#include <miniz.h>
@@ -0,0 +1,108 @@
+#include "partition_sim.h"
+#include "esp_app_format.h"
+#include "mbedtls/sha256.h"
+
+#include <algorithm>
+#include <map>
+#include <string.h>
+
+#define HASH_LEN                32
+#define ESP_ERR_IMAGE_INVALID   0x2002  /* from esp_image_format.h */
+
+struct sim_partition {
+    esp_partition_t part;
+    std::vector<uint8_t> flash;
+    size_t image_size;      /* What esp_image_verify() finds when parsing the segments */
+    size_t fail_read_at;
+    partition_sim_stats stats;
+};
+
+static std::map<const esp_partition_t *, sim_partition *> s_partitions;
+static uint32_t s_next_address = 0x10000;
+
+const esp_partition_t *partition_sim_create(const char *label, size_t size, const std::vector<uint8_t> &image)
+{
+    sim_partition *p = new sim_partition();
+    p->part.type = 0;               /* ESP_PARTITION_TYPE_APP */
+    p->part.address = s_next_address;
+    p->part.size = size;
+    strncpy(p->part.label, label, sizeof(p->part.label) - 1);
+    p->flash.assign(size, 0xff);
+    std::copy(image.begin(), image.begin() + std::min(image.size(), size), p->flash.begin());
+    p->image_size = image.size();
+    s_next_address += size;
+    s_partitions[&p->part] = p;
+    return &p->part;
+}
+
+void partition_sim_destroy(const esp_partition_t *partition)
+{
+    delete s_partitions[partition];
+    s_partitions.erase(partition);
+}
+
+void partition_sim_fail_read_at(const esp_partition_t *partition, size_t offset)
+{
+    s_partitions.at(partition)->fail_read_at = offset;
+}
+
+partition_sim_stats partition_sim_get_stats(const esp_partition_t *partition)
+{
+    return s_partitions.at(partition)->stats;
+}
+
+static std::vector<uint8_t> sha256(const uint8_t *data, size_t size)
+{
+    std::vector<uint8_t> digest(HASH_LEN);
+    mbedtls_sha256_ret(data, size, digest.data(), 0);
+    return digest;
+}
+
+std::vector<uint8_t> partition_sim_image_sha256(const std::vector<uint8_t> &image)
+{
+    const esp_image_header_t *header = (const esp_image_header_t *)image.data();
+    if (image.size() > sizeof(esp_image_header_t) + HASH_LEN && header->hash_appended) {
+        return std::vector<uint8_t>(image.end() - HASH_LEN, image.end());
+    }
+    return sha256(image.data(), image.size());
+}
+
+void partition_sim_append_sha256(std::vector<uint8_t> &image)
+{
+    ((esp_image_header_t *)image.data())->hash_appended = 1;
+    std::vector<uint8_t> digest = sha256(image.data(), image.size());
+    image.insert(image.end(), digest.begin(), digest.end());
+}
+
+extern "C" esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    sim_partition *p = s_partitions.at(partition);
+    if (src_offset > p->flash.size() || size > p->flash.size() - src_offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (p->fail_read_at && src_offset + size > p->fail_read_at) {
+        return ESP_FAIL;
+    }
+    memcpy(dst, p->flash.data() + src_offset, size);
+    p->stats.reads++;
+    p->stats.bytes_read += size;
+    p->stats.max_read = size > p->stats.max_read ? size : p->stats.max_read;
+    return ESP_OK;
+}
+
+/* As bootloader_common_get_sha256_of_partition() for an app partition, the image is checked before */
+extern "C" esp_err_t esp_partition_get_sha256(const esp_partition_t *partition, uint8_t *sha_256)
+{
+    sim_partition *p = s_partitions.at(partition);
+    if (p->image_size == 0 || p->flash[0] != ESP_IMAGE_HEADER_MAGIC) {
+        return ESP_ERR_IMAGE_INVALID;
+    }
+    std::vector<uint8_t> image(p->flash.begin(), p->flash.begin() + p->image_size);
+    const esp_image_header_t *header = (const esp_image_header_t *)image.data();
+    if (header->hash_appended && sha256(image.data(), image.size() - HASH_LEN) != partition_sim_image_sha256(image)) {
+        return ESP_ERR_IMAGE_INVALID;
+    }
+    std::vector<uint8_t> digest = partition_sim_image_sha256(image);
+    memcpy(sha_256, digest.data(), HASH_LEN);
+    return ESP_OK;
+}
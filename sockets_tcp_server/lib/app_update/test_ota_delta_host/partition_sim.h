@@ -0,0 +1,22 @@
+#pragma once
+/* Emulated app partitions, each holding an app image followed by erased flash */
+#include "esp_partition.h"
+#include <vector>
+
+struct partition_sim_stats {
+    size_t reads;
+    size_t bytes_read;
+    size_t max_read;
+};
+
+/* Creates a partition holding image, padded with 0xff up to size */
+const esp_partition_t *partition_sim_create(const char *label, size_t size, const std::vector<uint8_t> &image);
+void partition_sim_destroy(const esp_partition_t *partition);
+/* Makes esp_partition_read() fail from the given offset, 0 to never fail */
+void partition_sim_fail_read_at(const esp_partition_t *partition, size_t offset);
+partition_sim_stats partition_sim_get_stats(const esp_partition_t *partition);
+
+/* SHA-256 of an app image as esp_partition_get_sha256() returns it: the appended hash if there is one */
+std::vector<uint8_t> partition_sim_image_sha256(const std::vector<uint8_t> &image);
+/* Sets the hash_appended flag of an app image and appends its SHA-256, as esptool elf2image does */
+void partition_sim_append_sha256(std::vector<uint8_t> &image);
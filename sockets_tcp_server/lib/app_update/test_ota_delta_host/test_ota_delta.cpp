@@ -0,0 +1,415 @@
+#include "catch.hpp"
+#include "esp_ota_ops.h"
+#include "esp_ota_delta.h"
+#include "esp_app_format.h"
+#include "esp32/rom/miniz.h"
+#include "partition_sim.h"
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PARTITION_SIZE  0x100000
+#define CONTROL_SIZE    12
+
+typedef std::vector<uint8_t> bytes;
+
+static bytes read_file(const std::string &path)
+{
+    std::ifstream f(path.c_str(), std::ios::binary);
+    REQUIRE(f.good());
+    return bytes(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const std::string &path, const bytes &data)
+{
+    std::ofstream f(path.c_str(), std::ios::binary);
+    f.write((const char *)data.data(), data.size());
+    REQUIRE(f.good());
+}
+
+/* Builds the compressed container the same way as esptool_py/ota_compress.py */
+static bytes pack(const bytes &content)
+{
+    tdefl_compressor *comp = new tdefl_compressor;
+    bytes data(content.size() + content.size() / 8 + 1024);
+    size_t in_size = content.size();
+    size_t out_size = data.size();
+    REQUIRE(tdefl_init(comp, NULL, NULL, TDEFL_WRITE_ZLIB_HEADER | 128) == TDEFL_STATUS_OKAY);
+    REQUIRE(tdefl_compress(comp, content.data(), &in_size, data.data(), &out_size, TDEFL_FINISH) == TDEFL_STATUS_DONE);
+    delete comp;
+    data.resize(out_size);
+
+    esp_ota_compressed_header_t header = {};
+    header.magic = ESP_OTA_COMPRESSED_MAGIC;
+    header.version = ESP_OTA_COMPRESSED_VERSION;
+    header.compression = ESP_OTA_COMPRESSION_ZLIB;
+    header.header_size = sizeof(header);
+    header.image_size = content.size();
+    header.data_size = data.size();
+    bytes container(sizeof(header) + data.size());
+    memcpy(container.data(), &header, sizeof(header));
+    memcpy(container.data() + sizeof(header), data.data(), data.size());
+    return container;
+}
+
+/* App image with code-like contents and an appended SHA-256 */
+static bytes make_image(size_t size, unsigned seed)
+{
+    static const char *words[] = { "\x36\x41\x00", "\x1d\xf0", "\x0c\x02", "esp_", "_task", "\xff\xff\x00\x00" };
+    bytes image(sizeof(esp_image_header_t), 0);
+    image[0] = ESP_IMAGE_HEADER_MAGIC;
+    srand(seed);
+    while (image.size() < size) {
+        if (rand() % 4 == 0) {
+            image.push_back(rand());
+        } else {
+            const char *w = words[rand() % 6];
+            image.insert(image.end(), w, w + strlen(w) + (w[0] == '\xff' ? 3 : 0));
+        }
+    }
+    image.resize(size);
+    partition_sim_append_sha256(image);
+    return image;
+}
+
+/* Next release of an app image: some code inserted, a few bytes changed and addresses moved in a region */
+static bytes make_release(const bytes &source, unsigned seed)
+{
+    bytes image(source.begin(), source.end() - 32);
+    srand(seed);
+    bytes inserted(500);
+    for (uint8_t &b : inserted) {
+        b = rand();
+    }
+    image.insert(image.begin() + image.size() / 3, inserted.begin(), inserted.end());
+    for (int i = 0; i < 30; i++) {
+        image[sizeof(esp_image_header_t) + rand() % (image.size() - sizeof(esp_image_header_t))] = rand();
+    }
+    for (size_t i = image.size() / 2; i < image.size() / 2 + 8192; i += 4) {
+        image[i] += 0x10;
+    }
+    partition_sim_append_sha256(image);
+    return image;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static void add_record(bytes &patch, uint32_t diff_len, uint32_t extra_len, int32_t seek)
+{
+    uint8_t control[CONTROL_SIZE];
+    put_u32(control, diff_len);
+    put_u32(control + 4, extra_len);
+    put_u32(control + 8, seek);
+    patch.insert(patch.end(), control, control + CONTROL_SIZE);
+}
+
+/* Patch of records taking the diff from random places of the source, with some extra bytes */
+static bytes random_patch(const bytes &source, const bytes &image, unsigned seed)
+{
+    bytes patch;
+    size_t image_pos = 0;
+    size_t source_pos = 0;
+    size_t seek_field = 0;
+    srand(seed);
+    while (image_pos < image.size()) {
+        size_t diff_len = std::min<size_t>(rand() % 6000, image.size() - image_pos);
+        size_t extra_len = std::min<size_t>(rand() % 300, image.size() - image_pos - diff_len);
+        size_t diff_source = patch.empty() ? 0 : rand() % (source.size() - diff_len);
+        if (!patch.empty()) {
+            put_u32(&patch[seek_field], diff_source - source_pos);
+        }
+        add_record(patch, diff_len, extra_len, 0);
+        seek_field = patch.size() - 4;
+        for (size_t i = 0; i < diff_len; i++) {
+            patch.push_back(image[image_pos + i] - source[diff_source + i]);
+        }
+        patch.insert(patch.end(), image.begin() + image_pos + diff_len, image.begin() + image_pos + diff_len + extra_len);
+        image_pos += diff_len + extra_len;
+        source_pos = diff_source + diff_len;
+    }
+    return patch;
+}
+
+static bytes make_delta(const bytes &source, const bytes &patch, size_t image_size)
+{
+    esp_ota_delta_header_t header = {};
+    header.magic = ESP_OTA_DELTA_MAGIC;
+    header.version = ESP_OTA_DELTA_VERSION;
+    header.header_size = sizeof(header);
+    header.source_size = source.size();
+    memcpy(header.source_sha256, partition_sim_image_sha256(source).data(), sizeof(header.source_sha256));
+    header.image_size = image_size;
+    bytes delta((const uint8_t *)&header, (const uint8_t *)&header + sizeof(header));
+    bytes container = pack(patch);
+    delta.insert(delta.end(), container.begin(), container.end());
+    return delta;
+}
+
+struct output {
+    bytes data;
+    size_t max_write;
+    esp_err_t fail_with;
+};
+
+static esp_err_t collect(void *ctx, const void *data, size_t size)
+{
+    output *out = static_cast<output *>(ctx);
+    if (out->fail_with != ESP_OK) {
+        return out->fail_with;
+    }
+    out->data.insert(out->data.end(), (const uint8_t *)data, (const uint8_t *)data + size);
+    out->max_write = size > out->max_write ? size : out->max_write;
+    return ESP_OK;
+}
+
+/* Feeds the delta image in pieces of random size up to max_piece, returns the result of esp_ota_delta_end() */
+static esp_err_t apply(const bytes &delta, const esp_partition_t *source, size_t max_piece, output &out,
+                       esp_err_t *write_err = NULL)
+{
+    esp_ota_delta_handle_t h = esp_ota_delta_begin(source, collect, &out);
+    REQUIRE(h != NULL);
+    esp_err_t err = ESP_OK;
+    size_t pos = 0;
+    while (pos < delta.size() && err == ESP_OK) {
+        size_t n = std::min<size_t>(1 + rand() % max_piece, delta.size() - pos);
+        err = esp_ota_delta_write(h, delta.data() + pos, n);
+        pos += n;
+    }
+    if (write_err) {
+        *write_err = err;
+    }
+    return esp_ota_delta_end(h);
+}
+
+TEST_CASE("delta image is applied whatever the write sizes", "[esp_ota_delta]")
+{
+    bytes source = make_image(200 * 1024 + 3, 1);
+    bytes image = make_release(source, 2);
+    bytes delta = make_delta(source, random_patch(source, image, 3), image.size());
+    const esp_partition_t *part = partition_sim_create("ota_0", PARTITION_SIZE, source);
+
+    CHECK(esp_ota_is_delta_image(delta.data(), delta.size()));
+    CHECK(esp_ota_is_delta_image(delta.data(), 3));
+    CHECK_FALSE(esp_ota_is_delta_image(image.data(), image.size()));
+    CHECK_FALSE(esp_ota_is_compressed_image(delta.data(), delta.size()));
+
+    for (size_t max_piece : { (size_t)1, (size_t)7, (size_t)289, (size_t)4096, delta.size() }) {
+        output out = {};
+        srand(max_piece);
+        CHECK(apply(delta, part, max_piece, out) == ESP_OK);
+        CHECK(out.data == image);
+    }
+    /* The source image is read through a bounded buffer */
+    CHECK(partition_sim_get_stats(part).max_read <= 4096);
+    partition_sim_destroy(part);
+}
+
+TEST_CASE("delta image made by ota_delta.py is applied", "[esp_ota_delta][packer]")
+{
+    bytes source = make_image(500 * 1024, 4);
+    bytes image = make_release(source, 5);
+    write_file("source.bin", source);
+    write_file("image.bin", image);
+    REQUIRE(system("python " OTA_DELTA_PY " diff source.bin image.bin delta.bin > /dev/null") == 0);
+    bytes delta = read_file("delta.bin");
+    const esp_partition_t *part = partition_sim_create("ota_0", PARTITION_SIZE, source);
+
+    output out = {};
+    CHECK(apply(delta, part, 1460, out) == ESP_OK);
+    CHECK(out.data == image);
+    partition_sim_stats stats = partition_sim_get_stats(part);
+    CHECK(stats.max_read <= 4096);
+    printf("image %zu bytes, compressed %zu bytes, delta %zu bytes (%.2f%%), %zu source bytes read in %zu reads\n",
+           image.size(), pack(image).size(), delta.size(), 100.0 * delta.size() / image.size(), stats.bytes_read, stats.reads);
+
+    /* The start of the new image is made to read its app description */
+    uint8_t header[289];
+    CHECK(esp_ota_delta_peek(delta.data(), delta.size(), part, header, sizeof(header)) == ESP_OK);
+    CHECK(memcmp(header, image.data(), sizeof(header)) == 0);
+
+    /* ota_delta.py checks the source image too */
+    write_file("image.bin", make_image(1000, 6));
+    CHECK(system("python " OTA_DELTA_PY " patch image.bin delta.bin out.bin 2> /dev/null") != 0);
+    REQUIRE(system("python " OTA_DELTA_PY " patch source.bin delta.bin out.bin > /dev/null") == 0);
+    CHECK(read_file("out.bin") == image);
+    remove("source.bin");
+    remove("image.bin");
+    remove("delta.bin");
+    remove("out.bin");
+    partition_sim_destroy(part);
+}
+
+TEST_CASE("delta image made from another source image is rejected", "[esp_ota_delta]")
+{
+    bytes source = make_image(50 * 1024, 7);
+    bytes image = make_release(source, 8);
+    bytes delta = make_delta(source, random_patch(source, image, 9), image.size());
+    output out = {};
+    esp_err_t write_err;
+    const esp_partition_t *part = NULL;
+
+    SECTION("other image") {
+        part = partition_sim_create("ota_0", PARTITION_SIZE, make_image(50 * 1024, 10));
+    }
+    SECTION("corrupted source image") {
+        bytes corrupted = source;
+        corrupted[1000] ^= 1;
+        part = partition_sim_create("ota_0", PARTITION_SIZE, corrupted);
+    }
+    SECTION("no image") {
+        part = partition_sim_create("ota_0", PARTITION_SIZE, bytes());
+    }
+    SECTION("source larger than the partition") {
+        part = partition_sim_create("ota_0", source.size() - 1, source);
+    }
+    CHECK(apply(delta, part, 512, out, &write_err) == ESP_ERR_OTA_VALIDATE_FAILED);
+    CHECK(write_err == ESP_ERR_OTA_VALIDATE_FAILED);
+    CHECK(out.data.empty());
+    partition_sim_destroy(part);
+}
+
+TEST_CASE("corrupted delta images are rejected", "[esp_ota_delta]")
+{
+    bytes source = make_image(64 * 1024, 11);
+    bytes image = make_release(source, 12);
+    bytes patch = random_patch(source, image, 13);
+    bytes delta = make_delta(source, patch, image.size());
+    const esp_partition_t *part = partition_sim_create("ota_0", PARTITION_SIZE, source);
+    output out = {};
+    esp_err_t write_err = ESP_OK;
+
+    SECTION("truncated") {
+        bytes d(delta.begin(), delta.end() - 100);
+        CHECK(apply(d, part, 512, out) == ESP_ERR_OTA_VALIDATE_FAILED);
+    }
+    SECTION("truncated patch") {
+        bytes p(patch.begin(), patch.end() - 1);
+        CHECK(apply(make_delta(source, p, image.size()), part, 512, out) == ESP_ERR_OTA_VALIDATE_FAILED);
+    }
+    SECTION("data after the end") {
+        bytes d = delta;
+        d.push_back(0);
+        CHECK(apply(d, part, 512, out, &write_err) == ESP_ERR_OTA_VALIDATE_FAILED);
+        CHECK(write_err == ESP_ERR_OTA_VALIDATE_FAILED);
+    }
+    SECTION("patch after the end of the image") {
+        bytes p = patch;
+        add_record(p, 0, 1, 0);
+        p.push_back(0);
+        CHECK(apply(make_delta(source, p, image.size()), part, 512, out, &write_err) == ESP_ERR_OTA_VALIDATE_FAILED);
+        CHECK(write_err == ESP_ERR_OTA_VALIDATE_FAILED);
+    }
+    SECTION("corrupted compressed patch") {
+        bytes d = delta;
+        d[d.size() / 2] ^= 0x55;
+        CHECK(apply(d, part, 512, out) == ESP_ERR_OTA_VALIDATE_FAILED);
+    }
+    SECTION("record larger than the image") {
+        bytes p;
+        add_record(p, 0, image.size() + 1, 0);
+        p.insert(p.end(), image.begin(), image.end());
+        p.push_back(0);
+        CHECK(apply(make_delta(source, p, image.size()), part, 512, out, &write_err) == ESP_ERR_OTA_VALIDATE_FAILED);
+        CHECK(write_err == ESP_ERR_OTA_VALIDATE_FAILED);
+        CHECK(out.data.empty());
+    }
+    SECTION("diff beyond the source image") {
+        bytes p;
+        add_record(p, 0, 0, source.size() - 10);
+        add_record(p, 11, 0, 0);
+        p.insert(p.end(), 11, 0);
+        CHECK(apply(make_delta(source, p, 11), part, 512, out, &write_err) == ESP_ERR_OTA_VALIDATE_FAILED);
+        CHECK(write_err == ESP_ERR_OTA_VALIDATE_FAILED);
+    }
+    SECTION("seek before the source image") {
+        bytes p;
+        add_record(p, 10, 0, -11);
+        p.insert(p.end(), 10, 0);
+        add_record(p, 10, 0, 0);
+        p.insert(p.end(), 10, 0);
+        CHECK(apply(make_delta(source, p, 20), part, 512, out, &write_err) == ESP_ERR_OTA_VALIDATE_FAILED);
+        CHECK(write_err == ESP_ERR_OTA_VALIDATE_FAILED);
+        CHECK(out.data.empty());
+    }
+    SECTION("unsupported version") {
+        bytes d = delta;
+        d[4] = ESP_OTA_DELTA_VERSION + 1;
+        CHECK(apply(d, part, 512, out, &write_err) == ESP_ERR_OTA_VALIDATE_FAILED);
+        CHECK(write_err == ESP_ERR_OTA_VALIDATE_FAILED);
+        CHECK(out.data.empty());
+    }
+    SECTION("write error") {
+        out.fail_with = ESP_FAIL;
+        CHECK(apply(delta, part, 512, out, &write_err) == ESP_ERR_OTA_VALIDATE_FAILED);
+        CHECK(write_err == ESP_FAIL);
+    }
+    SECTION("source read error") {
+        partition_sim_fail_read_at(part, source.size() / 2);
+        CHECK(apply(delta, part, 512, out, &write_err) == ESP_ERR_OTA_VALIDATE_FAILED);
+        CHECK(write_err == ESP_FAIL);
+    }
+    partition_sim_destroy(part);
+}
+
+TEST_CASE("longer delta headers of later versions are skipped", "[esp_ota_delta]")
+{
+    bytes source = make_image(10000, 14);
+    bytes image = make_release(source, 15);
+    bytes delta = make_delta(source, random_patch(source, image, 16), image.size());
+    esp_ota_delta_header_t *header = (esp_ota_delta_header_t *)delta.data();
+    header->header_size += 8;
+    delta.insert(delta.begin() + sizeof(*header), 8, 0xaa);
+    const esp_partition_t *part = partition_sim_create("ota_0", PARTITION_SIZE, source);
+    output out = {};
+    CHECK(apply(delta, part, 5, out) == ESP_OK);
+    CHECK(out.data == image);
+    partition_sim_destroy(part);
+}
+
+TEST_CASE("image header is made from the start of the delta image", "[esp_ota_delta]")
+{
+    bytes source = make_image(100 * 1024, 17);
+    bytes image = make_release(source, 18);
+    const esp_partition_t *part = partition_sim_create("ota_0", PARTITION_SIZE, source);
+    uint8_t header[289];
+    bytes patch;
+
+    SECTION("random records") {
+        patch = random_patch(source, image, 19);
+    }
+    SECTION("small records at the start") {
+        /* The start of the patch is much larger than the start of the image */
+        for (size_t i = 0; i < sizeof(header); i++) {
+            add_record(patch, 0, 1, 0);
+            patch.push_back(image[i]);
+        }
+        add_record(patch, 0, image.size() - sizeof(header), 0);
+        patch.insert(patch.end(), image.begin() + sizeof(header), image.end());
+    }
+    bytes delta = make_delta(source, patch, image.size());
+
+    size_t needed = 0;
+    for (size_t size = 0; size <= delta.size(); size++) {
+        esp_err_t err = esp_ota_delta_peek(delta.data(), size, part, header, sizeof(header));
+        if (err == ESP_OK) {
+            needed = size;
+            break;
+        }
+        REQUIRE(err == ESP_ERR_INVALID_SIZE);
+    }
+    REQUIRE(needed > 0);
+    CHECK(memcmp(header, image.data(), sizeof(header)) == 0);
+    CHECK(esp_ota_delta_peek(image.data(), image.size(), part, header, sizeof(header)) == ESP_ERR_OTA_VALIDATE_FAILED);
+    partition_sim_destroy(part);
+}
@@ -106,6 +106,95 @@ _Static_assert(sizeof(rtc_retain_mem_t) <= ESP_BOOTLOADER_RESERVE_RTC, "Reserved
  */
 esp_err_t esp_image_verify(esp_image_load_mode_t mode, const esp_partition_pos_t *part, esp_image_metadata_t *data);
 
+#ifndef BOOTLOADER_BUILD
+/**
+ * @brief Opaque state of an app image verified from the data written to a partition
+ */
+typedef struct esp_image_stream *esp_image_stream_handle_t;
+
+/**
+ * @brief Start verifying an app image from the data written to a partition (not available in bootloader).
+ *
+ * The data passed to esp_image_verify_stream_data() is parsed and hashed as esp_image_verify() does when
+ * reading it from flash, so that an image being written doesn't need to be read back to be verified.
+ *
+ * @param part Partition the image is written to, from its start.
+ * @param[out] out_handle Handle for esp_image_verify_stream_data() and esp_image_verify_stream_end().
+ *
+ * @return
+ * - ESP_OK if the handle was allocated
+ * - ESP_ERR_NO_MEM if out of memory
+ * - ESP_ERR_INVALID_ARG if an argument is NULL or the partition is larger than 16MB
+ * - ESP_ERR_NOT_SUPPORTED if the signature of apps is checked on update, only esp_image_verify() checks it.
+ */
+esp_err_t esp_image_verify_stream_begin(const esp_partition_pos_t *part, esp_image_stream_handle_t *out_handle);
+
+/**
+ * @brief Verify the next data written to the partition.
+ *
+ * The data written after the end of the image is ignored.
+ * Errors are not logged, call esp_image_verify() on the partition to know why the image is invalid.
+ *
+ * @param handle Handle obtained from esp_image_verify_stream_begin().
+ * @param data Data written to the partition, following the previous data.
+ * @param size Size of data in bytes.
+ *
+ * @return
+ * - ESP_OK if the data is valid so far
+ * - ESP_ERR_IMAGE_INVALID if the image is invalid, the following data is ignored
+ * - ESP_ERR_INVALID_ARG if handle or data is NULL
+ */
+esp_err_t esp_image_verify_stream_data(esp_image_stream_handle_t handle, const void *data, size_t size);
+
+/**
+ * @brief Finish verifying an app image from the data written to a partition, and free the handle.
+ *
+ * @param handle Handle obtained from esp_image_verify_stream_begin().
+ * @param[out] data Image metadata, as esp_image_verify() would return it. NULL to only free the handle.
+ *
+ * @return
+ * - ESP_OK if the whole image was written and is valid
+ * - ESP_ERR_IMAGE_INVALID if the image is invalid or incomplete
+ * - ESP_ERR_INVALID_ARG if handle is NULL
+ */
+esp_err_t esp_image_verify_stream_end(esp_image_stream_handle_t handle, esp_image_metadata_t *data);
+
+/**
+ * @brief Save the state of an image verification, to continue it with esp_image_verify_stream_restore() after a restart.
+ *
+ * @param handle Handle obtained from esp_image_verify_stream_begin().
+ * @param[out] state Buffer receiving the state.
+ * @param[inout] size Size of the state buffer in bytes, set to the size of the state.
+ *
+ * @return
+ * - ESP_OK if the state was saved
+ * - ESP_ERR_INVALID_SIZE if the buffer is too small, ESP_IMAGE_STREAM_STATE_MAX_SIZE bytes are always enough
+ * - ESP_ERR_INVALID_ARG if an argument is NULL
+ */
+esp_err_t esp_image_verify_stream_save(esp_image_stream_handle_t handle, void *state, size_t *size);
+
+/**
+ * @brief Continue an image verification from a state saved by esp_image_verify_stream_save().
+ *
+ * The state is only valid in the app which saved it.
+ *
+ * @param part Partition the image is written to, as passed to esp_image_verify_stream_begin().
+ * @param state Saved state.
+ * @param size Size of the saved state in bytes.
+ * @param[out] out_handle Handle for esp_image_verify_stream_data() and esp_image_verify_stream_end().
+ *
+ * @return
+ * - ESP_OK if the handle was allocated
+ * - ESP_ERR_NO_MEM if out of memory
+ * - ESP_ERR_INVALID_ARG if an argument is NULL, or the state is invalid or was saved for another partition
+ */
+esp_err_t esp_image_verify_stream_restore(const esp_partition_pos_t *part, const void *state, size_t size,
+                                          esp_image_stream_handle_t *out_handle);
+
+/* Size of a state saved by esp_image_verify_stream_save() at most */
+#define ESP_IMAGE_STREAM_STATE_MAX_SIZE 512
+#endif // BOOTLOADER_BUILD
+
 /**
  * @brief Verify and load an app image (available only in space of bootloader).
  *
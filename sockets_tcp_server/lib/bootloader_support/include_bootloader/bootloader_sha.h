@@ -31,3 +31,18 @@ bootloader_sha256_handle_t bootloader_sha256_start(void);
 void bootloader_sha256_data(bootloader_sha256_handle_t handle, const void *data, size_t data_len);
 
 void bootloader_sha256_finish(bootloader_sha256_handle_t handle, uint8_t *digest);
+
+#ifndef BOOTLOADER_BUILD
+/* State of a SHA256 calculation in progress, independent of the SHA engine used */
+typedef struct {
+    uint32_t total[2];
+    uint32_t state[8];
+    uint8_t buffer[64];
+} bootloader_sha256_state_t;
+
+/* Save the state of a SHA256 calculation in progress, so that it can be continued after a restart */
+void bootloader_sha256_save(bootloader_sha256_handle_t handle, bootloader_sha256_state_t *state);
+
+/* Continue a SHA256 calculation from a saved state. Returns NULL if out of memory. */
+bootloader_sha256_handle_t bootloader_sha256_restore(const bootloader_sha256_state_t *state);
+#endif
@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 #include <string.h>
+#include <stdlib.h>
 #include <sys/param.h>
 #include <soc/cpu.h>
 #include <bootloader_utility.h>
@@ -716,6 +717,269 @@ esp_err_t esp_image_verify_bootloader_data(esp_image_metadata_t *data)
 }
 
 
+#ifndef BOOTLOADER_BUILD
+typedef enum {
+    STREAM_IMAGE_HEADER,
+    STREAM_SEGMENT_HEADER,
+    STREAM_SEGMENT_DATA,
+    STREAM_CHECKSUM,        /* Padding to 16 bytes ending with the checksum byte */
+    STREAM_HASH,            /* Appended SHA-256 */
+    STREAM_DONE,            /* Following data is not part of the image */
+} stream_state_t;
+
+struct esp_image_stream {
+    esp_image_metadata_t data;
+    uint32_t part_size;
+    uint32_t offset;            /* Offset in the image of the data parsed */
+    stream_state_t state;
+    int segment;                /* Index of the segment being received */
+    uint32_t left;              /* Bytes left to receive in the current state */
+    WORD_ALIGNED_ATTR uint8_t buf[HASH_LEN];   /* Header, checksum padding or hash being received */
+    uint32_t buf_len;
+    uint8_t checksum;
+    bootloader_sha256_handle_t sha_handle;
+    esp_err_t err;
+};
+
+esp_err_t esp_image_verify_stream_begin(const esp_partition_pos_t *part, esp_image_stream_handle_t *out_handle)
+{
+#ifdef SECURE_BOOT_CHECK_SIGNATURE
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    if (part == NULL || out_handle == NULL || part->size > SIXTEEN_MB) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_image_stream_handle_t handle = calloc(1, sizeof(struct esp_image_stream));
+    if (handle == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    handle->data.start_addr = part->offset;
+    handle->part_size = part->size;
+    handle->state = STREAM_IMAGE_HEADER;
+    handle->left = sizeof(esp_image_header_t);
+    handle->checksum = ESP_ROM_CHECKSUM_INITIAL;
+    *out_handle = handle;
+    return ESP_OK;
+#endif
+}
+
+/* XOR of all the bytes, as the image checksum is the XOR of the bytes of the XOR of the segment data words */
+static uint8_t xor_bytes(const uint8_t *data, size_t size)
+{
+    uint8_t result = 0;
+    while (size > 0 && ((intptr_t)data & 3) != 0) {
+        result ^= *data++;
+        size--;
+    }
+    uint32_t word = 0;
+    for (; size >= 4; size -= 4, data += 4) {
+        word ^= *(const uint32_t *)data;
+    }
+    while (size > 0) {
+        result ^= *data++;
+        size--;
+    }
+    return result ^ (word >> 24) ^ (word >> 16) ^ (word >> 8) ^ word;
+}
+
+/* Moves to the next state once the data of the current one is received */
+static esp_err_t stream_next(esp_image_stream_handle_t handle)
+{
+    esp_image_metadata_t *data = &handle->data;
+    uint32_t data_addr = data->start_addr + handle->offset;
+
+    switch (handle->state) {
+    case STREAM_IMAGE_HEADER:
+        memcpy(&data->image, handle->buf, sizeof(esp_image_header_t));
+        if (verify_image_header(data->start_addr, &data->image, true) != ESP_OK
+                || data->image.segment_count > ESP_IMAGE_MAX_SEGMENTS) {
+            return ESP_ERR_IMAGE_INVALID;
+        }
+        if (data->image.hash_appended) {
+            handle->sha_handle = bootloader_sha256_start();
+            if (handle->sha_handle == NULL) {
+                return ESP_ERR_NO_MEM;
+            }
+            bootloader_sha256_data(handle->sha_handle, &data->image, sizeof(esp_image_header_t));
+        }
+        handle->segment = -1;
+        break;
+    case STREAM_SEGMENT_HEADER:
+        memcpy(&data->segments[handle->segment], handle->buf, sizeof(esp_image_segment_header_t));
+        if (verify_segment_header(handle->segment, &data->segments[handle->segment], data_addr, true) != ESP_OK) {
+            return ESP_ERR_IMAGE_INVALID;
+        }
+        if (handle->sha_handle != NULL) {
+            bootloader_sha256_data(handle->sha_handle, handle->buf, sizeof(esp_image_segment_header_t));
+        }
+        data->segment_data[handle->segment] = data_addr;
+        handle->state = STREAM_SEGMENT_DATA;
+        handle->left = data->segments[handle->segment].data_len;
+        return ESP_OK;
+    case STREAM_SEGMENT_DATA:
+        break;
+    case STREAM_CHECKSUM:
+        if (!esp_cpu_in_ocd_debug_mode() && handle->buf[handle->buf_len - 1] != handle->checksum) {
+            return ESP_ERR_IMAGE_INVALID;
+        }
+        if (handle->sha_handle != NULL) {
+            bootloader_sha256_data(handle->sha_handle, handle->buf, handle->buf_len);
+        }
+        data->image_len = handle->offset;
+        if (data->image.hash_appended) {
+            handle->state = STREAM_HASH;
+            handle->left = HASH_LEN;
+        } else {
+            handle->state = STREAM_DONE;
+        }
+        return ESP_OK;
+    case STREAM_HASH: {
+        uint8_t image_hash[HASH_LEN];
+        bootloader_sha256_finish(handle->sha_handle, image_hash);
+        handle->sha_handle = NULL;
+        if (!esp_cpu_in_ocd_debug_mode() && memcmp(image_hash, handle->buf, HASH_LEN) != 0) {
+            return ESP_ERR_IMAGE_INVALID;
+        }
+        memcpy(data->image_digest, handle->buf, HASH_LEN);
+        data->image_len = handle->offset;
+        handle->state = STREAM_DONE;
+        return ESP_OK;
+    }
+    default:
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    /* After the image header or a segment: next segment header, or the checksum padding after the last one */
+    if (++handle->segment < data->image.segment_count) {
+        handle->state = STREAM_SEGMENT_HEADER;
+        handle->left = sizeof(esp_image_segment_header_t);
+    } else {
+        handle->state = STREAM_CHECKSUM;
+        handle->left = ((handle->offset + 1 + 15) & ~15) - handle->offset;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_image_verify_stream_data(esp_image_stream_handle_t handle, const void *data, size_t size)
+{
+    const uint8_t *in = (const uint8_t *)data;
+
+    if (handle == NULL || data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    while (size > 0 && handle->err == ESP_OK && handle->state != STREAM_DONE) {
+        uint32_t len = MIN(size, handle->left);
+        if (handle->state == STREAM_SEGMENT_DATA) {
+            handle->checksum ^= xor_bytes(in, len);
+            if (handle->sha_handle != NULL) {
+                bootloader_sha256_data(handle->sha_handle, in, len);
+            }
+        } else {
+            memcpy(handle->buf + handle->buf_len, in, len);
+            handle->buf_len += len;
+        }
+        in += len;
+        size -= len;
+        handle->offset += len;
+        handle->left -= len;
+        if (handle->offset > handle->part_size) {
+            handle->err = ESP_ERR_IMAGE_INVALID;
+        }
+        while (handle->err == ESP_OK && handle->left == 0 && handle->state != STREAM_DONE) {
+            handle->err = stream_next(handle);
+            handle->buf_len = 0;
+        }
+    }
+    return handle->err;
+}
+
+esp_err_t esp_image_verify_stream_end(esp_image_stream_handle_t handle, esp_image_metadata_t *data)
+{
+    if (handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = handle->err;
+    if (err == ESP_OK && handle->state != STREAM_DONE) {
+        err = ESP_ERR_IMAGE_INVALID;
+    }
+    if (data != NULL) {
+        if (err == ESP_OK) {
+            memcpy(data, &handle->data, sizeof(esp_image_metadata_t));
+        } else {
+            // Prevent invalid/incomplete data leaking out
+            bzero(data, sizeof(esp_image_metadata_t));
+        }
+    }
+    if (handle->sha_handle != NULL) {
+        bootloader_sha256_finish(handle->sha_handle, NULL);
+    }
+    free(handle);
+    return err;
+}
+
+#define STREAM_STATE_MAGIC 0x53494d45  /* "EMIS" */
+
+/* Saved verification state, the SHA-256 state replaces the handle of the hash in progress */
+typedef struct {
+    uint32_t magic;
+    uint32_t size;
+    struct esp_image_stream stream;
+    bootloader_sha256_state_t sha;
+} stream_saved_t;
+
+_Static_assert(sizeof(stream_saved_t) <= ESP_IMAGE_STREAM_STATE_MAX_SIZE, "ESP_IMAGE_STREAM_STATE_MAX_SIZE is too small");
+
+esp_err_t esp_image_verify_stream_save(esp_image_stream_handle_t handle, void *state, size_t *size)
+{
+    if (handle == NULL || state == NULL || size == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (*size < sizeof(stream_saved_t)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    stream_saved_t *saved = (stream_saved_t *)state;
+    bzero(saved, sizeof(stream_saved_t));
+    saved->magic = STREAM_STATE_MAGIC;
+    saved->size = sizeof(stream_saved_t);
+    memcpy(&saved->stream, handle, sizeof(struct esp_image_stream));
+    saved->stream.sha_handle = NULL;
+    if (handle->sha_handle != NULL) {
+        bootloader_sha256_save(handle->sha_handle, &saved->sha);
+    }
+    *size = sizeof(stream_saved_t);
+    return ESP_OK;
+}
+
+esp_err_t esp_image_verify_stream_restore(const esp_partition_pos_t *part, const void *state, size_t size,
+                                          esp_image_stream_handle_t *out_handle)
+{
+    const stream_saved_t *saved = (const stream_saved_t *)state;
+
+    if (part == NULL || state == NULL || out_handle == NULL || size != sizeof(stream_saved_t)
+            || saved->magic != STREAM_STATE_MAGIC || saved->size != sizeof(stream_saved_t)
+            || saved->stream.data.start_addr != part->offset || saved->stream.part_size != part->size
+            || saved->stream.state > STREAM_DONE || saved->stream.buf_len > sizeof(saved->stream.buf)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_image_stream_handle_t handle = malloc(sizeof(struct esp_image_stream));
+    if (handle == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(handle, &saved->stream, sizeof(struct esp_image_stream));
+    // the hash is in progress from the image header until the appended hash is received
+    if (handle->err == ESP_OK && handle->data.image.hash_appended
+            && handle->state > STREAM_IMAGE_HEADER && handle->state < STREAM_DONE) {
+        handle->sha_handle = bootloader_sha256_restore(&saved->sha);
+        if (handle->sha_handle == NULL) {
+            free(handle);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    *out_handle = handle;
+    return ESP_OK;
+}
+#endif // BOOTLOADER_BUILD
+
 static esp_err_t verify_checksum(bootloader_sha256_handle_t sha_handle, uint32_t checksum_word, esp_image_metadata_t *data)
 {
     uint32_t unpadded_length = data->image_len;
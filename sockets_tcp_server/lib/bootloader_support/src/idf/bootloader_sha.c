@@ -18,6 +18,7 @@
 #include <assert.h>
 #include <sys/param.h>
 #include <mbedtls/sha256.h>
+#include "sdkconfig.h"
 
 bootloader_sha256_handle_t bootloader_sha256_start(void)
 {
@@ -52,3 +53,36 @@ void bootloader_sha256_finish(bootloader_sha256_handle_t handle, uint8_t *digest
     mbedtls_sha256_free(ctx);
     free(handle);
 }
+
+void bootloader_sha256_save(bootloader_sha256_handle_t handle, bootloader_sha256_state_t *state)
+{
+    assert(handle != NULL);
+    mbedtls_sha256_context ctx;
+    // a clone of a context using the SHA engine holds the state read from the engine
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_clone(&ctx, (const mbedtls_sha256_context *)handle);
+    memcpy(state->total, ctx.total, sizeof(state->total));
+    memcpy(state->state, ctx.state, sizeof(state->state));
+    memcpy(state->buffer, ctx.buffer, sizeof(state->buffer));
+    mbedtls_sha256_free(&ctx);
+}
+
+bootloader_sha256_handle_t bootloader_sha256_restore(const bootloader_sha256_state_t *state)
+{
+    mbedtls_sha256_context *ctx = (mbedtls_sha256_context *)bootloader_sha256_start();
+    if (!ctx) {
+        return NULL;
+    }
+    memcpy(ctx->total, state->total, sizeof(ctx->total));
+    memcpy(ctx->state, state->state, sizeof(ctx->state));
+    memcpy(ctx->buffer, state->buffer, sizeof(ctx->buffer));
+    if (state->total[0] >= 64 || state->total[1] != 0) {
+        // blocks were already processed, continue from the restored digest state
+#if defined(MBEDTLS_SHA256_ALT) && CONFIG_IDF_TARGET_ESP32
+        ctx->mode = ESP_MBEDTLS_SHA256_SOFTWARE;
+#elif defined(MBEDTLS_SHA256_ALT) && CONFIG_IDF_TARGET_ESP32S2
+        ctx->sha_state = ESP_SHA256_STATE_IN_PROCESS;
+#endif
+    }
+    return ctx;
+}
@@ -5,6 +5,7 @@
 #include <esp_types.h>
 #include <stdio.h>
 #include "string.h"
+#include <sys/param.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -48,6 +49,41 @@ TEST_CASE("Verify unit test app image", "[bootloader_support]")
     TEST_ASSERT_NOT_EQUAL(0, data.image_len);
     TEST_ASSERT_TRUE(data.image_len <= running->size);
 }
+
+TEST_CASE("Verify unit test app image as a stream", "[bootloader_support]")
+{
+    esp_image_metadata_t data = { 0 };
+    esp_image_metadata_t stream_data = { 0 };
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    TEST_ASSERT_NOT_EQUAL(NULL, running);
+    const esp_partition_pos_t running_pos  = {
+        .offset = running->address,
+        .size = running->size,
+    };
+    TEST_ASSERT_EQUAL_HEX(ESP_OK, esp_image_verify(ESP_IMAGE_VERIFY, &running_pos, &data));
+
+    const uint8_t *image;
+    spi_flash_mmap_handle_t handle;
+    uint32_t mapped_size = MIN(running->size, data.image_len + 4096);
+    TEST_ESP_OK(esp_partition_mmap(running, 0, mapped_size, SPI_FLASH_MMAP_DATA, (const void **)&image, &handle));
+
+    // pieces of odd sizes, and the data following the image is ignored
+    esp_image_stream_handle_t stream;
+    TEST_ESP_OK(esp_image_verify_stream_begin(&running_pos, &stream));
+    for (uint32_t offset = 0, size = 1; offset < mapped_size; offset += size, size = (size * 7 + 3) % 1500) {
+        TEST_ESP_OK(esp_image_verify_stream_data(stream, image + offset, MIN(size, mapped_size - offset)));
+    }
+    TEST_ESP_OK(esp_image_verify_stream_end(stream, &stream_data));
+    TEST_ASSERT_EQUAL_MEMORY(&data, &stream_data, sizeof(esp_image_metadata_t));
+
+    // the last bytes of the image are missing
+    TEST_ESP_OK(esp_image_verify_stream_begin(&running_pos, &stream));
+    TEST_ESP_OK(esp_image_verify_stream_data(stream, image, data.image_len - 1));
+    TEST_ASSERT_EQUAL_HEX(ESP_ERR_IMAGE_INVALID, esp_image_verify_stream_end(stream, &stream_data));
+    TEST_ASSERT_EQUAL(0, stream_data.image_len);
+
+    spi_flash_munmap(handle);
+}
 #endif
 
 void check_label_search (int num_test, const char *list, const char *t_label, bool result)
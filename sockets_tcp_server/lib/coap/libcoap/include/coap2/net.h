@@ -33,22 +33,51 @@
 
 struct coap_queue_t;
 
+/**
+ * Number of hash buckets used to look up the entries of a context's sendqueue
+ * by transaction id and by token. A lookup scans the entries of one bucket,
+ * on average the number of queued entries divided by this size.
+ */
+#ifndef COAP_SENDQUEUE_HASH_SIZE
+#define COAP_SENDQUEUE_HASH_SIZE 32
+#endif
+
 /**
  * Queue entry
+ *
+ * The sendqueue of a context is a pairing heap ordered by t, linked through
+ * child, sibling and prev. Its entries are also doubly chained in two hash
+ * tables of the context, to be found by transaction id and by token, and
+ * unlinked from them without scanning their bucket. The next pointer is only
+ * used by the delayqueue of a session.
  */
 typedef struct coap_queue_t {
   struct coap_queue_t *next;
-  coap_tick_t t;                /**< when to send PDU for the next time */
+  coap_tick_t t;                /**< when to send PDU for the next time,
+                                 *   relative to sendqueue_basetime */
   unsigned char retransmit_cnt; /**< retransmission counter, will be removed
                                  *    when zero */
   unsigned int timeout;         /**< the randomized timeout value */
   coap_session_t *session;      /**< the CoAP session */
   coap_tid_t id;                /**< CoAP transaction id */
   coap_pdu_t *pdu;              /**< the CoAP PDU to send */
+  struct coap_queue_t *child;   /**< first child in the sendqueue heap */
+  struct coap_queue_t *sibling; /**< next sibling in the sendqueue heap */
+  struct coap_queue_t *prev;    /**< previous sibling, or parent of a first
+                                 *   child; @c NULL for the heap root */
+  struct coap_queue_t *tid_next;   /**< next entry with the same id hash */
+  struct coap_queue_t **tid_pprev; /**< pointer to this entry in the id hash
+                                    *   chain, @c NULL when not indexed */
+  struct coap_queue_t *token_next; /**< next entry with the same token hash */
+  struct coap_queue_t **token_pprev; /**< pointer to this entry in the token
+                                      *   hash chain */
 } coap_queue_t;
 
 /**
- * Adds @p node to given @p queue, ordered by variable t in @p node.
+ * Adds @p node to given @p queue, ordered by variable t in @p node. When @p
+ * queue is the sendqueue of the node's session context, the node is also
+ * indexed by transaction id and token for coap_find_transaction() and the
+ * cancel functions.
  *
  * @param queue Queue to add to.
  * @param node Node entry to add to Queue.
@@ -159,10 +188,10 @@ typedef struct coap_context_t {
 #endif /* WITHOUT_ASYNC */
 
   /**
-   * The time stamp in the first element of the sendqeue is relative
+   * The time stamps of all elements of the sendqueue are relative
    * to sendqueue_basetime. */
   coap_tick_t sendqueue_basetime;
-  coap_queue_t *sendqueue;
+  coap_queue_t *sendqueue;        /**< heap root, the next to retransmit */
   coap_endpoint_t *endpoint;      /**< the endpoints used for listening  */
   coap_session_t *sessions;       /**< client sessions */
 
@@ -217,6 +246,10 @@ typedef struct coap_context_t {
   unsigned int csm_timeout;           /**< Timeout for waiting for a CSM from the remote side. 0 means disabled. */
 
   void *app;                       /**< application-specific data */
+
+  /* Kept last, so that the other fields do not move with the hash size. */
+  coap_queue_t *sendqueue_tid[COAP_SENDQUEUE_HASH_SIZE];   /**< sendqueue by session and id */
+  coap_queue_t *sendqueue_token[COAP_SENDQUEUE_HASH_SIZE]; /**< sendqueue by session and token */
 } coap_context_t;
 
 /**
@@ -285,9 +318,10 @@ coap_register_option(coap_context_t *ctx, uint16_t type) {
 }
 
 /**
- * Set sendqueue_basetime in the given context object @p ctx to @p now. This
- * function returns the number of elements in the queue head that have timed
- * out.
+ * Set sendqueue_basetime in the given context object @p ctx to @p now. The
+ * time stamps of all elements in the sendqueue are adjusted, those that have
+ * timed out are set to zero. This function returns the number of elements
+ * that have timed out.
  */
 unsigned int coap_adjust_basetime(coap_context_t *ctx, coap_tick_t now);
 
@@ -603,7 +637,8 @@ int coap_handle_event(coap_context_t *context,
  * element with id @p id was found, @c 0 otherwise. For a return value of @c 0,
  * the contents of @p node is undefined.
  *
- * @param queue The queue to search for @p id.
+ * @param queue The queue to search for @p id, the sendqueue of the context
+ *              of @p session.
  * @param session The session to look for.
  * @param id    The transaction id to look for.
  * @param node  If found, @p node is updated to point to the removed node. You
@@ -623,7 +658,8 @@ coap_wait_ack( coap_context_t *context, coap_session_t *session,
 /**
  * Retrieves transaction from the queue.
  *
- * @param queue The transaction queue to be searched.
+ * @param queue The transaction queue to be searched, the sendqueue of the
+ *              context of @p session.
  * @param session The session to find.
  * @param id    The transaction id to find.
  *
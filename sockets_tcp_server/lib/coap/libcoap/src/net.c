@@ -147,34 +147,189 @@ coap_free_node(coap_queue_t *node) {
 }
 #endif /* WITH_CONTIKI */
 
+/*
+ * The sendqueue is a pairing heap ordered by t, so that adding, removing and
+ * retransmitting a node do not depend on the number of outstanding
+ * transactions. The first child of a node is linked through child, the
+ * following children through sibling, and prev points back to the previous
+ * sibling or, for a first child, to the parent. All time stamps are relative
+ * to sendqueue_basetime.
+ */
+
+/* Makes the root with the later time stamp the first child of the other. */
+static coap_queue_t *
+coap_queue_meld(coap_queue_t *a, coap_queue_t *b) {
+  if (!a)
+    return b;
+  if (!b)
+    return a;
+
+  if (b->t < a->t) {
+    coap_queue_t *tmp = a;
+    a = b;
+    b = tmp;
+  }
+  b->sibling = a->child;
+  if (a->child)
+    a->child->prev = b;
+  b->prev = a;
+  a->child = b;
+  return a;
+}
+
+/* Melds a list of siblings into one heap, in two passes. */
+static coap_queue_t *
+coap_queue_merge_pairs(coap_queue_t *first) {
+  coap_queue_t *pairs = NULL, *result = NULL;
+
+  /* meld pairs from left to right, collecting them in reverse order */
+  while (first) {
+    coap_queue_t *a = first, *b = first->sibling;
+    first = b ? b->sibling : NULL;
+    a->sibling = a->prev = NULL;
+    if (b)
+      b->sibling = b->prev = NULL;
+    a = coap_queue_meld(a, b);
+    a->sibling = pairs;
+    pairs = a;
+  }
+
+  /* meld the pairs from right to left */
+  while (pairs) {
+    coap_queue_t *a = pairs;
+    pairs = a->sibling;
+    a->sibling = NULL;
+    result = coap_queue_meld(result, a);
+  }
+  return result;
+}
+
+/* Removes node from the heap with the given root. */
+static void
+coap_queue_unlink(coap_queue_t **queue, coap_queue_t *node) {
+  coap_queue_t *children = coap_queue_merge_pairs(node->child);
+
+  if (node == *queue) {
+    *queue = children;
+  } else {
+    if (node->prev->child == node)
+      node->prev->child = node->sibling;
+    else
+      node->prev->sibling = node->sibling;
+    if (node->sibling)
+      node->sibling->prev = node->prev;
+    *queue = coap_queue_meld(*queue, children);
+  }
+  node->child = node->sibling = node->prev = NULL;
+}
+
+/* Returns the node following q in the heap, in pre-order. */
+static coap_queue_t *
+coap_queue_walk(coap_queue_t *q) {
+  if (q->child)
+    return q->child;
+  while (q) {
+    if (q->sibling)
+      return q->sibling;
+    /* go back over the previous siblings to the parent */
+    while (q->prev && q->prev->child != q)
+      q = q->prev;
+    q = q->prev;
+  }
+  return NULL;
+}
+
+COAP_STATIC_INLINE unsigned int
+coap_queue_hash_tid(const coap_session_t *session, coap_tid_t id) {
+  return ((uint32_t)((uintptr_t)session >> 4) * 31u + (uint16_t)id)
+         % COAP_SENDQUEUE_HASH_SIZE;
+}
+
+static unsigned int
+coap_queue_hash_token(const coap_session_t *session,
+                      const uint8_t *token, size_t token_length) {
+  /* FNV-1a, seeded with the session */
+  uint32_t hash = 2166136261u ^ (uint32_t)((uintptr_t)session >> 4);
+  size_t i;
+
+  for (i = 0; i < token_length; i++) {
+    hash ^= token[i];
+    hash *= 16777619u;
+  }
+  return hash % COAP_SENDQUEUE_HASH_SIZE;
+}
+
+COAP_STATIC_INLINE unsigned int
+coap_queue_hash_node_token(const coap_queue_t *node) {
+  if (!node->pdu)
+    return coap_queue_hash_token(node->session, NULL, 0);
+  return coap_queue_hash_token(node->session,
+                               node->pdu->token, node->pdu->token_length);
+}
+
+static void
+coap_queue_index_add(coap_context_t *ctx, coap_queue_t *node) {
+  coap_queue_t **tid_bucket =
+    &ctx->sendqueue_tid[coap_queue_hash_tid(node->session, node->id)];
+  coap_queue_t **token_bucket =
+    &ctx->sendqueue_token[coap_queue_hash_node_token(node)];
+
+  node->tid_next = *tid_bucket;
+  if (node->tid_next)
+    node->tid_next->tid_pprev = &node->tid_next;
+  node->tid_pprev = tid_bucket;
+  *tid_bucket = node;
+  node->token_next = *token_bucket;
+  if (node->token_next)
+    node->token_next->token_pprev = &node->token_next;
+  node->token_pprev = token_bucket;
+  *token_bucket = node;
+}
+
+/* Removes node from the hash tables, returns 0 if it was not indexed. */
+static int
+coap_queue_index_remove(coap_queue_t *node) {
+  if (!node->tid_pprev)
+    return 0;
+
+  *node->tid_pprev = node->tid_next;
+  if (node->tid_next)
+    node->tid_next->tid_pprev = node->tid_pprev;
+  node->tid_next = NULL;
+  node->tid_pprev = NULL;
+
+  *node->token_pprev = node->token_next;
+  if (node->token_next)
+    node->token_next->token_pprev = node->token_pprev;
+  node->token_next = NULL;
+  node->token_pprev = NULL;
+  return 1;
+}
+
+/* Takes an indexed node out of the sendqueue of its context. */
+static void
+coap_queue_remove(coap_context_t *ctx, coap_queue_t *node) {
+  if (coap_queue_index_remove(node))
+    coap_queue_unlink(&ctx->sendqueue, node);
+}
+
 unsigned int
 coap_adjust_basetime(coap_context_t *ctx, coap_tick_t now) {
   unsigned int result = 0;
   coap_tick_diff_t delta = now - ctx->sendqueue_basetime;
+  coap_queue_t *q;
 
-  if (ctx->sendqueue) {
-    /* delta < 0 means that the new time stamp is before the old. */
+  /* Moving all time stamps by the same amount, or to zero for the elements
+   * that have timed out, keeps the heap ordered. */
+  for (q = ctx->sendqueue; q; q = coap_queue_walk(q)) {
     if (delta <= 0) {
-      ctx->sendqueue->t -= delta;
+      /* delta < 0 means that the new time stamp is before the old. */
+      q->t -= delta;
+    } else if (q->t <= (coap_tick_t)delta) {
+      q->t = 0;
+      result++;
     } else {
-      /* This case is more complex: The time must be advanced forward,
-       * thus possibly leading to timed out elements at the queue's
-       * start. For every element that has timed out, its relative
-       * time is set to zero and the result counter is increased. */
-
-      coap_queue_t *q = ctx->sendqueue;
-      coap_tick_t t = 0;
-      while (q && (t + q->t < (coap_tick_t)delta)) {
-        t += q->t;
-        q->t = 0;
-        result++;
-        q = q->next;
-      }
-
-      /* finally adjust the first element that has not expired */
-      if (q) {
-        q->t = (coap_tick_t)delta - t;
-      }
+      q->t -= delta;
     }
   }
 
@@ -186,38 +341,13 @@ coap_adjust_basetime(coap_context_t *ctx, coap_tick_t now) {
 
 int
 coap_insert_node(coap_queue_t **queue, coap_queue_t *node) {
-  coap_queue_t *p, *q;
   if (!queue || !node)
     return 0;
 
-  /* set queue head if empty */
-  if (!*queue) {
-    *queue = node;
-    return 1;
-  }
-
-  /* replace queue head if PDU's time is less than head's time */
-  q = *queue;
-  if (node->t < q->t) {
-    node->next = q;
-    *queue = node;
-    q->t -= node->t;                /* make q->t relative to node->t */
-    return 1;
-  }
-
-  /* search for right place to insert */
-  do {
-    node->t -= q->t;                /* make node-> relative to q->t */
-    p = q;
-    q = q->next;
-  } while (q && q->t <= node->t);
-
-  /* insert new item */
-  if (q) {
-    q->t -= node->t;                /* make q->t relative to node->t */
-  }
-  node->next = q;
-  p->next = node;
+  node->child = node->sibling = node->prev = NULL;
+  *queue = coap_queue_meld(*queue, node);
+  if (node->session && queue == &node->session->context->sendqueue)
+    coap_queue_index_add(node->session->context, node);
   return 1;
 }
 
@@ -226,16 +356,14 @@ coap_delete_node(coap_queue_t *node) {
   if (!node)
     return 0;
 
-  coap_delete_pdu(node->pdu);
   if ( node->session ) {
     /*
      * Need to remove out of context->sendqueue as added in by coap_wait_ack()
      */
-    if (node->session->context->sendqueue) {
-      LL_DELETE(node->session->context->sendqueue, node);
-    }
+    coap_queue_remove(node->session->context, node);
     coap_session_release(node->session);
   }
+  coap_delete_pdu(node->pdu);
   coap_free_node(node);
 
   return 1;
@@ -243,11 +371,28 @@ coap_delete_node(coap_queue_t *node) {
 
 void
 coap_delete_all(coap_queue_t *queue) {
-  if (!queue)
-    return;
+  while (queue) {
+    coap_queue_t *q = queue;
+
+    /* put the children in front of the remaining siblings */
+    if (q->child) {
+      coap_queue_t *last = q->child;
+      while (last->sibling)
+        last = last->sibling;
+      last->sibling = q->sibling;
+      q->sibling = q->child;
+    }
+    queue = q->sibling;
 
-  coap_delete_all(queue->next);
-  coap_delete_node(queue);
+    if (q->session) {
+      coap_context_t *ctx = q->session->context;
+      if (ctx->sendqueue == q)
+        ctx->sendqueue = NULL;
+      coap_queue_index_remove(q);
+    }
+    q->child = q->sibling = q->prev = NULL;
+    coap_delete_node(q);
+  }
 }
 
 coap_queue_t *
@@ -282,10 +427,9 @@ coap_pop_next(coap_context_t *context) {
     return NULL;
 
   next = context->sendqueue;
-  context->sendqueue = context->sendqueue->next;
-  if (context->sendqueue) {
-    context->sendqueue->t += next->t;
-  }
+  if (next->session)
+    coap_queue_index_remove(next);
+  coap_queue_unlink(&context->sendqueue, next);
   next->next = NULL;
   return next;
 }
@@ -830,10 +974,8 @@ coap_wait_ack(coap_context_t *context, coap_session_t *session,
   /* Set timer for pdu retransmission. If this is the first element in
   * the retransmission queue, the base time is set to the current
   * time and the retransmission time is node->timeout. If there is
-  * already an entry in the sendqueue, we must check if this node is
-  * to be retransmitted earlier. Therefore, node->timeout is first
-  * normalized to the base time and then inserted into the queue with
-  * an adjusted relative time.
+  * already an entry in the sendqueue, node->timeout is normalized to
+  * the base time before the node is inserted into the queue.
   */
   coap_ticks(&now);
   if (context->sendqueue == NULL) {
@@ -1395,46 +1537,22 @@ error:
 
 int
 coap_remove_from_queue(coap_queue_t **queue, coap_session_t *session, coap_tid_t id, coap_queue_t **node) {
-  coap_queue_t *p, *q;
+  coap_queue_t *q;
 
-  if (!queue || !*queue)
+  if (!queue || !*queue || !session || queue != &session->context->sendqueue)
     return 0;
 
-  /* replace queue head if PDU's time is less than head's time */
-
-  if (session == (*queue)->session && id == (*queue)->id) { /* found transaction */
-    *node = *queue;
-    *queue = (*queue)->next;
-    if (*queue) {          /* adjust relative time of new queue head */
-      (*queue)->t += (*node)->t;
-    }
-    (*node)->next = NULL;
-    coap_log(LOG_DEBUG, "** %s: tid=%d: removed\n",
-             coap_session_str(session), id);
-    return 1;
-  }
-
-  /* search transaction to remove (only first occurence will be removed) */
-  q = *queue;
-  do {
-    p = q;
-    q = q->next;
-  } while (q && (session != q->session || id != q->id));
-
-  if (q) {                        /* found transaction */
-    p->next = q->next;
-    if (p->next) {                /* must update relative time of p->next */
-      p->next->t += q->t;
-    }
-    q->next = NULL;
-    *node = q;
-    coap_log(LOG_DEBUG, "** %s: tid=%d: removed\n",
-             coap_session_str(session), id);
-    return 1;
-  }
-
-  return 0;
+  q = coap_find_transaction(*queue, session, id);
+  if (!q)
+    return 0;
 
+  coap_queue_index_remove(q);
+  coap_queue_unlink(queue, q);
+  q->next = NULL;
+  *node = q;
+  coap_log(LOG_DEBUG, "** %s: tid=%d: removed\n",
+           coap_session_str(session), id);
+  return 1;
 }
 
 COAP_STATIC_INLINE int
@@ -1446,36 +1564,24 @@ token_match(const uint8_t *a, size_t alen,
 void
 coap_cancel_session_messages(coap_context_t *context, coap_session_t *session,
   coap_nack_reason_t reason) {
-  coap_queue_t *p, *q;
-
-  while (context->sendqueue && context->sendqueue->session == session) {
-    q = context->sendqueue;
-    context->sendqueue = q->next;
-    coap_log(LOG_DEBUG, "** %s: tid=%d: removed\n",
-             coap_session_str(session), q->id);
-    if (q->pdu->type == COAP_MESSAGE_CON && context->nack_handler)
-      context->nack_handler(context, session, q->pdu, reason, q->id);
-    coap_delete_node(q);
-  }
-
-  if (!context->sendqueue)
-    return;
-
-  p = context->sendqueue;
-  q = p->next;
-
-  while (q) {
-    if (q->session == session) {
-      p->next = q->next;
-      coap_log(LOG_DEBUG, "** %s: tid=%d: removed\n",
-               coap_session_str(session), q->id);
-      if (q->pdu->type == COAP_MESSAGE_CON && context->nack_handler)
-        context->nack_handler(context, session, q->pdu, reason, q->id);
-      coap_delete_node(q);
-      q = p->next;
-    } else {
-      p = q;
-      q = q->next;
+  coap_queue_t *q;
+  unsigned int i;
+
+  for (i = 0; i < COAP_SENDQUEUE_HASH_SIZE; i++) {
+    q = context->sendqueue_tid[i];
+    while (q) {
+      if (q->session == session) {
+        coap_queue_remove(context, q);
+        coap_log(LOG_DEBUG, "** %s: tid=%d: removed\n",
+                 coap_session_str(session), q->id);
+        if (q->pdu->type == COAP_MESSAGE_CON && context->nack_handler)
+          context->nack_handler(context, session, q->pdu, reason, q->id);
+        coap_delete_node(q);
+        /* the nack handler may have changed the bucket */
+        q = context->sendqueue_tid[i];
+      } else {
+        q = q->tid_next;
+      }
     }
   }
 }
@@ -1485,48 +1591,37 @@ coap_cancel_all_messages(coap_context_t *context, coap_session_t *session,
   const uint8_t *token, size_t token_length) {
   /* cancel all messages in sendqueue that belong to session
    * and use the specified token */
-  coap_queue_t *p, *q;
-
-  while (context->sendqueue && context->sendqueue->session == session &&
-    token_match(token, token_length,
-      context->sendqueue->pdu->token,
-      context->sendqueue->pdu->token_length)) {
-    q = context->sendqueue;
-    context->sendqueue = q->next;
-    coap_log(LOG_DEBUG, "** %s: tid=%d: removed\n",
-             coap_session_str(session), q->id);
-    coap_delete_node(q);
-  }
-
-  if (!context->sendqueue)
-    return;
+  coap_queue_t **bucket = &context->sendqueue_token[
+    coap_queue_hash_token(session, token, token_length)];
+  coap_queue_t *q = *bucket;
 
-  p = context->sendqueue;
-  q = p->next;
-
-  /* when q is not NULL, it does not match (dst, token), so we can skip it */
   while (q) {
-    if (q->session == session &&
+    if (q->session == session && q->pdu &&
       token_match(token, token_length,
         q->pdu->token, q->pdu->token_length)) {
-      p->next = q->next;
+      coap_queue_remove(context, q);
       coap_log(LOG_DEBUG, "** %s: tid=%d: removed\n",
                coap_session_str(session), q->id);
       coap_delete_node(q);
-      q = p->next;
+      q = *bucket;
     } else {
-      p = q;
-      q = q->next;
+      q = q->token_next;
     }
   }
 }
 
 coap_queue_t *
 coap_find_transaction(coap_queue_t *queue, coap_session_t *session, coap_tid_t id) {
-  while (queue && queue->session != session && queue->id != id)
-    queue = queue->next;
+  coap_queue_t *q;
+
+  if (!queue || !session)
+    return NULL;
 
-  return queue;
+  q = session->context->sendqueue_tid[coap_queue_hash_tid(session, id)];
+  while (q && (q->session != session || q->id != id))
+    q = q->tid_next;
+
+  return q;
 }
 
 coap_pdu_t *
@@ -2437,20 +2532,14 @@ static void coap_retransmittimer_execute(void *arg) {
 
   elapsed = now - ctx->sendqueue_basetime; /* that's positive for sure, and unless we haven't been called for a complete wrapping cycle, did not wrap */
 
+  /* the time stamps of all queued nodes are relative to sendqueue_basetime,
+   * which is reset by coap_wait_ack() when the queue was empty */
   nextinqueue = coap_peek_next(ctx);
-  while (nextinqueue != NULL) {
-    if (nextinqueue->t > elapsed) {
-      nextinqueue->t -= elapsed;
-      break;
-    } else {
-      elapsed -= nextinqueue->t;
-      coap_retransmit(ctx, coap_pop_next(ctx));
-      nextinqueue = coap_peek_next(ctx);
-    }
+  while (nextinqueue != NULL && nextinqueue->t <= elapsed) {
+    coap_retransmit(ctx, coap_pop_next(ctx));
+    nextinqueue = coap_peek_next(ctx);
   }
 
-  ctx->sendqueue_basetime = now;
-
   coap_retransmittimer_restart(ctx);
 }
 
@@ -27,17 +27,6 @@ static coap_tick_t timestamp[] = {
 /* nodes for testing. node[0] is left empty */
 coap_queue_t *node[5];
 
-static coap_tick_t
-add_timestamps(coap_queue_t *queue, size_t num) {
-  coap_tick_t t = 0;
-  while (queue && num--) {
-    t += queue->t;
-    queue = queue->next;
-  }
-
-  return t;
-}
-
 static void
 t_sendqueue1(void) {
   int result = coap_insert_node(&ctx->sendqueue, node[1]);
@@ -56,10 +45,10 @@ t_sendqueue2(void) {
 
   CU_ASSERT(result > 0);
   CU_ASSERT_PTR_EQUAL(ctx->sendqueue, node[1]);
-  CU_ASSERT_PTR_EQUAL(ctx->sendqueue->next, node[2]);
+  CU_ASSERT_PTR_EQUAL(ctx->sendqueue->child, node[2]);
 
   CU_ASSERT(ctx->sendqueue->t == timestamp[1]);
-  CU_ASSERT(node[2]->t == timestamp[2] - timestamp[1]);
+  CU_ASSERT(node[2]->t == timestamp[2]);
 }
 
 /* insert new node as first element in queue */
@@ -73,11 +62,9 @@ t_sendqueue3(void) {
   CU_ASSERT_PTR_EQUAL(ctx->sendqueue, node[3]);
   CU_ASSERT(node[3]->t == timestamp[3]);
 
-  CU_ASSERT_PTR_NOT_NULL(ctx->sendqueue->next);
-  CU_ASSERT_PTR_NOT_NULL(ctx->sendqueue->next->next);
-
-  CU_ASSERT(ctx->sendqueue->next->t == timestamp[1] - timestamp[3]);
-  CU_ASSERT(ctx->sendqueue->next->next->t == timestamp[2] - timestamp[1]);
+  CU_ASSERT_PTR_EQUAL(ctx->sendqueue->child, node[1]);
+  CU_ASSERT(node[1]->t == timestamp[1]);
+  CU_ASSERT(node[2]->t == timestamp[2]);
 }
 
 /* insert new node as fourth element in queue */
@@ -90,21 +77,12 @@ t_sendqueue4(void) {
   CU_ASSERT(result > 0);
 
   CU_ASSERT_PTR_EQUAL(ctx->sendqueue, node[3]);
+  CU_ASSERT_PTR_EQUAL(coap_find_transaction(ctx->sendqueue, session, 4), node[4]);
 
-  CU_ASSERT_PTR_NOT_NULL(ctx->sendqueue->next);
-  CU_ASSERT_PTR_EQUAL(ctx->sendqueue->next, node[1]);
-
-  CU_ASSERT_PTR_NOT_NULL(ctx->sendqueue->next->next);
-  CU_ASSERT_PTR_EQUAL(ctx->sendqueue->next->next, node[4]);
-
-  CU_ASSERT_PTR_NOT_NULL(ctx->sendqueue->next->next->next);
-  CU_ASSERT_PTR_EQUAL(ctx->sendqueue->next->next->next, node[2]);
-
-  CU_ASSERT(ctx->sendqueue->next->t == timestamp[1] - timestamp[3]);
-  CU_ASSERT(add_timestamps(ctx->sendqueue, 1) == timestamp[3]);
-  CU_ASSERT(add_timestamps(ctx->sendqueue, 2) == timestamp[1]);
-  CU_ASSERT(add_timestamps(ctx->sendqueue, 3) == timestamp[4]);
-  CU_ASSERT(add_timestamps(ctx->sendqueue, 4) == timestamp[2]);
+  CU_ASSERT(node[3]->t == timestamp[3]);
+  CU_ASSERT(node[1]->t == timestamp[1]);
+  CU_ASSERT(node[4]->t == timestamp[4]);
+  CU_ASSERT(node[2]->t == timestamp[2]);
 }
 
 static void
@@ -112,17 +90,7 @@ t_sendqueue5(void) {
   const coap_tick_diff_t delta1 = 20, delta2 = 130;
   unsigned int result;
   coap_tick_t now;
-
-  /* space for saving the current node timestamps */
-  static coap_tick_t times[sizeof(timestamp)/sizeof(coap_tick_t)];
-  coap_queue_t *p;
-  int i;
-
-  /* save timestamps of nodes in the sendqueue in their actual order */
-  memset(times, 0, sizeof(times));
-  for (p = ctx->sendqueue, i = 0; p; p = p->next, i++) {
-    times[i] = p->t;
-  }
+  size_t i;
 
   coap_ticks(&now);
   ctx->sendqueue_basetime = now;
@@ -134,6 +102,7 @@ t_sendqueue5(void) {
   CU_ASSERT_PTR_NOT_NULL(ctx->sendqueue);
   CU_ASSERT(ctx->sendqueue_basetime == now);
   CU_ASSERT(ctx->sendqueue->t == timestamp[3] + delta1);
+  CU_ASSERT(node[2]->t == timestamp[2] + delta1);
 
   now += delta2;
   result = coap_adjust_basetime(ctx, now);
@@ -142,15 +111,14 @@ t_sendqueue5(void) {
   CU_ASSERT_PTR_NOT_NULL(ctx->sendqueue);
   CU_ASSERT(ctx->sendqueue->t == 0);
 
-  CU_ASSERT_PTR_NOT_NULL(ctx->sendqueue->next);
-  CU_ASSERT(ctx->sendqueue->next->t == 0);
-
-  CU_ASSERT_PTR_NOT_NULL(ctx->sendqueue->next->next);
-  CU_ASSERT(ctx->sendqueue->next->next->t == delta2 - delta1 - timestamp[1]);
+  CU_ASSERT(node[3]->t == 0);
+  CU_ASSERT(node[1]->t == 0);
+  CU_ASSERT(node[4]->t == timestamp[4] + delta1 - delta2);
+  CU_ASSERT(node[2]->t == timestamp[2] + delta1 - delta2);
 
   /* restore timestamps of nodes in the sendqueue */
-  for (p = ctx->sendqueue, i = 0; p; p = p->next, i++) {
-    p->t = times[i];
+  for (i = 1; i < sizeof(node)/sizeof(coap_queue_t *); i++) {
+    node[i]->t = timestamp[i];
   }
 }
 
@@ -161,17 +129,6 @@ t_sendqueue6(void) {
   const coap_tick_diff_t delta = 20;
   coap_queue_t *tmpqueue = ctx->sendqueue;
 
-  /* space for saving the current node timestamps */
-  static coap_tick_t times[sizeof(timestamp)/sizeof(coap_tick_t)];
-  coap_queue_t *p;
-  int i;
-
-  /* save timestamps of nodes in the sendqueue in their actual order */
-  memset(times, 0, sizeof(times));
-  for (p = ctx->sendqueue, i = 0; p; p = p->next, i++) {
-    times[i] = p->t;
-  }
-
   coap_ticks(&now);
   ctx->sendqueue = NULL;
   ctx->sendqueue_basetime = now;
@@ -193,9 +150,6 @@ t_sendqueue7(void) {
   CU_ASSERT_PTR_NOT_NULL(ctx->sendqueue);
   CU_ASSERT_PTR_EQUAL(ctx->sendqueue, node[3]);
 
-  CU_ASSERT_PTR_NOT_NULL(ctx->sendqueue->next);
-  CU_ASSERT_PTR_EQUAL(ctx->sendqueue->next, node[1]);
-
   result = coap_remove_from_queue(&ctx->sendqueue, session, 3, &tmp_node);
 
   CU_ASSERT(result == 1);
@@ -222,12 +176,12 @@ t_sendqueue8(void) {
   CU_ASSERT_PTR_NOT_NULL(ctx->sendqueue);
   CU_ASSERT_PTR_EQUAL(ctx->sendqueue, node[1]);
   CU_ASSERT(ctx->sendqueue->t == timestamp[1]);
+  CU_ASSERT_PTR_NULL(coap_find_transaction(ctx->sendqueue, session, 4));
 
-  CU_ASSERT_PTR_NOT_NULL(ctx->sendqueue->next);
-  CU_ASSERT_PTR_EQUAL(ctx->sendqueue->next, node[2]);
-  CU_ASSERT(ctx->sendqueue->next->t == timestamp[2] - timestamp[1]);
+  CU_ASSERT_PTR_EQUAL(ctx->sendqueue->child, node[2]);
+  CU_ASSERT(node[2]->t == timestamp[2]);
 
-  CU_ASSERT_PTR_NULL(ctx->sendqueue->next->next);
+  CU_ASSERT_PTR_NULL(node[2]->child);
 }
 
 static void
@@ -250,7 +204,7 @@ t_sendqueue9(void) {
   CU_ASSERT(tmp_node->t == timestamp[1]);
   CU_ASSERT(ctx->sendqueue->t == timestamp[2]);
 
-  CU_ASSERT_PTR_NULL(ctx->sendqueue->next);
+  CU_ASSERT_PTR_NULL(ctx->sendqueue->child);
 }
 
 static void
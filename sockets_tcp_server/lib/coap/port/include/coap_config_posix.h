@@ -51,6 +51,7 @@ struct in6_pktinfo {
 #define HAVE_MBEDTLS
 #endif /* CONFIG_MBEDTLS_TLS_ENABLED */
 #define COAP_CONSTRAINED_STACK 1
+#define COAP_SENDQUEUE_HASH_SIZE CONFIG_COAP_SENDQUEUE_HASH_SIZE
 #define ESPIDF_VERSION
 
 #define _POSIX_TIMERS 1
@@ -0,0 +1,27 @@
+#pragma once
+// libcoap configuration for building the library on a Linux host
+
+#ifndef WITH_POSIX
+#define WITH_POSIX
+#endif
+
+#define HAVE_ARPA_INET_H
+#define HAVE_ASSERT_H
+#define HAVE_LIMITS_H
+#define HAVE_MALLOC
+#define HAVE_NETDB_H
+#define HAVE_NETINET_IN_H
+#define HAVE_STDIO_H
+#define HAVE_STRNLEN 1
+#define HAVE_STRUCT_CMSGHDR
+#define HAVE_SYS_IOCTL_H
+#define HAVE_SYS_SELECT_H
+#define HAVE_SYS_SOCKET_H
+#define HAVE_SYS_TIME_H
+#define HAVE_SYS_UIO_H
+#define HAVE_TIME_H
+#define HAVE_UNISTD_H
+
+#define PACKAGE_NAME "libcoap-host"
+#define PACKAGE_VERSION "?"
+#define PACKAGE_STRING PACKAGE_NAME PACKAGE_VERSION
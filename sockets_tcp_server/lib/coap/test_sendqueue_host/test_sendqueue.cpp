@@ -0,0 +1,520 @@
+#include "catch.hpp"
+
+extern "C" {
+#include "coap_config.h"
+#include "coap.h"
+}
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <random>
+#include <set>
+#include <vector>
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+static coap_address_t loopback_address(uint16_t port)
+{
+    coap_address_t addr;
+    coap_address_init(&addr);
+    addr.size = sizeof(struct sockaddr_in);
+    addr.addr.sin.sin_family = AF_INET;
+    addr.addr.sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.addr.sin.sin_port = htons(port);
+    return addr;
+}
+
+// Context with client sessions whose transactions are queued directly, without sending anything
+struct QueueFixture {
+    coap_context_t* ctx;
+    std::vector<coap_session_t*> sessions;
+    std::mt19937 gen;
+    int nacks;
+
+    explicit QueueFixture(size_t session_count = 8) : gen(50), nacks(0)
+    {
+        coap_startup();
+        coap_set_log_level(LOG_ERR);
+        ctx = coap_new_context(NULL);
+        REQUIRE(ctx != NULL);
+        ctx->app = this;
+        coap_register_nack_handler(ctx, [](coap_context_t* ctx, coap_session_t*, coap_pdu_t*, coap_nack_reason_t, const coap_tid_t) {
+            static_cast<QueueFixture*>(ctx->app)->nacks++;
+        });
+        coap_address_t dst = loopback_address(9);
+        for (size_t i = 0; i < session_count; i++) {
+            coap_session_t* session = coap_new_client_session(ctx, NULL, &dst, COAP_PROTO_UDP);
+            REQUIRE(session != NULL);
+            sessions.push_back(session);
+        }
+    }
+
+    ~QueueFixture()
+    {
+        coap_free_context(ctx);
+    }
+
+    coap_queue_t* queue(coap_session_t* session, coap_tid_t tid, unsigned int timeout, const std::vector<uint8_t>& token)
+    {
+        coap_pdu_t* pdu = coap_pdu_init(COAP_MESSAGE_CON, COAP_REQUEST_GET, tid, 64);
+        REQUIRE(pdu != NULL);
+        REQUIRE(coap_add_token(pdu, token.size(), token.data()));
+        coap_queue_t* node = coap_new_node();
+        REQUIRE(node != NULL);
+        node->id = tid;
+        node->pdu = pdu;
+        node->timeout = timeout;
+        REQUIRE(coap_wait_ack(ctx, session, node) == tid);
+        return node;
+    }
+
+    coap_queue_t* queue(coap_session_t* session, coap_tid_t tid, unsigned int timeout)
+    {
+        return queue(session, tid, timeout, token_of(tid));
+    }
+
+    static std::vector<uint8_t> token_of(coap_tid_t tid)
+    {
+        return { (uint8_t)(tid >> 8), (uint8_t)tid, 0x5a };
+    }
+
+    void ack(coap_session_t* session, coap_tid_t tid)
+    {
+        coap_pdu_t* ack = coap_pdu_init(COAP_MESSAGE_ACK, 0, tid, 0);
+        REQUIRE(ack != NULL);
+        coap_dispatch(ctx, session, ack);
+        coap_delete_pdu(ack);
+    }
+
+    // Pops and frees all queued transactions, checking they come out in deadline order
+    size_t drain()
+    {
+        size_t count = 0;
+        coap_tick_t last = 0;
+        coap_queue_t* node;
+        while ((node = coap_pop_next(ctx)) != NULL) {
+            CHECK(node->t >= last);
+            last = node->t;
+            coap_delete_node(node);
+            count++;
+        }
+        return count;
+    }
+};
+
+TEST_CASE("retransmissions come out of the queue in deadline order", "[sendqueue]")
+{
+    QueueFixture f;
+    std::vector<std::pair<coap_session_t*, coap_tid_t>> queued;
+    for (coap_tid_t tid = 1; tid <= 3000; tid++) {
+        coap_session_t* session = f.sessions[f.gen() % f.sessions.size()];
+        f.queue(session, tid, 1000 + f.gen() % 2000);
+        queued.push_back({ session, tid });
+    }
+    CHECK(coap_peek_next(f.ctx) == f.ctx->sendqueue);
+
+    // Remove a third of them, in random order
+    std::shuffle(queued.begin(), queued.end(), f.gen);
+    for (size_t i = 0; i < 1000; i++) {
+        coap_queue_t* node = NULL;
+        REQUIRE(coap_remove_from_queue(&f.ctx->sendqueue, queued[i].first, queued[i].second, &node));
+        REQUIRE(node != NULL);
+        CHECK(node->id == queued[i].second);
+        CHECK(node->session == queued[i].first);
+        coap_delete_node(node);
+    }
+    CHECK(f.drain() == 2000);
+    CHECK(f.ctx->sendqueue == NULL);
+    CHECK(coap_can_exit(f.ctx));
+}
+
+TEST_CASE("retransmitted transactions are queued again after the others", "[sendqueue]")
+{
+    QueueFixture f(1);
+    for (coap_tid_t tid = 1; tid <= 100; tid++) {
+        f.queue(f.sessions[0], tid, 2000 + tid);
+    }
+    // Requeue the first half with a later deadline, as coap_retransmit() does
+    for (int i = 0; i < 50; i++) {
+        coap_queue_t* node = coap_pop_next(f.ctx);
+        REQUIRE(node != NULL);
+        CHECK(node->id == i + 1);
+        node->t += 4000;
+        REQUIRE(coap_insert_node(&f.ctx->sendqueue, node));
+    }
+    std::vector<coap_tid_t> order;
+    coap_queue_t* node;
+    while ((node = coap_pop_next(f.ctx)) != NULL) {
+        order.push_back(node->id);
+        coap_delete_node(node);
+    }
+    REQUIRE(order.size() == 100);
+    for (int i = 0; i < 100; i++) {
+        CHECK(order[i] == ((i + 50) % 100) + 1);
+    }
+}
+
+TEST_CASE("transactions are found by session and message id", "[sendqueue]")
+{
+    QueueFixture f(2);
+    coap_queue_t* a = f.queue(f.sessions[0], 7, 2000);
+    coap_queue_t* b = f.queue(f.sessions[1], 7, 1000);
+    coap_queue_t* c = f.queue(f.sessions[1], 8, 3000);
+
+    CHECK(coap_find_transaction(f.ctx->sendqueue, f.sessions[0], 7) == a);
+    CHECK(coap_find_transaction(f.ctx->sendqueue, f.sessions[1], 7) == b);
+    CHECK(coap_find_transaction(f.ctx->sendqueue, f.sessions[1], 8) == c);
+    CHECK(coap_find_transaction(f.ctx->sendqueue, f.sessions[0], 8) == NULL);
+    CHECK(coap_peek_next(f.ctx) == b);
+
+    coap_queue_t* removed = NULL;
+    CHECK_FALSE(coap_remove_from_queue(&f.ctx->sendqueue, f.sessions[0], 8, &removed));
+    REQUIRE(coap_remove_from_queue(&f.ctx->sendqueue, f.sessions[1], 7, &removed));
+    CHECK(removed == b);
+    coap_delete_node(removed);
+    CHECK(coap_find_transaction(f.ctx->sendqueue, f.sessions[1], 7) == NULL);
+    CHECK(coap_peek_next(f.ctx) == a);
+    CHECK(f.drain() == 2);
+}
+
+TEST_CASE("ACKs remove their transaction from the queue", "[sendqueue]")
+{
+    QueueFixture f;
+    std::vector<std::pair<coap_session_t*, coap_tid_t>> queued;
+    for (coap_tid_t tid = 100; tid < 600; tid++) {
+        coap_session_t* session = f.sessions[tid % f.sessions.size()];
+        f.queue(session, tid, 1000 + f.gen() % 2000);
+        queued.push_back({ session, tid });
+    }
+    std::shuffle(queued.begin(), queued.end(), f.gen);
+    for (size_t i = 0; i < 400; i++) {
+        f.ack(queued[i].first, queued[i].second);
+        CHECK(coap_find_transaction(f.ctx->sendqueue, queued[i].first, queued[i].second) == NULL);
+    }
+    // An ACK from another session does not match
+    f.ack(f.sessions[(queued[400].first == f.sessions[0]) ? 1 : 0], queued[400].second);
+    for (size_t i = 400; i < queued.size(); i++) {
+        CHECK(coap_find_transaction(f.ctx->sendqueue, queued[i].first, queued[i].second) != NULL);
+    }
+    CHECK(f.drain() == 100);
+    CHECK(f.nacks == 0);
+}
+
+TEST_CASE("messages are cancelled by session and token", "[sendqueue]")
+{
+    QueueFixture f(2);
+    const std::vector<uint8_t> token = { 1, 2, 3, 4 };
+    const std::vector<uint8_t> other = { 1, 2, 3 };
+    for (coap_tid_t tid = 1; tid <= 10; tid++) {
+        f.queue(f.sessions[0], tid, 1000 + tid, token);
+        f.queue(f.sessions[1], tid, 1000 + tid, token);
+        f.queue(f.sessions[0], 100 + tid, 1000 + tid, other);
+    }
+    coap_cancel_all_messages(f.ctx, f.sessions[0], token.data(), token.size());
+    for (coap_tid_t tid = 1; tid <= 10; tid++) {
+        CHECK(coap_find_transaction(f.ctx->sendqueue, f.sessions[0], tid) == NULL);
+        CHECK(coap_find_transaction(f.ctx->sendqueue, f.sessions[1], tid) != NULL);
+        CHECK(coap_find_transaction(f.ctx->sendqueue, f.sessions[0], 100 + tid) != NULL);
+    }
+    CHECK(f.nacks == 0);
+    CHECK(f.drain() == 20);
+}
+
+TEST_CASE("cancelling the messages of a session reports them as not delivered", "[sendqueue]")
+{
+    QueueFixture f(3);
+    for (coap_tid_t tid = 1; tid <= 300; tid++) {
+        f.queue(f.sessions[tid % 3], tid, 1000 + f.gen() % 2000);
+    }
+    coap_cancel_session_messages(f.ctx, f.sessions[1], COAP_NACK_NOT_DELIVERABLE);
+    CHECK(f.nacks == 100);
+    for (coap_tid_t tid = 1; tid <= 300; tid++) {
+        CHECK((coap_find_transaction(f.ctx->sendqueue, f.sessions[tid % 3], tid) == NULL) == (tid % 3 == 1));
+    }
+    CHECK(f.drain() == 200);
+}
+
+TEST_CASE("deleting a queued node takes it out of the queue", "[sendqueue]")
+{
+    QueueFixture f(1);
+    std::vector<coap_queue_t*> nodes;
+    for (coap_tid_t tid = 1; tid <= 50; tid++) {
+        nodes.push_back(f.queue(f.sessions[0], tid, 1000 + f.gen() % 2000));
+    }
+    for (size_t i = 0; i < nodes.size(); i += 2) {
+        coap_delete_node(nodes[i]);
+    }
+    for (coap_tid_t tid = 1; tid <= 50; tid++) {
+        CHECK((coap_find_transaction(f.ctx->sendqueue, f.sessions[0], tid) == NULL) == (tid % 2 == 1));
+    }
+    CHECK(f.drain() == 25);
+}
+
+TEST_CASE("coap_adjust_basetime() rebases the queue", "[sendqueue]")
+{
+    QueueFixture f(1);
+    coap_queue_t* a = f.queue(f.sessions[0], 1, 100);
+    coap_queue_t* b = f.queue(f.sessions[0], 2, 300);
+    coap_queue_t* c = f.queue(f.sessions[0], 3, 200);
+    coap_tick_t base = f.ctx->sendqueue_basetime;
+    coap_tick_t ta = a->t, tb = b->t, tc = c->t;
+
+    // Moving back in time delays everything
+    CHECK(coap_adjust_basetime(f.ctx, base - 10) == 0);
+    CHECK(f.ctx->sendqueue_basetime == base - 10);
+    CHECK(a->t == ta + 10);
+    CHECK(b->t == tb + 10);
+    CHECK(c->t == tc + 10);
+
+    // Moving forward times out the transactions now due
+    CHECK(coap_adjust_basetime(f.ctx, base - 10 + tc + 10) == 2);
+    CHECK(a->t == 0);
+    CHECK(c->t == 0);
+    CHECK(b->t == tb - tc);
+    coap_queue_t* first = coap_pop_next(f.ctx);
+    CHECK(first != b);
+    coap_delete_node(first);
+    CHECK(f.drain() == 2);
+}
+
+// Peer on the loopback interface which ACKs CON requests, ignoring the first transmissions of each message
+struct LossyPeer {
+    int sock;
+    uint16_t port;
+    int ignore;
+    std::map<uint16_t, int> transmissions;
+
+    explicit LossyPeer(int ignore) : ignore(ignore)
+    {
+        sock = socket(AF_INET, SOCK_DGRAM, 0);
+        coap_address_t addr = loopback_address(0);
+        REQUIRE(bind(sock, &addr.addr.sa, addr.size) == 0);
+        REQUIRE(getsockname(sock, &addr.addr.sa, &addr.size) == 0);
+        port = ntohs(addr.addr.sin.sin_port);
+    }
+
+    ~LossyPeer()
+    {
+        close(sock);
+    }
+
+    void poll()
+    {
+        uint8_t buf[256];
+        struct sockaddr_in from;
+        socklen_t len = sizeof(from);
+        ssize_t ret;
+        while ((ret = recvfrom(sock, buf, sizeof(buf), MSG_DONTWAIT, (struct sockaddr*)&from, &len)) >= 4) {
+            uint16_t mid = (buf[2] << 8) | buf[3];
+            if (++transmissions[mid] > ignore) {
+                const uint8_t ack[4] = { 0x60, 0x00, buf[2], buf[3] };
+                sendto(sock, ack, sizeof(ack), 0, (struct sockaddr*)&from, len);
+            }
+            len = sizeof(from);
+        }
+    }
+};
+
+static coap_pdu_t* new_get(coap_session_t* session)
+{
+    coap_pdu_t* pdu = coap_new_pdu(session);
+    REQUIRE(pdu != NULL);
+    pdu->type = COAP_MESSAGE_CON;
+    pdu->tid = coap_new_message_id(session);
+    pdu->code = COAP_REQUEST_GET;
+    const uint8_t token[2] = { (uint8_t)(pdu->tid >> 8), (uint8_t)pdu->tid };
+    coap_add_token(pdu, sizeof(token), token);
+    coap_add_option(pdu, COAP_OPTION_URI_PATH, 4, (const uint8_t*)"time");
+    return pdu;
+}
+
+TEST_CASE("CON requests are retransmitted until they are acknowledged", "[sendqueue]")
+{
+    const int ignore = GENERATE(1, 5);
+    const size_t session_count = 40;
+    QueueFixture f(0);
+    LossyPeer peer(ignore);
+    coap_address_t dst = loopback_address(peer.port);
+    const coap_fixed_point_t ack_timeout = { 0, 20 };
+
+    for (size_t i = 0; i < session_count; i++) {
+        coap_session_t* session = coap_new_client_session(f.ctx, NULL, &dst, COAP_PROTO_UDP);
+        REQUIRE(session != NULL);
+        session->ack_timeout = ack_timeout;     // Below the 1 s accepted by coap_session_set_ack_timeout()
+        coap_session_set_max_retransmit(session, 3);
+        f.sessions.push_back(session);
+        REQUIRE(coap_send(session, new_get(session)) != COAP_INVALID_TID);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    while (f.ctx->sendqueue && (elapsed_ns(start) < 5e9)) {
+        peer.poll();
+        coap_run_once(f.ctx, 5);
+    }
+    CHECK(f.ctx->sendqueue == NULL);
+    REQUIRE(peer.transmissions.size() == session_count);
+    for (auto& mid : peer.transmissions) {
+        // Given up after the 3 retransmissions when the peer ignores more
+        CHECK(mid.second == std::min(ignore + 1, 4));
+    }
+    CHECK(f.nacks == ((ignore > 3) ? (int)session_count : 0));
+}
+
+TEST_CASE("retransmission queue throughput", "[sendqueue][benchmark]")
+{
+    printf("Retransmission queue, ns per operation:\n");
+    printf("%8s %10s %10s %10s %10s\n", "queued", "wait_ack", "retransmit", "ack", "cancel");
+    for (int count : { 100, 1000, 10000 }) {
+        QueueFixture f;
+        std::vector<std::pair<coap_session_t*, coap_tid_t>> queued;
+        for (int i = 0; i < count; i++) {
+            queued.push_back({ f.sessions[i % f.sessions.size()], (coap_tid_t)(i + 1) });
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        for (auto& q : queued) {
+            f.queue(q.first, q.second, 2000 + f.gen() % 1000);
+        }
+        double wait_ack = elapsed_ns(start) / count;
+
+        // Requeue each transaction with a later deadline, as coap_retransmit() does
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; i++) {
+            coap_queue_t* node = coap_pop_next(f.ctx);
+            node->t += 4000 + f.gen() % 2000;
+            coap_insert_node(&f.ctx->sendqueue, node);
+        }
+        double retransmit = elapsed_ns(start) / count;
+
+        std::shuffle(queued.begin(), queued.end(), f.gen);
+        start = std::chrono::steady_clock::now();
+        for (auto& q : queued) {
+            f.ack(q.first, q.second);
+        }
+        double ack = elapsed_ns(start) / count;
+        REQUIRE(f.ctx->sendqueue == NULL);
+
+        for (auto& q : queued) {
+            f.queue(q.first, q.second, 2000 + f.gen() % 1000);
+        }
+        std::shuffle(queued.begin(), queued.end(), f.gen);
+        start = std::chrono::steady_clock::now();
+        for (auto& q : queued) {
+            std::vector<uint8_t> token = QueueFixture::token_of(q.second);
+            coap_cancel_all_messages(f.ctx, q.first, token.data(), token.size());
+        }
+        double cancel = elapsed_ns(start) / count;
+        REQUIRE(f.ctx->sendqueue == NULL);
+
+        printf("%8d %10.0f %10.0f %10.0f %10.0f\n", count, wait_ack, retransmit, ack, cancel);
+    }
+}
+
+// coap_run_once() for contexts with more than the 64 sockets it can wait for
+static void run_once(coap_context_t* ctx, unsigned int timeout_ms)
+{
+    coap_socket_t* sockets[1000];
+    unsigned int count = 0;
+    coap_tick_t now;
+    coap_ticks(&now);
+    unsigned int timeout = coap_write(ctx, sockets, sizeof(sockets) / sizeof(sockets[0]), &count, now);
+    if (timeout == 0 || timeout_ms < timeout) {
+        timeout = timeout_ms;
+    }
+    fd_set readfds;
+    FD_ZERO(&readfds);
+    int nfds = 0;
+    for (unsigned int i = 0; i < count; i++) {
+        if (sockets[i]->flags & COAP_SOCKET_WANT_READ) {
+            FD_SET(sockets[i]->fd, &readfds);
+            nfds = std::max(nfds, sockets[i]->fd + 1);
+        }
+    }
+    struct timeval tv = { 0, (suseconds_t)timeout * 1000 };
+    if (select(nfds, &readfds, NULL, NULL, &tv) > 0) {
+        for (unsigned int i = 0; i < count; i++) {
+            if ((sockets[i]->flags & COAP_SOCKET_WANT_READ) && FD_ISSET(sockets[i]->fd, &readfds)) {
+                sockets[i]->flags |= COAP_SOCKET_CAN_READ;
+            }
+        }
+    }
+    coap_ticks(&now);
+    coap_read(ctx, now);
+}
+
+// Client and server set up as in examples/client.c and examples/coap-server.c, with one CON
+// request outstanding per client session until the server gets to respond to it
+TEST_CASE("client and server with many outstanding requests", "[sendqueue][benchmark]")
+{
+    coap_startup();
+    coap_set_log_level(LOG_ERR);
+    coap_context_t* server = coap_new_context(NULL);
+    REQUIRE(server != NULL);
+    coap_address_t listen = loopback_address(0);
+    coap_endpoint_t* ep = coap_new_endpoint(server, &listen, COAP_PROTO_UDP);
+    REQUIRE(ep != NULL);
+    coap_resource_t* resource = coap_resource_init(coap_new_str_const((const uint8_t*)"time", 4),
+                                                    COAP_RESOURCE_FLAGS_RELEASE_URI);
+    coap_register_handler(resource, COAP_REQUEST_GET,
+                          [](coap_context_t*, coap_resource_t*, coap_session_t*, coap_pdu_t*,
+                             coap_binary_t*, coap_string_t*, coap_pdu_t* response) {
+        response->code = COAP_RESPONSE_CODE(205);
+        coap_add_data(response, 5, (const uint8_t*)"12:00");
+    });
+    coap_add_resource(server, resource);
+
+    static int responses;
+    coap_context_t* client = coap_new_context(NULL);
+    REQUIRE(client != NULL);
+    coap_register_response_handler(client, [](coap_context_t*, coap_session_t*, coap_pdu_t*,
+                                              coap_pdu_t* received, const coap_tid_t) {
+        if (received->code == COAP_RESPONSE_CODE(205)) {
+            responses++;
+        }
+    });
+    coap_address_t dst = loopback_address(ntohs(ep->bind_addr.addr.sin.sin_port));
+    const size_t session_count = 400;
+    std::vector<coap_session_t*> sessions;
+    for (size_t i = 0; i < session_count; i++) {
+        coap_session_t* session = coap_new_client_session(client, NULL, &dst, COAP_PROTO_UDP);
+        REQUIRE(session != NULL);
+        sessions.push_back(session);
+    }
+
+    const int rounds = 10;
+    responses = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (size_t i = 0; i < session_count; i++) {
+            REQUIRE(coap_send(sessions[i], new_get(sessions[i])) != COAP_INVALID_TID);
+            // Let the server read the requests before its socket buffer overflows. It reads one
+            // request per call and its responses wait in the client sockets until all are sent.
+            if (i % 50 == 49) {
+                for (int j = 0; j < 50; j++) {
+                    run_once(server, 0);
+                }
+            }
+        }
+        while ((responses < (round + 1) * (int)session_count) && (elapsed_ns(start) < 20e9)) {
+            run_once(server, 0);
+            run_once(client, 0);
+        }
+    }
+    double total = elapsed_ns(start);
+    CHECK(responses == rounds * (int)session_count);
+    CHECK(client->sendqueue == NULL);
+    printf("%d requests over %u sessions: %.1f us per request\n",
+           responses, (unsigned)session_count, total / responses / 1000);
+
+    coap_free_context(client);
+    coap_free_context(server);
+}
@@ -7,6 +7,9 @@ COMPONENT_ADD_INCLUDEDIRS := . private_include
 
 ifneq ($(CONFIG_ESP_TLS_USING_MBEDTLS), )
 COMPONENT_OBJS += esp_tls_mbedtls.o
+ifneq ($(CONFIG_ESP_TLS_CLIENT_SESSION_CACHE), )
+COMPONENT_OBJS += esp_tls_client_session_cache.o
+endif
 endif
 
 ifneq ($(CONFIG_ESP_TLS_USING_WOLFSSL), )
@@ -28,6 +28,9 @@ static const char *TAG = "esp-tls";
 
 #ifdef CONFIG_ESP_TLS_USING_MBEDTLS
 #include "esp_tls_mbedtls.h"
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+#include "esp_tls_client_session_cache.h"
+#endif
 #elif CONFIG_ESP_TLS_USING_WOLFSSL
 #include "esp_tls_wolfssl.h"
 #endif
@@ -299,13 +302,29 @@ static int esp_tls_low_level_conn(const char *hostname, int hostlen, int port, c
             tls->conn_state = ESP_TLS_FAIL;
             return -1;
         }
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+        esp_tls_client_session_cache_load(hostname, hostlen, port, cfg, tls);
+#endif
         tls->read = _esp_tls_read;
         tls->write = _esp_tls_write;
         tls->conn_state = ESP_TLS_HANDSHAKE;
     /* falls through */
     case ESP_TLS_HANDSHAKE:
         ESP_LOGD(TAG, "handshake in progress...");
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+        {
+            int ret = esp_tls_handshake(tls, cfg);
+            if (ret == 1) {
+                esp_tls_client_session_cache_save(hostname, hostlen, port, cfg, tls);
+            } else if (ret == -1) {
+                /* Do not keep offering a session the server may have rejected */
+                esp_tls_client_session_cache_remove(hostname, hostlen, port, cfg);
+            }
+            return ret;
+        }
+#else
         return esp_tls_handshake(tls, cfg);
+#endif
         break;
     case ESP_TLS_FAIL:
         ESP_LOGE(TAG, "failed to open a new connection");;
@@ -504,3 +523,10 @@ void esp_tls_free_global_ca_store(void)
 {
     return _esp_tls_free_global_ca_store();
 }
+
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+void esp_tls_free_client_session_cache(void)
+{
+    esp_tls_client_session_cache_clear();
+}
+#endif /* CONFIG_ESP_TLS_CLIENT_SESSION_CACHE */
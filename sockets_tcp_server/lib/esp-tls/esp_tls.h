@@ -613,6 +613,18 @@ int esp_tls_server_session_create(esp_tls_cfg_server_t *cfg, int sockfd, esp_tls
 void esp_tls_server_session_delete(esp_tls_t *tls);
 #endif /* ! CONFIG_ESP_TLS_SERVER */
 
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+/**
+ * @brief      Free the client session cache.
+ *
+ * Sessions of completed client handshakes are cached per host and port and offered
+ * on the next connection to the same server (see ESP_TLS_CLIENT_SESSION_CACHE).
+ * This function drops all the cached sessions, so that subsequent connections
+ * perform a full handshake, e.g. after the trusted CA certificates were changed.
+ */
+void esp_tls_free_client_session_cache(void);
+#endif /* CONFIG_ESP_TLS_CLIENT_SESSION_CACHE */
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,214 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+#include <stdlib.h>
+#include <sys/lock.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_tls_client_session_cache.h"
+#include "esp_log.h"
+
+static const char *TAG = "esp-tls-session-cache";
+
+/* The cache is process wide: every esp-tls client (esp_http_client, the MQTT and
+   websocket transports, ...) shares it, keyed by host:port and by the part of the
+   configuration that decides how the server is verified. A resumed session skips the
+   certificate and CN checks, so a connection must never resume a session set up with
+   a laxer configuration. A client does not need to know about the cache, the session
+   is offered on connect and refreshed on every successful handshake. */
+typedef struct {
+    char *host;                     /*!< Host name, NULL if the slot is free */
+    int port;                       /*!< Port of the server */
+    uint32_t config_id;             /*!< Hash of the verification settings of the connection */
+    TickType_t stored_at;           /*!< Tick count when the session was saved */
+    TickType_t lifetime;            /*!< Validity of the session in ticks */
+    mbedtls_ssl_session session;    /*!< Session ID, master secret and session ticket (if any) */
+} session_cache_entry_t;
+
+static session_cache_entry_t s_cache[CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_SIZE];
+static _lock_t s_cache_lock;
+
+static bool entry_expired(const session_cache_entry_t *entry, TickType_t now)
+{
+    return (now - entry->stored_at) >= entry->lifetime;
+}
+
+static void entry_free(session_cache_entry_t *entry)
+{
+    free(entry->host);
+    entry->host = NULL;
+    mbedtls_ssl_session_free(&entry->session);
+}
+
+static uint32_t hash_bytes(uint32_t hash, const void *data, size_t len)
+{
+    // FNV-1a, with the length first so that a missing buffer and an empty one differ
+    const uint8_t *bytes = data;
+    hash = (hash ^ (uint32_t)(data ? len + 1 : 0)) * 16777619;
+    for (size_t i = 0; data && i < len; i++) {
+        hash = (hash ^ bytes[i]) * 16777619;
+    }
+    return hash;
+}
+
+static uint32_t hash_string(uint32_t hash, const char *str)
+{
+    return hash_bytes(hash, str, str ? strlen(str) : 0);
+}
+
+static uint32_t config_id(const esp_tls_cfg_t *cfg)
+{
+    uint32_t hash = 2166136261;
+    if (cfg == NULL) {
+        return hash;
+    }
+    hash = hash_bytes(hash, cfg->use_global_ca_store ? NULL : cfg->cacert_buf, cfg->cacert_bytes);
+    hash = hash_bytes(hash, cfg->clientcert_buf, cfg->clientcert_bytes);
+    hash = hash_bytes(hash, cfg->clientkey_buf, cfg->clientkey_bytes);
+    hash = hash_string(hash, cfg->common_name);
+    if (cfg->psk_hint_key) {
+        hash = hash_string(hash, cfg->psk_hint_key->hint);
+        hash = hash_bytes(hash, cfg->psk_hint_key->key, cfg->psk_hint_key->key_size);
+    } else {
+        hash = hash_bytes(hash, NULL, 0);
+    }
+    hash = (hash ^ (cfg->use_global_ca_store | cfg->skip_common_name << 1 |
+                    (cfg->crt_bundle_attach != NULL) << 2)) * 16777619;
+    return hash;
+}
+
+static session_cache_entry_t *entry_find(const char *hostname, size_t hostlen, int port, uint32_t id)
+{
+    for (int i = 0; i < CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_SIZE; i++) {
+        session_cache_entry_t *entry = &s_cache[i];
+        if (entry->host && entry->port == port && entry->config_id == id &&
+            strncasecmp(entry->host, hostname, hostlen) == 0 && entry->host[hostlen] == '\0') {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static session_cache_entry_t *entry_get_free(TickType_t now)
+{
+    session_cache_entry_t *oldest = &s_cache[0];
+    for (int i = 0; i < CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_SIZE; i++) {
+        session_cache_entry_t *entry = &s_cache[i];
+        if (entry->host == NULL) {
+            return entry;
+        }
+        if (entry_expired(entry, now)) {
+            entry_free(entry);
+            return entry;
+        }
+        if ((now - entry->stored_at) > (now - oldest->stored_at)) {
+            oldest = entry;
+        }
+    }
+    ESP_LOGD(TAG, "Evicting session for %s:%d", oldest->host, oldest->port);
+    entry_free(oldest);
+    return oldest;
+}
+
+static TickType_t session_lifetime(const mbedtls_ssl_session *session)
+{
+    uint32_t lifetime_s = CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_TIMEOUT;
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+    /* The server tells how long it keeps accepting the ticket, there is no point in holding it longer */
+    if (session->ticket != NULL && session->ticket_lifetime != 0 && session->ticket_lifetime < lifetime_s) {
+        lifetime_s = session->ticket_lifetime;
+    }
+#endif
+    return pdMS_TO_TICKS(lifetime_s * 1000ULL);
+}
+
+esp_err_t esp_tls_client_session_cache_load(const char *hostname, size_t hostlen, int port,
+                                            const esp_tls_cfg_t *cfg, esp_tls_t *tls)
+{
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    _lock_acquire(&s_cache_lock);
+    session_cache_entry_t *entry = entry_find(hostname, hostlen, port, config_id(cfg));
+    if (entry) {
+        if (entry_expired(entry, xTaskGetTickCount())) {
+            ESP_LOGD(TAG, "Session for %s:%d expired", entry->host, port);
+            entry_free(entry);
+        } else {
+            int ret = mbedtls_ssl_set_session(&tls->ssl, &entry->session);
+            if (ret == 0) {
+                ESP_LOGD(TAG, "Resuming session for %s:%d", entry->host, port);
+                err = ESP_OK;
+            } else {
+                ESP_LOGW(TAG, "mbedtls_ssl_set_session returned -0x%x", -ret);
+                err = ESP_FAIL;
+            }
+        }
+    }
+    _lock_release(&s_cache_lock);
+    return err;
+}
+
+esp_err_t esp_tls_client_session_cache_save(const char *hostname, size_t hostlen, int port,
+                                            const esp_tls_cfg_t *cfg, const esp_tls_t *tls)
+{
+    esp_err_t err = ESP_OK;
+    TickType_t now = xTaskGetTickCount();
+    _lock_acquire(&s_cache_lock);
+    session_cache_entry_t *entry = entry_find(hostname, hostlen, port, config_id(cfg));
+    if (entry == NULL) {
+        entry = entry_get_free(now);
+        entry->host = strndup(hostname, hostlen);
+        if (entry->host == NULL) {
+            err = ESP_ERR_NO_MEM;
+            goto exit;
+        }
+        entry->port = port;
+        entry->config_id = config_id(cfg);
+        mbedtls_ssl_session_init(&entry->session);
+    }
+    /* mbedtls_ssl_get_session() releases the previous session of the entry before copying */
+    int ret = mbedtls_ssl_get_session(&tls->ssl, &entry->session);
+    if (ret != 0) {
+        ESP_LOGW(TAG, "mbedtls_ssl_get_session returned -0x%x", -ret);
+        entry_free(entry);
+        err = ESP_FAIL;
+        goto exit;
+    }
+    entry->stored_at = now;
+    entry->lifetime = session_lifetime(&entry->session);
+exit:
+    _lock_release(&s_cache_lock);
+    return err;
+}
+
+void esp_tls_client_session_cache_remove(const char *hostname, size_t hostlen, int port, const esp_tls_cfg_t *cfg)
+{
+    _lock_acquire(&s_cache_lock);
+    session_cache_entry_t *entry = entry_find(hostname, hostlen, port, config_id(cfg));
+    if (entry) {
+        entry_free(entry);
+    }
+    _lock_release(&s_cache_lock);
+}
+
+void esp_tls_client_session_cache_clear(void)
+{
+    _lock_acquire(&s_cache_lock);
+    for (int i = 0; i < CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_SIZE; i++) {
+        if (s_cache[i].host) {
+            entry_free(&s_cache[i]);
+        }
+    }
+    _lock_release(&s_cache_lock);
+}
@@ -0,0 +1,49 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include "esp_tls.h"
+
+/**
+ * Internal API to resume a previously cached session for host:port
+ *
+ * Looks up a non-expired session saved for the given host and port, by a connection
+ * with the same CA certificate, client certificate and key, common name check and
+ * PSK as `cfg`, and loads
+ * it into the (already set up) ssl context of `tls`, so that the following
+ * handshake offers the session ID and/or session ticket to the server.
+ *
+ * @return ESP_OK if a session was loaded, ESP_ERR_NOT_FOUND if there was none
+ */
+esp_err_t esp_tls_client_session_cache_load(const char *hostname, size_t hostlen, int port,
+                                            const esp_tls_cfg_t *cfg, esp_tls_t *tls);
+
+/**
+ * Internal API to save the session of a completed client handshake for host:port
+ *
+ * Replaces any entry stored for the same host, port and verification settings. When the cache is full,
+ * an expired entry or else the least recently stored one is evicted.
+ */
+esp_err_t esp_tls_client_session_cache_save(const char *hostname, size_t hostlen, int port,
+                                            const esp_tls_cfg_t *cfg, const esp_tls_t *tls);
+
+/**
+ * Internal API to drop the session cached for host:port, e.g. after a failed handshake
+ */
+void esp_tls_client_session_cache_remove(const char *hostname, size_t hostlen, int port, const esp_tls_cfg_t *cfg);
+
+/**
+ * Internal API to free all the cached sessions
+ */
+void esp_tls_client_session_cache_clear(void);
@@ -0,0 +1,102 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdint.h>
+#include "esp_crc.h"
+#include "sdkconfig.h"
+
+#if CONFIG_ESP_CRC_SLICE_BY_8
+#define ESP_CRC_SLICES 8
+#elif CONFIG_ESP_CRC_SLICE_BY_4
+#define ESP_CRC_SLICES 4
+#else
+#define ESP_CRC_SLICES 1
+#endif
+
+/*
+ * Table k of each CRC holds the CRC of byte i followed by k zero bytes, so
+ * the contribution of every byte of a block can be looked up independently
+ * and the lookups combined with XOR ("slicing"). Only the tables used by the
+ * configured slice count are compiled in.
+ */
+#include "crc_tables.h"
+
+uint16_t esp_crc16_modbus(uint16_t crc, const void *data, size_t size)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    const uint16_t (*t)[256] = s_crc16_modbus_table;
+
+#if ESP_CRC_SLICES == 8
+    for (; size >= 8; size -= 8, p += 8) {
+        crc ^= p[0] | (p[1] << 8);
+        crc = t[7][crc & 0xff] ^ t[6][crc >> 8] ^ t[5][p[2]] ^ t[4][p[3]]
+              ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    }
+#elif ESP_CRC_SLICES == 4
+    for (; size >= 4; size -= 4, p += 4) {
+        crc ^= p[0] | (p[1] << 8);
+        crc = t[3][crc & 0xff] ^ t[2][crc >> 8] ^ t[1][p[2]] ^ t[0][p[3]];
+    }
+#endif
+    while (size--) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+    }
+    return crc;
+}
+
+uint16_t esp_crc16_ccitt(uint16_t crc, const void *data, size_t size)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    const uint16_t (*t)[256] = s_crc16_ccitt_table;
+
+#if ESP_CRC_SLICES == 8
+    for (; size >= 8; size -= 8, p += 8) {
+        crc ^= (p[0] << 8) | p[1];
+        crc = t[7][crc >> 8] ^ t[6][crc & 0xff] ^ t[5][p[2]] ^ t[4][p[3]]
+              ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    }
+#elif ESP_CRC_SLICES == 4
+    for (; size >= 4; size -= 4, p += 4) {
+        crc ^= (p[0] << 8) | p[1];
+        crc = t[3][crc >> 8] ^ t[2][crc & 0xff] ^ t[1][p[2]] ^ t[0][p[3]];
+    }
+#endif
+    while (size--) {
+        crc = (uint16_t)(crc << 8) ^ t[0][(crc >> 8) ^ *p++];
+    }
+    return crc;
+}
+
+uint8_t esp_crc7(uint8_t crc, const void *data, size_t size)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    const uint8_t (*t)[256] = s_crc7_table;
+    // The tables work on the CRC shifted into the upper 7 bits
+    uint8_t r = crc << 1;
+
+#if ESP_CRC_SLICES == 8
+    for (; size >= 8; size -= 8, p += 8) {
+        r = t[7][r ^ p[0]] ^ t[6][p[1]] ^ t[5][p[2]] ^ t[4][p[3]]
+            ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    }
+#elif ESP_CRC_SLICES == 4
+    for (; size >= 4; size -= 4, p += 4) {
+        r = t[3][r ^ p[0]] ^ t[2][p[1]] ^ t[1][p[2]] ^ t[0][p[3]];
+    }
+#endif
+    while (size--) {
+        r = t[0][r ^ *p++];
+    }
+    return r >> 1;
+}
@@ -0,0 +1,90 @@
+#!/usr/bin/env python
+#
+# Generates crc_tables.h, the slice-by-8 lookup tables used by esp_crc.c
+#
+# Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+from __future__ import print_function
+import os
+
+SLICES = 8
+
+
+def reflected_table(poly, width):
+    # Table k holds the CRC of byte i followed by k zero bytes, LSB first
+    first = []
+    for i in range(256):
+        crc = i
+        for _ in range(8):
+            crc = (crc >> 1) ^ poly if crc & 1 else crc >> 1
+        first.append(crc)
+    tables = [first]
+    for _ in range(1, SLICES):
+        prev = tables[-1]
+        tables.append([(c >> 8) ^ first[c & 0xff] for c in prev])
+    return tables
+
+
+def normal_table(poly, width):
+    # Table k holds the CRC of byte i followed by k zero bytes, MSB first
+    top = 1 << (width - 1)
+    mask = (1 << width) - 1
+    first = []
+    for i in range(256):
+        crc = i << (width - 8)
+        for _ in range(8):
+            crc = ((crc << 1) ^ poly if crc & top else crc << 1) & mask
+        first.append(crc)
+    tables = [first]
+    for _ in range(1, SLICES):
+        prev = tables[-1]
+        tables.append([((c << 8) & mask) ^ first[c >> (width - 8)] for c in prev])
+    return tables
+
+
+def emit(out, ctype, name, tables, digits):
+    out.append('static const %s %s[ESP_CRC_SLICES][256] = {' % (ctype, name))
+    for k, table in enumerate(tables):
+        if k == 1:
+            out.append('#if ESP_CRC_SLICES > 1')
+        elif k == 4:
+            out.append('#endif')
+            out.append('#if ESP_CRC_SLICES > 4')
+        out.append('    {')
+        for row in range(0, 256, 8):
+            out.append('        ' + ', '.join('0x%0*x' % (digits, v) for v in table[row:row + 8]) + ',')
+        out.append('    },')
+    out.append('#endif')
+    out.append('};')
+    out.append('')
+
+
+def main():
+    out = ['// Generated by gen_crc_tables.py, do not edit',
+           '#pragma once',
+           '',
+           '// CRC16-Modbus: polynomial 0x8005, reflected (0xA001)']
+    emit(out, 'uint16_t', 's_crc16_modbus_table', reflected_table(0xA001, 16), 4)
+    out.append('// CRC16-CCITT: polynomial 0x1021, MSB first')
+    emit(out, 'uint16_t', 's_crc16_ccitt_table', normal_table(0x1021, 16), 4)
+    out.append('// CRC7 (SD): polynomial 0x09, MSB first, kept in the upper 7 bits of a byte')
+    emit(out, 'uint8_t', 's_crc7_table', normal_table(0x09 << 1, 8), 2)
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'crc_tables.h')
+    with open(path, 'w') as f:
+        f.write('\n'.join(out))
+
+
+if __name__ == '__main__':
+    main()
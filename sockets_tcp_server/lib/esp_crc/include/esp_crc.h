@@ -0,0 +1,73 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * Table driven CRC kernels, processing 1, 4 or 8 bytes per step depending on
+ * CONFIG_ESP_CRC_SLICES.
+ *
+ * All functions are incremental: pass the initial value below with the first
+ * chunk of data, then the value returned for the previous chunk. None of these
+ * CRCs has a final XOR, so the last value returned is the CRC of the whole data.
+ */
+
+#define ESP_CRC16_MODBUS_INIT       0xFFFF  /*!< Initial value of the Modbus RTU CRC */
+#define ESP_CRC16_XMODEM_INIT       0x0000  /*!< Initial value of the CRC16-CCITT used by SD cards and XMODEM */
+#define ESP_CRC16_CCITT_FALSE_INIT  0xFFFF  /*!< Initial value of the CRC16-CCITT variant known as CCITT-FALSE */
+#define ESP_CRC7_INIT               0x00    /*!< Initial value of the CRC7 used by SD cards */
+
+/**
+ * @brief Update the CRC16 used by Modbus RTU (polynomial 0x8005, reflected)
+ *
+ * The CRC is sent least significant byte first after the frame.
+ *
+ * @param crc ESP_CRC16_MODBUS_INIT, or the value returned for the previous chunk
+ * @param data data to add to the CRC
+ * @param size size of data in bytes
+ * @return updated CRC
+ */
+uint16_t esp_crc16_modbus(uint16_t crc, const void *data, size_t size);
+
+/**
+ * @brief Update a CRC16-CCITT (polynomial 0x1021, not reflected)
+ *
+ * The CRC is sent most significant byte first after the data.
+ *
+ * @param crc ESP_CRC16_XMODEM_INIT or ESP_CRC16_CCITT_FALSE_INIT, or the value returned for the previous chunk
+ * @param data data to add to the CRC
+ * @param size size of data in bytes
+ * @return updated CRC
+ */
+uint16_t esp_crc16_ccitt(uint16_t crc, const void *data, size_t size);
+
+/**
+ * @brief Update the CRC7 used by SD cards (polynomial 0x09)
+ *
+ * @param crc ESP_CRC7_INIT, or the value returned for the previous chunk
+ * @param data data to add to the CRC
+ * @param size size of data in bytes
+ * @return updated CRC, in the 7 least significant bits
+ */
+uint8_t esp_crc7(uint8_t crc, const void *data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
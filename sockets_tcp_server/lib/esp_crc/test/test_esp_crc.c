@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_crc.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "unity.h"
+#include "test_utils.h"
+
+static const uint8_t check_data[] = "123456789";
+
+TEST_CASE("CRCs of the standard check string", "[esp_crc]")
+{
+    TEST_ASSERT_EQUAL_HEX16(0x4B37, esp_crc16_modbus(ESP_CRC16_MODBUS_INIT, check_data, 9));
+    TEST_ASSERT_EQUAL_HEX16(0x31C3, esp_crc16_ccitt(ESP_CRC16_XMODEM_INIT, check_data, 9));
+    TEST_ASSERT_EQUAL_HEX16(0x29B1, esp_crc16_ccitt(ESP_CRC16_CCITT_FALSE_INIT, check_data, 9));
+    TEST_ASSERT_EQUAL_HEX8(0x75, esp_crc7(ESP_CRC7_INIT, check_data, 9));
+}
+
+TEST_CASE("CRCs computed in chunks match the CRC of the whole data", "[esp_crc]")
+{
+    const size_t size = 1031;
+    uint8_t *data = malloc(size);
+    TEST_ASSERT_NOT_NULL(data);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = esp_random();
+    }
+    uint16_t modbus = esp_crc16_modbus(ESP_CRC16_MODBUS_INIT, data, size);
+    uint16_t ccitt = esp_crc16_ccitt(ESP_CRC16_XMODEM_INIT, data, size);
+    uint8_t crc7 = esp_crc7(ESP_CRC7_INIT, data, size);
+
+    for (size_t chunk = 1; chunk <= 13; chunk++) {
+        uint16_t modbus_chunks = ESP_CRC16_MODBUS_INIT;
+        uint16_t ccitt_chunks = ESP_CRC16_XMODEM_INIT;
+        uint8_t crc7_chunks = ESP_CRC7_INIT;
+        for (size_t pos = 0; pos < size; pos += chunk) {
+            size_t len = (size - pos < chunk) ? size - pos : chunk;
+            modbus_chunks = esp_crc16_modbus(modbus_chunks, data + pos, len);
+            ccitt_chunks = esp_crc16_ccitt(ccitt_chunks, data + pos, len);
+            crc7_chunks = esp_crc7(crc7_chunks, data + pos, len);
+        }
+        TEST_ASSERT_EQUAL_HEX16(modbus, modbus_chunks);
+        TEST_ASSERT_EQUAL_HEX16(ccitt, ccitt_chunks);
+        TEST_ASSERT_EQUAL_HEX8(crc7, crc7_chunks);
+    }
+    free(data);
+}
+
+TEST_CASE("CRC16 throughput on SD blocks", "[esp_crc]")
+{
+    const size_t size = 512;
+    const int count = 1000;
+    uint8_t *data = calloc(1, size);
+    TEST_ASSERT_NOT_NULL(data);
+    volatile uint16_t crc = 0;
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < count; i++) {
+        crc = esp_crc16_ccitt(ESP_CRC16_XMODEM_INIT, data, size);
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    printf("CRC16-CCITT: %d blocks of %u bytes in %lld us (0x%04x)\n", count, (unsigned) size, elapsed, crc);
+    free(data);
+}
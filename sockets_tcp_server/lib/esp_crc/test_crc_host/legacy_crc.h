@@ -0,0 +1,17 @@
+#pragma once
+// Byte at a time CRC loops, as used before esp_crc
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint16_t legacy_mb_crc16(const uint8_t *data, size_t size);     // freemodbus usMBCRC16()
+uint8_t legacy_sdspi_crc7(const uint8_t *data, size_t size);    // driver sdspi_crc7()
+uint16_t legacy_sdspi_crc16(const uint8_t *data, size_t size);  // driver sdspi_crc16(), with the crc16_be() table
+
+#ifdef __cplusplus
+}
+#endif
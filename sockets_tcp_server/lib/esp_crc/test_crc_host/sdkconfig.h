@@ -0,0 +1,2 @@
+#pragma once
+// CONFIG_ESP_CRC_SLICE_BY_<n> is set by the Makefile from ESP_CRC_SLICES
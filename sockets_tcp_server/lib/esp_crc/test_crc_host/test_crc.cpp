@@ -0,0 +1,126 @@
+#include "catch.hpp"
+#include "esp_crc.h"
+#include "legacy_crc.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+static const uint8_t check_data[] = "123456789";
+static const size_t check_size = 9;
+
+static std::vector<uint8_t> random_data(std::mt19937& gen, size_t size)
+{
+    std::vector<uint8_t> data(size);
+    for (auto& byte : data) {
+        byte = (uint8_t)gen();
+    }
+    return data;
+}
+
+TEST_CASE("CRCs of the standard check string", "[esp_crc]")
+{
+    CHECK(esp_crc16_modbus(ESP_CRC16_MODBUS_INIT, check_data, check_size) == 0x4B37);
+    CHECK(esp_crc16_ccitt(ESP_CRC16_XMODEM_INIT, check_data, check_size) == 0x31C3);
+    CHECK(esp_crc16_ccitt(ESP_CRC16_CCITT_FALSE_INIT, check_data, check_size) == 0x29B1);
+    CHECK(esp_crc7(ESP_CRC7_INIT, check_data, check_size) == 0x75);
+    CHECK(esp_crc16_modbus(ESP_CRC16_MODBUS_INIT, check_data, 0) == ESP_CRC16_MODBUS_INIT);
+    CHECK(esp_crc7(ESP_CRC7_INIT, NULL, 0) == ESP_CRC7_INIT);
+}
+
+TEST_CASE("CRCs match the byte at a time loops", "[esp_crc]")
+{
+    std::mt19937 gen(49);
+    for (size_t size = 0; size <= 600; size++) {
+        std::vector<uint8_t> data = random_data(gen, size);
+        const uint8_t* p = data.data();
+        INFO("size " << size);
+        REQUIRE(esp_crc16_modbus(ESP_CRC16_MODBUS_INIT, p, size) == legacy_mb_crc16(p, size));
+        REQUIRE(__builtin_bswap16(esp_crc16_ccitt(ESP_CRC16_XMODEM_INIT, p, size)) == legacy_sdspi_crc16(p, size));
+        REQUIRE(esp_crc7(ESP_CRC7_INIT, p, size) == legacy_sdspi_crc7(p, size));
+    }
+}
+
+TEST_CASE("Modbus frame with its CRC appended has a CRC of zero", "[esp_crc]")
+{
+    std::mt19937 gen(1);
+    std::vector<uint8_t> frame = random_data(gen, 40);
+    uint16_t crc = esp_crc16_modbus(ESP_CRC16_MODBUS_INIT, frame.data(), frame.size());
+    frame.push_back(crc & 0xFF);
+    frame.push_back(crc >> 8);
+    CHECK(esp_crc16_modbus(ESP_CRC16_MODBUS_INIT, frame.data(), frame.size()) == 0);
+}
+
+TEST_CASE("CRCs computed in chunks match the CRC of the whole data", "[esp_crc]")
+{
+    std::mt19937 gen(2);
+    for (int round = 0; round < 500; round++) {
+        size_t size = gen() % 1100;
+        std::vector<uint8_t> data = random_data(gen, size);
+        uint16_t modbus = ESP_CRC16_MODBUS_INIT;
+        uint16_t ccitt = ESP_CRC16_CCITT_FALSE_INIT;
+        uint8_t crc7 = ESP_CRC7_INIT;
+        size_t pos = 0;
+        while (pos < size) {
+            // Mostly small chunks, to leave the data misaligned with the slices
+            size_t chunk = std::min<size_t>(size - pos, (gen() % 4) ? gen() % 12 : gen() % 300);
+            modbus = esp_crc16_modbus(modbus, &data[pos], chunk);
+            ccitt = esp_crc16_ccitt(ccitt, &data[pos], chunk);
+            crc7 = esp_crc7(crc7, &data[pos], chunk);
+            pos += chunk;
+        }
+        INFO("size " << size);
+        REQUIRE(modbus == esp_crc16_modbus(ESP_CRC16_MODBUS_INIT, data.data(), size));
+        REQUIRE(ccitt == esp_crc16_ccitt(ESP_CRC16_CCITT_FALSE_INIT, data.data(), size));
+        REQUIRE(crc7 == esp_crc7(ESP_CRC7_INIT, data.data(), size));
+    }
+}
+
+template<typename F>
+static double throughput(F crc, const std::vector<uint8_t>& data, size_t block)
+{
+    const size_t total = 64 * 1024 * 1024;
+    volatile unsigned sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t done = 0; done < total; done += data.size()) {
+        for (size_t pos = 0; pos + block <= data.size(); pos += block) {
+            sink = sink + crc(&data[pos], block);
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return total / elapsed.count() / 1e6;
+}
+
+TEST_CASE("CRC throughput compared to the byte at a time loops", "[esp_crc][benchmark]")
+{
+    std::mt19937 gen(3);
+    std::vector<uint8_t> data = random_data(gen, 64 * 1024);
+    const size_t blocks[] = { 8, 64, 256, 512 };
+
+    printf("CRC throughput in MB/s (legacy loop -> esp_crc):\n");
+    printf("%6s %22s %22s %22s\n", "block", "CRC16-Modbus", "CRC16-CCITT", "CRC7");
+    for (size_t block : blocks) {
+        double mb_old = throughput([](const uint8_t* p, size_t n) {
+            return (unsigned)legacy_mb_crc16(p, n);
+        }, data, block);
+        double mb_new = throughput([](const uint8_t* p, size_t n) {
+            return (unsigned)esp_crc16_modbus(ESP_CRC16_MODBUS_INIT, p, n);
+        }, data, block);
+        double ccitt_old = throughput([](const uint8_t* p, size_t n) {
+            return (unsigned)legacy_sdspi_crc16(p, n);
+        }, data, block);
+        double ccitt_new = throughput([](const uint8_t* p, size_t n) {
+            return (unsigned)esp_crc16_ccitt(ESP_CRC16_XMODEM_INIT, p, n);
+        }, data, block);
+        double crc7_old = throughput([](const uint8_t* p, size_t n) {
+            return (unsigned)legacy_sdspi_crc7(p, n);
+        }, data, block);
+        double crc7_new = throughput([](const uint8_t* p, size_t n) {
+            return (unsigned)esp_crc7(ESP_CRC7_INIT, p, n);
+        }, data, block);
+        printf("%6zu %9.0f -> %9.0f %9.0f -> %9.0f %9.0f -> %9.0f\n", block,
+               mb_old, mb_new, ccitt_old, ccitt_new, crc7_old, crc7_new);
+    }
+}
@@ -26,11 +26,17 @@
 #include "sdkconfig.h"
 #include "esp_http_client.h"
 #include "errno.h"
+#include "lwip/pbuf.h"
 
 #ifdef CONFIG_ESP_HTTP_CLIENT_ENABLE_HTTPS
 #include "esp_transport_ssl.h"
 #endif
 
+#ifdef CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL
+#include <sys/lock.h>
+#include "esp_transport_pool.h"
+#endif
+
 static const char *TAG = "HTTP_CLIENT";
 
 /**
@@ -119,6 +125,10 @@ struct esp_http_client {
     bool                        first_line_prepared;
     int                         header_index;
     bool                        is_async;
+#ifdef CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL
+    esp_transport_handle_t      pooled_transport;   /*!< Transport borrowed from the connection pool, in transport_list while in use */
+    uint32_t                    pool_config_id;     /*!< Hash of the TLS settings, pooled connections are only shared by identical ones */
+#endif
 };
 
 typedef struct esp_http_client esp_http_client_t;
@@ -171,6 +181,106 @@ static esp_err_t http_dispatch_event(esp_http_client_t *client, esp_http_client_
     return ESP_OK;
 }
 
+#ifdef CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL
+static esp_transport_pool_handle_t s_connection_pool;
+static _lock_t s_connection_pool_lock;
+
+static esp_transport_pool_handle_t http_client_get_connection_pool(void)
+{
+    _lock_acquire(&s_connection_pool_lock);
+    if (s_connection_pool == NULL) {
+        esp_transport_pool_config_t pool_config = {
+            .max_connections = CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL_SIZE,
+            .idle_timeout_ms = CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL_IDLE_TIMEOUT_MS,
+        };
+        s_connection_pool = esp_transport_pool_init(&pool_config);
+    }
+    _lock_release(&s_connection_pool_lock);
+    return s_connection_pool;
+}
+
+void esp_http_client_flush_connection_pool(void)
+{
+    esp_transport_pool_flush(http_client_get_connection_pool());
+}
+
+static uint32_t http_client_hash_string(uint32_t hash, const char *str)
+{
+    // FNV-1a, including the terminating null so that NULL and "" differ from a missing string
+    if (str == NULL) {
+        return hash * 16777619;
+    }
+    do {
+        hash = (hash ^ (uint8_t)*str) * 16777619;
+    } while (*str++);
+    return hash;
+}
+
+static uint32_t http_client_pool_config_id(const esp_http_client_config_t *config)
+{
+    uint32_t hash = 2166136261;
+    hash = http_client_hash_string(hash, config->use_global_ca_store ? NULL : config->cert_pem);
+    hash = http_client_hash_string(hash, config->client_cert_pem);
+    hash = http_client_hash_string(hash, config->client_key_pem);
+    hash = (hash ^ (config->use_global_ca_store | config->skip_cert_common_name_check << 1)) * 16777619;
+    return hash;
+}
+
+/* The connection can carry a new request: no request is pending on it and the response was read entirely */
+static bool http_client_connection_reusable(esp_http_client_handle_t client)
+{
+    if (client->is_async || client->transport == NULL) {
+        return false;
+    }
+    if (client->state == HTTP_STATE_CONNECTED) {
+        return !client->first_line_prepared;
+    }
+    return client->state >= HTTP_STATE_RES_COMPLETE_HEADER && client->is_chunk_complete &&
+           http_should_keep_alive(client->parser);
+}
+
+/* Hands the current transport over to the pool if it is reusable, or closes it (destroying a borrowed one) */
+static esp_err_t http_client_release_transport(esp_http_client_handle_t client, bool destroying)
+{
+    esp_transport_handle_t t = client->transport;
+    bool reusable = http_client_connection_reusable(client);
+    if (client->pooled_transport == NULL && !(destroying && reusable)) {
+        return esp_transport_close(t);
+    }
+    esp_transport_list_remove(client->transport_list, t);
+    client->transport = NULL;
+    client->pooled_transport = NULL;
+    if (!reusable) {
+        esp_transport_close(t);
+        esp_transport_destroy(t);
+        return ESP_OK;
+    }
+    ESP_LOGD(TAG, "Keeping connection to %s:%d in the pool", client->connection_info.host, client->connection_info.port);
+    return esp_transport_pool_put(http_client_get_connection_pool(), t, client->connection_info.scheme,
+                                  client->connection_info.host, client->connection_info.port, client->pool_config_id);
+}
+
+static esp_transport_handle_t http_client_borrow_transport(esp_http_client_handle_t client)
+{
+    if (client->is_async) {
+        return NULL;
+    }
+    esp_transport_handle_t t = esp_transport_pool_get(http_client_get_connection_pool(), client->connection_info.scheme,
+                                                      client->connection_info.host, client->connection_info.port, client->pool_config_id);
+    if (t == NULL) {
+        return NULL;
+    }
+    // Joins the transport list to share its error tracker, until the connection is released
+    if (esp_transport_list_add(client->transport_list, t, client->connection_info.scheme) != ESP_OK) {
+        esp_transport_close(t);
+        esp_transport_destroy(t);
+        return NULL;
+    }
+    client->pooled_transport = t;
+    return t;
+}
+#endif
+
 static int http_on_message_begin(http_parser *parser)
 {
     esp_http_client_t *client = parser->data;
@@ -559,6 +669,9 @@ esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *co
         ESP_LOGE(TAG, "Error set configurations");
         goto error;
     }
+#ifdef CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL
+    client->pool_config_id = http_client_pool_config_id(config);
+#endif
     _success = (
                    (client->request->buffer->data  = malloc(client->buffer_size_tx))  &&
                    (client->response->buffer->data = malloc(client->buffer_size_rx))
@@ -619,7 +732,15 @@ esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
     if (client == NULL) {
         return ESP_FAIL;
     }
+#ifdef CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL
+    if (client->state >= HTTP_STATE_INIT) {
+        http_dispatch_event(client, HTTP_EVENT_DISCONNECTED, esp_transport_get_error_handle(client->transport), 0);
+        http_client_release_transport(client, true);
+        client->state = HTTP_STATE_INIT;
+    }
+#else
     esp_http_client_close(client);
+#endif
     esp_transport_list_destroy(client->transport_list);
     http_header_destroy(client->request->headers);
     free(client->request->buffer->data);
@@ -885,6 +1006,68 @@ int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
     return ridx;
 }
 
+/* Reads through esp_http_client_read() into a newly allocated pbuf */
+static int http_client_read_pbuf_copy(esp_http_client_handle_t client, struct pbuf **p, int len)
+{
+    struct pbuf *q = pbuf_alloc(PBUF_RAW, len > UINT16_MAX ? UINT16_MAX : len, PBUF_RAM);
+    if (q == NULL) {
+        ESP_LOGE(TAG, "Error allocating memory");
+        return ESP_FAIL;
+    }
+    int rlen = esp_http_client_read(client, q->payload, q->len);
+    if (rlen <= 0) {
+        pbuf_free(q);
+        return rlen;
+    }
+    pbuf_realloc(q, rlen);
+    *p = q;
+    return rlen;
+}
+
+int esp_http_client_read_pbuf(esp_http_client_handle_t client, struct pbuf **p, int len)
+{
+    esp_http_buffer_t *res_buffer = client->response->buffer;
+
+    *p = NULL;
+    if (len <= 0) {
+        return 0;
+    }
+    if (res_buffer->raw_len) {
+        /* Body data received along with the headers */
+        return http_client_read_pbuf_copy(client, p, len < res_buffer->raw_len ? len : res_buffer->raw_len);
+    }
+    if (client->response->is_chunked || client->response->content_length < 0 ||
+        esp_http_client_get_transport_type(client) != HTTP_TRANSPORT_OVER_TCP) {
+        /* The data has to go through the parser, or through TLS */
+        return http_client_read_pbuf_copy(client, p, len);
+    }
+
+    int remain_len = client->response->content_length - client->response->data_process;
+    if (len > remain_len) {
+        len = remain_len;
+    }
+    if (len <= 0) {
+        return 0;
+    }
+    errno = 0;
+    int rlen = esp_transport_tcp_read_pbuf(client->transport, p, len, client->timeout_ms);
+    if (rlen <= 0) {
+        if (errno != 0) {
+            ESP_LOGW(TAG, "esp_transport_tcp_read_pbuf returned:%d and errno:%d ", rlen, errno);
+        }
+        return rlen < 0 ? ESP_FAIL : 0;
+    }
+    for (struct pbuf *q = *p; q != NULL; q = q->next) {
+        http_dispatch_event(client, HTTP_EVENT_ON_DATA, q->payload, q->len);
+    }
+    client->response->data_process += rlen;
+    if (client->response->data_process == client->response->content_length) {
+        /* The parser did not see the body, report the end of the message as it would have */
+        client->is_chunk_complete = true;
+    }
+    return rlen;
+}
+
 esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
 {
     esp_err_t err;
@@ -1012,6 +1195,14 @@ static esp_err_t esp_http_client_connect(esp_http_client_handle_t client)
     }
 
     if (client->state < HTTP_STATE_CONNECTED) {
+#ifdef CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL
+        if ((client->transport = http_client_borrow_transport(client)) != NULL) {
+            ESP_LOGD(TAG, "Reusing connection to: %s://%s:%d", client->connection_info.scheme, client->connection_info.host, client->connection_info.port);
+            client->state = HTTP_STATE_CONNECTED;
+            http_dispatch_event(client, HTTP_EVENT_ON_CONNECTED, NULL, 0);
+            return ESP_OK;
+        }
+#endif
         ESP_LOGD(TAG, "Begin connect to: %s://%s:%d", client->connection_info.scheme, client->connection_info.host, client->connection_info.port);
         client->transport = esp_transport_list_get_transport(client->transport_list, client->connection_info.scheme);
         if (client->transport == NULL) {
@@ -1213,8 +1404,14 @@ esp_err_t esp_http_client_close(esp_http_client_handle_t client)
 {
     if (client->state >= HTTP_STATE_INIT) {
         http_dispatch_event(client, HTTP_EVENT_DISCONNECTED, esp_transport_get_error_handle(client->transport), 0);
+#ifdef CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL
+        esp_err_t err = http_client_release_transport(client, false);
+        client->state = HTTP_STATE_INIT;
+        return err;
+#else
         client->state = HTTP_STATE_INIT;
         return esp_transport_close(client->transport);
+#endif
     }
     return ESP_OK;
 }
@@ -128,6 +128,10 @@ typedef struct {
  * Enum for the HTTP status codes.
  */
 typedef enum {
+    /* 2xx - Success */
+    HttpStatus_Ok                = 200,
+    HttpStatus_PartialContent    = 206,
+
     /* 3xx - Redirection */
     HttpStatus_MovedPermanently  = 301,
     HttpStatus_Found             = 302,
@@ -403,6 +407,27 @@ bool esp_http_client_is_chunked_response(esp_http_client_handle_t client);
  */
 int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len);
 
+struct pbuf;
+
+/**
+ * @brief      Read data from http stream without copying it
+ *
+ *             Same as `esp_http_client_read`, except that for plain HTTP responses with a
+ *             Content-Length the data is not copied: the pbuf chain received by the TCP/IP stack
+ *             is handed over to the caller, who releases it with pbuf_free(). Chunked responses,
+ *             HTTPS, and the data received along with the headers are copied into a newly
+ *             allocated pbuf. HTTP_EVENT_ON_DATA events are dispatched as with `esp_http_client_read`.
+ *
+ * @param[in]  client  The esp_http_client handle
+ * @param[out] p       Set to the received pbuf chain, or NULL if nothing was received
+ * @param[in]  len     Maximum number of bytes to read
+ *
+ * @return
+ *     - (-1) if any errors
+ *     - Length of data in the pbuf chain
+ */
+int esp_http_client_read_pbuf(esp_http_client_handle_t client, struct pbuf **p, int len);
+
 
 /**
  * @brief      Get http response status code, the valid value if this function invoke after `esp_http_client_perform`
@@ -450,6 +475,17 @@ esp_err_t esp_http_client_close(esp_http_client_handle_t client);
  */
 esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client);
 
+#ifdef CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL
+/**
+ * @brief      Close all the idle connections of the connection pool shared by the clients
+ *
+ *             Connections are kept in the pool when a client is cleaned up (or closes a connection
+ *             taken from the pool) after a complete response on a kept-alive connection.
+ *             Flushing the pool releases their sockets and TLS contexts, e.g. before a network change.
+ */
+void esp_http_client_flush_connection_pool(void);
+#endif
+
 /**
  * @brief      Get transport type
  *
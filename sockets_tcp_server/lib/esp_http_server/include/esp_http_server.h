@@ -810,6 +810,40 @@ int httpd_req_to_sockfd(httpd_req_t *r);
  */
 int httpd_req_recv(httpd_req_t *r, char *buf, size_t buf_len);
 
+struct pbuf;
+
+/**
+ * @brief   API to read content data from the HTTP request without copying it
+ *
+ * Same as httpd_req_recv(), except that the data is not copied into a
+ * buffer: the pbuf chain of the TCP/IP stack holding the next (up to)
+ * 'buf_len' bytes of content is handed over to the caller, who walks it
+ * through the payload, len and next members of each pbuf and releases it
+ * with pbuf_free(). This avoids copying large uploads once more before
+ * they are processed (e.g. written to flash).
+ *
+ * @note
+ *  - This API is supposed to be called only from the context of
+ *    a URI handler where httpd_req_t* request pointer is valid.
+ *  - Content already buffered by the server while parsing the headers,
+ *    and content of sessions with a receive override (e.g. over TLS),
+ *    are copied into a newly allocated pbuf.
+ *  - The pbufs may hold receive buffers of the network driver, so they
+ *    should be released promptly.
+ *
+ * @param[in]  r        The request being responded to
+ * @param[out] p        Set to the received pbuf chain, or NULL if nothing was received
+ * @param[in]  buf_len  Maximum number of bytes to receive
+ *
+ * @return
+ *  - Bytes : Number of bytes in the pbuf chain
+ *  - 0     : Buffer length parameter is zero / connection closed by peer
+ *  - HTTPD_SOCK_ERR_INVALID  : Invalid arguments
+ *  - HTTPD_SOCK_ERR_TIMEOUT  : Timeout/interrupted while calling socket recv()
+ *  - HTTPD_SOCK_ERR_FAIL     : Unrecoverable error while calling socket recv()
+ */
+int httpd_req_recv_pbuf(httpd_req_t *r, struct pbuf **p, size_t buf_len);
+
 /**
  * @brief   Search for a field in request headers and
  *          return the string length of it's value
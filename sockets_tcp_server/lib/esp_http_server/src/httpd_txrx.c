@@ -19,6 +19,8 @@
 
 #include <esp_http_server.h>
 #include "esp_httpd_priv.h"
+#include "lwip/sockets.h"
+#include "lwip/pbuf.h"
 
 static const char *TAG = "httpd_txrx";
 
@@ -599,3 +601,62 @@ int httpd_default_recv(httpd_handle_t hd, int sockfd, char *buf, size_t buf_len,
     }
     return ret;
 }
+
+/* Receives into a newly allocated pbuf, for the data which can not be handed over as is */
+static int httpd_recv_pbuf_copy(httpd_req_t *r, struct pbuf **p, size_t buf_len, bool halt_after_pending)
+{
+    struct pbuf *q = pbuf_alloc(PBUF_RAW, MIN(buf_len, UINT16_MAX), PBUF_RAM);
+    if (q == NULL) {
+        ESP_LOGE(TAG, LOG_FMT("failed to allocate %d bytes"), MIN(buf_len, UINT16_MAX));
+        return HTTPD_SOCK_ERR_FAIL;
+    }
+    int ret = httpd_recv_with_opt(r, q->payload, q->len, halt_after_pending);
+    if (ret <= 0) {
+        pbuf_free(q);
+        return ret;
+    }
+    pbuf_realloc(q, ret);
+    *p = q;
+    return ret;
+}
+
+int httpd_req_recv_pbuf(httpd_req_t *r, struct pbuf **p, size_t buf_len)
+{
+    if (r == NULL || p == NULL) {
+        return HTTPD_SOCK_ERR_INVALID;
+    }
+    *p = NULL;
+
+    if (!httpd_valid_req(r)) {
+        ESP_LOGW(TAG, LOG_FMT("invalid request"));
+        return HTTPD_SOCK_ERR_INVALID;
+    }
+
+    struct httpd_req_aux *ra = r->aux;
+    ESP_LOGD(TAG, LOG_FMT("remaining length = %d"), ra->remaining_len);
+
+    if (buf_len > ra->remaining_len) {
+        buf_len = ra->remaining_len;
+    }
+    if (buf_len == 0) {
+        return buf_len;
+    }
+
+    int ret;
+    if (ra->sd->pending_len > 0 || ra->sd->recv_fn != httpd_default_recv) {
+        /* Only the pending data is copied, the next call gets the data of the socket */
+        ret = httpd_recv_pbuf_copy(r, p, buf_len, ra->sd->pending_len > 0);
+    } else {
+        ret = lwip_recv_pbuf(ra->sd->fd, p, buf_len, 0);
+        if (ret < 0) {
+            ret = httpd_sock_err("recv", ra->sd->fd);
+        }
+    }
+    if (ret < 0) {
+        ESP_LOGD(TAG, LOG_FMT("error in httpd_recv"));
+        return ret;
+    }
+    ra->remaining_len -= ret;
+    ESP_LOGD(TAG, LOG_FMT("received length = %d"), ret);
+    return ret;
+}
@@ -28,6 +28,10 @@ typedef void *esp_https_ota_handle_t;
  */
 typedef struct {
     const esp_http_client_config_t *http_config;   /*!< ESP HTTP client configuration */
+    bool pipelined_write;                          /*!< Write to flash from a separate task while the next chunk is downloaded.
+                                                        Uses a second buffer of `http_config->buffer_size` bytes. */
+    bool resumable;                                /*!< Save the progress of the download to NVS, so that an interrupted download of the
+                                                        same `http_config->url` continues where it stopped. NVS must be initialized. */
 } esp_https_ota_config_t;
 
 #define ESP_ERR_HTTPS_OTA_BASE            (0x9000)
@@ -79,6 +83,16 @@ esp_err_t esp_https_ota(const esp_http_client_config_t *config);
  * @note     This API is blocking, so setting `is_async` member of `http_config` structure will
  *           result in an error.
  *
+ * @note     With `resumable` set in esp_https_ota_config_t, the progress is saved to NVS every
+ *           CONFIG_OTA_RESUME_CHECKPOINT_KB of image written. If a previous download of the same URL
+ *           was interrupted, the rest of the image is requested with a `Range` header, and with an `If-Range`
+ *           header holding the ETag or Last-Modified value the server sent for the image. Then
+ *           esp_https_ota_perform() continues writing it after the last checkpoint. If the server doesn't
+ *           answer with the rest of the same image (status 206 and the remaining length), the download
+ *           starts from the beginning. A download can only be resumed if the server sends a strong ETag
+ *           or a Last-Modified header. The saved progress is kept until the whole image is downloaded.
+ *           Compressed and delta images are always downloaded from their beginning.
+ *
  * @return
  *    - ESP_OK: HTTPS OTA Firmware upgrade context initialised and HTTPS connection established
  *    - ESP_FAIL: For generic failure.
@@ -95,6 +109,10 @@ esp_err_t esp_https_ota_begin(esp_https_ota_config_t *ota_config, esp_https_ota_
  * must be called only if esp_https_ota_begin() returns successfully.
  * This function must be called in a loop since it returns after every HTTP read operation thus 
  * giving you the flexibility to stop OTA operation midway.
+ *
+ * @note     With `pipelined_write` set in esp_https_ota_config_t, the data read is written to flash
+ *           by a writer task while this function returns to read the next chunk. A flash write error
+ *           is then returned by a later call to this function, or by esp_https_ota_finish().
  * 
  * @param[in]  https_ota_handle  pointer to esp_https_ota_handle_t structure
  *
@@ -151,6 +169,10 @@ esp_err_t esp_https_ota_finish(esp_https_ota_handle_t https_ota_handle);
  * @note    This API can be called only after esp_https_ota_begin() and before esp_https_ota_perform().
  *          Calling this API is not mandatory.
  *
+ * @note    For a compressed image (see esp_ota_compressed.h), the app description is read from the
+ *          decompressed image header. For a delta image (see esp_ota_delta.h), it is read from the
+ *          image header made from the running app image.
+ *
  * @param[in]   https_ota_handle   pointer to esp_https_ota_handle_t structure
  * @param[out]  new_app_info       pointer to an allocated esp_app_desc_t structure
  * 
@@ -172,7 +194,7 @@ esp_err_t esp_https_ota_get_img_desc(esp_https_ota_handle_t https_ota_handle, es
 *
 * @return
 *    - -1    On failure
-*    - total bytes read so far
+*    - total bytes read so far, including the bytes written before a resumed download was interrupted
 */
 int esp_https_ota_get_image_len_read(esp_https_ota_handle_t https_ota_handle);
 
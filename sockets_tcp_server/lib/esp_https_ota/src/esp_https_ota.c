@@ -15,13 +15,31 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <esp_https_ota.h>
 #include <esp_log.h>
 #include <esp_ota_ops.h>
+#include <esp_ota_compressed.h>
+#include <esp_ota_delta.h>
 #include <errno.h>
+#include <sys/param.h>
+#include <nvs.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 
 #define IMAGE_HEADER_SIZE sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t) + 1
 #define DEFAULT_OTA_BUF_SIZE IMAGE_HEADER_SIZE
+#define OTA_PIPELINE_BUF_COUNT 2
+/* Compressed data read at most to decompress the image header of a compressed or delta image */
+#define COMPRESSED_HEADER_MAX_SIZE 4096
+/* Progress of a resumable download is saved at each checkpoint, at a flash sector boundary */
+#define OTA_RESUME_CHECKPOINT_SIZE ((CONFIG_OTA_RESUME_CHECKPOINT_KB / 4) * 4096)
+#define OTA_RESUME_NVS_NAMESPACE "esp_https_ota"
+#define OTA_RESUME_NVS_URL_KEY "url"
+#define OTA_RESUME_NVS_STATE_KEY "state"
+#define OTA_RESUME_NVS_VALIDATOR_KEY "validator"
 static const char *TAG = "esp_https_ota";
 
 typedef enum {
@@ -31,6 +49,18 @@ typedef enum {
     ESP_HTTPS_OTA_SUCCESS,
 } esp_https_ota_state;
 
+/* Buffer handed over to the writer task, a NULL `buf` stops the task */
+typedef struct {
+    char *buf;
+    size_t len;
+} esp_https_ota_chunk_t;
+
+/* Progress of a resumable download saved to NVS, followed by the state saved by esp_ota_get_resume_state() */
+typedef struct {
+    uint32_t image_len;     /* Length of the whole image, as sent by the server */
+    uint32_t offset;        /* Length of the image written to the partition, where the download continues */
+} esp_https_ota_resume_t;
+
 struct esp_https_ota_handle {
     esp_ota_handle_t update_handle;
     const esp_partition_t *update_partition;
@@ -39,6 +69,28 @@ struct esp_https_ota_handle {
     size_t ota_upgrade_buf_size;
     int binary_file_len;
     esp_https_ota_state state;
+    /* Pipelined write: `ota_upgrade_buf` and `ota_pipeline_buf` are filled in turns while the
+       writer task writes the other one to flash */
+    bool pipelined_write;
+    char *ota_pipeline_buf;
+    char *read_buf;
+    QueueHandle_t free_queue;
+    QueueHandle_t filled_queue;
+    SemaphoreHandle_t writer_done;
+    TaskHandle_t writer_task;
+    volatile esp_err_t writer_err;
+    /* Resumable download: `resume_buf` holds the progress saved to NVS at each checkpoint */
+    bool resumable;
+    nvs_handle_t resume_nvs;
+    esp_https_ota_resume_t *resume_buf;
+    size_t resume_state_size;
+    int image_len;
+    int resume_offset;      /* Non zero while continuing an interrupted download, until the OTA is resumed */
+    char *validator;        /* Strong ETag, or else Last-Modified, of the last response, sent as If-Range when resuming */
+    bool validator_etag;
+    http_event_handle_cb http_event_handler;    /* Event handler and user data of the http_config */
+    void *http_user_data;
+    int written_len;        /* Length of the image passed to esp_ota_write() */
 };
 
 typedef struct esp_https_ota_handle esp_https_ota_t;
@@ -116,12 +168,149 @@ static void _http_cleanup(esp_http_client_handle_t client)
     esp_http_client_cleanup(client);
 }
 
+static void _ota_resume_save(esp_https_ota_t *https_ota_handle)
+{
+    size_t size = ESP_OTA_RESUME_STATE_MAX_SIZE;
+    esp_err_t err = esp_ota_get_resume_state(https_ota_handle->update_handle, https_ota_handle->resume_buf + 1, &size);
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        ESP_LOGI(TAG, "Download of a compressed or delta image can't be resumed");
+        https_ota_handle->resumable = false;
+        return;
+    }
+    if (err == ESP_OK) {
+        https_ota_handle->resume_buf->image_len = https_ota_handle->image_len;
+        https_ota_handle->resume_buf->offset = https_ota_handle->written_len;
+        err = nvs_set_blob(https_ota_handle->resume_nvs, OTA_RESUME_NVS_STATE_KEY, https_ota_handle->resume_buf,
+                           sizeof(esp_https_ota_resume_t) + size);
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(https_ota_handle->resume_nvs);
+    }
+    if (err != ESP_OK) {
+        /* The download can still be resumed from the previous checkpoint */
+        ESP_LOGW(TAG, "Couldn't save OTA progress (%s)", esp_err_to_name(err));
+    } else {
+        ESP_LOGD(TAG, "Saved OTA progress at %d bytes", https_ota_handle->written_len);
+    }
+}
+
+/* Writes to the OTA partition, saving the progress of a resumable download at each checkpoint */
+static esp_err_t _ota_write_checkpointed(esp_https_ota_t *https_ota_handle, const char *buf, size_t len)
+{
+    while (len > 0) {
+        size_t write_len = len;
+        if (https_ota_handle->resumable) {
+            write_len = MIN(len, OTA_RESUME_CHECKPOINT_SIZE - https_ota_handle->written_len % OTA_RESUME_CHECKPOINT_SIZE);
+        }
+        esp_err_t err = esp_ota_write(https_ota_handle->update_handle, buf, write_len);
+        if (err != ESP_OK) {
+            return err;
+        }
+        https_ota_handle->written_len += write_len;
+        buf += write_len;
+        len -= write_len;
+        if (https_ota_handle->resumable && https_ota_handle->written_len % OTA_RESUME_CHECKPOINT_SIZE == 0) {
+            _ota_resume_save(https_ota_handle);
+        }
+    }
+    return ESP_OK;
+}
+
+static void _ota_writer_task(void *param)
+{
+    esp_https_ota_t *https_ota_handle = (esp_https_ota_t *)param;
+    esp_https_ota_chunk_t chunk;
+
+    while (xQueueReceive(https_ota_handle->filled_queue, &chunk, portMAX_DELAY) == pdTRUE && chunk.buf) {
+        /* Once a write failed, the remaining buffers are only recycled */
+        if (https_ota_handle->writer_err == ESP_OK) {
+            esp_err_t err = _ota_write_checkpointed(https_ota_handle, chunk.buf, chunk.len);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Error: esp_ota_write failed! err=0x%d", err);
+                https_ota_handle->writer_err = err;
+            }
+        }
+        xQueueSend(https_ota_handle->free_queue, &chunk.buf, portMAX_DELAY);
+    }
+    xSemaphoreGive(https_ota_handle->writer_done);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t _ota_writer_start(esp_https_ota_t *https_ota_handle)
+{
+    https_ota_handle->writer_err = ESP_OK;
+    if (xTaskCreate(_ota_writer_task, "ota_writer", CONFIG_OTA_WRITER_TASK_STACK_SIZE, https_ota_handle,
+                    CONFIG_OTA_WRITER_TASK_PRIORITY, &https_ota_handle->writer_task) != pdPASS) {
+        ESP_LOGE(TAG, "Couldn't create OTA writer task");
+        https_ota_handle->writer_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    xQueueSend(https_ota_handle->free_queue, &https_ota_handle->ota_pipeline_buf, portMAX_DELAY);
+    /* `ota_upgrade_buf` still holds the image header if esp_https_ota_get_img_desc() was called */
+    if (!https_ota_handle->binary_file_len) {
+        xQueueSend(https_ota_handle->free_queue, &https_ota_handle->ota_upgrade_buf, portMAX_DELAY);
+    }
+    return ESP_OK;
+}
+
+/* Waits for the queued buffers to be written and stops the writer task, returns the first write error */
+static esp_err_t _ota_writer_stop(esp_https_ota_t *https_ota_handle)
+{
+    if (https_ota_handle->writer_task) {
+        esp_https_ota_chunk_t chunk = { .buf = NULL, .len = 0 };
+        xQueueSend(https_ota_handle->filled_queue, &chunk, portMAX_DELAY);
+        xSemaphoreTake(https_ota_handle->writer_done, portMAX_DELAY);
+        https_ota_handle->writer_task = NULL;
+    }
+    return https_ota_handle->writer_err;
+}
+
+static esp_err_t _ota_pipeline_init(esp_https_ota_t *https_ota_handle)
+{
+    https_ota_handle->ota_pipeline_buf = (char *)malloc(https_ota_handle->ota_upgrade_buf_size);
+    https_ota_handle->free_queue = xQueueCreate(OTA_PIPELINE_BUF_COUNT, sizeof(char *));
+    https_ota_handle->filled_queue = xQueueCreate(OTA_PIPELINE_BUF_COUNT, sizeof(esp_https_ota_chunk_t));
+    https_ota_handle->writer_done = xSemaphoreCreateBinary();
+    if (!https_ota_handle->ota_pipeline_buf || !https_ota_handle->free_queue ||
+        !https_ota_handle->filled_queue || !https_ota_handle->writer_done) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+static void _ota_pipeline_deinit(esp_https_ota_t *https_ota_handle)
+{
+    _ota_writer_stop(https_ota_handle);
+    free(https_ota_handle->ota_pipeline_buf);
+    https_ota_handle->ota_pipeline_buf = NULL;
+    if (https_ota_handle->free_queue) {
+        vQueueDelete(https_ota_handle->free_queue);
+        https_ota_handle->free_queue = NULL;
+    }
+    if (https_ota_handle->filled_queue) {
+        vQueueDelete(https_ota_handle->filled_queue);
+        https_ota_handle->filled_queue = NULL;
+    }
+    if (https_ota_handle->writer_done) {
+        vSemaphoreDelete(https_ota_handle->writer_done);
+        https_ota_handle->writer_done = NULL;
+    }
+}
+
 static esp_err_t _ota_write(esp_https_ota_t *https_ota_handle, const void *buffer, size_t buf_len)
 {
     if (buffer == NULL || https_ota_handle == NULL) {
         return ESP_FAIL;
     }
-    esp_err_t err = esp_ota_write(https_ota_handle->update_handle, buffer, buf_len);
+    if (https_ota_handle->pipelined_write) {
+        /* The buffer is owned by the writer task until it is put back to `free_queue` */
+        esp_https_ota_chunk_t chunk = { .buf = (char *)buffer, .len = buf_len };
+        xQueueSend(https_ota_handle->filled_queue, &chunk, portMAX_DELAY);
+        https_ota_handle->binary_file_len += buf_len;
+        ESP_LOGD(TAG, "Queued image length %d", https_ota_handle->binary_file_len);
+        return ESP_ERR_HTTPS_OTA_IN_PROGRESS;
+    }
+    esp_err_t err = _ota_write_checkpointed(https_ota_handle, buffer, buf_len);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Error: esp_ota_write failed! err=0x%d", err);
     } else {
@@ -132,6 +321,175 @@ static esp_err_t _ota_write(esp_https_ota_t *https_ota_handle, const void *buffe
     return err;
 }
 
+/* Keeps the validator of the image from the response headers, then passes the event to the handler of the http_config */
+static esp_err_t _ota_resume_http_event(esp_http_client_event_t *evt)
+{
+    esp_https_ota_t *https_ota_handle = evt->user_data;
+    if (https_ota_handle->resumable) {
+        if (evt->event_id == HTTP_EVENT_HEADERS_SENT) {
+            free(https_ota_handle->validator);
+            https_ota_handle->validator = NULL;
+            https_ota_handle->validator_etag = false;
+        } else if (evt->event_id == HTTP_EVENT_ON_HEADER) {
+            /* A weak ETag can't be used in If-Range */
+            bool etag = strcasecmp(evt->header_key, "ETag") == 0 && strncmp(evt->header_value, "W/", 2) != 0;
+            if (etag || (strcasecmp(evt->header_key, "Last-Modified") == 0 && !https_ota_handle->validator_etag)) {
+                free(https_ota_handle->validator);
+                https_ota_handle->validator = strdup(evt->header_value);
+                https_ota_handle->validator_etag = etag;
+            }
+        }
+    }
+    if (https_ota_handle->http_event_handler == NULL) {
+        return ESP_OK;
+    }
+    evt->user_data = https_ota_handle->http_user_data;
+    return https_ota_handle->http_event_handler(evt);
+}
+
+/* Reads a string saved to NVS, allocated with malloc() */
+static char *_ota_resume_get_str(esp_https_ota_t *https_ota_handle, const char *key)
+{
+    size_t len = 0;
+    if (nvs_get_str(https_ota_handle->resume_nvs, key, NULL, &len) != ESP_OK) {
+        return NULL;
+    }
+    char *str = malloc(len);
+    if (str && nvs_get_str(https_ota_handle->resume_nvs, key, str, &len) != ESP_OK) {
+        free(str);
+        str = NULL;
+    }
+    return str;
+}
+
+/*
+ * Loads the progress of an interrupted download of the same URL, and asks the server for the rest of the image
+ * if it is still the image with the saved validator (If-Range), or for the whole new image otherwise.
+ */
+static void _ota_resume_load(esp_https_ota_t *https_ota_handle, const char *url)
+{
+    char *saved_url = _ota_resume_get_str(https_ota_handle, OTA_RESUME_NVS_URL_KEY);
+    bool same_url = saved_url && strcmp(saved_url, url) == 0;
+    free(saved_url);
+    char *validator = _ota_resume_get_str(https_ota_handle, OTA_RESUME_NVS_VALIDATOR_KEY);
+    size_t size = sizeof(esp_https_ota_resume_t) + ESP_OTA_RESUME_STATE_MAX_SIZE;
+    if (!same_url || !validator || nvs_get_blob(https_ota_handle->resume_nvs, OTA_RESUME_NVS_STATE_KEY, https_ota_handle->resume_buf, &size) != ESP_OK
+        || size < sizeof(esp_https_ota_resume_t) || https_ota_handle->resume_buf->offset == 0
+        || https_ota_handle->resume_buf->offset >= https_ota_handle->resume_buf->image_len) {
+        free(validator);
+        return;
+    }
+    https_ota_handle->resume_state_size = size - sizeof(esp_https_ota_resume_t);
+    https_ota_handle->image_len = https_ota_handle->resume_buf->image_len;
+    https_ota_handle->resume_offset = https_ota_handle->resume_buf->offset;
+
+    char range[32];
+    snprintf(range, sizeof(range), "bytes=%d-", https_ota_handle->resume_offset);
+    esp_http_client_set_header(https_ota_handle->http_client, "Range", range);
+    esp_http_client_set_header(https_ota_handle->http_client, "If-Range", validator);
+    free(validator);
+    ESP_LOGI(TAG, "Resuming download at %d of %d bytes", https_ota_handle->resume_offset, https_ota_handle->image_len);
+}
+
+static esp_err_t _ota_resume_init(esp_https_ota_t *https_ota_handle, const char *url)
+{
+    if (url == NULL) {
+        ESP_LOGW(TAG, "Download can only be resumed when the URL is configured");
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = nvs_open(OTA_RESUME_NVS_NAMESPACE, NVS_READWRITE, &https_ota_handle->resume_nvs);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Download can't be resumed, failed to open NVS (%s)", esp_err_to_name(err));
+        return err;
+    }
+    https_ota_handle->resume_buf = malloc(sizeof(esp_https_ota_resume_t) + ESP_OTA_RESUME_STATE_MAX_SIZE);
+    if (!https_ota_handle->resume_buf) {
+        nvs_close(https_ota_handle->resume_nvs);
+        return ESP_ERR_NO_MEM;
+    }
+    _ota_resume_load(https_ota_handle, url);
+    return ESP_OK;
+}
+
+static void _ota_resume_deinit(esp_https_ota_t *https_ota_handle)
+{
+    if (https_ota_handle->resume_buf) {
+        nvs_close(https_ota_handle->resume_nvs);
+        free(https_ota_handle->resume_buf);
+        https_ota_handle->resume_buf = NULL;
+    }
+    free(https_ota_handle->validator);
+    https_ota_handle->validator = NULL;
+    https_ota_handle->resumable = false;
+}
+
+/* Forgets the saved progress, the next download starts from the beginning */
+static void _ota_resume_discard(esp_https_ota_t *https_ota_handle)
+{
+    https_ota_handle->resume_offset = 0;
+    if (nvs_erase_key(https_ota_handle->resume_nvs, OTA_RESUME_NVS_STATE_KEY) == ESP_OK) {
+        nvs_commit(https_ota_handle->resume_nvs);
+    }
+}
+
+/*
+ * Checks that the server continues the interrupted download, or downloads the image again from its start.
+ * Then a new download records its URL, the length and the validator of the image to be resumed later.
+ */
+static esp_err_t _ota_resume_connected(esp_https_ota_t *https_ota_handle, const char *url)
+{
+    esp_http_client_handle_t http_client = https_ota_handle->http_client;
+    if (https_ota_handle->resume_offset) {
+        if (esp_http_client_get_status_code(http_client) == HttpStatus_PartialContent
+            && esp_http_client_get_content_length(http_client) == https_ota_handle->image_len - https_ota_handle->resume_offset) {
+            return ESP_OK;
+        }
+        int status_code = esp_http_client_get_status_code(http_client);
+        ESP_LOGW(TAG, "Server didn't continue the download (status %d), restarting it", status_code);
+        _ota_resume_discard(https_ota_handle);
+        esp_http_client_delete_header(http_client, "Range");
+        esp_http_client_delete_header(http_client, "If-Range");
+        /* The image changed or the server ignored the range: the response already is the whole image */
+        if (status_code != HttpStatus_Ok) {
+            esp_http_client_close(http_client);
+            esp_err_t err = _http_connect(http_client);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+
+    https_ota_handle->image_len = esp_http_client_get_content_length(http_client);
+    if (https_ota_handle->image_len <= 0) {
+        ESP_LOGW(TAG, "Download can't be resumed, the image length is unknown");
+        _ota_resume_deinit(https_ota_handle);
+        return ESP_OK;
+    }
+    if (https_ota_handle->validator == NULL) {
+        ESP_LOGW(TAG, "Download can't be resumed, the server sent no ETag or Last-Modified");
+        _ota_resume_deinit(https_ota_handle);
+        return ESP_OK;
+    }
+    esp_err_t err = nvs_set_str(https_ota_handle->resume_nvs, OTA_RESUME_NVS_URL_KEY, url);
+    if (err == ESP_OK) {
+        err = nvs_set_str(https_ota_handle->resume_nvs, OTA_RESUME_NVS_VALIDATOR_KEY, https_ota_handle->validator);
+    }
+    if (err == ESP_OK) {
+        err = nvs_erase_key(https_ota_handle->resume_nvs, OTA_RESUME_NVS_STATE_KEY);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(https_ota_handle->resume_nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Download can't be resumed, failed to write NVS (%s)", esp_err_to_name(err));
+        _ota_resume_deinit(https_ota_handle);
+    }
+    return ESP_OK;
+}
+
 esp_err_t esp_https_ota_begin(esp_https_ota_config_t *ota_config, esp_https_ota_handle_t *handle)
 {
     esp_err_t err;
@@ -160,14 +518,28 @@ esp_err_t esp_https_ota_begin(esp_https_ota_config_t *ota_config, esp_https_ota_
     }
     
     /* Initiate HTTP Connection */
-    https_ota_handle->http_client = esp_http_client_init(ota_config->http_config);
+    esp_http_client_config_t http_config = *ota_config->http_config;
+    if (ota_config->resumable) {
+        https_ota_handle->http_event_handler = http_config.event_handler;
+        https_ota_handle->http_user_data = http_config.user_data;
+        http_config.event_handler = _ota_resume_http_event;
+        http_config.user_data = https_ota_handle;
+    }
+    https_ota_handle->http_client = esp_http_client_init(&http_config);
     if (https_ota_handle->http_client == NULL) {
         ESP_LOGE(TAG, "Failed to initialise HTTP connection");
         err = ESP_FAIL;
         goto failure;
     }
 
+    if (ota_config->resumable) {
+        https_ota_handle->resumable = _ota_resume_init(https_ota_handle, ota_config->http_config->url) == ESP_OK;
+    }
+
     err = _http_connect(https_ota_handle->http_client);
+    if (err == ESP_OK && https_ota_handle->resumable) {
+        err = _ota_resume_connected(https_ota_handle, ota_config->http_config->url);
+    }
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to establish HTTP connection");
         goto http_cleanup;
@@ -194,6 +566,17 @@ esp_err_t esp_https_ota_begin(esp_https_ota_config_t *ota_config, esp_https_ota_
     }
     https_ota_handle->ota_upgrade_buf_size = alloc_size;
 
+    https_ota_handle->pipelined_write = ota_config->pipelined_write;
+    if (https_ota_handle->pipelined_write) {
+        err = _ota_pipeline_init(https_ota_handle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Couldn't allocate memory for pipelined write");
+            _ota_pipeline_deinit(https_ota_handle);
+            free(https_ota_handle->ota_upgrade_buf);
+            goto http_cleanup;
+        }
+    }
+
     https_ota_handle->binary_file_len = 0;
     *handle = (esp_https_ota_handle_t)https_ota_handle;
     https_ota_handle->state = ESP_HTTPS_OTA_BEGIN;
@@ -202,11 +585,61 @@ esp_err_t esp_https_ota_begin(esp_https_ota_config_t *ota_config, esp_https_ota_
 http_cleanup:
     _http_cleanup(https_ota_handle->http_client);
 failure:
+    _ota_resume_deinit(https_ota_handle);
     free(https_ota_handle);
     *handle = NULL;
     return err;
 }
 
+/*
+ * Reads the compressed image until its app image header can be decompressed, or the delta image until its app image
+ * header can be made from the running app image. The data read is kept in `ota_upgrade_buf`, grown if needed,
+ * to be written to the OTA partition first.
+ */
+static esp_err_t _read_compressed_img_desc(esp_https_ota_t *handle, esp_app_desc_t *new_app_info, bool delta)
+{
+    const esp_partition_t *running = delta ? esp_ota_get_running_partition() : NULL;
+    size_t buf_size = handle->ota_upgrade_buf_size;
+    char *image_header = malloc(IMAGE_HEADER_SIZE);
+    if (!image_header) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err;
+    while ((err = delta ? esp_ota_delta_peek(handle->ota_upgrade_buf, handle->binary_file_len, running,
+                                             image_header, IMAGE_HEADER_SIZE)
+                        : esp_ota_decompress_peek(handle->ota_upgrade_buf, handle->binary_file_len,
+                                                  image_header, IMAGE_HEADER_SIZE)) == ESP_ERR_INVALID_SIZE) {
+        if (handle->binary_file_len == buf_size) {
+            if (buf_size >= COMPRESSED_HEADER_MAX_SIZE) {
+                break;
+            }
+            char *buf = realloc(handle->ota_upgrade_buf, buf_size * 2);
+            if (!buf) {
+                err = ESP_ERR_NO_MEM;
+                break;
+            }
+            handle->ota_upgrade_buf = buf;
+            buf_size *= 2;
+        }
+        int data_read = esp_http_client_read(handle->http_client, handle->ota_upgrade_buf + handle->binary_file_len,
+                                             buf_size - handle->binary_file_len);
+        if (errno == ENOTCONN || errno == ECONNRESET || errno == ECONNABORTED || data_read < 0 ||
+            (data_read == 0 && esp_https_ota_is_complete_data_received(handle))) {
+            ESP_LOGE(TAG, "Connection closed, errno = %d", errno);
+            break;
+        }
+        handle->binary_file_len += data_read;
+    }
+    if (err == ESP_OK) {
+        memcpy(new_app_info, &image_header[sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t)], sizeof(esp_app_desc_t));
+    } else {
+        ESP_LOGE(TAG, "Couldn't decompress image headers (%s)", esp_err_to_name(err));
+        err = ESP_FAIL;
+    }
+    free(image_header);
+    return err;
+}
+
 esp_err_t esp_https_ota_get_img_desc(esp_https_ota_handle_t https_ota_handle, esp_app_desc_t *new_app_info)
 {
     esp_https_ota_t *handle = (esp_https_ota_t *)https_ota_handle;
@@ -218,6 +651,15 @@ esp_err_t esp_https_ota_get_img_desc(esp_https_ota_handle_t https_ota_handle, es
         ESP_LOGE(TAG, "esp_https_ota_read_img_desc: Invalid state");
         return ESP_FAIL;
     }
+    if (handle->resume_offset) {
+        /* The image header was written to the partition before the download was interrupted */
+        if (esp_partition_read(handle->update_partition, sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t),
+                               new_app_info, sizeof(esp_app_desc_t)) != ESP_OK) {
+            ESP_LOGE(TAG, "Couldn't read image header from the partition");
+            return ESP_FAIL;
+        }
+        return ESP_OK;
+    }
     /*
      * `data_read_size` holds number of bytes needed to read complete header.
      * `bytes_read` holds number of bytes read.
@@ -248,6 +690,12 @@ esp_err_t esp_https_ota_get_img_desc(esp_https_ota_handle_t https_ota_handle, es
         return ESP_FAIL;
     }
     handle->binary_file_len = bytes_read;
+    if (esp_ota_is_compressed_image(handle->ota_upgrade_buf, bytes_read)) {
+        return _read_compressed_img_desc(handle, new_app_info, false);
+    }
+    if (esp_ota_is_delta_image(handle->ota_upgrade_buf, bytes_read)) {
+        return _read_compressed_img_desc(handle, new_app_info, true);
+    }
     memcpy(new_app_info, &handle->ota_upgrade_buf[sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t)], sizeof(esp_app_desc_t));
     return ESP_OK;                                
 }
@@ -268,22 +716,60 @@ esp_err_t esp_https_ota_perform(esp_https_ota_handle_t https_ota_handle)
     int data_read;
     switch (handle->state) {
         case ESP_HTTPS_OTA_BEGIN:
-            err = esp_ota_begin(handle->update_partition, OTA_SIZE_UNKNOWN, &handle->update_handle);
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "esp_ota_begin failed (%s)", esp_err_to_name(err));
-                return err;
+            if (handle->resume_offset) {
+                err = esp_ota_resume(handle->update_partition, handle->resume_buf + 1, handle->resume_state_size,
+                                     &handle->update_handle);
+                if (err != ESP_OK) {
+                    /* The server already sends the rest of the image, the next attempt starts from the beginning */
+                    ESP_LOGE(TAG, "esp_ota_resume failed (%s)", esp_err_to_name(err));
+                    _ota_resume_discard(handle);
+                    return err;
+                }
+            } else {
+                err = esp_ota_begin(handle->update_partition, OTA_SIZE_UNKNOWN, &handle->update_handle);
+                if (err != ESP_OK) {
+                    ESP_LOGE(TAG, "esp_ota_begin failed (%s)", esp_err_to_name(err));
+                    return err;
+                }
             }
             handle->state = ESP_HTTPS_OTA_IN_PROGRESS;
+            if (handle->pipelined_write && _ota_writer_start(handle) != ESP_OK) {
+                /* No buffer was handed over to a writer task, the update goes on with serial write */
+                ESP_LOGW(TAG, "Falling back to serial write");
+                _ota_pipeline_deinit(handle);
+                handle->pipelined_write = false;
+            }
+            if (handle->resume_offset) {
+                /* The download continues after the image data already written */
+                handle->binary_file_len = handle->resume_offset;
+                handle->written_len = handle->resume_offset;
+                handle->resume_offset = 0;
+                return ESP_ERR_HTTPS_OTA_IN_PROGRESS;
+            }
             /* In case `esp_https_ota_read_img_desc` was invoked first,
                then the image data read there should be written to OTA partition
                */
             if (handle->binary_file_len) {
-                return _ota_write(handle, (const void *)handle->ota_upgrade_buf, handle->binary_file_len);
+                /* `binary_file_len` is accumulated again by _ota_write() */
+                int header_len = handle->binary_file_len;
+                handle->binary_file_len = 0;
+                return _ota_write(handle, (const void *)handle->ota_upgrade_buf, header_len);
             }
             /* falls through */
         case ESP_HTTPS_OTA_IN_PROGRESS:
+            if (handle->pipelined_write) {
+                /* Waits only if the writer task is still busy with both buffers */
+                if (!handle->read_buf) {
+                    xQueueReceive(handle->free_queue, &handle->read_buf, portMAX_DELAY);
+                }
+                if (handle->writer_err != ESP_OK) {
+                    return handle->writer_err;
+                }
+            } else {
+                handle->read_buf = handle->ota_upgrade_buf;
+            }
             data_read = esp_http_client_read(handle->http_client,
-                                             handle->ota_upgrade_buf,
+                                             handle->read_buf,
                                              handle->ota_upgrade_buf_size);
             if (data_read == 0) {
                 /*
@@ -306,10 +792,18 @@ esp_err_t esp_https_ota_perform(esp_https_ota_handle_t https_ota_handle)
                 }
                 ESP_LOGI(TAG, "Connection closed");
             } else if (data_read > 0) {
-                return _ota_write(handle, (const void *)handle->ota_upgrade_buf, data_read);
+                err = _ota_write(handle, (const void *)handle->read_buf, data_read);
+                handle->read_buf = NULL;
+                return err;
             } else {
                 return ESP_FAIL;
             }
+            if (handle->pipelined_write) {
+                err = _ota_writer_stop(handle);
+                if (err != ESP_OK) {
+                    return err;
+                }
+            }
             handle->state = ESP_HTTPS_OTA_SUCCESS;
             break;
          default:
@@ -340,15 +834,29 @@ esp_err_t esp_https_ota_finish(esp_https_ota_handle_t https_ota_handle)
     switch (handle->state) {
         case ESP_HTTPS_OTA_SUCCESS:
         case ESP_HTTPS_OTA_IN_PROGRESS:
-            err = esp_ota_end(handle->update_handle);
+            /* Flush the buffers still queued to the writer task before closing the image */
+            if (handle->pipelined_write && _ota_writer_stop(handle) != ESP_OK) {
+                esp_ota_end(handle->update_handle);
+                err = handle->writer_err;
+            } else {
+                err = esp_ota_end(handle->update_handle);
+            }
             /* falls through */
         case ESP_HTTPS_OTA_BEGIN:
+            if (handle->pipelined_write) {
+                _ota_pipeline_deinit(handle);
+            }
             if (handle->ota_upgrade_buf) {
                 free(handle->ota_upgrade_buf);
             }
             if (handle->http_client) {
                 _http_cleanup(handle->http_client);
             }
+            /* The progress is kept unless the whole image was downloaded */
+            if (handle->resumable && handle->state == ESP_HTTPS_OTA_SUCCESS) {
+                _ota_resume_discard(handle);
+            }
+            _ota_resume_deinit(handle);
             break;
         default:
             ESP_LOGE(TAG, "Invalid ESP HTTPS OTA State");
@@ -386,6 +894,12 @@ esp_err_t esp_https_ota(const esp_http_client_config_t *config)
 
     esp_https_ota_config_t ota_config = {
         .http_config = config,
+#if CONFIG_OTA_PIPELINED_WRITE
+        .pipelined_write = true,
+#endif
+#if CONFIG_OTA_RESUMABLE_DOWNLOAD
+        .resumable = true,
+#endif
     };
 
     esp_https_ota_handle_t https_ota_handle = NULL;
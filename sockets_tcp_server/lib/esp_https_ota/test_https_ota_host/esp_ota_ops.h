@@ -0,0 +1,32 @@
+#pragma once
+/* Subset of app_update used by esp_https_ota, writing to the emulated flash in ota_sim.cpp */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_SIZE_UNKNOWN 0xffffffff
+#define ESP_OTA_RESUME_STATE_MAX_SIZE 576
+
+#define ESP_ERR_OTA_BASE                         0x1500
+#define ESP_ERR_OTA_VALIDATE_FAILED              (ESP_ERR_OTA_BASE + 0x03)
+
+typedef uint32_t esp_ota_handle_t;
+
+const esp_partition_t *esp_ota_get_running_partition(void);
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from);
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle);
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size);
+esp_err_t esp_ota_end(esp_ota_handle_t handle);
+esp_err_t esp_ota_get_resume_state(esp_ota_handle_t handle, void *state, size_t *size);
+esp_err_t esp_ota_resume(const esp_partition_t *partition, const void *state, size_t size, esp_ota_handle_t *out_handle);
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,15 @@
+#pragma once
+/* FreeRTOS subset used by esp_https_ota, implemented on std::thread in freertos_sim.cpp */
+#include <stdint.h>
+#include "sdkconfig.h"
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE         ((BaseType_t)0)
+#define pdTRUE          ((BaseType_t)1)
+#define pdPASS          pdTRUE
+#define pdFAIL          pdFALSE
+#define portMAX_DELAY   ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS 1
@@ -0,0 +1,22 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+/* The task runs on a detached thread, which ends when the task function returns */
+BaseType_t xTaskCreate(TaskFunction_t task_code, const char *name, uint32_t stack_depth, void *parameters,
+                       UBaseType_t priority, TaskHandle_t *created_task);
+void vTaskDelete(TaskHandle_t task);
+
+/* Makes the following xTaskCreate() calls fail, as when there is no memory for the task */
+void freertos_sim_set_task_create_fail(bool fail);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,97 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <string.h>
+
+struct QueueDefinition {
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t> > items;
+    size_t length;
+    size_t item_size;
+};
+
+template <typename Pred>
+static bool wait(QueueDefinition *q, std::unique_lock<std::mutex> &lock, TickType_t ticks_to_wait, Pred pred)
+{
+    if (ticks_to_wait == portMAX_DELAY) {
+        q->changed.wait(lock, pred);
+        return true;
+    }
+    return q->changed.wait_for(lock, std::chrono::milliseconds(ticks_to_wait * portTICK_PERIOD_MS), pred);
+}
+
+static bool s_task_create_fail;
+
+extern "C" {
+
+void freertos_sim_set_task_create_fail(bool fail)
+{
+    s_task_create_fail = fail;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t task_code, const char *name, uint32_t stack_depth, void *parameters,
+                       UBaseType_t priority, TaskHandle_t *created_task)
+{
+    if (s_task_create_fail) {
+        return pdFAIL;
+    }
+    std::thread task(task_code, parameters);
+    if (created_task) {
+        *created_task = (TaskHandle_t)parameters;
+    }
+    task.detach();
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t queue_length, UBaseType_t item_size)
+{
+    QueueDefinition *q = new QueueDefinition;
+    q->length = queue_length;
+    q->item_size = item_size;
+    return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    std::unique_lock<std::mutex> lock(queue->lock);
+    if (!wait(queue, lock, ticks_to_wait, [queue] { return queue->items.size() < queue->length; })) {
+        return pdFALSE;
+    }
+    const uint8_t *data = (const uint8_t *)item;
+    queue->items.push_back(std::vector<uint8_t>(data, data + (item ? queue->item_size : 0)));
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait)
+{
+    std::unique_lock<std::mutex> lock(queue->lock);
+    if (!wait(queue, lock, ticks_to_wait, [queue] { return !queue->items.empty(); })) {
+        return pdFALSE;
+    }
+    if (buffer && queue->item_size) {
+        memcpy(buffer, queue->items.front().data(), queue->item_size);
+    }
+    queue->items.pop_front();
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    delete queue;
+}
+
+}
@@ -0,0 +1,483 @@
+#include "ota_sim.h"
+#include "esp_http_client.h"
+#include "esp_ota_ops.h"
+#include "esp_app_format.h"
+#include "esp_ota_compressed.h"
+#include "esp_ota_delta.h"
+
+#include "nvs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <mutex>
+#include <thread>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SECTOR_SIZE     4096
+#define BLOCK_SIZE      65536
+#define PAGE_SIZE       256
+#define OTA_HANDLE      1
+#define RESUME_MAGIC    0x4d495352
+
+struct esp_http_client {
+    size_t pos;
+    size_t sent;            /* Bytes sent on this connection */
+    int status;
+    std::string range;
+    std::string if_range;
+    http_event_handle_cb event_handler;
+    void *user_data;
+};
+
+/* State saved by esp_ota_get_resume_state() */
+struct ota_resume_state {
+    uint32_t magic;
+    uint32_t written;
+};
+
+static ota_sim_config s_config;
+static std::vector<uint8_t> s_image;
+static unsigned s_image_version;    /* ETag of the image */
+static std::vector<uint8_t> s_partition;
+static esp_partition_t s_update_partition;
+static std::vector<uint8_t> s_running_image;
+static esp_partition_t s_running_partition;
+static size_t s_written;
+static size_t s_downloaded;
+static bool s_ota_open;
+static bool s_ota_compressed;
+static std::map<std::string, std::vector<uint8_t> > s_nvs;
+static bool s_boot_set;
+
+static void sim_delay(double ms)
+{
+    std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(ms * s_config.time_scale));
+}
+
+ota_sim_config ota_sim_default_config()
+{
+    ota_sim_config config;
+    config.partition_size = 0x180000;
+    config.net_bytes_per_sec = 250 * 1024;
+    config.sector_erase_ms = 45;
+    config.block_erase_ms = 150;
+    config.page_program_ms = 0.6;
+    config.time_scale = 0.1;
+    config.fail_write_at = 0;
+    config.disconnect_after = 0;
+    config.ignore_range = false;
+    return config;
+}
+
+void ota_sim_init(const ota_sim_config &config, const std::vector<uint8_t> &image)
+{
+    s_config = config;
+    s_image = image;
+    s_image_version = 1;
+    s_partition.assign(config.partition_size, 0);
+    memset(&s_update_partition, 0, sizeof(s_update_partition));
+    s_update_partition.subtype = 0x10;
+    s_update_partition.address = 0x110000;
+    s_update_partition.size = config.partition_size;
+    strcpy(s_update_partition.label, "ota_0");
+    s_written = 0;
+    s_downloaded = 0;
+    s_ota_open = false;
+    s_boot_set = false;
+    s_nvs.clear();
+}
+
+void ota_sim_set_server(size_t disconnect_after, bool ignore_range)
+{
+    s_config.disconnect_after = disconnect_after;
+    s_config.ignore_range = ignore_range;
+}
+
+void ota_sim_set_server_image(const std::vector<uint8_t> &image)
+{
+    s_image = image;
+    s_image_version++;
+}
+
+void ota_sim_set_fail_write_at(size_t offset)
+{
+    s_config.fail_write_at = offset;
+}
+
+size_t ota_sim_downloaded()
+{
+    return s_downloaded;
+}
+
+void ota_sim_set_running_image(const std::vector<uint8_t> &image)
+{
+    s_running_image = image;
+    memset(&s_running_partition, 0, sizeof(s_running_partition));
+    s_running_partition.subtype = 0x10;
+    s_running_partition.address = 0x10000;
+    s_running_partition.size = 0x100000;
+    strcpy(s_running_partition.label, "factory");
+}
+
+const std::vector<uint8_t> &ota_sim_partition()
+{
+    return s_partition;
+}
+
+size_t ota_sim_written()
+{
+    return s_written;
+}
+
+bool ota_sim_boot_partition_set()
+{
+    return s_boot_set;
+}
+
+std::vector<uint8_t> ota_sim_make_image(size_t size, unsigned seed)
+{
+    std::vector<uint8_t> image(size);
+    srand(seed);
+    for (size_t i = 0; i < size; i++) {
+        image[i] = rand();
+    }
+    image[0] = ESP_IMAGE_HEADER_MAGIC;
+    return image;
+}
+
+extern "C" {
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    return "ERROR";
+}
+
+static std::string etag()
+{
+    return "\"" + std::to_string(s_image_version) + "\"";
+}
+
+static void dispatch_event(esp_http_client_handle_t client, esp_http_client_event_id_t event_id,
+                           const char *header_key = NULL, const char *header_value = NULL)
+{
+    if (client->event_handler) {
+        esp_http_client_event_t event = {};
+        event.event_id = event_id;
+        event.client = client;
+        event.user_data = client->user_data;
+        event.header_key = (char *)header_key;
+        event.header_value = (char *)header_value;
+        client->event_handler(&event);
+    }
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    esp_http_client_handle_t client = new esp_http_client();
+    client->event_handler = config->event_handler;
+    client->user_data = config->user_data;
+    return client;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len)
+{
+    unsigned long offset = 0;
+    client->pos = 0;
+    client->sent = 0;
+    client->status = HttpStatus_Ok;
+    /* The whole image is sent when it no longer is the image of If-Range */
+    if (!client->range.empty() && !s_config.ignore_range && sscanf(client->range.c_str(), "bytes=%lu-", &offset) == 1
+        && offset < s_image.size() && (client->if_range.empty() || client->if_range == etag())) {
+        client->pos = offset;
+        client->status = HttpStatus_PartialContent;
+    }
+    dispatch_event(client, HTTP_EVENT_HEADERS_SENT);
+    return ESP_OK;
+}
+
+int esp_http_client_fetch_headers(esp_http_client_handle_t client)
+{
+    dispatch_event(client, HTTP_EVENT_ON_HEADER, "Content-Type", "application/octet-stream");
+    dispatch_event(client, HTTP_EVENT_ON_HEADER, "ETag", etag().c_str());
+    return esp_http_client_get_content_length(client);
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value)
+{
+    if (strcmp(key, "Range") == 0) {
+        client->range = value;
+    } else if (strcmp(key, "If-Range") == 0) {
+        client->if_range = value;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t client, const char *key)
+{
+    if (strcmp(key, "Range") == 0) {
+        client->range.clear();
+    } else if (strcmp(key, "If-Range") == 0) {
+        client->if_range.clear();
+    }
+    return ESP_OK;
+}
+
+int esp_http_client_get_content_length(esp_http_client_handle_t client)
+{
+    return s_image.size() - (client->status == HttpStatus_PartialContent ? client->pos : 0);
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return client->status;
+}
+
+esp_err_t esp_http_client_set_redirection(esp_http_client_handle_t client)
+{
+    return ESP_OK;
+}
+
+void esp_http_client_add_auth(esp_http_client_handle_t client)
+{
+}
+
+/* Like the real client, fills the buffer unless the end of the body is reached */
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
+{
+    size_t n = s_image.size() - client->pos;
+    if (n > (size_t)len) {
+        n = len;
+    }
+    errno = 0;
+    if (s_config.disconnect_after) {
+        if (client->sent == s_config.disconnect_after) {
+            /* Like the real client once the transport read failed */
+            errno = ECONNRESET;
+            return 0;
+        }
+        n = std::min(n, s_config.disconnect_after - client->sent);
+    }
+    sim_delay(n * 1000.0 / s_config.net_bytes_per_sec);
+    memcpy(buffer, s_image.data() + client->pos, n);
+    client->pos += n;
+    client->sent += n;
+    s_downloaded += n;
+    return n;
+}
+
+bool esp_http_client_is_complete_data_received(esp_http_client_handle_t client)
+{
+    return client->pos == s_image.size();
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    delete client;
+    return ESP_OK;
+}
+
+const esp_partition_t *esp_ota_get_running_partition(void)
+{
+    return &s_running_partition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    if (partition == &s_update_partition && src_offset + size <= s_partition.size()) {
+        memcpy(dst, s_partition.data() + src_offset, size);
+        return ESP_OK;
+    }
+    if (partition != &s_running_partition || src_offset + size > partition->size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    /* Erased flash after the image */
+    memset(dst, 0xff, size);
+    if (src_offset < s_running_image.size()) {
+        memcpy(dst, s_running_image.data() + src_offset, std::min(size, s_running_image.size() - src_offset));
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_get_sha256(const esp_partition_t *partition, uint8_t *sha_256)
+{
+    if (partition != &s_running_partition || s_running_image.size() < 32) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(sha_256, s_running_image.data() + s_running_image.size() - 32, 32);
+    return ESP_OK;
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+    return &s_update_partition;
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+{
+    size_t size = (image_size == 0 || image_size == OTA_SIZE_UNKNOWN) ? partition->size :
+                  (image_size + SECTOR_SIZE - 1) & ~(SECTOR_SIZE - 1);
+    /* Sectors up to the first block boundary, whole blocks, then the remaining sectors */
+    size_t blocks = size / BLOCK_SIZE;
+    sim_delay(blocks * s_config.block_erase_ms + (size - blocks * BLOCK_SIZE) / SECTOR_SIZE * s_config.sector_erase_ms);
+    memset(s_partition.data(), 0xff, size);
+    s_written = 0;
+    s_ota_open = true;
+    s_ota_compressed = false;
+    *out_handle = OTA_HANDLE;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_get_resume_state(esp_ota_handle_t handle, void *state, size_t *size)
+{
+    if (handle != OTA_HANDLE || !s_ota_open) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (s_ota_compressed) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (s_written % SECTOR_SIZE != 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (*size < sizeof(ota_resume_state)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    ota_resume_state saved = { RESUME_MAGIC, (uint32_t)s_written };
+    memcpy(state, &saved, sizeof(saved));
+    *size = sizeof(saved);
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_resume(const esp_partition_t *partition, const void *state, size_t size, esp_ota_handle_t *out_handle)
+{
+    ota_resume_state saved;
+    if (partition != &s_update_partition || size != sizeof(saved)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(&saved, state, sizeof(saved));
+    if (saved.magic != RESUME_MAGIC || saved.written == 0 || saved.written % SECTOR_SIZE != 0
+        || saved.written > s_partition.size()) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    /* Erases the rest of the partition, like esp_ota_begin() with OTA_SIZE_UNKNOWN */
+    size_t size_erased = s_partition.size() - saved.written;
+    size_t blocks = size_erased / BLOCK_SIZE;
+    sim_delay(blocks * s_config.block_erase_ms + (size_erased - blocks * BLOCK_SIZE) / SECTOR_SIZE * s_config.sector_erase_ms);
+    memset(s_partition.data() + saved.written, 0xff, size_erased);
+    s_written = saved.written;
+    s_ota_open = true;
+    s_ota_compressed = false;
+    *out_handle = OTA_HANDLE;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+    const uint8_t *data_bytes = (const uint8_t *)data;
+    if (handle != OTA_HANDLE || !s_ota_open) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    /* Compressed and delta images are passed as is, esp_ota_write() decompressing and applying them is tested in app_update */
+    if (s_written == 0 && size > 0 && data_bytes[0] != ESP_IMAGE_HEADER_MAGIC && !esp_ota_is_compressed_image(data, size)
+        && !esp_ota_is_delta_image(data, size)) {
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    if (s_written == 0 && size > 0 && data_bytes[0] != ESP_IMAGE_HEADER_MAGIC) {
+        s_ota_compressed = true;
+    }
+    if (s_written + size > s_partition.size()) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (s_config.fail_write_at && s_written <= s_config.fail_write_at && s_config.fail_write_at < s_written + size) {
+        return ESP_ERR_FLASH_OP_FAIL;
+    }
+    size_t pages = (s_written + size + PAGE_SIZE - 1) / PAGE_SIZE - s_written / PAGE_SIZE;
+    sim_delay(pages * s_config.page_program_ms);
+    memcpy(s_partition.data() + s_written, data_bytes, size);
+    s_written += size;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+    if (handle != OTA_HANDLE || !s_ota_open) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    s_ota_open = false;
+    return s_written ? ESP_OK : ESP_ERR_OTA_VALIDATE_FAILED;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition)
+{
+    s_boot_set = true;
+    return ESP_OK;
+}
+
+/* A single namespace is enough for esp_https_ota */
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+static esp_err_t nvs_get(const char *key, void *out_value, size_t *length)
+{
+    auto it = s_nvs.find(key);
+    if (it == s_nvs.end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (out_value) {
+        if (*length < it->second.size()) {
+            return ESP_ERR_NVS_INVALID_LENGTH;
+        }
+        memcpy(out_value, it->second.data(), it->second.size());
+    }
+    *length = it->second.size();
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    s_nvs[key].assign(value, value + strlen(value) + 1);
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+{
+    return nvs_get(key, out_value, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    s_nvs[key].assign((const uint8_t *)value, (const uint8_t *)value + length);
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    return nvs_get(key, out_value, length);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    return s_nvs.erase(key) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+/*
+ * Simulated OTA server and emulated flash.
+ *
+ * esp_http_client_read() returns the image after the time it takes to receive it at `net_bytes_per_sec`,
+ * esp_ota_begin() erases the update partition and esp_ota_write() programs it with the latencies of
+ * a SPI NOR flash chip. All the latencies are slept for real, multiplied by `time_scale`, so that
+ * the download and the flash write overlap as they would on the target when pipelined.
+ *
+ * The server sends an ETag changed by ota_sim_set_server_image(), answers a `Range: bytes=<offset>-` request
+ * with the rest of the image (status 206) unless `If-Range` holds another ETag, and can reset the connection
+ * after sending some data. NVS is kept in memory until ota_sim_init().
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#define ESP_ERR_FLASH_BASE      0x6000
+#define ESP_ERR_FLASH_OP_FAIL   (ESP_ERR_FLASH_BASE + 1)
+
+struct ota_sim_config {
+    size_t partition_size;
+    double net_bytes_per_sec;   /* TLS payload throughput */
+    double sector_erase_ms;     /* 4 KB sector erase */
+    double block_erase_ms;      /* 64 KB block erase, used for aligned ranges like spi_flash_erase_range() */
+    double page_program_ms;     /* 256 B page program */
+    double time_scale;          /* real time slept per simulated time */
+    size_t fail_write_at;       /* esp_ota_write() covering this offset fails, 0 to never fail */
+    size_t disconnect_after;    /* The server resets each connection after sending this many bytes, 0 to never reset */
+    bool ignore_range;          /* The server sends the whole image to a Range request (status 200) */
+};
+
+/* Typical values: 2 Mbit/s TLS download, sector/block erase and page program times of a 32 Mbit NOR flash */
+ota_sim_config ota_sim_default_config();
+
+void ota_sim_init(const ota_sim_config &config, const std::vector<uint8_t> &image);
+
+/* Changes the server configuration or the image it sends, keeping the partition and NVS contents */
+void ota_sim_set_server(size_t disconnect_after, bool ignore_range);
+void ota_sim_set_server_image(const std::vector<uint8_t> &image);
+void ota_sim_set_fail_write_at(size_t offset);
+
+/* Number of bytes of the image sent by the server since ota_sim_init() */
+size_t ota_sim_downloaded();
+
+/* Sets the app image of the running partition, the source of delta images. Its last 32 bytes are its SHA-256. */
+void ota_sim_set_running_image(const std::vector<uint8_t> &image);
+
+/* Contents of the update partition */
+const std::vector<uint8_t> &ota_sim_partition();
+
+/* Number of bytes written by esp_ota_write() */
+size_t ota_sim_written();
+
+bool ota_sim_boot_partition_set();
+
+/* Builds an image with a valid header magic followed by pseudo random data */
+std::vector<uint8_t> ota_sim_make_image(size_t size, unsigned seed);
@@ -0,0 +1,5 @@
+#define CONFIG_IDF_TARGET_ESP32 1
+#define CONFIG_OTA_ALLOW_HTTP 1
+#define CONFIG_OTA_WRITER_TASK_STACK_SIZE 4096
+#define CONFIG_OTA_WRITER_TASK_PRIORITY 5
+#define CONFIG_OTA_RESUME_CHECKPOINT_KB 16
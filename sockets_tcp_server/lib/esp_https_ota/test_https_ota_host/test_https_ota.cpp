@@ -0,0 +1,434 @@
+#include "catch.hpp"
+#include "esp_https_ota.h"
+#include "esp_ota_ops.h"
+#include "esp_ota_compressed.h"
+#include "esp_ota_delta.h"
+#include "esp32/rom/miniz.h"
+#include "freertos/task.h"
+#include "ota_sim.h"
+#include "sdkconfig.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+static esp_app_desc_t s_app_desc;
+static int s_headers_received;
+
+static esp_err_t http_event_handler(esp_http_client_event_t *evt)
+{
+    if (evt->event_id == HTTP_EVENT_ON_HEADER) {
+        (*(int *)evt->user_data)++;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t run_ota(bool pipelined, int buffer_size, bool read_img_desc, bool resumable = false)
+{
+    esp_http_client_config_t http_config = {};
+    http_config.url = "http://ota.local/app.bin";
+    http_config.buffer_size = buffer_size;
+    http_config.event_handler = http_event_handler;
+    http_config.user_data = &s_headers_received;
+    esp_https_ota_config_t ota_config = {};
+    ota_config.http_config = &http_config;
+    ota_config.pipelined_write = pipelined;
+    ota_config.resumable = resumable;
+
+    esp_https_ota_handle_t handle = NULL;
+    esp_err_t err = esp_https_ota_begin(&ota_config, &handle);
+    REQUIRE(err == ESP_OK);
+    if (read_img_desc) {
+        err = esp_https_ota_get_img_desc(handle, &s_app_desc);
+        if (err != ESP_OK) {
+            /* The connection was reset before the image header was received */
+            esp_https_ota_finish(handle);
+            return err;
+        }
+    }
+    do {
+        err = esp_https_ota_perform(handle);
+    } while (err == ESP_ERR_HTTPS_OTA_IN_PROGRESS);
+    if (err == ESP_OK) {
+        CHECK(esp_https_ota_is_complete_data_received(handle));
+        CHECK(esp_https_ota_get_image_len_read(handle) == (int)ota_sim_written());
+    }
+    esp_err_t finish_err = esp_https_ota_finish(handle);
+    return err != ESP_OK ? err : finish_err;
+}
+
+static void check_partition(const std::vector<uint8_t> &image)
+{
+    const std::vector<uint8_t> &partition = ota_sim_partition();
+    REQUIRE(ota_sim_written() == image.size());
+    CHECK(memcmp(partition.data(), image.data(), image.size()) == 0);
+    CHECK(ota_sim_boot_partition_set());
+}
+
+static ota_sim_config fast_config()
+{
+    ota_sim_config config = ota_sim_default_config();
+    config.partition_size = 0x40000;
+    config.time_scale = 0.01;
+    return config;
+}
+
+TEST_CASE("serial and pipelined write store the complete image", "[esp_https_ota]")
+{
+    std::vector<uint8_t> image = ota_sim_make_image(200 * 1024 + 123, 1);
+    for (int pipelined = 0; pipelined < 2; pipelined++) {
+        for (int read_img_desc = 0; read_img_desc < 2; read_img_desc++) {
+            for (int buffer_size : { 0, 1000, 4096 }) {
+                ota_sim_init(fast_config(), image);
+                CHECK(run_ota(pipelined, buffer_size, read_img_desc) == ESP_OK);
+                check_partition(image);
+            }
+        }
+    }
+}
+
+TEST_CASE("flash write error stops the update", "[esp_https_ota]")
+{
+    std::vector<uint8_t> image = ota_sim_make_image(64 * 1024, 2);
+    ota_sim_config config = fast_config();
+    for (size_t fail_at : { (size_t)100, (size_t)30000, image.size() - 1 }) {
+        for (int pipelined = 0; pipelined < 2; pipelined++) {
+            config.fail_write_at = fail_at;
+            ota_sim_init(config, image);
+            CHECK(run_ota(pipelined, 4096, false) == ESP_ERR_FLASH_OP_FAIL);
+            CHECK(ota_sim_written() <= fail_at);
+            CHECK_FALSE(ota_sim_boot_partition_set());
+        }
+    }
+}
+
+TEST_CASE("pipelined write falls back to serial write without writer task", "[esp_https_ota]")
+{
+    std::vector<uint8_t> image = ota_sim_make_image(64 * 1024 + 17, 4);
+    freertos_sim_set_task_create_fail(true);
+    for (int read_img_desc = 0; read_img_desc < 2; read_img_desc++) {
+        ota_sim_init(fast_config(), image);
+        CHECK(run_ota(true, 4096, read_img_desc) == ESP_OK);
+        check_partition(image);
+    }
+    freertos_sim_set_task_create_fail(false);
+}
+
+TEST_CASE("image with invalid magic byte is rejected", "[esp_https_ota]")
+{
+    std::vector<uint8_t> image = ota_sim_make_image(32 * 1024, 3);
+    image[0] = 0;
+    for (int pipelined = 0; pipelined < 2; pipelined++) {
+        ota_sim_init(fast_config(), image);
+        CHECK(run_ota(pipelined, 4096, false) == ESP_ERR_OTA_VALIDATE_FAILED);
+        CHECK(ota_sim_written() == 0);
+        CHECK_FALSE(ota_sim_boot_partition_set());
+    }
+}
+
+static std::vector<uint8_t> compress_image(const std::vector<uint8_t> &image)
+{
+    tdefl_compressor *comp = new tdefl_compressor;
+    std::vector<uint8_t> container(sizeof(esp_ota_compressed_header_t) + image.size() + 1024);
+    size_t in_size = image.size();
+    size_t out_size = container.size() - sizeof(esp_ota_compressed_header_t);
+    REQUIRE(tdefl_init(comp, NULL, NULL, TDEFL_WRITE_ZLIB_HEADER | 128) == TDEFL_STATUS_OKAY);
+    REQUIRE(tdefl_compress(comp, image.data(), &in_size, container.data() + sizeof(esp_ota_compressed_header_t),
+                           &out_size, TDEFL_FINISH) == TDEFL_STATUS_DONE);
+    delete comp;
+    esp_ota_compressed_header_t header = {};
+    header.magic = ESP_OTA_COMPRESSED_MAGIC;
+    header.version = ESP_OTA_COMPRESSED_VERSION;
+    header.compression = ESP_OTA_COMPRESSION_ZLIB;
+    header.header_size = sizeof(header);
+    header.image_size = image.size();
+    header.data_size = out_size;
+    memcpy(container.data(), &header, sizeof(header));
+    container.resize(sizeof(header) + out_size);
+    return container;
+}
+
+static esp_err_t append(void *ctx, const void *data, size_t size)
+{
+    std::vector<uint8_t> *out = static_cast<std::vector<uint8_t> *>(ctx);
+    out->insert(out->end(), (const uint8_t *)data, (const uint8_t *)data + size);
+    return ESP_OK;
+}
+
+TEST_CASE("app description is read from the decompressed header of a compressed image", "[esp_https_ota]")
+{
+    std::vector<uint8_t> image(150 * 1024);
+    for (size_t i = 0; i < image.size(); i++) {
+        image[i] = (i * 7 / 13) ^ (i >> 9);
+    }
+    image[0] = ESP_IMAGE_HEADER_MAGIC;
+    esp_app_desc_t desc = {};
+    desc.magic_word = ESP_APP_DESC_MAGIC_WORD;
+    strcpy(desc.version, "v2.1.0-ota");
+    strcpy(desc.project_name, "sockets_tcp_server");
+    memcpy(&image[sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t)], &desc, sizeof(desc));
+    std::vector<uint8_t> container = compress_image(image);
+
+    for (int pipelined = 0; pipelined < 2; pipelined++) {
+        for (int buffer_size : { 0, 512, 4096 }) {
+            memset(&s_app_desc, 0, sizeof(s_app_desc));
+            ota_sim_init(fast_config(), container);
+            CHECK(run_ota(pipelined, buffer_size, true) == ESP_OK);
+            CHECK(s_app_desc.magic_word == ESP_APP_DESC_MAGIC_WORD);
+            CHECK(std::string(s_app_desc.version) == desc.version);
+            CHECK(std::string(s_app_desc.project_name) == desc.project_name);
+
+            /* The compressed image is passed to esp_ota_write() as downloaded */
+            REQUIRE(ota_sim_written() == container.size());
+            std::vector<uint8_t> decompressed;
+            esp_ota_decompress_handle_t h = esp_ota_decompress_begin(append, &decompressed);
+            CHECK(esp_ota_decompress_write(h, ota_sim_partition().data(), ota_sim_written()) == ESP_OK);
+            CHECK(esp_ota_decompress_end(h) == ESP_OK);
+            CHECK(decompressed == image);
+        }
+    }
+}
+
+/* Delta image of a single record: the diff against the whole running image, then the rest of the new image */
+static std::vector<uint8_t> make_delta(const std::vector<uint8_t> &source, const std::vector<uint8_t> &image)
+{
+    uint32_t diff_len = std::min(source.size(), image.size());
+    uint32_t control[3] = { diff_len, (uint32_t)image.size() - diff_len, 0 };
+    std::vector<uint8_t> patch((const uint8_t *)control, (const uint8_t *)control + sizeof(control));
+    for (size_t i = 0; i < diff_len; i++) {
+        patch.push_back(image[i] - source[i]);
+    }
+    patch.insert(patch.end(), image.begin() + diff_len, image.end());
+
+    esp_ota_delta_header_t header = {};
+    header.magic = ESP_OTA_DELTA_MAGIC;
+    header.version = ESP_OTA_DELTA_VERSION;
+    header.header_size = sizeof(header);
+    header.source_size = source.size();
+    memcpy(header.source_sha256, source.data() + source.size() - 32, 32);
+    header.image_size = image.size();
+    std::vector<uint8_t> delta((const uint8_t *)&header, (const uint8_t *)&header + sizeof(header));
+    std::vector<uint8_t> container = compress_image(patch);
+    delta.insert(delta.end(), container.begin(), container.end());
+    return delta;
+}
+
+TEST_CASE("app description is read from the header made from a delta image", "[esp_https_ota]")
+{
+    std::vector<uint8_t> source = ota_sim_make_image(120 * 1024, 5);
+    esp_app_desc_t desc = {};
+    desc.magic_word = ESP_APP_DESC_MAGIC_WORD;
+    strcpy(desc.version, "v2.0.0");
+    memcpy(&source[sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t)], &desc, sizeof(desc));
+    std::vector<uint8_t> image = source;
+    strcpy(desc.version, "v2.1.0-delta");
+    memcpy(&image[sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t)], &desc, sizeof(desc));
+    image.insert(image.begin() + 50000, 3000, 0x5a);
+    std::vector<uint8_t> delta = make_delta(source, image);
+    ota_sim_set_running_image(source);
+
+    for (int pipelined = 0; pipelined < 2; pipelined++) {
+        for (int buffer_size : { 0, 512, 4096 }) {
+            memset(&s_app_desc, 0, sizeof(s_app_desc));
+            ota_sim_init(fast_config(), delta);
+            CHECK(run_ota(pipelined, buffer_size, true) == ESP_OK);
+            CHECK(s_app_desc.magic_word == ESP_APP_DESC_MAGIC_WORD);
+            CHECK(std::string(s_app_desc.version) == desc.version);
+
+            /* The delta image is passed to esp_ota_write() as downloaded */
+            REQUIRE(ota_sim_written() == delta.size());
+            std::vector<uint8_t> patched;
+            esp_ota_delta_handle_t h = esp_ota_delta_begin(esp_ota_get_running_partition(), append, &patched);
+            CHECK(esp_ota_delta_write(h, ota_sim_partition().data(), ota_sim_written()) == ESP_OK);
+            CHECK(esp_ota_delta_end(h) == ESP_OK);
+            CHECK(patched == image);
+        }
+    }
+}
+
+#define CHECKPOINT_SIZE (CONFIG_OTA_RESUME_CHECKPOINT_KB * 1024)
+
+/* Runs the OTA until it succeeds, returns the number of attempts */
+static int run_ota_until_done(bool pipelined, int buffer_size, bool read_img_desc, bool resumable, int max_attempts)
+{
+    for (int attempt = 1; attempt <= max_attempts; attempt++) {
+        esp_err_t err = run_ota(pipelined, buffer_size, read_img_desc, resumable);
+        if (err == ESP_OK) {
+            return attempt;
+        }
+        CHECK(err == ESP_FAIL);
+        CHECK_FALSE(ota_sim_boot_partition_set());
+    }
+    return 0;
+}
+
+static std::vector<uint8_t> make_image_with_desc(size_t size, unsigned seed, const char *version)
+{
+    std::vector<uint8_t> image = ota_sim_make_image(size, seed);
+    esp_app_desc_t desc = {};
+    desc.magic_word = ESP_APP_DESC_MAGIC_WORD;
+    strcpy(desc.version, version);
+    memcpy(&image[sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t)], &desc, sizeof(desc));
+    return image;
+}
+
+TEST_CASE("interrupted download resumes from the last checkpoint", "[esp_https_ota][resume]")
+{
+    std::vector<uint8_t> image = make_image_with_desc(200 * 1024 + 123, 6, "v3.0.0-resumed");
+    const size_t disconnect_after = 50000;
+    ota_sim_config config = fast_config();
+    config.disconnect_after = disconnect_after;
+    for (int pipelined = 0; pipelined < 2; pipelined++) {
+        for (int read_img_desc = 0; read_img_desc < 2; read_img_desc++) {
+            for (int buffer_size : { 1000, 4096 }) {
+                memset(&s_app_desc, 0, sizeof(s_app_desc));
+                ota_sim_init(config, image);
+                int attempts = run_ota_until_done(pipelined, buffer_size, read_img_desc, true, 20);
+                REQUIRE(attempts > 1);
+                check_partition(image);
+                if (read_img_desc) {
+                    /* Read from the partition when the download is resumed */
+                    CHECK(std::string(s_app_desc.version) == "v3.0.0-resumed");
+                }
+                /* Each attempt downloads again at most the data after the last checkpoint */
+                CHECK(ota_sim_downloaded() <= image.size() + (attempts - 1) * CHECKPOINT_SIZE);
+                CHECK(attempts <= (int)(image.size() / (disconnect_after - CHECKPOINT_SIZE)) + 1);
+            }
+        }
+    }
+}
+
+TEST_CASE("download starts over without resumable config", "[esp_https_ota][resume]")
+{
+    std::vector<uint8_t> image = ota_sim_make_image(100 * 1024, 7);
+    ota_sim_config config = fast_config();
+    config.disconnect_after = 60000;
+    for (int pipelined = 0; pipelined < 2; pipelined++) {
+        ota_sim_init(config, image);
+        CHECK(run_ota(pipelined, 4096, false) == ESP_FAIL);
+        ota_sim_set_server(0, false);
+        CHECK(run_ota(pipelined, 4096, false, true) == ESP_OK);
+        check_partition(image);
+        CHECK(ota_sim_downloaded() == 60000 + image.size());
+    }
+}
+
+TEST_CASE("download starts over when the server ignores the range", "[esp_https_ota][resume]")
+{
+    std::vector<uint8_t> image = ota_sim_make_image(100 * 1024, 8);
+    ota_sim_config config = fast_config();
+    config.disconnect_after = 60000;
+    for (int pipelined = 0; pipelined < 2; pipelined++) {
+        ota_sim_init(config, image);
+        CHECK(run_ota(pipelined, 4096, false, true) == ESP_FAIL);
+        ota_sim_set_server(0, true);
+        CHECK(run_ota(pipelined, 4096, false, true) == ESP_OK);
+        check_partition(image);
+        CHECK(ota_sim_downloaded() == 60000 + image.size());
+    }
+}
+
+TEST_CASE("download starts over when the image changed on the server", "[esp_https_ota][resume]")
+{
+    std::vector<uint8_t> image = ota_sim_make_image(100 * 1024, 9);
+    std::vector<uint8_t> new_image = ota_sim_make_image(110 * 1024, 10);
+    ota_sim_config config = fast_config();
+    config.disconnect_after = 60000;
+    for (int pipelined = 0; pipelined < 2; pipelined++) {
+        ota_sim_init(config, image);
+        CHECK(run_ota(pipelined, 4096, false, true) == ESP_FAIL);
+        ota_sim_set_server(0, false);
+        ota_sim_set_server_image(new_image);
+        CHECK(run_ota(pipelined, 4096, false, true) == ESP_OK);
+        check_partition(new_image);
+        CHECK(ota_sim_downloaded() == 60000 + new_image.size());
+
+        /* The progress is forgotten once the download is complete */
+        CHECK(run_ota(pipelined, 4096, false, true) == ESP_OK);
+        CHECK(ota_sim_downloaded() == 60000 + 2 * new_image.size());
+    }
+}
+
+TEST_CASE("download starts over when the image changed to one of the same length", "[esp_https_ota][resume]")
+{
+    std::vector<uint8_t> image = ota_sim_make_image(100 * 1024, 12);
+    std::vector<uint8_t> new_image = ota_sim_make_image(100 * 1024, 13);
+    ota_sim_config config = fast_config();
+    config.disconnect_after = 60000;
+    for (int pipelined = 0; pipelined < 2; pipelined++) {
+        ota_sim_init(config, image);
+        s_headers_received = 0;
+        CHECK(run_ota(pipelined, 4096, false, true) == ESP_FAIL);
+        /* The event handler of the http_config still gets the events, with its user data */
+        CHECK(s_headers_received > 0);
+        ota_sim_set_server(0, false);
+        ota_sim_set_server_image(new_image);
+        CHECK(run_ota(pipelined, 4096, false, true) == ESP_OK);
+        check_partition(new_image);
+        /* The whole new image is sent in answer to the If-Range request */
+        CHECK(ota_sim_downloaded() == 60000 + new_image.size());
+    }
+}
+
+TEST_CASE("download of a compressed image starts over", "[esp_https_ota][resume]")
+{
+    std::vector<uint8_t> image(150 * 1024);
+    for (size_t i = 0; i < image.size(); i++) {
+        image[i] = rand() % 4;
+    }
+    image[0] = ESP_IMAGE_HEADER_MAGIC;
+    std::vector<uint8_t> container = compress_image(image);
+    ota_sim_config config = fast_config();
+    config.disconnect_after = container.size() - 1000;
+    REQUIRE(container.size() > 2 * CHECKPOINT_SIZE);
+    for (int pipelined = 0; pipelined < 2; pipelined++) {
+        ota_sim_init(config, container);
+        CHECK(run_ota(pipelined, 4096, false, true) == ESP_FAIL);
+        ota_sim_set_server(0, false);
+        CHECK(run_ota(pipelined, 4096, false, true) == ESP_OK);
+        check_partition(container);
+        CHECK(ota_sim_downloaded() == 2 * container.size() - 1000);
+    }
+}
+
+TEST_CASE("flash write error keeps the progress", "[esp_https_ota][resume]")
+{
+    std::vector<uint8_t> image = ota_sim_make_image(100 * 1024, 11);
+    ota_sim_config config = fast_config();
+    config.fail_write_at = 70000;
+    for (int pipelined = 0; pipelined < 2; pipelined++) {
+        ota_sim_init(config, image);
+        CHECK(run_ota(pipelined, 4096, false, true) == ESP_ERR_FLASH_OP_FAIL);
+        ota_sim_set_fail_write_at(0);
+        size_t downloaded = ota_sim_downloaded();
+        CHECK(run_ota(pipelined, 4096, false, true) == ESP_OK);
+        check_partition(image);
+        /* Continued from the last checkpoint before the failed write */
+        CHECK(ota_sim_downloaded() - downloaded == image.size() - 70000 / CHECKPOINT_SIZE * CHECKPOINT_SIZE);
+    }
+}
+
+TEST_CASE("total OTA time with serial and pipelined write", "[esp_https_ota][timing]")
+{
+    std::vector<uint8_t> image = ota_sim_make_image(1024 * 1024, 4);
+    ota_sim_config config = ota_sim_default_config();
+
+    printf("OTA of %zu KB, download %.0f KB/s, erase %.0f ms/64 KB, program %.2f ms/256 B\n",
+           image.size() / 1024, config.net_bytes_per_sec / 1024, config.block_erase_ms, config.page_program_ms);
+    printf("buffer [B]  serial [s]  pipelined [s]  speedup\n");
+    for (int buffer_size : { 1024, 4096 }) {
+        double seconds[2];
+        for (int pipelined = 0; pipelined < 2; pipelined++) {
+            ota_sim_init(config, image);
+            auto start = std::chrono::steady_clock::now();
+            REQUIRE(run_ota(pipelined, buffer_size, false) == ESP_OK);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            check_partition(image);
+            /* Back to the simulated time of the target */
+            seconds[pipelined] = elapsed.count() / config.time_scale;
+        }
+        printf("%10d  %10.2f  %13.2f  %6.2fx\n", buffer_size, seconds[0], seconds[1], seconds[0] / seconds[1]);
+        CHECK(seconds[1] < seconds[0]);
+    }
+}
@@ -80,6 +80,7 @@ static sys_sem_t api_lock_sem = NULL;
 static bool tcpip_initialized = false;
 static esp_netif_t *s_last_default_esp_netif = NULL;
 
+#if !LWIP_TCPIP_CORE_LOCKING
 /**
  * @brief Api callback from tcpip thread used to call esp-netif
  * function in lwip task context
@@ -98,10 +99,14 @@ static void esp_netif_api_cb(void *api_msg)
     sys_sem_signal(&api_sync_sem);
 
 }
+#endif /* !LWIP_TCPIP_CORE_LOCKING */
 
 /**
  * @brief Initiates a tcpip remote call if called from another task
  * or calls the function directly if executed from lwip task
+ *
+ * With core locking, the function is called in the calling task with the core lock held
+ * (taken here, unless the task already holds it, e.g. in the lwip task or in an lwip callback)
  */
 static inline esp_err_t esp_netif_lwip_ipc_call(esp_netif_api_fn fn, esp_netif_t *netif, void *data)
 {
@@ -110,6 +115,15 @@ static inline esp_err_t esp_netif_lwip_ipc_call(esp_netif_api_fn fn, esp_netif_t
             .data = data,
             .api_fn = fn
     };
+#if LWIP_TCPIP_CORE_LOCKING
+    if (!sys_tcpip_core_locked()) {
+        ESP_LOGD(TAG, "check: locked, if=%p fn=%p\n", netif, fn);
+        LOCK_TCPIP_CORE();
+        esp_err_t ret = fn(&msg);
+        UNLOCK_TCPIP_CORE();
+        return ret;
+    }
+#else
     if (g_lwip_task != xTaskGetCurrentTaskHandle()) {
         ESP_LOGD(TAG, "check: remote, if=%p fn=%p\n", netif, fn);
         sys_arch_sem_wait(&api_lock_sem, 0);
@@ -117,6 +131,7 @@ static inline esp_err_t esp_netif_lwip_ipc_call(esp_netif_api_fn fn, esp_netif_t
         sys_sem_signal(&api_lock_sem);
         return msg.ret;
     }
+#endif /* LWIP_TCPIP_CORE_LOCKING */
     ESP_LOGD(TAG, "check: local, if=%p fn=%p\n", netif, fn);
     return fn(&msg);
 }
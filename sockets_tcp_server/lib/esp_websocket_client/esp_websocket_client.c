@@ -19,6 +19,7 @@
 #include "esp_transport_tcp.h"
 #include "esp_transport_ssl.h"
 #include "esp_transport_ws.h"
+#include "esp_websocket_deflate.h"
 /* using uri parser */
 #include "http_parser.h"
 #include "freertos/task.h"
@@ -39,6 +40,8 @@ static const char *TAG = "WEBSOCKET_CLIENT";
 #define WEBSOCKET_NETWORK_TIMEOUT_MS    (10*1000)
 #define WEBSOCKET_PING_TIMEOUT_MS       (10*1000)
 #define WEBSOCKET_EVENT_QUEUE_SIZE      (1)
+#define WEBSOCKET_DEFLATE_CLIENT_WINDOW_BITS    (12)
+#define WEBSOCKET_DEFLATE_SERVER_WINDOW_BITS    (15)
 
 #define ESP_WS_CLIENT_MEM_CHECK(TAG, a, action) if (!(a)) {                                         \
         ESP_LOGE(TAG,"%s:%d (%s): %s", __FILE__, __LINE__, __FUNCTION__, "Memory exhausted");       \
@@ -65,6 +68,8 @@ typedef struct {
     char                        *subprotocol;
     char                        *user_agent;
     char                        *headers;
+    bool                        permessage_deflate;
+    esp_transport_ws_deflate_config_t deflate;
 } websocket_config_storage_t;
 
 typedef enum {
@@ -90,11 +95,19 @@ struct esp_websocket_client {
     EventGroupHandle_t          status_bits;
     xSemaphoreHandle            lock;
     char                        *rx_buffer;
-    char                        *tx_buffer;
     int                         buffer_size;
     ws_transport_opcodes_t      last_opcode;
     int                         payload_len;
     int                         payload_offset;
+    bool                        deflate_in_use;         /*!< permessage-deflate negotiated on the current connection */
+    esp_transport_ws_deflate_config_t deflate_agreed;
+    ws_deflate_handle_t         deflate;
+    ws_inflate_handle_t         inflate;
+    char                        *deflate_buffer;        /*!< compressed frame being sent */
+    char                        *inflate_buffer;        /*!< decompressed data not dispatched yet */
+    int                         inflate_len;
+    int                         inflate_offset;         /*!< decompressed data of the current frame already dispatched */
+    bool                        rx_compressed;          /*!< the message being received is compressed */
 };
 
 static uint64_t _tick_get_ms(void)
@@ -199,6 +212,18 @@ static esp_err_t esp_websocket_client_set_config(esp_websocket_client_handle_t c
         ESP_WS_CLIENT_MEM_CHECK(TAG, cfg->headers, return ESP_ERR_NO_MEM);
     }
 
+    cfg->permessage_deflate = config->permessage_deflate;
+    cfg->deflate.client_max_window_bits = config->deflate_client_max_window_bits;
+    if (cfg->deflate.client_max_window_bits == 0) {
+        cfg->deflate.client_max_window_bits = WEBSOCKET_DEFLATE_CLIENT_WINDOW_BITS;
+    }
+    cfg->deflate.server_max_window_bits = config->deflate_server_max_window_bits;
+    if (cfg->deflate.server_max_window_bits == 0) {
+        cfg->deflate.server_max_window_bits = WEBSOCKET_DEFLATE_SERVER_WINDOW_BITS;
+    }
+    cfg->deflate.client_no_context_takeover = config->deflate_client_no_context_takeover;
+    cfg->deflate.server_no_context_takeover = config->deflate_server_no_context_takeover;
+
     cfg->network_timeout_ms = WEBSOCKET_NETWORK_TIMEOUT_MS;
     cfg->user_context = config->user_context;
     cfg->auto_reconnect = true;
@@ -248,6 +273,11 @@ static void set_websocket_transport_optional_settings(esp_websocket_client_handl
     if (trans && client->config->headers) {
         esp_transport_ws_set_headers(trans, client->config->headers);
     }
+    if (trans && client->config->permessage_deflate) {
+        if (esp_transport_ws_set_permessage_deflate(trans, &client->config->deflate) != ESP_OK) {
+            ESP_LOGE(TAG, "Invalid permessage-deflate configuration, the extension is not offered");
+        }
+    }
 }
 
 esp_websocket_client_handle_t esp_websocket_client_init(const esp_websocket_client_config_t *config)
@@ -344,10 +374,6 @@ esp_websocket_client_handle_t esp_websocket_client_init(const esp_websocket_clie
     ESP_WS_CLIENT_MEM_CHECK(TAG, client->rx_buffer, {
         goto _websocket_init_fail;
     });
-    client->tx_buffer = malloc(buffer_size);
-    ESP_WS_CLIENT_MEM_CHECK(TAG, client->tx_buffer, {
-        goto _websocket_init_fail;
-    });
     client->status_bits = xEventGroupCreate();
     ESP_WS_CLIENT_MEM_CHECK(TAG, client->status_bits, {
         goto _websocket_init_fail;
@@ -375,8 +401,11 @@ esp_err_t esp_websocket_client_destroy(esp_websocket_client_handle_t client)
     esp_websocket_client_destroy_config(client);
     esp_transport_list_destroy(client->transport_list);
     vQueueDelete(client->lock);
-    free(client->tx_buffer);
     free(client->rx_buffer);
+    ws_deflate_destroy(client->deflate);
+    ws_inflate_destroy(client->inflate);
+    free(client->deflate_buffer);
+    free(client->inflate_buffer);
     if (client->status_bits) {
         vEventGroupDelete(client->status_bits);
     }
@@ -449,10 +478,109 @@ esp_err_t esp_websocket_client_set_uri(esp_websocket_client_handle_t client, con
     return ESP_OK;
 }
 
+static esp_err_t esp_websocket_client_setup_deflate(esp_websocket_client_handle_t client)
+{
+    esp_transport_ws_deflate_config_t agreed;
+    // A new connection starts with empty compression contexts
+    ws_deflate_destroy(client->deflate);
+    ws_inflate_destroy(client->inflate);
+    client->deflate = NULL;
+    client->inflate = NULL;
+    client->deflate_in_use = false;
+    client->rx_compressed = false;
+    client->inflate_len = 0;
+    if (!client->config->permessage_deflate || esp_transport_ws_get_permessage_deflate(client->transport, &agreed) != ESP_OK) {
+        return ESP_OK;
+    }
+    if (client->deflate_buffer == NULL) {
+        client->deflate_buffer = malloc(client->buffer_size);
+        ESP_WS_CLIENT_MEM_CHECK(TAG, client->deflate_buffer, return ESP_ERR_NO_MEM);
+    }
+    if (client->inflate_buffer == NULL) {
+        client->inflate_buffer = malloc(client->buffer_size);
+        ESP_WS_CLIENT_MEM_CHECK(TAG, client->inflate_buffer, return ESP_ERR_NO_MEM);
+    }
+    client->deflate = ws_deflate_create(agreed.client_max_window_bits);
+    ESP_WS_CLIENT_MEM_CHECK(TAG, client->deflate, return ESP_ERR_NO_MEM);
+    client->inflate = ws_inflate_create(agreed.server_max_window_bits);
+    ESP_WS_CLIENT_MEM_CHECK(TAG, client->inflate, return ESP_ERR_NO_MEM);
+    client->deflate_agreed = agreed;
+    client->deflate_in_use = true;
+    ESP_LOGD(TAG, "permessage-deflate in use, client window %d bits, server window %d bits",
+             agreed.client_max_window_bits, agreed.server_max_window_bits);
+    return ESP_OK;
+}
+
+/* Decompressed data are dispatched by buffer_size chunks, the last chunk of a frame is held back
+   until the end of the frame to report the decompressed frame length with it */
+static esp_err_t esp_websocket_client_inflate_output(void *ctx, const uint8_t *data, int len)
+{
+    esp_websocket_client_handle_t client = ctx;
+    while (len > 0) {
+        if (client->inflate_len == client->buffer_size) {
+            client->payload_len = -1;
+            client->payload_offset = client->inflate_offset;
+            esp_websocket_client_dispatch_event(client, WEBSOCKET_EVENT_DATA, client->inflate_buffer, client->inflate_len);
+            client->inflate_offset += client->inflate_len;
+            client->inflate_len = 0;
+        }
+        int chunk = client->buffer_size - client->inflate_len;
+        if (chunk > len) {
+            chunk = len;
+        }
+        memcpy(client->inflate_buffer + client->inflate_len, data, chunk);
+        client->inflate_len += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t esp_websocket_client_inflate(esp_websocket_client_handle_t client, int rlen, bool frame_start, bool frame_end)
+{
+    if (frame_start) {
+        client->inflate_offset = 0;
+    }
+    bool message_end = frame_end && esp_transport_ws_get_fin_flag(client->transport);
+    esp_err_t err = ws_inflate_message(client->inflate, (const uint8_t *)client->rx_buffer, rlen, message_end,
+                                       esp_websocket_client_inflate_output, client);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error decompress message");
+        return err;
+    }
+    if (frame_end) {
+        client->payload_len = client->inflate_offset + client->inflate_len;
+        client->payload_offset = client->inflate_offset;
+        esp_websocket_client_dispatch_event(client, WEBSOCKET_EVENT_DATA, client->inflate_buffer, client->inflate_len);
+        client->inflate_len = 0;
+    }
+    return ESP_OK;
+}
+
+static bool esp_websocket_client_is_compressed_frame(esp_websocket_client_handle_t client)
+{
+    if (!client->deflate_in_use) {
+        return false;
+    }
+    if (client->last_opcode == WS_TRANSPORT_OPCODES_TEXT || client->last_opcode == WS_TRANSPORT_OPCODES_BINARY) {
+        // RSV1 is only set on the first frame of a compressed message, the continuation frames follow it
+        client->rx_compressed = esp_transport_ws_get_rsv1_flag(client->transport);
+        if (client->rx_compressed && client->deflate_agreed.server_no_context_takeover) {
+            ws_inflate_reset(client->inflate);
+        }
+    } else if (client->last_opcode != WS_TRANSPORT_OPCODES_CONT) {
+        // control frames are never compressed
+        return false;
+    }
+    return client->rx_compressed;
+}
+
 static esp_err_t esp_websocket_client_recv(esp_websocket_client_handle_t client)
 {
     int rlen;
-    client->payload_offset = 0;
+    int payload_len;
+    int payload_offset = 0;
+    bool compressed = false;
     do {
         rlen = esp_transport_read(client->transport, client->rx_buffer, client->buffer_size, client->config->network_timeout_ms);
         if (rlen < 0) {
@@ -460,13 +588,25 @@ static esp_err_t esp_websocket_client_recv(esp_websocket_client_handle_t client)
             esp_websocket_client_abort_connection(client);
             return ESP_FAIL;
         }
-        client->payload_len = esp_transport_ws_get_read_payload_len(client->transport);
-        client->last_opcode = esp_transport_ws_get_read_opcode(client->transport);
+        payload_len = esp_transport_ws_get_read_payload_len(client->transport);
+        if (payload_offset == 0) {
+            client->last_opcode = esp_transport_ws_get_read_opcode(client->transport);
+            compressed = esp_websocket_client_is_compressed_frame(client);
+        }
 
-        esp_websocket_client_dispatch_event(client, WEBSOCKET_EVENT_DATA, client->rx_buffer, rlen);
+        if (compressed) {
+            if (esp_websocket_client_inflate(client, rlen, payload_offset == 0, payload_offset + rlen >= payload_len) != ESP_OK) {
+                esp_websocket_client_abort_connection(client);
+                return ESP_FAIL;
+            }
+        } else {
+            client->payload_len = payload_len;
+            client->payload_offset = payload_offset;
+            esp_websocket_client_dispatch_event(client, WEBSOCKET_EVENT_DATA, client->rx_buffer, rlen);
+        }
 
-        client->payload_offset += rlen;
-    } while (client->payload_offset < client->payload_len);
+        payload_offset += rlen;
+    } while (payload_offset < payload_len);
 
     // if a PING message received -> send out the PONG, this will not work for PING messages with payload longer than buffer len
     if (client->last_opcode == WS_TRANSPORT_OPCODES_PING) {
@@ -520,6 +660,10 @@ static void esp_websocket_client_task(void *pv)
                     break;
                 }
                 ESP_LOGD(TAG, "Transport connected to %s://%s:%d", client->config->scheme, client->config->host, client->config->port);
+                if (esp_websocket_client_setup_deflate(client) != ESP_OK) {
+                    esp_websocket_client_abort_connection(client);
+                    break;
+                }
 
                 client->state = WEBSOCKET_STATE_CONNECTED;
                 esp_websocket_client_dispatch_event(client, WEBSOCKET_EVENT_CONNECTED, NULL, 0);
@@ -624,6 +768,58 @@ int esp_websocket_client_send_bin(esp_websocket_client_handle_t client, const ch
     return esp_websocket_client_send_with_opcode(client, WS_TRANSPORT_OPCODES_BINARY, data, len, timeout);
 }
 
+typedef struct {
+    esp_websocket_client_handle_t client;
+    uint32_t opcode;                    /*!< opcode of the next frame */
+    int len;                            /*!< compressed data in deflate_buffer */
+    int timeout_ms;
+} websocket_deflate_writer_t;
+
+/* Compressed data are sent by buffer_size frames, a full frame is only sent once more data follow,
+   so that the last frame of the message can carry the FIN flag */
+static esp_err_t esp_websocket_client_deflate_output(void *ctx, const uint8_t *data, int len)
+{
+    websocket_deflate_writer_t *writer = ctx;
+    esp_websocket_client_handle_t client = writer->client;
+    while (len > 0) {
+        if (writer->len == client->buffer_size) {
+            if (esp_transport_ws_send_raw(client->transport, writer->opcode, client->deflate_buffer, writer->len, writer->timeout_ms) != writer->len) {
+                ESP_LOGE(TAG, "Network error: esp_transport_write() failed, errno=%d", errno);
+                return ESP_FAIL;
+            }
+            writer->opcode = WS_TRANSPORT_OPCODES_CONT;
+            writer->len = 0;
+        }
+        int chunk = client->buffer_size - writer->len;
+        if (chunk > len) {
+            chunk = len;
+        }
+        memcpy(client->deflate_buffer + writer->len, data, chunk);
+        writer->len += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+    return ESP_OK;
+}
+
+static int esp_websocket_client_send_compressed(esp_websocket_client_handle_t client, ws_transport_opcodes_t opcode, const char *data, int len, int timeout_ms)
+{
+    websocket_deflate_writer_t writer = {
+        .client = client,
+        .opcode = opcode | WS_TRANSPORT_OPCODES_RSV1,
+        .timeout_ms = timeout_ms,
+    };
+    if (ws_deflate_message(client->deflate, (const uint8_t *)data, len, client->deflate_agreed.client_no_context_takeover,
+                           esp_websocket_client_deflate_output, &writer) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if (esp_transport_ws_send_raw(client->transport, writer.opcode | WS_TRANSPORT_OPCODES_FIN, client->deflate_buffer, writer.len, timeout_ms) != writer.len) {
+        ESP_LOGE(TAG, "Network error: esp_transport_write() failed, errno=%d", errno);
+        return ESP_FAIL;
+    }
+    return len;
+}
+
 static int esp_websocket_client_send_with_opcode(esp_websocket_client_handle_t client, ws_transport_opcodes_t opcode, const char *data, int len, TickType_t timeout)
 {
     int need_write = len;
@@ -649,6 +845,10 @@ static int esp_websocket_client_send_with_opcode(esp_websocket_client_handle_t c
         ESP_LOGE(TAG, "Invalid transport");
         goto unlock_and_return;
     }
+    if (client->deflate_in_use) {
+        ret = esp_websocket_client_send_compressed(client, opcode, data, len, (timeout==portMAX_DELAY)? -1 : timeout * portTICK_PERIOD_MS);
+        goto unlock_and_return;
+    }
     uint32_t current_opcode = opcode;
     while (widx < len) {
         if (need_write > client->buffer_size) {
@@ -656,9 +856,8 @@ static int esp_websocket_client_send_with_opcode(esp_websocket_client_handle_t c
         } else {
             current_opcode |= WS_TRANSPORT_OPCODES_FIN;
         }
-        memcpy(client->tx_buffer, data + widx, need_write);
-        // send with ws specific way and specific opcode
-        wlen = esp_transport_ws_send_raw(client->transport, current_opcode, (char *)client->tx_buffer, need_write,
+        // send with ws specific way and specific opcode, the transport masks a copy of the data
+        wlen = esp_transport_ws_send_raw(client->transport, current_opcode, data + widx, need_write,
                                         (timeout==portMAX_DELAY)? -1 : timeout * portTICK_PERIOD_MS);
         if (wlen <= 0) {
             ret = wlen;
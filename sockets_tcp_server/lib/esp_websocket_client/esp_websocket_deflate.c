@@ -0,0 +1,419 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_websocket_deflate.h"
+#include "sdkconfig.h"
+
+#if CONFIG_IDF_TARGET_ESP32
+#include "esp32/rom/miniz.h"
+#elif CONFIG_IDF_TARGET_ESP32S2
+#include "esp32s2/rom/miniz.h"
+#endif
+
+static const char *TAG = "WEBSOCKET_DEFLATE";
+
+#define WS_DEFLATE_MEM_CHECK(TAG, a, action) if (!(a)) {                                    \
+        ESP_LOGE(TAG,"%s:%d (%s): %s", __FILE__, __LINE__, __FUNCTION__, "Memory exhausted");   \
+        action;                                                                                 \
+        }
+
+#define MIN_MATCH           3
+#define MAX_MATCH           258
+#define MAX_CHAIN           32          /* hash chain entries probed per position */
+#define MIN_WINDOW_SIZE     512         /* keeps a full match of lookahead within the upper window half */
+#define NIL                 0           /* position 0 is never used as a match source */
+#define OUT_BUFFER_SIZE     256
+
+static const uint8_t s_sync_flush_tail[] = { 0x00, 0x00, 0xff, 0xff };
+
+/*
+ * The compressor keeps 2 * wsize bytes: the upper half is filled with the message, the lower
+ * half holds the history. Once the upper half is consumed the window slides by wsize bytes.
+ * head[] gives the most recent position of a 3-byte hash, prev[] chains older positions.
+ */
+struct ws_deflate {
+    uint8_t *window;
+    uint16_t *head;
+    uint16_t *prev;
+    unsigned wsize;
+    unsigned wmask;
+    unsigned hash_bits;
+    unsigned max_dist;
+    unsigned pos;                       /* next position to compress */
+    unsigned fill;                      /* end of the data in the window */
+    uint32_t bit_buf;
+    int bit_count;
+    uint8_t out[OUT_BUFFER_SIZE];
+    int out_len;
+    ws_deflate_output_t output;
+    void *ctx;
+    esp_err_t err;
+};
+
+struct ws_inflate {
+    tinfl_decompressor decomp;
+    uint8_t *dict;                      /* wrapping output buffer, also the LZ77 dictionary */
+    size_t dict_size;
+    size_t dict_ofs;
+    bool stream_ended;                  /* the peer closed the deflate stream with a final block */
+};
+
+/* Fixed Huffman literal/length codes, bit reversed as deflate emits them LSB first */
+static uint16_t s_fixed_lit_code[288];
+static uint8_t s_fixed_lit_len[288];
+static uint8_t s_fixed_dist_code[30];
+
+static unsigned reverse_bits(unsigned code, int len)
+{
+    unsigned res = 0;
+    while (len--) {
+        res = (res << 1) | (code & 1);
+        code >>= 1;
+    }
+    return res;
+}
+
+static void build_fixed_tables(void)
+{
+    // Building the tables again from another task writes the same values, no locking needed
+    if (s_fixed_lit_len[0]) {
+        return;
+    }
+    for (int i = 0; i < 288; i++) {
+        unsigned code;
+        int len;
+        if (i < 144) {
+            code = 0x30 + i;
+            len = 8;
+        } else if (i < 256) {
+            code = 0x190 + i - 144;
+            len = 9;
+        } else if (i < 280) {
+            code = i - 256;
+            len = 7;
+        } else {
+            code = 0xc0 + i - 280;
+            len = 8;
+        }
+        s_fixed_lit_code[i] = reverse_bits(code, len);
+        s_fixed_lit_len[i] = len;
+    }
+    for (int i = 0; i < 30; i++) {
+        s_fixed_dist_code[i] = reverse_bits(i, 5);
+    }
+}
+
+static void deflate_flush_output(ws_deflate_handle_t d)
+{
+    if (d->out_len && d->err == ESP_OK) {
+        d->err = d->output(d->ctx, d->out, d->out_len);
+    }
+    d->out_len = 0;
+}
+
+static inline void deflate_put_bits(ws_deflate_handle_t d, uint32_t bits, int count)
+{
+    d->bit_buf |= bits << d->bit_count;
+    d->bit_count += count;
+    while (d->bit_count >= 8) {
+        if (d->out_len == OUT_BUFFER_SIZE) {
+            deflate_flush_output(d);
+        }
+        d->out[d->out_len++] = d->bit_buf & 0xff;
+        d->bit_buf >>= 8;
+        d->bit_count -= 8;
+    }
+}
+
+static inline void deflate_put_literal(ws_deflate_handle_t d, int lit)
+{
+    deflate_put_bits(d, s_fixed_lit_code[lit], s_fixed_lit_len[lit]);
+}
+
+static void deflate_put_match(ws_deflate_handle_t d, unsigned len, unsigned dist)
+{
+    unsigned n = len - MIN_MATCH;
+    if (len == MAX_MATCH) {
+        deflate_put_literal(d, 285);
+    } else if (n < 8) {
+        deflate_put_literal(d, 257 + n);
+    } else {
+        int extra = 29 - __builtin_clz(n);
+        deflate_put_literal(d, 257 + 4 * (extra + 1) + ((n >> extra) & 3));
+        deflate_put_bits(d, n & ((1 << extra) - 1), extra);
+    }
+
+    n = dist - 1;
+    if (n < 4) {
+        deflate_put_bits(d, s_fixed_dist_code[n], 5);
+    } else {
+        int extra = 30 - __builtin_clz(n);
+        deflate_put_bits(d, s_fixed_dist_code[2 * (extra + 1) + ((n >> extra) & 1)], 5);
+        deflate_put_bits(d, n & ((1 << extra) - 1), extra);
+    }
+}
+
+static inline unsigned deflate_hash(ws_deflate_handle_t d, const uint8_t *p)
+{
+    uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+    return (v * 2654435761u) >> (32 - d->hash_bits);
+}
+
+static inline void deflate_insert(ws_deflate_handle_t d, unsigned pos)
+{
+    unsigned h = deflate_hash(d, d->window + pos);
+    d->prev[pos & d->wmask] = d->head[h];
+    d->head[h] = pos;
+}
+
+static void deflate_slide(ws_deflate_handle_t d)
+{
+    unsigned wsize = d->wsize;
+    memcpy(d->window, d->window + wsize, wsize);
+    d->pos -= wsize;
+    d->fill -= wsize;
+    for (unsigned i = 0; i < (1u << d->hash_bits); i++) {
+        d->head[i] = d->head[i] >= wsize ? d->head[i] - wsize : NIL;
+    }
+    for (unsigned i = 0; i < wsize; i++) {
+        d->prev[i] = d->prev[i] >= wsize ? d->prev[i] - wsize : NIL;
+    }
+}
+
+static unsigned deflate_longest_match(ws_deflate_handle_t d, unsigned pos, unsigned max_len, unsigned *match_dist)
+{
+    const uint8_t *window = d->window;
+    const uint8_t *cur = window + pos;
+    unsigned best_len = MIN_MATCH - 1;
+    unsigned candidate = d->head[deflate_hash(d, cur)];
+    int chain = MAX_CHAIN;
+
+    while (candidate != NIL && candidate < pos && pos - candidate <= d->max_dist && chain--) {
+        const uint8_t *match = window + candidate;
+        if (match[best_len] == cur[best_len] && match[0] == cur[0] && match[1] == cur[1]) {
+            unsigned len = 2;
+            while (len < max_len && match[len] == cur[len]) {
+                len++;
+            }
+            if (len > best_len) {
+                best_len = len;
+                *match_dist = pos - candidate;
+                if (len == max_len) {
+                    break;
+                }
+            }
+        }
+        unsigned next = d->prev[candidate & d->wmask];
+        if (next >= candidate) {
+            break;
+        }
+        candidate = next;
+    }
+    return best_len >= MIN_MATCH ? best_len : 0;
+}
+
+/* Greedy LZ77 parse of the window from pos up to limit */
+static void deflate_window(ws_deflate_handle_t d, unsigned limit)
+{
+    while (d->pos < limit) {
+        unsigned pos = d->pos;
+        unsigned avail = d->fill - pos;
+        unsigned len = 0, dist = 0;
+        if (avail >= MIN_MATCH) {
+            len = deflate_longest_match(d, pos, avail < MAX_MATCH ? avail : MAX_MATCH, &dist);
+            deflate_insert(d, pos);
+        }
+        if (len) {
+            deflate_put_match(d, len, dist);
+            unsigned end = pos + len;
+            unsigned last_insert = d->fill - MIN_MATCH;
+            for (unsigned p = pos + 1; p < end && p <= last_insert; p++) {
+                deflate_insert(d, p);
+            }
+            d->pos = end;
+        } else {
+            deflate_put_literal(d, d->window[pos]);
+            d->pos++;
+        }
+    }
+}
+
+ws_deflate_handle_t ws_deflate_create(int window_bits)
+{
+    if (window_bits < 8 || window_bits > 15) {
+        ESP_LOGE(TAG, "Invalid window bits %d", window_bits);
+        return NULL;
+    }
+    build_fixed_tables();
+    ws_deflate_handle_t d = calloc(1, sizeof(struct ws_deflate));
+    WS_DEFLATE_MEM_CHECK(TAG, d, return NULL);
+    d->max_dist = 1u << window_bits;
+    d->wsize = d->max_dist < MIN_WINDOW_SIZE ? MIN_WINDOW_SIZE : d->max_dist;
+    d->wmask = d->wsize - 1;
+    d->hash_bits = window_bits < 9 ? 9 : window_bits;
+    if (d->max_dist == d->wsize) {
+        // prev[] is indexed modulo wsize, an entry wsize positions back is already overwritten
+        d->max_dist = d->wsize - 1;
+    }
+    d->window = malloc(2 * d->wsize);
+    d->head = calloc(1u << d->hash_bits, sizeof(uint16_t));
+    d->prev = calloc(d->wsize, sizeof(uint16_t));
+    WS_DEFLATE_MEM_CHECK(TAG, d->window && d->head && d->prev, {
+        ws_deflate_destroy(d);
+        return NULL;
+    });
+    return d;
+}
+
+esp_err_t ws_deflate_message(ws_deflate_handle_t d, const uint8_t *data, int len, bool no_context_takeover,
+                             ws_deflate_output_t output, void *ctx)
+{
+    if (no_context_takeover && d->fill) {
+        memset(d->head, 0, (1u << d->hash_bits) * sizeof(uint16_t));
+        d->pos = d->fill = 0;
+    }
+    d->output = output;
+    d->ctx = ctx;
+    d->err = ESP_OK;
+    d->out_len = 0;
+    d->bit_buf = 0;
+    d->bit_count = 0;
+
+    // Single fixed Huffman block, never final so that the next message continues the stream
+    deflate_put_bits(d, 0x2, 3);
+    while (len > 0 && d->err == ESP_OK) {
+        if (d->fill == 2 * d->wsize) {
+            deflate_slide(d);
+        }
+        int chunk = 2 * d->wsize - d->fill;
+        if (chunk > len) {
+            chunk = len;
+        }
+        memcpy(d->window + d->fill, data, chunk);
+        d->fill += chunk;
+        data += chunk;
+        len -= chunk;
+        // Keep a full match of lookahead unless this is the end of the message
+        deflate_window(d, len ? d->fill - MAX_MATCH : d->fill);
+    }
+    deflate_put_literal(d, 256);
+    // Sync flush: empty stored block, its LEN/NLEN (00 00 ff ff) is stripped per RFC 7692
+    deflate_put_bits(d, 0, 3);
+    if (d->bit_count) {
+        deflate_put_bits(d, 0, 8 - d->bit_count);
+    }
+    deflate_flush_output(d);
+    return d->err;
+}
+
+void ws_deflate_destroy(ws_deflate_handle_t d)
+{
+    if (d == NULL) {
+        return;
+    }
+    free(d->window);
+    free(d->head);
+    free(d->prev);
+    free(d);
+}
+
+ws_inflate_handle_t ws_inflate_create(int window_bits)
+{
+    if (window_bits < 8 || window_bits > 15) {
+        ESP_LOGE(TAG, "Invalid window bits %d", window_bits);
+        return NULL;
+    }
+    ws_inflate_handle_t inf = calloc(1, sizeof(struct ws_inflate));
+    WS_DEFLATE_MEM_CHECK(TAG, inf, return NULL);
+    inf->dict_size = 1u << window_bits;
+    inf->dict = malloc(inf->dict_size);
+    WS_DEFLATE_MEM_CHECK(TAG, inf->dict, {
+        free(inf);
+        return NULL;
+    });
+    ws_inflate_reset(inf);
+    return inf;
+}
+
+void ws_inflate_reset(ws_inflate_handle_t inf)
+{
+    tinfl_init(&inf->decomp);
+    inf->dict_ofs = 0;
+    inf->stream_ended = false;
+}
+
+static esp_err_t inflate_data(ws_inflate_handle_t inf, const uint8_t *data, size_t len,
+                              ws_deflate_output_t output, void *ctx)
+{
+    for (;;) {
+        size_t in_size = len;
+        size_t out_size = inf->dict_size - inf->dict_ofs;
+        tinfl_status status = tinfl_decompress(&inf->decomp, data, &in_size, inf->dict, inf->dict + inf->dict_ofs,
+                                               &out_size, TINFL_FLAG_HAS_MORE_INPUT);
+        data += in_size;
+        len -= in_size;
+        if (out_size) {
+            esp_err_t err = output(ctx, inf->dict + inf->dict_ofs, out_size);
+            if (err != ESP_OK) {
+                return err;
+            }
+            inf->dict_ofs = (inf->dict_ofs + out_size) & (inf->dict_size - 1);
+        }
+        if (status < TINFL_STATUS_DONE) {
+            ESP_LOGE(TAG, "Invalid compressed data, status=%d", status);
+            return ESP_FAIL;
+        }
+        if (status == TINFL_STATUS_DONE) {
+            // The dictionary is kept, a new stream may still refer to it
+            tinfl_init(&inf->decomp);
+            inf->stream_ended = true;
+            if (len == 0) {
+                return ESP_OK;
+            }
+            inf->stream_ended = false;
+        } else if (status == TINFL_STATUS_NEEDS_MORE_INPUT) {
+            return ESP_OK;
+        }
+        // TINFL_STATUS_HAS_MORE_OUTPUT: the dictionary wrapped around, continue
+    }
+}
+
+esp_err_t ws_inflate_message(ws_inflate_handle_t inf, const uint8_t *data, int len, bool message_end,
+                             ws_deflate_output_t output, void *ctx)
+{
+    esp_err_t err = ESP_OK;
+    if (len > 0) {
+        inf->stream_ended = false;
+        err = inflate_data(inf, data, len, output, ctx);
+    }
+    if (err == ESP_OK && message_end) {
+        if (!inf->stream_ended) {
+            err = inflate_data(inf, s_sync_flush_tail, sizeof(s_sync_flush_tail), output, ctx);
+        }
+        inf->stream_ended = false;
+    }
+    return err;
+}
+
+void ws_inflate_destroy(ws_inflate_handle_t inf)
+{
+    if (inf == NULL) {
+        return;
+    }
+    free(inf->dict);
+    free(inf);
+}
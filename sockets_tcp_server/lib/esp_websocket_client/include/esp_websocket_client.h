@@ -52,7 +52,9 @@ typedef struct {
     uint8_t op_code;                        /*!< Received opcode */
     esp_websocket_client_handle_t client;   /*!< esp_websocket_client_handle_t context */
     void *user_context;                     /*!< user_data context, from esp_websocket_client_config_t user_data */
-    int payload_len;                        /*!< Total payload length, payloads exceeding buffer will be posted through multiple events */
+    int payload_len;                        /*!< Total payload length, payloads exceeding buffer will be posted through multiple events.
+                                                 For a compressed frame (permessage-deflate) the data are decompressed and the length is
+                                                 only known with the last event of the frame, the previous ones report -1 */
     int payload_offset;                     /*!< Actual offset for the data associated with this event */
 } esp_websocket_event_data_t;
 
@@ -85,6 +87,11 @@ typedef struct {
     char                        *subprotocol;               /*!< Websocket subprotocol */
     char                        *user_agent;                /*!< Websocket user-agent */
     char                        *headers;                   /*!< Websocket additional headers */
+    bool                        permessage_deflate;         /*!< Offer the permessage-deflate extension (RFC 7692), text and binary messages are then sent compressed */
+    int                         deflate_client_max_window_bits;     /*!< Window of the messages compressed by the client, 8..15, default 12. The compressor uses about 6 * 2^bits bytes */
+    int                         deflate_server_max_window_bits;     /*!< Largest window accepted for the messages sent by the server, 8..15, default 15. The decompressor uses 2^bits bytes plus 11kB */
+    bool                        deflate_client_no_context_takeover; /*!< Compress each message independently of the previous ones */
+    bool                        deflate_server_no_context_takeover; /*!< Ask the server to compress each message independently of the previous ones */
 } esp_websocket_client_config_t;
 
 /**
@@ -0,0 +1,80 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_WEBSOCKET_DEFLATE_H_
+#define _ESP_WEBSOCKET_DEFLATE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Compression and decompression of permessage-deflate (RFC 7692) messages
+ *
+ * Messages are raw deflate data ending with an empty stored block (sync flush) whose
+ * trailing 0x00 0x00 0xff 0xff bytes are not transmitted.
+ */
+typedef struct ws_deflate *ws_deflate_handle_t;
+typedef struct ws_inflate *ws_inflate_handle_t;
+
+/**
+ * Receives the (de)compressed output as it is produced, returning an error aborts the operation
+ */
+typedef esp_err_t (*ws_deflate_output_t)(void *ctx, const uint8_t *data, int len);
+
+/**
+ * @brief Create a compressor with an LZ77 window of 2^window_bits bytes (8..15)
+ *
+ * The compressor allocates about 6 * 2^window_bits bytes. It emits fixed Huffman codes only,
+ * which keeps it small and fast; repetitive payloads compress through the LZ77 matches.
+ */
+ws_deflate_handle_t ws_deflate_create(int window_bits);
+
+/**
+ * @brief Compress one message and pass the compressed data to `output`
+ *
+ * @param no_context_takeover  if set, the message does not refer to the previous ones
+ */
+esp_err_t ws_deflate_message(ws_deflate_handle_t deflate, const uint8_t *data, int len, bool no_context_takeover,
+                             ws_deflate_output_t output, void *ctx);
+void ws_deflate_destroy(ws_deflate_handle_t deflate);
+
+/**
+ * @brief Create a decompressor for messages using an LZ77 window of up to 2^window_bits bytes (8..15)
+ */
+ws_inflate_handle_t ws_inflate_create(int window_bits);
+
+/**
+ * @brief Forget the previous messages, to be used when the peer does not take over its context
+ */
+void ws_inflate_reset(ws_inflate_handle_t inflate);
+
+/**
+ * @brief Decompress a part of a message and pass the decompressed data to `output`
+ *
+ * @param message_end  set with the last part of the message
+ */
+esp_err_t ws_inflate_message(ws_inflate_handle_t inflate, const uint8_t *data, int len, bool message_end,
+                             ws_deflate_output_t output, void *ctx);
+void ws_inflate_destroy(ws_inflate_handle_t inflate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_WEBSOCKET_DEFLATE_H_ */
@@ -0,0 +1 @@
+#define CONFIG_IDF_TARGET_ESP32 1
@@ -0,0 +1,216 @@
+#include "catch.hpp"
+#include "esp_websocket_deflate.h"
+#include "esp32/rom/miniz.h"
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdlib.h>
+#include <stdio.h>
+
+static esp_err_t append_output(void *ctx, const uint8_t *data, int len)
+{
+    std::vector<uint8_t> *out = static_cast<std::vector<uint8_t> *>(ctx);
+    out->insert(out->end(), data, data + len);
+    return ESP_OK;
+}
+
+static std::vector<uint8_t> deflate(ws_deflate_handle_t d, const std::string &msg, bool no_context_takeover)
+{
+    std::vector<uint8_t> out;
+    CHECK(ws_deflate_message(d, (const uint8_t *)msg.data(), msg.size(), no_context_takeover, append_output, &out) == ESP_OK);
+    return out;
+}
+
+/* Inflates a message passed in pieces of random sizes, as received in rx buffer chunks */
+static std::string inflate(ws_inflate_handle_t inf, const std::vector<uint8_t> &msg)
+{
+    std::vector<uint8_t> out;
+    size_t pos = 0;
+    do {
+        size_t chunk = msg.size() - pos;
+        if (chunk > 1) {
+            chunk = 1 + rand() % chunk;
+        }
+        bool end = pos + chunk == msg.size();
+        CHECK(ws_inflate_message(inf, msg.data() + pos, chunk, end, append_output, &out) == ESP_OK);
+        pos += chunk;
+    } while (pos < msg.size());
+    return std::string(out.begin(), out.end());
+}
+
+static std::string json_message(int i)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf), "{\"device\":\"sensor-%02d\",\"seq\":%d,\"temperature\":%d.%d,\"humidity\":%d,"
+             "\"status\":\"ok\",\"uptime\":%d,\"rssi\":-%d}", i % 16, i, 20 + i % 7, i % 10, 40 + i % 13, 1000 + i * 5, 50 + i % 20);
+    return buf;
+}
+
+static std::string random_message(size_t len)
+{
+    std::string msg(len, 0);
+    for (size_t i = 0; i < len; i++) {
+        msg[i] = rand();
+    }
+    return msg;
+}
+
+static std::string text_message(size_t len)
+{
+    static const char *words[] = { "websocket ", "deflate ", "extension ", "message ", "frame ", "payload ", "window ", "\n" };
+    std::string msg;
+    while (msg.size() < len) {
+        msg += words[rand() % 8];
+    }
+    msg.resize(len);
+    return msg;
+}
+
+static size_t wire_size(size_t payload_len)
+{
+    // masked client frame header
+    return payload_len + (payload_len < 126 ? 6 : payload_len < 65536 ? 8 : 14);
+}
+
+TEST_CASE("deflated messages inflate to the original data", "[ws_deflate]")
+{
+    for (int bits = 8; bits <= 15; bits++) {
+        for (int no_context_takeover = 0; no_context_takeover < 2; no_context_takeover++) {
+            ws_deflate_handle_t d = ws_deflate_create(bits);
+            ws_inflate_handle_t inf = ws_inflate_create(bits);
+            REQUIRE(d);
+            REQUIRE(inf);
+            std::vector<std::string> messages = { "", "a", json_message(1), json_message(2), text_message(5000),
+                                                  random_message(3000), text_message(100000), json_message(3),
+                                                  std::string(70000, 'x'), ""
+                                                };
+            for (const auto &msg : messages) {
+                std::vector<uint8_t> compressed = deflate(d, msg, no_context_takeover);
+                if (no_context_takeover) {
+                    ws_inflate_reset(inf);
+                }
+                CHECK(inflate(inf, compressed) == msg);
+            }
+            ws_deflate_destroy(d);
+            ws_inflate_destroy(inf);
+        }
+    }
+}
+
+TEST_CASE("deflate context takeover improves small message compression", "[ws_deflate]")
+{
+    ws_deflate_handle_t d = ws_deflate_create(12);
+    ws_deflate_handle_t d_reset = ws_deflate_create(12);
+    ws_inflate_handle_t inf = ws_inflate_create(12);
+    size_t with_context = 0, without_context = 0;
+    for (int i = 0; i < 100; i++) {
+        std::string msg = json_message(i);
+        std::vector<uint8_t> compressed = deflate(d, msg, false);
+        with_context += compressed.size();
+        CHECK(inflate(inf, compressed) == msg);
+        without_context += deflate(d_reset, msg, true).size();
+    }
+    CHECK(with_context < without_context / 2);
+    ws_deflate_destroy(d);
+    ws_deflate_destroy(d_reset);
+    ws_inflate_destroy(inf);
+}
+
+TEST_CASE("messages of a reference compressor with sync flush are inflated", "[ws_deflate]")
+{
+    static tdefl_compressor comp;
+    for (int final_block = 0; final_block < 2; final_block++) {
+        REQUIRE(tdefl_init(&comp, NULL, NULL, TDEFL_DEFAULT_MAX_PROBES) == TDEFL_STATUS_OKAY);
+        ws_inflate_handle_t inf = ws_inflate_create(15);
+        for (int i = 0; i < 50; i++) {
+            std::string msg = i % 5 ? json_message(i) : text_message(20000);
+            std::vector<uint8_t> compressed(msg.size() + 1024);
+            size_t in_size = msg.size(), out_size = compressed.size();
+            REQUIRE(tdefl_compress(&comp, msg.data(), &in_size, compressed.data(), &out_size,
+                                   final_block ? TDEFL_FINISH : TDEFL_SYNC_FLUSH) == (final_block ? TDEFL_STATUS_DONE : TDEFL_STATUS_OKAY));
+            compressed.resize(out_size);
+            if (final_block) {
+                // each message is a complete stream, the tail is not stripped
+                REQUIRE(tdefl_init(&comp, NULL, NULL, TDEFL_DEFAULT_MAX_PROBES) == TDEFL_STATUS_OKAY);
+            } else {
+                REQUIRE(compressed.size() >= 4);
+                CHECK(compressed[compressed.size() - 1] == 0xff);
+                compressed.resize(compressed.size() - 4);
+            }
+            CHECK(inflate(inf, compressed) == msg);
+        }
+        ws_inflate_destroy(inf);
+    }
+}
+
+TEST_CASE("invalid compressed data is rejected", "[ws_deflate]")
+{
+    ws_inflate_handle_t inf = ws_inflate_create(10);
+    std::vector<uint8_t> out;
+    const uint8_t invalid[] = { 0x07, 0xff, 0xff, 0xff };   // reserved block type
+    CHECK(ws_inflate_message(inf, invalid, sizeof(invalid), true, append_output, &out) == ESP_FAIL);
+    ws_inflate_destroy(inf);
+    CHECK(ws_deflate_create(7) == NULL);
+    CHECK(ws_inflate_create(16) == NULL);
+}
+
+TEST_CASE("deflate compression ratio and speed", "[ws_deflate][perf]")
+{
+    struct {
+        const char *name;
+        std::vector<std::string> messages;
+    } loads[3];
+    loads[0].name = "json 160B";
+    loads[1].name = "text 4kB";
+    loads[2].name = "random 1kB";
+    for (int i = 0; i < 1000; i++) {
+        loads[0].messages.push_back(json_message(i));
+    }
+    for (int i = 0; i < 100; i++) {
+        loads[1].messages.push_back(text_message(4096));
+        loads[2].messages.push_back(random_message(1024));
+    }
+
+    printf("%-12s %-5s %-8s %10s %10s %7s %10s %10s\n", "load", "bits", "context", "raw", "wire", "ratio", "us/deflate", "us/inflate");
+    for (auto &load : loads) {
+        size_t raw_wire = 0;
+        for (const auto &msg : load.messages) {
+            raw_wire += wire_size(msg.size());
+        }
+        printf("%-12s %-5s %-8s %10zu %10zu %7.2f\n", load.name, "-", "none", raw_wire, raw_wire, 1.0);
+        for (int bits = 9; bits <= 15; bits += 3) {
+            for (int no_context_takeover = 0; no_context_takeover < 2; no_context_takeover++) {
+                ws_deflate_handle_t d = ws_deflate_create(bits);
+                ws_inflate_handle_t inf = ws_inflate_create(bits);
+                std::vector<std::vector<uint8_t>> compressed;
+                size_t wire = 0;
+                auto start = std::chrono::steady_clock::now();
+                for (const auto &msg : load.messages) {
+                    compressed.push_back(deflate(d, msg, no_context_takeover));
+                }
+                auto mid = std::chrono::steady_clock::now();
+                for (size_t i = 0; i < compressed.size(); i++) {
+                    std::vector<uint8_t> out;
+                    if (no_context_takeover) {
+                        ws_inflate_reset(inf);
+                    }
+                    CHECK(ws_inflate_message(inf, compressed[i].data(), compressed[i].size(), true, append_output, &out) == ESP_OK);
+                    CHECK(out.size() == load.messages[i].size());
+                    wire += wire_size(compressed[i].size());
+                }
+                auto end = std::chrono::steady_clock::now();
+                double n = load.messages.size();
+                printf("%-12s %-5d %-8s %10zu %10zu %7.2f %10.2f %10.2f\n", load.name, bits,
+                       no_context_takeover ? "reset" : "takeover", raw_wire, wire, (double)raw_wire / wire,
+                       std::chrono::duration<double, std::micro>(mid - start).count() / n,
+                       std::chrono::duration<double, std::micro>(end - mid).count() / n);
+                if (load.messages[0][0] == '{' && !no_context_takeover) {
+                    CHECK(wire * 3 < raw_wire);
+                }
+                ws_deflate_destroy(d);
+                ws_inflate_destroy(inf);
+            }
+        }
+    }
+}
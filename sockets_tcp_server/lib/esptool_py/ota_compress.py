@@ -0,0 +1,106 @@
+#!/usr/bin/env python
+#
+# ota_compress packs an app image into the compressed OTA image container accepted by
+# esp_ota_write() (see app_update/include/esp_ota_compressed.h), and unpacks it back
+#
+# Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http:#www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+from __future__ import print_function, division
+import argparse
+import struct
+import sys
+import zlib
+
+COMPRESSED_MAGIC = 0x5a544f45  # "EOTZ"
+COMPRESSED_VERSION = 1
+COMPRESSION_ZLIB = 1
+ESP_IMAGE_HEADER_MAGIC = 0xe9
+
+# magic, version, compression, header_size, image_size, data_size
+HEADER = struct.Struct("<IBBHII")
+
+
+class InputError(RuntimeError):
+    pass
+
+
+def compress(content, level=9):
+    """ Returns the compressed container of any content, as also used inside delta OTA images """
+    # The default 32 KB window is the size of the dictionary of the inflater on the chip
+    data = zlib.compress(content, level)
+    return HEADER.pack(COMPRESSED_MAGIC, COMPRESSED_VERSION, COMPRESSION_ZLIB, HEADER.size, len(content), len(data)) + data
+
+
+def pack(image, level=9):
+    """ Returns the compressed OTA image container of an app image """
+    if len(image) == 0 or bytearray(image[:1])[0] != ESP_IMAGE_HEADER_MAGIC:
+        raise InputError("Not an app image (expected magic byte 0x%02x)" % ESP_IMAGE_HEADER_MAGIC)
+    return compress(image, level)
+
+
+def unpack(container):
+    """ Returns the app image of a compressed OTA image container, checking it as esp_ota_write() does """
+    if len(container) < HEADER.size:
+        raise InputError("Container is too short")
+    magic, version, compression, header_size, image_size, data_size = HEADER.unpack_from(container)
+    if magic != COMPRESSED_MAGIC:
+        raise InputError("Invalid magic 0x%08x" % magic)
+    if version != COMPRESSED_VERSION or compression != COMPRESSION_ZLIB or header_size < HEADER.size:
+        raise InputError("Unsupported version %d, compression %d" % (version, compression))
+    if len(container) != header_size + data_size:
+        raise InputError("Container is %d bytes, expected %d" % (len(container), header_size + data_size))
+    try:
+        image = zlib.decompress(container[header_size:])
+    except zlib.error as e:
+        raise InputError("Corrupted compressed data: %s" % e)
+    if len(image) != image_size:
+        raise InputError("Image is %d bytes, expected %d" % (len(image), image_size))
+    return image
+
+
+def main():
+    parser = argparse.ArgumentParser(description="ESP32 compressed OTA image packer")
+    subparsers = parser.add_subparsers(dest="operation", help="Run ota_compress.py {command} -h for additional help")
+
+    pack_parser = subparsers.add_parser("pack", help="Compress an app image for OTA update")
+    pack_parser.add_argument("input", help="App image (.bin)", type=argparse.FileType("rb"))
+    pack_parser.add_argument("output", help="Compressed OTA image", type=argparse.FileType("wb"))
+    pack_parser.add_argument("--level", help="zlib compression level (default: %(default)s)", type=int, default=9,
+                             choices=range(1, 10))
+
+    unpack_parser = subparsers.add_parser("unpack", help="Check a compressed OTA image and extract its app image")
+    unpack_parser.add_argument("input", help="Compressed OTA image", type=argparse.FileType("rb"))
+    unpack_parser.add_argument("output", help="App image (.bin)", type=argparse.FileType("wb"))
+
+    args = parser.parse_args()
+    if args.operation is None:
+        parser.print_help()
+        sys.exit(1)
+
+    data = args.input.read()
+    try:
+        if args.operation == "pack":
+            result = pack(data, args.level)
+            print("Compressed %d bytes to %d bytes (%.1f%%)" % (len(data), len(result), 100.0 * len(result) / len(data)))
+        else:
+            result = unpack(data)
+            print("Extracted %d bytes app image" % len(result))
+    except InputError as e:
+        print(e, file=sys.stderr)
+        sys.exit(2)
+    args.output.write(result)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,237 @@
+#!/usr/bin/env python
+#
+# ota_delta makes a delta OTA image, accepted by esp_ota_write() (see app_update/include/esp_ota_delta.h),
+# from the app image running on the device and a new app image, and applies it back to check it
+#
+# Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http:#www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+from __future__ import print_function, division
+import argparse
+import hashlib
+import os
+import struct
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.realpath(__file__)))
+import ota_compress  # noqa: E402
+from ota_compress import InputError  # noqa: E402
+
+DELTA_MAGIC = 0x44544f45  # "EOTD"
+DELTA_VERSION = 1
+
+# magic, version, reserved, header_size, source_size, source_sha256, image_size
+HEADER = struct.Struct("<IBBHI32sI")
+# diff_len, extra_len, seek
+CONTROL = struct.Struct("<IIi")
+
+# Offset of the hash_appended field of esp_image_header_t
+IMAGE_HASH_APPENDED_OFFSET = 23
+IMAGE_HASH_LEN = 32
+
+# Length of the source image substrings indexed to find matches
+KEY_LEN = 12
+# Every KEY_STRIDE-th substring is indexed, any match of KEY_LEN + KEY_STRIDE - 1 bytes is found
+KEY_STRIDE = 4
+# Source positions kept per substring, limits the search in repeated data (like padding)
+KEY_CANDIDATES = 16
+# Shorter exact matches cost more in control blocks than they save
+MIN_MATCH = 16
+# A match is extended over differing bytes until this many bytes bring no gain
+EXTEND_LOOKAHEAD = 64
+
+
+def image_sha256(image):
+    """ Returns the SHA-256 of an app image, as esp_partition_get_sha256() does on the device """
+    data = bytearray(image[:IMAGE_HASH_APPENDED_OFFSET + 1])
+    if len(image) == 0 or data[0] != ota_compress.ESP_IMAGE_HEADER_MAGIC:
+        raise InputError("Not an app image (expected magic byte 0x%02x)" % ota_compress.ESP_IMAGE_HEADER_MAGIC)
+    if len(data) > IMAGE_HASH_APPENDED_OFFSET and data[IMAGE_HASH_APPENDED_OFFSET] == 1:
+        # The device uses the hash appended to the image, check it is the image as built
+        if len(image) < IMAGE_HASH_LEN or hashlib.sha256(image[:-IMAGE_HASH_LEN]).digest() != image[-IMAGE_HASH_LEN:]:
+            raise InputError("Appended SHA-256 of the app image doesn't match (signed images are not supported)")
+        return image[-IMAGE_HASH_LEN:]
+    return hashlib.sha256(image).digest()
+
+
+def _match_length(a, a_pos, b, b_pos):
+    """ Length of the exact match of a[a_pos:] and b[b_pos:] """
+    length = 0
+    limit = min(len(a) - a_pos, len(b) - b_pos)
+    while length + 64 <= limit and a[a_pos + length:a_pos + length + 64] == b[b_pos + length:b_pos + length + 64]:
+        length += 64
+    while length < limit and a[a_pos + length] == b[b_pos + length]:
+        length += 1
+    return length
+
+
+def _extend(source, source_pos, image, image_pos, limit, step):
+    """ Length of the approximate match going `step` (1 or -1) from the positions, where it is worth a diff """
+    best = score = length = 0
+    while length < limit and length - best < EXTEND_LOOKAHEAD:
+        # As bsdiff: a byte is worth diffing while at least half of them match
+        score += 1 if source[source_pos + length * step] == image[image_pos + length * step] else -1
+        length += 1
+        if score > 0:
+            best = length
+            score = 0
+    return best
+
+
+def _find_matches(source, image):
+    """ Returns the (image_pos, source_pos, length) of approximate matches, in order and not overlapping """
+    index = {}
+    for pos in range(0, len(source) - KEY_LEN + 1, KEY_STRIDE):
+        candidates = index.setdefault(source[pos:pos + KEY_LEN], [])
+        if len(candidates) < KEY_CANDIDATES:
+            candidates.append(pos)
+
+    matches = []
+    last_end = 0            # End of the previous match in the image
+    last_offset = 0         # source_pos - image_pos of the previous match
+    pos = 0
+    while pos + MIN_MATCH <= len(image):
+        best_length = 0
+        best_source = 0
+        # Continuing at the offset of the previous match finds the code following a change
+        if 0 <= pos + last_offset < len(source):
+            best_length = _match_length(source, pos + last_offset, image, pos)
+            best_source = pos + last_offset
+        for shift in range(KEY_STRIDE):
+            for candidate in index.get(image[pos + shift:pos + shift + KEY_LEN], ()):
+                if candidate < shift:
+                    continue
+                length = _match_length(source, candidate - shift, image, pos)
+                if length > best_length:
+                    best_length, best_source = length, candidate - shift
+        if best_length < MIN_MATCH:
+            pos += 1
+            continue
+        # Extend back over the unmatched image data, then forward over small changes
+        back = _extend(source, best_source - 1, image, pos - 1, min(pos - last_end, best_source), -1)
+        forward = _extend(source, best_source + best_length, image, pos + best_length,
+                          min(len(source) - best_source - best_length, len(image) - pos - best_length), 1)
+        matches.append((pos - back, best_source - back, back + best_length + forward))
+        last_end = pos + best_length + forward
+        last_offset = best_source - pos
+        pos = last_end
+    return matches
+
+
+def make_patch(source, image):
+    """ Returns the patch making image from source """
+    matches = _find_matches(source, image)
+    # The first record only has the extra bytes before the first match, then seeks to it
+    next_image, next_source = matches[0][:2] if matches else (len(image), 0)
+    patch = bytearray(CONTROL.pack(0, next_image, next_source) + image[:next_image])
+    for i, (match_image, match_source, length) in enumerate(matches):
+        if i + 1 < len(matches):
+            next_image, next_source = matches[i + 1][:2]
+        else:
+            next_image, next_source = len(image), match_source + length
+        patch += CONTROL.pack(length, next_image - match_image - length, next_source - match_source - length)
+        patch += bytearray((a - b) & 0xff for a, b in zip(bytearray(image[match_image:match_image + length]),
+                                                          bytearray(source[match_source:match_source + length])))
+        patch += image[match_image + length:next_image]
+    return bytes(patch)
+
+
+def apply_patch(source, patch, image_size):
+    """ Returns the image made by applying patch to source, checking it as esp_ota_write() does """
+    image = bytearray()
+    source = bytearray(source)
+    pos = 0
+    source_pos = 0
+    while len(image) < image_size:
+        if pos + CONTROL.size > len(patch):
+            raise InputError("Patch is truncated")
+        diff_len, extra_len, seek = CONTROL.unpack_from(patch, pos)
+        pos += CONTROL.size
+        if len(image) + diff_len + extra_len > image_size or source_pos + diff_len > len(source) or \
+                not 0 <= source_pos + diff_len + seek <= len(source) or pos + diff_len + extra_len > len(patch):
+            raise InputError("Invalid patch record at image offset %d" % len(image))
+        diff = bytearray(patch[pos:pos + diff_len])
+        image += bytearray((a + b) & 0xff for a, b in zip(diff, source[source_pos:source_pos + diff_len]))
+        image += patch[pos + diff_len:pos + diff_len + extra_len]
+        pos += diff_len + extra_len
+        source_pos += diff_len + seek
+    if pos != len(patch):
+        raise InputError("%d bytes after the end of the patch" % (len(patch) - pos))
+    return bytes(image)
+
+
+def diff(source, image, level=9):
+    """ Returns the delta OTA image making the app image `image` from the app image `source` """
+    source_sha256 = image_sha256(source)
+    image_sha256(image)
+    patch = make_patch(source, image)
+    return HEADER.pack(DELTA_MAGIC, DELTA_VERSION, 0, HEADER.size, len(source), source_sha256, len(image)) + \
+        ota_compress.compress(patch, level)
+
+
+def patch(source, delta):
+    """ Returns the app image made from the app image `source` by a delta OTA image """
+    if len(delta) < HEADER.size:
+        raise InputError("Delta image is too short")
+    magic, version, _, header_size, source_size, source_sha256, image_size = HEADER.unpack_from(delta)
+    if magic != DELTA_MAGIC:
+        raise InputError("Invalid magic 0x%08x" % magic)
+    if version != DELTA_VERSION or header_size < HEADER.size:
+        raise InputError("Unsupported version %d" % version)
+    if len(source) != source_size or image_sha256(source) != source_sha256:
+        raise InputError("Delta image was made from another source image")
+    return apply_patch(source, ota_compress.unpack(delta[header_size:]), image_size)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="ESP32 delta OTA image generator")
+    subparsers = parser.add_subparsers(dest="operation", help="Run ota_delta.py {command} -h for additional help")
+
+    diff_parser = subparsers.add_parser("diff", help="Make a delta OTA image from the running app image to a new one")
+    diff_parser.add_argument("source", help="App image running on the device (.bin)", type=argparse.FileType("rb"))
+    diff_parser.add_argument("input", help="New app image (.bin)", type=argparse.FileType("rb"))
+    diff_parser.add_argument("output", help="Delta OTA image", type=argparse.FileType("wb"))
+    diff_parser.add_argument("--level", help="zlib compression level (default: %(default)s)", type=int, default=9,
+                             choices=range(1, 10))
+
+    patch_parser = subparsers.add_parser("patch", help="Check a delta OTA image and make the new app image from it")
+    patch_parser.add_argument("source", help="App image the delta image was made from (.bin)", type=argparse.FileType("rb"))
+    patch_parser.add_argument("input", help="Delta OTA image", type=argparse.FileType("rb"))
+    patch_parser.add_argument("output", help="New app image (.bin)", type=argparse.FileType("wb"))
+
+    args = parser.parse_args()
+    if args.operation is None:
+        parser.print_help()
+        sys.exit(1)
+
+    source = args.source.read()
+    data = args.input.read()
+    try:
+        if args.operation == "diff":
+            result = diff(source, data, args.level)
+            if patch(source, result) != data:
+                raise InputError("Delta image doesn't make the new app image")
+            print("Delta of %d bytes (%.1f%% of the %d bytes app image, %.1f%% of the compressed app image)" %
+                  (len(result), 100.0 * len(result) / len(data), len(data),
+                   100.0 * len(result) / len(ota_compress.compress(data, args.level))))
+        else:
+            result = patch(source, data)
+            print("Made %d bytes app image" % len(result))
+    except InputError as e:
+        print(e, file=sys.stderr)
+        sys.exit(2)
+    args.output.write(result)
+
+
+if __name__ == "__main__":
+    main()
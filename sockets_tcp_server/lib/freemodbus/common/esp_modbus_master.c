@@ -17,7 +17,9 @@
 #include "mbc_master.h"         // for master interface define
 #include "esp_modbus_master.h"  // for public interface defines
 #include "mbc_serial_master.h"      // for create function of the port
+#include "mbc_tcp_master.h"         // for create function of the port
 #include "esp_modbus_callbacks.h"   // for callback functions
+#include "mbc_scan_plan.h"          // for scan planner
 
 // This file implements public API for Modbus master controller. 
 // These functions are wrappers for interface functions of the controller
@@ -36,9 +38,8 @@ esp_err_t mbc_master_init(mb_port_type_t port_type, void** handler)
         error = mbc_serial_master_create(port_type, &port_handler);
         break;
     case MB_PORT_TCP_MASTER:
-        // TCP MAster is not yet supported
-        //error = mbc_tcp_master_create(port_type, &port_handler);
-        return ESP_ERR_NOT_SUPPORTED;
+        error = mbc_tcp_master_create(port_type, &port_handler);
+        break;
     default:
         return ESP_ERR_NOT_SUPPORTED;
     }
@@ -70,7 +71,7 @@ esp_err_t mbc_master_destroy(void)
     error = master_interface_ptr->destroy();
     MB_MASTER_CHECK((error == ESP_OK), 
                     error, 
-                    "SERIAL master destroy failure error=(0x%x).", 
+                    "Master destroy failure error=(0x%x).", 
                     error);
     return error;
 }
@@ -87,7 +88,7 @@ esp_err_t mbc_master_get_cid_info(uint16_t cid, const mb_parameter_descriptor_t*
     error = master_interface_ptr->get_cid_info(cid, param_info);
     MB_MASTER_CHECK((error == ESP_OK), 
                     error, 
-                    "SERIAL master get cid info failure error=(0x%x).", 
+                    "Master get cid info failure error=(0x%x).", 
                     error);
     return error;
 }
@@ -107,7 +108,7 @@ esp_err_t mbc_master_get_parameter(uint16_t cid, char* name, uint8_t* value, uin
     error = master_interface_ptr->get_parameter(cid, name, value, type);
     MB_MASTER_CHECK((error == ESP_OK), 
                     error,
-                    "SERIAL master get parameter failure error=(0x%x) (%s).",
+                    "Master get parameter failure error=(0x%x) (%s).",
                     error, esp_err_to_name(error));
     return error;
 }
@@ -127,7 +128,7 @@ esp_err_t mbc_master_send_request(mb_param_request_t* request, void* data_ptr)
     error = master_interface_ptr->send_request(request, data_ptr);
     MB_MASTER_CHECK((error == ESP_OK), 
                     error,
-                    "SERIAL master send request failure error=(0x%x) (%s).",
+                    "Master send request failure error=(0x%x) (%s).",
                     error, esp_err_to_name(error));
     return ESP_OK;
 }
@@ -147,7 +148,7 @@ esp_err_t mbc_master_set_descriptor(const mb_parameter_descriptor_t* descriptor,
     error = master_interface_ptr->set_descriptor(descriptor, num_elements);
     MB_MASTER_CHECK((error == ESP_OK), 
                     error,
-                    "SERIAL master set descriptor failure error=(0x%x) (%s).",
+                    "Master set descriptor failure error=(0x%x) (%s).",
                     error, esp_err_to_name(error));
     return ESP_OK;
 }
@@ -167,7 +168,7 @@ esp_err_t mbc_master_set_parameter(uint16_t cid, char* name, uint8_t* value, uin
     error = master_interface_ptr->set_parameter(cid, name, value, type);
     MB_MASTER_CHECK((error == ESP_OK), 
                     error,
-                    "SERIAL master set parameter failure error=(0x%x) (%s).",
+                    "Master set parameter failure error=(0x%x) (%s).",
                     error, esp_err_to_name(error));
     return ESP_OK;
 }
@@ -187,7 +188,7 @@ esp_err_t mbc_master_setup(void* comm_info)
     error = master_interface_ptr->setup(comm_info);
     MB_MASTER_CHECK((error == ESP_OK), 
                     error,
-                    "SERIAL master setup failure error=(0x%x) (%s).",
+                    "Master setup failure error=(0x%x) (%s).",
                     error, esp_err_to_name(error));
     return ESP_OK;
 }
@@ -207,11 +208,68 @@ esp_err_t mbc_master_start(void)
     error = master_interface_ptr->start();
     MB_MASTER_CHECK((error == ESP_OK), 
                     error,
-                    "SERIAL master start failure error=(0x%x) (%s).",
+                    "Master start failure error=(0x%x) (%s).",
                     error, esp_err_to_name(error));
     return ESP_OK;
 }
 
+/**
+ * Plan the requests reading a list of characteristics
+ */
+esp_err_t mbc_master_scan_plan_create(const uint16_t* cids, uint16_t cid_count, uint16_t max_gap,
+                                        mb_scan_plan_handle_t* plan)
+{
+    esp_err_t error = ESP_OK;
+    MB_MASTER_CHECK((master_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    const mb_master_options_t* mbm_opts = &master_interface_ptr->opts;
+    MB_MASTER_CHECK((mbm_opts->mbm_param_descriptor_table != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master parameter description table is not set.");
+    error = mbc_scan_plan_create(mbm_opts->mbm_param_descriptor_table, mbm_opts->mbm_param_descriptor_size,
+                                    cids, cid_count, max_gap, plan);
+    MB_MASTER_CHECK((error == ESP_OK),
+                    error,
+                    "Master scan plan create failure error=(0x%x) (%s).",
+                    error, esp_err_to_name(error));
+    return ESP_OK;
+}
+
+/**
+ * Read the characteristics of a scan plan
+ */
+esp_err_t mbc_master_scan(mb_scan_plan_handle_t plan, uint8_t* const* values, esp_err_t* errors)
+{
+    MB_MASTER_CHECK((master_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    MB_MASTER_CHECK((master_interface_ptr->send_request != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    MB_MASTER_CHECK(((plan != NULL) && (values != NULL)),
+                    ESP_ERR_INVALID_ARG,
+                    "Master scan plan or values are incorrect.");
+    MB_MASTER_CHECK((mbc_scan_plan_get_table(plan) == master_interface_ptr->opts.mbm_param_descriptor_table),
+                    ESP_ERR_INVALID_STATE,
+                    "Master parameter description table changed since the scan plan was created.");
+    // The errors of the characteristics are reported in errors, no log for each poll
+    return mbc_scan_plan_execute(plan, master_interface_ptr->send_request, master_interface_ptr->send_requests,
+                                    values, errors);
+}
+
+/**
+ * Delete a scan plan
+ */
+esp_err_t mbc_master_scan_plan_delete(mb_scan_plan_handle_t plan)
+{
+    MB_MASTER_CHECK((plan != NULL),
+                    ESP_ERR_INVALID_ARG,
+                    "Master scan plan is incorrect.");
+    mbc_scan_plan_delete(plan);
+    return ESP_OK;
+}
+
 eMBErrorCode eMBMasterRegDiscreteCB(UCHAR * pucRegBuffer, USHORT usAddress,
                             USHORT usNDiscrete)
 {
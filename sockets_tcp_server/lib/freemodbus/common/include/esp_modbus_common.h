@@ -128,6 +128,9 @@ typedef union {
         uint32_t dummy_baudrate;                /*!< Modbus baudrate */
         uart_parity_t dummy_parity;             /*!< Modbus UART parity settings */
         uint16_t tcp_port;                      /*!< Modbus TCP port */
+        const char* const* ip_addr;             /*!< Modbus TCP master: NULL terminated table of the slave addresses
+                                                     ("host" or "host:port", tcp_port by default),
+                                                     the slave address N selects the entry N - 1 */
     };
 } mb_communication_info_t;
 
@@ -107,6 +107,11 @@ typedef struct {
     uint16_t reg_size;              /*!< Modbus number of registers */
 } mb_param_request_t;
 
+/**
+ * @brief Handle of a scan plan reading a list of characteristics, see mbc_master_scan_plan_create()
+ */
+typedef struct mb_scan_plan* mb_scan_plan_handle_t;
+
 // Master interface public functions
 /**
  * @brief Initialize Modbus controller and stack
@@ -242,6 +247,65 @@ esp_err_t mbc_master_get_parameter(uint16_t cid, char* name, uint8_t* value, uin
 */
 esp_err_t mbc_master_set_parameter(uint16_t cid, char* name, uint8_t* value, uint8_t *type);
 
+/**
+ * @brief Plan the requests reading a list of characteristics. The register ranges of the characteristics
+ *        of the same slave and register type are joined into the fewest multi-register read requests
+ *        (up to 125 registers or 2000 coils or discrete inputs each), so that polling many characteristics
+ *        does not cost one request and response per characteristic. The plan is built once and used
+ *        by mbc_master_scan() on each poll.
+ *
+ * @note  Registers between the ranges of two characteristics are also read to join them
+ *        if there are at most max_gap of them. The slave may refuse to read registers it does not have,
+ *        then the characteristics are read separately (see mbc_master_scan()).
+ *
+ * @param[in] cids list of characteristic ids to read
+ * @param cid_count number of characteristics in the list
+ * @param max_gap maximum number of unused registers (coils or discrete inputs) read to join two ranges,
+ *        0 joins adjacent or overlapping ranges only
+ * @param[out] plan handle of the created plan
+ *
+ * @return
+ *     - esp_err_t ESP_OK - the plan was created
+ *     - esp_err_t ESP_ERR_INVALID_ARG - invalid argument of function or characteristic
+ *     - esp_err_t ESP_ERR_INVALID_STATE - the parameter description table is not set
+ *     - esp_err_t ESP_ERR_NOT_FOUND - the characteristic (cid) not found
+ *     - esp_err_t ESP_ERR_NO_MEM - out of memory
+ */
+esp_err_t mbc_master_scan_plan_create(const uint16_t* cids, uint16_t cid_count, uint16_t max_gap,
+                                        mb_scan_plan_handle_t* plan);
+
+/**
+ * @brief Read the characteristics of a scan plan. Each request of the plan is sent, waiting its response,
+ *        and its data is scattered to the value buffers of the characteristics it reads. Each value buffer
+ *        is filled as mbc_master_get_parameter() does.
+ *
+ * @note  If the slave answers a joined request with an exception, its characteristics are read separately,
+ *        on this scan and the next ones of the plan.
+ *
+ * @param plan handle of the plan created by mbc_master_scan_plan_create()
+ * @param[out] values value buffer of each characteristic, in the order of the cid list of the plan
+ * @param[out] errors result of each characteristic, in the order of the cid list, can be NULL
+ *
+ * @return
+ *     - esp_err_t ESP_OK - all the characteristics were read
+ *     - esp_err_t ESP_ERR_INVALID_ARG - invalid argument of function
+ *     - esp_err_t ESP_ERR_INVALID_STATE - the parameter description table changed since the plan was created
+ *     - the first error returned by a request (see mbc_master_send_request()), the other characteristics
+ *       are still read, see errors
+ */
+esp_err_t mbc_master_scan(mb_scan_plan_handle_t plan, uint8_t* const* values, esp_err_t* errors);
+
+/**
+ * @brief Delete a scan plan
+ *
+ * @param plan handle of the plan created by mbc_master_scan_plan_create()
+ *
+ * @return
+ *     - esp_err_t ESP_OK - the plan was deleted
+ *     - esp_err_t ESP_ERR_INVALID_ARG - plan is NULL
+ */
+esp_err_t mbc_master_scan_plan_delete(mb_scan_plan_handle_t plan);
+
 #ifdef __cplusplus
 }
 #endif
@@ -78,6 +78,7 @@ typedef esp_err_t (*iface_get_parameter)(uint16_t, char*, uint8_t*, uint8_t*);
 typedef esp_err_t (*iface_send_request)(mb_param_request_t*, void*);                  /*!< Interface send_request method */
 typedef esp_err_t (*iface_set_descriptor)(const mb_parameter_descriptor_t*, const uint16_t); /*!< Interface set_descriptor method */
 typedef esp_err_t (*iface_set_parameter)(uint16_t, char*, uint8_t*, uint8_t*);        /*!< Interface set_parameter method */
+typedef esp_err_t (*iface_send_requests)(mb_param_request_t*, void* const*, esp_err_t*, uint16_t); /*!< Interface send_requests method */
 
 /**
  * @brief Modbus controller interface structure
@@ -96,6 +97,7 @@ typedef struct {
     iface_send_request send_request;        /*!< Interface send_request method */
     iface_set_descriptor set_descriptor;    /*!< Interface set_descriptor method */
     iface_set_parameter set_parameter;      /*!< Interface set_parameter method */
+    iface_send_requests send_requests;      /*!< Interface send_requests method, sends several requests at once (optional) */
     // Modbus register calback function pointers
     reg_discrete_cb master_reg_cb_discrete; /*!< Stack callback discrete rw method */
     reg_input_cb master_reg_cb_input;       /*!< Stack callback input rw method */
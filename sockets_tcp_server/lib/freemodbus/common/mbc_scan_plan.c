@@ -0,0 +1,332 @@
+/* Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// mbc_scan_plan.c
+// Reads a list of characteristics with the fewest requests: the register ranges
+// of each slave and Modbus function are joined into multi-register requests.
+
+#include <stdbool.h>                // for bool
+#include <stdlib.h>                 // for calloc, qsort
+#include <string.h>                 // for memcpy
+#include "esp_log.h"                // for log_write
+#include "port.h"                   // for port types used by mbproto.h
+#include "mbproto.h"                // for Modbus function codes
+#include "mbc_scan_plan.h"
+
+static const char *TAG = "MB_SCAN_PLAN";
+
+// Characteristic of the cid list
+typedef struct {
+    const mb_parameter_descriptor_t* reg_info;  // Parameter description
+    uint16_t index;                             // Index in the cid list
+} mb_scan_item_t;
+
+// Request reading the registers of consecutive items
+typedef struct {
+    size_t buffer_offset;                       // Offset of the data of the request in the plan buffer
+    mb_param_request_t request;
+    uint16_t first_item;                        // Index of the first item in the plan items
+    uint16_t item_count;                        // Number of items read by the request
+    bool split;                                 // The slave refused the request, the items are read one by one
+} mb_scan_request_t;
+
+struct mb_scan_plan {
+    const mb_parameter_descriptor_t* table;     // Parameter description table the plan is built from
+    uint16_t item_count;
+    uint16_t request_count;
+    mb_scan_item_t* items;                      // Items sorted by slave, function and register
+    mb_scan_request_t* requests;
+    uint8_t* buffer;                            // Data of all the requests
+    // Requests sent at once, up to item_count
+    mb_param_request_t* batch_requests;
+    void** batch_data;
+    esp_err_t* batch_errors;
+};
+
+static uint8_t mbc_scan_get_command(mb_param_type_t param_type)
+{
+    switch (param_type) {
+        case MB_PARAM_HOLDING:
+            return MB_FUNC_READ_HOLDING_REGISTER;
+        case MB_PARAM_INPUT:
+            return MB_FUNC_READ_INPUT_REGISTER;
+        case MB_PARAM_COIL:
+            return MB_FUNC_READ_COILS;
+        case MB_PARAM_DISCRETE:
+            return MB_FUNC_READ_DISCRETE_INPUTS;
+        default:
+            return MB_FUNC_NONE;
+    }
+}
+
+static bool mbc_scan_is_bit_command(uint8_t command)
+{
+    return (command == MB_FUNC_READ_COILS) || (command == MB_FUNC_READ_DISCRETE_INPUTS);
+}
+
+// Size of the data read by a request, as filled by the register callbacks of the master
+static size_t mbc_scan_get_data_size(uint8_t command, uint16_t reg_size)
+{
+    if (mbc_scan_is_bit_command(command)) {
+        // The bits start at the bit (reg_start % 8) of the buffer
+        return reg_size / 8 + 2;
+    }
+    return reg_size * 2;
+}
+
+static int mbc_scan_compare_items(const void* a, const void* b)
+{
+    const mb_parameter_descriptor_t* reg_a = ((const mb_scan_item_t*)a)->reg_info;
+    const mb_parameter_descriptor_t* reg_b = ((const mb_scan_item_t*)b)->reg_info;
+    if (reg_a->mb_slave_addr != reg_b->mb_slave_addr) {
+        return (int)reg_a->mb_slave_addr - (int)reg_b->mb_slave_addr;
+    }
+    if (reg_a->mb_param_type != reg_b->mb_param_type) {
+        return (int)reg_a->mb_param_type - (int)reg_b->mb_param_type;
+    }
+    if (reg_a->mb_reg_start != reg_b->mb_reg_start) {
+        return (int)reg_a->mb_reg_start - (int)reg_b->mb_reg_start;
+    }
+    // Keep the order of the cid list, qsort is not stable
+    return (int)((const mb_scan_item_t*)a)->index - (int)((const mb_scan_item_t*)b)->index;
+}
+
+esp_err_t mbc_scan_plan_create(const mb_parameter_descriptor_t* table, size_t table_size,
+                                const uint16_t* cids, uint16_t cid_count, uint16_t max_gap,
+                                mb_scan_plan_handle_t* plan)
+{
+    if ((table == NULL) || (cids == NULL) || (cid_count == 0) || (plan == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (uint16_t i = 0; i < cid_count; i++) {
+        if (cids[i] >= table_size) {
+            ESP_LOGE(TAG, "cid(%u) is not in the parameter description table.", cids[i]);
+            return ESP_ERR_NOT_FOUND;
+        }
+        const mb_parameter_descriptor_t* reg_info = &table[cids[i]];
+        if ((mbc_scan_get_command(reg_info->mb_param_type) == MB_FUNC_NONE) || (reg_info->mb_size == 0)) {
+            ESP_LOGE(TAG, "cid(%u) has an incorrect parameter type or size.", cids[i]);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    // The requests can't outnumber the items
+    struct mb_scan_plan* new_plan = calloc(1, sizeof(struct mb_scan_plan)
+                                            + cid_count * (sizeof(mb_scan_item_t) + sizeof(void*)
+                                                + sizeof(mb_scan_request_t) + sizeof(esp_err_t)
+                                                + sizeof(mb_param_request_t)));
+    if (new_plan == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    new_plan->table = table;
+    new_plan->item_count = cid_count;
+    new_plan->items = (mb_scan_item_t*)(new_plan + 1);
+    new_plan->batch_data = (void**)(new_plan->items + cid_count);
+    new_plan->requests = (mb_scan_request_t*)(new_plan->batch_data + cid_count);
+    new_plan->batch_errors = (esp_err_t*)(new_plan->requests + cid_count);
+    new_plan->batch_requests = (mb_param_request_t*)(new_plan->batch_errors + cid_count);
+    for (uint16_t i = 0; i < cid_count; i++) {
+        new_plan->items[i].reg_info = &table[cids[i]];
+        new_plan->items[i].index = i;
+    }
+    qsort(new_plan->items, cid_count, sizeof(mb_scan_item_t), mbc_scan_compare_items);
+
+    size_t buffer_size = 0;
+    mb_scan_request_t* request = NULL;
+    uint32_t request_end = 0;
+    for (uint16_t i = 0; i < cid_count; i++) {
+        const mb_parameter_descriptor_t* reg_info = new_plan->items[i].reg_info;
+        uint8_t command = mbc_scan_get_command(reg_info->mb_param_type);
+        uint32_t reg_end = (uint32_t)reg_info->mb_reg_start + reg_info->mb_size;
+        uint32_t count_max = mbc_scan_is_bit_command(command) ? MB_SCAN_BIT_COUNT_MAX : MB_SCAN_REG_COUNT_MAX;
+        if ((request != NULL)
+                && (request->request.slave_addr == reg_info->mb_slave_addr)
+                && (request->request.command == command)
+                && (reg_info->mb_reg_start <= request_end + max_gap)
+                && (((reg_end > request_end) ? reg_end : request_end) - request->request.reg_start <= count_max)) {
+            // Join the range of the item to the request
+            if (reg_end > request_end) {
+                request_end = reg_end;
+            }
+            request->request.reg_size = request_end - request->request.reg_start;
+            request->item_count++;
+        } else {
+            if (request != NULL) {
+                buffer_size += mbc_scan_get_data_size(request->request.command, request->request.reg_size);
+            }
+            request = &new_plan->requests[new_plan->request_count++];
+            request->buffer_offset = buffer_size;
+            request->request.slave_addr = reg_info->mb_slave_addr;
+            request->request.command = command;
+            request->request.reg_start = reg_info->mb_reg_start;
+            request->request.reg_size = reg_info->mb_size;
+            request->first_item = i;
+            request->item_count = 1;
+            request_end = reg_end;
+        }
+    }
+    // Each request has its own data to be sent at once with the others
+    buffer_size += mbc_scan_get_data_size(request->request.command, request->request.reg_size);
+    new_plan->buffer = malloc(buffer_size);
+    if (new_plan->buffer == NULL) {
+        free(new_plan);
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGD(TAG, "%u characteristics read with %u requests.", cid_count, new_plan->request_count);
+    *plan = new_plan;
+    return ESP_OK;
+}
+
+// Copy the data of an item from the data of its request, where it is placed as if the item was read alone
+static void mbc_scan_scatter(const mb_param_request_t* request, const uint8_t* data,
+                                const mb_parameter_descriptor_t* reg_info, uint8_t* value)
+{
+    uint16_t offset = reg_info->mb_reg_start - request->reg_start;
+    if (!mbc_scan_is_bit_command(request->command)) {
+        memcpy(value, data + offset * 2, reg_info->mb_size * 2);
+        return;
+    }
+    // The bits are only set or cleared, as xMBUtilSetBits() does in the register callbacks
+    uint32_t src_bit = request->reg_start % 8 + offset;
+    uint32_t dst_bit = reg_info->mb_reg_start % 8;
+    for (uint16_t count = reg_info->mb_size; count > 0; count--, src_bit++, dst_bit++) {
+        uint8_t mask = 1 << (dst_bit % 8);
+        if (data[src_bit / 8] & (1 << (src_bit % 8))) {
+            value[dst_bit / 8] |= mask;
+        } else {
+            value[dst_bit / 8] &= ~mask;
+        }
+    }
+}
+
+// Send the batch of requests, at once if the interface can
+static void mbc_scan_send_batch(mb_scan_plan_handle_t plan, mb_scan_send_request_t send_request,
+                                mb_scan_send_requests_t send_requests, uint16_t count)
+{
+    if (send_requests != NULL) {
+        send_requests(plan->batch_requests, plan->batch_data, plan->batch_errors, count);
+        return;
+    }
+    for (uint16_t i = 0; i < count; i++) {
+        plan->batch_errors[i] = send_request(&plan->batch_requests[i], plan->batch_data[i]);
+    }
+}
+
+esp_err_t mbc_scan_plan_execute(mb_scan_plan_handle_t plan, mb_scan_send_request_t send_request,
+                                mb_scan_send_requests_t send_requests,
+                                uint8_t* const* values, esp_err_t* errors)
+{
+    if ((plan == NULL) || ((send_request == NULL) && (send_requests == NULL)) || (values == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t result = ESP_OK;
+    uint16_t count = 0;
+    for (uint16_t i = 0; i < plan->request_count; i++) {
+        const mb_scan_request_t* request = &plan->requests[i];
+        if (!request->split) {
+            plan->batch_requests[count] = request->request;
+            plan->batch_data[count] = plan->buffer + request->buffer_offset;
+            count++;
+        }
+    }
+    mbc_scan_send_batch(plan, send_request, send_requests, count);
+    count = 0;
+    for (uint16_t i = 0; i < plan->request_count; i++) {
+        mb_scan_request_t* request = &plan->requests[i];
+        if (request->split) {
+            continue;
+        }
+        const mb_scan_item_t* items = &plan->items[request->first_item];
+        esp_err_t error = plan->batch_errors[count++];
+        if ((error == ESP_ERR_INVALID_RESPONSE) && (request->item_count > 1)) {
+            // The slave refuses the joined request, some registers between the items may not exist:
+            // read the items one by one, on the next executions too
+            ESP_LOGW(TAG, "slave(%u) refuses to read registers %u-%u at once, reading them separately.",
+                            request->request.slave_addr, request->request.reg_start,
+                            request->request.reg_start + request->request.reg_size - 1);
+            request->split = true;
+            continue;
+        }
+        for (uint16_t j = 0; j < request->item_count; j++) {
+            if (error == ESP_OK) {
+                mbc_scan_scatter(&request->request, plan->buffer + request->buffer_offset,
+                                    items[j].reg_info, values[items[j].index]);
+            }
+            if (errors != NULL) {
+                errors[items[j].index] = error;
+            }
+        }
+        if ((error != ESP_OK) && (result == ESP_OK)) {
+            result = error;
+        }
+    }
+
+    // The items of the split requests are read to their value directly
+    count = 0;
+    for (uint16_t i = 0; i < plan->request_count; i++) {
+        const mb_scan_request_t* request = &plan->requests[i];
+        for (uint16_t j = 0; request->split && (j < request->item_count); j++) {
+            const mb_scan_item_t* item = &plan->items[request->first_item + j];
+            plan->batch_requests[count].slave_addr = item->reg_info->mb_slave_addr;
+            plan->batch_requests[count].command = request->request.command;
+            plan->batch_requests[count].reg_start = item->reg_info->mb_reg_start;
+            plan->batch_requests[count].reg_size = item->reg_info->mb_size;
+            plan->batch_data[count] = values[item->index];
+            count++;
+        }
+    }
+    if (count == 0) {
+        return result;
+    }
+    mbc_scan_send_batch(plan, send_request, send_requests, count);
+    count = 0;
+    for (uint16_t i = 0; i < plan->request_count; i++) {
+        const mb_scan_request_t* request = &plan->requests[i];
+        for (uint16_t j = 0; request->split && (j < request->item_count); j++) {
+            esp_err_t error = plan->batch_errors[count++];
+            if (errors != NULL) {
+                errors[plan->items[request->first_item + j].index] = error;
+            }
+            if ((error != ESP_OK) && (result == ESP_OK)) {
+                result = error;
+            }
+        }
+    }
+    return result;
+}
+
+const mb_parameter_descriptor_t* mbc_scan_plan_get_table(mb_scan_plan_handle_t plan)
+{
+    return (plan != NULL) ? plan->table : NULL;
+}
+
+uint16_t mbc_scan_plan_get_request_count(mb_scan_plan_handle_t plan)
+{
+    uint16_t count = 0;
+    if (plan != NULL) {
+        for (uint16_t i = 0; i < plan->request_count; i++) {
+            count += plan->requests[i].split ? plan->requests[i].item_count : 1;
+        }
+    }
+    return count;
+}
+
+void mbc_scan_plan_delete(mb_scan_plan_handle_t plan)
+{
+    if (plan != NULL) {
+        free(plan->buffer);
+        free(plan);
+    }
+}
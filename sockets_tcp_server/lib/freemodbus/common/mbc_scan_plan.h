@@ -0,0 +1,91 @@
+/* Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _MB_CONTROLLER_SCAN_PLAN_H
+#define _MB_CONTROLLER_SCAN_PLAN_H
+
+#include <stdint.h>                 // for standard int types definition
+#include <stddef.h>                 // for size_t
+#include "esp_err.h"                // for esp_err_t
+#include "esp_modbus_master.h"      // for public master types
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Scan planner of the Modbus master controller. It does not depend on the port,
+// the requests are sent by the send_request or send_requests method of the master interface.
+
+#define MB_SCAN_REG_COUNT_MAX   (125)   // Registers in a read holding/input registers request
+#define MB_SCAN_BIT_COUNT_MAX   (2000)  // Bits in a read coils/discrete inputs request
+
+typedef esp_err_t (*mb_scan_send_request_t)(mb_param_request_t*, void*); /*!< Same as the interface send_request method */
+typedef esp_err_t (*mb_scan_send_requests_t)(mb_param_request_t*, void* const*, esp_err_t*, uint16_t); /*!< Same as the interface send_requests method */
+
+/**
+ * @brief Build the requests reading the characteristics of a cid list
+ *
+ * @param[in] table parameter description table, cid is the index in the table
+ * @param table_size number of elements in the table
+ * @param[in] cids list of characteristics to read
+ * @param cid_count number of characteristics in the list
+ * @param max_gap registers (bits for coils and discrete inputs) not in the list read to join two ranges
+ * @param[out] plan the created plan
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Invalid argument or characteristic that can't be read
+ *     - ESP_ERR_NOT_FOUND cid not in the table
+ *     - ESP_ERR_NO_MEM Out of memory
+ */
+esp_err_t mbc_scan_plan_create(const mb_parameter_descriptor_t* table, size_t table_size,
+                                const uint16_t* cids, uint16_t cid_count, uint16_t max_gap,
+                                mb_scan_plan_handle_t* plan);
+
+/**
+ * @brief Send the requests of the plan and scatter the read data to the characteristic values
+ *
+ * @param plan plan created by mbc_scan_plan_create()
+ * @param send_request function sending a request and waiting for its response
+ * @param send_requests function sending several requests at once and waiting for all their responses,
+ *        used instead of send_request if not NULL
+ * @param[out] values value buffer of each characteristic of the cid list, filled as by mbc_master_get_parameter()
+ * @param[out] errors result of each characteristic of the cid list, can be NULL
+ *
+ * @return ESP_OK if all the characteristics were read, otherwise the first error
+ */
+esp_err_t mbc_scan_plan_execute(mb_scan_plan_handle_t plan, mb_scan_send_request_t send_request,
+                                mb_scan_send_requests_t send_requests,
+                                uint8_t* const* values, esp_err_t* errors);
+
+/**
+ * @brief Get the parameter description table the plan was built from
+ */
+const mb_parameter_descriptor_t* mbc_scan_plan_get_table(mb_scan_plan_handle_t plan);
+
+/**
+ * @brief Get the number of requests sent by one execution of the plan
+ */
+uint16_t mbc_scan_plan_get_request_count(mb_scan_plan_handle_t plan);
+
+/**
+ * @brief Free the plan
+ */
+void mbc_scan_plan_delete(mb_scan_plan_handle_t plan);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _MB_CONTROLLER_SCAN_PLAN_H
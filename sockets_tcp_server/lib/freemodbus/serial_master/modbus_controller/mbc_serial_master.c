@@ -693,6 +693,7 @@ esp_err_t mbc_serial_master_create(mb_port_type_t port_type, void** handler)
     mbm_interface_ptr->send_request = mbc_serial_master_send_request;
     mbm_interface_ptr->set_descriptor = mbc_serial_master_set_descriptor;
     mbm_interface_ptr->set_parameter = mbc_serial_master_set_parameter;
+    mbm_interface_ptr->send_requests = NULL; // The requests are sent one by one
 
     mbm_interface_ptr->master_reg_cb_discrete = eMBRegDiscreteCBSerialMaster;
     mbm_interface_ptr->master_reg_cb_input = eMBRegInputCBSerialMaster;
@@ -0,0 +1,549 @@
+/* Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// mbc_tcp_master.c
+// TCP master implementation of the Modbus controller
+// The request and response PDUs are built here and the transactions are done by the port, which
+// may have several transactions outstanding on a connection, so that the requests of several tasks
+// and the requests of a scan plan are sent without waiting for the previous responses.
+// The data layout of the values is the same as for the serial master.
+
+#include <stdlib.h>                 // for calloc
+#include <string.h>                 // for memcpy
+#include "esp_log.h"                // for log_write
+#include "port.h"                   // for port types
+#include "mbproto.h"                // for Modbus function codes
+#include "sdkconfig.h"              // for KConfig values
+#include "esp_modbus_common.h"      // for common types
+#include "esp_modbus_master.h"      // for public master types
+#include "mbc_master.h"             // for private master types
+#include "mbc_tcp_master.h"         // for tcp master create function and types
+#include "port_tcp_master.h"        // for the transactions
+
+// Quantities allowed by the Modbus application protocol
+#define MB_TCP_READ_BITS_MAX        (2000)
+#define MB_TCP_READ_REGS_MAX        (125)
+#define MB_TCP_WRITE_BITS_MAX       (1968)
+#define MB_TCP_WRITE_REGS_MAX       (123)
+#define MB_TCP_READWRITE_REGS_MAX   (121)
+
+#define MB_TCP_COIL_ON              (0xFF00)
+
+static mb_master_interface_t* mbm_interface_ptr = NULL;
+
+static void mbc_tcp_master_set_u16(uint8_t* buf, uint16_t value)
+{
+    buf[0] = (uint8_t)(value >> 8);
+    buf[1] = (uint8_t)value;
+}
+
+static uint16_t mbc_tcp_master_get_u16(const uint8_t* buf)
+{
+    return ((uint16_t)buf[0] << 8) | buf[1];
+}
+
+// Setup Modbus controller parameters
+static esp_err_t mbc_tcp_master_setup(void* comm_info)
+{
+    MB_MASTER_CHECK((mbm_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface uninitialized.");
+    mb_master_options_t* mbm_opts = &mbm_interface_ptr->opts;
+
+    const mb_communication_info_t* comm_info_ptr = (mb_communication_info_t*)comm_info;
+    MB_MASTER_CHECK((comm_info_ptr != NULL), ESP_ERR_INVALID_ARG, "mb incorrect communication info.");
+    // Check communication options
+    MB_MASTER_CHECK((comm_info_ptr->tcp_mode == MB_MODE_TCP),
+                ESP_ERR_INVALID_ARG, "mb incorrect mode = (0x%x).",
+                (uint32_t)comm_info_ptr->tcp_mode);
+    MB_MASTER_CHECK(((comm_info_ptr->ip_addr != NULL) && (comm_info_ptr->ip_addr[0] != NULL)),
+                ESP_ERR_INVALID_ARG, "mb incorrect slave address table.");
+    // Save the communication options
+    mbm_opts->mbm_comm = *comm_info_ptr;
+    if (mbm_opts->mbm_comm.tcp_port == 0) {
+        mbm_opts->mbm_comm.tcp_port = CONFIG_FMB_TCP_PORT_DEFAULT;
+    }
+    return ESP_OK;
+}
+
+// Modbus controller start function: connects to the slaves
+static esp_err_t mbc_tcp_master_start(void)
+{
+    MB_MASTER_CHECK((mbm_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface uninitialized.");
+    const mb_communication_info_t* comm_info = &mbm_interface_ptr->opts.mbm_comm;
+    MB_MASTER_CHECK((comm_info->ip_addr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "mb slave address table is not set.");
+    esp_err_t error = mb_tcp_master_port_start(comm_info->ip_addr, comm_info->tcp_port);
+    MB_MASTER_CHECK((error == ESP_OK), error,
+                    "mb tcp port start failure, returns (0x%x).", error);
+    return ESP_OK;
+}
+
+// Modbus controller destroy function
+static esp_err_t mbc_tcp_master_destroy(void)
+{
+    MB_MASTER_CHECK((mbm_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface uninitialized.");
+    // The port is not started if start was not called
+    (void)mb_tcp_master_port_stop();
+    free(mbm_interface_ptr); // free the memory allocated for options
+    mbm_interface_ptr = NULL;
+    return ESP_OK;
+}
+
+// Set Modbus parameter description table
+static esp_err_t mbc_tcp_master_set_descriptor(const mb_parameter_descriptor_t* descriptor, const uint16_t num_elements)
+{
+    MB_MASTER_CHECK((descriptor != NULL),
+                        ESP_ERR_INVALID_ARG, "mb incorrect descriptor.");
+    MB_MASTER_CHECK((num_elements >= 1),
+                        ESP_ERR_INVALID_ARG, "mb table size is incorrect.");
+    mb_master_options_t* mbm_opts = &mbm_interface_ptr->opts;
+    const mb_parameter_descriptor_t *reg_ptr = descriptor;
+    // Go through all items in the table to check all Modbus registers
+    for (uint16_t counter = 0; counter < (num_elements); counter++, reg_ptr++)
+    {
+        // Below is the code to check consistency of the table format and required fields.
+        MB_MASTER_CHECK((reg_ptr->cid == counter),
+                            ESP_ERR_INVALID_ARG, "mb descriptor cid field is incorrect.");
+        MB_MASTER_CHECK((reg_ptr->param_key != NULL),
+                            ESP_ERR_INVALID_ARG, "mb descriptor param key is incorrect.");
+        MB_MASTER_CHECK((reg_ptr->mb_size > 0),
+                            ESP_ERR_INVALID_ARG, "mb descriptor param size is incorrect.");
+    }
+    mbm_opts->mbm_param_descriptor_table = descriptor;
+    mbm_opts->mbm_param_descriptor_size = num_elements;
+    return ESP_OK;
+}
+
+// Build the request PDU of the transaction
+static esp_err_t mbc_tcp_master_build_request(const mb_param_request_t* request, const void* data_ptr,
+                                                mb_tcp_transaction_t* transaction)
+{
+    uint8_t* pdu = &transaction->adu[MB_TCP_FUNC];
+    uint16_t size = request->reg_size;
+    uint16_t value = 0;
+    uint16_t max_size = 1;
+
+    // Check the quantity first, the data is copied to the PDU
+    switch (request->command)
+    {
+        case MB_FUNC_READ_COILS:
+        case MB_FUNC_READ_DISCRETE_INPUTS:
+            max_size = MB_TCP_READ_BITS_MAX;
+            break;
+        case MB_FUNC_READ_HOLDING_REGISTER:
+        case MB_FUNC_READ_INPUT_REGISTER:
+            max_size = MB_TCP_READ_REGS_MAX;
+            break;
+        case MB_FUNC_WRITE_SINGLE_COIL:
+        case MB_FUNC_WRITE_REGISTER:
+            size = 1;
+            break;
+        case MB_FUNC_WRITE_MULTIPLE_COILS:
+            max_size = MB_TCP_WRITE_BITS_MAX;
+            break;
+        case MB_FUNC_WRITE_MULTIPLE_REGISTERS:
+            max_size = MB_TCP_WRITE_REGS_MAX;
+            break;
+        case MB_FUNC_READWRITE_MULTIPLE_REGISTERS:
+            max_size = MB_TCP_READWRITE_REGS_MAX;
+            break;
+        default:
+            ESP_LOGE(MB_MASTER_TAG, "%s: Incorrect function in request (%u) ",
+                                                    __FUNCTION__, request->command);
+            return ESP_ERR_NOT_SUPPORTED;
+    }
+    MB_MASTER_CHECK(((size >= 1) && (size <= max_size)),
+                    ESP_ERR_INVALID_ARG, "mb incorrect request size (%u).", size);
+
+    pdu[0] = request->command;
+    mbc_tcp_master_set_u16(&pdu[1], request->reg_start);
+    mbc_tcp_master_set_u16(&pdu[3], size);
+    transaction->pdu_length = 5;
+    switch (request->command)
+    {
+        case MB_FUNC_WRITE_SINGLE_COIL:
+        case MB_FUNC_WRITE_REGISTER:
+            // The value is sent instead of the quantity
+            memcpy(&value, data_ptr, sizeof(value));
+            MB_MASTER_CHECK(((request->command == MB_FUNC_WRITE_REGISTER)
+                                || (value == MB_TCP_COIL_ON) || (value == 0)),
+                            ESP_ERR_INVALID_ARG, "mb incorrect coil value (0x%x).", value);
+            mbc_tcp_master_set_u16(&pdu[3], value);
+            break;
+        case MB_FUNC_WRITE_MULTIPLE_COILS:
+            pdu[5] = (uint8_t)((size + 7) / 8);
+            memcpy(&pdu[6], data_ptr, pdu[5]);
+            transaction->pdu_length = 6 + pdu[5];
+            break;
+        case MB_FUNC_WRITE_MULTIPLE_REGISTERS:
+            pdu[5] = (uint8_t)(2 * size);
+            for (uint16_t i = 0; i < size; i++) {
+                memcpy(&value, (const uint16_t*)data_ptr + i, sizeof(value));
+                mbc_tcp_master_set_u16(&pdu[6 + 2 * i], value);
+            }
+            transaction->pdu_length = 6 + pdu[5];
+            break;
+        case MB_FUNC_READWRITE_MULTIPLE_REGISTERS:
+            // Writes the registers then reads them back, as the serial master does
+            mbc_tcp_master_set_u16(&pdu[5], request->reg_start);
+            mbc_tcp_master_set_u16(&pdu[7], size);
+            pdu[9] = (uint8_t)(2 * size);
+            for (uint16_t i = 0; i < size; i++) {
+                memcpy(&value, (const uint16_t*)data_ptr + i, sizeof(value));
+                mbc_tcp_master_set_u16(&pdu[10 + 2 * i], value);
+            }
+            transaction->pdu_length = 10 + pdu[9];
+            break;
+        default:
+            break;
+    }
+    transaction->slave_addr = request->slave_addr;
+    return ESP_OK;
+}
+
+// Check the response PDU of the transaction and copy the read data
+static esp_err_t mbc_tcp_master_parse_response(const mb_param_request_t* request, void* data_ptr,
+                                                const mb_tcp_transaction_t* transaction)
+{
+    const uint8_t* pdu = &transaction->adu[MB_TCP_FUNC];
+    uint16_t length = transaction->pdu_length;
+    uint16_t size = request->reg_size;
+    uint8_t* data = (uint8_t*)data_ptr;
+    uint16_t value = 0;
+
+    if (pdu[0] == (request->command | MB_FUNC_ERROR)) {
+        ESP_LOGD(MB_MASTER_TAG, "%s: slave(%u) exception (%u) to function (%u).", __FUNCTION__,
+                    request->slave_addr, (length > 1) ? pdu[1] : 0, request->command);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (pdu[0] != request->command) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    switch (request->command)
+    {
+        case MB_FUNC_READ_COILS:
+        case MB_FUNC_READ_DISCRETE_INPUTS:
+            if ((length != 2 + (size + 7) / 8) || (pdu[1] != (size + 7) / 8)) {
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            // The bits are set from bit (reg_start % 8) of the buffer
+            for (uint16_t k = 0; k < size; k++) {
+                uint16_t bit = (request->reg_start % 8) + k;
+                if (pdu[2 + k / 8] & (1 << (k % 8))) {
+                    data[bit / 8] |= (uint8_t)(1 << (bit % 8));
+                } else {
+                    data[bit / 8] &= (uint8_t)~(1 << (bit % 8));
+                }
+            }
+            break;
+        case MB_FUNC_READ_HOLDING_REGISTER:
+        case MB_FUNC_READ_INPUT_REGISTER:
+        case MB_FUNC_READWRITE_MULTIPLE_REGISTERS:
+            if ((length != 2 + 2 * size) || (pdu[1] != 2 * size)) {
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            for (uint16_t i = 0; i < size; i++) {
+                const uint8_t* reg = &pdu[2 + 2 * i];
+                _XFER_2_WR(data, reg);
+                data += 2;
+            }
+            break;
+        case MB_FUNC_WRITE_SINGLE_COIL:
+        case MB_FUNC_WRITE_REGISTER:
+            memcpy(&value, data_ptr, sizeof(value));
+            if ((length != 5) || (mbc_tcp_master_get_u16(&pdu[1]) != request->reg_start)
+                    || (mbc_tcp_master_get_u16(&pdu[3]) != value)) {
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            break;
+        case MB_FUNC_WRITE_MULTIPLE_COILS:
+        case MB_FUNC_WRITE_MULTIPLE_REGISTERS:
+            if ((length != 5) || (mbc_tcp_master_get_u16(&pdu[1]) != request->reg_start)
+                    || (mbc_tcp_master_get_u16(&pdu[3]) != size)) {
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            break;
+        default:
+            return ESP_ERR_INVALID_RESPONSE;
+    }
+    return ESP_OK;
+}
+
+// Send several custom Modbus requests at once and wait for all their responses
+static esp_err_t mbc_tcp_master_send_requests(mb_param_request_t* requests, void* const* data,
+                                                esp_err_t* errors, uint16_t count)
+{
+    MB_MASTER_CHECK((mbm_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface uninitialized.");
+    MB_MASTER_CHECK(((requests != NULL) && (data != NULL) && (errors != NULL)),
+                    ESP_ERR_INVALID_ARG, "mb incorrect request parameters.");
+    if (count == 0) {
+        return ESP_OK;
+    }
+    mb_tcp_transaction_t* transactions = calloc(count, sizeof(mb_tcp_transaction_t));
+    if (transactions == NULL) {
+        for (uint16_t i = 0; i < count; i++) {
+            errors[i] = ESP_ERR_NO_MEM;
+        }
+        return ESP_ERR_NO_MEM;
+    }
+    for (uint16_t i = 0; i < count; i++) {
+        // A transaction not built has no PDU, the port does not send it
+        errors[i] = (data[i] != NULL) ? mbc_tcp_master_build_request(&requests[i], data[i], &transactions[i])
+                                        : ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t error = mb_tcp_master_port_transact(transactions, count);
+    esp_err_t result = ESP_OK;
+    for (uint16_t i = 0; i < count; i++) {
+        if (errors[i] == ESP_OK) {
+            errors[i] = (error != ESP_OK) ? error : transactions[i].error;
+        }
+        if (errors[i] == ESP_OK) {
+            errors[i] = mbc_tcp_master_parse_response(&requests[i], data[i], &transactions[i]);
+        }
+        if ((errors[i] != ESP_OK) && (result == ESP_OK)) {
+            result = errors[i];
+        }
+    }
+    free(transactions);
+    return result;
+}
+
+// Send custom Modbus request defined as mb_param_request_t structure
+static esp_err_t mbc_tcp_master_send_request(mb_param_request_t* request, void* data_ptr)
+{
+    MB_MASTER_CHECK((request != NULL),
+                    ESP_ERR_INVALID_ARG, "mb request structure.");
+    MB_MASTER_CHECK((data_ptr != NULL),
+                    ESP_ERR_INVALID_ARG, "mb incorrect data pointer.");
+    esp_err_t error = ESP_FAIL;
+    esp_err_t result = mbc_tcp_master_send_requests(request, &data_ptr, &error, 1);
+    return (result == ESP_OK) ? error : result;
+}
+
+static esp_err_t mbc_tcp_master_get_cid_info(uint16_t cid, const mb_parameter_descriptor_t** param_buffer)
+{
+    MB_MASTER_CHECK((mbm_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface uninitialized.");
+    mb_master_options_t* mbm_opts = &mbm_interface_ptr->opts;
+
+    MB_MASTER_CHECK((param_buffer != NULL),
+                        ESP_ERR_INVALID_ARG, "mb incorrect data buffer pointer.");
+    MB_MASTER_CHECK((mbm_opts->mbm_param_descriptor_table != NULL),
+                        ESP_ERR_INVALID_ARG, "mb incorrect descriptor table or not set.");
+    MB_MASTER_CHECK((cid < mbm_opts->mbm_param_descriptor_size),
+                        ESP_ERR_NOT_FOUND, "mb incorrect cid of characteristic.");
+
+    // It is assumed that characteristics cid increased in the table
+    const mb_parameter_descriptor_t* reg_info = &mbm_opts->mbm_param_descriptor_table[cid];
+
+    MB_MASTER_CHECK((reg_info->param_key != NULL),
+                        ESP_ERR_INVALID_ARG, "mb incorrect characteristic key.");
+    *param_buffer = reg_info;
+    return ESP_OK;
+}
+
+// Helper function to get modbus command for each type of Modbus register area
+static uint8_t mbc_tcp_master_get_command(mb_param_type_t param_type, mb_param_mode_t mode)
+{
+    uint8_t command = 0;
+    switch(param_type)
+    {
+        case MB_PARAM_HOLDING:
+            command = (mode == MB_PARAM_WRITE) ?
+                        MB_FUNC_WRITE_MULTIPLE_REGISTERS :
+                        MB_FUNC_READ_HOLDING_REGISTER;
+            break;
+        case MB_PARAM_INPUT:
+            command = MB_FUNC_READ_INPUT_REGISTER;
+            break;
+        case MB_PARAM_COIL:
+            command = (mode == MB_PARAM_WRITE) ?
+                        MB_FUNC_WRITE_MULTIPLE_COILS :
+                        MB_FUNC_READ_COILS;
+            break;
+        case MB_PARAM_DISCRETE:
+            if (mode != MB_PARAM_WRITE) {
+                command = MB_FUNC_READ_DISCRETE_INPUTS;
+            } else {
+                ESP_LOGE(MB_MASTER_TAG, "%s: Incorrect mode (%u)",
+                            __FUNCTION__, (uint8_t)mode);
+            }
+            break;
+        default:
+            ESP_LOGE(MB_MASTER_TAG, "%s: Incorrect param type (%u)",
+                            __FUNCTION__, param_type);
+            break;
+    }
+    return command;
+}
+
+// Helper to search parameter by name in the parameter description table
+// and fills Modbus request fields accordingly
+static esp_err_t mbc_tcp_master_set_request(char* name, mb_param_mode_t mode,
+                                                mb_param_request_t* request,
+                                                mb_parameter_descriptor_t* reg_data)
+{
+    MB_MASTER_CHECK((mbm_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface uninitialized.");
+    mb_master_options_t* mbm_opts = &mbm_interface_ptr->opts;
+    esp_err_t error = ESP_ERR_NOT_FOUND;
+    MB_MASTER_CHECK((name != NULL),
+                        ESP_ERR_INVALID_ARG, "mb incorrect parameter name.");
+    MB_MASTER_CHECK((request != NULL),
+                        ESP_ERR_INVALID_ARG, "mb incorrect request parameter.");
+    MB_MASTER_CHECK((mode <= MB_PARAM_WRITE),
+                        ESP_ERR_INVALID_ARG, "mb incorrect mode.");
+    MB_MASTER_ASSERT(mbm_opts->mbm_param_descriptor_table != NULL);
+    const mb_parameter_descriptor_t* reg_ptr = mbm_opts->mbm_param_descriptor_table;
+    for (uint16_t counter = 0; counter < (mbm_opts->mbm_param_descriptor_size); counter++, reg_ptr++)
+    {
+        // Compare the name of parameter with parameter key from table
+        if (strcmp((const char*)name, (const char*)reg_ptr->param_key) == 0) {
+            // The correct line is found in the table and reg_ptr points to the found parameter description
+            request->slave_addr = reg_ptr->mb_slave_addr;
+            request->reg_start = reg_ptr->mb_reg_start;
+            request->reg_size = reg_ptr->mb_size;
+            request->command = mbc_tcp_master_get_command(reg_ptr->mb_param_type, mode);
+            MB_MASTER_CHECK((request->command > 0),
+                                ESP_ERR_INVALID_ARG,
+                                "mb incorrect command or parameter type.");
+            if (reg_data != NULL) {
+                *reg_data = *reg_ptr; // Set the cid registered parameter data
+            }
+            error = ESP_OK;
+            break;
+        }
+    }
+    return error;
+}
+
+// Get parameter data for corresponding characteristic
+static esp_err_t mbc_tcp_master_get_parameter(uint16_t cid, char* name,
+                                                    uint8_t* value_ptr, uint8_t *type)
+{
+    MB_MASTER_CHECK((name != NULL),
+                        ESP_ERR_INVALID_ARG, "mb incorrect descriptor.");
+    MB_MASTER_CHECK((type != NULL),
+                        ESP_ERR_INVALID_ARG, "type pointer is incorrect.");
+    esp_err_t error = ESP_ERR_INVALID_RESPONSE;
+    mb_param_request_t request ;
+    mb_parameter_descriptor_t reg_info = { 0 };
+
+    error = mbc_tcp_master_set_request(name, MB_PARAM_READ, &request, &reg_info);
+    if ((error == ESP_OK) && (cid == reg_info.cid)) {
+        // Send request to read characteristic data
+        error = mbc_tcp_master_send_request(&request, value_ptr);
+        if (error == ESP_OK) {
+            ESP_LOGD(MB_MASTER_TAG, "%s: Good response for get cid(%u) = %s",
+                                    __FUNCTION__, (int)reg_info.cid, (char*)esp_err_to_name(error));
+        } else {
+            ESP_LOGD(MB_MASTER_TAG, "%s: Bad response to get cid(%u) = %s",
+                                            __FUNCTION__, reg_info.cid, (char*)esp_err_to_name(error));
+        }
+        // Set the type of parameter found in the table
+        *type = reg_info.param_type;
+    } else {
+        ESP_LOGD(MB_MASTER_TAG, "%s: The cid(%u) not found in the data dictionary.",
+                                                    __FUNCTION__, reg_info.cid);
+    }
+    return error;
+}
+
+// Set parameter value for characteristic selected by name and cid
+static esp_err_t mbc_tcp_master_set_parameter(uint16_t cid, char* name,
+                                                    uint8_t* value_ptr, uint8_t *type)
+{
+    MB_MASTER_CHECK((name != NULL),
+                        ESP_ERR_INVALID_ARG, "mb incorrect descriptor.");
+    MB_MASTER_CHECK((value_ptr != NULL),
+                        ESP_ERR_INVALID_ARG, "value pointer is incorrect.");
+    MB_MASTER_CHECK((type != NULL),
+                        ESP_ERR_INVALID_ARG, "type pointer is incorrect.");
+    esp_err_t error = ESP_ERR_INVALID_RESPONSE;
+    mb_param_request_t request ;
+    mb_parameter_descriptor_t reg_info = { 0 };
+
+    error = mbc_tcp_master_set_request(name, MB_PARAM_WRITE, &request, &reg_info);
+    if ((error == ESP_OK) && (cid == reg_info.cid)) {
+        // Send request to write characteristic data
+        error = mbc_tcp_master_send_request(&request, value_ptr);
+        if (error == ESP_OK) {
+            ESP_LOGD(MB_MASTER_TAG, "%s: Good response for set cid(%u) = %s",
+                                    __FUNCTION__, (int)reg_info.cid, (char*)esp_err_to_name(error));
+        } else {
+            ESP_LOGD(MB_MASTER_TAG, "%s: Bad response to set cid(%u) = %s",
+                                    __FUNCTION__, reg_info.cid, (char*)esp_err_to_name(error));
+        }
+        // Set the type of parameter found in the table
+        *type = reg_info.param_type;
+    } else {
+        ESP_LOGE(MB_MASTER_TAG, "%s: The requested cid(%u) not found in the data dictionary.",
+                                    __FUNCTION__, reg_info.cid);
+    }
+    return error;
+}
+
+// Initialization of resources for Modbus TCP master controller
+esp_err_t mbc_tcp_master_create(mb_port_type_t port_type, void** handler)
+{
+    MB_MASTER_CHECK((port_type == MB_PORT_TCP_MASTER),
+                        ESP_ERR_INVALID_STATE, "mb incorrect port selected = %u.",
+                        (uint32_t)port_type);
+    // Allocate space for master interface structure
+    if (mbm_interface_ptr == NULL) {
+        mbm_interface_ptr = calloc(1, sizeof(mb_master_interface_t));
+    }
+    MB_MASTER_CHECK((mbm_interface_ptr != NULL),
+                        ESP_ERR_NO_MEM, "mb master interface allocation failure.");
+
+    // Initialize interface properties, the port task is created by start
+    mb_master_options_t* mbm_opts = &mbm_interface_ptr->opts;
+    mbm_opts->port_type = MB_PORT_TCP_MASTER;
+    mbm_opts->mbm_comm.tcp_mode = MB_MODE_TCP;
+    mbm_opts->mbm_comm.tcp_port = CONFIG_FMB_TCP_PORT_DEFAULT;
+    mbm_opts->mbm_comm.ip_addr = NULL;
+
+    // Initialize public interface methods of the interface
+    mbm_interface_ptr->init = mbc_tcp_master_create;
+    mbm_interface_ptr->destroy = mbc_tcp_master_destroy;
+    mbm_interface_ptr->setup = mbc_tcp_master_setup;
+    mbm_interface_ptr->start = mbc_tcp_master_start;
+    mbm_interface_ptr->get_cid_info = mbc_tcp_master_get_cid_info;
+    mbm_interface_ptr->get_parameter = mbc_tcp_master_get_parameter;
+    mbm_interface_ptr->send_request = mbc_tcp_master_send_request;
+    mbm_interface_ptr->set_descriptor = mbc_tcp_master_set_descriptor;
+    mbm_interface_ptr->set_parameter = mbc_tcp_master_set_parameter;
+    mbm_interface_ptr->send_requests = mbc_tcp_master_send_requests;
+
+    // The freemodbus stack is not used, the responses are decoded by the controller
+    mbm_interface_ptr->master_reg_cb_discrete = NULL;
+    mbm_interface_ptr->master_reg_cb_input = NULL;
+    mbm_interface_ptr->master_reg_cb_holding = NULL;
+    mbm_interface_ptr->master_reg_cb_coils = NULL;
+
+    *handler = mbm_interface_ptr;
+
+    return ESP_OK;
+}
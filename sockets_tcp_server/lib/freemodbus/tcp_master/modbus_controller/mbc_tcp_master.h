@@ -0,0 +1,36 @@
+/* Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  mbc_tcp_master.h Modbus controller TCP master implementation header file
+
+#ifndef _MODBUS_TCP_CONTROLLER_MASTER
+#define _MODBUS_TCP_CONTROLLER_MASTER
+
+#include <stdint.h>                 // for standard int types definition
+#include <stddef.h>                 // for NULL and std defines
+#include "esp_err.h"                // for esp_err_t
+#include "esp_modbus_common.h"      // for common defines
+
+/**
+ * @brief Initialize Modbus TCP master controller
+ *
+ * @param[out] handler handler(pointer) to master data structure
+ * @return
+ *     - ESP_OK   Success
+ *     - ESP_ERR_NO_MEM Parameter error
+ */
+esp_err_t mbc_tcp_master_create(mb_port_type_t port_type, void** handler);
+
+#endif // _MODBUS_TCP_CONTROLLER_MASTER
@@ -0,0 +1,556 @@
+/* Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// port_tcp_master.c
+// Modbus TCP master port: a task keeps a non-blocking connection to each slave and
+// processes the transactions of all the slaves in one select() loop. Several transactions
+// may be outstanding on a connection, their responses are matched by transaction identifier.
+
+#include <stdbool.h>                // for bool
+#include <stdlib.h>                 // for calloc
+#include <string.h>                 // for memcpy
+#include <stdio.h>                  // for snprintf
+#include <fcntl.h>                  // for fcntl
+#include <sys/param.h>              // for MIN
+#include "freertos/FreeRTOS.h"      // for task creation and semaphores
+#include "freertos/task.h"          // for task api access
+#include "freertos/semphr.h"        // for semaphores
+#include "esp_log.h"                // for log_write
+#include "esp_timer.h"              // for esp_timer_get_time
+#include "lwip/sockets.h"           // for sockets
+#include "lwip/netdb.h"             // for getaddrinfo
+#include "sdkconfig.h"              // for KConfig values
+#include "esp_modbus_common.h"      // for controller task options
+#include "port_tcp_master.h"
+
+static const char *TAG = "MB_TCP_MASTER_PORT";
+
+#define MB_TCP_RESPONSE_TIMEOUT_US  ((int64_t)CONFIG_FMB_MASTER_TIMEOUT_MS_RESPOND * 1000)
+#define MB_TCP_CONNECT_TIMEOUT_US   ((int64_t)CONFIG_FMB_TCP_MASTER_CONNECT_TIMEOUT_MS * 1000)
+#define MB_TCP_MAX_PENDING          (CONFIG_FMB_TCP_MASTER_MAX_PENDING)
+#define MB_TCP_POLL_PERIOD_US       (1000 * 1000)   // Longest select() wait without deadline
+
+#define MB_TCP_GET_U16(buf, off)    (((uint16_t)(buf)[(off)] << 8) | (buf)[(off) + 1])
+#define MB_TCP_SET_U16(buf, off, value) { \
+    (buf)[(off)] = (uint8_t)((value) >> 8); \
+    (buf)[(off) + 1] = (uint8_t)(value); \
+}
+
+typedef TAILQ_HEAD(mb_tcp_transaction_list, mb_tcp_transaction) mb_tcp_transaction_list_t;
+
+typedef enum {
+    MB_TCP_SLAVE_DISCONNECTED,
+    MB_TCP_SLAVE_CONNECTING,
+    MB_TCP_SLAVE_CONNECTED,
+} mb_tcp_slave_state_t;
+
+// Connection to a slave
+typedef struct {
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    int sock;
+    mb_tcp_slave_state_t state;
+    bool connect;                           // Connect even without transaction (at start)
+    int64_t connect_deadline;
+    uint16_t next_tid;
+    uint16_t pending_count;
+    mb_tcp_transaction_list_t queued;       // Transactions waiting to be sent
+    mb_tcp_transaction_list_t pending;      // Transactions sent or being sent in order, waiting for their response
+    uint16_t rx_length;
+    uint8_t rx[MB_TCP_ADU_SIZE_MAX];        // Response being received
+} mb_tcp_slave_t;
+
+// Task waiting for its transactions
+typedef struct mb_tcp_waiter {
+    SemaphoreHandle_t done;
+    uint16_t remaining;
+} mb_tcp_waiter_t;
+
+typedef struct {
+    SemaphoreHandle_t lock;                 // Protects the slaves and stop
+    SemaphoreHandle_t stopped;
+    TaskHandle_t task_handle;
+    int ctrl_sock;                          // UDP socket on loopback, wakes the task up
+    int wakeup_sock;                        // UDP socket sending to ctrl_sock
+    struct sockaddr_in ctrl_addr;
+    bool stop;
+    uint16_t slave_count;
+    mb_tcp_slave_t slaves[];
+} mb_tcp_port_t;
+
+static mb_tcp_port_t* s_port = NULL;
+
+static void mb_tcp_complete(mb_tcp_transaction_t* transaction, esp_err_t error)
+{
+    transaction->error = error;
+    if (--transaction->waiter->remaining == 0) {
+        xSemaphoreGive(transaction->waiter->done);
+    }
+}
+
+static void mb_tcp_fail_all(mb_tcp_transaction_list_t* list, esp_err_t error)
+{
+    mb_tcp_transaction_t* transaction;
+    while ((transaction = TAILQ_FIRST(list)) != NULL) {
+        TAILQ_REMOVE(list, transaction, entries);
+        mb_tcp_complete(transaction, error);
+    }
+}
+
+static uint16_t mb_tcp_adu_length(const mb_tcp_transaction_t* transaction)
+{
+    return MB_TCP_FUNC + transaction->pdu_length;
+}
+
+// Close the connection, the pending transactions fail, and the queued ones too if the connection can't be made
+static void mb_tcp_slave_close(mb_tcp_slave_t* slave, bool fail_queued, esp_err_t error)
+{
+    if (slave->sock >= 0) {
+        close(slave->sock);
+        slave->sock = -1;
+    }
+    slave->state = MB_TCP_SLAVE_DISCONNECTED;
+    slave->rx_length = 0;
+    slave->pending_count = 0;
+    mb_tcp_fail_all(&slave->pending, error);
+    if (fail_queued) {
+        mb_tcp_fail_all(&slave->queued, error);
+    }
+}
+
+static void mb_tcp_slave_connect(mb_tcp_slave_t* slave, int64_t now)
+{
+    slave->connect = false;
+    slave->sock = socket(slave->addr.ss_family, SOCK_STREAM, IPPROTO_TCP);
+    if (slave->sock < 0) {
+        ESP_LOGE(TAG, "socket creation failure, errno=%d.", errno);
+        mb_tcp_slave_close(slave, true, ESP_ERR_TIMEOUT);
+        return;
+    }
+    // The requests are small and pipelined, send them at once
+    int nodelay = 1;
+    setsockopt(slave->sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    fcntl(slave->sock, F_SETFL, fcntl(slave->sock, F_GETFL, 0) | O_NONBLOCK);
+    if (connect(slave->sock, (struct sockaddr*)&slave->addr, slave->addr_len) == 0) {
+        slave->state = MB_TCP_SLAVE_CONNECTED;
+    } else if (errno == EINPROGRESS) {
+        slave->state = MB_TCP_SLAVE_CONNECTING;
+        slave->connect_deadline = now + MB_TCP_CONNECT_TIMEOUT_US;
+    } else {
+        ESP_LOGW(TAG, "slave(%u) connection failure, errno=%d.", (unsigned)(slave - s_port->slaves) + 1, errno);
+        mb_tcp_slave_close(slave, true, ESP_ERR_TIMEOUT);
+    }
+}
+
+// Send the pending transactions not sent yet
+static void mb_tcp_slave_send(mb_tcp_slave_t* slave)
+{
+    mb_tcp_transaction_t* transaction;
+    TAILQ_FOREACH(transaction, &slave->pending, entries) {
+        uint16_t length = mb_tcp_adu_length(transaction);
+        while (transaction->sent < length) {
+            int ret = send(slave->sock, transaction->adu + transaction->sent, length - transaction->sent, 0);
+            if (ret < 0) {
+                if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+                    ESP_LOGW(TAG, "slave(%u) send failure, errno=%d.", (unsigned)(slave - s_port->slaves) + 1, errno);
+                    mb_tcp_slave_close(slave, false, ESP_ERR_TIMEOUT);
+                }
+                return;
+            }
+            transaction->sent += ret;
+        }
+    }
+}
+
+static bool mb_tcp_slave_has_unsent(const mb_tcp_slave_t* slave)
+{
+    const mb_tcp_transaction_t* last = TAILQ_LAST(&slave->pending, mb_tcp_transaction_list);
+    return (last != NULL) && (last->sent < mb_tcp_adu_length(last));
+}
+
+// Match a received response to its transaction
+static void mb_tcp_slave_process_response(mb_tcp_slave_t* slave)
+{
+    uint16_t tid = MB_TCP_GET_U16(slave->rx, MB_TCP_TID);
+    uint16_t pdu_length = MB_TCP_GET_U16(slave->rx, MB_TCP_LEN) - 1;
+    mb_tcp_transaction_t* transaction;
+    TAILQ_FOREACH(transaction, &slave->pending, entries) {
+        if ((MB_TCP_GET_U16(transaction->adu, MB_TCP_TID) == tid)
+                && (transaction->sent == mb_tcp_adu_length(transaction))) {
+            break;
+        }
+    }
+    if (transaction == NULL) {
+        // Response of a transaction that timed out
+        ESP_LOGD(TAG, "slave(%u) response with unknown transaction id (%u) dropped.",
+                    (unsigned)(slave - s_port->slaves) + 1, tid);
+        return;
+    }
+    TAILQ_REMOVE(&slave->pending, transaction, entries);
+    slave->pending_count--;
+    if (slave->rx[MB_TCP_UID] != transaction->adu[MB_TCP_UID]) {
+        mb_tcp_complete(transaction, ESP_ERR_INVALID_RESPONSE);
+        return;
+    }
+    memcpy(&transaction->adu[MB_TCP_FUNC], &slave->rx[MB_TCP_FUNC], pdu_length);
+    transaction->pdu_length = pdu_length;
+    mb_tcp_complete(transaction, ESP_OK);
+}
+
+// Receive the available responses
+static void mb_tcp_slave_receive(mb_tcp_slave_t* slave)
+{
+    for (;;) {
+        uint16_t length = MB_TCP_FUNC;
+        if (slave->rx_length >= MB_TCP_FUNC) {
+            length = MB_TCP_UID + MB_TCP_GET_U16(slave->rx, MB_TCP_LEN);
+        }
+        int ret = recv(slave->sock, slave->rx + slave->rx_length, length - slave->rx_length, 0);
+        if (ret < 0) {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+                ESP_LOGW(TAG, "slave(%u) receive failure, errno=%d.", (unsigned)(slave - s_port->slaves) + 1, errno);
+                mb_tcp_slave_close(slave, false, ESP_ERR_TIMEOUT);
+            }
+            return;
+        }
+        if (ret == 0) {
+            ESP_LOGW(TAG, "slave(%u) closed the connection.", (unsigned)(slave - s_port->slaves) + 1);
+            mb_tcp_slave_close(slave, false, ESP_ERR_TIMEOUT);
+            return;
+        }
+        slave->rx_length += ret;
+        if (slave->rx_length == MB_TCP_FUNC) {
+            uint16_t pdu_length = MB_TCP_GET_U16(slave->rx, MB_TCP_LEN) - 1;
+            if ((MB_TCP_GET_U16(slave->rx, MB_TCP_PID) != MB_TCP_PROTOCOL_ID)
+                    || (pdu_length == 0) || (pdu_length > MB_TCP_PDU_SIZE_MAX)) {
+                // The next frames can't be found in the stream
+                ESP_LOGE(TAG, "slave(%u) sent an invalid MBAP header.", (unsigned)(slave - s_port->slaves) + 1);
+                mb_tcp_slave_close(slave, false, ESP_ERR_INVALID_RESPONSE);
+                return;
+            }
+        } else if (slave->rx_length == length) {
+            mb_tcp_slave_process_response(slave);
+            slave->rx_length = 0;
+        }
+    }
+}
+
+// Update the connection and transactions of a slave before waiting for its socket
+static void mb_tcp_slave_poll(mb_tcp_slave_t* slave, int64_t now, fd_set* readfds, fd_set* writefds,
+                                int* maxfd, int64_t* wakeup)
+{
+    if ((slave->state == MB_TCP_SLAVE_CONNECTING) && (now >= slave->connect_deadline)) {
+        ESP_LOGW(TAG, "slave(%u) connection timeout.", (unsigned)(slave - s_port->slaves) + 1);
+        mb_tcp_slave_close(slave, true, ESP_ERR_TIMEOUT);
+    }
+    if ((slave->state == MB_TCP_SLAVE_DISCONNECTED) && (slave->connect || !TAILQ_EMPTY(&slave->queued))) {
+        mb_tcp_slave_connect(slave, now);
+    }
+    if (slave->state == MB_TCP_SLAVE_CONNECTING) {
+        FD_SET(slave->sock, writefds);
+        *maxfd = MAX(*maxfd, slave->sock);
+        *wakeup = MIN(*wakeup, slave->connect_deadline);
+        return;
+    }
+    if (slave->state != MB_TCP_SLAVE_CONNECTED) {
+        return;
+    }
+
+    mb_tcp_transaction_t* transaction;
+    mb_tcp_transaction_t* next;
+    for (transaction = TAILQ_FIRST(&slave->pending); transaction != NULL; transaction = next) {
+        next = TAILQ_NEXT(transaction, entries);
+        if (now < transaction->deadline) {
+            continue;
+        }
+        if (transaction->sent != 0 && transaction->sent != mb_tcp_adu_length(transaction)) {
+            // The rest of the request can't be dropped from the stream
+            mb_tcp_slave_close(slave, false, ESP_ERR_TIMEOUT);
+            return;
+        }
+        TAILQ_REMOVE(&slave->pending, transaction, entries);
+        slave->pending_count--;
+        mb_tcp_complete(transaction, ESP_ERR_TIMEOUT);
+    }
+    while ((slave->pending_count < MB_TCP_MAX_PENDING) && ((transaction = TAILQ_FIRST(&slave->queued)) != NULL)) {
+        TAILQ_REMOVE(&slave->queued, transaction, entries);
+        MB_TCP_SET_U16(transaction->adu, MB_TCP_TID, slave->next_tid);
+        MB_TCP_SET_U16(transaction->adu, MB_TCP_PID, MB_TCP_PROTOCOL_ID);
+        MB_TCP_SET_U16(transaction->adu, MB_TCP_LEN, transaction->pdu_length + 1);
+        transaction->adu[MB_TCP_UID] = transaction->slave_addr;
+        slave->next_tid++;
+        transaction->sent = 0;
+        transaction->deadline = now + MB_TCP_RESPONSE_TIMEOUT_US;
+        TAILQ_INSERT_TAIL(&slave->pending, transaction, entries);
+        slave->pending_count++;
+    }
+    mb_tcp_slave_send(slave);
+    if (slave->state != MB_TCP_SLAVE_CONNECTED) {
+        return;
+    }
+    FD_SET(slave->sock, readfds);
+    if (mb_tcp_slave_has_unsent(slave)) {
+        FD_SET(slave->sock, writefds);
+    }
+    *maxfd = MAX(*maxfd, slave->sock);
+    TAILQ_FOREACH(transaction, &slave->pending, entries) {
+        *wakeup = MIN(*wakeup, transaction->deadline);
+    }
+}
+
+// Process the socket events of a slave
+static void mb_tcp_slave_process(mb_tcp_slave_t* slave, fd_set* readfds, fd_set* writefds)
+{
+    if (slave->sock < 0) {
+        return;
+    }
+    if (slave->state == MB_TCP_SLAVE_CONNECTING) {
+        if (FD_ISSET(slave->sock, writefds)) {
+            int error = 0;
+            socklen_t len = sizeof(error);
+            if ((getsockopt(slave->sock, SOL_SOCKET, SO_ERROR, &error, &len) < 0) || (error != 0)) {
+                ESP_LOGW(TAG, "slave(%u) connection failure, errno=%d.", (unsigned)(slave - s_port->slaves) + 1, error);
+                mb_tcp_slave_close(slave, true, ESP_ERR_TIMEOUT);
+            } else {
+                ESP_LOGI(TAG, "slave(%u) connected.", (unsigned)(slave - s_port->slaves) + 1);
+                slave->state = MB_TCP_SLAVE_CONNECTED;
+            }
+        }
+        return;
+    }
+    if (FD_ISSET(slave->sock, readfds)) {
+        mb_tcp_slave_receive(slave);
+    }
+    if ((slave->state == MB_TCP_SLAVE_CONNECTED) && FD_ISSET(slave->sock, writefds)) {
+        mb_tcp_slave_send(slave);
+    }
+}
+
+static void mb_tcp_master_port_task(void* arg)
+{
+    mb_tcp_port_t* port = (mb_tcp_port_t*)arg;
+    for (;;) {
+        fd_set readfds;
+        fd_set writefds;
+        FD_ZERO(&readfds);
+        FD_ZERO(&writefds);
+        FD_SET(port->ctrl_sock, &readfds);
+        int maxfd = port->ctrl_sock;
+
+        xSemaphoreTake(port->lock, portMAX_DELAY);
+        if (port->stop) {
+            break;
+        }
+        int64_t now = esp_timer_get_time();
+        int64_t wakeup = now + MB_TCP_POLL_PERIOD_US;
+        for (uint16_t i = 0; i < port->slave_count; i++) {
+            mb_tcp_slave_poll(&port->slaves[i], now, &readfds, &writefds, &maxfd, &wakeup);
+        }
+        xSemaphoreGive(port->lock);
+
+        int64_t timeout = MAX(wakeup - now, 0);
+        struct timeval tv = {
+            .tv_sec = timeout / 1000000,
+            .tv_usec = timeout % 1000000,
+        };
+        if (select(maxfd + 1, &readfds, &writefds, NULL, &tv) < 0) {
+            ESP_LOGE(TAG, "select failure, errno=%d.", errno);
+            vTaskDelay(1);
+            continue;
+        }
+
+        xSemaphoreTake(port->lock, portMAX_DELAY);
+        if (FD_ISSET(port->ctrl_sock, &readfds)) {
+            uint8_t buf[16];
+            while (recv(port->ctrl_sock, buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+            }
+        }
+        for (uint16_t i = 0; i < port->slave_count; i++) {
+            mb_tcp_slave_process(&port->slaves[i], &readfds, &writefds);
+        }
+        xSemaphoreGive(port->lock);
+    }
+
+    for (uint16_t i = 0; i < port->slave_count; i++) {
+        mb_tcp_slave_close(&port->slaves[i], true, ESP_ERR_INVALID_STATE);
+    }
+    xSemaphoreGive(port->lock);
+    xSemaphoreGive(port->stopped);
+    vTaskDelete(NULL);
+}
+
+static void mb_tcp_wakeup(mb_tcp_port_t* port)
+{
+    uint8_t msg = 0;
+    if (sendto(port->wakeup_sock, &msg, sizeof(msg), 0, (struct sockaddr*)&port->ctrl_addr, sizeof(port->ctrl_addr)) < 0) {
+        ESP_LOGW(TAG, "wakeup failure, errno=%d.", errno);
+    }
+}
+
+static esp_err_t mb_tcp_resolve(mb_tcp_slave_t* slave, const char* addr, uint16_t default_port)
+{
+    char host[64];
+    char port_str[8];
+    const char* port_sep = strrchr(addr, ':');
+    if ((port_sep != NULL) && (strchr(addr, ':') == port_sep)) {
+        // "host:port", several ':' is an IPv6 address without port
+        snprintf(host, sizeof(host), "%.*s", (int)(port_sep - addr), addr);
+        snprintf(port_str, sizeof(port_str), "%s", port_sep + 1);
+    } else {
+        snprintf(host, sizeof(host), "%s", addr);
+        snprintf(port_str, sizeof(port_str), "%u", default_port);
+    }
+    const struct addrinfo hints = {
+        .ai_family = AF_UNSPEC,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo* res = NULL;
+    if ((getaddrinfo(host, port_str, &hints, &res) != 0) || (res == NULL)) {
+        ESP_LOGE(TAG, "slave address (%s) can't be resolved.", addr);
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(&slave->addr, res->ai_addr, res->ai_addrlen);
+    slave->addr_len = res->ai_addrlen;
+    freeaddrinfo(res);
+    return ESP_OK;
+}
+
+static void mb_tcp_port_free(mb_tcp_port_t* port)
+{
+    if (port->ctrl_sock >= 0) {
+        close(port->ctrl_sock);
+    }
+    if (port->wakeup_sock >= 0) {
+        close(port->wakeup_sock);
+    }
+    if (port->lock) {
+        vSemaphoreDelete(port->lock);
+    }
+    if (port->stopped) {
+        vSemaphoreDelete(port->stopped);
+    }
+    free(port);
+}
+
+esp_err_t mb_tcp_master_port_start(const char* const* addr_table, uint16_t default_port)
+{
+    if (s_port != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if ((addr_table == NULL) || (addr_table[0] == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint16_t slave_count = 0;
+    while (addr_table[slave_count] != NULL) {
+        slave_count++;
+    }
+    mb_tcp_port_t* port = calloc(1, sizeof(mb_tcp_port_t) + slave_count * sizeof(mb_tcp_slave_t));
+    if (port == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    port->ctrl_sock = -1;
+    port->wakeup_sock = -1;
+    port->slave_count = slave_count;
+    esp_err_t err = ESP_OK;
+    for (uint16_t i = 0; i < slave_count; i++) {
+        mb_tcp_slave_t* slave = &port->slaves[i];
+        slave->sock = -1;
+        slave->connect = true;
+        TAILQ_INIT(&slave->queued);
+        TAILQ_INIT(&slave->pending);
+        err = mb_tcp_resolve(slave, addr_table[i], default_port);
+        if (err != ESP_OK) {
+            mb_tcp_port_free(port);
+            return err;
+        }
+    }
+
+    port->lock = xSemaphoreCreateMutex();
+    port->stopped = xSemaphoreCreateBinary();
+    port->ctrl_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    port->wakeup_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    socklen_t addr_len = sizeof(port->ctrl_addr);
+    port->ctrl_addr.sin_family = AF_INET;
+    port->ctrl_addr.sin_port = 0;
+    port->ctrl_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((port->lock == NULL) || (port->stopped == NULL) || (port->ctrl_sock < 0) || (port->wakeup_sock < 0)
+            || (bind(port->ctrl_sock, (struct sockaddr*)&port->ctrl_addr, sizeof(port->ctrl_addr)) < 0)
+            || (getsockname(port->ctrl_sock, (struct sockaddr*)&port->ctrl_addr, &addr_len) < 0)) {
+        ESP_LOGE(TAG, "port resources creation failure, errno=%d.", errno);
+        mb_tcp_port_free(port);
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_port = port;
+    if (xTaskCreate(mb_tcp_master_port_task, "modbus_tcp_matask", MB_CONTROLLER_STACK_SIZE,
+                    port, MB_CONTROLLER_PRIORITY, &port->task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "port task creation failure.");
+        s_port = NULL;
+        mb_tcp_port_free(port);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t mb_tcp_master_port_stop(void)
+{
+    mb_tcp_port_t* port = s_port;
+    if (port == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(port->lock, portMAX_DELAY);
+    port->stop = true;
+    xSemaphoreGive(port->lock);
+    mb_tcp_wakeup(port);
+    xSemaphoreTake(port->stopped, portMAX_DELAY);
+    s_port = NULL;
+    mb_tcp_port_free(port);
+    return ESP_OK;
+}
+
+esp_err_t mb_tcp_master_port_transact(mb_tcp_transaction_t* transactions, uint16_t count)
+{
+    mb_tcp_port_t* port = s_port;
+    if (port == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    mb_tcp_waiter_t waiter = {
+        .done = xSemaphoreCreateBinary(),
+        .remaining = 0,
+    };
+    if (waiter.done == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    xSemaphoreTake(port->lock, portMAX_DELAY);
+    for (uint16_t i = 0; i < count; i++) {
+        mb_tcp_transaction_t* transaction = &transactions[i];
+        if ((transaction->slave_addr == 0) || (transaction->slave_addr > port->slave_count)
+                || (transaction->pdu_length == 0) || (transaction->pdu_length > MB_TCP_PDU_SIZE_MAX)) {
+            transaction->error = ESP_ERR_INVALID_ARG;
+            continue;
+        }
+        transaction->waiter = &waiter;
+        waiter.remaining++;
+        TAILQ_INSERT_TAIL(&port->slaves[transaction->slave_addr - 1].queued, transaction, entries);
+    }
+    bool wait = (waiter.remaining > 0);
+    xSemaphoreGive(port->lock);
+    if (wait) {
+        mb_tcp_wakeup(port);
+        xSemaphoreTake(waiter.done, portMAX_DELAY);
+    }
+    vSemaphoreDelete(waiter.done);
+    return ESP_OK;
+}
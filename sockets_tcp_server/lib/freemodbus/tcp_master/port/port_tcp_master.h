@@ -0,0 +1,106 @@
+/* Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  port_tcp_master.h Modbus TCP master port: connections to the slaves and MBAP transactions
+
+#ifndef _PORT_TCP_MASTER_H
+#define _PORT_TCP_MASTER_H
+
+#include <stdint.h>                 // for standard int types definition
+#include <sys/queue.h>              // for TAILQ
+#include "esp_err.h"                // for esp_err_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----------------------- MBAP Header --------------------------------------*/
+// Same layout as in modbus/tcp/mbtcp.c, the PDU follows the unit identifier
+#define MB_TCP_TID          0
+#define MB_TCP_PID          2
+#define MB_TCP_LEN          4
+#define MB_TCP_UID          6
+#define MB_TCP_FUNC         7
+
+#define MB_TCP_PROTOCOL_ID  0       // 0 = Modbus Protocol
+#define MB_TCP_PDU_SIZE_MAX 253     // Function code and data
+#define MB_TCP_ADU_SIZE_MAX (MB_TCP_FUNC + MB_TCP_PDU_SIZE_MAX)
+
+struct mb_tcp_waiter;
+
+/**
+ * @brief Modbus TCP transaction: a request PDU sent to a slave and its response PDU
+ */
+typedef struct mb_tcp_transaction {
+    uint8_t slave_addr;                     /*!< Slave address, the index + 1 in the address table, sent as unit identifier */
+    uint16_t pdu_length;                    /*!< Length of the request PDU, then of the response PDU */
+    esp_err_t error;                        /*!< Result of the transaction */
+    uint8_t adu[MB_TCP_ADU_SIZE_MAX];       /*!< The request PDU at MB_TCP_FUNC, replaced by the response PDU */
+    // Used by the port
+    TAILQ_ENTRY(mb_tcp_transaction) entries;
+    uint16_t sent;                          /*!< Bytes of the request ADU sent */
+    int64_t deadline;                       /*!< Time (us) the response is expected by */
+    struct mb_tcp_waiter* waiter;           /*!< Task waiting for the transaction */
+} mb_tcp_transaction_t;
+
+/**
+ * @brief Connect to the slaves and start the task processing the transactions
+ *
+ * @param addr_table NULL terminated table of slave addresses, "host" or "host:port"
+ * @param default_port port of the slaves without port in the table
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Incorrect or unresolved address
+ *     - ESP_ERR_INVALID_STATE Already started
+ *     - ESP_ERR_NO_MEM Out of memory, or the sockets or task can't be created
+ */
+esp_err_t mb_tcp_master_port_start(const char* const* addr_table, uint16_t default_port);
+
+/**
+ * @brief Stop the task and close the connections, the pending transactions fail with ESP_ERR_INVALID_STATE
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_STATE Not started
+ */
+esp_err_t mb_tcp_master_port_stop(void);
+
+/**
+ * @brief Send requests and wait for their responses
+ *
+ * The requests to different slaves are sent at once, up to CONFIG_FMB_TCP_MASTER_MAX_PENDING to the same slave,
+ * and may be sent at the same time as the requests of other tasks.
+ *
+ * @param transactions transactions with their slave_addr and request PDU set
+ * @param count number of transactions
+ *
+ * @return
+ *     - ESP_OK The transactions are done, see their error field:
+ *         - ESP_OK: the response PDU is in adu
+ *         - ESP_ERR_TIMEOUT: no connection or response from the slave in time
+ *         - ESP_ERR_INVALID_RESPONSE: invalid response
+ *         - ESP_ERR_INVALID_ARG: the slave address is not in the table
+ *         - ESP_ERR_INVALID_STATE: the port was stopped
+ *     - ESP_ERR_INVALID_STATE Not started
+ *     - ESP_ERR_NO_MEM Out of memory
+ */
+esp_err_t mb_tcp_master_port_transact(mb_tcp_transaction_t* transactions, uint16_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _PORT_TCP_MASTER_H
@@ -0,0 +1,13 @@
+#pragma once
+// Types of the Modbus stack port
+
+#define PR_BEGIN_EXTERN_C           extern "C" {
+#define PR_END_EXTERN_C             }
+
+typedef char    BOOL;
+typedef unsigned char UCHAR;
+typedef char    CHAR;
+typedef unsigned short USHORT;
+typedef short   SHORT;
+typedef unsigned long ULONG;
+typedef long    LONG;
@@ -0,0 +1 @@
+#define CONFIG_FMB_MASTER_TIMEOUT_MS_RESPOND 150
@@ -0,0 +1,144 @@
+#include <set>
+#include <tuple>
+#include "sdkconfig.h"
+#include "port.h"
+#include "mbproto.h"
+#include "slave_sim.h"
+
+// The frames are sent as 11 bit characters (start bit, 8 data bits, parity or second stop bit, stop bit)
+static const double BITS_PER_CHAR = 11;
+// Slave address, function code, address, quantity, CRC
+static const unsigned REQUEST_SIZE = 8;
+// Slave address, function code, byte count, CRC
+static const unsigned RESPONSE_OVERHEAD = 5;
+static const double SLAVE_DELAY = 0.002;
+static const double RESPONSE_TIMEOUT = CONFIG_FMB_MASTER_TIMEOUT_MS_RESPOND / 1000.0;
+
+static double s_char_time;
+static double s_bus_time;
+static uint32_t s_request_count;
+static std::set<std::tuple<uint8_t, int, uint16_t>> s_registers;
+
+void slave_sim_init(uint32_t baudrate)
+{
+    s_char_time = BITS_PER_CHAR / baudrate;
+    s_bus_time = 0;
+    s_request_count = 0;
+    s_registers.clear();
+}
+
+void slave_sim_add_range(uint8_t slave_addr, mb_param_type_t type, uint16_t reg_start, uint16_t reg_count)
+{
+    for (uint32_t reg = reg_start; reg < (uint32_t)reg_start + reg_count; reg++) {
+        s_registers.insert(std::make_tuple(slave_addr, (int)type, (uint16_t)reg));
+    }
+}
+
+uint16_t slave_sim_get_value(uint8_t slave_addr, mb_param_type_t type, uint16_t reg)
+{
+    uint32_t value = (reg * 2654435761u) ^ (slave_addr * 40503u) ^ ((uint32_t)type << 13);
+    value ^= value >> 16;
+    return (type == MB_PARAM_COIL || type == MB_PARAM_DISCRETE) ? (value & 1) : (uint16_t)value;
+}
+
+// The frame and the 3.5 character silence ending it
+static void bus_transfer(unsigned size)
+{
+    s_bus_time += (size + 3.5) * s_char_time;
+}
+
+esp_err_t slave_sim_send_request(mb_param_request_t* request, void* data)
+{
+    mb_param_type_t type;
+    uint16_t count_max;
+    switch (request->command) {
+    case MB_FUNC_READ_HOLDING_REGISTER:
+        type = MB_PARAM_HOLDING;
+        count_max = 125;
+        break;
+    case MB_FUNC_READ_INPUT_REGISTER:
+        type = MB_PARAM_INPUT;
+        count_max = 125;
+        break;
+    case MB_FUNC_READ_COILS:
+        type = MB_PARAM_COIL;
+        count_max = 2000;
+        break;
+    case MB_FUNC_READ_DISCRETE_INPUTS:
+        type = MB_PARAM_DISCRETE;
+        count_max = 2000;
+        break;
+    default:
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    s_request_count++;
+    bus_transfer(REQUEST_SIZE);
+
+    bool slave_found = false;
+    for (const auto &reg : s_registers) {
+        if (std::get<0>(reg) == request->slave_addr) {
+            slave_found = true;
+            break;
+        }
+    }
+    if (!slave_found) {
+        s_bus_time += RESPONSE_TIMEOUT;
+        return ESP_ERR_TIMEOUT;
+    }
+    s_bus_time += SLAVE_DELAY;
+
+    // Exception response: illegal data value or illegal data address
+    bool exception = request->reg_size == 0 || request->reg_size > count_max;
+    for (uint32_t i = 0; !exception && i < request->reg_size; i++) {
+        exception = !s_registers.count(std::make_tuple(request->slave_addr, (int)type, (uint16_t)(request->reg_start + i)));
+    }
+    if (exception) {
+        bus_transfer(RESPONSE_OVERHEAD);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    uint8_t *buffer = (uint8_t *)data;
+    if (type == MB_PARAM_HOLDING || type == MB_PARAM_INPUT) {
+        bus_transfer(RESPONSE_OVERHEAD + request->reg_size * 2);
+        for (uint16_t i = 0; i < request->reg_size; i++) {
+            // As _XFER_2_WR() in the register callbacks
+            uint16_t value = slave_sim_get_value(request->slave_addr, type, request->reg_start + i);
+            buffer[i * 2] = value & 0xff;
+            buffer[i * 2 + 1] = value >> 8;
+        }
+    } else {
+        bus_transfer(RESPONSE_OVERHEAD + (request->reg_size + 7) / 8);
+        // As xMBUtilSetBits() in the coils and discrete inputs callbacks, from bit (reg_start % 8)
+        unsigned bit = request->reg_start % 8;
+        for (uint16_t i = 0; i < request->reg_size; i++, bit++) {
+            if (slave_sim_get_value(request->slave_addr, type, request->reg_start + i)) {
+                buffer[bit / 8] |= 1 << (bit % 8);
+            } else {
+                buffer[bit / 8] &= ~(1 << (bit % 8));
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t slave_sim_send_requests(mb_param_request_t* requests, void* const* data, esp_err_t* errors, uint16_t count)
+{
+    esp_err_t result = ESP_OK;
+    for (uint16_t i = 0; i < count; i++) {
+        errors[i] = slave_sim_send_request(&requests[i], data[i]);
+        if (errors[i] != ESP_OK && result == ESP_OK) {
+            result = errors[i];
+        }
+    }
+    return result;
+}
+
+uint32_t slave_sim_get_request_count()
+{
+    return s_request_count;
+}
+
+double slave_sim_get_bus_time()
+{
+    return s_bus_time;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_modbus_master.h"
+
+/*
+ * Simulated Modbus RTU segment. The slaves answer the requests sent through slave_sim_send_request(),
+ * which fills the data buffer as the send_request method of the serial master does, and the time
+ * the requests and responses take on the bus is accumulated.
+ */
+
+/* Remove all the slaves and reset the counters */
+void slave_sim_init(uint32_t baudrate);
+
+/* Add registers (coils, discrete inputs) to a slave, their values are slave_sim_get_value() */
+void slave_sim_add_range(uint8_t slave_addr, mb_param_type_t type, uint16_t reg_start, uint16_t reg_count);
+
+/* Value of a register, 0 or 1 for coils and discrete inputs */
+uint16_t slave_sim_get_value(uint8_t slave_addr, mb_param_type_t type, uint16_t reg);
+
+/* Send a read request, returns as mbc_master_send_request() */
+esp_err_t slave_sim_send_request(mb_param_request_t* request, void* data);
+
+/* Send several read requests, as the send_requests method of a master interface */
+esp_err_t slave_sim_send_requests(mb_param_request_t* requests, void* const* data, esp_err_t* errors, uint16_t count);
+
+/* Number of requests sent since slave_sim_init() */
+uint32_t slave_sim_get_request_count();
+
+/* Time in seconds the requests and responses took on the bus since slave_sim_init() */
+double slave_sim_get_bus_time();
@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include <vector>
+#include "catch.hpp"
+#include "mbc_scan_plan.h"
+#include "slave_sim.h"
+
+using namespace std;
+
+static mb_parameter_descriptor_t make_descriptor(uint16_t cid, uint8_t slave_addr, mb_param_type_t type,
+                                                 uint16_t reg_start, uint16_t size)
+{
+    mb_parameter_descriptor_t descriptor = {};
+    descriptor.cid = cid;
+    descriptor.param_key = "param";
+    descriptor.param_units = "";
+    descriptor.mb_slave_addr = slave_addr;
+    descriptor.mb_param_type = type;
+    descriptor.mb_reg_start = reg_start;
+    descriptor.mb_size = size;
+    descriptor.param_type = PARAM_TYPE_U16;
+    descriptor.param_size = PARAM_SIZE_U16;
+    descriptor.access = PAR_PERMS_READ;
+    return descriptor;
+}
+
+static uint8_t read_command(mb_param_type_t type)
+{
+    static const uint8_t commands[] = { 3, 4, 1, 2 };
+    return commands[type];
+}
+
+// Value buffers of the characteristics, prefilled to check the bits around coils are kept
+struct values_t {
+    vector<vector<uint8_t>> buffers;
+    vector<uint8_t *> pointers;
+
+    values_t(size_t count) : buffers(count, vector<uint8_t>(256, 0xa5))
+    {
+        for (auto &buffer : buffers) {
+            pointers.push_back(buffer.data());
+        }
+    }
+};
+
+// Read the characteristics one request each, as mbc_master_get_parameter() does
+static esp_err_t read_one_by_one(const vector<mb_parameter_descriptor_t> &table, const vector<uint16_t> &cids,
+                                 values_t &values, vector<esp_err_t> &errors)
+{
+    esp_err_t result = ESP_OK;
+    for (size_t i = 0; i < cids.size(); i++) {
+        const mb_parameter_descriptor_t &reg_info = table[cids[i]];
+        mb_param_request_t request = {
+            reg_info.mb_slave_addr, read_command(reg_info.mb_param_type), reg_info.mb_reg_start, reg_info.mb_size
+        };
+        errors[i] = slave_sim_send_request(&request, values.pointers[i]);
+        if (errors[i] != ESP_OK && result == ESP_OK) {
+            result = errors[i];
+        }
+    }
+    return result;
+}
+
+// Scan a cid list with a plan and one by one, checking the values and errors are the same,
+// returns true if all the characteristics were read
+static bool check_scan(const vector<mb_parameter_descriptor_t> &table, const vector<uint16_t> &cids,
+                       mb_scan_plan_handle_t plan, uint32_t *plan_requests, uint32_t *single_requests,
+                       bool send_at_once = false)
+{
+    values_t expected(cids.size());
+    vector<esp_err_t> expected_errors(cids.size());
+    uint32_t start = slave_sim_get_request_count();
+    esp_err_t expected_result = read_one_by_one(table, cids, expected, expected_errors);
+    if (single_requests) {
+        *single_requests = slave_sim_get_request_count() - start;
+    }
+
+    values_t values(cids.size());
+    vector<esp_err_t> errors(cids.size(), ESP_FAIL);
+    start = slave_sim_get_request_count();
+    CHECK(mbc_scan_plan_execute(plan, slave_sim_send_request, send_at_once ? slave_sim_send_requests : NULL,
+                                values.pointers.data(), errors.data()) == expected_result);
+    if (plan_requests) {
+        *plan_requests = slave_sim_get_request_count() - start;
+    }
+    for (size_t i = 0; i < cids.size(); i++) {
+        CHECK(errors[i] == expected_errors[i]);
+        if (errors[i] == ESP_OK) {
+            CHECK(values.buffers[i] == expected.buffers[i]);
+        }
+    }
+    return expected_result == ESP_OK;
+}
+
+TEST_CASE("holding registers in a few blocks are read with one request per block", "[scan]")
+{
+    // 80 one-register characteristics in 4 blocks
+    const struct {
+        uint16_t start;
+        uint16_t count;
+    } blocks[] = { {0, 20}, {100, 30}, {200, 20}, {1000, 10} };
+    vector<mb_parameter_descriptor_t> table;
+    vector<uint16_t> cids;
+    for (const auto &block : blocks) {
+        for (uint16_t reg = block.start; reg < block.start + block.count; reg++) {
+            cids.push_back(table.size());
+            table.push_back(make_descriptor(table.size(), 1, MB_PARAM_HOLDING, reg, 1));
+        }
+    }
+    // In any order
+    shuffle(cids.begin(), cids.end(), std::mt19937(1));
+
+    mb_scan_plan_handle_t plan;
+    REQUIRE(mbc_scan_plan_create(table.data(), table.size(), cids.data(), cids.size(), 0, &plan) == ESP_OK);
+    CHECK(mbc_scan_plan_get_request_count(plan) == 4);
+    CHECK(mbc_scan_plan_get_table(plan) == table.data());
+
+    printf("%u holding registers in 4 blocks\n", (unsigned)cids.size());
+    printf("baudrate  requests one by one [ms]  requests planned [ms]  speedup\n");
+    for (uint32_t baudrate : { 9600, 19200, 115200 }) {
+        slave_sim_init(baudrate);
+        for (const auto &block : blocks) {
+            slave_sim_add_range(1, MB_PARAM_HOLDING, block.start, block.count);
+        }
+        values_t expected(cids.size());
+        vector<esp_err_t> expected_errors(cids.size());
+        REQUIRE(read_one_by_one(table, cids, expected, expected_errors) == ESP_OK);
+        uint32_t single_requests = slave_sim_get_request_count();
+        double single_time = slave_sim_get_bus_time();
+
+        slave_sim_init(baudrate);
+        for (const auto &block : blocks) {
+            slave_sim_add_range(1, MB_PARAM_HOLDING, block.start, block.count);
+        }
+        values_t values(cids.size());
+        REQUIRE(mbc_scan_plan_execute(plan, slave_sim_send_request, NULL, values.pointers.data(), NULL) == ESP_OK);
+        uint32_t plan_requests = slave_sim_get_request_count();
+        double plan_time = slave_sim_get_bus_time();
+        for (size_t i = 0; i < cids.size(); i++) {
+            CHECK(values.buffers[i] == expected.buffers[i]);
+        }
+
+        CHECK(single_requests == 80);
+        CHECK(plan_requests == 4);
+        CHECK(plan_time * 5 < single_time);
+        printf("%8u  %8u %15.1f  %8u %12.1f  %6.1fx\n", baudrate, single_requests, single_time * 1000,
+               plan_requests, plan_time * 1000, single_time / plan_time);
+    }
+    mbc_scan_plan_delete(plan);
+}
+
+TEST_CASE("requests are limited to 125 registers and 2000 bits", "[scan]")
+{
+    slave_sim_init(115200);
+    slave_sim_add_range(1, MB_PARAM_INPUT, 0, 1000);
+    slave_sim_add_range(1, MB_PARAM_COIL, 0, 5000);
+    vector<mb_parameter_descriptor_t> table;
+    vector<uint16_t> cids;
+    // Characteristics of 1 to 4 registers, a request never splits one
+    for (uint16_t reg = 0, size = 1; reg + size <= 1000; reg += size, size = 1 + size % 4) {
+        cids.push_back(table.size());
+        table.push_back(make_descriptor(table.size(), 1, MB_PARAM_INPUT, reg, size));
+    }
+    for (uint16_t reg = 0; reg < 5000 - 16; reg += 16) {
+        cids.push_back(table.size());
+        table.push_back(make_descriptor(table.size(), 1, MB_PARAM_COIL, reg, 16));
+    }
+
+    mb_scan_plan_handle_t plan;
+    REQUIRE(mbc_scan_plan_create(table.data(), table.size(), cids.data(), cids.size(), 0, &plan) == ESP_OK);
+    uint16_t request_count = mbc_scan_plan_get_request_count(plan);
+    uint32_t plan_requests;
+    CHECK(check_scan(table, cids, plan, &plan_requests, NULL));
+    // A request over the limits would be refused by the slave and its characteristics read one by one
+    CHECK(plan_requests == request_count);
+    CHECK(mbc_scan_plan_get_request_count(plan) == request_count);
+    // 1000 registers with at least 122 per request, 4984 coils with 2000 per request
+    CHECK(plan_requests >= 8 + 3);
+    CHECK(plan_requests <= 9 + 3);
+    mbc_scan_plan_delete(plan);
+}
+
+TEST_CASE("registers between characteristics are read up to max_gap", "[scan]")
+{
+    slave_sim_init(115200);
+    slave_sim_add_range(1, MB_PARAM_HOLDING, 0, 100);
+    vector<mb_parameter_descriptor_t> table = {
+        make_descriptor(0, 1, MB_PARAM_HOLDING, 0, 2),
+        make_descriptor(1, 1, MB_PARAM_HOLDING, 4, 1),
+        make_descriptor(2, 1, MB_PARAM_HOLDING, 11, 2),
+        make_descriptor(3, 1, MB_PARAM_HOLDING, 4, 2),  // overlaps cid 1
+        make_descriptor(4, 1, MB_PARAM_HOLDING, 1, 1),  // inside cid 0
+    };
+    vector<uint16_t> cids = { 0, 1, 2, 3, 4 };
+    const struct {
+        uint16_t max_gap;
+        uint16_t requests;
+    } cases[] = { {0, 3}, {1, 3}, {2, 2}, {4, 2}, {5, 1}, {100, 1} };
+    for (const auto &c : cases) {
+        mb_scan_plan_handle_t plan;
+        REQUIRE(mbc_scan_plan_create(table.data(), table.size(), cids.data(), cids.size(), c.max_gap, &plan) == ESP_OK);
+        uint32_t plan_requests;
+        check_scan(table, cids, plan, &plan_requests, NULL);
+        CHECK(plan_requests == c.requests);
+        mbc_scan_plan_delete(plan);
+    }
+}
+
+TEST_CASE("slaves and register types are read with separate requests", "[scan]")
+{
+    slave_sim_init(115200);
+    vector<mb_parameter_descriptor_t> table;
+    vector<uint16_t> cids;
+    for (uint8_t slave_addr = 1; slave_addr <= 3; slave_addr++) {
+        for (int type = MB_PARAM_HOLDING; type < MB_PARAM_COUNT; type++) {
+            slave_sim_add_range(slave_addr, (mb_param_type_t)type, 0, 64);
+            for (uint16_t reg = 0; reg < 64; reg += 8) {
+                cids.push_back(table.size());
+                table.push_back(make_descriptor(table.size(), slave_addr, (mb_param_type_t)type, reg, 8));
+            }
+        }
+    }
+    mb_scan_plan_handle_t plan;
+    REQUIRE(mbc_scan_plan_create(table.data(), table.size(), cids.data(), cids.size(), 0, &plan) == ESP_OK);
+    uint32_t plan_requests;
+    check_scan(table, cids, plan, &plan_requests, NULL);
+    CHECK(plan_requests == 3 * 4);
+    mbc_scan_plan_delete(plan);
+}
+
+TEST_CASE("characteristics are read separately when the slave refuses the joined request", "[scan]")
+{
+    slave_sim_init(115200);
+    // Registers 2 and 3 don't exist
+    slave_sim_add_range(1, MB_PARAM_HOLDING, 0, 2);
+    slave_sim_add_range(1, MB_PARAM_HOLDING, 4, 10);
+    slave_sim_add_range(1, MB_PARAM_HOLDING, 20, 10);
+    vector<mb_parameter_descriptor_t> table = {
+        make_descriptor(0, 1, MB_PARAM_HOLDING, 0, 2),
+        make_descriptor(1, 1, MB_PARAM_HOLDING, 4, 2),
+        make_descriptor(2, 1, MB_PARAM_HOLDING, 6, 2),
+        make_descriptor(3, 1, MB_PARAM_HOLDING, 20, 2),
+        make_descriptor(4, 1, MB_PARAM_HOLDING, 22, 2),
+    };
+    vector<uint16_t> cids = { 0, 1, 2, 3, 4 };
+    mb_scan_plan_handle_t plan;
+    REQUIRE(mbc_scan_plan_create(table.data(), table.size(), cids.data(), cids.size(), 2, &plan) == ESP_OK);
+    CHECK(mbc_scan_plan_get_request_count(plan) == 2);
+
+    // The refused request, then each of its characteristics
+    uint32_t plan_requests;
+    check_scan(table, cids, plan, &plan_requests, NULL);
+    CHECK(plan_requests == 1 + 3 + 1);
+    // They are read separately from now on
+    CHECK(mbc_scan_plan_get_request_count(plan) == 4);
+    check_scan(table, cids, plan, &plan_requests, NULL);
+    CHECK(plan_requests == 4);
+    mbc_scan_plan_delete(plan);
+
+    // Including when some of them can't be read alone
+    table.push_back(make_descriptor(5, 1, MB_PARAM_HOLDING, 9, 6));
+    cids.push_back(5);
+    REQUIRE(mbc_scan_plan_create(table.data(), table.size(), cids.data(), cids.size(), 2, &plan) == ESP_OK);
+    CHECK(mbc_scan_plan_get_request_count(plan) == 2);
+    CHECK(!check_scan(table, cids, plan, &plan_requests, NULL));
+    CHECK(plan_requests == 1 + 4 + 1);
+    CHECK(!check_scan(table, cids, plan, &plan_requests, NULL));
+    CHECK(plan_requests == 4 + 1);
+    mbc_scan_plan_delete(plan);
+}
+
+TEST_CASE("characteristics of a slave not responding time out", "[scan]")
+{
+    slave_sim_init(115200);
+    slave_sim_add_range(1, MB_PARAM_INPUT, 0, 10);
+    vector<mb_parameter_descriptor_t> table = {
+        make_descriptor(0, 1, MB_PARAM_INPUT, 0, 2),
+        make_descriptor(1, 2, MB_PARAM_INPUT, 0, 2),
+        make_descriptor(2, 2, MB_PARAM_INPUT, 2, 2),
+        make_descriptor(3, 1, MB_PARAM_INPUT, 2, 2),
+    };
+    vector<uint16_t> cids = { 3, 2, 1, 0 };
+    mb_scan_plan_handle_t plan;
+    REQUIRE(mbc_scan_plan_create(table.data(), table.size(), cids.data(), cids.size(), 0, &plan) == ESP_OK);
+    values_t values(cids.size());
+    vector<esp_err_t> errors(cids.size());
+    CHECK(mbc_scan_plan_execute(plan, slave_sim_send_request, NULL, values.pointers.data(), errors.data()) == ESP_ERR_TIMEOUT);
+    CHECK(errors == vector<esp_err_t>({ ESP_OK, ESP_ERR_TIMEOUT, ESP_ERR_TIMEOUT, ESP_OK }));
+    // Not retried one by one
+    CHECK(slave_sim_get_request_count() == 2);
+    check_scan(table, cids, plan, NULL, NULL);
+    mbc_scan_plan_delete(plan);
+}
+
+TEST_CASE("scan plan arguments are checked", "[scan]")
+{
+    vector<mb_parameter_descriptor_t> table = {
+        make_descriptor(0, 1, MB_PARAM_INPUT, 0, 2),
+        make_descriptor(1, 1, MB_PARAM_UNKNOWN, 0, 2),
+        make_descriptor(2, 1, MB_PARAM_INPUT, 0, 0),
+    };
+    mb_scan_plan_handle_t plan;
+    uint16_t cids[] = { 0, 1, 2, 3 };
+    CHECK(mbc_scan_plan_create(table.data(), table.size(), &cids[3], 1, 0, &plan) == ESP_ERR_NOT_FOUND);
+    CHECK(mbc_scan_plan_create(table.data(), table.size(), &cids[1], 1, 0, &plan) == ESP_ERR_INVALID_ARG);
+    CHECK(mbc_scan_plan_create(table.data(), table.size(), &cids[2], 1, 0, &plan) == ESP_ERR_INVALID_ARG);
+    CHECK(mbc_scan_plan_create(table.data(), table.size(), cids, 0, 0, &plan) == ESP_ERR_INVALID_ARG);
+    CHECK(mbc_scan_plan_create(NULL, 0, cids, 1, 0, &plan) == ESP_ERR_INVALID_ARG);
+    REQUIRE(mbc_scan_plan_create(table.data(), table.size(), cids, 1, 0, &plan) == ESP_OK);
+    CHECK(mbc_scan_plan_execute(plan, slave_sim_send_request, NULL, NULL, NULL) == ESP_ERR_INVALID_ARG);
+    CHECK(mbc_scan_plan_execute(plan, NULL, NULL, NULL, NULL) == ESP_ERR_INVALID_ARG);
+    mbc_scan_plan_delete(plan);
+    mbc_scan_plan_delete(NULL);
+}
+
+TEST_CASE("random characteristics read with a plan are the same as read one by one", "[scan]")
+{
+    std::mt19937 gen(0x5ca9);
+    uint32_t total_plan_requests = 0;
+    uint32_t total_single_requests = 0;
+    for (int round = 0; round < 200; round++) {
+        slave_sim_init(115200);
+        for (uint8_t slave_addr = 1; slave_addr <= 2; slave_addr++) {
+            for (int type = MB_PARAM_HOLDING; type < MB_PARAM_COUNT; type++) {
+                for (int i = 0; i < 4; i++) {
+                    slave_sim_add_range(slave_addr, (mb_param_type_t)type, gen() % 400, 1 + gen() % 150);
+                }
+            }
+        }
+        vector<mb_parameter_descriptor_t> table;
+        vector<uint16_t> cids;
+        size_t count = 1 + gen() % 100;
+        for (size_t i = 0; i < count; i++) {
+            mb_param_type_t type = (mb_param_type_t)(gen() % MB_PARAM_COUNT);
+            uint16_t size = (type == MB_PARAM_COIL || type == MB_PARAM_DISCRETE) ? 1 + gen() % 40 : 1 + gen() % 4;
+            table.push_back(make_descriptor(i, 1 + gen() % 2, type, gen() % 520, size));
+            if (gen() % 4) {
+                cids.push_back(i);
+            }
+        }
+        if (cids.empty()) {
+            continue;
+        }
+        mb_scan_plan_handle_t plan;
+        REQUIRE(mbc_scan_plan_create(table.data(), table.size(), cids.data(), cids.size(), gen() % 10, &plan) == ESP_OK);
+        uint32_t plan_requests, single_requests;
+        // The requests are sent one by one or at once, as by a TCP master
+        check_scan(table, cids, plan, &plan_requests, &single_requests, round % 2);
+        // Once the refused joined requests are split, a scan never takes more requests than one by one
+        check_scan(table, cids, plan, &plan_requests, &single_requests, round % 2);
+        CHECK(plan_requests <= single_requests);
+        total_plan_requests += plan_requests;
+        total_single_requests += single_requests;
+        mbc_scan_plan_delete(plan);
+    }
+    printf("random scans: %u requests planned, %u one by one\n", total_plan_requests, total_single_requests);
+}
@@ -0,0 +1,5 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+typedef void *EventGroupHandle_t;
+typedef uint32_t EventBits_t;
@@ -0,0 +1,10 @@
+#pragma once
+#include "freertos/queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+#define xSemaphoreCreateBinary()            xQueueCreate(1, 0)
+#define xSemaphoreCreateMutex()             xQueueCreateMutex()
+#define xSemaphoreGive(sem)                 xQueueSend((sem), NULL, 0)
+#define xSemaphoreTake(sem, ticks_to_wait)  xQueueReceive((sem), NULL, (ticks_to_wait))
+#define vSemaphoreDelete(sem)               vQueueDelete(sem)
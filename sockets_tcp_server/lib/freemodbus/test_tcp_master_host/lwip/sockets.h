@@ -0,0 +1,9 @@
+#pragma once
+// The lwIP socket API is the BSD one
+#include <errno.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
@@ -0,0 +1,22 @@
+#pragma once
+// Types of the Modbus stack port
+
+#define INLINE                      inline
+#define PR_BEGIN_EXTERN_C           extern "C" {
+#define PR_END_EXTERN_C             }
+
+#ifndef TRUE
+#define TRUE            1
+#endif
+
+#ifndef FALSE
+#define FALSE           0
+#endif
+
+typedef char    BOOL;
+typedef unsigned char UCHAR;
+typedef char    CHAR;
+typedef unsigned short USHORT;
+typedef short   SHORT;
+typedef unsigned long ULONG;
+typedef long    LONG;
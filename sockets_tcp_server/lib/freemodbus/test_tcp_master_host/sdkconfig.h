@@ -0,0 +1,11 @@
+#define CONFIG_FMB_MASTER_TIMEOUT_MS_RESPOND 150
+#define CONFIG_FMB_MASTER_DELAY_MS_CONVERT 200
+#define CONFIG_FMB_TCP_PORT_DEFAULT 502
+#define CONFIG_FMB_TCP_MASTER_MAX_PENDING 4
+#define CONFIG_FMB_TCP_MASTER_CONNECT_TIMEOUT_MS 500
+#define CONFIG_FMB_CONTROLLER_STACK_SIZE 4096
+#define CONFIG_FMB_SERIAL_TASK_PRIO 10
+#define CONFIG_FMB_COMM_MODE_RTU_EN 1
+#define CONFIG_FMB_COMM_MODE_ASCII_EN 0
+#define CONFIG_FMB_CONTROLLER_SLAVE_ID_SUPPORT 0
+#define CONFIG_FMB_TIMER_ISR_IN_IRAM 0
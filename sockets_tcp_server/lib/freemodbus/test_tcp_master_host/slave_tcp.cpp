@@ -0,0 +1,262 @@
+#include "slave_tcp.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <stdexcept>
+
+static int64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint16_t get_u16(const uint8_t* buf)
+{
+    return (uint16_t)((buf[0] << 8) | buf[1]);
+}
+
+static void put_u16(std::vector<uint8_t>& out, uint16_t value)
+{
+    out.push_back((uint8_t)(value >> 8));
+    out.push_back((uint8_t)value);
+}
+
+SlaveTcp::SlaveTcp()
+    : delay_ms(0), reorder(0), drop_after(0), requests(0), connections(0), max_outstanding(0),
+      stop_(false), holding_(REG_COUNT), input_(REG_COUNT), coils_(REG_COUNT), discrete_(REG_COUNT)
+{
+    for (uint16_t i = 0; i < REG_COUNT; i++) {
+        holding_[i] = 0x1000 + i;
+        input_[i] = 0x2000 + i;
+        coils_[i] = (i % 3) == 0;
+        discrete_[i] = (i % 5) == 0 || (i % 7) == 1;
+    }
+    listen_sock_ = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (listen_sock_ < 0 || bind(listen_sock_, (struct sockaddr*)&addr, sizeof(addr)) < 0
+            || listen(listen_sock_, 4) < 0 || getsockname(listen_sock_, (struct sockaddr*)&addr, &len) < 0) {
+        throw std::runtime_error("slave socket");
+    }
+    port_ = ntohs(addr.sin_port);
+    accept_thread_ = std::thread(&SlaveTcp::accept_loop, this);
+}
+
+SlaveTcp::~SlaveTcp()
+{
+    stop_ = true;
+    accept_thread_.join();
+    close(listen_sock_);
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+std::string SlaveTcp::address() const
+{
+    return "127.0.0.1:" + std::to_string(port_);
+}
+
+uint16_t SlaveTcp::holding(uint16_t reg)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    return holding_[reg];
+}
+
+uint16_t SlaveTcp::input(uint16_t reg)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    return input_[reg];
+}
+
+bool SlaveTcp::coil(uint16_t bit)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    return coils_[bit];
+}
+
+bool SlaveTcp::discrete(uint16_t bit)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    return discrete_[bit];
+}
+
+void SlaveTcp::set_holding(uint16_t reg, uint16_t value)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    holding_[reg] = value;
+}
+
+void SlaveTcp::accept_loop()
+{
+    while (!stop_) {
+        struct pollfd fd = { listen_sock_, POLLIN, 0 };
+        if (poll(&fd, 1, 5) <= 0) {
+            continue;
+        }
+        int sock = accept(listen_sock_, NULL, NULL);
+        if (sock >= 0) {
+            int nodelay = 1;
+            setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+            connections++;
+            threads_.push_back(std::thread(&SlaveTcp::connection_loop, this, sock));
+        }
+    }
+}
+
+void SlaveTcp::connection_loop(int sock)
+{
+    std::vector<uint8_t> rx;
+    std::deque<Response> responses;
+    while (!stop_) {
+        int64_t now = now_us();
+        int group = reorder;
+        if (group > 1) {
+            // Send the responses of a group in reverse order, or the incomplete group after a while
+            if (((int)responses.size() >= group)
+                    || (!responses.empty() && (now >= responses.front().due_us + 50000))) {
+                for (auto it = responses.rbegin(); it != responses.rend(); ++it) {
+                    send(sock, it->adu.data(), it->adu.size(), MSG_NOSIGNAL);
+                }
+                responses.clear();
+            }
+        } else {
+            while (!responses.empty() && (responses.front().due_us <= now)) {
+                send(sock, responses.front().adu.data(), responses.front().adu.size(), MSG_NOSIGNAL);
+                responses.pop_front();
+            }
+        }
+
+        struct pollfd fd = { sock, POLLIN, 0 };
+        if (poll(&fd, 1, 1) <= 0) {
+            continue;
+        }
+        uint8_t buf[512];
+        ssize_t ret = recv(sock, buf, sizeof(buf), 0);
+        if (ret <= 0) {
+            break;
+        }
+        rx.insert(rx.end(), buf, buf + ret);
+        while ((rx.size() >= 7) && (rx.size() >= 6u + get_u16(&rx[4]))) {
+            size_t length = 6 + get_u16(&rx[4]);
+            requests++;
+            if ((drop_after > 0) && (--drop_after == 0)) {
+                close(sock);
+                return;
+            }
+            responses.push_back(Response{ process(rx.data(), length), now + delay_ms * 1000 });
+            rx.erase(rx.begin(), rx.begin() + length);
+            int outstanding = responses.size();
+            int max = max_outstanding;
+            while ((outstanding > max) && !max_outstanding.compare_exchange_weak(max, outstanding)) {
+            }
+        }
+    }
+    close(sock);
+}
+
+std::vector<uint8_t> SlaveTcp::process(const uint8_t* adu, size_t length)
+{
+    std::vector<uint8_t> pdu = process_pdu(adu + 7, length - 7);
+    std::vector<uint8_t> out(adu, adu + 4);
+    put_u16(out, pdu.size() + 1);
+    out.push_back(adu[6]);
+    out.insert(out.end(), pdu.begin(), pdu.end());
+    return out;
+}
+
+std::vector<uint8_t> SlaveTcp::process_pdu(const uint8_t* pdu, size_t length)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    uint8_t function = pdu[0];
+    uint16_t addr = get_u16(&pdu[1]);
+    uint16_t count = get_u16(&pdu[3]);
+    std::vector<uint8_t> out = { function };
+    const std::vector<uint8_t> illegal_address = { (uint8_t)(function | 0x80), 2 };
+    bool in_range = (count >= 1) && (addr + count <= REG_COUNT);
+
+    switch (function) {
+    case 1:
+    case 2: {
+        if (!in_range || count > 2000) {
+            return illegal_address;
+        }
+        const std::vector<bool>& bits = (function == 1) ? coils_ : discrete_;
+        out.push_back((count + 7) / 8);
+        out.resize(2 + (count + 7) / 8);
+        for (uint16_t k = 0; k < count; k++) {
+            if (bits[addr + k]) {
+                out[2 + k / 8] |= 1 << (k % 8);
+            }
+        }
+        return out;
+    }
+    case 3:
+    case 4:
+        if (!in_range || count > 125) {
+            return illegal_address;
+        }
+        out.push_back(2 * count);
+        for (uint16_t i = addr; i < addr + count; i++) {
+            if ((function == 3) && holes.count(i)) {
+                return illegal_address;
+            }
+            put_u16(out, (function == 3) ? holding_[i] : input_[i]);
+        }
+        return out;
+    case 5:
+        if ((addr >= REG_COUNT) || ((count != 0xFF00) && (count != 0))) {
+            return { (uint8_t)(function | 0x80), 3 };
+        }
+        coils_[addr] = (count == 0xFF00);
+        return std::vector<uint8_t>(pdu, pdu + 5);
+    case 6:
+        if (addr >= REG_COUNT) {
+            return illegal_address;
+        }
+        holding_[addr] = count;
+        return std::vector<uint8_t>(pdu, pdu + 5);
+    case 15:
+        if (!in_range || (length != 6u + pdu[5])) {
+            return illegal_address;
+        }
+        for (uint16_t k = 0; k < count; k++) {
+            coils_[addr + k] = (pdu[6 + k / 8] >> (k % 8)) & 1;
+        }
+        return std::vector<uint8_t>(pdu, pdu + 5);
+    case 16:
+        if (!in_range || (length != 6u + 2 * count)) {
+            return illegal_address;
+        }
+        for (uint16_t i = 0; i < count; i++) {
+            holding_[addr + i] = get_u16(&pdu[6 + 2 * i]);
+        }
+        return std::vector<uint8_t>(pdu, pdu + 5);
+    case 23: {
+        uint16_t write_addr = get_u16(&pdu[5]);
+        uint16_t write_count = get_u16(&pdu[7]);
+        if (!in_range || (write_addr + write_count > REG_COUNT) || (length != 10u + 2 * write_count)) {
+            return illegal_address;
+        }
+        for (uint16_t i = 0; i < write_count; i++) {
+            holding_[write_addr + i] = get_u16(&pdu[10 + 2 * i]);
+        }
+        out.push_back(2 * count);
+        for (uint16_t i = addr; i < addr + count; i++) {
+            put_u16(out, holding_[i]);
+        }
+        return out;
+    }
+    default:
+        return { (uint8_t)(function | 0x80), 1 };
+    }
+}
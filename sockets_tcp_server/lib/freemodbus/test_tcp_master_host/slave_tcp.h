@@ -0,0 +1,61 @@
+#pragma once
+// Modbus TCP slave listening on the loopback interface, for the TCP master tests
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+class SlaveTcp {
+public:
+    static const uint16_t REG_COUNT = 1000;     // Registers, coils and discrete inputs of each type
+
+    SlaveTcp();
+    ~SlaveTcp();
+
+    std::string address() const;                // "127.0.0.1:port"
+    uint16_t port() const { return port_; }
+
+    // Registers and bits, initialized from their address
+    uint16_t holding(uint16_t reg);
+    uint16_t input(uint16_t reg);
+    bool coil(uint16_t bit);
+    bool discrete(uint16_t bit);
+    void set_holding(uint16_t reg, uint16_t value);
+
+    // Behavior
+    std::atomic<int> delay_ms;                  // Response delay
+    std::atomic<int> reorder;                   // Responses sent in reverse order by groups of this many requests
+    std::atomic<int> drop_after;                // Close the connection instead of responding to this request (1 = next one)
+    std::set<uint16_t> holes;                   // Holding registers not implemented, read with an exception
+
+    // Statistics
+    std::atomic<int> requests;
+    std::atomic<int> connections;
+    std::atomic<int> max_outstanding;           // Most requests received and not responded at the same time
+
+private:
+    struct Response {
+        std::vector<uint8_t> adu;
+        int64_t due_us;
+    };
+
+    void accept_loop();
+    void connection_loop(int sock);
+    std::vector<uint8_t> process(const uint8_t* adu, size_t length);
+    std::vector<uint8_t> process_pdu(const uint8_t* pdu, size_t length);
+
+    int listen_sock_;
+    uint16_t port_;
+    std::atomic<bool> stop_;
+    std::mutex lock_;
+    std::vector<uint16_t> holding_;
+    std::vector<uint16_t> input_;
+    std::vector<bool> coils_;
+    std::vector<bool> discrete_;
+    std::thread accept_thread_;
+    std::vector<std::thread> threads_;
+};
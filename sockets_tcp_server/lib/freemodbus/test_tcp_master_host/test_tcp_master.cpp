@@ -0,0 +1,401 @@
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "catch.hpp"
+#include "sdkconfig.h"
+#include "esp_modbus_master.h"
+#include "mbc_master.h"
+#include "mbc_scan_plan.h"
+#include "slave_tcp.h"
+
+using namespace std;
+
+extern "C" {
+
+// The serial master is not built in this test
+esp_err_t mbc_serial_master_create(mb_port_type_t port_type, void **handler)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    return "ERROR";
+}
+
+}
+
+static int64_t elapsed_ms(chrono::steady_clock::time_point start)
+{
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+}
+
+// TCP master controller connected to the slaves, slave address N is the N-th address
+struct Master {
+    vector<string> addresses;
+    vector<const char *> table;
+    mb_master_interface_t *iface;
+
+    Master(const vector<string> &slave_addresses) : addresses(slave_addresses)
+    {
+        for (auto &address : addresses) {
+            table.push_back(address.c_str());
+        }
+        table.push_back(NULL);
+        void *handler = NULL;
+        REQUIRE(mbc_master_init(MB_PORT_TCP_MASTER, &handler) == ESP_OK);
+        iface = (mb_master_interface_t *)handler;
+        mb_communication_info_t comm = {};
+        comm.tcp_mode = MB_MODE_TCP;
+        comm.ip_addr = table.data();
+        REQUIRE(mbc_master_setup(&comm) == ESP_OK);
+        REQUIRE(mbc_master_start() == ESP_OK);
+    }
+
+    ~Master()
+    {
+        mbc_master_destroy();
+    }
+};
+
+static esp_err_t send(uint8_t slave_addr, uint8_t command, uint16_t reg_start, uint16_t reg_size, void *data)
+{
+    mb_param_request_t request = { slave_addr, command, reg_start, reg_size };
+    return mbc_master_send_request(&request, data);
+}
+
+static mb_parameter_descriptor_t make_descriptor(uint16_t cid, const char *key, uint8_t slave_addr,
+                                                 mb_param_type_t type, uint16_t reg_start, uint16_t size)
+{
+    mb_parameter_descriptor_t descriptor = {};
+    descriptor.cid = cid;
+    descriptor.param_key = key;
+    descriptor.param_units = "";
+    descriptor.mb_slave_addr = slave_addr;
+    descriptor.mb_param_type = type;
+    descriptor.mb_reg_start = reg_start;
+    descriptor.mb_size = size;
+    descriptor.param_type = PARAM_TYPE_U16;
+    descriptor.param_size = PARAM_SIZE_U16;
+    descriptor.access = PAR_PERMS_READ_WRITE;
+    return descriptor;
+}
+
+TEST_CASE("TCP master reads and writes registers and bits", "[tcp_master]")
+{
+    SlaveTcp slave;
+    Master master({ slave.address() });
+
+    uint16_t regs[8] = {};
+    CHECK(send(1, 3, 10, 5, regs) == ESP_OK);
+    for (int i = 0; i < 5; i++) {
+        CHECK(regs[i] == 0x1000 + 10 + i);
+    }
+    CHECK(send(1, 4, 20, 3, regs) == ESP_OK);
+    for (int i = 0; i < 3; i++) {
+        CHECK(regs[i] == 0x2000 + 20 + i);
+    }
+
+    // The bits are set from bit (reg_start % 8) of the buffer, the other bits are kept
+    uint8_t bits[4];
+    memset(bits, 0xa5, sizeof(bits));
+    CHECK(send(1, 1, 5, 16, bits) == ESP_OK);
+    CHECK((bits[0] & 0x1f) == (0xa5 & 0x1f));
+    for (int k = 0; k < 16; k++) {
+        CHECK(((bits[(5 + k) / 8] >> ((5 + k) % 8)) & 1) == slave.coil(5 + k));
+    }
+    memset(bits, 0, sizeof(bits));
+    CHECK(send(1, 2, 3, 10, bits) == ESP_OK);
+    for (int k = 0; k < 10; k++) {
+        CHECK(((bits[(3 + k) / 8] >> ((3 + k) % 8)) & 1) == slave.discrete(3 + k));
+    }
+
+    uint16_t values[3] = { 1, 2, 0xfffe };
+    CHECK(send(1, 16, 100, 3, values) == ESP_OK);
+    for (int i = 0; i < 3; i++) {
+        CHECK(slave.holding(100 + i) == values[i]);
+    }
+    uint16_t value = 0xbeef;
+    CHECK(send(1, 6, 200, 1, &value) == ESP_OK);
+    CHECK(slave.holding(200) == 0xbeef);
+
+    value = 0xff00;
+    CHECK(send(1, 5, 7, 1, &value) == ESP_OK);
+    CHECK(slave.coil(7));
+    value = 0;
+    CHECK(send(1, 5, 7, 1, &value) == ESP_OK);
+    CHECK_FALSE(slave.coil(7));
+    value = 0x1234;
+    CHECK(send(1, 5, 7, 1, &value) == ESP_ERR_INVALID_ARG);
+
+    uint8_t coils[2] = { 0x55, 0x02 };
+    CHECK(send(1, 15, 30, 10, coils) == ESP_OK);
+    for (int k = 0; k < 10; k++) {
+        CHECK(slave.coil(30 + k) == (bool)((coils[k / 8] >> (k % 8)) & 1));
+    }
+
+    uint16_t read_write[2] = { 7, 8 };
+    CHECK(send(1, 23, 300, 2, read_write) == ESP_OK);
+    CHECK(slave.holding(300) == 7);
+    CHECK(slave.holding(301) == 8);
+    CHECK(read_write[0] == 7);
+    CHECK(read_write[1] == 8);
+
+    CHECK(send(1, 8, 0, 1, regs) == ESP_ERR_NOT_SUPPORTED);
+    CHECK(send(1, 3, 0, 126, regs) == ESP_ERR_INVALID_ARG);
+    CHECK(slave.connections == 1);
+}
+
+TEST_CASE("TCP master gets and sets parameters of the description table", "[tcp_master]")
+{
+    SlaveTcp slave;
+    Master master({ slave.address() });
+    const mb_parameter_descriptor_t table[] = {
+        make_descriptor(0, "setpoint", 1, MB_PARAM_HOLDING, 40, 2),
+        make_descriptor(1, "level", 1, MB_PARAM_INPUT, 50, 1),
+        make_descriptor(2, "pump", 1, MB_PARAM_COIL, 9, 1),
+    };
+    REQUIRE(mbc_master_set_descriptor(table, 3) == ESP_OK);
+
+    uint16_t value[2] = {};
+    uint8_t type = 0;
+    CHECK(mbc_master_get_parameter(0, (char *)"setpoint", (uint8_t *)value, &type) == ESP_OK);
+    CHECK(value[0] == 0x1000 + 40);
+    CHECK(value[1] == 0x1000 + 41);
+    CHECK(type == PARAM_TYPE_U16);
+    CHECK(mbc_master_get_parameter(1, (char *)"level", (uint8_t *)value, &type) == ESP_OK);
+    CHECK(value[0] == 0x2000 + 50);
+
+    value[0] = 0xaaaa;
+    value[1] = 0x5555;
+    CHECK(mbc_master_set_parameter(0, (char *)"setpoint", (uint8_t *)value, &type) == ESP_OK);
+    CHECK(slave.holding(40) == 0xaaaa);
+    CHECK(slave.holding(41) == 0x5555);
+    uint8_t pump = slave.coil(9) ? 0 : 1;
+    CHECK(mbc_master_set_parameter(2, (char *)"pump", &pump, &type) == ESP_OK);
+    CHECK(slave.coil(9) == (bool)pump);
+}
+
+TEST_CASE("TCP master reports exceptions and invalid slave addresses", "[tcp_master]")
+{
+    SlaveTcp slave;
+    Master master({ slave.address() });
+
+    uint16_t regs[32];
+    CHECK(send(1, 3, SlaveTcp::REG_COUNT - 10, 20, regs) == ESP_ERR_INVALID_RESPONSE);
+    slave.holes.insert(61);
+    CHECK(send(1, 3, 60, 2, regs) == ESP_ERR_INVALID_RESPONSE);
+    // The connection is still in sync
+    CHECK(send(1, 3, 62, 2, regs) == ESP_OK);
+    CHECK(regs[0] == 0x1000 + 62);
+
+    CHECK(send(0, 3, 0, 1, regs) == ESP_ERR_INVALID_ARG);
+    CHECK(send(2, 3, 0, 1, regs) == ESP_ERR_INVALID_ARG);
+    CHECK(slave.connections == 1);
+}
+
+TEST_CASE("Requests of several tasks are pipelined on the connection", "[tcp_master]")
+{
+    SlaveTcp slave;
+    Master master({ slave.address() });
+    slave.delay_ms = 50;
+
+    const int task_count = 8;
+    vector<esp_err_t> errors(task_count, ESP_FAIL);
+    vector<uint16_t> values(task_count);
+    vector<thread> tasks;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < task_count; i++) {
+        tasks.push_back(thread([i, &errors, &values] {
+            errors[i] = send(1, 3, 100 + i, 1, &values[i]);
+        }));
+    }
+    for (auto &task : tasks) {
+        task.join();
+    }
+    int64_t time_ms = elapsed_ms(start);
+    printf("%d requests of %d tasks, %d ms response delay: %d ms\n", task_count, task_count,
+           (int)slave.delay_ms, (int)time_ms);
+    for (int i = 0; i < task_count; i++) {
+        CHECK(errors[i] == ESP_OK);
+        CHECK(values[i] == 0x1000 + 100 + i);
+    }
+    // 2 rounds of CONFIG_FMB_TCP_MASTER_MAX_PENDING requests instead of 8 round trips
+    CHECK(slave.max_outstanding == CONFIG_FMB_TCP_MASTER_MAX_PENDING);
+    CHECK(time_ms < task_count * 50 / 2);
+    CHECK(slave.connections == 1);
+}
+
+TEST_CASE("Responses out of order are matched to their requests", "[tcp_master]")
+{
+    SlaveTcp slave;
+    Master master({ slave.address() });
+    slave.reorder = 4;
+
+    uint16_t holding[3][4] = {};
+    uint16_t input[2] = {};
+    mb_param_request_t requests[] = {
+        { 1, 3, 0, 4 },
+        { 1, 3, 10, 2 },
+        { 1, 4, 30, 2 },
+        { 1, 3, 500, 3 },
+    };
+    void *const data[] = { holding[0], holding[1], input, holding[2] };
+    esp_err_t errors[4];
+    REQUIRE(master.iface->send_requests != NULL);
+    for (int round = 0; round < 3; round++) {
+        memset(holding, 0, sizeof(holding));
+        CHECK(master.iface->send_requests(requests, data, errors, 4) == ESP_OK);
+        for (int i = 0; i < 4; i++) {
+            CHECK(errors[i] == ESP_OK);
+        }
+        for (int i = 0; i < 4; i++) {
+            CHECK(holding[0][i] == 0x1000 + i);
+        }
+        CHECK(holding[1][0] == 0x1000 + 10);
+        CHECK(holding[1][1] == 0x1000 + 11);
+        CHECK(input[0] == 0x2000 + 30);
+        CHECK(input[1] == 0x2000 + 31);
+        CHECK(holding[2][2] == 0x1000 + 502);
+    }
+}
+
+TEST_CASE("Late responses are dropped and lost connections are reopened", "[tcp_master]")
+{
+    SlaveTcp slave;
+    Master master({ slave.address() });
+    uint16_t value = 0;
+
+    slave.delay_ms = CONFIG_FMB_MASTER_TIMEOUT_MS_RESPOND + 100;
+    CHECK(send(1, 3, 10, 1, &value) == ESP_ERR_TIMEOUT);
+    slave.delay_ms = 0;
+    // The response to the request timed out comes first, it does not complete this request
+    CHECK(send(1, 3, 20, 1, &value) == ESP_OK);
+    CHECK(value == 0x1000 + 20);
+    CHECK(slave.connections == 1);
+
+    slave.drop_after = 1;
+    auto start = chrono::steady_clock::now();
+    CHECK(send(1, 3, 30, 1, &value) == ESP_ERR_TIMEOUT);
+    CHECK(elapsed_ms(start) < CONFIG_FMB_MASTER_TIMEOUT_MS_RESPOND);
+    CHECK(send(1, 3, 40, 1, &value) == ESP_OK);
+    CHECK(value == 0x1000 + 40);
+    CHECK(slave.connections == 2);
+}
+
+TEST_CASE("Requests to a slave not listening fail", "[tcp_master]")
+{
+    string address;
+    {
+        SlaveTcp closed;
+        address = closed.address();
+    }
+    SlaveTcp slave;
+    Master master({ address, slave.address() });
+    uint16_t value = 0;
+    auto start = chrono::steady_clock::now();
+    CHECK(send(1, 3, 0, 1, &value) == ESP_ERR_TIMEOUT);
+    CHECK(elapsed_ms(start) < CONFIG_FMB_TCP_MASTER_CONNECT_TIMEOUT_MS);
+    // The other slaves are not affected
+    CHECK(send(2, 3, 0, 1, &value) == ESP_OK);
+    CHECK(value == 0x1000);
+}
+
+TEST_CASE("Scan plans read several slaves", "[tcp_master][scan]")
+{
+    SlaveTcp slave1;
+    SlaveTcp slave2;
+    Master master({ slave1.address(), slave2.address() });
+    slave2.holes.insert(12);    // In the gap of a joined range, the slave refuses the joined request
+    const mb_parameter_descriptor_t table[] = {
+        make_descriptor(0, "a", 1, MB_PARAM_HOLDING, 0, 2),
+        make_descriptor(1, "b", 1, MB_PARAM_HOLDING, 4, 1),
+        make_descriptor(2, "c", 1, MB_PARAM_INPUT, 7, 2),
+        make_descriptor(3, "d", 1, MB_PARAM_COIL, 13, 3),
+        make_descriptor(4, "e", 2, MB_PARAM_HOLDING, 10, 2),
+        make_descriptor(5, "f", 2, MB_PARAM_HOLDING, 13, 1),
+        make_descriptor(6, "g", 2, MB_PARAM_DISCRETE, 2, 9),
+        make_descriptor(7, "h", 2, MB_PARAM_HOLDING, 2, 1),
+    };
+    REQUIRE(mbc_master_set_descriptor(table, 8) == ESP_OK);
+    const uint16_t cids[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    mb_scan_plan_handle_t plan = NULL;
+    REQUIRE(mbc_master_scan_plan_create(cids, 8, 4, &plan) == ESP_OK);
+    CHECK(mbc_scan_plan_get_request_count(plan) < 8);
+
+    for (int round = 0; round < 2; round++) {
+        uint8_t buffers[8][4] = {};
+        uint8_t *values[8];
+        for (int i = 0; i < 8; i++) {
+            values[i] = buffers[i];
+        }
+        esp_err_t errors[8];
+        CHECK(mbc_master_scan(plan, values, errors) == ESP_OK);
+        for (int i = 0; i < 8; i++) {
+            CHECK(errors[i] == ESP_OK);
+            SlaveTcp &slave = (table[i].mb_slave_addr == 1) ? slave1 : slave2;
+            for (int k = 0; k < table[i].mb_size; k++) {
+                uint16_t reg = table[i].mb_reg_start + k;
+                uint16_t bit_index = table[i].mb_reg_start % 8 + k;
+                uint8_t bit = (buffers[i][bit_index / 8] >> (bit_index % 8)) & 1;
+                uint16_t reg_value = (k < 2) ? (buffers[i][2 * k] | (buffers[i][2 * k + 1] << 8)) : 0;
+                switch (table[i].mb_param_type) {
+                case MB_PARAM_HOLDING:
+                    CHECK(reg_value == slave.holding(reg));
+                    break;
+                case MB_PARAM_INPUT:
+                    CHECK(reg_value == slave.input(reg));
+                    break;
+                case MB_PARAM_COIL:
+                    CHECK(bit == slave.coil(reg));
+                    break;
+                default:
+                    CHECK(bit == slave.discrete(reg));
+                    break;
+                }
+            }
+        }
+    }
+    CHECK(mbc_master_scan_plan_delete(plan) == ESP_OK);
+}
+
+TEST_CASE("Pipelined scan compared to one request at a time", "[tcp_master][scan]")
+{
+    SlaveTcp slave;
+    Master master({ slave.address() });
+    slave.delay_ms = 5;
+
+    const int count = 40;
+    vector<mb_parameter_descriptor_t> table;
+    vector<uint16_t> cids;
+    for (int i = 0; i < count; i++) {
+        table.push_back(make_descriptor(i, "reg", 1, MB_PARAM_HOLDING, 10 * i, 1));
+        cids.push_back(i);
+    }
+    REQUIRE(mbc_master_set_descriptor(table.data(), count) == ESP_OK);
+    mb_scan_plan_handle_t plan = NULL;
+    REQUIRE(mbc_master_scan_plan_create(cids.data(), count, 0, &plan) == ESP_OK);
+    REQUIRE(mbc_scan_plan_get_request_count(plan) == count);
+
+    vector<uint16_t> buffers(count);
+    vector<uint8_t *> values;
+    for (auto &buffer : buffers) {
+        values.push_back((uint8_t *)&buffer);
+    }
+    auto start = chrono::steady_clock::now();
+    CHECK(mbc_scan_plan_execute(plan, master.iface->send_request, NULL, values.data(), NULL) == ESP_OK);
+    int64_t serial_ms = elapsed_ms(start);
+    start = chrono::steady_clock::now();
+    CHECK(mbc_master_scan(plan, values.data(), NULL) == ESP_OK);
+    int64_t pipelined_ms = elapsed_ms(start);
+    for (int i = 0; i < count; i++) {
+        CHECK(buffers[i] == 0x1000 + 10 * i);
+    }
+    printf("%d requests, %d ms response delay: %d ms one at a time, %d ms pipelined (%d outstanding)\n",
+           count, (int)slave.delay_ms, (int)serial_ms, (int)pipelined_ms, CONFIG_FMB_TCP_MASTER_MAX_PENDING);
+    CHECK(pipelined_ms * 2 < serial_ms);
+    CHECK(mbc_master_scan_plan_delete(plan) == ESP_OK);
+}
@@ -61,6 +61,16 @@
 #define IDF_PERFORMANCE_MIN_EVENT_DISPATCH_PSRAM                                21000
 #endif
 
+// inbound messages routed per second by the mqtt topic router, with thousands of filters registered
+#ifndef IDF_PERFORMANCE_MIN_MQTT_TOPIC_ROUTING
+#define IDF_PERFORMANCE_MIN_MQTT_TOPIC_ROUTING                                  20000
+#endif
+
+// websocket frames masked and framed by tcp_transport, MB/s
+#ifndef IDF_PERFORMANCE_MIN_WS_MASKING_THROUGHPUT_MBSEC
+#define IDF_PERFORMANCE_MIN_WS_MASKING_THROUGHPUT_MBSEC                         20
+#endif
+
 #ifndef IDF_PERFORMANCE_MAX_SPILL_REG_CYCLES
 #define IDF_PERFORMANCE_MAX_SPILL_REG_CYCLES                                    150
 #endif
@@ -969,6 +969,43 @@ netconn_send(struct netconn *conn, struct netbuf *buf)
   return err;
 }
 
+#if LWIP_SOCKET_MMSG
+/**
+ * @ingroup netconn_udp
+ * Send a batch of datagrams over a UDP or RAW netconn with a single call
+ * into the tcpip thread. Sending stops at the first datagram which can not
+ * be sent.
+ *
+ * @param conn the UDP or RAW netconn over which to send data
+ * @param bufs array of netbufs containing the data to send
+ * @param count number of netbufs in the array
+ * @param sent receives the number of netbufs sent
+ * @return ERR_OK if all the data was sent, the error of the first netbuf not
+ *         sent otherwise
+ */
+err_t
+netconn_send_batch(struct netconn *conn, struct netbuf *bufs, u16_t count, u16_t *sent)
+{
+  API_MSG_VAR_DECLARE(msg);
+  err_t err;
+
+  LWIP_ERROR("netconn_send_batch: invalid conn", (conn != NULL), return ERR_ARG;);
+  LWIP_ERROR("netconn_send_batch: invalid sent", (sent != NULL), return ERR_ARG;);
+
+  LWIP_DEBUGF(API_LIB_DEBUG, ("netconn_send_batch: sending %"U16_F" datagrams\n", count));
+
+  API_MSG_VAR_ALLOC(msg);
+  API_MSG_VAR_REF(msg).conn = conn;
+  API_MSG_VAR_REF(msg).msg.sb.bufs = bufs;
+  API_MSG_VAR_REF(msg).msg.sb.count = count;
+  err = netconn_apimsg(lwip_netconn_do_send_batch, &API_MSG_VAR_REF(msg));
+  *sent = API_MSG_VAR_REF(msg).msg.sb.sent;
+  API_MSG_VAR_FREE(msg);
+
+  return err;
+}
+#endif /* LWIP_SOCKET_MMSG */
+
 /**
  * @ingroup netconn_tcp
  * Send data over a TCP netconn.
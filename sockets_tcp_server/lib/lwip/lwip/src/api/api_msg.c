@@ -1578,6 +1578,52 @@ lwip_netconn_do_listen(void *m)
 }
 #endif /* LWIP_TCP */
 
+/* Send a netbuf on the RAW or UDP pcb of a netconn */
+static err_t
+lwip_netconn_send_netbuf(struct netconn *conn, struct netbuf *b)
+{
+  err_t err;
+
+  if (conn->pcb.tcp == NULL) {
+    return ERR_CONN;
+  }
+  switch (NETCONNTYPE_GROUP(conn->type)) {
+#if LWIP_RAW
+    case NETCONN_RAW:
+      if (ip_addr_isany(&b->addr) || IP_IS_ANY_TYPE_VAL(b->addr)) {
+        err = raw_send(conn->pcb.raw, b->p);
+      } else {
+        err = raw_sendto(conn->pcb.raw, b->p, &b->addr);
+      }
+      break;
+#endif
+#if LWIP_UDP
+    case NETCONN_UDP:
+#if LWIP_CHECKSUM_ON_COPY
+      if (ip_addr_isany(&b->addr) || IP_IS_ANY_TYPE_VAL(b->addr)) {
+        err = udp_send_chksum(conn->pcb.udp, b->p,
+                              b->flags & NETBUF_FLAG_CHKSUM, b->toport_chksum);
+      } else {
+        err = udp_sendto_chksum(conn->pcb.udp, b->p,
+                                &b->addr, b->port,
+                                b->flags & NETBUF_FLAG_CHKSUM, b->toport_chksum);
+      }
+#else /* LWIP_CHECKSUM_ON_COPY */
+      if (ip_addr_isany_val(b->addr) || IP_IS_ANY_TYPE_VAL(b->addr)) {
+        err = udp_send(conn->pcb.udp, b->p);
+      } else {
+        err = udp_sendto(conn->pcb.udp, b->p, &b->addr, b->port);
+      }
+#endif /* LWIP_CHECKSUM_ON_COPY */
+      break;
+#endif /* LWIP_UDP */
+    default:
+      err = ERR_CONN;
+      break;
+  }
+  return err;
+}
+
 /**
  * Send some data on a RAW or UDP pcb contained in a netconn
  * Called from netconn_send
@@ -1601,48 +1647,37 @@ lwip_netconn_do_send(void *m)
 #endif
 
   if (err == ERR_OK) {
-    if (msg->conn->pcb.tcp != NULL) {
-      switch (NETCONNTYPE_GROUP(msg->conn->type)) {
-#if LWIP_RAW
-        case NETCONN_RAW:
-          if (ip_addr_isany(&msg->msg.b->addr) || IP_IS_ANY_TYPE_VAL(msg->msg.b->addr)) {
-            err = raw_send(msg->conn->pcb.raw, msg->msg.b->p);
-          } else {
-            err = raw_sendto(msg->conn->pcb.raw, msg->msg.b->p, &msg->msg.b->addr);
-          }
-          break;
-#endif
-#if LWIP_UDP
-        case NETCONN_UDP:
-#if LWIP_CHECKSUM_ON_COPY
-          if (ip_addr_isany(&msg->msg.b->addr) || IP_IS_ANY_TYPE_VAL(msg->msg.b->addr)) {
-            err = udp_send_chksum(msg->conn->pcb.udp, msg->msg.b->p,
-                                  msg->msg.b->flags & NETBUF_FLAG_CHKSUM, msg->msg.b->toport_chksum);
-          } else {
-            err = udp_sendto_chksum(msg->conn->pcb.udp, msg->msg.b->p,
-                                    &msg->msg.b->addr, msg->msg.b->port,
-                                    msg->msg.b->flags & NETBUF_FLAG_CHKSUM, msg->msg.b->toport_chksum);
-          }
-#else /* LWIP_CHECKSUM_ON_COPY */
-          if (ip_addr_isany_val(msg->msg.b->addr) || IP_IS_ANY_TYPE_VAL(msg->msg.b->addr)) {
-            err = udp_send(msg->conn->pcb.udp, msg->msg.b->p);
-          } else {
-            err = udp_sendto(msg->conn->pcb.udp, msg->msg.b->p, &msg->msg.b->addr, msg->msg.b->port);
-          }
-#endif /* LWIP_CHECKSUM_ON_COPY */
-          break;
-#endif /* LWIP_UDP */
-        default:
-          err = ERR_CONN;
-          break;
-      }
-    } else {
-      err = ERR_CONN;
+    err = lwip_netconn_send_netbuf(msg->conn, msg->msg.b);
+  }
+  msg->err = err;
+  TCPIP_APIMSG_ACK(msg);
+}
+
+#if LWIP_SOCKET_MMSG
+/**
+ * Send a batch of netbufs on a RAW or UDP pcb contained in a netconn,
+ * stopping at the first one which can not be sent
+ * Called from netconn_send_batch
+ *
+ * @param m the api_msg pointing to the connection
+ */
+void
+lwip_netconn_do_send_batch(void *m)
+{
+  struct api_msg *msg = (struct api_msg *)m;
+  err_t err = netconn_err(msg->conn);
+
+  msg->msg.sb.sent = 0;
+  while ((err == ERR_OK) && (msg->msg.sb.sent < msg->msg.sb.count)) {
+    err = lwip_netconn_send_netbuf(msg->conn, &msg->msg.sb.bufs[msg->msg.sb.sent]);
+    if (err == ERR_OK) {
+      msg->msg.sb.sent++;
     }
   }
   msg->err = err;
   TCPIP_APIMSG_ACK(msg);
 }
+#endif /* LWIP_SOCKET_MMSG */
 
 #if LWIP_TCP
 /**
@@ -1333,6 +1333,26 @@ lwip_recv(int s, void *mem, size_t len, int flags)
   return lwip_recvfrom(s, mem, len, flags, NULL, NULL);
 }
 
+/* Helper function to check the receive vectors of a message.
+ * Returns their total length, or -1 if they are not valid.
+ */
+static ssize_t
+lwip_recvmsg_iov_len(const struct msghdr *message)
+{
+  ssize_t buflen = 0;
+  int i;
+
+  for (i = 0; i < message->msg_iovlen; i++) {
+    if ((message->msg_iov[i].iov_base == NULL) || ((ssize_t)message->msg_iov[i].iov_len <= 0) ||
+        ((size_t)(ssize_t)message->msg_iov[i].iov_len != message->msg_iov[i].iov_len) ||
+        ((ssize_t)(buflen + (ssize_t)message->msg_iov[i].iov_len) <= 0)) {
+      return -1;
+    }
+    buflen = (ssize_t)(buflen + (ssize_t)message->msg_iov[i].iov_len);
+  }
+  return buflen;
+}
+
 ssize_t
 lwip_recvmsg(int s, struct msghdr *message, int flags)
 {
@@ -1356,16 +1376,11 @@ lwip_recvmsg(int s, struct msghdr *message, int flags)
   }
 
   /* check for valid vectors */
-  buflen = 0;
-  for (i = 0; i < message->msg_iovlen; i++) {
-    if ((message->msg_iov[i].iov_base == NULL) || ((ssize_t)message->msg_iov[i].iov_len <= 0) ||
-        ((size_t)(ssize_t)message->msg_iov[i].iov_len != message->msg_iov[i].iov_len) ||
-        ((ssize_t)(buflen + (ssize_t)message->msg_iov[i].iov_len) <= 0)) {
-      sock_set_errno(sock, err_to_errno(ERR_VAL));
-      done_socket(sock);
-      return -1;
-    }
-    buflen = (ssize_t)(buflen + (ssize_t)message->msg_iov[i].iov_len);
+  buflen = lwip_recvmsg_iov_len(message);
+  if (buflen < 0) {
+    sock_set_errno(sock, err_to_errno(ERR_VAL));
+    done_socket(sock);
+    return -1;
   }
 
   if (NETCONNTYPE_GROUP(netconn_type(sock->conn)) == NETCONN_TCP) {
@@ -1434,6 +1449,282 @@ lwip_recvmsg(int s, struct msghdr *message, int flags)
 #endif /* LWIP_UDP || LWIP_RAW */
 }
 
+#if LWIP_SOCKET_MMSG
+/**
+ * @ingroup socket
+ * Receive up to 'vlen' datagrams with one call, like Linux recvmmsg()
+ * without its timeout argument (SO_RCVTIMEO applies to each wait).
+ * Unless MSG_DONTWAIT is given, waits for each datagram, or only for the
+ * first one with MSG_WAITFORONE.
+ *
+ * @return the number of datagrams received, with the number of bytes of
+ * each in its msg_len, or -1 if none was received (with errno set)
+ */
+int
+lwip_recvmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+  struct lwip_sock *sock;
+  unsigned int n;
+  int recv_flags = flags & MSG_DONTWAIT;
+  err_t err = ERR_OK;
+
+  LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_recvmmsg(%d, msgvec=%p, vlen=%u, flags=0x%x)\n", s, (void *)msgvec, vlen, flags));
+  LWIP_ERROR("lwip_recvmmsg: invalid msgvec", (msgvec != NULL) || (vlen == 0),
+             set_errno(EINVAL); return -1;);
+  LWIP_ERROR("lwip_recvmmsg: unsupported flags", (flags & ~(MSG_DONTWAIT | MSG_WAITFORONE)) == 0,
+             set_errno(EOPNOTSUPP); return -1;);
+
+  sock = get_socket(s);
+  if (!sock) {
+    return -1;
+  }
+  if (NETCONNTYPE_GROUP(netconn_type(sock->conn)) == NETCONN_TCP) {
+    sock_set_errno(sock, EOPNOTSUPP);
+    done_socket(sock);
+    return -1;
+  }
+
+#if LWIP_UDP || LWIP_RAW
+  for (n = 0; n < vlen; n++) {
+    struct msghdr *message = &msgvec[n].msg_hdr;
+    u16_t datagram_len = 0;
+    ssize_t buflen;
+
+    if ((message->msg_iovlen <= 0) || (message->msg_iovlen > IOV_MAX) ||
+        ((buflen = lwip_recvmsg_iov_len(message)) < 0)) {
+      err = ERR_VAL;
+      break;
+    }
+    err = lwip_recvfrom_udp_raw(sock, recv_flags, message, &datagram_len, s);
+    if (err != ERR_OK) {
+      break;
+    }
+    if (datagram_len > buflen) {
+      message->msg_flags |= MSG_TRUNC;
+      msgvec[n].msg_len = (unsigned int)buflen;
+    } else {
+      msgvec[n].msg_len = datagram_len;
+    }
+    if (flags & MSG_WAITFORONE) {
+      recv_flags |= MSG_DONTWAIT;
+    }
+  }
+#else /* LWIP_UDP || LWIP_RAW */
+  n = 0;
+  err = ERR_ARG;
+#endif /* LWIP_UDP || LWIP_RAW */
+
+  if ((n == 0) && (vlen > 0)) {
+    sock_set_errno(sock, err_to_errno(err));
+    done_socket(sock);
+    return -1;
+  }
+  sock_set_errno(sock, 0);
+  done_socket(sock);
+  return (int)n;
+}
+#endif /* LWIP_SOCKET_MMSG */
+
+#if LWIP_SOCKET_RECV_PBUF
+#if LWIP_TCP
+/* Helper function to detach the first 'len' bytes (less than p->tot_len) of a
+ * received chain into '*head'. Whole pbufs are moved, only the leading part of
+ * a pbuf crossing the boundary is copied. Returns the rest of the chain, or the
+ * unchanged chain with '*head' set to NULL if the copy can not be allocated.
+ */
+static struct pbuf *
+lwip_recv_pbuf_split(struct pbuf *p, u16_t len, struct pbuf **head)
+{
+  struct pbuf *q, *r, *last = NULL, *part = NULL;
+  u16_t off = 0;
+
+  LWIP_ASSERT("invalid split length", len < p->tot_len);
+
+  for (q = p; off + q->len <= len; q = q->next) {
+    off = (u16_t)(off + q->len);
+    last = q;
+  }
+  if (len > off) {
+    part = pbuf_alloc(PBUF_RAW, (u16_t)(len - off), PBUF_RAM);
+    if (part == NULL) {
+      *head = NULL;
+      return p;
+    }
+    MEMCPY(part->payload, q->payload, part->len);
+  }
+  if (last != NULL) {
+    last->next = NULL;
+    for (r = p; r != NULL; r = r->next) {
+      r->tot_len = (u16_t)(r->tot_len - q->tot_len);
+    }
+    if (part != NULL) {
+      pbuf_cat(p, part);
+    }
+    *head = p;
+  } else {
+    *head = part;
+  }
+  if (part != NULL) {
+    pbuf_remove_header(q, part->len);
+  }
+  return q;
+}
+
+/* Helper function to take up to "len" bytes of received pbufs from netconn
+ * without copying them. Keeps sock->lastdata for the part exceeding "len".
+ */
+static ssize_t
+lwip_recv_tcp_pbuf(struct lwip_sock *sock, struct pbuf **out, size_t len, int flags)
+{
+  u8_t apiflags = NETCONN_NOAUTORCVD;
+  struct pbuf *head = NULL;
+  u16_t recvd = 0;
+  u16_t recv_left = (u16_t)LWIP_MIN(len, 0xFFFF);
+
+  if (flags & MSG_DONTWAIT) {
+    apiflags |= NETCONN_DONTBLOCK;
+  }
+
+  while (recv_left > 0) {
+    struct pbuf *p;
+    err_t err;
+
+    if (sock->lastdata.pbuf) {
+      p = sock->lastdata.pbuf;
+    } else {
+      err = netconn_recv_tcp_pbuf_flags(sock->conn, &p, apiflags);
+      LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_recv_tcp_pbuf: netconn_recv err=%d, pbuf=%p\n",
+                                  err, (void *)p));
+      if (err != ERR_OK) {
+        if (recvd > 0) {
+          /* return what we have, the error is reported by the next call */
+          break;
+        }
+        sock_set_errno(sock, err_to_errno(err));
+        return (err == ERR_CLSD) ? 0 : -1;
+      }
+      LWIP_ASSERT("p != NULL", p != NULL);
+    }
+
+    if (p->tot_len > recv_left) {
+      struct pbuf *rest = lwip_recv_pbuf_split(p, recv_left, &p);
+      sock->lastdata.pbuf = rest;
+      if (p == NULL) {
+        if (recvd > 0) {
+          break;
+        }
+        sock_set_errno(sock, ENOMEM);
+        return -1;
+      }
+    } else {
+      sock->lastdata.pbuf = NULL;
+    }
+
+    recvd = (u16_t)(recvd + p->tot_len);
+    recv_left = (u16_t)(recv_left - p->tot_len);
+    if (head == NULL) {
+      head = p;
+    } else {
+      pbuf_cat(head, p);
+    }
+    /* once we have some data to return, only add more if we don't need to wait */
+    apiflags |= NETCONN_DONTBLOCK | NETCONN_NOFIN;
+  }
+
+  if (recvd > 0) {
+    /* the data is owned by the application now, update the window */
+    netconn_tcp_recvd(sock->conn, recvd);
+  }
+  *out = head;
+  sock_set_errno(sock, 0);
+  return recvd;
+}
+#endif /* LWIP_TCP */
+
+/**
+ * @ingroup socket
+ * Receive without copying: hands the received pbuf chain over to the caller,
+ * who walks it (p->payload, p->len, p->next) and releases it with pbuf_free().
+ * For stream sockets, up to 'len' bytes are returned; whole pbufs are handed
+ * over, only a pbuf crossing the 'len' boundary has its leading part copied.
+ * For datagram sockets, the whole datagram is returned regardless of 'len'.
+ * MSG_PEEK is not supported.
+ * The pbufs may hold driver receive buffers, so they should not be kept long.
+ *
+ * @return the number of bytes in '*p', 0 on connection close (with '*p' set
+ * to NULL) or -1 on error (with errno set)
+ */
+ssize_t
+lwip_recvfrom_pbuf(int s, struct pbuf **p, size_t len, int flags,
+                   struct sockaddr *from, socklen_t *fromlen)
+{
+  struct lwip_sock *sock;
+  ssize_t ret;
+
+  LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_recvfrom_pbuf(%d, %"SZT_F", 0x%x, ..)\n", s, len, flags));
+  LWIP_ERROR("lwip_recvfrom_pbuf: invalid pbuf pointer", p != NULL, set_errno(EINVAL); return -1;);
+  LWIP_ERROR("lwip_recvfrom_pbuf: unsupported flags", (flags & ~MSG_DONTWAIT) == 0,
+             set_errno(EOPNOTSUPP); return -1;);
+  *p = NULL;
+
+  sock = get_socket(s);
+  if (!sock) {
+    return -1;
+  }
+#if LWIP_TCP
+  if (NETCONNTYPE_GROUP(netconn_type(sock->conn)) == NETCONN_TCP) {
+    ret = lwip_recv_tcp_pbuf(sock, p, len, flags);
+    lwip_recv_tcp_from(sock, from, fromlen, "lwip_recvfrom_pbuf", s, ret);
+    done_socket(sock);
+    return ret;
+  }
+#endif /* LWIP_TCP */
+#if LWIP_UDP || LWIP_RAW
+  LWIP_UNUSED_ARG(len);
+  {
+    struct netbuf *buf = sock->lastdata.netbuf;
+    if (buf == NULL) {
+      err_t err = netconn_recv_udp_raw_netbuf_flags(sock->conn, &buf,
+                                                    (flags & MSG_DONTWAIT) ? NETCONN_DONTBLOCK : 0);
+      if (err != ERR_OK) {
+        sock_set_errno(sock, err_to_errno(err));
+        done_socket(sock);
+        return -1;
+      }
+    }
+    sock->lastdata.netbuf = NULL;
+    if (from && fromlen) {
+      lwip_sock_make_addr(sock->conn, netbuf_fromaddr(buf), netbuf_fromport(buf), from, fromlen);
+    }
+    *p = buf->p;
+    buf->p = NULL;
+    netbuf_delete(buf);
+    ret = (*p)->tot_len;
+  }
+#else /* LWIP_UDP || LWIP_RAW */
+  LWIP_UNUSED_ARG(from);
+  LWIP_UNUSED_ARG(fromlen);
+  sock_set_errno(sock, err_to_errno(ERR_ARG));
+  done_socket(sock);
+  return -1;
+#endif /* LWIP_UDP || LWIP_RAW */
+
+  sock_set_errno(sock, 0);
+  done_socket(sock);
+  return ret;
+}
+
+/**
+ * @ingroup socket
+ * Same as lwip_recvfrom_pbuf() without the source address.
+ */
+ssize_t
+lwip_recv_pbuf(int s, struct pbuf **p, size_t len, int flags)
+{
+  return lwip_recvfrom_pbuf(s, p, len, flags, NULL, NULL);
+}
+#endif /* LWIP_SOCKET_RECV_PBUF */
+
 ssize_t
 lwip_send(int s, const void *data, size_t size, int flags)
 {
@@ -1474,6 +1765,116 @@ lwip_send(int s, const void *data, size_t size, int flags)
   return (err == ERR_OK ? (ssize_t)written : -1);
 }
 
+#if LWIP_UDP || LWIP_RAW
+/* Helper function to build the netbuf of a datagram from a msghdr.
+ * Returns 0 or an errno value, chain_buf has to be freed in any case.
+ */
+static int
+lwip_sendmsg_netbuf(const struct msghdr *msg, struct netbuf *chain_buf, ssize_t *datagram_len)
+{
+  err_t err = ERR_OK;
+  int i;
+  ssize_t size = 0;
+
+  /* initialize chain buffer with destination */
+  memset(chain_buf, 0, sizeof(struct netbuf));
+  if (msg->msg_name) {
+    u16_t remote_port;
+    SOCKADDR_TO_IPADDR_PORT((const struct sockaddr *)msg->msg_name, &chain_buf->addr, remote_port);
+    netbuf_fromport(chain_buf) = remote_port;
+  }
+#if LWIP_NETIF_TX_SINGLE_PBUF
+  for (i = 0; i < msg->msg_iovlen; i++) {
+    size += msg->msg_iov[i].iov_len;
+    if ((msg->msg_iov[i].iov_len > INT_MAX) || (size < (int)msg->msg_iov[i].iov_len)) {
+      /* overflow */
+      return EMSGSIZE;
+    }
+  }
+  if (size > 0xFFFF) {
+    /* overflow */
+    return EMSGSIZE;
+  }
+  /* Allocate a new netbuf and copy the data into it. */
+  if (netbuf_alloc(chain_buf, (u16_t)size) == NULL) {
+    err = ERR_MEM;
+  } else {
+    /* flatten the IO vectors */
+    size_t offset = 0;
+#if LWIP_CHECKSUM_ON_COPY
+    u32_t acc = 0;
+#endif /* LWIP_CHECKSUM_ON_COPY */
+    for (i = 0; i < msg->msg_iovlen; i++) {
+#if LWIP_CHECKSUM_ON_COPY
+      /* checksum each IO vector while copying it and aggregate the sums */
+      u16_t chksum = LWIP_CHKSUM_COPY(&((u8_t *)chain_buf->p->payload)[offset], msg->msg_iov[i].iov_base,
+                                      (u16_t)msg->msg_iov[i].iov_len);
+      if (offset & 1) {
+        /* a vector starting at an odd offset is summed with swapped bytes */
+        chksum = (u16_t)(SWAP_BYTES_IN_WORD(chksum));
+      }
+      acc += chksum;
+      acc = FOLD_U32T(acc);
+#else /* LWIP_CHECKSUM_ON_COPY */
+      MEMCPY(&((u8_t *)chain_buf->p->payload)[offset], msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len);
+#endif /* LWIP_CHECKSUM_ON_COPY */
+      offset += msg->msg_iov[i].iov_len;
+    }
+#if LWIP_CHECKSUM_ON_COPY
+    acc = FOLD_U32T(acc);
+    netbuf_set_chksum(chain_buf, (u16_t)acc);
+#endif /* LWIP_CHECKSUM_ON_COPY */
+    err = ERR_OK;
+  }
+#else /* LWIP_NETIF_TX_SINGLE_PBUF */
+  /* create a chained netbuf from the IO vectors. NOTE: we assemble a pbuf chain
+     manually to avoid having to allocate, chain, and delete a netbuf for each iov */
+  for (i = 0; i < msg->msg_iovlen; i++) {
+    struct pbuf *p;
+    if (msg->msg_iov[i].iov_len > 0xFFFF) {
+      /* overflow */
+      return EMSGSIZE;
+    }
+    p = pbuf_alloc(PBUF_TRANSPORT, 0, PBUF_REF);
+    if (p == NULL) {
+      err = ERR_MEM; /* let netbuf_delete() cleanup chain_buf */
+      break;
+    }
+    p->payload = msg->msg_iov[i].iov_base;
+    p->len = p->tot_len = (u16_t)msg->msg_iov[i].iov_len;
+    /* netbuf empty, add new pbuf */
+    if (chain_buf->p == NULL) {
+      chain_buf->p = chain_buf->ptr = p;
+      /* add pbuf to existing pbuf chain */
+    } else {
+      if (chain_buf->p->tot_len + p->len > 0xffff) {
+        /* overflow */
+        pbuf_free(p);
+        return EMSGSIZE;
+      }
+      pbuf_cat(chain_buf->p, p);
+    }
+  }
+  /* save size of total chain */
+  if (err == ERR_OK) {
+    size = netbuf_len(chain_buf);
+  }
+#endif /* LWIP_NETIF_TX_SINGLE_PBUF */
+
+  if (err == ERR_OK) {
+#if LWIP_IPV4 && LWIP_IPV6
+    /* Dual-stack: Unmap IPv4 mapped IPv6 addresses */
+    if (IP_IS_V6_VAL(chain_buf->addr) && ip6_addr_isipv4mappedipv6(ip_2_ip6(&chain_buf->addr))) {
+      unmap_ipv4_mapped_ipv6(ip_2_ip4(&chain_buf->addr), ip_2_ip6(&chain_buf->addr));
+      IP_SET_TYPE_VAL(chain_buf->addr, IPADDR_TYPE_V4);
+    }
+#endif /* LWIP_IPV4 && LWIP_IPV6 */
+    *datagram_len = size;
+  }
+  return err_to_errno(err);
+}
+#endif /* LWIP_UDP || LWIP_RAW */
+
 ssize_t
 lwip_sendmsg(int s, const struct msghdr *msg, int flags)
 {
@@ -1524,118 +1925,130 @@ lwip_sendmsg(int s, const struct msghdr *msg, int flags)
 #if LWIP_UDP || LWIP_RAW
   {
     struct netbuf chain_buf;
-    int i;
     ssize_t size = 0;
+    int errval;
 
     LWIP_UNUSED_ARG(flags);
     LWIP_ERROR("lwip_sendmsg: invalid msghdr name", (((msg->msg_name == NULL) && (msg->msg_namelen == 0)) ||
                IS_SOCK_ADDR_LEN_VALID(msg->msg_namelen)),
                sock_set_errno(sock, err_to_errno(ERR_ARG)); done_socket(sock); return -1;);
 
-    /* initialize chain buffer with destination */
-    memset(&chain_buf, 0, sizeof(struct netbuf));
-    if (msg->msg_name) {
-      u16_t remote_port;
-      SOCKADDR_TO_IPADDR_PORT((const struct sockaddr *)msg->msg_name, &chain_buf.addr, remote_port);
-      netbuf_fromport(&chain_buf) = remote_port;
-    }
-#if LWIP_NETIF_TX_SINGLE_PBUF
-    for (i = 0; i < msg->msg_iovlen; i++) {
-      size += msg->msg_iov[i].iov_len;
-      if ((msg->msg_iov[i].iov_len > INT_MAX) || (size < (int)msg->msg_iov[i].iov_len)) {
-        /* overflow */
-        goto sendmsg_emsgsize;
-      }
-    }
-    if (size > 0xFFFF) {
-      /* overflow */
-      goto sendmsg_emsgsize;
+    errval = lwip_sendmsg_netbuf(msg, &chain_buf, &size);
+    if (errval == 0) {
+      /* send the data */
+      err = netconn_send(sock->conn, &chain_buf);
+      errval = err_to_errno(err);
     }
-    /* Allocate a new netbuf and copy the data into it. */
-    if (netbuf_alloc(&chain_buf, (u16_t)size) == NULL) {
-      err = ERR_MEM;
-    } else {
-      /* flatten the IO vectors */
-      size_t offset = 0;
-      for (i = 0; i < msg->msg_iovlen; i++) {
-        MEMCPY(&((u8_t *)chain_buf.p->payload)[offset], msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len);
-        offset += msg->msg_iov[i].iov_len;
-      }
-#if LWIP_CHECKSUM_ON_COPY
-      {
-        /* This can be improved by using LWIP_CHKSUM_COPY() and aggregating the checksum for each IO vector */
-        u16_t chksum = ~inet_chksum_pbuf(chain_buf.p);
-        netbuf_set_chksum(&chain_buf, chksum);
+
+    /* deallocated the buffer */
+    netbuf_free(&chain_buf);
+
+    sock_set_errno(sock, errval);
+    done_socket(sock);
+    return (errval == 0 ? size : -1);
+  }
+#else /* LWIP_UDP || LWIP_RAW */
+  sock_set_errno(sock, err_to_errno(ERR_ARG));
+  done_socket(sock);
+  return -1;
+#endif /* LWIP_UDP || LWIP_RAW */
+}
+
+#if LWIP_SOCKET_MMSG
+/**
+ * @ingroup socket
+ * Send up to 'vlen' messages with one call, like Linux sendmmsg(). The
+ * datagrams are passed to the tcpip thread in batches of up to
+ * LWIP_SOCKET_MMSG_BATCH with netconn_send_batch(), instead of with one
+ * message each. Messages of stream sockets are sent one by one.
+ *
+ * @return the number of messages sent, with the number of bytes of each
+ * in its msg_len, or -1 if none was sent (with errno set)
+ */
+int
+lwip_sendmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+  struct lwip_sock *sock;
+  unsigned int n = 0;
+  int errval = 0;
+
+  LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_sendmmsg(%d, msgvec=%p, vlen=%u, flags=0x%x)\n", s, (void *)msgvec, vlen, flags));
+  LWIP_ERROR("lwip_sendmmsg: invalid msgvec", (msgvec != NULL) || (vlen == 0),
+             set_errno(EINVAL); return -1;);
+  LWIP_ERROR("lwip_sendmmsg: unsupported flags", (flags & ~(MSG_DONTWAIT | MSG_MORE)) == 0,
+             set_errno(EOPNOTSUPP); return -1;);
+
+  sock = get_socket(s);
+  if (!sock) {
+    return -1;
+  }
+
+  if (NETCONNTYPE_GROUP(netconn_type(sock->conn)) == NETCONN_TCP) {
+    done_socket(sock);
+    for (n = 0; n < vlen; n++) {
+      ssize_t ret = lwip_sendmsg(s, &msgvec[n].msg_hdr, flags);
+      if (ret < 0) {
+        return (n > 0) ? (int)n : -1;
       }
-#endif /* LWIP_CHECKSUM_ON_COPY */
-      err = ERR_OK;
+      msgvec[n].msg_len = (unsigned int)ret;
     }
-#else /* LWIP_NETIF_TX_SINGLE_PBUF */
-    /* create a chained netbuf from the IO vectors. NOTE: we assemble a pbuf chain
-       manually to avoid having to allocate, chain, and delete a netbuf for each iov */
-    for (i = 0; i < msg->msg_iovlen; i++) {
-      struct pbuf *p;
-      if (msg->msg_iov[i].iov_len > 0xFFFF) {
-        /* overflow */
-        goto sendmsg_emsgsize;
+    return (int)n;
+  }
+
+#if LWIP_UDP || LWIP_RAW
+  while ((n < vlen) && (errval == 0)) {
+    struct netbuf bufs[LWIP_SOCKET_MMSG_BATCH];
+    u16_t count = 0;
+    u16_t sent = 0;
+    u16_t i;
+
+    /* build the netbufs of the next batch */
+    while ((count < LWIP_SOCKET_MMSG_BATCH) && (n + count < vlen)) {
+      const struct msghdr *msg = &msgvec[n + count].msg_hdr;
+      ssize_t size = 0;
+
+      if ((msg->msg_iov == NULL) || (msg->msg_iovlen <= 0) || (msg->msg_iovlen > IOV_MAX)) {
+        errval = EMSGSIZE;
+        break;
       }
-      p = pbuf_alloc(PBUF_TRANSPORT, 0, PBUF_REF);
-      if (p == NULL) {
-        err = ERR_MEM; /* let netbuf_delete() cleanup chain_buf */
+      if (!(((msg->msg_name == NULL) && (msg->msg_namelen == 0)) || IS_SOCK_ADDR_LEN_VALID(msg->msg_namelen))) {
+        errval = err_to_errno(ERR_ARG);
         break;
       }
-      p->payload = msg->msg_iov[i].iov_base;
-      p->len = p->tot_len = (u16_t)msg->msg_iov[i].iov_len;
-      /* netbuf empty, add new pbuf */
-      if (chain_buf.p == NULL) {
-        chain_buf.p = chain_buf.ptr = p;
-        /* add pbuf to existing pbuf chain */
-      } else {
-        if (chain_buf.p->tot_len + p->len > 0xffff) {
-          /* overflow */
-          pbuf_free(p);
-          goto sendmsg_emsgsize;
-        }
-        pbuf_cat(chain_buf.p, p);
+      errval = lwip_sendmsg_netbuf(msg, &bufs[count], &size);
+      if (errval != 0) {
+        netbuf_free(&bufs[count]);
+        break;
       }
+      msgvec[n + count].msg_len = (unsigned int)size;
+      count++;
     }
-    /* save size of total chain */
-    if (err == ERR_OK) {
-      size = netbuf_len(&chain_buf);
-    }
-#endif /* LWIP_NETIF_TX_SINGLE_PBUF */
 
-    if (err == ERR_OK) {
-#if LWIP_IPV4 && LWIP_IPV6
-      /* Dual-stack: Unmap IPv4 mapped IPv6 addresses */
-      if (IP_IS_V6_VAL(chain_buf.addr) && ip6_addr_isipv4mappedipv6(ip_2_ip6(&chain_buf.addr))) {
-        unmap_ipv4_mapped_ipv6(ip_2_ip4(&chain_buf.addr), ip_2_ip6(&chain_buf.addr));
-        IP_SET_TYPE_VAL(chain_buf.addr, IPADDR_TYPE_V4);
+    if (count > 0) {
+      err_t err = netconn_send_batch(sock->conn, bufs, count, &sent);
+      if (err != ERR_OK) {
+        errval = err_to_errno(err);
       }
-#endif /* LWIP_IPV4 && LWIP_IPV6 */
-
-      /* send the data */
-      err = netconn_send(sock->conn, &chain_buf);
+      for (i = 0; i < count; i++) {
+        netbuf_free(&bufs[i]);
+      }
+      n += sent;
     }
+  }
+#else /* LWIP_UDP || LWIP_RAW */
+  errval = err_to_errno(ERR_ARG);
+#endif /* LWIP_UDP || LWIP_RAW */
 
-    /* deallocated the buffer */
-    netbuf_free(&chain_buf);
-
-    sock_set_errno(sock, err_to_errno(err));
-    done_socket(sock);
-    return (err == ERR_OK ? size : -1);
-sendmsg_emsgsize:
-    sock_set_errno(sock, EMSGSIZE);
-    netbuf_free(&chain_buf);
+  if ((n == 0) && (vlen > 0)) {
+    sock_set_errno(sock, errval);
     done_socket(sock);
     return -1;
   }
-#else /* LWIP_UDP || LWIP_RAW */
-  sock_set_errno(sock, err_to_errno(ERR_ARG));
+  sock_set_errno(sock, 0);
   done_socket(sock);
-  return -1;
-#endif /* LWIP_UDP || LWIP_RAW */
+  return (int)n;
 }
+#endif /* LWIP_SOCKET_MMSG */
 
 ssize_t
 lwip_sendto(int s, const void *data, size_t size, int flags,
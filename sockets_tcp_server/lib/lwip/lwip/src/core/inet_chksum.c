@@ -255,6 +255,159 @@ lwip_standard_chksum(const void *dataptr, int len)
 }
 #endif
 
+#if (LWIP_CHKSUM_ALGORITHM == 4) || (LWIP_CHKSUM_COPY_ALGORITHM == 2)
+/** LWIP_CHKSUM_ACC64==1: sum 32-bit words into a 64-bit accumulator (fast on
+ * 64-bit hosts). Otherwise, the 16-bit halves of each word are added to a 32-bit
+ * accumulator, which needs no carry handling on CPUs without a carry flag. */
+#ifndef LWIP_CHKSUM_ACC64
+# if defined(UINTPTR_MAX) && (UINTPTR_MAX > 0xffffffffUL)
+#  define LWIP_CHKSUM_ACC64 1
+# else
+#  define LWIP_CHKSUM_ACC64 0
+# endif
+#endif
+
+#if LWIP_CHKSUM_ACC64
+typedef u64_t chksum_acc_t;
+#define CHKSUM_ADD_WORD(acc, w)  (acc) += (w)
+/* no overflow for less than 2^32 words */
+#define CHKSUM_BLOCK_WORDS       0x4000
+#define CHKSUM_FOLD_ACC(acc)     (u32_t)(((acc) & 0xffffU) + (((acc) >> 16) & 0xffffU) + \
+                                         (((acc) >> 32) & 0xffffU) + ((acc) >> 48))
+#else
+typedef u32_t chksum_acc_t;
+#define CHKSUM_ADD_WORD(acc, w)  (acc) += ((w) & 0xffffU) + ((w) >> 16)
+/* each word adds up to 0x1fffe: fold at least every 32k words */
+#define CHKSUM_BLOCK_WORDS       0x4000
+#define CHKSUM_FOLD_ACC(acc)     FOLD_U32T(acc)
+#endif
+
+/** Sum (and copy if dst != NULL) 32-bit aligned words, 8 at a time.
+ * @return native order 32-bit sum of the 16-bit halves of the words, not folded */
+static u32_t
+chksum_words(u32_t *dst, const u32_t *src, int words)
+{
+  u32_t sum = 0;
+
+  while (words > 0) {
+    chksum_acc_t acc = 0;
+    int block = LWIP_MIN(words, CHKSUM_BLOCK_WORDS);
+    words -= block;
+    if (dst == NULL) {
+      for (; block >= 8; block -= 8, src += 8) {
+        CHKSUM_ADD_WORD(acc, src[0]);
+        CHKSUM_ADD_WORD(acc, src[1]);
+        CHKSUM_ADD_WORD(acc, src[2]);
+        CHKSUM_ADD_WORD(acc, src[3]);
+        CHKSUM_ADD_WORD(acc, src[4]);
+        CHKSUM_ADD_WORD(acc, src[5]);
+        CHKSUM_ADD_WORD(acc, src[6]);
+        CHKSUM_ADD_WORD(acc, src[7]);
+      }
+      for (; block > 0; block--) {
+        CHKSUM_ADD_WORD(acc, *src);
+        src++;
+      }
+    } else {
+      for (; block >= 8; block -= 8, src += 8, dst += 8) {
+        u32_t w0 = src[0], w1 = src[1], w2 = src[2], w3 = src[3];
+        u32_t w4 = src[4], w5 = src[5], w6 = src[6], w7 = src[7];
+        dst[0] = w0;
+        dst[1] = w1;
+        dst[2] = w2;
+        dst[3] = w3;
+        dst[4] = w4;
+        dst[5] = w5;
+        dst[6] = w6;
+        dst[7] = w7;
+        CHKSUM_ADD_WORD(acc, w0);
+        CHKSUM_ADD_WORD(acc, w1);
+        CHKSUM_ADD_WORD(acc, w2);
+        CHKSUM_ADD_WORD(acc, w3);
+        CHKSUM_ADD_WORD(acc, w4);
+        CHKSUM_ADD_WORD(acc, w5);
+        CHKSUM_ADD_WORD(acc, w6);
+        CHKSUM_ADD_WORD(acc, w7);
+      }
+      for (; block > 0; block--) {
+        u32_t w = *src++;
+        *dst++ = w;
+        CHKSUM_ADD_WORD(acc, w);
+      }
+    }
+    sum += CHKSUM_FOLD_ACC(acc);
+  }
+  return sum;
+}
+#endif /* (LWIP_CHKSUM_ALGORITHM == 4) || (LWIP_CHKSUM_COPY_ALGORITHM == 2) */
+
+#if (LWIP_CHKSUM_ALGORITHM == 4) /* Alternative version #4 */
+/**
+ * Checksum a word at a time: after aligning to 32 bits, the inner loop sums
+ * 32 bytes per iteration without carry checks (see LWIP_CHKSUM_ACC64), the
+ * accumulator being folded once per 64k bytes only.
+ *
+ * @param dataptr points to start of data to be summed at any boundary
+ * @param len length of data to be summed
+ * @return host order (!) lwip checksum (non-inverted Internet sum)
+ */
+u16_t
+lwip_standard_chksum(const void *dataptr, int len)
+{
+  const u8_t *pb = (const u8_t *)dataptr;
+  const u16_t *ps;
+  u16_t t = 0;
+  u32_t sum = 0;
+  int words;
+  /* starts at odd byte address? */
+  int odd = ((mem_ptr_t)pb & 1);
+
+  if (odd && len > 0) {
+    ((u8_t *)&t)[1] = *pb++;
+    len--;
+  }
+
+  ps = (const u16_t *)(const void *)pb;
+
+  if (((mem_ptr_t)ps & 3) && len > 1) {
+    sum += *ps++;
+    len -= 2;
+  }
+
+  words = len >> 2;
+  sum += chksum_words(NULL, (const u32_t *)(const void *)ps, words);
+  ps += words * 2;
+  len -= words * 4;
+
+  /* make room in upper bits */
+  sum = FOLD_U32T(sum);
+
+  /* 16-bit aligned word remaining? */
+  if (len > 1) {
+    sum += *ps++;
+    len -= 2;
+  }
+
+  /* dangling tail byte remaining? */
+  if (len > 0) {                /* include odd byte */
+    ((u8_t *)&t)[0] = *(const u8_t *)ps;
+  }
+
+  sum += t;                     /* add end bytes */
+
+  /* Fold 32-bit sum to 16 bits
+     calling this twice is probably faster than if statements... */
+  sum = FOLD_U32T(sum);
+  sum = FOLD_U32T(sum);
+
+  if (odd) {
+    sum = SWAP_BYTES_IN_WORD(sum);
+  }
+
+  return (u16_t)sum;
+}
+#endif
+
 /** Parts of the pseudo checksum which are common to IPv4 and IPv6 */
 static u16_t
 inet_cksum_pseudo_base(struct pbuf *p, u8_t proto, u16_t proto_len, u32_t acc)
@@ -606,3 +759,44 @@ lwip_chksum_copy(void *dst, const void *src, u16_t len)
   return LWIP_CHKSUM(dst, len);
 }
 #endif /* (LWIP_CHKSUM_COPY_ALGORITHM == 1) */
+
+#if (LWIP_CHKSUM_COPY_ALGORITHM == 2) /* Version #2 */
+/** Fused: the checksum is added up while copying, a word at a time, so the
+ * data is only read once. Falls back to version #1 for short buffers and if
+ * src and dst are not equally aligned (which would need unaligned accesses).
+ */
+u16_t
+lwip_chksum_copy(void *dst, const void *src, u16_t len)
+{
+  u8_t *pd = (u8_t *)dst;
+  const u8_t *ps = (const u8_t *)src;
+  u16_t head, words, tail, chksum;
+  u32_t acc, sum;
+
+  if ((len < 16) || ((((mem_ptr_t)pd ^ (mem_ptr_t)ps) & 3) != 0)) {
+    MEMCPY(dst, src, len);
+    return LWIP_CHKSUM(dst, len);
+  }
+
+  /* copy up to the first aligned word */
+  head = (u16_t)((4 - ((mem_ptr_t)ps & 3)) & 3);
+  MEMCPY(pd, ps, head);
+  acc = LWIP_CHKSUM(pd, head);
+
+  words = (u16_t)((len - head) >> 2);
+  sum = chksum_words((u32_t *)(void *)(pd + head), (const u32_t *)(const void *)(ps + head), words);
+  sum = FOLD_U32T(sum);
+  chksum = (u16_t)FOLD_U32T(sum);
+  tail = (u16_t)(head + words * 4);
+  /* words and tail are summed from an odd offset if the head is 1 or 3 bytes */
+  acc += (head & 1) ? (u32_t)SWAP_BYTES_IN_WORD(chksum) : chksum;
+
+  MEMCPY(pd + tail, ps + tail, len - tail);
+  chksum = LWIP_CHKSUM(pd + tail, len - tail);
+  acc += (head & 1) ? (u32_t)SWAP_BYTES_IN_WORD(chksum) : chksum;
+
+  acc = FOLD_U32T(acc);
+  acc = FOLD_U32T(acc);
+  return (u16_t)acc;
+}
+#endif /* (LWIP_CHKSUM_COPY_ALGORITHM == 2) */
@@ -169,6 +169,9 @@ PACK_STRUCT_END
 #if (LWIP_TCP && LWIP_TCP_SACK_OUT && (LWIP_TCP_MAX_SACK_NUM < 1))
 #error "LWIP_TCP_MAX_SACK_NUM must be greater than 0"
 #endif
+#if (LWIP_TCP && LWIP_TCP_SACK_IN && !LWIP_TCP_SACK_OUT)
+#error "To use LWIP_TCP_SACK_IN, LWIP_TCP_SACK_OUT needs to be enabled (SACK is negotiated with it)"
+#endif
 #if (LWIP_NETIF_API && (NO_SYS==1))
 #error "If you want to use NETIF API, you have to define NO_SYS=0 in your lwipopts.h"
 #endif
@@ -76,6 +76,7 @@
 #include "lwip/mld6.h"
 
 #define LWIP_MEMPOOL(name,num,size,desc) LWIP_MEMPOOL_DECLARE(name,num,size,desc)
+#define LWIP_MEMPOOL_RESERVED(name,num,reserved,size,desc) LWIP_MEMPOOL_DECLARE_RESERVED(name,num,reserved,size,desc)
 #include "lwip/priv/memp_std.h"
 
 const struct memp_desc *const memp_pools[MEMP_MAX] = {
@@ -93,6 +94,88 @@ const struct memp_desc *const memp_pools[MEMP_MAX] = {
 #define MEMP_OVERFLOW_CHECK 1
 #endif
 
+#if MEMP_MEM_MALLOC && !MEMP_STATS
+/* With MEMP_MEM_MALLOC, the protection is only needed for the stats */
+#define MEMP_DECL_PROTECT(lev)
+#define MEMP_PROTECT(lev)
+#define MEMP_UNPROTECT(lev)
+#else
+#define MEMP_DECL_PROTECT(lev)  SYS_ARCH_DECL_PROTECT(lev)
+#define MEMP_PROTECT(lev)       SYS_ARCH_PROTECT(lev)
+#define MEMP_UNPROTECT(lev)     SYS_ARCH_UNPROTECT(lev)
+#endif
+
+#if MEMP_MEM_MALLOC_RESERVE
+/* Index terminating the free lists of reserved elements */
+#define MEMP_RESERVE_END        0xffffU
+/* Incremented tag of a free list head */
+#define MEMP_RESERVE_TAG(head)  (((head) & 0xffff0000UL) + 0x10000UL)
+
+static struct memp *
+memp_reserve_element(const struct memp_desc *desc, u16_t idx)
+{
+  /* cast through void* to get rid of alignment warnings */
+  return (struct memp *)(void *)((u8_t *)LWIP_MEM_ALIGN(desc->base) + (size_t)idx * (MEMP_SIZE + desc->size
+#if MEMP_OVERFLOW_CHECK
+                                 + MEM_SANITY_REGION_AFTER_ALIGNED
+#endif
+                                                                                  ));
+}
+
+/* A free reserved element stores the index of the next one where its data goes */
+#define memp_reserve_link(memp) ((u16_t *)(void *)((u8_t *)(memp) + MEMP_SIZE))
+
+/**
+ * Take a free element out of the reserve of a pool, lock-free.
+ * Elements are static: reading the link of one which was just taken by
+ * another thread is harmless, the tag makes the exchange fail.
+ */
+static struct memp *
+memp_reserve_pop(const struct memp_desc *desc)
+{
+  u32_t head, next;
+  u16_t idx;
+
+  if (desc->reserve == NULL) {
+    return NULL;
+  }
+  head = __atomic_load_n(desc->reserve, __ATOMIC_ACQUIRE);
+  do {
+    idx = (u16_t)(head & 0xffffU);
+    if (idx == MEMP_RESERVE_END) {
+      return NULL;
+    }
+    next = MEMP_RESERVE_TAG(head) | *memp_reserve_link(memp_reserve_element(desc, idx));
+  } while (!MEMP_RESERVE_CAS(desc->reserve, &head, next));
+  return memp_reserve_element(desc, idx);
+}
+
+/**
+ * Put an element back to the reserve of its pool if it comes from there.
+ * @return 1 if it did, 0 if the element was allocated by mem_malloc()
+ */
+static int
+memp_reserve_push(const struct memp_desc *desc, struct memp *memp)
+{
+  u32_t head, next;
+  u8_t *base = (u8_t *)LWIP_MEM_ALIGN(desc->base);
+  u16_t idx;
+
+  if ((desc->reserve == NULL) || ((u8_t *)memp < base) ||
+      ((u8_t *)memp >= (u8_t *)memp_reserve_element(desc, desc->num))) {
+    return 0;
+  }
+  idx = (u16_t)(((u8_t *)memp - base) / ((u8_t *)memp_reserve_element(desc, 1) - base));
+  LWIP_ASSERT("memp_free: reserved element properly aligned", memp_reserve_element(desc, idx) == memp);
+  head = __atomic_load_n(desc->reserve, __ATOMIC_ACQUIRE);
+  do {
+    *memp_reserve_link(memp) = (u16_t)(head & 0xffffU);
+    next = MEMP_RESERVE_TAG(head) | idx;
+  } while (!MEMP_RESERVE_CAS(desc->reserve, &head, next));
+  return 1;
+}
+#endif /* MEMP_MEM_MALLOC_RESERVE */
+
 #if MEMP_SANITY_CHECK && !MEMP_MEM_MALLOC
 /**
  * Check that memp-lists don't form a circle, using "Floyd's cycle-finding algorithm".
@@ -174,7 +257,25 @@ memp_overflow_check_all(void)
 void
 memp_init_pool(const struct memp_desc *desc)
 {
-#if MEMP_MEM_MALLOC
+#if MEMP_MEM_MALLOC_RESERVE
+  if (desc->reserve != NULL) {
+    u16_t i;
+
+    LWIP_ASSERT("memp_init_pool: too many reserved elements", desc->num < MEMP_RESERVE_END);
+    /* chain the reserved elements in order, the first one on top */
+    for (i = 0; i < desc->num; ++i) {
+      struct memp *memp = memp_reserve_element(desc, i);
+      *memp_reserve_link(memp) = (u16_t)((i + 1 < desc->num) ? (i + 1) : MEMP_RESERVE_END);
+#if MEMP_OVERFLOW_CHECK
+      memp_overflow_init_element(memp, desc);
+#endif /* MEMP_OVERFLOW_CHECK */
+    }
+    *desc->reserve = (desc->num > 0) ? 0 : MEMP_RESERVE_END;
+  }
+#if MEMP_STATS
+  desc->stats->avail = desc->num;
+#endif /* MEMP_STATS */
+#elif MEMP_MEM_MALLOC
   LWIP_UNUSED_ARG(desc);
 #else
   int i;
@@ -248,11 +349,20 @@ do_memp_malloc_pool_fn(const struct memp_desc *desc, const char *file, const int
 #endif
 {
   struct memp *memp;
-  SYS_ARCH_DECL_PROTECT(old_level);
-
+  MEMP_DECL_PROTECT(old_level);
 #if MEMP_MEM_MALLOC
-  memp = (struct memp *)mem_malloc(MEMP_SIZE + MEMP_ALIGN_SIZE(desc->size));
-  SYS_ARCH_PROTECT(old_level);
+  int from_heap = 0;
+
+#if MEMP_MEM_MALLOC_RESERVE
+  memp = memp_reserve_pop(desc);
+  if (memp == NULL)
+#endif /* MEMP_MEM_MALLOC_RESERVE */
+  {
+    memp = (struct memp *)mem_malloc(MEMP_SIZE + MEMP_ALIGN_SIZE(desc->size));
+    from_heap = 1;
+  }
+  LWIP_UNUSED_ARG(from_heap);
+  MEMP_PROTECT(old_level);
 #else /* MEMP_MEM_MALLOC */
   SYS_ARCH_PROTECT(old_level);
 
@@ -284,15 +394,20 @@ do_memp_malloc_pool_fn(const struct memp_desc *desc, const char *file, const int
     if (desc->stats->used > desc->stats->max) {
       desc->stats->max = desc->stats->used;
     }
+#if MEMP_MEM_MALLOC
+    if (from_heap) {
+      desc->stats->heap++;
+    }
+#endif /* MEMP_MEM_MALLOC */
 #endif
-    SYS_ARCH_UNPROTECT(old_level);
+    MEMP_UNPROTECT(old_level);
     /* cast through u8_t* to get rid of alignment warnings */
     return ((u8_t *)memp + MEMP_SIZE);
   } else {
 #if MEMP_STATS
     desc->stats->err++;
 #endif
-    SYS_ARCH_UNPROTECT(old_level);
+    MEMP_UNPROTECT(old_level);
     LWIP_DEBUGF(MEMP_DEBUG | LWIP_DBG_LEVEL_SERIOUS, ("memp_malloc: out of memory in pool %s\n", desc->desc));
   }
 
@@ -359,7 +474,7 @@ static void
 do_memp_free_pool(const struct memp_desc *desc, void *mem)
 {
   struct memp *memp;
-  SYS_ARCH_DECL_PROTECT(old_level);
+  MEMP_DECL_PROTECT(old_level);
 
   LWIP_ASSERT("memp_free: mem properly aligned",
               ((mem_ptr_t)mem % MEM_ALIGNMENT) == 0);
@@ -367,7 +482,7 @@ do_memp_free_pool(const struct memp_desc *desc, void *mem)
   /* cast through void* to get rid of alignment warnings */
   memp = (struct memp *)(void *)((u8_t *)mem - MEMP_SIZE);
 
-  SYS_ARCH_PROTECT(old_level);
+  MEMP_PROTECT(old_level);
 
 #if MEMP_OVERFLOW_CHECK == 1
   memp_overflow_check_element(memp, desc);
@@ -379,8 +494,13 @@ do_memp_free_pool(const struct memp_desc *desc, void *mem)
 
 #if MEMP_MEM_MALLOC
   LWIP_UNUSED_ARG(desc);
-  SYS_ARCH_UNPROTECT(old_level);
-  mem_free(memp);
+  MEMP_UNPROTECT(old_level);
+#if MEMP_MEM_MALLOC_RESERVE
+  if (!memp_reserve_push(desc, memp))
+#endif /* MEMP_MEM_MALLOC_RESERVE */
+  {
+    mem_free(memp);
+  }
 #else /* MEMP_MEM_MALLOC */
   memp->next = *desc->tab;
   *desc->tab = memp;
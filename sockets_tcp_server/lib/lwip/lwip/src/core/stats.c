@@ -109,6 +109,9 @@ stats_display_mem(struct stats_mem *mem, const char *name)
   LWIP_PLATFORM_DIAG(("used: %"MEM_SIZE_F"\n\t", mem->used));
   LWIP_PLATFORM_DIAG(("max: %"MEM_SIZE_F"\n\t", mem->max));
   LWIP_PLATFORM_DIAG(("err: %"STAT_COUNTER_F"\n", mem->err));
+#if MEMP_MEM_MALLOC
+  LWIP_PLATFORM_DIAG(("\theap: %"STAT_COUNTER_F"\n", mem->heap));
+#endif /* MEMP_MEM_MALLOC */
 }
 
 #if MEMP_STATS
@@ -184,6 +184,14 @@ struct tcp_pcb **const tcp_pcb_lists[] = {&tcp_listen_pcbs.pcbs, &tcp_bound_pcbs
 
 u8_t tcp_active_pcbs_changed;
 
+#if LWIP_TCP_PCB_HASH
+#if (TCP_PCB_HASH_SIZE & (TCP_PCB_HASH_SIZE - 1)) != 0
+#error "TCP_PCB_HASH_SIZE must be a power of 2"
+#endif
+/** Active and TIME-WAIT PCBs, chained through hash_next */
+static struct tcp_pcb *tcp_pcb_hash[TCP_PCB_HASH_SIZE];
+#endif /* LWIP_TCP_PCB_HASH */
+
 /** Timer counter to handle calling slow-timer from tcp_tmr() */
 static u8_t tcp_timer;
 static u8_t tcp_timer_ctr;
@@ -1394,6 +1402,7 @@ tcp_slowtmr_start:
         LWIP_ASSERT("tcp_slowtmr: first pcb == tcp_active_pcbs", tcp_active_pcbs == pcb);
         tcp_active_pcbs = pcb->next;
       }
+      TCP_HASH_RMV(&tcp_active_pcbs, pcb);
 
       if (pcb_reset) {
         tcp_rst(pcb, pcb->snd_nxt, pcb->rcv_nxt, &pcb->local_ip, &pcb->remote_ip,
@@ -1460,6 +1469,7 @@ tcp_slowtmr_start:
         LWIP_ASSERT("tcp_slowtmr: first pcb == tcp_tw_pcbs", tcp_tw_pcbs == pcb);
         tcp_tw_pcbs = pcb->next;
       }
+      TCP_HASH_RMV(&tcp_tw_pcbs, pcb);
       pcb2 = pcb;
       pcb = pcb->next;
       tcp_free(pcb2);
@@ -2252,6 +2262,87 @@ tcp_pcb_purge(struct tcp_pcb *pcb)
   }
 }
 
+#if LWIP_TCP_PCB_HASH
+static u32_t
+tcp_pcb_hash_bucket(const ip_addr_t *remote_ip, u16_t local_port, u16_t remote_port)
+{
+  u32_t h = 0;
+#if LWIP_IPV6
+  if (IP_IS_V6(remote_ip)) {
+    const u32_t *addr = ip_2_ip6(remote_ip)->addr;
+    h = addr[0] ^ addr[1] ^ addr[2] ^ addr[3];
+  }
+#endif /* LWIP_IPV6 */
+#if LWIP_IPV4
+  if (!IP_IS_V6(remote_ip)) {
+    h = ip4_addr_get_u32(ip_2_ip4(remote_ip));
+  }
+#endif /* LWIP_IPV4 */
+  h ^= ((u32_t)local_port << 16) | remote_port;
+  /* multiplicative hashing, the high half depends on all the key bits */
+  h *= 0x9E3779B1UL;
+  return (h ^ (h >> 16)) & (TCP_PCB_HASH_SIZE - 1);
+}
+
+/**
+ * Adds an active or TIME-WAIT PCB to the hash table, called from TCP_REG.
+ */
+void
+tcp_pcb_hash_add(struct tcp_pcb *pcb)
+{
+  u32_t bucket = tcp_pcb_hash_bucket(&pcb->remote_ip, pcb->local_port, pcb->remote_port);
+  pcb->hash_next = tcp_pcb_hash[bucket];
+  tcp_pcb_hash[bucket] = pcb;
+}
+
+/**
+ * Removes a PCB from the hash table, called from TCP_RMV.
+ */
+void
+tcp_pcb_hash_remove(struct tcp_pcb *pcb)
+{
+  struct tcp_pcb **link = &tcp_pcb_hash[tcp_pcb_hash_bucket(&pcb->remote_ip, pcb->local_port, pcb->remote_port)];
+  for (; *link != NULL; link = &(*link)->hash_next) {
+    if (*link == pcb) {
+      *link = pcb->hash_next;
+      break;
+    }
+  }
+  pcb->hash_next = NULL;
+}
+
+/**
+ * Finds the PCB of an incoming segment among the active and TIME-WAIT PCBs.
+ * Like the list walk, an active PCB is preferred to a TIME-WAIT one.
+ *
+ * @param inp the netif the segment was received on
+ * @return the matching PCB or NULL
+ */
+struct tcp_pcb *
+tcp_pcb_hash_find(const ip_addr_t *local_ip, u16_t local_port,
+                  const ip_addr_t *remote_ip, u16_t remote_port, struct netif *inp)
+{
+  struct tcp_pcb *pcb;
+  struct tcp_pcb *tw_pcb = NULL;
+  for (pcb = tcp_pcb_hash[tcp_pcb_hash_bucket(remote_ip, local_port, remote_port)]; pcb != NULL; pcb = pcb->hash_next) {
+    /* check if PCB is bound to specific netif */
+    if ((pcb->netif_idx != NETIF_NO_INDEX) && (pcb->netif_idx != netif_get_index(inp))) {
+      continue;
+    }
+    if (pcb->remote_port == remote_port &&
+        pcb->local_port == local_port &&
+        ip_addr_cmp(&pcb->remote_ip, remote_ip) &&
+        ip_addr_cmp(&pcb->local_ip, local_ip)) {
+      if (pcb->state != TIME_WAIT) {
+        return pcb;
+      }
+      tw_pcb = pcb;
+    }
+  }
+  return tw_pcb;
+}
+#endif /* LWIP_TCP_PCB_HASH */
+
 /**
  * Purges the PCB and removes it from a PCB list. Any delayed ACKs are sent first.
  *
@@ -85,6 +85,12 @@ static u8_t flags;
 static u8_t recv_flags;
 static struct pbuf *recv_data;
 
+#if LWIP_TCP_SACK_IN
+/* SACK blocks of the incoming segment (at most 4 fit in the options) */
+static struct tcp_sack_range in_sacks[4];
+static u8_t in_num_sacks;
+#endif /* LWIP_TCP_SACK_IN */
+
 struct tcp_pcb *tcp_input_pcb;
 
 /* Forward declarations. */
@@ -104,6 +110,9 @@ static void tcp_remove_sacks_lt(struct tcp_pcb *pcb, u32_t seq);
 static void tcp_remove_sacks_gt(struct tcp_pcb *pcb, u32_t seq);
 #endif /* TCP_OOSEQ_BYTES_LIMIT || TCP_OOSEQ_PBUFS_LIMIT */
 #endif /* LWIP_TCP_SACK_OUT */
+#if LWIP_TCP_SACK_IN
+static u8_t tcp_sack_update(struct tcp_pcb *pcb);
+#endif /* LWIP_TCP_SACK_IN */
 
 /**
  * The initial input processing of TCP. It verifies the TCP header, demultiplexes
@@ -243,6 +252,26 @@ tcp_input(struct pbuf *p, struct netif *inp)
     }
   }
 
+#if LWIP_TCP_PCB_HASH
+  /* Demultiplex an incoming segment. The active and TIME-WAIT connections
+     are found through their hash table. */
+  pcb = tcp_pcb_hash_find(ip_current_dest_addr(), tcphdr->dest, ip_current_src_addr(), tcphdr->src,
+                          ip_data.current_input_netif);
+  if ((pcb != NULL) && (pcb->state == TIME_WAIT)) {
+    LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_input: packed for TIME_WAITing connection.\n"));
+#ifdef LWIP_HOOK_TCP_INPACKET_PCB
+    if (LWIP_HOOK_TCP_INPACKET_PCB(pcb, tcphdr, tcphdr_optlen, tcphdr_opt1len,
+                                   tcphdr_opt2, p) == ERR_OK)
+#endif
+    {
+      tcp_timewait_input(pcb);
+    }
+    pbuf_free(p);
+    return;
+  }
+
+  if (pcb == NULL) {
+#else /* LWIP_TCP_PCB_HASH */
   /* Demultiplex an incoming segment. First, we check if it is destined
      for an active connection. */
   prev = NULL;
@@ -311,6 +340,7 @@ tcp_input(struct pbuf *p, struct netif *inp)
         return;
       }
     }
+#endif /* LWIP_TCP_PCB_HASH */
 
     /* Finally, if we still did not get a match, we check all PCBs that
        are LISTENing for incoming connections. */
@@ -1211,7 +1241,13 @@ tcp_receive(struct tcp_pcb *pcb)
               }
               if (pcb->dupacks > 3) {
                 /* Inflate the congestion window */
-                TCP_WND_INC(pcb->cwnd, pcb->mss);
+#if LWIP_TCP_SACK_IN
+                /* (not for SACK based recovery, which estimates the data in flight) */
+                if (!TCP_SACK_RECOVERY(pcb))
+#endif /* LWIP_TCP_SACK_IN */
+                {
+                  TCP_WND_INC(pcb->cwnd, pcb->mss);
+                }
               }
               if (pcb->dupacks >= 3) {
                 /* Do fast retransmit (checked via TF_INFR, not via dupacks count) */
@@ -1233,6 +1269,14 @@ tcp_receive(struct tcp_pcb *pcb)
       /* Reset the "IN Fast Retransmit" flag, since we are no longer
          in fast retransmit. Also reset the congestion window to the
          slow start threshold. */
+#if LWIP_TCP_SACK_IN
+      /* SACK based recovery goes on until all the data outstanding
+         when it started is acknowledged (RFC 6675). */
+      if ((pcb->flags & TF_INFR) && TCP_SACK_RECOVERY(pcb) &&
+          TCP_SEQ_LT(ackno, pcb->recovery_point)) {
+        LWIP_DEBUGF(TCP_FR_DEBUG, ("tcp_receive: partial ACK %"U32_F" during SACK recovery\n", ackno));
+      } else
+#endif /* LWIP_TCP_SACK_IN */
       if (pcb->flags & TF_INFR) {
         tcp_clear_flags(pcb, TF_INFR);
         pcb->cwnd = pcb->ssthresh;
@@ -1253,8 +1297,8 @@ tcp_receive(struct tcp_pcb *pcb)
       pcb->lastack = ackno;
 
       /* Update the congestion control variables (cwnd and
-         ssthresh). */
-      if (pcb->state >= ESTABLISHED) {
+         ssthresh), cwnd does not grow during (SACK based) recovery. */
+      if ((pcb->state >= ESTABLISHED) && !(pcb->flags & TF_INFR)) {
         if (pcb->cwnd < pcb->ssthresh) {
           tcpwnd_size_t increase;
           /* limit to 1 SMSS segment during period following RTO */
@@ -1336,6 +1380,14 @@ tcp_receive(struct tcp_pcb *pcb)
       tcp_send_empty_ack(pcb);
     }
 
+#if LWIP_TCP_SACK_IN
+    if ((in_num_sacks > 0) && tcp_sack_update(pcb) && !(pcb->flags & TF_INFR)) {
+      /* Enough data following the first unacked segment was SACKed to deem
+         it lost, even without three duplicate ACKs (RFC 6675) */
+      tcp_rexmit_fast(pcb);
+    }
+#endif /* LWIP_TCP_SACK_IN */
+
     LWIP_DEBUGF(TCP_RTO_DEBUG, ("tcp_receive: pcb->rttest %"U32_F" rtseq %"U32_F" ackno %"U32_F"\n",
                                 pcb->rttest, pcb->rtseq, ackno));
 
@@ -1898,6 +1950,18 @@ tcp_get_next_optbyte(void)
   }
 }
 
+#if LWIP_TCP_SACK_IN
+static u32_t
+tcp_get_next_optu32(void)
+{
+  u32_t val = (u32_t)tcp_get_next_optbyte() << 24;
+  val |= (u32_t)tcp_get_next_optbyte() << 16;
+  val |= (u32_t)tcp_get_next_optbyte() << 8;
+  val |= tcp_get_next_optbyte();
+  return val;
+}
+#endif /* LWIP_TCP_SACK_IN */
+
 /**
  * Parses the options contained in the incoming segment.
  *
@@ -1917,6 +1981,9 @@ tcp_parseopt(struct tcp_pcb *pcb)
 
   LWIP_ASSERT("tcp_parseopt: invalid pcb", pcb != NULL);
 
+#if LWIP_TCP_SACK_IN
+  in_num_sacks = 0;
+#endif /* LWIP_TCP_SACK_IN */
   /* Parse the TCP MSS option, if present. */
   if (tcphdr_optlen != 0) {
     for (tcp_optidx = 0; tcp_optidx < tcphdr_optlen; ) {
@@ -2009,6 +2076,27 @@ tcp_parseopt(struct tcp_pcb *pcb)
           }
           break;
 #endif /* LWIP_TCP_SACK_OUT */
+#if LWIP_TCP_SACK_IN
+        case LWIP_TCP_OPT_SACK:
+          LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_parseopt: SACK\n"));
+          data = tcp_get_next_optbyte();
+          if ((data < 10) || (((data - 2) % 8) != 0) || (tcp_optidx - 2 + data) > tcphdr_optlen) {
+            /* Bad length */
+            LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_parseopt: bad length\n"));
+            return;
+          }
+          /* TCP SACK option with valid length, the blocks are only used if SACK was negotiated */
+          for (data = (u8_t)((data - 2) / 8); data > 0; data--) {
+            u32_t left = tcp_get_next_optu32();
+            u32_t right = tcp_get_next_optu32();
+            if ((pcb->flags & TF_SACK) && (in_num_sacks < LWIP_ARRAYSIZE(in_sacks))) {
+              in_sacks[in_num_sacks].left = left;
+              in_sacks[in_num_sacks].right = right;
+              in_num_sacks++;
+            }
+          }
+          break;
+#endif /* LWIP_TCP_SACK_IN */
         default:
           LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_parseopt: other\n"));
           data = tcp_get_next_optbyte();
@@ -2176,4 +2264,48 @@ tcp_remove_sacks_gt(struct tcp_pcb *pcb, u32_t seq)
 
 #endif /* LWIP_TCP_SACK_OUT */
 
+#if LWIP_TCP_SACK_IN
+/**
+ * Called by tcp_receive() to update the scoreboard of RFC 6675 with the SACK
+ * blocks of the incoming ACK: the unacked segments they cover are marked as
+ * SACKed. Blocks not within the unacknowledged data (like D-SACKs) are ignored.
+ *
+ * @param pcb the tcp_pcb which received the ACK
+ * @return 1 if the first unacked segment is deemed lost, 0 otherwise
+ */
+static u8_t
+tcp_sack_update(struct tcp_pcb *pcb)
+{
+  struct tcp_seg *seg;
+  u32_t sacked_bytes = 0;
+  u16_t sacked_segs = 0;
+  u8_t i;
+
+  for (i = 0; i < in_num_sacks; i++) {
+    u32_t left = in_sacks[i].left;
+    u32_t right = in_sacks[i].right;
+    if (!TCP_SEQ_LT(left, right) || TCP_SEQ_LEQ(left, pcb->lastack) || TCP_SEQ_GT(right, pcb->snd_nxt)) {
+      continue;
+    }
+    for (seg = pcb->unacked; (seg != NULL) && TCP_SEQ_LT(lwip_ntohl(seg->tcphdr->seqno), right); seg = seg->next) {
+      u32_t seg_seqno = lwip_ntohl(seg->tcphdr->seqno);
+      if (TCP_SEQ_GEQ(seg_seqno, left) && TCP_SEQ_LEQ(seg_seqno + TCP_TCPLEN(seg), right)) {
+        seg->flags |= TF_SEG_SACKED;
+      }
+    }
+  }
+
+  if (pcb->unacked == NULL) {
+    return 0;
+  }
+  for (seg = pcb->unacked->next; seg != NULL; seg = seg->next) {
+    if (seg->flags & TF_SEG_SACKED) {
+      sacked_segs++;
+      sacked_bytes += TCP_TCPLEN(seg);
+    }
+  }
+  return (u8_t)TCP_SACK_IS_LOST(pcb, sacked_segs, sacked_bytes);
+}
+#endif /* LWIP_TCP_SACK_IN */
+
 #endif /* LWIP_TCP */
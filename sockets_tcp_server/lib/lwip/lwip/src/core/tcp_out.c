@@ -126,6 +126,9 @@
 
 /* Forward declarations.*/
 static err_t tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb, struct netif *netif);
+#if LWIP_TCP_SACK_IN
+static tcpwnd_size_t tcp_output_sack_rexmit(struct tcp_pcb *pcb);
+#endif /* LWIP_TCP_SACK_IN */
 
 /* tcp_route: common code that returns a fixed bound netif or calls ip_route */
 static struct netif *
@@ -1260,6 +1263,14 @@ tcp_output(struct tcp_pcb *pcb)
   }
 
   wnd = LWIP_MIN(pcb->snd_wnd, pcb->cwnd);
+#if LWIP_TCP_SACK_IN
+  if ((pcb->flags & (TF_SACK | TF_INFR)) == (TF_SACK | TF_INFR)) {
+    /* SACK based loss recovery: retransmissions first, new data may use
+       what is left of cwnd once the data in flight is accounted for */
+    tcpwnd_size_t room = tcp_output_sack_rexmit(pcb);
+    wnd = LWIP_MIN(pcb->snd_wnd, (pcb->snd_nxt - pcb->lastack) + room);
+  }
+#endif /* LWIP_TCP_SACK_IN */
 
   seg = pcb->unsent;
 
@@ -1620,6 +1631,101 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb, struct netif *netif
   return err;
 }
 
+#if LWIP_TCP_SACK_IN
+/**
+ * Called by tcp_output() during SACK based loss recovery (RFC 6675):
+ * retransmits the unacked segments deemed lost while the congestion window
+ * is larger than the estimated data in flight ("pipe"). Segments are
+ * retransmitted in place, they stay on the unacked queue.
+ *
+ * @param pcb the tcp_pcb in loss recovery
+ * @return the part of the congestion window left for new data
+ */
+static tcpwnd_size_t
+tcp_output_sack_rexmit(struct tcp_pcb *pcb)
+{
+  struct tcp_seg *seg;
+  struct netif *netif = NULL;
+  err_t err;
+  u32_t sacked_bytes = 0, bytes_above, pipe = 0;
+  u16_t sacked_segs = 0, segs_above;
+
+  for (seg = pcb->unacked; seg != NULL; seg = seg->next) {
+    if (seg->flags & TF_SEG_SACKED) {
+      sacked_segs++;
+      sacked_bytes += TCP_TCPLEN(seg);
+    }
+  }
+
+  /* SetPipe(): segments neither SACKed nor lost are in flight, retransmitted
+     ones count once more. The first unacked segment is always lost here. */
+  bytes_above = sacked_bytes;
+  segs_above = sacked_segs;
+  for (seg = pcb->unacked; seg != NULL; seg = seg->next) {
+    u32_t len = TCP_TCPLEN(seg);
+    if (seg->flags & TF_SEG_SACKED) {
+      segs_above--;
+      bytes_above -= len;
+      continue;
+    }
+    if ((seg != pcb->unacked) && !TCP_SACK_IS_LOST(pcb, segs_above, bytes_above)) {
+      pipe += len;
+    }
+    if (seg->flags & TF_SEG_RETRANSMITTED) {
+      pipe += len;
+    }
+  }
+
+  /* NextSeg() rule 1: the lost segments which were not retransmitted yet */
+  bytes_above = sacked_bytes;
+  segs_above = sacked_segs;
+  for (seg = pcb->unacked; seg != NULL; seg = seg->next) {
+    u32_t len = TCP_TCPLEN(seg);
+    u32_t rttest;
+    if (seg->flags & TF_SEG_SACKED) {
+      segs_above--;
+      bytes_above -= len;
+      continue;
+    }
+    if ((seg->flags & TF_SEG_RETRANSMITTED) ||
+        ((seg != pcb->unacked) && !TCP_SACK_IS_LOST(pcb, segs_above, bytes_above))) {
+      continue;
+    }
+    /* The first unacked segment is retransmitted when entering recovery
+       whatever the data in flight (RFC 6675, step 4.3), cwnd only limits
+       the following retransmissions */
+    if (((seg != pcb->unacked) && (pipe + len > pcb->cwnd)) || tcp_output_segment_busy(seg)) {
+      break;
+    }
+    if (netif == NULL) {
+      netif = tcp_route(pcb, &pcb->local_ip, &pcb->remote_ip);
+      if (netif == NULL) {
+        return 0;
+      }
+    }
+    LWIP_DEBUGF(TCP_FR_DEBUG, ("tcp_output: SACK recovery, retransmit %"U32_F"\n",
+                               lwip_ntohl(seg->tcphdr->seqno)));
+    /* Don't take RTT measurements from retransmitted segments */
+    rttest = pcb->rttest;
+    err = tcp_output_segment(seg, pcb, netif);
+    pcb->rttest = rttest;
+    if (err != ERR_OK) {
+      break;
+    }
+    seg->flags |= TF_SEG_RETRANSMITTED;
+    pipe += len;
+    if (pcb->nrtx < 0xFF) {
+      ++pcb->nrtx;
+    }
+    MIB2_STATS_INC(mib2.tcpretranssegs);
+    /* the retransmission carried the ACK */
+    tcp_clear_flags(pcb, TF_ACK_DELAY | TF_ACK_NOW);
+  }
+
+  return (tcpwnd_size_t)((pcb->cwnd > pipe) ? (pcb->cwnd - pipe) : 0);
+}
+#endif /* LWIP_TCP_SACK_IN */
+
 /**
  * Requeue all unacked segments for retransmission
  *
@@ -1665,6 +1771,19 @@ tcp_rexmit_rto_prepare(struct tcp_pcb *pcb)
   /* unacked queue is now empty */
   pcb->unacked = NULL;
 
+#if LWIP_TCP_SACK_IN
+  /* Everything is sent again: forget the SACK scoreboard and end the recovery */
+  {
+    struct tcp_seg *useg;
+    for (useg = pcb->unsent; useg != seg->next; useg = useg->next) {
+      useg->flags &= (u8_t)~(TF_SEG_SACKED | TF_SEG_RETRANSMITTED);
+    }
+  }
+  if (TCP_SACK_RECOVERY(pcb)) {
+    tcp_clear_flags(pcb, TF_INFR);
+  }
+#endif /* LWIP_TCP_SACK_IN */
+
   /* Mark RTO in-progress */
   tcp_set_flags(pcb, TF_RTO);
   /* Record the next byte following retransmit */
@@ -1785,13 +1904,29 @@ tcp_rexmit_fast(struct tcp_pcb *pcb)
   LWIP_ASSERT("tcp_rexmit_fast: invalid pcb", pcb != NULL);
 
   if (pcb->unacked != NULL && !(pcb->flags & TF_INFR)) {
+    err_t err;
     /* This is fast retransmit. Retransmit the first unacked segment. */
     LWIP_DEBUGF(TCP_FR_DEBUG,
                 ("tcp_receive: dupacks %"U16_F" (%"U32_F
                  "), fast retransmit %"U32_F"\n",
                  (u16_t)pcb->dupacks, pcb->lastack,
                  lwip_ntohl(pcb->unacked->tcphdr->seqno)));
-    if (tcp_rexmit(pcb) == ERR_OK) {
+#if LWIP_TCP_SACK_IN
+    if (TCP_SACK_RECOVERY(pcb)) {
+      /* SACK based recovery: tcp_output() retransmits the lost segments
+         until all the data sent so far is acknowledged */
+      struct tcp_seg *seg;
+      for (seg = pcb->unacked; seg != NULL; seg = seg->next) {
+        seg->flags &= (u8_t)~TF_SEG_RETRANSMITTED;
+      }
+      pcb->recovery_point = pcb->snd_nxt;
+      err = ERR_OK;
+    } else
+#endif /* LWIP_TCP_SACK_IN */
+    {
+      err = tcp_rexmit(pcb);
+    }
+    if (err == ERR_OK) {
       /* Set ssthresh to half of the minimum of the current
        * cwnd and the advertised window */
       pcb->ssthresh = LWIP_MIN(pcb->cwnd, pcb->snd_wnd) / 2;
@@ -1806,6 +1941,12 @@ tcp_rexmit_fast(struct tcp_pcb *pcb)
       }
 
       pcb->cwnd = pcb->ssthresh + 3 * pcb->mss;
+#if LWIP_TCP_SACK_IN
+      if (TCP_SACK_RECOVERY(pcb)) {
+        /* no inflation, the data in flight is estimated from the scoreboard */
+        pcb->cwnd = pcb->ssthresh;
+      }
+#endif /* LWIP_TCP_SACK_IN */
       tcp_set_flags(pcb, TF_INFR);
 
       /* Reset the retransmission timer to prevent immediate rto retransmissions */
@@ -340,6 +340,9 @@ err_t   netconn_tcp_recvd(struct netconn *conn, size_t len);
 err_t   netconn_sendto(struct netconn *conn, struct netbuf *buf,
                              const ip_addr_t *addr, u16_t port);
 err_t   netconn_send(struct netconn *conn, struct netbuf *buf);
+#if LWIP_SOCKET_MMSG
+err_t   netconn_send_batch(struct netconn *conn, struct netbuf *bufs, u16_t count, u16_t *sent);
+#endif /* LWIP_SOCKET_MMSG */
 err_t   netconn_write_partly(struct netconn *conn, const void *dataptr, size_t size,
                              u8_t apiflags, size_t *bytes_written);
 err_t   netconn_write_vectors_partly(struct netconn *conn, struct netvector *vectors, u16_t vectorcnt,
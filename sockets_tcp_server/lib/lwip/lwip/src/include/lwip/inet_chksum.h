@@ -58,6 +58,7 @@
 # ifndef LWIP_CHKSUM_COPY
 #  define LWIP_CHKSUM_COPY(dst, src, len) lwip_chksum_copy(dst, src, len)
 #  ifndef LWIP_CHKSUM_COPY_ALGORITHM
+/* 1: MEMCPY then LWIP_CHKSUM, 2: copy and sum a word at a time in one pass */
 #   define LWIP_CHKSUM_COPY_ALGORITHM 1
 #  endif /* LWIP_CHKSUM_COPY_ALGORITHM */
 # else /* LWIP_CHKSUM_COPY */
@@ -76,6 +76,26 @@ extern const struct memp_desc* const memp_pools[MEMP_MAX];
     LWIP_MEM_ALIGN_SIZE(size) \
   };
 
+#if MEMP_MEM_MALLOC_RESERVE
+/** Declare a pool allocated with mem_malloc() once its 'reserved' statically
+ * allocated elements are all in use */
+#define LWIP_MEMPOOL_DECLARE_RESERVED(name,num,reserved,size,desc) \
+  LWIP_DECLARE_MEMORY_ALIGNED(memp_memory_ ## name ## _base, ((reserved) * (MEMP_SIZE + MEMP_ALIGN_SIZE(size)))); \
+    \
+  LWIP_MEMPOOL_DECLARE_STATS_INSTANCE(memp_stats_ ## name) \
+    \
+  static u32_t memp_reserve_ ## name; \
+    \
+  const struct memp_desc memp_ ## name = { \
+    DECLARE_LWIP_MEMPOOL_DESC(desc) \
+    LWIP_MEMPOOL_DECLARE_STATS_REFERENCE(memp_stats_ ## name) \
+    LWIP_MEM_ALIGN_SIZE(size), \
+    (reserved), \
+    memp_memory_ ## name ## _base, \
+    ((reserved) > 0) ? &memp_reserve_ ## name : NULL \
+  };
+#endif /* MEMP_MEM_MALLOC_RESERVE */
+
 #else /* MEMP_MEM_MALLOC */
 
 /**
@@ -110,6 +130,10 @@ extern const struct memp_desc* const memp_pools[MEMP_MAX];
 
 #endif /* MEMP_MEM_MALLOC */
 
+#if !MEMP_MEM_MALLOC_RESERVE
+#define LWIP_MEMPOOL_DECLARE_RESERVED(name,num,reserved,size,desc) LWIP_MEMPOOL_DECLARE(name,num,size,desc)
+#endif /* !MEMP_MEM_MALLOC_RESERVE */
+
 /**
  * @ingroup mempool
  * Initialize a private memory pool
@@ -271,6 +271,41 @@
 #define MEMP_MEM_MALLOC                 0
 #endif
 
+/**
+ * MEMP_NUM_TCP_SEG_RESERVED, MEMP_NUM_PBUF_RESERVED, MEMP_NUM_NETBUF_RESERVED,
+ * MEMP_NUM_TCPIP_MSG_API_RESERVED: with MEMP_MEM_MALLOC==1, number of elements
+ * of these (busiest) pools which are statically allocated and kept in a
+ * lock-free free list. memp_malloc() only calls mem_malloc() for them once
+ * all the reserved elements are in use. Needs MEMP_RESERVE_CAS().
+ */
+#if !defined MEMP_NUM_TCP_SEG_RESERVED || defined __DOXYGEN__
+#define MEMP_NUM_TCP_SEG_RESERVED       0
+#endif
+#if !defined MEMP_NUM_PBUF_RESERVED || defined __DOXYGEN__
+#define MEMP_NUM_PBUF_RESERVED          0
+#endif
+#if !defined MEMP_NUM_NETBUF_RESERVED || defined __DOXYGEN__
+#define MEMP_NUM_NETBUF_RESERVED        0
+#endif
+#if !defined MEMP_NUM_TCPIP_MSG_API_RESERVED || defined __DOXYGEN__
+#define MEMP_NUM_TCPIP_MSG_API_RESERVED 0
+#endif
+/* Set if any pool keeps elements in reserve, not to be defined in lwipopts.h */
+#define MEMP_MEM_MALLOC_RESERVE         (MEMP_MEM_MALLOC && ((MEMP_NUM_TCP_SEG_RESERVED > 0) || \
+                                         (MEMP_NUM_PBUF_RESERVED > 0) || (MEMP_NUM_NETBUF_RESERVED > 0) || \
+                                         (MEMP_NUM_TCPIP_MSG_API_RESERVED > 0)))
+
+/**
+ * MEMP_RESERVE_CAS(ptr, expected, desired): atomically replace the u32_t at
+ * ptr by desired if it equals *expected, otherwise load it into *expected.
+ * Returns nonzero on success. Defaults to the GCC __atomic builtin (which
+ * memp.c also uses to load the heads of the free lists).
+ */
+#if !defined MEMP_RESERVE_CAS || defined __DOXYGEN__
+#define MEMP_RESERVE_CAS(ptr, expected, desired) \
+  __atomic_compare_exchange_n((ptr), (expected), (desired), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#endif
+
 /**
  * MEMP_MEM_INIT==1: Force use of memset to initialize pool memory.
  * Useful if pool are moved in uninitialized section of memory. This will ensure
@@ -1283,6 +1318,36 @@
 #define LWIP_TCP_SACK_OUT               0
 #endif
 
+/**
+ * LWIP_TCP_SACK_IN==1: TCP will use the selective acknowledgements (SACKs)
+ * received from the remote host for loss recovery (RFC 6675): SACKed segments
+ * are not retransmitted, and all the segments lost in a window are
+ * retransmitted during one recovery instead of one per round trip.
+ * SACK is negotiated with the option of LWIP_TCP_SACK_OUT, which must be
+ * enabled too.
+ */
+#if !defined LWIP_TCP_SACK_IN || defined __DOXYGEN__
+#define LWIP_TCP_SACK_IN                0
+#endif
+
+/**
+ * LWIP_TCP_PCB_HASH==1: Find the PCB of incoming segments through a hash table of the
+ * active and TIME-WAIT PCBs (keyed by remote address and ports) instead of walking both
+ * lists. Costs one pointer per PCB plus the table, and makes the demultiplexing cost
+ * independent of the number of connections.
+ */
+#if !defined LWIP_TCP_PCB_HASH || defined __DOXYGEN__
+#define LWIP_TCP_PCB_HASH               0
+#endif
+
+/**
+ * TCP_PCB_HASH_SIZE: Number of buckets of the PCB hash table, must be a power of 2.
+ * Only used if LWIP_TCP_PCB_HASH is enabled.
+ */
+#if !defined TCP_PCB_HASH_SIZE || defined __DOXYGEN__
+#define TCP_PCB_HASH_SIZE               64
+#endif
+
 /**
  * LWIP_TCP_MAX_SACK_NUM: The maximum number of SACK values to include in TCP segments.
  * Must be at least 1, but is only used if LWIP_TCP_SACK_OUT is enabled.
@@ -2101,6 +2166,33 @@
 #if !defined LWIP_SOCKET_POLL || defined __DOXYGEN__
 #define LWIP_SOCKET_POLL                1
 #endif
+
+/**
+ * LWIP_SOCKET_RECV_PBUF==1: enable lwip_recv_pbuf() and lwip_recvfrom_pbuf(),
+ * which hand the received pbufs over to the application instead of copying
+ * them into its buffer.
+ */
+#if !defined LWIP_SOCKET_RECV_PBUF || defined __DOXYGEN__
+#define LWIP_SOCKET_RECV_PBUF           0
+#endif
+
+/**
+ * LWIP_SOCKET_MMSG==1: enable lwip_sendmmsg() and lwip_recvmmsg(), and
+ * netconn_send_batch() used by lwip_sendmmsg() to pass a batch of datagrams
+ * to the tcpip thread with a single message.
+ */
+#if !defined LWIP_SOCKET_MMSG || defined __DOXYGEN__
+#define LWIP_SOCKET_MMSG                0
+#endif
+
+/**
+ * LWIP_SOCKET_MMSG_BATCH: maximum number of datagrams lwip_sendmmsg() passes
+ * to the tcpip thread at once. A netbuf per datagram of a batch is on the
+ * stack of the calling thread.
+ */
+#if !defined LWIP_SOCKET_MMSG_BATCH || defined __DOXYGEN__
+#define LWIP_SOCKET_MMSG_BATCH          8
+#endif
 /**
  * @}
  */
@@ -2201,7 +2293,7 @@
  * MEMP_STATS==1: Enable memp.c pool stats.
  */
 #if !defined MEMP_STATS || defined __DOXYGEN__
-#define MEMP_STATS                      (MEMP_MEM_MALLOC == 0)
+#define MEMP_STATS                      ((MEMP_MEM_MALLOC == 0) || MEMP_MEM_MALLOC_RESERVE)
 #endif
 
 /**
@@ -86,6 +86,14 @@ struct api_msg {
   union {
     /** used for lwip_netconn_do_send */
     struct netbuf *b;
+#if LWIP_SOCKET_MMSG
+    /** used for lwip_netconn_do_send_batch */
+    struct {
+      struct netbuf *bufs;
+      u16_t count;
+      u16_t sent;
+    } sb;
+#endif /* LWIP_SOCKET_MMSG */
     /** used for lwip_netconn_do_newconn */
     struct {
       u8_t proto;
@@ -208,6 +216,9 @@ void lwip_netconn_do_connect         (void *m);
 void lwip_netconn_do_disconnect      (void *m);
 void lwip_netconn_do_listen          (void *m);
 void lwip_netconn_do_send            (void *m);
+#if LWIP_SOCKET_MMSG
+void lwip_netconn_do_send_batch      (void *m);
+#endif /* LWIP_SOCKET_MMSG */
 void lwip_netconn_do_recv            (void *m);
 #if TCP_LISTEN_BACKLOG
 void lwip_netconn_do_accepted        (void *m);
@@ -65,7 +65,7 @@ extern "C" {
 
 #endif /* MEMP_OVERFLOW_CHECK */
 
-#if !MEMP_MEM_MALLOC || MEMP_OVERFLOW_CHECK
+#if !MEMP_MEM_MALLOC || MEMP_OVERFLOW_CHECK || MEMP_MEM_MALLOC_RESERVE
 struct memp {
   struct memp *next;
 #if MEMP_OVERFLOW_CHECK
@@ -73,7 +73,7 @@ struct memp {
   int line;
 #endif /* MEMP_OVERFLOW_CHECK */
 };
-#endif /* !MEMP_MEM_MALLOC || MEMP_OVERFLOW_CHECK */
+#endif /* !MEMP_MEM_MALLOC || MEMP_OVERFLOW_CHECK || MEMP_MEM_MALLOC_RESERVE */
 
 #if MEM_USE_POOLS && MEMP_USE_CUSTOM_POOLS
 /* Use a helper type to get the start and end of the user "memory pools" for mem_malloc */
@@ -127,6 +127,16 @@ struct memp_desc {
 
   /** First free element of each pool. Elements form a linked list. */
   struct memp **tab;
+#elif MEMP_MEM_MALLOC_RESERVE
+  /** Number of reserved elements */
+  u16_t num;
+
+  /** Base address of the reserved elements */
+  u8_t *base;
+
+  /** Free reserved elements: tag in the upper 16 bits (against ABA), index
+      of the first element in the lower ones. NULL if the pool has no reserve. */
+  u32_t *reserve;
 #endif /* MEMP_MEM_MALLOC */
 };
 
@@ -31,12 +31,20 @@
 #define LWIP_PBUF_MEMPOOL(name, num, payload, desc) LWIP_MEMPOOL(name, num, (LWIP_MEM_ALIGN_SIZE(sizeof(struct pbuf)) + LWIP_MEM_ALIGN_SIZE(payload)), desc)
 #endif /* LWIP_PBUF_MEMPOOL */
 
+#ifndef LWIP_MEMPOOL_RESERVED
+/* This treats pools which may keep elements in reserve (with MEMP_MEM_MALLOC)
+ * just like any other pool. */
+#define LWIP_MEMPOOL_RESERVED(name, num, reserved, size, desc) LWIP_MEMPOOL(name, num, size, desc)
+#endif /* LWIP_MEMPOOL_RESERVED */
+
 
 /*
  * A list of internal pools used by LWIP.
  *
  * LWIP_MEMPOOL(pool_name, number_elements, element_size, pool_description)
  *     creates a pool name MEMP_pool_name. description is used in stats.c
+ * LWIP_MEMPOOL_RESERVED(pool_name, number_elements, number_reserved, element_size, pool_description)
+ *     the same, number_reserved elements are kept in reserve with MEMP_MEM_MALLOC
  */
 #if LWIP_RAW
 LWIP_MEMPOOL(RAW_PCB,        MEMP_NUM_RAW_PCB,         sizeof(struct raw_pcb),        "RAW_PCB")
@@ -49,7 +57,7 @@ LWIP_MEMPOOL(UDP_PCB,        MEMP_NUM_UDP_PCB,         sizeof(struct udp_pcb),
 #if LWIP_TCP
 LWIP_MEMPOOL(TCP_PCB,        MEMP_NUM_TCP_PCB,         sizeof(struct tcp_pcb),        "TCP_PCB")
 LWIP_MEMPOOL(TCP_PCB_LISTEN, MEMP_NUM_TCP_PCB_LISTEN,  sizeof(struct tcp_pcb_listen), "TCP_PCB_LISTEN")
-LWIP_MEMPOOL(TCP_SEG,        MEMP_NUM_TCP_SEG,         sizeof(struct tcp_seg),        "TCP_SEG")
+LWIP_MEMPOOL_RESERVED(TCP_SEG, MEMP_NUM_TCP_SEG, MEMP_NUM_TCP_SEG_RESERVED, sizeof(struct tcp_seg), "TCP_SEG")
 #endif /* LWIP_TCP */
 
 #if LWIP_ALTCP && LWIP_TCP
@@ -64,12 +72,12 @@ LWIP_MEMPOOL(FRAG_PBUF,      MEMP_NUM_FRAG_PBUF,       sizeof(struct pbuf_custom
 #endif /* IP_FRAG && !LWIP_NETIF_TX_SINGLE_PBUF || (LWIP_IPV6 && LWIP_IPV6_FRAG) */
 
 #if LWIP_NETCONN || LWIP_SOCKET
-LWIP_MEMPOOL(NETBUF,         MEMP_NUM_NETBUF,          sizeof(struct netbuf),         "NETBUF")
+LWIP_MEMPOOL_RESERVED(NETBUF, MEMP_NUM_NETBUF, MEMP_NUM_NETBUF_RESERVED, sizeof(struct netbuf), "NETBUF")
 LWIP_MEMPOOL(NETCONN,        MEMP_NUM_NETCONN,         sizeof(struct netconn),        "NETCONN")
 #endif /* LWIP_NETCONN || LWIP_SOCKET */
 
 #if NO_SYS==0
-LWIP_MEMPOOL(TCPIP_MSG_API,  MEMP_NUM_TCPIP_MSG_API,   sizeof(struct tcpip_msg),      "TCPIP_MSG_API")
+LWIP_MEMPOOL_RESERVED(TCPIP_MSG_API, MEMP_NUM_TCPIP_MSG_API, MEMP_NUM_TCPIP_MSG_API_RESERVED, sizeof(struct tcpip_msg), "TCPIP_MSG_API")
 #if LWIP_MPU_COMPATIBLE
 LWIP_MEMPOOL(API_MSG,        MEMP_NUM_API_MSG,         sizeof(struct api_msg),        "API_MSG")
 #if LWIP_DNS
@@ -130,7 +138,7 @@ LWIP_MEMPOOL(MLD6_GROUP,     MEMP_NUM_MLD6_GROUP,      sizeof(struct mld_group),
  *     This allocates enough space for the pbuf struct and a payload.
  *     (Example: pbuf_payload_size=0 allocates only size for the struct)
  */
-LWIP_MEMPOOL(PBUF,           MEMP_NUM_PBUF,            sizeof(struct pbuf),           "PBUF_REF/ROM")
+LWIP_MEMPOOL_RESERVED(PBUF,  MEMP_NUM_PBUF, MEMP_NUM_PBUF_RESERVED, sizeof(struct pbuf), "PBUF_REF/ROM")
 LWIP_PBUF_MEMPOOL(PBUF_POOL, PBUF_POOL_SIZE,           PBUF_POOL_BUFSIZE,             "PBUF_POOL")
 
 
@@ -151,3 +159,4 @@ LWIP_PBUF_MEMPOOL(PBUF_POOL, PBUF_POOL_SIZE,           PBUF_POOL_BUFSIZE,
 #undef LWIP_MALLOC_MEMPOOL_START
 #undef LWIP_MALLOC_MEMPOOL_END
 #undef LWIP_PBUF_MEMPOOL
+#undef LWIP_MEMPOOL_RESERVED
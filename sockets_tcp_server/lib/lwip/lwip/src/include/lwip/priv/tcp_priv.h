@@ -88,6 +88,18 @@ void             tcp_rexmit_fast (struct tcp_pcb *pcb);
 u32_t            tcp_update_rcv_ann_wnd(struct tcp_pcb *pcb);
 err_t            tcp_process_refused_data(struct tcp_pcb *pcb);
 
+#if LWIP_TCP_SACK_IN
+/** Loss recovery of the pcb is SACK based (SACK was negotiated) */
+#define TCP_SACK_RECOVERY(pcb) ((pcb)->flags & TF_SACK)
+/** RFC 6675 DupThresh */
+#define TCP_SACK_DUPTHRESH 3
+/** RFC 6675 IsLost(): a segment is deemed lost once DupThresh segments, or more
+ * than (DupThresh - 1) * MSS bytes, following it have been SACKed */
+#define TCP_SACK_IS_LOST(pcb, sacked_segs_above, sacked_bytes_above) \
+  (((sacked_segs_above) >= TCP_SACK_DUPTHRESH) || \
+   ((sacked_bytes_above) > (u32_t)(TCP_SACK_DUPTHRESH - 1) * (pcb)->mss))
+#endif /* LWIP_TCP_SACK_IN */
+
 /**
  * This is the Nagle algorithm: try to combine user data to send as few TCP
  * segments as possible. Only send if
@@ -270,6 +282,10 @@ struct tcp_seg {
                                                checksummed into 'chksum' */
 #define TF_SEG_OPTS_WND_SCALE   (u8_t)0x08U /* Include WND SCALE option (only used in SYN segments) */
 #define TF_SEG_OPTS_SACK_PERM   (u8_t)0x10U /* Include SACK Permitted option (only used in SYN segments) */
+#if LWIP_TCP_SACK_IN
+#define TF_SEG_SACKED           (u8_t)0x20U /* Selectively acknowledged by the remote host (unacked segments only) */
+#define TF_SEG_RETRANSMITTED    (u8_t)0x40U /* Retransmitted during the current SACK based loss recovery */
+#endif /* LWIP_TCP_SACK_IN */
   struct tcp_hdr *tcphdr;  /* the TCP header */
 };
 
@@ -278,6 +294,7 @@ struct tcp_seg {
 #define LWIP_TCP_OPT_MSS        2
 #define LWIP_TCP_OPT_WS         3
 #define LWIP_TCP_OPT_SACK_PERM  4
+#define LWIP_TCP_OPT_SACK       5
 #define LWIP_TCP_OPT_TS         8
 
 #define LWIP_TCP_OPT_LEN_MSS    4
@@ -349,6 +366,30 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
    3) All PCBs in the tcp_listen_pcbs list is in LISTEN state.
    4) All PCBs in the tcp_tw_pcbs list is in TIME-WAIT state.
 */
+#if LWIP_TCP_PCB_HASH
+/* The active and TIME-WAIT PCBs are also linked in a hash table used by tcp_input()
+   to find the PCB of an incoming segment. The key (remote address and ports) must
+   not change while a PCB is registered. */
+void tcp_pcb_hash_add(struct tcp_pcb *pcb);
+void tcp_pcb_hash_remove(struct tcp_pcb *pcb);
+struct tcp_pcb *tcp_pcb_hash_find(const ip_addr_t *local_ip, u16_t local_port,
+                                  const ip_addr_t *remote_ip, u16_t remote_port, struct netif *inp);
+
+#define TCP_HASH_REG(pcbs, npcb) do { \
+    if (((pcbs) == &tcp_active_pcbs) || ((pcbs) == &tcp_tw_pcbs)) { \
+      tcp_pcb_hash_add(npcb); \
+    } \
+  } while (0)
+#define TCP_HASH_RMV(pcbs, npcb) do { \
+    if (((pcbs) == &tcp_active_pcbs) || ((pcbs) == &tcp_tw_pcbs)) { \
+      tcp_pcb_hash_remove(npcb); \
+    } \
+  } while (0)
+#else /* LWIP_TCP_PCB_HASH */
+#define TCP_HASH_REG(pcbs, npcb)
+#define TCP_HASH_RMV(pcbs, npcb)
+#endif /* LWIP_TCP_PCB_HASH */
+
 /* Define two macros, TCP_REG and TCP_RMV that registers a TCP PCB
    with a PCB list or removes a PCB from a list, respectively. */
 #ifndef TCP_DEBUG_PCB_LISTS
@@ -367,6 +408,7 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
                             (npcb)->next = *(pcbs); \
                             LWIP_ASSERT("TCP_REG: npcb->next != npcb", (npcb)->next != (npcb)); \
                             *(pcbs) = (npcb); \
+                            TCP_HASH_REG(pcbs, npcb); \
                             LWIP_ASSERT("TCP_REG: tcp_pcbs sane", tcp_pcbs_sane()); \
               tcp_timer_needed(); \
                             } while(0)
@@ -383,6 +425,7 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
                                } \
                             } \
                             (npcb)->next = NULL; \
+                            TCP_HASH_RMV(pcbs, npcb); \
                             LWIP_ASSERT("TCP_RMV: tcp_pcbs sane", tcp_pcbs_sane()); \
                             LWIP_DEBUGF(TCP_DEBUG, ("TCP_RMV: removed %p from %p\n", (void *)(npcb), (void *)(*(pcbs)))); \
                             } while(0)
@@ -393,6 +436,7 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
   do {                                             \
     (npcb)->next = *pcbs;                          \
     *(pcbs) = (npcb);                              \
+    TCP_HASH_REG(pcbs, npcb);                      \
     tcp_timer_needed();                            \
   } while (0)
 
@@ -413,6 +457,7 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
       }                                            \
     }                                              \
     (npcb)->next = NULL;                           \
+    TCP_HASH_RMV(pcbs, npcb);                      \
   } while(0)
 
 #endif /* LWIP_DEBUG */
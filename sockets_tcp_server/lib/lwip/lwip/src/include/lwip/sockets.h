@@ -138,6 +138,15 @@ struct msghdr {
 #define MSG_TRUNC   0x04
 #define MSG_CTRUNC  0x08
 
+#if LWIP_SOCKET_MMSG
+/* lwip_sendmmsg()/lwip_recvmmsg() message, msg_len is the number of bytes
+   sent or received */
+struct mmsghdr {
+  struct msghdr msg_hdr;
+  unsigned int  msg_len;
+};
+#endif /* LWIP_SOCKET_MMSG */
+
 /* RFC 3542, Section 20: Ancillary Data */
 struct cmsghdr {
   socklen_t  cmsg_len;   /* number of bytes, including header */
@@ -263,6 +272,7 @@ struct linger {
 #define MSG_DONTWAIT   0x08    /* Nonblocking i/o for this operation only */
 #define MSG_MORE       0x10    /* Sender will send more */
 #define MSG_NOSIGNAL   0x20    /* Uninmplemented: Requests not to send the SIGPIPE signal if an attempt to send is made on a stream-oriented socket that is no longer connected. */
+#define MSG_WAITFORONE 0x40    /* lwip_recvmmsg(): only wait for the first message */
 
 
 /*
@@ -616,6 +626,17 @@ int lwip_fcntl(int s, int cmd, int val);
 const char *lwip_inet_ntop(int af, const void *src, char *dst, socklen_t size);
 int lwip_inet_pton(int af, const char *src, void *dst);
 
+#if LWIP_SOCKET_RECV_PBUF
+struct pbuf;
+ssize_t lwip_recv_pbuf(int s, struct pbuf **p, size_t len, int flags);
+ssize_t lwip_recvfrom_pbuf(int s, struct pbuf **p, size_t len, int flags,
+      struct sockaddr *from, socklen_t *fromlen);
+#endif /* LWIP_SOCKET_RECV_PBUF */
+#if LWIP_SOCKET_MMSG
+int lwip_sendmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen, int flags);
+int lwip_recvmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen, int flags);
+#endif /* LWIP_SOCKET_MMSG */
+
 #if LWIP_COMPAT_SOCKETS
 #if LWIP_COMPAT_SOCKETS != 2
 
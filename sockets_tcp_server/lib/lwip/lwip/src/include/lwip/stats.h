@@ -104,6 +104,10 @@ struct stats_mem {
   mem_size_t used;
   mem_size_t max;
   STAT_COUNTER illegal;
+#if MEMP_MEM_MALLOC
+  /** Pool elements allocated with mem_malloc() */
+  STAT_COUNTER heap;
+#endif /* MEMP_MEM_MALLOC */
 };
 
 /** System element stats */
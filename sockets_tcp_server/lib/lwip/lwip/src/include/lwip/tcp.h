@@ -248,6 +248,11 @@ struct tcp_pcb {
   /* ports are in host byte order */
   u16_t remote_port;
 
+#if LWIP_TCP_PCB_HASH
+  /* next PCB of the same bucket of the active and TIME-WAIT PCB hash table */
+  struct tcp_pcb *hash_next;
+#endif /* LWIP_TCP_PCB_HASH */
+
   tcpflags_t flags;
 #define TF_ACK_DELAY   0x01U   /* Delayed ACK. */
 #define TF_ACK_NOW     0x02U   /* Immediate ACK. */
@@ -315,6 +320,11 @@ struct tcp_pcb {
   /* first byte following last rto byte */
   u32_t rto_end;
 
+#if LWIP_TCP_SACK_IN
+  /* SACK based loss recovery (TF_INFR with TF_SACK) ends when this is acked */
+  u32_t recovery_point;
+#endif /* LWIP_TCP_SACK_IN */
+
   /* sender variables */
   u32_t snd_nxt;   /* next new seqno to be sent */
   u32_t snd_wl1, snd_wl2; /* Sequence and acknowledgement numbers of last
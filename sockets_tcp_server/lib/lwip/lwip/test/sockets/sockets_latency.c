@@ -0,0 +1,191 @@
+/**
+ * @file
+ * Sockets call latency
+ *
+ * This file measures the average duration of socket calls on loopback
+ * sockets. Built with and without LWIP_TCPIP_CORE_LOCKING, it compares
+ * calling into the core with the core lock held to passing each call to
+ * the tcpip thread and waiting for it to be processed.
+ *
+ * - sockets_latency_run() blocks, it has to be called from a thread which
+ *   may use sockets, after tcpip_init()
+ * - loopback sockets are used, so the netif driver is not measured
+ * - sys_now() is the only time source: use enough iterations for the test
+ *   to last at least a few hundred milliseconds
+ */
+
+#include "lwip/opt.h"
+#include "sockets_latency.h"
+
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+
+#include <string.h>
+
+#if LWIP_SOCKET && LWIP_IPV4 /* this uses IPv4 loopback sockets, currently */
+
+#if LWIP_TCPIP_CORE_LOCKING
+#define TEST_MODE_NAME        "core locking"
+#else
+#define TEST_MODE_NAME        "tcpip thread messages"
+#endif
+
+#define TEST_DATA_SIZE        64
+
+struct sockets_latency_peer {
+  int s;
+  int echo;
+  sys_sem_t done;
+};
+
+static void
+sockets_latency_report(const char *name, u32_t started, int iterations)
+{
+  /* tenths of microseconds per call */
+  u32_t t = (u32_t)(((u64_t)(sys_now() - started) * 10000) / (u32_t)iterations);
+  LWIP_PLATFORM_DIAG(("%-28s %6"U32_F".%"U32_F" us\n", name, t / 10, t % 10));
+}
+
+/* Receives until the connection is closed, echoing the data if requested */
+static void
+sockets_latency_peer_thread(void *arg)
+{
+  struct sockets_latency_peer *peer = (struct sockets_latency_peer *)arg;
+  char buf[TCP_MSS];
+  ssize_t len;
+
+  while ((len = lwip_recv(peer->s, buf, sizeof(buf), 0)) > 0) {
+    if (peer->echo) {
+      ssize_t ret = lwip_send(peer->s, buf, (size_t)len, 0);
+      LWIP_ASSERT("echo failed", ret == len);
+    }
+  }
+  lwip_close(peer->s);
+  sys_sem_signal(&peer->done);
+}
+
+/* Opens a TCP connection over the loopback interface, served by a peer thread */
+static int
+sockets_latency_connect(struct sockets_latency_peer *peer, int echo)
+{
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  int slisten, s, ret, one = 1;
+  sys_thread_t t;
+
+  slisten = lwip_socket(AF_INET, SOCK_STREAM, 0);
+  LWIP_ASSERT("slisten >= 0", slisten >= 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = PP_HTONL(INADDR_LOOPBACK);
+  ret = lwip_bind(slisten, (struct sockaddr *)&addr, sizeof(addr));
+  LWIP_ASSERT("ret == 0", ret == 0);
+  ret = lwip_listen(slisten, 1);
+  LWIP_ASSERT("ret == 0", ret == 0);
+  ret = lwip_getsockname(slisten, (struct sockaddr *)&addr, &addr_len);
+  LWIP_ASSERT("ret == 0", ret == 0);
+
+  s = lwip_socket(AF_INET, SOCK_STREAM, 0);
+  LWIP_ASSERT("s >= 0", s >= 0);
+  ret = lwip_connect(s, (struct sockaddr *)&addr, sizeof(addr));
+  LWIP_ASSERT("ret == 0", ret == 0);
+  peer->s = lwip_accept(slisten, NULL, NULL);
+  LWIP_ASSERT("peer->s >= 0", peer->s >= 0);
+  lwip_close(slisten);
+
+  ret = lwip_setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  LWIP_ASSERT("ret == 0", ret == 0);
+  ret = lwip_setsockopt(peer->s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  LWIP_ASSERT("ret == 0", ret == 0);
+
+  peer->echo = echo;
+  ret = sys_sem_new(&peer->done, 0);
+  LWIP_ASSERT("ret == ERR_OK", ret == ERR_OK);
+  t = sys_thread_new("sockets_latency_peer", sockets_latency_peer_thread, peer,
+                     DEFAULT_THREAD_STACKSIZE, DEFAULT_THREAD_PRIO);
+  LWIP_ASSERT("thread != NULL", t != 0);
+  return s;
+}
+
+static void
+sockets_latency_disconnect(struct sockets_latency_peer *peer, int s)
+{
+  lwip_close(s);
+  sys_arch_sem_wait(&peer->done, 0);
+  sys_sem_free(&peer->done);
+}
+
+void
+sockets_latency_run(int iterations)
+{
+  struct sockets_latency_peer peer;
+  struct sockaddr_in addr;
+  socklen_t addr_len;
+  char buf[TEST_DATA_SIZE];
+  int s, sudp, i, ret, opt;
+  socklen_t opt_len;
+  u32_t started;
+
+  LWIP_ASSERT("iterations > 0", iterations > 0);
+  memset(buf, 'x', sizeof(buf));
+  LWIP_PLATFORM_DIAG(("socket call latency, %s, %d iterations\n", TEST_MODE_NAME, iterations));
+
+  s = sockets_latency_connect(&peer, 0);
+
+  started = sys_now();
+  for (i = 0; i < iterations; i++) {
+    opt_len = sizeof(opt);
+    ret = lwip_getsockopt(s, SOL_SOCKET, SO_ERROR, &opt, &opt_len);
+    LWIP_ASSERT("ret == 0", ret == 0);
+  }
+  sockets_latency_report("getsockopt(SO_ERROR)", started, iterations);
+
+  started = sys_now();
+  for (i = 0; i < iterations; i++) {
+    opt = i & 1;
+    ret = lwip_setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    LWIP_ASSERT("ret == 0", ret == 0);
+  }
+  sockets_latency_report("setsockopt(TCP_NODELAY)", started, iterations);
+  opt = 1;
+  lwip_setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+  sockets_latency_disconnect(&peer, s);
+
+  s = sockets_latency_connect(&peer, 1);
+  started = sys_now();
+  for (i = 0; i < iterations; i++) {
+    ret = lwip_send(s, buf, 1, 0);
+    LWIP_ASSERT("ret == 1", ret == 1);
+    ret = lwip_recv(s, buf, sizeof(buf), 0);
+    LWIP_ASSERT("ret == 1", ret == 1);
+  }
+  sockets_latency_report("tcp send+recv round trip", started, iterations);
+  sockets_latency_disconnect(&peer, s);
+
+  /* the receiving socket is not read, the datagrams are dropped once its mbox is full */
+  sudp = lwip_socket(AF_INET, SOCK_DGRAM, 0);
+  LWIP_ASSERT("sudp >= 0", sudp >= 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = PP_HTONL(INADDR_LOOPBACK);
+  ret = lwip_bind(sudp, (struct sockaddr *)&addr, sizeof(addr));
+  LWIP_ASSERT("ret == 0", ret == 0);
+  addr_len = sizeof(addr);
+  ret = lwip_getsockname(sudp, (struct sockaddr *)&addr, &addr_len);
+  LWIP_ASSERT("ret == 0", ret == 0);
+  s = lwip_socket(AF_INET, SOCK_DGRAM, 0);
+  LWIP_ASSERT("s >= 0", s >= 0);
+
+  started = sys_now();
+  for (i = 0; i < iterations; i++) {
+    ret = lwip_sendto(s, buf, sizeof(buf), 0, (struct sockaddr *)&addr, sizeof(addr));
+    /* with core locking, the loopback queue can be full if the tcpip thread is not scheduled */
+    LWIP_ASSERT("ret == sizeof(buf)", (ret == sizeof(buf)) || (errno == ENOMEM));
+  }
+  sockets_latency_report("udp sendto", started, iterations);
+  lwip_close(s);
+  lwip_close(sudp);
+}
+
+#endif /* LWIP_SOCKET && LWIP_IPV4 */
@@ -0,0 +1,6 @@
+#ifndef LWIP_HDR_TEST_SOCKETS_LATENCY
+#define LWIP_HDR_TEST_SOCKETS_LATENCY
+
+void sockets_latency_run(int iterations);
+
+#endif /* LWIP_HDR_TEST_SOCKETS_LATENCY */
@@ -0,0 +1,194 @@
+/**
+ * @file
+ * Sockets UDP batching throughput
+ *
+ * This file measures how many datagrams per second are sent over a loopback
+ * UDP socket with lwip_sendmmsg() for a range of batch sizes, batch size 1
+ * being lwip_sendto(). A receiver thread drains the destination socket with
+ * lwip_recvmmsg() and counts the datagrams which made it through.
+ *
+ * - sockets_mmsg_run() blocks, it has to be called from a thread which may
+ *   use sockets, after tcpip_init()
+ * - loopback sockets are used, so the netif driver is not measured
+ * - datagrams refused with ENOMEM because the loopback queue is full are
+ *   not counted as sent (with core locking, the sender can keep the tcpip
+ *   thread from emptying it); datagrams dropped because the receive mbox is
+ *   full count as sent but not as received
+ * - sys_now() is the only time source: use enough datagrams for each batch
+ *   size to last at least a few hundred milliseconds
+ */
+
+#include "lwip/opt.h"
+#include "sockets_mmsg.h"
+
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+
+#include <string.h>
+
+#if LWIP_SOCKET && LWIP_IPV4 && LWIP_SOCKET_MMSG && LWIP_SO_RCVTIMEO
+
+#if LWIP_TCPIP_CORE_LOCKING
+#define TEST_MODE_NAME        "core locking"
+#else
+#define TEST_MODE_NAME        "tcpip thread messages"
+#endif
+
+#define TEST_DATA_SIZE        64
+#define TEST_MAX_BATCH        32
+/* the receiver stops once nothing was received for this long after the sender is done */
+#define TEST_RECV_TIMEOUT_MS  100
+
+struct sockets_mmsg_receiver {
+  int s;
+  volatile int sending;
+  u32_t received;
+  u32_t calls;
+  sys_sem_t done;
+};
+
+static void
+sockets_mmsg_receiver_thread(void *arg)
+{
+  struct sockets_mmsg_receiver *rx = (struct sockets_mmsg_receiver *)arg;
+  struct mmsghdr msgs[TEST_MAX_BATCH];
+  struct iovec iovs[TEST_MAX_BATCH];
+  static char bufs[TEST_MAX_BATCH][TEST_DATA_SIZE];
+  int i, ret;
+
+  memset(msgs, 0, sizeof(msgs));
+  for (i = 0; i < TEST_MAX_BATCH; i++) {
+    iovs[i].iov_base = bufs[i];
+    iovs[i].iov_len = sizeof(bufs[i]);
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+  for (;;) {
+    ret = lwip_recvmmsg(rx->s, msgs, TEST_MAX_BATCH, MSG_WAITFORONE);
+    if (ret > 0) {
+      rx->received += (u32_t)ret;
+      rx->calls++;
+    } else if (!rx->sending) {
+      break;
+    }
+  }
+  sys_sem_signal(&rx->done);
+}
+
+/* Opens the destination socket, drained by a receiver thread */
+static void
+sockets_mmsg_receiver_start(struct sockets_mmsg_receiver *rx, struct sockaddr_in *addr)
+{
+  socklen_t addr_len = sizeof(*addr);
+  int ret, timeout = TEST_RECV_TIMEOUT_MS;
+  sys_thread_t t;
+
+  rx->s = lwip_socket(AF_INET, SOCK_DGRAM, 0);
+  LWIP_ASSERT("rx->s >= 0", rx->s >= 0);
+  memset(addr, 0, sizeof(*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_addr.s_addr = PP_HTONL(INADDR_LOOPBACK);
+  ret = lwip_bind(rx->s, (struct sockaddr *)addr, sizeof(*addr));
+  LWIP_ASSERT("ret == 0", ret == 0);
+  ret = lwip_getsockname(rx->s, (struct sockaddr *)addr, &addr_len);
+  LWIP_ASSERT("ret == 0", ret == 0);
+#if LWIP_SO_SNDRCVTIMEO_NONSTANDARD
+  ret = lwip_setsockopt(rx->s, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+#else
+  {
+    struct timeval tv;
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+    ret = lwip_setsockopt(rx->s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  }
+#endif
+  LWIP_ASSERT("ret == 0", ret == 0);
+
+  rx->sending = 1;
+  rx->received = 0;
+  rx->calls = 0;
+  ret = sys_sem_new(&rx->done, 0);
+  LWIP_ASSERT("ret == ERR_OK", ret == ERR_OK);
+  t = sys_thread_new("sockets_mmsg_receiver", sockets_mmsg_receiver_thread, rx,
+                     DEFAULT_THREAD_STACKSIZE, DEFAULT_THREAD_PRIO);
+  LWIP_ASSERT("thread != NULL", t != 0);
+}
+
+static void
+sockets_mmsg_receiver_stop(struct sockets_mmsg_receiver *rx)
+{
+  rx->sending = 0;
+  sys_arch_sem_wait(&rx->done, 0);
+  sys_sem_free(&rx->done);
+  lwip_close(rx->s);
+}
+
+/* Sends 'datagrams' datagrams in calls of 'batch' datagrams, returns the number sent */
+static u32_t
+sockets_mmsg_send(int s, struct sockaddr_in *addr, int datagrams, int batch)
+{
+  struct mmsghdr msgs[TEST_MAX_BATCH];
+  struct iovec iov;
+  static char buf[TEST_DATA_SIZE];
+  u32_t sent = 0;
+  int i, ret;
+
+  iov.iov_base = buf;
+  iov.iov_len = sizeof(buf);
+  memset(msgs, 0, sizeof(msgs));
+  for (i = 0; i < batch; i++) {
+    msgs[i].msg_hdr.msg_iov = &iov;
+    msgs[i].msg_hdr.msg_iovlen = 1;
+    msgs[i].msg_hdr.msg_name = addr;
+    msgs[i].msg_hdr.msg_namelen = sizeof(*addr);
+  }
+
+  for (i = 0; i < datagrams; i += batch) {
+    int count = LWIP_MIN(batch, datagrams - i);
+    if (batch == 1) {
+      ret = lwip_sendto(s, buf, sizeof(buf), 0, (const struct sockaddr *)addr, sizeof(*addr));
+      ret = (ret == sizeof(buf)) ? 1 : -1;
+    } else {
+      ret = lwip_sendmmsg(s, msgs, (unsigned int)count, 0);
+    }
+    /* with core locking, the loopback queue can be full if the tcpip thread is not scheduled */
+    LWIP_ASSERT("ret > 0", (ret > 0) || (errno == ENOMEM));
+    if (ret > 0) {
+      sent += (u32_t)ret;
+    }
+  }
+  return sent;
+}
+
+void
+sockets_mmsg_run(int datagrams)
+{
+  static const int batches[] = {1, 2, 4, 8, 16, TEST_MAX_BATCH};
+  struct sockets_mmsg_receiver rx;
+  struct sockaddr_in addr;
+  u32_t started, elapsed, sent;
+  size_t i;
+  int s;
+
+  LWIP_ASSERT("datagrams > 0", datagrams > 0);
+  LWIP_PLATFORM_DIAG(("udp datagrams per second, %s, %d datagrams of %d bytes, %d per tcpip message\n",
+                      TEST_MODE_NAME, datagrams, TEST_DATA_SIZE, LWIP_SOCKET_MMSG_BATCH));
+  LWIP_PLATFORM_DIAG(("%6s %10s %10s %10s %10s\n", "batch", "sent", "sent pps", "received", "recv calls"));
+
+  for (i = 0; i < LWIP_ARRAYSIZE(batches); i++) {
+    sockets_mmsg_receiver_start(&rx, &addr);
+    s = lwip_socket(AF_INET, SOCK_DGRAM, 0);
+    LWIP_ASSERT("s >= 0", s >= 0);
+
+    started = sys_now();
+    sent = sockets_mmsg_send(s, &addr, datagrams, batches[i]);
+    elapsed = sys_now() - started;
+
+    sockets_mmsg_receiver_stop(&rx);
+    lwip_close(s);
+    LWIP_PLATFORM_DIAG(("%6d %10"U32_F" %10"U32_F" %10"U32_F" %10"U32_F"\n", batches[i], sent,
+                        (u32_t)(((u64_t)sent * 1000) / LWIP_MAX(elapsed, 1)), rx.received, rx.calls));
+  }
+}
+
+#endif /* LWIP_SOCKET && LWIP_IPV4 && LWIP_SOCKET_MMSG && LWIP_SO_RCVTIMEO */
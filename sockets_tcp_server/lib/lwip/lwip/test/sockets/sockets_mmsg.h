@@ -0,0 +1,6 @@
+#ifndef LWIP_HDR_TEST_SOCKETS_MMSG
+#define LWIP_HDR_TEST_SOCKETS_MMSG
+
+void sockets_mmsg_run(int datagrams);
+
+#endif /* LWIP_HDR_TEST_SOCKETS_MMSG */
@@ -828,6 +828,248 @@ cleanup:
 }
 END_TEST
 
+#if LWIP_SOCKET_RECV_PBUF
+static void test_sockets_recv_pbuf_check(struct pbuf *p, u16_t len, u8_t first)
+{
+  struct pbuf *q;
+  u16_t i, j = 0;
+
+  fail_unless(p != NULL);
+  fail_unless(p->tot_len == len);
+  for (q = p; q != NULL; q = q->next) {
+    for (i = 0; i < q->len; i++, j++) {
+      fail_unless(((u8_t *)q->payload)[i] == (u8_t)(first + j));
+    }
+  }
+  fail_unless(j == len);
+}
+
+/* Verify pbufs are handed over without copying and split at the requested length */
+START_TEST(test_sockets_recv_pbuf)
+{
+  int listnr, s1, s2, s3, ret, i, opt;
+  struct sockaddr_storage addr_storage, from;
+  socklen_t addr_size, from_len;
+  struct pbuf *p;
+  u8_t buf[300];
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < (int)sizeof(buf); i++) {
+    buf[i] = (u8_t)i;
+  }
+  test_sockets_init_loopback_addr(AF_INET, &addr_storage, &addr_size);
+
+  listnr = test_sockets_alloc_socket_nonblocking(AF_INET, SOCK_STREAM);
+  fail_unless(listnr >= 0);
+  s1 = test_sockets_alloc_socket_nonblocking(AF_INET, SOCK_STREAM);
+  fail_unless(s1 >= 0);
+  ret = lwip_bind(listnr, (struct sockaddr*)&addr_storage, addr_size);
+  fail_unless(ret == 0);
+  ret = lwip_listen(listnr, 0);
+  fail_unless(ret == 0);
+  ret = lwip_getsockname(listnr, (struct sockaddr*)&addr_storage, &addr_size);
+  fail_unless(ret == 0);
+  ret = lwip_connect(s1, (struct sockaddr*)&addr_storage, addr_size);
+  fail_unless(ret == -1);
+  fail_unless(errno == EINPROGRESS);
+  while (tcpip_thread_poll_one());
+  s2 = lwip_accept(listnr, NULL, NULL);
+  fail_unless(s2 >= 0);
+  ret = lwip_close(listnr);
+  fail_unless(ret == 0);
+
+  /* nothing received yet */
+  ret = lwip_recv_pbuf(s2, &p, 100, MSG_DONTWAIT);
+  fail_unless(ret == -1);
+  fail_unless(errno == EWOULDBLOCK);
+  fail_unless(p == NULL);
+
+  /* three segments queued as a chain of three pbufs */
+  opt = 1;
+  ret = lwip_setsockopt(s1, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+  fail_unless(ret == 0);
+  ret = lwip_send(s1, buf, 100, 0);
+  fail_unless(ret == 100);
+  while (tcpip_thread_poll_one());
+  ret = lwip_send(s1, buf + 100, 100, 0);
+  fail_unless(ret == 100);
+  while (tcpip_thread_poll_one());
+  ret = lwip_send(s1, buf + 200, 100, 0);
+  fail_unless(ret == 100);
+  while (tcpip_thread_poll_one());
+
+  /* whole pbuf plus the leading part of the next one */
+  ret = lwip_recv_pbuf(s2, &p, 150, MSG_DONTWAIT);
+  fail_unless(ret == 150);
+  test_sockets_recv_pbuf_check(p, 150, 0);
+  pbuf_free(p);
+
+  /* the rest of a pbuf only */
+  ret = lwip_recv_pbuf(s2, &p, 50, MSG_DONTWAIT);
+  fail_unless(ret == 50);
+  test_sockets_recv_pbuf_check(p, 50, 150);
+  pbuf_free(p);
+
+  /* the copying API continues where we stopped */
+  ret = lwip_recv(s2, buf, 10, MSG_DONTWAIT);
+  fail_unless(ret == 10);
+  fail_unless(buf[0] == 200);
+
+  /* no more than what is available */
+  ret = lwip_recv_pbuf(s2, &p, 1000, MSG_DONTWAIT);
+  fail_unless(ret == 90);
+  test_sockets_recv_pbuf_check(p, 90, 210);
+  pbuf_free(p);
+
+  ret = lwip_recv_pbuf(s2, &p, 100, MSG_PEEK);
+  fail_unless(ret == -1);
+  fail_unless(errno == EOPNOTSUPP);
+
+  /* connection closed by the peer */
+  ret = lwip_close(s1);
+  fail_unless(ret == 0);
+  while (tcpip_thread_poll_one());
+  ret = lwip_recv_pbuf(s2, &p, 100, MSG_DONTWAIT);
+  fail_unless(ret == 0);
+  fail_unless(p == NULL);
+  ret = lwip_close(s2);
+  fail_unless(ret == 0);
+
+  /* datagrams are returned whole */
+  test_sockets_init_loopback_addr(AF_INET, &addr_storage, &addr_size);
+  s3 = test_sockets_alloc_socket_nonblocking(AF_INET, SOCK_DGRAM);
+  fail_unless(s3 >= 0);
+  ret = lwip_bind(s3, (struct sockaddr*)&addr_storage, addr_size);
+  fail_unless(ret == 0);
+  ret = lwip_getsockname(s3, (struct sockaddr*)&addr_storage, &addr_size);
+  fail_unless(ret == 0);
+  for (i = 0; i < (int)sizeof(buf); i++) {
+    buf[i] = (u8_t)(i + 7);
+  }
+  ret = lwip_sendto(s3, buf, 200, 0, (struct sockaddr*)&addr_storage, addr_size);
+  fail_unless(ret == 200);
+  while (tcpip_thread_poll_one());
+  from_len = sizeof(from);
+  ret = lwip_recvfrom_pbuf(s3, &p, 10, 0, (struct sockaddr*)&from, &from_len);
+  fail_unless(ret == 200);
+  test_sockets_recv_pbuf_check(p, 200, 7);
+  pbuf_free(p);
+  fail_unless(from_len == sizeof(struct sockaddr_in));
+  fail_unless(((struct sockaddr_in*)&from)->sin_port == ((struct sockaddr_in*)&addr_storage)->sin_port);
+  ret = lwip_close(s3);
+  fail_unless(ret == 0);
+}
+END_TEST
+#endif /* LWIP_SOCKET_RECV_PBUF */
+
+#if LWIP_SOCKET_MMSG
+#define TEST_MMSG_COUNT (LWIP_SOCKET_MMSG_BATCH + 4)
+
+START_TEST(test_sockets_mmsg)
+{
+  int s1, s2, ret, i, j;
+  struct sockaddr_storage addr_storage;
+  socklen_t addr_size;
+  struct mmsghdr msgs[TEST_MMSG_COUNT];
+  struct iovec iovs[TEST_MMSG_COUNT][2];
+  u8_t bufs[TEST_MMSG_COUNT][64];
+  u8_t rbufs[TEST_MMSG_COUNT][64];
+  LWIP_UNUSED_ARG(_i);
+
+  test_sockets_init_loopback_addr(AF_INET, &addr_storage, &addr_size);
+  s2 = test_sockets_alloc_socket_nonblocking(AF_INET, SOCK_DGRAM);
+  fail_unless(s2 >= 0);
+  ret = lwip_bind(s2, (struct sockaddr*)&addr_storage, addr_size);
+  fail_unless(ret == 0);
+  ret = lwip_getsockname(s2, (struct sockaddr*)&addr_storage, &addr_size);
+  fail_unless(ret == 0);
+  s1 = test_sockets_alloc_socket_nonblocking(AF_INET, SOCK_DGRAM);
+  fail_unless(s1 >= 0);
+
+  /* nothing to receive */
+  memset(msgs, 0, sizeof(msgs));
+  for (i = 0; i < TEST_MMSG_COUNT; i++) {
+    iovs[i][0].iov_base = rbufs[i];
+    iovs[i][0].iov_len = sizeof(rbufs[i]);
+    msgs[i].msg_hdr.msg_iov = iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+  ret = lwip_recvmmsg(s2, msgs, TEST_MMSG_COUNT, MSG_DONTWAIT);
+  fail_unless(ret == -1);
+  fail_unless(errno == EWOULDBLOCK);
+  /* an empty vector sends nothing */
+  ret = lwip_sendmmsg(s1, msgs, 0, 0);
+  fail_unless(ret == 0);
+
+  /* more datagrams than a batch, of different sizes, the last ones of 2 vectors */
+  memset(msgs, 0, sizeof(msgs));
+  for (i = 0; i < TEST_MMSG_COUNT; i++) {
+    for (j = 0; j < (int)sizeof(bufs[i]); j++) {
+      bufs[i][j] = (u8_t)(i + j);
+    }
+    iovs[i][0].iov_base = bufs[i];
+    iovs[i][0].iov_len = (size_t)(i + 1);
+    iovs[i][1].iov_base = &bufs[i][i + 1];
+    iovs[i][1].iov_len = 10;
+    msgs[i].msg_hdr.msg_iov = iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = (i >= LWIP_SOCKET_MMSG_BATCH) ? 2 : 1;
+    msgs[i].msg_hdr.msg_name = &addr_storage;
+    msgs[i].msg_hdr.msg_namelen = addr_size;
+  }
+  ret = lwip_sendmmsg(s1, msgs, TEST_MMSG_COUNT, 0);
+  fail_unless(ret == TEST_MMSG_COUNT);
+  for (i = 0; i < TEST_MMSG_COUNT; i++) {
+    fail_unless(msgs[i].msg_len == (unsigned int)((i >= LWIP_SOCKET_MMSG_BATCH) ? i + 11 : i + 1));
+  }
+
+  /* an invalid message stops the batch, the previous ones are sent */
+  msgs[2].msg_hdr.msg_iovlen = 0;
+  ret = lwip_sendmmsg(s1, msgs, 3, 0);
+  fail_unless(ret == 2);
+  ret = lwip_sendmmsg(s1, &msgs[2], 1, 0);
+  fail_unless(ret == -1);
+  fail_unless(errno == EMSGSIZE);
+  while (tcpip_thread_poll_one());
+
+  /* the last datagram is truncated */
+  memset(msgs, 0, sizeof(msgs));
+  for (i = 0; i < TEST_MMSG_COUNT; i++) {
+    iovs[i][0].iov_base = rbufs[i];
+    iovs[i][0].iov_len = (i == TEST_MMSG_COUNT - 1) ? 5 : sizeof(rbufs[i]);
+    msgs[i].msg_hdr.msg_iov = iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+  ret = lwip_recvmmsg(s2, msgs, TEST_MMSG_COUNT, MSG_DONTWAIT);
+  fail_unless(ret == TEST_MMSG_COUNT);
+  for (i = 0; i < TEST_MMSG_COUNT; i++) {
+    unsigned int len = (unsigned int)((i >= LWIP_SOCKET_MMSG_BATCH) ? i + 11 : i + 1);
+    if (i == TEST_MMSG_COUNT - 1) {
+      fail_unless(msgs[i].msg_len == 5);
+      fail_unless(msgs[i].msg_hdr.msg_flags & MSG_TRUNC);
+      len = 5;
+    } else {
+      fail_unless(msgs[i].msg_len == len);
+      fail_unless(!(msgs[i].msg_hdr.msg_flags & MSG_TRUNC));
+    }
+    for (j = 0; j < (int)len; j++) {
+      fail_unless(rbufs[i][j] == (u8_t)(i + j));
+    }
+  }
+
+  /* MSG_WAITFORONE returns what is there (the socket does not block anyway) */
+  ret = lwip_recvmmsg(s2, msgs, TEST_MMSG_COUNT, MSG_WAITFORONE);
+  fail_unless(ret == 2);
+  fail_unless(msgs[0].msg_len == 1);
+  fail_unless(msgs[1].msg_len == 2);
+
+  ret = lwip_close(s1);
+  fail_unless(ret == 0);
+  ret = lwip_close(s2);
+  fail_unless(ret == 0);
+}
+END_TEST
+#endif /* LWIP_SOCKET_MMSG */
+
 /** Create the suite including all tests for this module */
 Suite *
 sockets_suite(void)
@@ -838,6 +1080,12 @@ sockets_suite(void)
     TESTFUNC(test_sockets_msgapis),
     TESTFUNC(test_sockets_select),
     TESTFUNC(test_sockets_recv_after_rst),
+#if LWIP_SOCKET_RECV_PBUF
+    TESTFUNC(test_sockets_recv_pbuf),
+#endif
+#if LWIP_SOCKET_MMSG
+    TESTFUNC(test_sockets_mmsg),
+#endif
   };
   return create_suite("SOCKETS", tests, sizeof(tests)/sizeof(testfunc), sockets_setup, sockets_teardown);
 }
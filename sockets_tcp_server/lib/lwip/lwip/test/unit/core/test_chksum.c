@@ -0,0 +1,235 @@
+#include "test_chksum.h"
+
+#include "lwip/inet_chksum.h"
+#include "lwip/def.h"
+
+#include <string.h>
+#ifdef LWIP_UNITTESTS_BENCH
+#include <stdio.h>
+#include <time.h>
+#endif /* LWIP_UNITTESTS_BENCH */
+
+#define TEST_BUFSIZE          2048
+#define TEST_ALIGNMENTS       8
+
+static u8_t chksum_src[TEST_BUFSIZE + TEST_ALIGNMENTS];
+static u8_t chksum_dst[TEST_BUFSIZE + TEST_ALIGNMENTS];
+
+/* Setups/teardown functions */
+
+static void
+chksum_setup(void)
+{
+  size_t i;
+  u32_t seed = 0x12345678;
+
+  for (i = 0; i < sizeof(chksum_src); i++) {
+    seed = seed * 1103515245 + 12345;
+    chksum_src[i] = (u8_t)(seed >> 16);
+  }
+}
+
+static void
+chksum_teardown(void)
+{
+}
+
+/** Reference: octet by octet in network order, as lwip_standard_chksum version #1 */
+static u16_t
+chksum_ref(const u8_t *data, int len)
+{
+  u32_t acc = 0;
+
+  while (len > 1) {
+    acc += ((u32_t)data[0] << 8) | data[1];
+    data += 2;
+    len -= 2;
+  }
+  if (len > 0) {
+    acc += (u32_t)data[0] << 8;
+  }
+  while (acc >> 16) {
+    acc = (acc >> 16) + (acc & 0xffffUL);
+  }
+  return (u16_t)~lwip_htons((u16_t)acc);
+}
+
+static void
+check_chksum_len(int offset, int len)
+{
+  u16_t expected = chksum_ref(&chksum_src[offset], len);
+  u16_t chksum = inet_chksum(&chksum_src[offset], (u16_t)len);
+  fail_unless(chksum == expected, "offset %d len %d: 0x%04x != 0x%04x", offset, len, chksum, expected);
+}
+
+/* Test functions */
+
+START_TEST(test_chksum_alignment)
+{
+  int offset, len;
+  LWIP_UNUSED_ARG(_i);
+
+  for (offset = 0; offset < TEST_ALIGNMENTS; offset++) {
+    for (len = 0; len <= 300; len++) {
+      check_chksum_len(offset, len);
+    }
+    for (len = 300; len <= TEST_BUFSIZE; len += 37) {
+      check_chksum_len(offset, len);
+    }
+    check_chksum_len(offset, TEST_BUFSIZE);
+  }
+}
+END_TEST
+
+START_TEST(test_chksum_overflow)
+{
+  static u8_t buf[0xffff + TEST_ALIGNMENTS];
+  int offset;
+  LWIP_UNUSED_ARG(_i);
+
+  /* all ones in the longest buffer: the accumulators are closest to overflowing */
+  memset(buf, 0xff, sizeof(buf));
+  for (offset = 0; offset < TEST_ALIGNMENTS; offset++) {
+    fail_unless(inet_chksum(&buf[offset], 0xffff) == chksum_ref(&buf[offset], 0xffff));
+    fail_unless(inet_chksum(&buf[offset], 0xfffe) == chksum_ref(&buf[offset], 0xfffe));
+  }
+}
+END_TEST
+
+START_TEST(test_chksum_copy)
+{
+#if LWIP_CHKSUM_COPY_ALGORITHM
+  int src_offset, dst_offset, len;
+  LWIP_UNUSED_ARG(_i);
+
+  for (src_offset = 0; src_offset < 4; src_offset++) {
+    for (dst_offset = 0; dst_offset < 4; dst_offset++) {
+      for (len = 0; len <= 1500; len += (len < 70 ? 1 : 29)) {
+        u16_t chksum, sum;
+        memset(chksum_dst, 0, sizeof(chksum_dst));
+        chksum = lwip_chksum_copy(&chksum_dst[dst_offset], &chksum_src[src_offset], (u16_t)len);
+        fail_unless(memcmp(&chksum_dst[dst_offset], &chksum_src[src_offset], len) == 0);
+        /* nothing written out of bounds */
+        fail_unless(chksum_dst[dst_offset + len] == 0);
+        fail_unless(dst_offset == 0 || chksum_dst[dst_offset - 1] == 0);
+        /* lwip_chksum_copy() returns the non-inverted sum */
+        sum = (u16_t)~chksum;
+        fail_unless(sum == chksum_ref(&chksum_src[src_offset], len),
+                    "src %d dst %d len %d", src_offset, dst_offset, len);
+      }
+    }
+  }
+#else
+  LWIP_UNUSED_ARG(_i);
+#endif /* LWIP_CHKSUM_COPY_ALGORITHM */
+}
+END_TEST
+
+/** Create the suite including all tests for this module */
+Suite *
+chksum_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_chksum_alignment),
+    TESTFUNC(test_chksum_overflow),
+    TESTFUNC(test_chksum_copy)
+  };
+  return create_suite("CHKSUM", tests, sizeof(tests)/sizeof(testfunc), chksum_setup, chksum_teardown);
+}
+
+#ifdef LWIP_UNITTESTS_BENCH
+/** Baseline for the benchmark: two bytes at a time, as lwip_standard_chksum version #2 */
+static u16_t
+chksum_u16(const void *dataptr, int len)
+{
+  const u8_t *pb = (const u8_t *)dataptr;
+  const u16_t *ps;
+  u16_t t = 0;
+  u32_t sum = 0;
+  int odd = ((mem_ptr_t)pb & 1);
+
+  if (odd && len > 0) {
+    ((u8_t *)&t)[1] = *pb++;
+    len--;
+  }
+  ps = (const u16_t *)(const void *)pb;
+  while (len > 1) {
+    sum += *ps++;
+    len -= 2;
+  }
+  if (len > 0) {
+    ((u8_t *)&t)[0] = *(const u8_t *)ps;
+  }
+  sum += t;
+  sum = FOLD_U32T(sum);
+  sum = FOLD_U32T(sum);
+  if (odd) {
+    sum = SWAP_BYTES_IN_WORD(sum);
+  }
+  return (u16_t)~sum;
+}
+
+/** Throughput of the 16-bit baseline, inet_chksum, copy then sum, and lwip_chksum_copy at several packet sizes */
+START_TEST(test_chksum_benchmark)
+{
+  static const int sizes[] = { 20, 64, 256, 576, 1460, TEST_BUFSIZE };
+  const int bytes_per_size = 16 * 1024 * 1024;
+  volatile u16_t sink = 0;
+  size_t s;
+  LWIP_UNUSED_ARG(_i);
+
+  printf("%6s %14s %14s %14s %14s\n", "bytes", "u16 MB/s", "chksum MB/s", "copy+sum MB/s", "fused MB/s");
+  for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    int len = sizes[s];
+    int i, rounds = bytes_per_size / len;
+    double mb = (double)rounds * len / (1024 * 1024);
+    double elapsed[4];
+    clock_t start;
+
+    start = clock();
+    for (i = 0; i < rounds; i++) {
+      sink = (u16_t)(sink + chksum_u16(&chksum_src[i & 3], len));
+    }
+    elapsed[0] = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (i = 0; i < rounds; i++) {
+      sink = (u16_t)(sink + inet_chksum(&chksum_src[i & 3], (u16_t)len));
+    }
+    elapsed[1] = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    /* copy then sum, as the socket send path does without LWIP_CHECKSUM_ON_COPY */
+    start = clock();
+    for (i = 0; i < rounds; i++) {
+      MEMCPY(&chksum_dst[i & 3], &chksum_src[i & 3], len);
+      sink = (u16_t)(sink + inet_chksum(&chksum_dst[i & 3], (u16_t)len));
+    }
+    elapsed[2] = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+#if LWIP_CHKSUM_COPY_ALGORITHM
+    start = clock();
+    for (i = 0; i < rounds; i++) {
+      sink = (u16_t)(sink + lwip_chksum_copy(&chksum_dst[i & 3], &chksum_src[i & 3], (u16_t)len));
+    }
+    elapsed[3] = (double)(clock() - start) / CLOCKS_PER_SEC;
+#else
+    elapsed[3] = elapsed[2];
+#endif /* LWIP_CHKSUM_COPY_ALGORITHM */
+
+    printf("%6d %14.0f %14.0f %14.0f %14.0f\n", len, mb / elapsed[0], mb / elapsed[1],
+           mb / elapsed[2], mb / elapsed[3]);
+  }
+  LWIP_UNUSED_ARG(sink);
+}
+END_TEST
+
+/** Benchmarks, only built with LWIP_UNITTESTS_BENCH: they print timings and check nothing */
+Suite *
+chksum_bench_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_chksum_benchmark)
+  };
+  return create_suite("CHKSUM_BENCH", tests, sizeof(tests)/sizeof(testfunc), chksum_setup, chksum_teardown);
+}
+#endif /* LWIP_UNITTESTS_BENCH */
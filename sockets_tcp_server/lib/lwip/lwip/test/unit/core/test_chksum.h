@@ -0,0 +1,11 @@
+#ifndef LWIP_HDR_TEST_CHKSUM_H
+#define LWIP_HDR_TEST_CHKSUM_H
+
+#include "../lwip_check.h"
+
+Suite *chksum_suite(void);
+#ifdef LWIP_UNITTESTS_BENCH
+Suite *chksum_bench_suite(void);
+#endif /* LWIP_UNITTESTS_BENCH */
+
+#endif
@@ -0,0 +1,119 @@
+#include "test_memp.h"
+
+#include "lwip/memp.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+#include "lwip/priv/tcp_priv.h"
+
+#if !LWIP_STATS || !MEMP_STATS
+#error "This tests needs MEMP-statistics enabled"
+#endif
+
+/* Setups/teardown functions */
+
+static void
+memp_setup(void)
+{
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT) | SKIP_HEAP);
+}
+
+static void
+memp_teardown(void)
+{
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT) | SKIP_HEAP);
+}
+
+
+/* Test functions */
+
+/** The element freed last is handed out first, whatever the allocator */
+START_TEST(test_memp_reuse)
+{
+  void *p1, *p2;
+  LWIP_UNUSED_ARG(_i);
+
+  p1 = memp_malloc(MEMP_TCP_SEG);
+  fail_unless(p1 != NULL);
+  fail_unless(MEMP_STATS_GET(used, MEMP_TCP_SEG) == 1);
+  memp_free(MEMP_TCP_SEG, p1);
+  fail_unless(MEMP_STATS_GET(used, MEMP_TCP_SEG) == 0);
+
+#if MEMP_MEM_MALLOC && (MEMP_NUM_TCP_SEG_RESERVED == 0)
+  /* the heap may give back anything */
+  LWIP_UNUSED_ARG(p2);
+#else
+  p2 = memp_malloc(MEMP_TCP_SEG);
+  fail_unless(p2 == p1);
+  memp_free(MEMP_TCP_SEG, p2);
+#endif
+}
+END_TEST
+
+/** Reserved elements are used before the heap, which is only a fallback */
+START_TEST(test_memp_reserve)
+{
+#if MEMP_MEM_MALLOC_RESERVE && (MEMP_NUM_TCP_SEG_RESERVED > 0) && (MEMP_NUM_PBUF_RESERVED > 0)
+#define EXTRA 3
+  void *segs[MEMP_NUM_TCP_SEG_RESERVED + EXTRA];
+  struct pbuf *p[MEMP_NUM_PBUF_RESERVED + 1];
+  STAT_COUNTER heap;
+  int i, round;
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(MEMP_STATS_GET(avail, MEMP_TCP_SEG) == MEMP_NUM_TCP_SEG_RESERVED);
+  fail_unless(MEMP_STATS_GET(avail, MEMP_PBUF) == MEMP_NUM_PBUF_RESERVED);
+
+  heap = MEMP_STATS_GET(heap, MEMP_TCP_SEG);
+  for (round = 0; round < 2; round++) {
+    for (i = 0; i < MEMP_NUM_TCP_SEG_RESERVED; i++) {
+      segs[i] = memp_malloc(MEMP_TCP_SEG);
+      fail_unless(segs[i] != NULL);
+      fail_unless(MEMP_STATS_GET(heap, MEMP_TCP_SEG) == heap);
+    }
+    /* the reserve is exhausted: fall back to the heap */
+    for (; i < MEMP_NUM_TCP_SEG_RESERVED + EXTRA; i++) {
+      segs[i] = memp_malloc(MEMP_TCP_SEG);
+      fail_unless(segs[i] != NULL);
+      fail_unless(MEMP_STATS_GET(heap, MEMP_TCP_SEG) == heap + (STAT_COUNTER)(i + 1 - MEMP_NUM_TCP_SEG_RESERVED));
+    }
+    fail_unless(MEMP_STATS_GET(used, MEMP_TCP_SEG) == MEMP_NUM_TCP_SEG_RESERVED + EXTRA);
+    fail_unless(MEMP_STATS_GET(max, MEMP_TCP_SEG) >= MEMP_NUM_TCP_SEG_RESERVED + EXTRA);
+    /* free them interleaved, heap and reserved elements go where they came from */
+    for (i = 0; i < MEMP_NUM_TCP_SEG_RESERVED + EXTRA; i += 2) {
+      memp_free(MEMP_TCP_SEG, segs[i]);
+    }
+    for (i = 1; i < MEMP_NUM_TCP_SEG_RESERVED + EXTRA; i += 2) {
+      memp_free(MEMP_TCP_SEG, segs[i]);
+    }
+    fail_unless(MEMP_STATS_GET(used, MEMP_TCP_SEG) == 0);
+    heap = MEMP_STATS_GET(heap, MEMP_TCP_SEG);
+  }
+
+  /* same through the pbuf API */
+  heap = MEMP_STATS_GET(heap, MEMP_PBUF);
+  for (i = 0; i <= MEMP_NUM_PBUF_RESERVED; i++) {
+    p[i] = pbuf_alloc(PBUF_RAW, 0, PBUF_REF);
+    fail_unless(p[i] != NULL);
+  }
+  fail_unless(MEMP_STATS_GET(heap, MEMP_PBUF) == heap + 1);
+  for (i = 0; i <= MEMP_NUM_PBUF_RESERVED; i++) {
+    pbuf_free(p[i]);
+  }
+  fail_unless(MEMP_STATS_GET(used, MEMP_PBUF) == 0);
+#undef EXTRA
+#else
+  LWIP_UNUSED_ARG(_i);
+#endif /* MEMP_MEM_MALLOC_RESERVE */
+}
+END_TEST
+
+/** Create the suite including all tests for this module */
+Suite *
+memp_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_memp_reuse),
+    TESTFUNC(test_memp_reserve)
+  };
+  return create_suite("MEMP", tests, sizeof(tests)/sizeof(testfunc), memp_setup, memp_teardown);
+}
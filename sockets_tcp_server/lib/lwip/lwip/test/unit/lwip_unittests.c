@@ -5,8 +5,11 @@
 #include "udp/test_udp.h"
 #include "tcp/test_tcp.h"
 #include "tcp/test_tcp_oos.h"
+#include "tcp/test_tcp_sack.h"
+#include "core/test_chksum.h"
 #include "core/test_def.h"
 #include "core/test_mem.h"
+#include "core/test_memp.h"
 #include "core/test_netif.h"
 #include "core/test_pbuf.h"
 #include "core/test_timers.h"
@@ -67,8 +70,11 @@ int main(void)
     udp_suite,
     tcp_suite,
     tcp_oos_suite,
+    tcp_sack_suite,
+    chksum_suite,
     def_suite,
     mem_suite,
+    memp_suite,
     netif_suite,
     pbuf_suite,
     timers_suite,
@@ -77,6 +83,11 @@ int main(void)
     mdns_suite,
     mqtt_suite,
     sockets_suite
+#ifdef LWIP_UNITTESTS_BENCH
+    /* Benchmarks printing timings, left out of the check suite by default */
+    , chksum_bench_suite
+    , tcp_bench_suite
+#endif /* LWIP_UNITTESTS_BENCH */
   };
   size_t num = sizeof(suites)/sizeof(void*);
   LWIP_ASSERT("No suites defined", num > 0);
@@ -37,6 +37,12 @@
 #define LWIP_IPV6                       1
 
 #define LWIP_CHECKSUM_ON_COPY           1
+#ifndef LWIP_CHKSUM_ALGORITHM
+#define LWIP_CHKSUM_ALGORITHM           4
+#endif
+#ifndef LWIP_CHKSUM_COPY_ALGORITHM
+#define LWIP_CHKSUM_COPY_ALGORITHM      2
+#endif
 #define TCP_CHECKSUM_ON_COPY_SANITY_CHECK 1
 #define TCP_CHECKSUM_ON_COPY_SANITY_CHECK_FAIL(printfmsg) LWIP_ASSERT("TCP_CHECKSUM_ON_COPY_SANITY_CHECK_FAIL", 0)
 
@@ -47,6 +53,8 @@
 #define LWIP_SOCKET                     !NO_SYS
 #define LWIP_NETCONN_FULLDUPLEX         LWIP_SOCKET
 #define LWIP_NETBUF_RECVINFO            1
+#define LWIP_SOCKET_RECV_PBUF           1
+#define LWIP_SOCKET_MMSG                1
 #define LWIP_HAVE_LOOPIF                1
 #define TCPIP_THREAD_TEST
 
@@ -61,7 +69,17 @@
 #define TCP_WND                         (10 * TCP_MSS)
 #define LWIP_WND_SCALE                  1
 #define TCP_RCV_SCALE                   0
+#define LWIP_TCP_SACK_OUT               1
+#define LWIP_TCP_SACK_IN                1
 #define PBUF_POOL_SIZE                  400 /* pbuf tests need ~200KByte */
+#define MEMP_NUM_TCP_PCB                255 /* tcp demux test and benchmark, tcp_pcb_num_t counts in u8_t */
+#define MEMP_NUM_NETBUF                 16  /* sockets mmsg test receives a batch */
+
+/* Find the PCBs of incoming segments through the hash table, can be overridden
+   (e.g. -DLWIP_TCP_PCB_HASH=0) to compare with the list walk in the LWIP_UNITTESTS_BENCH benchmark */
+#ifndef LWIP_TCP_PCB_HASH
+#define LWIP_TCP_PCB_HASH               1
+#endif
 
 /* Enable IGMP and MDNS for MDNS tests */
 #define LWIP_IGMP                       1
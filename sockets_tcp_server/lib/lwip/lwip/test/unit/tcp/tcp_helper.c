@@ -158,22 +158,23 @@ tcp_set_state(struct tcp_pcb* pcb, enum tcp_state state, const ip_addr_t* local_
   pcb->lastack = iss;
   pcb->snd_lbb = iss;
   
+  /* the addresses and ports are set before registering: they are the key of the pcb hash */
   if (state == ESTABLISHED) {
-    TCP_REG(&tcp_active_pcbs, pcb);
     ip_addr_copy(pcb->local_ip, *local_ip);
     pcb->local_port = local_port;
     ip_addr_copy(pcb->remote_ip, *remote_ip);
     pcb->remote_port = remote_port;
+    TCP_REG(&tcp_active_pcbs, pcb);
   } else if(state == LISTEN) {
     TCP_REG(&tcp_listen_pcbs.pcbs, pcb);
     ip_addr_copy(pcb->local_ip, *local_ip);
     pcb->local_port = local_port;
   } else if(state == TIME_WAIT) {
-    TCP_REG(&tcp_tw_pcbs, pcb);
     ip_addr_copy(pcb->local_ip, *local_ip);
     pcb->local_port = local_port;
     ip_addr_copy(pcb->remote_ip, *remote_ip);
     pcb->remote_port = remote_port;
+    TCP_REG(&tcp_tw_pcbs, pcb);
   } else {
     fail();
   }
@@ -5,6 +5,11 @@
 #include "tcp_helper.h"
 #include "lwip/inet_chksum.h"
 
+#ifdef LWIP_UNITTESTS_BENCH
+#include <stdio.h>
+#include <time.h>
+#endif /* LWIP_UNITTESTS_BENCH */
+
 #ifdef _MSC_VER
 #pragma warning(disable: 4307) /* we explicitly wrap around TCP seqnos */
 #endif
@@ -1664,6 +1669,120 @@ START_TEST(test_tcp_persist_split)
 }
 END_TEST
 
+/** Check that segments are delivered to the right pcb among pcbs sharing parts of
+ * their 4-tuple, including TIME-WAIT and removed pcbs */
+START_TEST(test_tcp_demux)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters[5];
+  struct tcp_pcb *pcbs[5];
+  ip_addr_t local_ip = test_local_ip;
+  ip_addr_t remote_ip = test_remote_ip;
+  ip_addr_t remote_ip2 = IPADDR4_INIT_BYTES(192, 168, 1, 3);
+  char data[] = {1, 2, 3, 4};
+  struct pbuf *p;
+  int i, j;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  for (i = 0; i < 5; i++) {
+    memset(&counters[i], 0, sizeof(counters[i]));
+    pcbs[i] = test_tcp_new_counters_pcb(&counters[i]);
+    EXPECT_RET(pcbs[i] != NULL);
+  }
+  /* pcbs 0 and 1 only differ by the remote port, 1 and 2 by the remote address,
+     0 and 3 by the local port, and 4 is in TIME-WAIT */
+  tcp_set_state(pcbs[0], ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+  tcp_set_state(pcbs[1], ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, TEST_REMOTE_PORT + 1);
+  tcp_set_state(pcbs[2], ESTABLISHED, &test_local_ip, &remote_ip2, TEST_LOCAL_PORT, TEST_REMOTE_PORT + 1);
+  tcp_set_state(pcbs[3], ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT + 1, TEST_REMOTE_PORT);
+  tcp_set_state(pcbs[4], TIME_WAIT, &test_local_ip, &remote_ip2, TEST_LOCAL_PORT, TEST_REMOTE_PORT);
+
+  for (i = 0; i < 4; i++) {
+    for (j = 0; j <= i; j++) {
+      p = tcp_create_rx_segment(pcbs[i], data, sizeof(data), 0, 0, 0);
+      EXPECT_RET(p != NULL);
+      test_tcp_input(p, &netif);
+    }
+  }
+  for (i = 0; i < 4; i++) {
+    EXPECT(counters[i].recv_calls == (u32_t)i + 1);
+    EXPECT(counters[i].recved_bytes == (i + 1) * sizeof(data));
+  }
+
+  /* data to the TIME-WAIT pcb is acknowledged, not delivered */
+  txcounters.num_tx_calls = 0;
+  p = tcp_create_rx_segment(pcbs[4], data, sizeof(data), 0, 0, 0);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(txcounters.num_tx_calls == 1);
+  EXPECT(counters[4].recv_calls == 0);
+
+  /* a removed pcb is not found anymore: the segment is answered with a RST */
+  tcp_abort(pcbs[1]);
+  EXPECT(counters[1].err_calls == 1);
+  txcounters.num_tx_calls = 0;
+  p = tcp_create_segment(&remote_ip, &local_ip, TEST_REMOTE_PORT + 1, TEST_LOCAL_PORT,
+                         data, sizeof(data), 0, 0, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(txcounters.num_tx_calls == 1);
+  for (i = 0; i < 4; i++) {
+    EXPECT(counters[i].recv_calls == (u32_t)i + 1);
+  }
+
+  tcp_abort(pcbs[0]);
+  tcp_abort(pcbs[2]);
+  tcp_abort(pcbs[3]);
+  tcp_abort(pcbs[4]);
+  EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 0);
+}
+END_TEST
+
+/** Check that segments are delivered to the right pcb with a growing number of connections.
+ * Segments are sent to the connections in turn, moving each pcb out of the front of the list. */
+START_TEST(test_tcp_demux_many)
+{
+  static const int connection_counts[] = { 4, 32, MEMP_NUM_TCP_PCB };
+  static struct test_tcp_counters counters[MEMP_NUM_TCP_PCB];
+  static struct tcp_pcb *pcbs[MEMP_NUM_TCP_PCB];
+  const int rounds = 4;
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  char data = 0x55;
+  size_t c;
+  int i, n, round;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  for (c = 0; c < sizeof(connection_counts) / sizeof(connection_counts[0]); c++) {
+    n = connection_counts[c];
+    for (i = 0; i < n; i++) {
+      memset(&counters[i], 0, sizeof(counters[i]));
+      pcbs[i] = test_tcp_new_counters_pcb(&counters[i]);
+      EXPECT_RET(pcbs[i] != NULL);
+      tcp_set_state(pcbs[i], ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, (u16_t)(TEST_REMOTE_PORT + i));
+    }
+
+    for (round = 0; round < rounds; round++) {
+      for (i = 0; i < n; i++) {
+        struct pbuf *p = tcp_create_rx_segment(pcbs[i], &data, 1, 0, 0, 0);
+        EXPECT_RET(p != NULL);
+        test_tcp_input(p, &netif);
+      }
+    }
+
+    for (i = 0; i < n; i++) {
+      EXPECT(counters[i].recv_calls == (u32_t)rounds);
+      EXPECT(counters[i].recved_bytes == (u32_t)rounds);
+      tcp_abort(pcbs[i]);
+    }
+    EXPECT(MEMP_STATS_GET(used, MEMP_TCP_PCB) == 0);
+  }
+}
+END_TEST
+
 /** Create the suite including all tests for this module */
 Suite *
 tcp_suite(void)
@@ -1689,7 +1808,71 @@ tcp_suite(void)
     TESTFUNC(test_tcp_rto_timeout_syn_sent_link_down),
     TESTFUNC(test_tcp_zwp_timeout),
     TESTFUNC(test_tcp_zwp_timeout_link_down),
-    TESTFUNC(test_tcp_persist_split)
+    TESTFUNC(test_tcp_persist_split),
+    TESTFUNC(test_tcp_demux),
+    TESTFUNC(test_tcp_demux_many)
   };
   return create_suite("TCP", tests, sizeof(tests)/sizeof(testfunc), tcp_setup, tcp_teardown);
 }
+
+#ifdef LWIP_UNITTESTS_BENCH
+/** Measure the cost of tcp_input with a growing number of connections. Segments are sent
+ * to the connections in turn, the worst case for the move-to-front list walk.
+ * Build once with -DLWIP_TCP_PCB_HASH=0 to compare the list walk with the hash table. */
+START_TEST(test_tcp_demux_benchmark)
+{
+  static const int connection_counts[] = { 4, 32, MEMP_NUM_TCP_PCB };
+  static struct test_tcp_counters counters[MEMP_NUM_TCP_PCB];
+  static struct tcp_pcb *pcbs[MEMP_NUM_TCP_PCB];
+  const int segments = 16384;
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  char data = 0x55;
+  size_t c;
+  int i, n, round, rounds;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tcp_init_netif(&netif, &txcounters, &test_local_ip, &test_netmask);
+  for (c = 0; c < sizeof(connection_counts) / sizeof(connection_counts[0]); c++) {
+    clock_t start;
+    double us_per_segment;
+    n = connection_counts[c];
+    rounds = segments / n;
+    for (i = 0; i < n; i++) {
+      memset(&counters[i], 0, sizeof(counters[i]));
+      pcbs[i] = test_tcp_new_counters_pcb(&counters[i]);
+      EXPECT_RET(pcbs[i] != NULL);
+      tcp_set_state(pcbs[i], ESTABLISHED, &test_local_ip, &test_remote_ip, TEST_LOCAL_PORT, (u16_t)(TEST_REMOTE_PORT + i));
+    }
+
+    start = clock();
+    for (round = 0; round < rounds; round++) {
+      for (i = 0; i < n; i++) {
+        struct pbuf *p = tcp_create_rx_segment(pcbs[i], &data, 1, 0, 0, 0);
+        EXPECT_RET(p != NULL);
+        test_tcp_input(p, &netif);
+        /* the window is not moved, keep it open */
+        pcbs[i]->rcv_wnd = pcbs[i]->rcv_ann_wnd = TCP_WND;
+      }
+    }
+    us_per_segment = (double)(clock() - start) * 1000000.0 / CLOCKS_PER_SEC / (rounds * n);
+    printf("tcp_input with %d connections (%s): %.3f us/segment\n", n,
+           LWIP_TCP_PCB_HASH ? "hash" : "list", us_per_segment);
+
+    for (i = 0; i < n; i++) {
+      tcp_abort(pcbs[i]);
+    }
+  }
+}
+END_TEST
+
+/** Benchmarks, only built with LWIP_UNITTESTS_BENCH: they print timings and check nothing */
+Suite *
+tcp_bench_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_tcp_demux_benchmark)
+  };
+  return create_suite("TCP_BENCH", tests, sizeof(tests)/sizeof(testfunc), tcp_setup, tcp_teardown);
+}
+#endif /* LWIP_UNITTESTS_BENCH */
@@ -4,5 +4,8 @@
 #include "../lwip_check.h"
 
 Suite *tcp_suite(void);
+#ifdef LWIP_UNITTESTS_BENCH
+Suite *tcp_bench_suite(void);
+#endif /* LWIP_UNITTESTS_BENCH */
 
 #endif
@@ -0,0 +1,402 @@
+#include "test_tcp_sack.h"
+
+#include "lwip/priv/tcp_priv.h"
+#include "lwip/stats.h"
+#include "lwip/tcpip.h"
+#include "lwip/prot/ip4.h"
+#include "tcp_helper.h"
+
+#if !LWIP_STATS || !TCP_STATS || !MEMP_STATS || !MIB2_STATS
+#error "This tests needs TCP-, MEMP- and MIB2-statistics enabled"
+#endif
+#if !LWIP_TCP_SACK_IN || !TCP_QUEUE_OOSEQ
+#error "This tests needs LWIP_TCP_SACK_IN and TCP_QUEUE_OOSEQ enabled"
+#endif
+
+/* The connection runs between two pcbs of this stack, over a simulated link:
+   packets are queued by the netif and delivered after a delay, the data
+   segments may be dropped. Time is simulated in milliseconds. */
+#define LINK_DELAY_MS       10  /* one way */
+#define LINK_DATA_MS        1   /* serialization of a data segment */
+#define LINK_QUEUE_LEN      64
+#define LINK_MAX_TIME_MS    600000
+#define SERVER_PORT         0x200
+
+static const ip_addr_t link_netif_ip = IPADDR4_INIT_BYTES(192, 168, 1, 3);
+
+struct link_packet {
+  struct pbuf *p;
+  u32_t due;
+};
+
+static struct {
+  struct netif netif;
+  struct link_packet queue[LINK_QUEUE_LEN];
+  u32_t now;
+  u32_t data_free;           /* time at which the link can send the next data segment */
+  u32_t loss_permille;       /* random loss of data segments */
+  u32_t rand;
+  const u32_t *drop_segs;    /* first transmissions to drop, by index (ascending) */
+  u32_t new_segs;            /* first transmissions seen */
+  u32_t snd_max;
+  u32_t dropped;
+  u8_t rexmit_dupacks;       /* duplicate ACKs received by the client at the first retransmission */
+  struct tcp_pcb *server;
+  struct tcp_pcb *client;
+  u32_t total;
+  u32_t written;
+  u32_t received;
+  u8_t data_error;
+} sack_link;
+
+/* Setups/teardown functions */
+static struct netif *old_netif_list;
+static struct netif *old_netif_default;
+
+static void
+tcp_sack_setup(void)
+{
+  old_netif_list = netif_list;
+  old_netif_default = netif_default;
+  netif_list = NULL;
+  netif_default = NULL;
+  tcp_remove_all();
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+static void
+tcp_sack_teardown(void)
+{
+  netif_list = NULL;
+  netif_default = NULL;
+  tcp_remove_all();
+  /* restore netif_list for next tests (e.g. loopif) */
+  netif_list = old_netif_list;
+  netif_default = old_netif_default;
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+/* helper functions */
+
+/** Get the payload length and the seqno of a TCP segment queued on the link */
+static u16_t
+link_datalen(struct pbuf *p, u32_t *seqno)
+{
+  struct ip_hdr iphdr;
+  struct tcp_hdr tcphdr;
+  u16_t iphlen;
+
+  pbuf_copy_partial(p, &iphdr, sizeof(iphdr), 0);
+  iphlen = (u16_t)IPH_HL_BYTES(&iphdr);
+  pbuf_copy_partial(p, &tcphdr, sizeof(tcphdr), iphlen);
+  *seqno = lwip_ntohl(tcphdr.seqno);
+  return (u16_t)(lwip_ntohs(IPH_LEN(&iphdr)) - iphlen - TCPH_HDRLEN_BYTES(&tcphdr));
+}
+
+/** Decide whether a data segment is lost: either a given first transmission
+ * or randomly. Handshake, ACKs and RSTs are never lost. */
+static u8_t
+link_drop(u16_t datalen, u32_t seqno)
+{
+  if (datalen == 0) {
+    return 0;
+  }
+  if (TCP_SEQ_GT(seqno + datalen, sack_link.snd_max)) {
+    u32_t index = sack_link.new_segs++;
+    sack_link.snd_max = seqno + datalen;
+    if ((sack_link.drop_segs != NULL) && (*sack_link.drop_segs == index)) {
+      sack_link.drop_segs++;
+      return 1;
+    }
+  }
+  if (sack_link.loss_permille) {
+    sack_link.rand = sack_link.rand * 1103515245 + 12345;
+    return ((sack_link.rand >> 16) % 1000) < sack_link.loss_permille;
+  }
+  return 0;
+}
+
+static err_t
+link_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr)
+{
+  struct pbuf *q;
+  u32_t seqno, due = sack_link.now + LINK_DELAY_MS;
+  u16_t datalen = link_datalen(p, &seqno);
+  int i;
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(ipaddr);
+
+  if (datalen > 0) {
+    /* data segments share the link bandwidth */
+    if (TCP_SEQ_LT(sack_link.data_free, sack_link.now)) {
+      sack_link.data_free = sack_link.now;
+    }
+    sack_link.data_free += LINK_DATA_MS;
+    due = sack_link.data_free + LINK_DELAY_MS;
+  }
+  if ((datalen > 0) && TCP_SEQ_LEQ(seqno + datalen, sack_link.snd_max) && (sack_link.rexmit_dupacks == 0)) {
+    sack_link.rexmit_dupacks = sack_link.client->dupacks;
+  }
+  if (link_drop(datalen, seqno)) {
+    sack_link.dropped++;
+    return ERR_OK;
+  }
+  for (i = 0; i < LINK_QUEUE_LEN; i++) {
+    if (sack_link.queue[i].p == NULL) {
+      break;
+    }
+  }
+  EXPECT_RETX(i < LINK_QUEUE_LEN, ERR_OK);
+  q = pbuf_alloc(PBUF_RAW, p->tot_len, PBUF_POOL);
+  EXPECT_RETX(q != NULL, ERR_OK);
+  pbuf_copy(q, p);
+  sack_link.queue[i].p = q;
+  sack_link.queue[i].due = due;
+  return ERR_OK;
+}
+
+/** Deliver the packets which are due, the oldest first */
+static void
+link_deliver(void)
+{
+  for (;;) {
+    int i, next = -1;
+    struct pbuf *p;
+    for (i = 0; i < LINK_QUEUE_LEN; i++) {
+      if ((sack_link.queue[i].p != NULL) && TCP_SEQ_LEQ(sack_link.queue[i].due, sack_link.now) &&
+          ((next < 0) || TCP_SEQ_LT(sack_link.queue[i].due, sack_link.queue[next].due))) {
+        next = i;
+      }
+    }
+    if (next < 0) {
+      return;
+    }
+    p = sack_link.queue[next].p;
+    sack_link.queue[next].p = NULL;
+    test_tcp_input(p, &sack_link.netif);
+  }
+}
+
+static void
+link_flush(void)
+{
+  int i;
+  for (i = 0; i < LINK_QUEUE_LEN; i++) {
+    if (sack_link.queue[i].p != NULL) {
+      pbuf_free(sack_link.queue[i].p);
+      sack_link.queue[i].p = NULL;
+    }
+  }
+}
+
+/* the receiver checks that byte n of the stream is (u8_t)n */
+static err_t
+server_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+  struct pbuf *q;
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(err);
+  if (p == NULL) {
+    return ERR_OK;
+  }
+  for (q = p; q != NULL; q = q->next) {
+    u16_t i;
+    for (i = 0; i < q->len; i++) {
+      if (((u8_t *)q->payload)[i] != (u8_t)(sack_link.received + i)) {
+        sack_link.data_error = 1;
+      }
+    }
+    sack_link.received += q->len;
+  }
+  tcp_recved(pcb, p->tot_len);
+  pbuf_free(p);
+  return ERR_OK;
+}
+
+static err_t
+server_accept(void *arg, struct tcp_pcb *newpcb, err_t err)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(err);
+  sack_link.server = newpcb;
+  tcp_recv(newpcb, server_recv);
+  return ERR_OK;
+}
+
+/** Queue as much of the data as the send buffer takes */
+static void
+client_send(void)
+{
+  static u8_t buf[TCP_SND_BUF];
+  u16_t len = (u16_t)LWIP_MIN(tcp_sndbuf(sack_link.client), sack_link.total - sack_link.written);
+  u16_t i;
+
+  if ((len == 0) || (tcp_sndqueuelen(sack_link.client) >= TCP_SND_QUEUELEN - 1)) {
+    return;
+  }
+  for (i = 0; i < len; i++) {
+    buf[i] = (u8_t)(sack_link.written + i);
+  }
+  if (tcp_write(sack_link.client, buf, len, TCP_WRITE_FLAG_COPY) == ERR_OK) {
+    sack_link.written += len;
+  }
+  tcp_output(sack_link.client);
+}
+
+/** Transfer 'total' bytes from a client to a server pcb over the simulated link
+ *
+ * @param total number of bytes to transfer
+ * @param sack 0 to disable SACK on both pcbs once connected
+ * @param slowtmr 0 to never call tcp_slowtmr (no retransmission timeouts)
+ * @return the time of the transfer in (simulated) milliseconds
+ */
+static u32_t
+sack_link_transfer(u32_t total, u8_t sack, u8_t slowtmr)
+{
+  struct tcp_pcb *listener;
+  err_t err;
+  u32_t started = 0;
+
+  /* the netif address is neither of the pcbs' addresses, so that packets
+     are not looped back */
+  test_tcp_init_netif(&sack_link.netif, NULL, &link_netif_ip, &test_netmask);
+  sack_link.netif.output = link_output;
+  sack_link.total = total;
+
+  LOCK_TCPIP_CORE();
+  listener = tcp_new();
+  EXPECT(listener != NULL);
+  err = tcp_bind(listener, IP_ADDR_ANY, SERVER_PORT);
+  EXPECT(err == ERR_OK);
+  listener = tcp_listen(listener);
+  EXPECT(listener != NULL);
+  tcp_accept(listener, server_accept);
+
+  sack_link.client = tcp_new();
+  EXPECT(sack_link.client != NULL);
+  tcp_nagle_disable(sack_link.client);
+  err = tcp_bind(sack_link.client, &test_local_ip, 0);
+  EXPECT(err == ERR_OK);
+  err = tcp_connect(sack_link.client, &test_remote_ip, SERVER_PORT, NULL);
+  EXPECT(err == ERR_OK);
+
+  for (sack_link.now = 0; sack_link.now < LINK_MAX_TIME_MS; sack_link.now++) {
+    link_deliver();
+    if ((sack_link.server != NULL) && (started == 0)) {
+      /* SACK_PERM was exchanged in the handshake */
+      EXPECT(sack_link.client->flags & TF_SACK);
+      EXPECT(sack_link.server->flags & TF_SACK);
+      if (!sack) {
+        tcp_clear_flags(sack_link.client, TF_SACK);
+        tcp_clear_flags(sack_link.server, TF_SACK);
+      }
+      started = sack_link.now;
+    }
+    if (sack_link.received == total) {
+      break;
+    }
+    if (sack_link.client->state == ESTABLISHED) {
+      client_send();
+    }
+    if ((sack_link.now % TCP_FAST_INTERVAL) == 0) {
+      tcp_fasttmr();
+      if (slowtmr && ((sack_link.now % TCP_SLOW_INTERVAL) == 0)) {
+        tcp_slowtmr();
+      }
+    }
+  }
+  EXPECT(sack_link.received == total);
+  EXPECT(sack_link.data_error == 0);
+
+  tcp_abort(sack_link.client);
+  if (sack_link.server != NULL) {
+    tcp_abort(sack_link.server);
+  }
+  tcp_close(listener);
+  UNLOCK_TCPIP_CORE();
+  link_flush();
+  return sack_link.now - started;
+}
+
+/* Test functions */
+
+/** Several segments lost in one window are all repaired by SACK based
+ * recovery: the retransmission timer never runs (tcp_slowtmr isn't called) */
+START_TEST(test_tcp_sack_multiple_holes)
+{
+  static const u32_t drop_segs[] = { 12, 15, 18, 0xFFFFFFFF };
+  u32_t retrans;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(&sack_link, 0, sizeof(sack_link));
+  sack_link.drop_segs = drop_segs;
+  retrans = lwip_stats.mib2.tcpretranssegs;
+  sack_link_transfer(40 * TCP_MSS, 1, 0);
+  EXPECT(sack_link.dropped == 3);
+  /* only the lost segments were sent again */
+  EXPECT(lwip_stats.mib2.tcpretranssegs - retrans == 3);
+}
+END_TEST
+
+/** The first unacked segment is retransmitted as soon as the third duplicate
+ * ACK arrives, even if the data still in flight exceeds the reduced cwnd */
+START_TEST(test_tcp_sack_rexmit_on_third_dupack)
+{
+  static const u32_t drop_segs[] = { 30, 0xFFFFFFFF };
+  LWIP_UNUSED_ARG(_i);
+
+  memset(&sack_link, 0, sizeof(sack_link));
+  sack_link.drop_segs = drop_segs;
+  sack_link_transfer(60 * TCP_MSS, 1, 0);
+  EXPECT(sack_link.dropped == 1);
+  EXPECT(sack_link.rexmit_dupacks == 3);
+}
+END_TEST
+
+/** SACK blocks are ignored if SACK was not negotiated: the holes are
+ * repaired one after the other, with the retransmission timer */
+START_TEST(test_tcp_sack_not_negotiated)
+{
+  static const u32_t drop_segs[] = { 12, 15, 18, 0xFFFFFFFF };
+  LWIP_UNUSED_ARG(_i);
+
+  memset(&sack_link, 0, sizeof(sack_link));
+  sack_link.drop_segs = drop_segs;
+  sack_link_transfer(40 * TCP_MSS, 0, 1);
+  EXPECT(sack_link.dropped == 3);
+}
+END_TEST
+
+/** A transfer over a lossy link is faster with SACK than without */
+START_TEST(test_tcp_sack_lossy_link)
+{
+  static const u32_t loss_permille[] = { 10, 20, 30, 50 };
+  const u32_t total = 400 * TCP_MSS;
+  u32_t sum_sack = 0, sum_nosack = 0;
+  size_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < sizeof(loss_permille) / sizeof(loss_permille[0]); i++) {
+    memset(&sack_link, 0, sizeof(sack_link));
+    sack_link.loss_permille = loss_permille[i];
+    sum_sack += sack_link_transfer(total, 1, 1);
+    memset(&sack_link, 0, sizeof(sack_link));
+    sack_link.loss_permille = loss_permille[i];
+    sum_nosack += sack_link_transfer(total, 0, 1);
+  }
+  EXPECT(sum_sack < sum_nosack);
+}
+END_TEST
+
+/** Create the suite including all tests for this module */
+Suite *
+tcp_sack_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_tcp_sack_multiple_holes),
+    TESTFUNC(test_tcp_sack_rexmit_on_third_dupack),
+    TESTFUNC(test_tcp_sack_not_negotiated),
+    TESTFUNC(test_tcp_sack_lossy_link)
+  };
+  return create_suite("TCP_SACK", tests, sizeof(tests)/sizeof(testfunc), tcp_sack_setup, tcp_sack_teardown);
+}
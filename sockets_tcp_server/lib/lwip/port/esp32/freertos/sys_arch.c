@@ -39,6 +39,7 @@
 #include "lwip/mem.h"
 #include "arch/sys_arch.h"
 #include "lwip/stats.h"
+#include "lwip/tcpip.h"
 #include "esp_log.h"
 #include "esp_compiler.h"
 
@@ -49,6 +50,11 @@ static sys_mutex_t g_lwip_protect_mutex = NULL;
 static pthread_key_t sys_thread_sem_key;
 static void sys_thread_sem_free(void* data);
 
+static sys_thread_t s_tcpip_thread = NULL;
+#if LWIP_TCPIP_CORE_LOCKING
+static sys_thread_t s_core_lock_holder = NULL;
+#endif
+
 #if !LWIP_COMPAT_MUTEX
 
 /**
@@ -548,6 +554,72 @@ sys_thread_sem_deinit(void)
   }
 }
 
+#if LWIP_TCPIP_CORE_LOCKING
+/**
+ * @brief Lock the TCP/IP core
+ *
+ * lock_tcpip_core is a FreeRTOS mutex, so a low priority task holding it is raised to
+ * the priority of the tcpip thread (or of any other task) waiting for it. The holder is
+ * recorded to check the lock is taken where the core is accessed.
+ */
+void
+sys_lock_tcpip_core(void)
+{
+  sys_mutex_lock(&lock_tcpip_core);
+  s_core_lock_holder = xTaskGetCurrentTaskHandle();
+}
+
+/**
+ * @brief Unlock the TCP/IP core
+ */
+void
+sys_unlock_tcpip_core(void)
+{
+  LWIP_ASSERT("core lock released by a task not holding it",
+              s_core_lock_holder == xTaskGetCurrentTaskHandle());
+  s_core_lock_holder = NULL;
+  sys_mutex_unlock(&lock_tcpip_core);
+}
+
+/**
+ * @brief Check if the calling task holds the TCP/IP core lock
+ *
+ * @return 1 if it does, 0 otherwise
+ */
+int
+sys_tcpip_core_locked(void)
+{
+  return s_core_lock_holder == xTaskGetCurrentTaskHandle();
+}
+#endif /* LWIP_TCPIP_CORE_LOCKING */
+
+/**
+ * @brief Record the calling task as the tcpip thread
+ */
+void
+sys_mark_tcpip_thread(void)
+{
+  s_tcpip_thread = xTaskGetCurrentTaskHandle();
+}
+
+/**
+ * @brief Assert that the TCP/IP core may be accessed from the calling task
+ *
+ * The core is accessed from tcpip_init() before the tcpip thread runs, this is not checked.
+ */
+void
+sys_check_core_locking(void)
+{
+  if (s_tcpip_thread == NULL) {
+    return;
+  }
+#if LWIP_TCPIP_CORE_LOCKING
+  LWIP_ASSERT("Function called without core lock", sys_tcpip_core_locked());
+#else
+  LWIP_ASSERT("Function called from wrong thread", xTaskGetCurrentTaskHandle() == s_tcpip_thread);
+#endif
+}
+
 void
 sys_delay_ms(uint32_t ms)
 {
@@ -97,6 +97,10 @@ sys_sem_t* sys_thread_sem_init(void);
 void sys_thread_sem_deinit(void);
 sys_sem_t* sys_thread_sem_get(void);
 
+#if LWIP_TCPIP_CORE_LOCKING
+int sys_tcpip_core_locked(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
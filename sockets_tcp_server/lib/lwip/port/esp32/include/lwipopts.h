@@ -93,6 +93,17 @@
 */
 #define MEMP_MEM_MALLOC                 1
 
+/**
+ * MEMP_NUM_*_RESERVED: number of elements of the busiest pools which are
+ * statically allocated, the heap is only used once they are all in use.
+ */
+#ifdef CONFIG_LWIP_MEMP_RESERVE
+#define MEMP_NUM_TCP_SEG_RESERVED       CONFIG_LWIP_MEMP_NUM_TCP_SEG_RESERVED
+#define MEMP_NUM_PBUF_RESERVED          CONFIG_LWIP_MEMP_NUM_PBUF_RESERVED
+#define MEMP_NUM_NETBUF_RESERVED        CONFIG_LWIP_MEMP_NUM_NETBUF_RESERVED
+#define MEMP_NUM_TCPIP_MSG_API_RESERVED CONFIG_LWIP_MEMP_NUM_TCPIP_MSG_API_RESERVED
+#endif
+
 /**
  * MEM_ALIGNMENT: should be set to the alignment of the CPU
  *    4 byte alignment -> #define MEM_ALIGNMENT 4
@@ -330,6 +341,25 @@
  */
 #define LWIP_TCP_SACK_OUT               CONFIG_LWIP_TCP_SACK_OUT
 
+/**
+ * LWIP_TCP_SACK_IN==1: TCP will use the SACKs received from the remote host
+ * for loss recovery (RFC 6675).
+ */
+#ifdef CONFIG_LWIP_TCP_SACK_IN
+#define LWIP_TCP_SACK_IN                1
+#else
+#define LWIP_TCP_SACK_IN                0
+#endif
+
+/**
+ * LWIP_TCP_PCB_HASH==1: Demultiplex incoming segments through a hash table of the
+ * active and TIME-WAIT PCBs.
+ */
+#ifdef CONFIG_LWIP_TCP_PCB_HASH
+#define LWIP_TCP_PCB_HASH               1
+#define TCP_PCB_HASH_SIZE               CONFIG_LWIP_TCP_PCB_HASH_SIZE
+#endif
+
 /**
  * ESP_TCP_KEEP_CONNECTION_WHEN_IP_CHANGES==1: Keep TCP connection when IP changed
  * scenario happens: 192.168.0.2 -> 0.0.0.0 -> 192.168.0.2 or 192.168.0.2 -> 0.0.0.0
@@ -533,10 +563,36 @@
    ----------------------------------------------
 */
 /**
- * LWIP_TCPIP_CORE_LOCKING: (EXPERIMENTAL!)
- * Don't use it if you're not an active lwIP project member
+ * LWIP_TCPIP_CORE_LOCKING: Application tasks lock the TCP/IP core and call
+ * it directly, instead of passing each API call to the tcpip thread.
  */
+#ifdef CONFIG_LWIP_TCPIP_CORE_LOCKING
+#define LWIP_TCPIP_CORE_LOCKING         1
+void sys_lock_tcpip_core(void);
+#define LOCK_TCPIP_CORE()               sys_lock_tcpip_core()
+void sys_unlock_tcpip_core(void);
+#define UNLOCK_TCPIP_CORE()             sys_unlock_tcpip_core()
+#else
 #define LWIP_TCPIP_CORE_LOCKING         0
+#endif
+
+/**
+ * LWIP_TCPIP_CORE_LOCKING_INPUT==0: Received packets are passed to the tcpip
+ * thread, so the Wi-Fi and Ethernet receive callbacks never wait for an
+ * application task holding the core lock.
+ */
+#define LWIP_TCPIP_CORE_LOCKING_INPUT   0
+
+/**
+ * LWIP_ASSERT_CORE_LOCKED: Check the core is only accessed from the tcpip
+ * thread, or with the core lock held.
+ */
+void sys_mark_tcpip_thread(void);
+#define LWIP_MARK_TCPIP_THREAD()        sys_mark_tcpip_thread()
+#ifdef CONFIG_LWIP_CHECK_THREAD_SAFETY
+void sys_check_core_locking(void);
+#define LWIP_ASSERT_CORE_LOCKED()       sys_check_core_locking()
+#endif
 
 /*
    ------------------------------------
@@ -567,6 +623,18 @@
  */
 #define LWIP_SO_RCVBUF                  CONFIG_LWIP_SO_RCVBUF
 
+/**
+ * LWIP_SOCKET_RECV_PBUF==1: Enable lwip_recv_pbuf() and lwip_recvfrom_pbuf(),
+ * used by the HTTP server and client to receive without copying.
+ */
+#define LWIP_SOCKET_RECV_PBUF           1
+
+/**
+ * LWIP_SOCKET_MMSG==1: Enable lwip_sendmmsg() and lwip_recvmmsg(), passing
+ * several UDP datagrams to the tcpip thread with one message.
+ */
+#define LWIP_SOCKET_MMSG                1
+
 /**
  * SO_REUSE==1: Enable SO_REUSEADDR option.
  * This option is set via menuconfig.
@@ -856,6 +924,20 @@
 #define CHECKSUM_CHECK_UDP              0
 #define CHECKSUM_CHECK_IP               0
 
+/**
+ * LWIP_CHKSUM_ALGORITHM 4: sum a 32-bit word at a time, 32 bytes per loop.
+ */
+#define LWIP_CHKSUM_ALGORITHM           4
+
+/**
+ * LWIP_CHECKSUM_ON_COPY==1: Calculate the checksum of TCP and UDP payloads while
+ * copying them from the application buffers, in the same pass.
+ */
+#ifdef CONFIG_LWIP_CHECKSUM_ON_COPY
+#define LWIP_CHECKSUM_ON_COPY           1
+#define LWIP_CHKSUM_COPY_ALGORITHM      2
+#endif
+
 #define LWIP_NETCONN_FULLDUPLEX         1
 #define LWIP_NETCONN_SEM_PER_THREAD     1
 
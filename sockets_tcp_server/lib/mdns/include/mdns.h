@@ -249,6 +249,10 @@ esp_err_t mdns_service_remove_all(void);
  * @brief  Query mDNS for host or service
  *         All following query methods are derived from this one
  *
+ * @note   Queries are answered right away if the records received in earlier responses are still cached
+ *         (see CONFIG_MDNS_CACHE_MAX_RECORDS). PTR queries are answered from the cache only if all cached
+ *         instances have known host names and addresses.
+ *
  * @param  name         service instance or host name (NULL for PTR queries)
  * @param  service_type service type (_http, _arduino, _ftp etc.) (NULL for host queries)
  * @param  proto        service protocol (_tcp, _udp, etc.) (NULL for host queries)
@@ -17,6 +17,7 @@
 #include "mdns_networking.h"
 #include "esp_log.h"
 #include <string.h>
+#include <ctype.h>
 #include <sys/param.h>
 
 #ifdef MDNS_ENABLE_DEBUG
@@ -37,6 +38,13 @@ static const char *TAG = "MDNS";
 static volatile TaskHandle_t _mdns_service_task_handle = NULL;
 static SemaphoreHandle_t _mdns_service_semaphore = NULL;
 
+/* names added to the packet being built, used for name compression */
+static struct {
+    mdns_name_dict_entry_t slots[MDNS_NAME_DICT_SIZE];
+    uint8_t order[MDNS_NAME_DICT_MAX_NAMES];
+    uint8_t count;
+} _mdns_name_dict;
+
 static void _mdns_search_finish_done(void);
 static mdns_search_once_t * _mdns_search_find_from(mdns_search_once_t * search, mdns_name_t * name, uint16_t type, mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol);
 static void _mdns_search_result_add_ip(mdns_search_once_t * search, const char * hostname, esp_ip_addr_t * ip, mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol);
@@ -400,10 +408,92 @@ static inline uint8_t _mdns_append_string(uint8_t * packet, uint16_t * index, co
     return len + 1;
 }
 
+/**
+ * @brief  Hash of a name label followed by the name at the given offset
+ */
+static uint16_t _mdns_name_dict_hash(const char * label, uint8_t len, uint16_t next)
+{
+    uint32_t hash = 2166136261UL ^ next;
+    uint8_t i;
+    for (i=0; i<len; i++) {
+        hash = (hash ^ (uint8_t)tolower((unsigned char)label[i])) * 16777619UL;
+    }
+    return (hash ^ (hash >> 16)) & (MDNS_NAME_DICT_SIZE - 1);
+}
+
+/**
+ * @brief  Forget names of the previous packet
+ */
+static void _mdns_name_dict_reset(void)
+{
+    memset(_mdns_name_dict.slots, 0, sizeof(_mdns_name_dict.slots));
+    _mdns_name_dict.count = 0;
+}
+
+/**
+ * @brief  Find a name in the packet, given as its first label and the offset of the rest of it
+ *
+ * @param  packet       MDNS packet
+ * @param  label        the first label of the name
+ * @param  len          length of the label
+ * @param  next         offset of the rest of the name, 0 if the label is the last one
+ *
+ * @return offset of the name in the packet or 0 if it was not added yet
+ */
+static uint16_t _mdns_name_dict_find(const uint8_t * packet, const char * label, uint8_t len, uint16_t next)
+{
+    uint16_t i = _mdns_name_dict_hash(label, len, next);
+    while (_mdns_name_dict.slots[i].offset) {
+        mdns_name_dict_entry_t * e = &_mdns_name_dict.slots[i];
+        if (e->next == next && packet[e->offset] == len && !strncasecmp((const char *)packet + e->offset + 1, label, len)) {
+            return e->offset;
+        }
+        i = (i + 1) & (MDNS_NAME_DICT_SIZE - 1);
+    }
+    return 0;
+}
+
+/**
+ * @brief  Remember a name added to the packet, nothing is done if the dictionary is full
+ */
+static void _mdns_name_dict_add(const uint8_t * packet, uint16_t offset, uint16_t next)
+{
+    if (_mdns_name_dict.count == MDNS_NAME_DICT_MAX_NAMES) {
+        return;
+    }
+    uint16_t i = _mdns_name_dict_hash((const char *)packet + offset + 1, packet[offset], next);
+    while (_mdns_name_dict.slots[i].offset) {
+        i = (i + 1) & (MDNS_NAME_DICT_SIZE - 1);
+    }
+    _mdns_name_dict.slots[i].offset = offset;
+    _mdns_name_dict.slots[i].next = next;
+    _mdns_name_dict.order[_mdns_name_dict.count++] = i;
+}
+
+/**
+ * @brief  Forget names at or after the given offset, when a record could not be added to the packet
+ *
+ * Names are removed in reverse order of adding, which keeps the probe sequences of the others intact
+ */
+static void _mdns_name_dict_truncate(uint16_t index)
+{
+    while (_mdns_name_dict.count) {
+        mdns_name_dict_entry_t * e = &_mdns_name_dict.slots[_mdns_name_dict.order[_mdns_name_dict.count - 1]];
+        if (e->offset < index) {
+            break;
+        }
+        e->offset = 0;
+        _mdns_name_dict.count--;
+    }
+}
+
 /**
  * @brief  appends FQDN to a packet, incrementing the index and
  *         compressing the output if previous occurrence of the string (or part of it) has been found
  *
+ * The longest suffix of the name which is already in the packet is found in the name dictionary,
+ * which holds every name (and name suffix) added to the packet
+ *
  * @param  packet       MDNS packet
  * @param  index        offset in the packet
  * @param  strings      string array containing the parts of the FQDN
@@ -413,64 +503,43 @@ static inline uint8_t _mdns_append_string(uint8_t * packet, uint16_t * index, co
  */
 static uint16_t _mdns_append_fqdn(uint8_t * packet, uint16_t * index, const char * strings[], uint8_t count)
 {
-    if (!count) {
-        //empty string so terminate
-        return _mdns_append_u8(packet, index, 0);
-    }
-    mdns_name_t name;
-    static char buf[MDNS_NAME_BUF_LEN];
-    uint8_t len = strlen(strings[0]);
-    //try to find first the string length in the packet (if it exists)
-    uint8_t * len_location = (uint8_t *)memchr(packet, (char)len, *index);
-    while (len_location) {
-        //check if the string after len_location is the string that we are looking for
-        if (memcmp(len_location+1, strings[0], len)) { //not continuing with our string
-search_next:
-            //try and find the length byte further in the packet
-            len_location = (uint8_t *)memchr(len_location+1, (char)len, *index - (len_location+1 - packet));
-            continue;
+    uint16_t start = *index;
+    uint16_t offsets[count + 1];
+    uint16_t next = 0;
+    uint8_t i = count;
+
+    //find the longest suffix of the name already in the packet
+    while (i) {
+        uint16_t offset = _mdns_name_dict_find(packet, strings[i - 1], strlen(strings[i - 1]), next);
+        if (!offset) {
+            break;
         }
-        //seems that we might have found the string that we are looking for
-        //read the destination into name and compare
-        name.parts = 0;
-        name.sub = 0;
-        name.host[0] = 0;
-        name.service[0] = 0;
-        name.proto[0] = 0;
-        name.domain[0] = 0;
-        const uint8_t * content = _mdns_read_fqdn(packet, len_location, &name, buf);
-        if (!content) {
-            //not a readable fqdn?
+        next = offset;
+        i--;
+    }
+    count = i;
+
+    //add the rest of the labels, followed by a pointer to the suffix or by the terminating zero
+    for (i=0; i<count; i++) {
+        offsets[i] = *index;
+        if (!_mdns_append_string(packet, index, strings[i])) {
             return 0;
         }
-        if (name.parts == count) {
-            uint8_t i;
-            for (i=0; i<count; i++) {
-                if (strcasecmp(strings[i], (const char *)&name + (i * (MDNS_NAME_BUF_LEN)))) {
-                    //not our string! let's search more
-                    goto search_next;
-                }
-            }
-            //we actually have found the string
-            break;
-        } else {
-            goto search_next;
-        }
     }
-    //string is not yet in the packet, so let's add it
-    if (!len_location) {
-        uint8_t written = _mdns_append_string(packet, index, strings[0]);
-        if (!written) {
+    if (next) {
+        if (!_mdns_append_u16(packet, index, next | MDNS_NAME_REF)) {
             return 0;
         }
-        //run the same for the other strings in the name
-        return written + _mdns_append_fqdn(packet, index, &strings[1], count - 1);
+    } else if (!_mdns_append_u8(packet, index, 0)) {
+        return 0;
     }
 
-    //we have found the string so let's insert a pointer to it instead
-    uint16_t offset = len_location - packet;
-    offset |= MDNS_NAME_REF;
-    return _mdns_append_u16(packet, index, offset);
+    //each of the new names refers to the one after it
+    while (count--) {
+        _mdns_name_dict_add(packet, offsets[count], next);
+        next = offsets[count];
+    }
+    return *index - start;
 }
 
 /**
@@ -483,7 +552,7 @@ search_next:
  *
  * @return length of added data: 0 on error or length on success
  */
-static uint16_t _mdns_append_ptr_record(uint8_t * packet, uint16_t * index, const char * instance, const char * service, const char * proto, bool flush, bool bye)
+static uint16_t _mdns_append_ptr_record(uint8_t * packet, uint16_t * index, const char * instance, const char * service, const char * proto, uint32_t ttl, bool flush, bool bye)
 {
     const char * str[4];
     uint16_t record_length = 0;
@@ -504,7 +573,7 @@ static uint16_t _mdns_append_ptr_record(uint8_t * packet, uint16_t * index, cons
     }
     record_length += part_length;
 
-    part_length = _mdns_append_type(packet, index, MDNS_ANSWER_PTR, false, bye?0:MDNS_ANSWER_PTR_TTL);
+    part_length = _mdns_append_type(packet, index, MDNS_ANSWER_PTR, false, bye?0:ttl);
     if (!part_length) {
         return 0;
     }
@@ -902,11 +971,11 @@ static uint8_t _mdns_append_answer(uint8_t * packet, uint16_t * index, mdns_out_
             return _mdns_append_ptr_record(packet, index,
                 _mdns_get_service_instance_name(answer->service),
                 answer->service->service, answer->service->proto,
-                answer->flush, answer->bye) > 0;
+                MDNS_ANSWER_PTR_TTL, answer->flush, answer->bye) > 0;
         } else {
             return _mdns_append_ptr_record(packet, index,
                 answer->custom_instance, answer->custom_service, answer->custom_proto,
-                answer->flush, answer->bye) > 0;
+                answer->ttl ? answer->ttl : MDNS_ANSWER_PTR_TTL, answer->flush, answer->bye) > 0;
         }
     } else if (answer->type == MDNS_TYPE_SRV) {
         return _mdns_append_srv_record(packet, index, answer->service, answer->flush, answer->bye) > 0;
@@ -965,6 +1034,28 @@ static uint8_t _mdns_append_answer(uint8_t * packet, uint16_t * index, mdns_out_
     return 0;
 }
 
+/**
+ * @brief  appends list of answers to a packet, answers which do not fit are left out
+ *
+ * @return number of records added to the packet
+ */
+static uint8_t _mdns_append_answers(uint8_t * packet, uint16_t * index, mdns_out_answer_t * a, mdns_if_t tcpip_if)
+{
+    uint8_t count = 0;
+    while (a) {
+        uint16_t start = *index;
+        uint8_t added = _mdns_append_answer(packet, index, a, tcpip_if);
+        if (!added) {
+            //drop what was written of the record
+            *index = start;
+            _mdns_name_dict_truncate(start);
+        }
+        count += added;
+        a = a->next;
+    }
+    return count;
+}
+
 /**
  * @brief  sends a packet
  *
@@ -976,44 +1067,59 @@ static void _mdns_dispatch_tx_packet(mdns_tx_packet_t * p)
     uint16_t index = MDNS_HEAD_LEN;
     memset(packet, 0, MDNS_HEAD_LEN);
     mdns_out_question_t * q;
-    mdns_out_answer_t * a;
     uint8_t count;
 
     _mdns_set_u16(packet, MDNS_HEAD_FLAGS_OFFSET, p->flags);
 
+    _mdns_name_dict_reset();
+
     count = 0;
     q = p->questions;
     while (q) {
+        uint16_t start = index;
         if (_mdns_append_question(packet, &index, q)) {
             count++;
+        } else {
+            //drop what was written of the question
+            index = start;
+            _mdns_name_dict_truncate(index);
         }
         q = q->next;
     }
     _mdns_set_u16(packet, MDNS_HEAD_QUESTIONS_OFFSET, count);
 
-    count = 0;
-    a = p->answers;
-    while (a) {
-        count += _mdns_append_answer(packet, &index, a, p->tcpip_if);
-        a = a->next;
-    }
-    _mdns_set_u16(packet, MDNS_HEAD_ANSWERS_OFFSET, count);
-
-    count = 0;
-    a = p->servers;
-    while (a) {
-        count += _mdns_append_answer(packet, &index, a, p->tcpip_if);
-        a = a->next;
-    }
-    _mdns_set_u16(packet, MDNS_HEAD_SERVERS_OFFSET, count);
-
-    count = 0;
-    a = p->additional;
-    while (a) {
-        count += _mdns_append_answer(packet, &index, a, p->tcpip_if);
-        a = a->next;
+    if (!p->flags) {
+        //query: known answers which do not fit follow in further packets, all but the last one truncated (RFC 6762, 7.2)
+        mdns_out_answer_t * a = p->answers;
+        count = 0;
+        while (a) {
+            uint16_t start = index;
+            if (_mdns_append_answer(packet, &index, a, p->tcpip_if)) {
+                count++;
+                a = a->next;
+                continue;
+            }
+            index = start;
+            _mdns_name_dict_truncate(start);
+            if (index == MDNS_HEAD_LEN) {
+                //does not fit even an empty packet
+                a = a->next;
+                continue;
+            }
+            _mdns_set_u16(packet, MDNS_HEAD_FLAGS_OFFSET, MDNS_FLAGS_DISTRIBUTED);
+            _mdns_set_u16(packet, MDNS_HEAD_ANSWERS_OFFSET, count);
+            _mdns_udp_pcb_write(p->tcpip_if, p->ip_protocol, &p->dst, p->port, packet, index);
+            memset(packet, 0, MDNS_HEAD_LEN);
+            index = MDNS_HEAD_LEN;
+            _mdns_name_dict_reset();
+            count = 0;
+        }
+        _mdns_set_u16(packet, MDNS_HEAD_ANSWERS_OFFSET, count);
+    } else {
+        _mdns_set_u16(packet, MDNS_HEAD_ANSWERS_OFFSET, _mdns_append_answers(packet, &index, p->answers, p->tcpip_if));
     }
-    _mdns_set_u16(packet, MDNS_HEAD_ADDITIONAL_OFFSET, count);
+    _mdns_set_u16(packet, MDNS_HEAD_SERVERS_OFFSET, _mdns_append_answers(packet, &index, p->servers, p->tcpip_if));
+    _mdns_set_u16(packet, MDNS_HEAD_ADDITIONAL_OFFSET, _mdns_append_answers(packet, &index, p->additional, p->tcpip_if));
 
 #ifdef MDNS_ENABLE_DEBUG
     _mdns_dbg_printf("\nTX[%u][%u]: ", p->tcpip_if, p->ip_protocol);
@@ -1212,6 +1318,7 @@ static bool _mdns_alloc_answer(mdns_out_answer_t ** destination, uint16_t type,
     a->type = type;
     a->service = service;
     a->custom_service = NULL;
+    a->ttl = 0;
     a->bye = bye;
     a->flush = flush;
     a->next = NULL;
@@ -2604,6 +2711,400 @@ static esp_err_t _mdns_strdup_check(char ** out, char * in)
     return ESP_OK;
 }
 
+/**
+ * @brief  Compare two names of cached records, empty and missing names are equal
+ */
+static bool _mdns_cache_name_eq(const char * a, const char * b)
+{
+    if (_str_null_or_empty(a) || _str_null_or_empty(b)) {
+        return _str_null_or_empty(a) == _str_null_or_empty(b);
+    }
+    return !strcasecmp(a, b);
+}
+
+/**
+ * @brief  Milliseconds left until cached record expires, 0 if it has already expired
+ */
+static uint32_t _mdns_cache_remaining_ms(mdns_cache_record_t * record, uint32_t now)
+{
+    uint32_t age = now - record->received_at;
+    uint32_t lifetime = record->ttl * 1000;
+    return (age < lifetime) ? (lifetime - age) : 0;
+}
+
+/**
+ * @brief  Check if cached record has the same owner name and type
+ */
+static bool _mdns_cache_record_owner_eq(mdns_cache_record_t * r, mdns_cache_record_t * other)
+{
+    if (r->type != other->type || r->tcpip_if != other->tcpip_if || r->ip_protocol != other->ip_protocol) {
+        return false;
+    }
+    if (r->type == MDNS_TYPE_A || r->type == MDNS_TYPE_AAAA) {
+        return _mdns_cache_name_eq(r->hostname, other->hostname);
+    }
+    if (r->type != MDNS_TYPE_PTR && !_mdns_cache_name_eq(r->instance, other->instance)) {
+        return false;
+    }
+    return _mdns_cache_name_eq(r->service, other->service) && _mdns_cache_name_eq(r->proto, other->proto);
+}
+
+/**
+ * @brief  Check if cached record is the same record (owner name, type and data)
+ *
+ * SRV and TXT records are unique for their owner name, their data is replaced when refreshed
+ */
+static bool _mdns_cache_record_eq(mdns_cache_record_t * r, mdns_cache_record_t * other)
+{
+    if (!_mdns_cache_record_owner_eq(r, other)) {
+        return false;
+    }
+    if (r->type == MDNS_TYPE_PTR) {
+        return _mdns_cache_name_eq(r->instance, other->instance);
+    }
+    if (r->type == MDNS_TYPE_A) {
+        return r->addr.u_addr.ip4.addr == other->addr.u_addr.ip4.addr;
+    }
+    if (r->type == MDNS_TYPE_AAAA) {
+        return !memcmp(r->addr.u_addr.ip6.addr, other->addr.u_addr.ip6.addr, MDNS_ANSWER_AAAA_SIZE);
+    }
+    return true;
+}
+
+/**
+ * @brief  Free cached record
+ */
+static void _mdns_cache_record_free(mdns_cache_record_t * record)
+{
+    free(record->instance);
+    free(record->service);
+    free(record->proto);
+    free(record->hostname);
+    free(record->txt_data);
+    free(record);
+}
+
+/**
+ * @brief  Remove expired records from the cache
+ */
+static void _mdns_cache_remove_expired(uint32_t now)
+{
+    mdns_cache_record_t ** r = &_mdns_server->cache;
+    while (*r) {
+        mdns_cache_record_t * c = *r;
+        if (!_mdns_cache_remaining_ms(c, now)) {
+            *r = c->next;
+            _mdns_cache_record_free(c);
+            _mdns_server->cache_count--;
+        } else {
+            r = &c->next;
+        }
+    }
+}
+
+/**
+ * @brief  Remove cached records received on particular interface
+ */
+static void _mdns_cache_clear_pcb(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
+{
+    mdns_cache_record_t ** r = &_mdns_server->cache;
+    while (*r) {
+        mdns_cache_record_t * c = *r;
+        if (c->tcpip_if == tcpip_if && c->ip_protocol == ip_protocol) {
+            *r = c->next;
+            _mdns_cache_record_free(c);
+            _mdns_server->cache_count--;
+        } else {
+            r = &c->next;
+        }
+    }
+}
+
+/**
+ * @brief  Remove all records from the cache
+ */
+static void _mdns_cache_free(void)
+{
+    while (_mdns_server->cache) {
+        mdns_cache_record_t * c = _mdns_server->cache;
+        _mdns_server->cache = c->next;
+        _mdns_cache_record_free(c);
+    }
+    _mdns_server->cache_count = 0;
+}
+
+/**
+ * @brief  Called from parser to store a record of a received response in the cache
+ *
+ * Records with TTL of zero (goodbye packets) are removed from the cache. If the cache-flush bit is set,
+ * older records of the same name and type are set to expire in one second (RFC 6762, 10.2)
+ *
+ * @param  packet       received packet, to resolve compressed names in the record data
+ * @param  name         owner name of the record
+ * @param  type         type of the record
+ * @param  flush        cache-flush bit of the record
+ * @param  ttl          TTL of the record in seconds
+ * @param  data         record data
+ * @param  data_len     length of the record data
+ */
+static void _mdns_cache_add(const uint8_t * packet, mdns_name_t * name, uint16_t type, bool flush, uint32_t ttl,
+                            const uint8_t * data, uint16_t data_len, mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
+{
+    static mdns_name_t target;
+    mdns_cache_record_t rec;
+    mdns_cache_record_t * r;
+    mdns_cache_record_t ** d;
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+    if (!MDNS_CACHE_MAX_RECORDS || name->sub || name->invalid) {
+        return;
+    }
+
+    memset(&rec, 0, sizeof(mdns_cache_record_t));
+    rec.type = type;
+    rec.tcpip_if = tcpip_if;
+    rec.ip_protocol = ip_protocol;
+    rec.ttl = (ttl > MDNS_CACHE_MAX_TTL) ? MDNS_CACHE_MAX_TTL : ttl;
+    rec.received_at = now;
+
+    if (type == MDNS_TYPE_PTR) {
+        if (_str_null_or_empty(name->service) || _str_null_or_empty(name->proto)
+            || !_mdns_parse_fqdn(packet, data, &target) || _str_null_or_empty(target.host)) {
+            return;
+        }
+        rec.instance = target.host;
+        rec.service = name->service;
+        rec.proto = name->proto;
+    } else if (type == MDNS_TYPE_SRV || type == MDNS_TYPE_TXT) {
+        if (_str_null_or_empty(name->host) || _str_null_or_empty(name->service) || _str_null_or_empty(name->proto)) {
+            return;
+        }
+        rec.instance = name->host;
+        rec.service = name->service;
+        rec.proto = name->proto;
+        if (type == MDNS_TYPE_SRV) {
+            if (data_len <= MDNS_SRV_FQDN_OFFSET
+                || !_mdns_parse_fqdn(packet, data + MDNS_SRV_FQDN_OFFSET, &target) || _str_null_or_empty(target.host)) {
+                return;
+            }
+            rec.hostname = target.host;
+            rec.port = _mdns_read_u16(data, MDNS_SRV_PORT_OFFSET);
+        }
+    } else if (type == MDNS_TYPE_A || type == MDNS_TYPE_AAAA) {
+        if (_str_null_or_empty(name->host) || !_str_null_or_empty(name->service)
+            || data_len != ((type == MDNS_TYPE_A) ? 4 : MDNS_ANSWER_AAAA_SIZE)) {
+            return;
+        }
+        rec.hostname = name->host;
+        if (type == MDNS_TYPE_A) {
+            rec.addr.type = IPADDR_TYPE_V4;
+            memcpy(&(rec.addr.u_addr.ip4.addr), data, 4);
+        } else {
+            rec.addr.type = IPADDR_TYPE_V6;
+            memcpy(rec.addr.u_addr.ip6.addr, data, MDNS_ANSWER_AAAA_SIZE);
+        }
+    } else {
+        return;
+    }
+
+    _mdns_cache_remove_expired(now);
+
+    d = &_mdns_server->cache;
+    while (*d) {
+        r = *d;
+        if (_mdns_cache_record_eq(r, &rec)) {
+            if (!ttl) {
+                //goodbye
+                *d = r->next;
+                _mdns_cache_record_free(r);
+                _mdns_server->cache_count--;
+                continue;
+            }
+            if (type == MDNS_TYPE_SRV && (r->port != rec.port || strcasecmp(r->hostname, rec.hostname))) {
+                char * hostname = strdup(rec.hostname);
+                if (!hostname) {
+                    HOOK_MALLOC_FAILED;
+                    return;
+                }
+                free(r->hostname);
+                r->hostname = hostname;
+                r->port = rec.port;
+            } else if (type == MDNS_TYPE_TXT && (r->txt_len != data_len || memcmp(r->txt_data, data, data_len))) {
+                uint8_t * txt_data = NULL;
+                if (data_len) {
+                    txt_data = (uint8_t *)malloc(data_len);
+                    if (!txt_data) {
+                        HOOK_MALLOC_FAILED;
+                        return;
+                    }
+                    memcpy(txt_data, data, data_len);
+                }
+                free(r->txt_data);
+                r->txt_data = txt_data;
+                r->txt_len = data_len;
+            }
+            r->ttl = rec.ttl;
+            r->received_at = now;
+            rec.ttl = 0;//refreshed, nothing to add
+        } else if (flush && ttl && _mdns_cache_record_owner_eq(r, &rec)
+                   && (now - r->received_at) > MDNS_CACHE_FLUSH_DELAY_MS) {
+            r->ttl = MDNS_CACHE_FLUSH_DELAY_MS / 1000;
+            r->received_at = now;
+        }
+        d = &r->next;
+    }
+
+    if (!rec.ttl) {
+        return;
+    }
+
+    if (_mdns_server->cache_count >= MDNS_CACHE_MAX_RECORDS) {
+        //evict the record which would expire first
+        mdns_cache_record_t ** oldest = &_mdns_server->cache;
+        for (d = &_mdns_server->cache; *d; d = &(*d)->next) {
+            if (_mdns_cache_remaining_ms(*d, now) < _mdns_cache_remaining_ms(*oldest, now)) {
+                oldest = d;
+            }
+        }
+        r = *oldest;
+        *oldest = r->next;
+        _mdns_cache_record_free(r);
+        _mdns_server->cache_count--;
+    }
+
+    r = (mdns_cache_record_t *)malloc(sizeof(mdns_cache_record_t));
+    if (!r) {
+        HOOK_MALLOC_FAILED;
+        return;
+    }
+    memcpy(r, &rec, sizeof(mdns_cache_record_t));
+    r->instance = NULL;
+    r->service = NULL;
+    r->proto = NULL;
+    r->hostname = NULL;
+    if (_mdns_strdup_check(&(r->instance), rec.instance)
+      || _mdns_strdup_check(&(r->service), rec.service)
+      || _mdns_strdup_check(&(r->proto), rec.proto)
+      || _mdns_strdup_check(&(r->hostname), rec.hostname)) {
+        HOOK_MALLOC_FAILED;
+        _mdns_cache_record_free(r);
+        return;
+    }
+    if (type == MDNS_TYPE_TXT && data_len) {
+        r->txt_data = (uint8_t *)malloc(data_len);
+        if (!r->txt_data) {
+            HOOK_MALLOC_FAILED;
+            _mdns_cache_record_free(r);
+            return;
+        }
+        memcpy(r->txt_data, data, data_len);
+        r->txt_len = data_len;
+    }
+    r->next = _mdns_server->cache;
+    _mdns_server->cache = r;
+    _mdns_server->cache_count++;
+}
+
+/**
+ * @brief  Add cached SRV, TXT and address records of the PTR results to the search
+ */
+static void _mdns_cache_search_ptr_results(mdns_search_once_t * search)
+{
+    mdns_cache_record_t * c;
+    mdns_result_t * r = search->result;
+    while (r) {
+        c = _mdns_server->cache;
+        while (c) {
+            if (c->tcpip_if == r->tcpip_if && c->ip_protocol == r->ip_protocol
+                && (c->type == MDNS_TYPE_SRV || c->type == MDNS_TYPE_TXT)
+                && _mdns_cache_name_eq(c->instance, r->instance_name)
+                && _mdns_cache_name_eq(c->service, search->service) && _mdns_cache_name_eq(c->proto, search->proto)) {
+                if (c->type == MDNS_TYPE_SRV && !r->hostname) {
+                    r->hostname = strdup(c->hostname);
+                    r->port = c->port;
+                } else if (c->type == MDNS_TYPE_TXT && !r->txt) {
+                    _mdns_result_txt_create(c->txt_data, c->txt_len, &(r->txt), &(r->txt_count));
+                }
+            }
+            c = c->next;
+        }
+        r = r->next;
+    }
+    c = _mdns_server->cache;
+    while (c) {
+        if (c->type == MDNS_TYPE_A || c->type == MDNS_TYPE_AAAA) {
+            _mdns_search_result_add_ip(search, c->hostname, &(c->addr), c->tcpip_if, c->ip_protocol);
+        }
+        c = c->next;
+    }
+}
+
+/**
+ * @brief  Answer new search from the cache
+ *
+ * PTR searches are answered when all the found instances have cached host names and addresses,
+ * other searches when at least one record was found.
+ *
+ * @param  search       the search
+ *
+ * @return true if the search was answered and does not have to be sent
+ */
+static bool _mdns_cache_search(mdns_search_once_t * search)
+{
+    mdns_cache_record_t * c;
+    mdns_txt_item_t * txt = NULL;
+    size_t txt_count = 0;
+
+    if (!_mdns_server->cache) {
+        return false;
+    }
+    _mdns_cache_remove_expired(xTaskGetTickCount() * portTICK_PERIOD_MS);
+
+    c = _mdns_server->cache;
+    while (c) {
+        if (search->type == MDNS_TYPE_PTR) {
+            if (c->type == MDNS_TYPE_PTR && _mdns_cache_name_eq(c->service, search->service) && _mdns_cache_name_eq(c->proto, search->proto)) {
+                _mdns_search_result_add_ptr(search, c->instance, c->tcpip_if, c->ip_protocol);
+            }
+        } else if (c->type == MDNS_TYPE_A || c->type == MDNS_TYPE_AAAA) {
+            if ((search->type == c->type || (search->type == MDNS_TYPE_ANY && !search->service))
+                && _mdns_cache_name_eq(c->hostname, search->instance)) {
+                _mdns_search_result_add_ip(search, c->hostname, &(c->addr), c->tcpip_if, c->ip_protocol);
+            }
+        } else if ((search->type == c->type || (search->type == MDNS_TYPE_ANY && search->service))
+                   && (c->type == MDNS_TYPE_SRV || c->type == MDNS_TYPE_TXT)
+                   && _mdns_cache_name_eq(c->instance, search->instance)
+                   && _mdns_cache_name_eq(c->service, search->service) && _mdns_cache_name_eq(c->proto, search->proto)) {
+            if (c->type == MDNS_TYPE_SRV) {
+                _mdns_search_result_add_srv(search, c->hostname, c->port, c->tcpip_if, c->ip_protocol);
+            } else {
+                _mdns_result_txt_create(c->txt_data, c->txt_len, &txt, &txt_count);
+                if (txt_count) {
+                    _mdns_search_result_add_txt(search, txt, txt_count, c->tcpip_if, c->ip_protocol);
+                }
+            }
+        }
+        c = c->next;
+    }
+
+    if (!search->result) {
+        return false;
+    }
+    if (search->type != MDNS_TYPE_PTR) {
+        return true;
+    }
+
+    _mdns_cache_search_ptr_results(search);
+    mdns_result_t * r = search->result;
+    while (r) {
+        if (!r->hostname || !r->addr) {
+            return false;
+        }
+        r = r->next;
+    }
+    return true;
+}
+
 /**
  * @brief  main packet parser
  *
@@ -2756,6 +3257,7 @@ void mdns_parse_packet(mdns_rx_packet_t * packet)
             uint32_t ttl = _mdns_read_u32(content, MDNS_TTL_OFFSET);
             uint16_t data_len = _mdns_read_u16(content, MDNS_LEN_OFFSET);
             const uint8_t * data_ptr = content + MDNS_DATA_OFFSET;
+            bool flush = !!(mdns_class & 0x8000);
             mdns_class &= 0x7FFF;
 
             content = data_ptr + data_len;
@@ -2792,6 +3294,7 @@ void mdns_parse_packet(mdns_rx_packet_t * packet)
                     //skip this record
                     continue;
                 }
+                _mdns_cache_add(data, name, type, flush, ttl, data_ptr, data_len, packet->tcpip_if, packet->ip_protocol);
                 search_result = _mdns_search_find_from(_mdns_server->search_once, name, type, packet->tcpip_if, packet->ip_protocol);
             }
 
@@ -3105,6 +3608,7 @@ void _mdns_disable_pcb(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
             _mdns_enable_pcb(other_if, ip_protocol);
         }
     }
+    _mdns_cache_clear_pcb(tcpip_if, ip_protocol);
     _mdns_server->interfaces[tcpip_if].pcbs[ip_protocol].state = PCB_OFF;
 }
 
@@ -3271,12 +3775,15 @@ static void _mdns_search_finish(mdns_search_once_t * search)
 }
 
 /**
- * @brief  Add new search to the search chain
+ * @brief  Add new search to the search chain, or finish it right away if it is answered from the cache
  */
 static void _mdns_search_add(mdns_search_once_t * search)
 {
     search->next = _mdns_server->search_once;
     _mdns_server->search_once = search;
+    if (_mdns_cache_search(search)) {
+        _mdns_search_finish(search);
+    }
 }
 
 /**
@@ -3577,6 +4084,52 @@ static mdns_search_once_t * _mdns_search_find_from(mdns_search_once_t * s, mdns_
     return NULL;
 }
 
+/**
+ * @brief  Add cached PTR records to search packet as known answers (RFC 6762, 7.1)
+ *
+ * Only records with more than half of their TTL remaining are added
+ *
+ * @return false on allocation failure
+ */
+static bool _mdns_search_add_known_answers(mdns_tx_packet_t * packet, mdns_search_once_t * search)
+{
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    mdns_cache_record_t * c = _mdns_server->cache;
+    mdns_out_answer_t * a;
+    while (c) {
+        uint32_t remaining = _mdns_cache_remaining_ms(c, now);
+        if (c->type != MDNS_TYPE_PTR || c->tcpip_if != packet->tcpip_if || c->ip_protocol != packet->ip_protocol
+            || remaining <= (c->ttl * 500)
+            || !_mdns_cache_name_eq(c->service, search->service) || !_mdns_cache_name_eq(c->proto, search->proto)) {
+            c = c->next;
+            continue;
+        }
+        a = packet->answers;
+        while (a && !(a->type == MDNS_TYPE_PTR && a->custom_instance && !strcasecmp(a->custom_instance, c->instance))) {
+            a = a->next;
+        }
+        if (!a) {
+            a = (mdns_out_answer_t *)malloc(sizeof(mdns_out_answer_t));
+            if (!a) {
+                HOOK_MALLOC_FAILED;
+                return false;
+            }
+            a->type = MDNS_TYPE_PTR;
+            a->service = NULL;
+            a->custom_instance = c->instance;
+            a->custom_service = search->service;
+            a->custom_proto = search->proto;
+            a->ttl = (remaining + 999) / 1000;
+            a->bye = false;
+            a->flush = false;
+            a->next = NULL;
+            queueToEnd(mdns_out_answer_t, packet->answers, a);
+        }
+        c = c->next;
+    }
+    return true;
+}
+
 /**
  * @brief  Create search packet for particular interface
  */
@@ -3622,12 +4175,17 @@ static mdns_tx_packet_t * _mdns_create_search_packet(mdns_search_once_t * search
             a->custom_instance = r->instance_name;
             a->custom_service = search->service;
             a->custom_proto = search->proto;
+            a->ttl = 0;
             a->bye = false;
             a->flush = false;
             a->next = NULL;
             queueToEnd(mdns_out_answer_t, packet->answers, a);
             r = r->next;
         }
+        if (!_mdns_search_add_known_answers(packet, search)) {
+            _mdns_free_tx_packet(packet);
+            return NULL;
+        }
     }
 
     return packet;
@@ -4343,6 +4901,7 @@ void mdns_free(void)
         }
         free(h);
     }
+    _mdns_cache_free();
     vSemaphoreDelete(_mdns_server->lock);
     free(_mdns_server);
     _mdns_server = NULL;
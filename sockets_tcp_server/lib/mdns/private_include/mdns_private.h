@@ -65,6 +65,9 @@
 #endif
 #define MDNS_TASK_AFFINITY          CONFIG_MDNS_TASK_AFFINITY
 #define MDNS_SERVICE_ADD_TIMEOUT_MS CONFIG_MDNS_SERVICE_ADD_TIMEOUT_MS
+#define MDNS_CACHE_MAX_RECORDS      CONFIG_MDNS_CACHE_MAX_RECORDS
+#define MDNS_CACHE_MAX_TTL          86400                   // Longest TTL (seconds) for which a record is cached
+#define MDNS_CACHE_FLUSH_DELAY_MS   1000                    // Records older than this are replaced by cache-flush records (RFC 6762, 10.2)
 
 #define MDNS_PACKET_QUEUE_LEN       16                      // Maximum packets that can be queued for parsing
 #define MDNS_ACTION_QUEUE_LEN       16                      // Maximum actions pending to the server
@@ -72,6 +75,8 @@
 #define MDNS_NAME_MAX_LEN           64                      // Maximum string length of hostname, instance, service and proto
 #define MDNS_NAME_BUF_LEN           (MDNS_NAME_MAX_LEN+1)   // Maximum char buffer size to hold hostname, instance, service or proto
 #define MDNS_MAX_PACKET_SIZE        1460                    // Maximum size of mDNS  outgoing packet
+#define MDNS_NAME_DICT_SIZE         128                     // Hash table size of the name compression dictionary (power of 2)
+#define MDNS_NAME_DICT_MAX_NAMES    96                      // Maximum names of outgoing packet used for compression
 
 #define MDNS_HEAD_LEN               12
 #define MDNS_HEAD_ID_OFFSET         0
@@ -288,8 +293,14 @@ typedef struct mdns_out_answer_s {
     const char * custom_instance;
     const char * custom_service;
     const char * custom_proto;
+    uint32_t ttl;               // remaining TTL of a known answer, 0 if the record type default is used
 } mdns_out_answer_t;
 
+typedef struct {
+    uint16_t offset;            // offset of the name in the packet, 0 if the slot is free
+    uint16_t next;              // offset of the name after the first label, 0 if there are no more labels
+} mdns_name_dict_entry_t;
+
 typedef struct mdns_tx_packet_s {
     struct mdns_tx_packet_s * next;
     uint32_t send_at;
@@ -340,6 +351,23 @@ typedef struct mdns_search_once_s {
     mdns_result_t * result;
 } mdns_search_once_t;
 
+typedef struct mdns_cache_record_s {
+    struct mdns_cache_record_s * next;
+    uint16_t type;
+    mdns_if_t tcpip_if;
+    mdns_ip_protocol_t ip_protocol;
+    char * instance;            // PTR target, SRV and TXT owner
+    char * service;
+    char * proto;
+    char * hostname;            // SRV target, A and AAAA owner
+    uint16_t port;
+    esp_ip_addr_t addr;
+    uint8_t * txt_data;
+    uint16_t txt_len;
+    uint32_t ttl;               // TTL in seconds as received
+    uint32_t received_at;       // ms timestamp of the last refresh
+} mdns_cache_record_t;
+
 typedef struct mdns_server_s {
     struct {
         mdns_pcb_t pcbs[MDNS_IP_PROTOCOL_MAX];
@@ -351,6 +379,8 @@ typedef struct mdns_server_s {
     QueueHandle_t action_queue;
     mdns_tx_packet_t * tx_queue_head;
     mdns_search_once_t * search_once;
+    mdns_cache_record_t * cache;
+    uint16_t cache_count;
     esp_timer_handle_t timer_handle;
 } mdns_server_t;
 
@@ -0,0 +1,196 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mdns.h"
+#include "mdns_private.h"
+
+//
+// Measures time to build (and "send") an announce packet and its size, against the number of services.
+// Every built packet is checked to be well formed: names end within the packet and compression
+// pointers only refer to earlier labels.
+#define BENCH_ITERATIONS    2000
+
+extern mdns_server_t * _mdns_server;
+
+//
+// Dependency injected test functions
+void mdns_test_execute_action(void * action);
+mdns_tx_packet_t * mdns_test_create_announce_packet(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_srv_item_t * services[], size_t len, bool include_ip);
+void mdns_test_dispatch_tx_packet(mdns_tx_packet_t * p);
+void mdns_test_free_tx_packet(mdns_tx_packet_t * packet);
+void mdns_test_init_di(void);
+
+static void execute_last_action(void)
+{
+    mdns_action_t * a = NULL;
+    GetLastItem(&a);
+    mdns_test_execute_action(a);
+}
+
+static uint16_t read_u16(const uint8_t * data, size_t index)
+{
+    return (data[index] << 8) | data[index + 1];
+}
+
+// checks name at given offset, returns offset after the name or 0 if it is malformed
+static size_t check_name(const uint8_t * data, size_t len, size_t index)
+{
+    size_t end = 0;
+    size_t name_len = 0;
+    size_t limit = index;
+    while (index < len) {
+        uint8_t label = data[index];
+        if (!label) {
+            return end ? end : index + 1;
+        }
+        if ((label & 0xC0) == 0xC0) {
+            if (index + 1 >= len) {
+                return 0;
+            }
+            size_t target = read_u16(data, index) & ~MDNS_NAME_REF;
+            if (target < MDNS_HEAD_LEN || target >= limit) {
+                return 0;
+            }
+            if (!end) {
+                end = index + 2;
+            }
+            index = limit = target;
+            continue;
+        }
+        if (label > 63) {
+            return 0;
+        }
+        name_len += label + 1;
+        if (name_len > 255) {
+            return 0;
+        }
+        index += label + 1;
+    }
+    return 0;
+}
+
+// checks all the records of a packet, returns number of records or -1 if the packet is malformed
+static int check_packet(const uint8_t * data, size_t len)
+{
+    size_t index = MDNS_HEAD_LEN;
+    int questions = read_u16(data, MDNS_HEAD_QUESTIONS_OFFSET);
+    int records = read_u16(data, MDNS_HEAD_ANSWERS_OFFSET) + read_u16(data, MDNS_HEAD_SERVERS_OFFSET) + read_u16(data, MDNS_HEAD_ADDITIONAL_OFFSET);
+    int i;
+
+    for (i = 0; i < questions; i++) {
+        if (!(index = check_name(data, len, index))) {
+            return -1;
+        }
+        index += 4;
+    }
+    for (i = 0; i < records; i++) {
+        if (!(index = check_name(data, len, index)) || index + MDNS_DATA_OFFSET > len) {
+            return -1;
+        }
+        uint16_t type = read_u16(data, index + MDNS_TYPE_OFFSET);
+        size_t data_index = index + MDNS_DATA_OFFSET;
+        index = data_index + read_u16(data, index + MDNS_LEN_OFFSET);
+        if (index > len) {
+            return -1;
+        }
+        if ((type == MDNS_TYPE_PTR && check_name(data, len, data_index) != index)
+            || (type == MDNS_TYPE_SRV && check_name(data, len, data_index + MDNS_SRV_FQDN_OFFSET) != index)) {
+            return -1;
+        }
+    }
+    return index == len ? records : -1;
+}
+
+static void services_add(int count)
+{
+    mdns_txt_item_t txt[2] = {
+        {"path", "/"},
+        {"version", "1.2.3"}
+    };
+    char service[16];
+    int i;
+
+    for (i = 0; i < count; i++) {
+        snprintf(service, sizeof(service), "_svc%02d", i);
+        if (mdns_service_add(NULL, service, i % 2 ? "_udp" : "_tcp", 1000 + i, txt, 2)) {
+            // This is expected failure as the service thread is not running
+        }
+        execute_last_action();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    static const int service_counts[] = { 1, 2, 4, 8, 12, 16, 20, MDNS_MAX_SERVICES };
+    mdns_srv_item_t * services[MDNS_MAX_SERVICES];
+    struct timespec start, end;
+    const uint8_t * data;
+    size_t i, n, len;
+
+    mdns_test_init_di();
+    if (mdns_init()) {
+        abort();
+    }
+    if (mdns_hostname_set("esp32-livingroom")) {
+        abort();
+    }
+    execute_last_action();
+    if (mdns_instance_name_set("Living Room Lamp")) {
+        abort();
+    }
+    execute_last_action();
+    services_add(MDNS_MAX_SERVICES);
+
+    n = 0;
+    for (mdns_srv_item_t * s = _mdns_server->services; s && n < MDNS_MAX_SERVICES; s = s->next) {
+        services[n++] = s;
+    }
+    if (n != MDNS_MAX_SERVICES) {
+        printf("only %zu services were added\n", n);
+        abort();
+    }
+
+    printf("services  records  bytes  build [us]\n");
+    for (i = 0; i < sizeof(service_counts) / sizeof(service_counts[0]); i++) {
+        int count = service_counts[i];
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (n = 0; n < BENCH_ITERATIONS; n++) {
+            mdns_tx_packet_t * packet = mdns_test_create_announce_packet(MDNS_IF_STA, MDNS_IP_PROTOCOL_V4, services, count, true);
+            if (!packet) {
+                abort();
+            }
+            mdns_test_dispatch_tx_packet(packet);
+            mdns_test_free_tx_packet(packet);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        len = GetLastPacket(&data);
+        int records = check_packet(data, len);
+        if (records < 0) {
+            printf("malformed packet for %d services\n", count);
+            abort();
+        }
+        double us = ((end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3) / BENCH_ITERATIONS;
+        printf("%8d  %7d  %5zu  %10.2f\n", count, records, len, us);
+    }
+
+    ForceTaskDelete();
+    mdns_free();
+    return 0;
+}
@@ -8,6 +8,9 @@
 void*     g_queue;
 int       g_queue_send_shall_fail = 0;
 int       g_size = 0;
+uint8_t   g_packet_data[4][1460];
+size_t    g_packet_len[4];
+size_t    g_packet_count = 0;
 
 const char * WIFI_EVENT = "wifi_event";
 const char * IP_EVENT = "ip_event";
@@ -99,3 +102,29 @@ void ForceTaskDelete(void)
 {
     g_queue_send_shall_fail = 1;
 }
+
+/// UDP write mock
+size_t MockUdpWrite(const uint8_t * data, size_t len)
+{
+    size_t i = g_packet_count++ % 4;
+    g_packet_len[i] = len < sizeof(g_packet_data[i]) ? len : sizeof(g_packet_data[i]);
+    memcpy(g_packet_data[i], data, g_packet_len[i]);
+    return len;
+}
+
+size_t GetPacketCount(void)
+{
+    return g_packet_count;
+}
+
+size_t GetPacket(size_t back, const uint8_t ** data)
+{
+    size_t i = (g_packet_count - 1 - back) % 4;
+    *data = g_packet_data[i];
+    return g_packet_len[i];
+}
+
+size_t GetLastPacket(const uint8_t ** data)
+{
+    return GetPacket(0, data);
+}
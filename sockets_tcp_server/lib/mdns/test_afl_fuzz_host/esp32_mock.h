@@ -44,6 +44,16 @@ esp_err_t esp_event_handler_register(const char * event_base, int32_t event_id,
 
 esp_err_t esp_event_handler_unregister(const char * event_base, int32_t event_id, void* event_handler);
 
-#define _mdns_udp_pcb_write(tcpip_if, ip_protocol, ip, port, data, len) len
+// UDP write mock, keeps the last four sent packets
+size_t MockUdpWrite(const uint8_t * data, size_t len);
+
+size_t GetPacketCount(void);
+
+// returns a sent packet, back = 0 for the last one
+size_t GetPacket(size_t back, const uint8_t ** data);
+
+size_t GetLastPacket(const uint8_t ** data);
+
+#define _mdns_udp_pcb_write(tcpip_if, ip_protocol, ip, port, data, len) MockUdpWrite(data, len)
 
 #endif /* ESP32_MOCK_H_ */
\ No newline at end of file
@@ -11,12 +11,20 @@ mdns_srv_item_t * (*mdns_test_static_mdns_get_service_item)(const char * service
 mdns_search_once_t * (*mdns_test_static_search_init)(const char * name, const char * service, const char * proto, uint16_t type, uint32_t timeout, uint8_t max_results) = NULL;
 esp_err_t         (*mdns_test_static_send_search_action)(mdns_action_type_t type, mdns_search_once_t * search) = NULL;
 void              (*mdns_test_static_search_free)(mdns_search_once_t * search) = NULL;
+mdns_tx_packet_t * (*mdns_test_static_create_search_packet)(mdns_search_once_t * search, mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol) = NULL;
+void              (*mdns_test_static_free_tx_packet)(mdns_tx_packet_t * packet) = NULL;
+mdns_tx_packet_t * (*mdns_test_static_create_announce_packet)(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_srv_item_t * services[], size_t len, bool include_ip) = NULL;
+void              (*mdns_test_static_dispatch_tx_packet)(mdns_tx_packet_t * p) = NULL;
 
 static void _mdns_execute_action(mdns_action_t * action);
 static mdns_srv_item_t * _mdns_get_service_item(const char * service, const char * proto);
 static mdns_search_once_t * _mdns_search_init(const char * name, const char * service, const char * proto, uint16_t type, uint32_t timeout, uint8_t max_results);
 static esp_err_t _mdns_send_search_action(mdns_action_type_t type, mdns_search_once_t * search);
 static void _mdns_search_free(mdns_search_once_t * search);
+static mdns_tx_packet_t * _mdns_create_search_packet(mdns_search_once_t * search, mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol);
+static void _mdns_free_tx_packet(mdns_tx_packet_t * packet);
+static mdns_tx_packet_t * _mdns_create_announce_packet(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_srv_item_t * services[], size_t len, bool include_ip);
+static void _mdns_dispatch_tx_packet(mdns_tx_packet_t * p);
 
 void mdns_test_init_di(void)
 {
@@ -25,6 +33,10 @@ void mdns_test_init_di(void)
     mdns_test_static_search_init = _mdns_search_init;
     mdns_test_static_send_search_action = _mdns_send_search_action;
     mdns_test_static_search_free = _mdns_search_free;
+    mdns_test_static_create_search_packet = _mdns_create_search_packet;
+    mdns_test_static_free_tx_packet = _mdns_free_tx_packet;
+    mdns_test_static_create_announce_packet = _mdns_create_announce_packet;
+    mdns_test_static_dispatch_tx_packet = _mdns_dispatch_tx_packet;
 }
 
 void mdns_test_execute_action(void * action)
@@ -50,4 +62,24 @@ mdns_search_once_t * mdns_test_search_init(const char * name, const char * servi
 mdns_srv_item_t * mdns_test_mdns_get_service_item(const char * service, const char * proto)
 {
     return mdns_test_static_mdns_get_service_item(service, proto);
-}
\ No newline at end of file
+}
+
+mdns_tx_packet_t * mdns_test_create_search_packet(mdns_search_once_t * search, mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
+{
+    return mdns_test_static_create_search_packet(search, tcpip_if, ip_protocol);
+}
+
+void mdns_test_free_tx_packet(mdns_tx_packet_t * packet)
+{
+    mdns_test_static_free_tx_packet(packet);
+}
+
+mdns_tx_packet_t * mdns_test_create_announce_packet(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_srv_item_t * services[], size_t len, bool include_ip)
+{
+    return mdns_test_static_create_announce_packet(tcpip_if, ip_protocol, services, len, include_ip);
+}
+
+void mdns_test_dispatch_tx_packet(mdns_tx_packet_t * p)
+{
+    mdns_test_static_dispatch_tx_packet(p);
+}
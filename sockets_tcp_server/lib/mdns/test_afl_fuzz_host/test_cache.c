@@ -0,0 +1,478 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "mdns.h"
+#include "mdns_private.h"
+
+//
+// Checks of the mDNS record cache: synthetic responses are passed to the parser
+// and searches are then run through the service actions, as mdns_query() would
+#define TEST_CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            abort(); \
+        } \
+    } while (0)
+
+extern mdns_server_t * _mdns_server;
+
+//
+// Dependency injected test functions
+void mdns_test_execute_action(void * action);
+mdns_search_once_t * mdns_test_search_init(const char * name, const char * service, const char * proto, uint16_t type, uint32_t timeout, uint8_t max_results);
+esp_err_t mdns_test_send_search_action(mdns_action_type_t type, mdns_search_once_t * search);
+void mdns_test_search_free(mdns_search_once_t * search);
+mdns_tx_packet_t * mdns_test_create_search_packet(mdns_search_once_t * search, mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol);
+void mdns_test_free_tx_packet(mdns_tx_packet_t * packet);
+void mdns_test_dispatch_tx_packet(mdns_tx_packet_t * p);
+void mdns_test_init_di(void);
+
+void mdns_parse_packet(mdns_rx_packet_t * packet);
+void _mdns_disable_pcb(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol);
+
+//
+// Response packet builder
+typedef struct {
+    uint8_t data[MDNS_MAX_PACKET_SIZE];
+    uint16_t len;
+    uint16_t answers;
+} test_packet_t;
+
+static void packet_init(test_packet_t * p)
+{
+    memset(p, 0, sizeof(test_packet_t));
+    p->data[MDNS_HEAD_FLAGS_OFFSET] = MDNS_FLAGS_AUTHORITATIVE >> 8;
+    p->data[MDNS_HEAD_FLAGS_OFFSET + 1] = MDNS_FLAGS_AUTHORITATIVE & 0xFF;
+    p->len = MDNS_HEAD_LEN;
+}
+
+static void packet_u16(test_packet_t * p, uint16_t v)
+{
+    p->data[p->len++] = v >> 8;
+    p->data[p->len++] = v & 0xFF;
+}
+
+// appends uncompressed name, labels separated by '|' as instance names may contain dots
+static void packet_name(test_packet_t * p, const char * name)
+{
+    const char * label = name;
+    while (*label) {
+        const char * end = strchr(label, '|');
+        size_t len = end ? (size_t)(end - label) : strlen(label);
+        p->data[p->len++] = len;
+        memcpy(p->data + p->len, label, len);
+        p->len += len;
+        label += len + (end ? 1 : 0);
+    }
+    p->data[p->len++] = 0;
+}
+
+// appends record header and returns offset of the data length
+static uint16_t packet_record(test_packet_t * p, const char * name, uint16_t type, bool flush, uint32_t ttl)
+{
+    packet_name(p, name);
+    packet_u16(p, type);
+    packet_u16(p, flush ? MDNS_CLASS_IN_FLUSH_CACHE : MDNS_CLASS_IN);
+    packet_u16(p, ttl >> 16);
+    packet_u16(p, ttl & 0xFFFF);
+    packet_u16(p, 0);
+    p->answers++;
+    return p->len - 2;
+}
+
+static void packet_record_end(test_packet_t * p, uint16_t len_offset)
+{
+    uint16_t len = p->len - len_offset - 2;
+    p->data[len_offset] = len >> 8;
+    p->data[len_offset + 1] = len & 0xFF;
+}
+
+static void packet_ptr(test_packet_t * p, const char * name, const char * target, uint32_t ttl)
+{
+    uint16_t l = packet_record(p, name, MDNS_TYPE_PTR, false, ttl);
+    packet_name(p, target);
+    packet_record_end(p, l);
+}
+
+static void packet_srv(test_packet_t * p, const char * name, const char * target, uint16_t port, uint32_t ttl)
+{
+    uint16_t l = packet_record(p, name, MDNS_TYPE_SRV, true, ttl);
+    packet_u16(p, 0);
+    packet_u16(p, 0);
+    packet_u16(p, port);
+    packet_name(p, target);
+    packet_record_end(p, l);
+}
+
+static void packet_txt(test_packet_t * p, const char * name, const char * txt, uint32_t ttl)
+{
+    uint16_t l = packet_record(p, name, MDNS_TYPE_TXT, true, ttl);
+    p->data[p->len++] = strlen(txt);
+    memcpy(p->data + p->len, txt, strlen(txt));
+    p->len += strlen(txt);
+    packet_record_end(p, l);
+}
+
+static void packet_a(test_packet_t * p, const char * name, uint32_t ip, bool flush, uint32_t ttl)
+{
+    uint16_t l = packet_record(p, name, MDNS_TYPE_A, flush, ttl);
+    memcpy(p->data + p->len, &ip, 4);
+    p->len += 4;
+    packet_record_end(p, l);
+}
+
+static void packet_parse(test_packet_t * p)
+{
+    mdns_rx_packet_t packet;
+    struct pbuf pb;
+
+    p->data[MDNS_HEAD_ANSWERS_OFFSET] = p->answers >> 8;
+    p->data[MDNS_HEAD_ANSWERS_OFFSET + 1] = p->answers & 0xFF;
+    memset(&packet, 0, sizeof(mdns_rx_packet_t));
+    memset(&pb, 0, sizeof(struct pbuf));
+    pb.payload = p->data;
+    pb.len = p->len;
+    packet.pb = &pb;
+    packet.tcpip_if = MDNS_IF_STA;
+    packet.ip_protocol = MDNS_IP_PROTOCOL_V4;
+    packet.src_port = MDNS_SERVICE_PORT;
+    mdns_parse_packet(&packet);
+}
+
+//
+// Search helpers
+static void execute_last_action(void)
+{
+    mdns_action_t * a = NULL;
+    GetLastItem(&a);
+    mdns_test_execute_action(a);
+}
+
+// starts a search and returns it, it is finished if it was answered from the cache
+static mdns_search_once_t * search_start(const char * name, const char * service, const char * proto, uint16_t type, uint8_t max_results)
+{
+    mdns_search_once_t * search = mdns_test_search_init(name, service, proto, type, 3000, max_results);
+    TEST_CHECK(search);
+    TEST_CHECK(mdns_test_send_search_action(ACTION_SEARCH_ADD, search) == ESP_OK);
+    execute_last_action();
+    return search;
+}
+
+static void search_end(mdns_search_once_t * search)
+{
+    if (search->state != SEARCH_OFF) {
+        TEST_CHECK(mdns_test_send_search_action(ACTION_SEARCH_END, search) == ESP_OK);
+        execute_last_action();
+    }
+    mdns_query_results_free(search->result);
+    mdns_test_search_free(search);
+}
+
+static size_t results_count(mdns_result_t * r)
+{
+    size_t count = 0;
+    for (; r; r = r->next) {
+        count++;
+    }
+    return count;
+}
+
+static size_t addr_count(mdns_ip_addr_t * a)
+{
+    size_t count = 0;
+    for (; a; a = a->next) {
+        count++;
+    }
+    return count;
+}
+
+static mdns_out_answer_t * known_answer_find(mdns_tx_packet_t * packet, const char * instance, size_t * count)
+{
+    mdns_out_answer_t * found = NULL;
+    *count = 0;
+    for (mdns_out_answer_t * a = packet->answers; a; a = a->next) {
+        if (a->type == MDNS_TYPE_PTR && !strcmp(a->custom_instance, instance)) {
+            found = a;
+            (*count)++;
+        }
+    }
+    return found;
+}
+
+//
+// Tests
+static void test_ptr_query_answered_from_cache(void)
+{
+    test_packet_t p;
+    packet_init(&p);
+    packet_ptr(&p, "_http|_tcp|local", "Living Room|_http|_tcp|local", 4500);
+    packet_srv(&p, "Living Room|_http|_tcp|local", "lamp|local", 8080, 120);
+    packet_txt(&p, "Living Room|_http|_tcp|local", "path=/", 4500);
+    packet_a(&p, "lamp|local", htonl(0xC0A80414), true, 120);
+    packet_parse(&p);
+    TEST_CHECK(_mdns_server->cache_count == 4);
+
+    mdns_search_once_t * search = search_start(NULL, "_http", "_tcp", MDNS_TYPE_PTR, 20);
+    TEST_CHECK(search->state == SEARCH_OFF);
+    TEST_CHECK(results_count(search->result) == 1);
+    mdns_result_t * r = search->result;
+    TEST_CHECK(!strcmp(r->instance_name, "Living Room"));
+    TEST_CHECK(!strcmp(r->hostname, "lamp"));
+    TEST_CHECK(r->port == 8080);
+    TEST_CHECK(r->txt_count == 1 && !strcmp(r->txt[0].key, "path") && !strcmp(r->txt[0].value, "/"));
+    TEST_CHECK(addr_count(r->addr) == 1 && r->addr->addr.u_addr.ip4.addr == htonl(0xC0A80414));
+    search_end(search);
+
+    // the same response again only refreshes the records
+    packet_parse(&p);
+    TEST_CHECK(_mdns_server->cache_count == 4);
+}
+
+static void test_host_and_service_queries_answered_from_cache(void)
+{
+    mdns_search_once_t * search = search_start("lamp", NULL, NULL, MDNS_TYPE_A, 1);
+    TEST_CHECK(search->state == SEARCH_OFF);
+    TEST_CHECK(results_count(search->result) == 1 && addr_count(search->result->addr) == 1);
+    search_end(search);
+
+    search = search_start("Living Room", "_http", "_tcp", MDNS_TYPE_SRV, 1);
+    TEST_CHECK(search->state == SEARCH_OFF);
+    TEST_CHECK(results_count(search->result) == 1);
+    TEST_CHECK(!strcmp(search->result->hostname, "lamp") && search->result->port == 8080);
+    search_end(search);
+
+    search = search_start("Living Room", "_http", "_tcp", MDNS_TYPE_TXT, 1);
+    TEST_CHECK(search->state == SEARCH_OFF);
+    TEST_CHECK(results_count(search->result) == 1 && search->result->txt_count == 1);
+    search_end(search);
+
+    // nothing cached for these
+    search = search_start("lamp", NULL, NULL, MDNS_TYPE_AAAA, 1);
+    TEST_CHECK(search->state != SEARCH_OFF && !search->result);
+    search_end(search);
+    search = search_start(NULL, "_ipp", "_tcp", MDNS_TYPE_PTR, 20);
+    TEST_CHECK(search->state != SEARCH_OFF && !search->result);
+    search_end(search);
+}
+
+static void test_known_answers(void)
+{
+    size_t count;
+    test_packet_t p;
+    packet_init(&p);
+    packet_ptr(&p, "_http|_tcp|local", "Kitchen|_http|_tcp|local", 4500);
+    packet_parse(&p);
+
+    // the host of the new instance is not known, so the search has to go out
+    mdns_search_once_t * search = search_start(NULL, "_http", "_tcp", MDNS_TYPE_PTR, 20);
+    TEST_CHECK(search->state != SEARCH_OFF);
+    TEST_CHECK(results_count(search->result) == 2);
+
+    mdns_tx_packet_t * packet = mdns_test_create_search_packet(search, MDNS_IF_STA, MDNS_IP_PROTOCOL_V4);
+    TEST_CHECK(packet);
+    TEST_CHECK(packet->questions && packet->questions->type == MDNS_TYPE_PTR);
+    TEST_CHECK(known_answer_find(packet, "Living Room", &count) && count == 1);
+    mdns_out_answer_t * a = known_answer_find(packet, "Kitchen", &count);
+    TEST_CHECK(a && count == 1);
+    TEST_CHECK(a->ttl > 4490 && a->ttl <= 4500);
+    mdns_test_free_tx_packet(packet);
+
+    // records are only known answers on the interface they were received on
+    packet = mdns_test_create_search_packet(search, MDNS_IF_ETH, MDNS_IP_PROTOCOL_V4);
+    TEST_CHECK(packet && !packet->answers);
+    mdns_test_free_tx_packet(packet);
+    search_end(search);
+
+    // records with less than half of the TTL left are not known answers
+    packet_init(&p);
+    packet_ptr(&p, "_http|_tcp|local", "Kitchen|_http|_tcp|local", 1);
+    packet_parse(&p);
+    usleep(600000);
+    search = search_start(NULL, "_http", "_tcp", MDNS_TYPE_PTR, 20);
+    packet = mdns_test_create_search_packet(search, MDNS_IF_STA, MDNS_IP_PROTOCOL_V4);
+    TEST_CHECK(packet);
+    TEST_CHECK(known_answer_find(packet, "Living Room", &count));
+    TEST_CHECK(!known_answer_find(packet, "Kitchen", &count));
+    mdns_test_free_tx_packet(packet);
+    search_end(search);
+}
+
+static uint16_t packet_get_u16(const uint8_t * data, uint16_t offset)
+{
+    return (data[offset] << 8) | data[offset + 1];
+}
+
+static void test_known_answers_split(void)
+{
+    // together with the records of the previous tests, they still fit the cache
+    const int instances = 24;
+    test_packet_t p;
+    char name[96];
+    int i;
+
+    // long instance names, so that the known answers do not fit one packet
+    for (i = 0; i < instances; i++) {
+        if (i % 10 == 0) {
+            packet_init(&p);
+        }
+        snprintf(name, sizeof(name), "Instance %02d with a name as long as a label can be made|_http|_tcp|local", i);
+        packet_ptr(&p, "_http|_tcp|local", name, 4500);
+        if (i % 10 == 9 || i == instances - 1) {
+            packet_parse(&p);
+        }
+    }
+
+    mdns_search_once_t * search = search_start(NULL, "_http", "_tcp", MDNS_TYPE_PTR, 50);
+    TEST_CHECK(search->state != SEARCH_OFF);
+    mdns_tx_packet_t * packet = mdns_test_create_search_packet(search, MDNS_IF_STA, MDNS_IP_PROTOCOL_V4);
+    TEST_CHECK(packet);
+    size_t sent = GetPacketCount();
+    mdns_test_dispatch_tx_packet(packet);
+    mdns_test_free_tx_packet(packet);
+    search_end(search);
+
+    // the question goes first, with the truncated bit set as more known answers follow (RFC 6762, 7.2)
+    const uint8_t * data;
+    TEST_CHECK(GetPacketCount() - sent == 2);
+    size_t len = GetPacket(1, &data);
+    TEST_CHECK(len <= MDNS_MAX_PACKET_SIZE && len > MDNS_MAX_PACKET_SIZE / 2);
+    TEST_CHECK(packet_get_u16(data, MDNS_HEAD_FLAGS_OFFSET) == MDNS_FLAGS_DISTRIBUTED);
+    TEST_CHECK(packet_get_u16(data, MDNS_HEAD_QUESTIONS_OFFSET) == 1);
+    uint16_t answers = packet_get_u16(data, MDNS_HEAD_ANSWERS_OFFSET);
+    GetPacket(0, &data);
+    TEST_CHECK(packet_get_u16(data, MDNS_HEAD_FLAGS_OFFSET) == 0);
+    TEST_CHECK(packet_get_u16(data, MDNS_HEAD_QUESTIONS_OFFSET) == 0);
+    answers += packet_get_u16(data, MDNS_HEAD_ANSWERS_OFFSET);
+    TEST_CHECK(answers >= instances);
+
+    // goodbye, not to leave them to the next tests
+    for (i = 0; i < instances; i++) {
+        if (i % 10 == 0) {
+            packet_init(&p);
+        }
+        snprintf(name, sizeof(name), "Instance %02d with a name as long as a label can be made|_http|_tcp|local", i);
+        packet_ptr(&p, "_http|_tcp|local", name, 0);
+        if (i % 10 == 9 || i == instances - 1) {
+            packet_parse(&p);
+        }
+    }
+    usleep(1100000);
+}
+
+static void test_goodbye_and_expiry(void)
+{
+    test_packet_t p;
+    packet_init(&p);
+    packet_ptr(&p, "_http|_tcp|local", "Kitchen|_http|_tcp|local", 0);
+    packet_parse(&p);
+
+    mdns_search_once_t * search = search_start(NULL, "_http", "_tcp", MDNS_TYPE_PTR, 20);
+    TEST_CHECK(search->state == SEARCH_OFF);
+    TEST_CHECK(results_count(search->result) == 1);
+    search_end(search);
+
+    packet_init(&p);
+    packet_a(&p, "short|local", htonl(0xC0A80415), true, 1);
+    packet_parse(&p);
+    search = search_start("short", NULL, NULL, MDNS_TYPE_A, 1);
+    TEST_CHECK(search->state == SEARCH_OFF && search->result);
+    search_end(search);
+
+    usleep(1100000);
+    search = search_start("short", NULL, NULL, MDNS_TYPE_A, 1);
+    TEST_CHECK(search->state != SEARCH_OFF && !search->result);
+    search_end(search);
+}
+
+static void test_cache_flush(void)
+{
+    test_packet_t p;
+    uint16_t count = _mdns_server->cache_count;
+
+    // the address of lamp.local was received more than a second ago, it is flushed by the new one
+    packet_init(&p);
+    packet_a(&p, "lamp|local", htonl(0xC0A80416), true, 120);
+    packet_parse(&p);
+    TEST_CHECK(_mdns_server->cache_count == count + 1);
+
+    mdns_search_once_t * search = search_start("lamp", NULL, NULL, MDNS_TYPE_A, 1);
+    TEST_CHECK(search->state == SEARCH_OFF && addr_count(search->result->addr) == 2);
+    search_end(search);
+
+    usleep(1100000);
+    search = search_start("lamp", NULL, NULL, MDNS_TYPE_A, 1);
+    TEST_CHECK(search->state == SEARCH_OFF && addr_count(search->result->addr) == 1);
+    TEST_CHECK(search->result->addr->addr.u_addr.ip4.addr == htonl(0xC0A80416));
+    search_end(search);
+}
+
+static void test_cache_size_limit(void)
+{
+    test_packet_t p;
+    char name[32];
+    int i;
+
+    packet_init(&p);
+    for (i = 0; i < MDNS_CACHE_MAX_RECORDS + 8; i++) {
+        snprintf(name, sizeof(name), "host%d|local", i);
+        packet_a(&p, name, htonl(0x0A000000 + i), false, 120 + i);
+    }
+    packet_parse(&p);
+    TEST_CHECK(_mdns_server->cache_count == MDNS_CACHE_MAX_RECORDS);
+
+    // records expiring first were evicted
+    mdns_search_once_t * search = search_start("host0", NULL, NULL, MDNS_TYPE_A, 1);
+    TEST_CHECK(!search->result);
+    search_end(search);
+    snprintf(name, sizeof(name), "host%d", MDNS_CACHE_MAX_RECORDS + 7);
+    search = search_start(name, NULL, NULL, MDNS_TYPE_A, 1);
+    TEST_CHECK(search->state == SEARCH_OFF && search->result);
+    search_end(search);
+
+    // records of a disabled interface are dropped
+    _mdns_disable_pcb(MDNS_IF_STA, MDNS_IP_PROTOCOL_V4);
+    TEST_CHECK(_mdns_server->cache_count == 0 && !_mdns_server->cache);
+}
+
+int main(int argc, char** argv)
+{
+    mdns_test_init_di();
+
+    if (mdns_init()) {
+        abort();
+    }
+    if (mdns_hostname_set("minifritz")) {
+        abort();
+    }
+    execute_last_action();
+
+    test_ptr_query_answered_from_cache();
+    test_host_and_service_queries_answered_from_cache();
+    test_known_answers();
+    test_known_answers_split();
+    test_goodbye_and_expiry();
+    test_cache_flush();
+    test_cache_size_limit();
+
+    ForceTaskDelete();
+    mdns_free();
+    printf("mDNS cache tests passed\n");
+    return 0;
+}
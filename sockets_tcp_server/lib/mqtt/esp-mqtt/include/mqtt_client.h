@@ -132,6 +132,14 @@ typedef esp_mqtt_event_t *esp_mqtt_event_handle_t;
 
 typedef esp_err_t (* mqtt_event_callback_t)(esp_mqtt_event_handle_t event);
 
+/**
+ * @brief Handler of the messages matching a topic filter, see esp_mqtt_client_register_topic_handler()
+ *
+ * @param handler_arg   argument passed when registering the handler
+ * @param event         MQTT_EVENT_DATA event of the received message
+ */
+typedef void (* esp_mqtt_topic_handler_t)(void *handler_arg, esp_mqtt_event_handle_t event);
+
 /**
  * MQTT client configuration structure
  */
@@ -273,6 +281,32 @@ int esp_mqtt_client_unsubscribe(esp_mqtt_client_handle_t client, const char *top
  */
 int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain);
 
+/**
+ * @brief Enqueue a publish message, to be sent asynchronously by the client task
+ *
+ * Notes:
+ * - The message is serialized into a preallocated slot without taking the client lock and
+ *   without writing to the transport, so publishing from several tasks does not serialize on
+ *   the client or on the socket. The client task coalesces the enqueued messages into as few
+ *   transport writes as possible.
+ * - The whole message has to fit the client buffer (`buffer_size`), use esp_mqtt_client_publish()
+ *   for larger messages
+ * - QoS>0 messages enqueued while the client is not connected are kept in the outbox and sent
+ *   after connection, QoS0 messages are dropped
+ * - Requires MQTT_PUBLISH_QUEUE to be enabled in menuconfig
+ *
+ * @param client    mqtt client handle
+ * @param topic     topic string
+ * @param data      payload string (set to NULL, sending empty payload message)
+ * @param len       data length, if set to 0, length is calculated from payload string
+ * @param qos       qos of publish message
+ * @param retain    retain flag
+ *
+ * @return message_id of the publish message (for QoS 0 message_id will always be zero) on success.
+ *         -1 on failure (queue full, message too large).
+ */
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain);
+
 /**
  * @brief Destroys the client handle
  *
@@ -307,6 +341,42 @@ esp_err_t esp_mqtt_set_config(esp_mqtt_client_handle_t client, const esp_mqtt_cl
  */
 esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event, esp_event_handler_t event_handler, void* event_handler_arg);
 
+/**
+ * @brief Registers a handler of the received messages matching a topic filter
+ *
+ * Notes:
+ * - The filter may contain the `+` and `#` wildcards; every received message is matched against
+ *   all the registered filters and passed to the handlers of the matching ones, from the mqtt task,
+ *   before the generic MQTT_EVENT_DATA event is dispatched. Messages longer than the buffer are
+ *   passed in several chunks, as with MQTT_EVENT_DATA (only the first chunk contains the topic).
+ * - Registering a handler does not subscribe the client, use esp_mqtt_client_subscribe()
+ *   once connected. Handlers stay registered across reconnections.
+ * - Registering the same handler for the same filter again only updates its argument
+ * - It is thread safe, please refer to `esp_mqtt_client_subscribe` for details
+ *
+ * @param client        mqtt client handle
+ * @param filter        topic filter
+ * @param handler       handler callback
+ * @param handler_arg   handler context
+ *
+ * @return ESP_ERR_INVALID_ARG if the filter is not valid
+ *         ESP_ERR_NO_MEM if failed to allocate
+ *         ESP_OK on success
+ */
+esp_err_t esp_mqtt_client_register_topic_handler(esp_mqtt_client_handle_t client, const char *filter, esp_mqtt_topic_handler_t handler, void *handler_arg);
+
+/**
+ * @brief Unregisters a handler registered by esp_mqtt_client_register_topic_handler()
+ *
+ * @param client        mqtt client handle
+ * @param filter        topic filter the handler was registered for
+ * @param handler       handler callback
+ *
+ * @return ESP_ERR_NOT_FOUND if the handler is not registered for the filter
+ *         ESP_OK on success
+ */
+esp_err_t esp_mqtt_client_unregister_topic_handler(esp_mqtt_client_handle_t client, const char *filter, esp_mqtt_topic_handler_t handler);
+
 #ifdef __cplusplus
 }
 #endif //__cplusplus
@@ -83,4 +83,22 @@
 
 #define OUTBOX_EXPIRED_TIMEOUT_MS   (30*1000)
 #define OUTBOX_MAX_SIZE             (4*1024)
+
+#ifdef CONFIG_MQTT_OUTBOX_DATA_SIZE
+#define OUTBOX_DATA_SIZE            CONFIG_MQTT_OUTBOX_DATA_SIZE
+#else
+#define OUTBOX_DATA_SIZE            (2*1024)
+#endif
+
+#ifdef CONFIG_MQTT_PUBLISH_QUEUE
+#define MQTT_PUBLISH_QUEUE_ENABLED  1
+#define MQTT_PUBLISH_QUEUE_SIZE     CONFIG_MQTT_PUBLISH_QUEUE_SIZE
+#define MQTT_PUBLISH_QUEUE_FLUSH_MS CONFIG_MQTT_PUBLISH_QUEUE_FLUSH_MS
+#endif
+
+#ifdef CONFIG_MQTT_OUTBOX_MAX_ITEMS
+#define OUTBOX_MAX_ITEMS            CONFIG_MQTT_OUTBOX_MAX_ITEMS
+#else
+#define OUTBOX_MAX_ITEMS            (8)
+#endif
 #endif
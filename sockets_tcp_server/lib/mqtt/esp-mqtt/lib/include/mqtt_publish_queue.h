@@ -0,0 +1,43 @@
+/*
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE', which is part of this source code package.
+ * Tuan PM <tuanpm at live dot com>
+ */
+#ifndef _MQTT_PUBLISH_QUEUE_H_
+#define _MQTT_PUBLISH_QUEUE_H_
+#include "platform.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+typedef struct publish_queue *publish_queue_handle_t;
+
+typedef struct publish_slot {
+    uint8_t *buffer;        /*!< slot storage, `slot_size` bytes */
+    uint8_t *data;          /*!< serialized packet (points into buffer) */
+    int len;                /*!< length of the serialized packet */
+    uint16_t msg_id;
+    int msg_type;
+    int msg_qos;
+} publish_slot_t;
+
+/**
+ * Bounded multi-producer, single-consumer queue of serialized messages.
+ *
+ * Producers claim a slot, serialize a packet into it and commit it without taking any lock;
+ * the consumer (mqtt task) peeks and releases the committed slots in claim order.
+ */
+publish_queue_handle_t publish_queue_init(int slots, int slot_size);
+int publish_queue_get_slot_size(publish_queue_handle_t queue);
+publish_slot_t *publish_queue_claim(publish_queue_handle_t queue);
+void publish_queue_commit(publish_queue_handle_t queue, publish_slot_t *slot);
+publish_slot_t *publish_queue_peek(publish_queue_handle_t queue);
+void publish_queue_release(publish_queue_handle_t queue, publish_slot_t *slot);
+bool publish_queue_is_empty(publish_queue_handle_t queue);
+void publish_queue_destroy(publish_queue_handle_t queue);
+
+#ifdef  __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,45 @@
+/*
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE', which is part of this source code package.
+ * Tuan PM <tuanpm at live dot com>
+ */
+#ifndef _MQTT_TOPIC_ROUTER_H_
+#define _MQTT_TOPIC_ROUTER_H_
+#include "platform.h"
+#include "mqtt_client.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+typedef struct topic_router *topic_router_handle_t;
+
+/**
+ * Registry of topic filters compiled into a trie, one node per topic level.
+ *
+ * Regular levels are found through a hash table keyed by (parent node, level), the `+` and `#`
+ * children are kept directly in the parent node, so matching a topic costs a hash lookup per
+ * level and per partially matching `+` branch, independently of the number of filters.
+ */
+topic_router_handle_t topic_router_create(void);
+esp_err_t topic_router_add(topic_router_handle_t router, const char *filter, esp_mqtt_topic_handler_t handler, void *handler_arg);
+esp_err_t topic_router_remove(topic_router_handle_t router, const char *filter, esp_mqtt_topic_handler_t handler);
+bool topic_router_is_empty(topic_router_handle_t router);
+
+/**
+ * Collects the handlers of all the filters matching the topic, returns the number of handlers
+ * which would be invoked by topic_router_deliver()
+ */
+int topic_router_match(topic_router_handle_t router, const char *topic, int topic_len);
+
+/**
+ * Invokes the handlers collected by the last topic_router_match(), a handler may add or remove
+ * filters (the collected set is not affected until the next match)
+ */
+void topic_router_deliver(topic_router_handle_t router, esp_mqtt_event_handle_t event);
+void topic_router_destroy(topic_router_handle_t router);
+
+#ifdef  __cplusplus
+}
+#endif
+#endif
@@ -1,7 +1,7 @@
 #include "mqtt_outbox.h"
+#include "mqtt_config.h"
 #include <stdlib.h>
 #include <string.h>
-#include "sys/queue.h"
 #include "esp_log.h"
 
 #ifndef CONFIG_MQTT_CUSTOM_OUTBOX
@@ -9,8 +9,36 @@
 
 static const char *TAG = "OUTBOX";
 
+#define OUTBOX_STATES   (CONFIRMED + 1)
+
+/*
+ * The outbox storage is preallocated on the first enqueue, so that clients which never
+ * keep a message pending do not pay for it:
+ *  - pool[] holds the item descriptors, free descriptors are chained in `free_items`
+ *  - data[] holds the message bytes, split into blocks allocated first fit and released
+ *    as soon as their item is deleted; adjacent free blocks are merged on allocation.
+ *    Allocation walks the blocks from the start, which stays short with the default
+ *    OUTBOX_DATA_SIZE of a few pending messages
+ * When no descriptor or no block is free, the item or its data is allocated on the heap
+ * instead, so a message is never refused because older ones are still pending.
+ *
+ * Every live item is linked into
+ *  - a hash chain of its msg_id (lookup and acknowledge in O(1))
+ *  - the list of its pending state, in order of entering that state (dequeue in O(1))
+ *  - the list ordered by tick (expiry in O(expired items))
+ */
+typedef struct {
+    struct outbox_item *prev;
+    struct outbox_item *next;
+} outbox_link_t;
+
+typedef struct {
+    struct outbox_item *first;
+    struct outbox_item *last;
+} outbox_list_head_t;
+
 typedef struct outbox_item {
-    char *buffer;
+    uint8_t *buffer;
     int len;
     int msg_id;
     int msg_type;
@@ -18,67 +46,213 @@ typedef struct outbox_item {
     int tick;
     int retry_count;
     pending_state_t pending;
-    STAILQ_ENTRY(outbox_item) next;
+    bool pooled;                    /*!< Descriptor taken from the pool, not from the heap */
+    bool data_pooled;               /*!< Buffer taken from the data blocks, not from the heap */
+    struct outbox_item *hash_next;  /*!< Next item in the hash chain, or in the free list */
+    outbox_link_t state_link;
+    outbox_link_t tick_link;
 } outbox_item_t;
 
-STAILQ_HEAD(outbox_list_t, outbox_item);
+/* Header of a block of the data storage, followed by the block bytes */
+typedef struct {
+    uint32_t size;                  /*!< Size of the block including this header */
+    uint32_t free;
+} outbox_block_t;
+
+#define OUTBOX_BLOCK_ALIGN(len)    (((len) + sizeof(outbox_block_t) + 3) & ~3)
 
+struct outbox_list_t {
+    outbox_item_t **buckets;
+    outbox_item_t *pool;
+    outbox_item_t *free_items;
+    uint8_t *data;
+    int hash_mask;
+    int size;
+    outbox_list_head_t state_list[OUTBOX_STATES];
+    outbox_list_head_t tick_list;
+};
+
+#define LIST_INSERT_LAST(list, item, field) do {                            \
+        (item)->field.prev = (list)->last;                                  \
+        (item)->field.next = NULL;                                          \
+        if ((list)->last) {                                                 \
+            (list)->last->field.next = (item);                              \
+        } else {                                                            \
+            (list)->first = (item);                                         \
+        }                                                                   \
+        (list)->last = (item);                                              \
+    } while (0)
+
+#define LIST_UNLINK(list, item, field) do {                                 \
+        if ((item)->field.prev) {                                           \
+            (item)->field.prev->field.next = (item)->field.next;            \
+        } else {                                                            \
+            (list)->first = (item)->field.next;                             \
+        }                                                                   \
+        if ((item)->field.next) {                                           \
+            (item)->field.next->field.prev = (item)->field.prev;            \
+        } else {                                                            \
+            (list)->last = (item)->field.prev;                              \
+        }                                                                   \
+    } while (0)
+
+static inline outbox_item_t **hash_bucket(outbox_handle_t outbox, int msg_id)
+{
+    return &outbox->buckets[msg_id & outbox->hash_mask];
+}
 
 outbox_handle_t outbox_init(void)
 {
-    outbox_handle_t outbox = calloc(1, sizeof(struct outbox_list_t));
+    int buckets = 1;
+    while (buckets < OUTBOX_MAX_ITEMS) {
+        buckets <<= 1;
+    }
+    outbox_handle_t outbox = calloc(1, sizeof(struct outbox_list_t) + buckets * sizeof(outbox_item_t *));
     ESP_MEM_CHECK(TAG, outbox, return NULL);
-    STAILQ_INIT(outbox);
+    outbox->buckets = (outbox_item_t **)(outbox + 1);
+    outbox->hash_mask = buckets - 1;
     return outbox;
 }
 
+/* Allocates the descriptor pool and the data storage, on the first enqueue */
+static void storage_init(outbox_handle_t outbox)
+{
+    outbox->pool = malloc(OUTBOX_MAX_ITEMS * sizeof(outbox_item_t) + OUTBOX_DATA_SIZE);
+    if (outbox->pool == NULL) {
+        ESP_LOGW(TAG, "No memory for the outbox storage, using the heap for each message");
+        return;
+    }
+    for (int i = 0; i < OUTBOX_MAX_ITEMS; i++) {
+        outbox->pool[i].hash_next = (i + 1 < OUTBOX_MAX_ITEMS) ? &outbox->pool[i + 1] : NULL;
+    }
+    outbox->free_items = &outbox->pool[0];
+    outbox->data = (uint8_t *)(outbox->pool + OUTBOX_MAX_ITEMS);
+    outbox_block_t *block = (outbox_block_t *)outbox->data;
+    block->size = OUTBOX_DATA_SIZE & ~3;
+    block->free = true;
+}
+
+/* Takes the first free data block large enough for `len` bytes, returns NULL if there is none */
+static uint8_t *data_alloc(outbox_handle_t outbox, int len)
+{
+    uint32_t needed = OUTBOX_BLOCK_ALIGN(len);
+    uint32_t end = OUTBOX_DATA_SIZE & ~3;
+    for (uint32_t offset = 0; outbox->data && offset < end; ) {
+        outbox_block_t *block = (outbox_block_t *)(outbox->data + offset);
+        if (block->free) {
+            // merge the following free blocks
+            while (offset + block->size < end && ((outbox_block_t *)(outbox->data + offset + block->size))->free) {
+                block->size += ((outbox_block_t *)(outbox->data + offset + block->size))->size;
+            }
+            if (block->size >= needed) {
+                if (block->size - needed > sizeof(outbox_block_t)) {
+                    outbox_block_t *rest = (outbox_block_t *)(outbox->data + offset + needed);
+                    rest->size = block->size - needed;
+                    rest->free = true;
+                    block->size = needed;
+                }
+                block->free = false;
+                return (uint8_t *)(block + 1);
+            }
+        }
+        offset += block->size;
+    }
+    return NULL;
+}
+
+static void item_free(outbox_handle_t outbox, outbox_item_handle_t item)
+{
+    if (item->data_pooled) {
+        ((outbox_block_t *)item->buffer - 1)->free = true;
+    } else {
+        free(item->buffer);
+    }
+    if (item->pooled) {
+        item->hash_next = outbox->free_items;
+        outbox->free_items = item;
+    } else {
+        free(item);
+    }
+}
+
+static void item_remove(outbox_handle_t outbox, outbox_item_handle_t item)
+{
+    outbox_item_t **link = hash_bucket(outbox, item->msg_id);
+    while (*link != item) {
+        link = &(*link)->hash_next;
+    }
+    *link = item->hash_next;
+    LIST_UNLINK(&outbox->state_list[item->pending], item, state_link);
+    LIST_UNLINK(&outbox->tick_list, item, tick_link);
+    outbox->size -= item->len;
+    item_free(outbox, item);
+}
+
 outbox_item_handle_t outbox_enqueue(outbox_handle_t outbox, outbox_message_handle_t message, int tick)
 {
-    outbox_item_handle_t item = calloc(1, sizeof(outbox_item_t));
-    ESP_MEM_CHECK(TAG, item, return NULL);
+    int len = message->len + message->remaining_len;
+    if (outbox->pool == NULL) {
+        storage_init(outbox);
+    }
+    outbox_item_handle_t item = outbox->free_items;
+    if (item) {
+        outbox->free_items = item->hash_next;
+        item->pooled = true;
+    } else {
+        item = malloc(sizeof(outbox_item_t));
+        ESP_MEM_CHECK(TAG, item, return NULL);
+        item->pooled = false;
+    }
+    item->buffer = data_alloc(outbox, len);
+    item->data_pooled = item->buffer != NULL;
+    if (item->buffer == NULL) {
+        item->buffer = malloc(len);
+        if (item->buffer == NULL) {
+            ESP_LOGE(TAG, "No memory to keep msgid=%d, len=%d", message->msg_id, len);
+            item_free(outbox, item);
+            return NULL;
+        }
+    }
+    item->len = len;
     item->msg_id = message->msg_id;
     item->msg_type = message->msg_type;
     item->msg_qos = message->msg_qos;
     item->tick = tick;
-    item->len =  message->len + message->remaining_len;
+    item->retry_count = 0;
     item->pending = QUEUED;
-    item->buffer = malloc(message->len + message->remaining_len);
-    ESP_MEM_CHECK(TAG, item->buffer, {
-        free(item);
-        return NULL;
-    });
     memcpy(item->buffer, message->data, message->len);
     if (message->remaining_data) {
         memcpy(item->buffer + message->len, message->remaining_data, message->remaining_len);
     }
-    STAILQ_INSERT_TAIL(outbox, item, next);
-    ESP_LOGD(TAG, "ENQUEUE msgid=%d, msg_type=%d, len=%d, size=%d", message->msg_id, message->msg_type, message->len + message->remaining_len, outbox_get_size(outbox));
+    outbox_item_t **bucket = hash_bucket(outbox, item->msg_id);
+    item->hash_next = *bucket;
+    *bucket = item;
+    LIST_INSERT_LAST(&outbox->state_list[QUEUED], item, state_link);
+    LIST_INSERT_LAST(&outbox->tick_list, item, tick_link);
+    outbox->size += len;
+    ESP_LOGD(TAG, "ENQUEUE msgid=%d, msg_type=%d, len=%d, size=%d", message->msg_id, message->msg_type, len, outbox_get_size(outbox));
     return item;
 }
 
 outbox_item_handle_t outbox_get(outbox_handle_t outbox, int msg_id)
 {
-    outbox_item_handle_t item;
-    STAILQ_FOREACH(item, outbox, next) {
+    // the hash chain is newest first, return the oldest match
+    outbox_item_handle_t found = NULL;
+    for (outbox_item_handle_t item = *hash_bucket(outbox, msg_id); item; item = item->hash_next) {
         if (item->msg_id == msg_id) {
-            return item;
+            found = item;
         }
     }
-    return NULL;
+    return found;
 }
 
 outbox_item_handle_t outbox_dequeue(outbox_handle_t outbox, pending_state_t pending, int *tick)
 {
-    outbox_item_handle_t item;
-    STAILQ_FOREACH(item, outbox, next) {
-        if (item->pending == pending) {
-            if (tick) {
-                *tick = item->tick;
-            }
-            return item;
-        }
+    outbox_item_handle_t item = outbox->state_list[pending].first;
+    if (item && tick) {
+        *tick = item->tick;
     }
-    return NULL;
+    return item;
 }
 
 uint8_t *outbox_item_get_data(outbox_item_handle_t item,  size_t *len, uint16_t *msg_id, int *msg_type, int *qos)
@@ -88,44 +262,45 @@ uint8_t *outbox_item_get_data(outbox_item_handle_t item,  size_t *len, uint16_t
         *msg_id = item->msg_id;
         *msg_type = item->msg_type;
         *qos = item->msg_qos;
-        return (uint8_t *)item->buffer;
+        return item->buffer;
     }
     return NULL;
 }
 
 esp_err_t outbox_delete(outbox_handle_t outbox, int msg_id, int msg_type)
 {
-    outbox_item_handle_t item, tmp;
-    STAILQ_FOREACH_SAFE(item, outbox, next, tmp) {
+    for (outbox_item_handle_t item = *hash_bucket(outbox, msg_id); item; item = item->hash_next) {
         if (item->msg_id == msg_id && (0xFF & (item->msg_type)) == msg_type) {
-            STAILQ_REMOVE(outbox, item, outbox_item, next);
-            free(item->buffer);
-            free(item);
+            item_remove(outbox, item);
             ESP_LOGD(TAG, "DELETED msgid=%d, msg_type=%d, remain size=%d", msg_id, msg_type, outbox_get_size(outbox));
             return ESP_OK;
         }
-
     }
     return ESP_FAIL;
 }
+
 esp_err_t outbox_delete_msgid(outbox_handle_t outbox, int msg_id)
 {
-    outbox_item_handle_t item, tmp;
-    STAILQ_FOREACH_SAFE(item, outbox, next, tmp) {
+    outbox_item_handle_t item = *hash_bucket(outbox, msg_id);
+    while (item) {
+        outbox_item_handle_t next = item->hash_next;
         if (item->msg_id == msg_id) {
-            STAILQ_REMOVE(outbox, item, outbox_item, next);
-            free(item->buffer);
-            free(item);
+            item_remove(outbox, item);
         }
-
+        item = next;
     }
     return ESP_OK;
 }
+
 esp_err_t outbox_set_pending(outbox_handle_t outbox, int msg_id, pending_state_t pending)
 {
     outbox_item_handle_t item = outbox_get(outbox, msg_id);
     if (item) {
-        item->pending = pending;
+        if (item->pending != pending) {
+            LIST_UNLINK(&outbox->state_list[item->pending], item, state_link);
+            LIST_INSERT_LAST(&outbox->state_list[pending], item, state_link);
+            item->pending = pending;
+        }
         return ESP_OK;
     }
     return ESP_FAIL;
@@ -135,22 +310,24 @@ esp_err_t outbox_set_tick(outbox_handle_t outbox, int msg_id, int tick)
 {
     outbox_item_handle_t item = outbox_get(outbox, msg_id);
     if (item) {
+        // ticks are monotonic, moving the item last keeps the tick list sorted
+        LIST_UNLINK(&outbox->tick_list, item, tick_link);
+        LIST_INSERT_LAST(&outbox->tick_list, item, tick_link);
         item->tick = tick;
         return ESP_OK;
     }
-    return ESP_FAIL; 
+    return ESP_FAIL;
 }
 
 esp_err_t outbox_delete_msgtype(outbox_handle_t outbox, int msg_type)
 {
-    outbox_item_handle_t item, tmp;
-    STAILQ_FOREACH_SAFE(item, outbox, next, tmp) {
+    outbox_item_handle_t item = outbox->tick_list.first;
+    while (item) {
+        outbox_item_handle_t next = item->tick_link.next;
         if (item->msg_type == msg_type) {
-            STAILQ_REMOVE(outbox, item, outbox_item, next);
-            free(item->buffer);
-            free(item);
+            item_remove(outbox, item);
         }
-
+        item = next;
     }
     return ESP_OK;
 }
@@ -158,29 +335,20 @@ esp_err_t outbox_delete_msgtype(outbox_handle_t outbox, int msg_type)
 int outbox_delete_expired(outbox_handle_t outbox, int current_tick, int timeout)
 {
     int deleted_items = 0;
-    outbox_item_handle_t item, tmp;
-    STAILQ_FOREACH_SAFE(item, outbox, next, tmp) {
-        if (current_tick - item->tick > timeout) {
-            STAILQ_REMOVE(outbox, item, outbox_item, next);
-            free(item->buffer);
-            free(item);
-            deleted_items ++;
+    while (outbox->tick_list.first) {
+        outbox_item_handle_t item = outbox->tick_list.first;
+        if (current_tick - item->tick <= timeout) {
+            break;
         }
-
+        item_remove(outbox, item);
+        deleted_items ++;
     }
     return deleted_items;
 }
 
 int outbox_get_size(outbox_handle_t outbox)
 {
-    int siz = 0;
-    outbox_item_handle_t item;
-    STAILQ_FOREACH(item, outbox, next) {
-        // Suppressing "use after free" warning as this could happen only if queue is in inconsistent state
-        // which never happens if STAILQ interface used
-        siz += item->len; // NOLINT(clang-analyzer-unix.Malloc)
-    }
-    return siz;
+    return outbox->size;
 }
 
 esp_err_t outbox_cleanup(outbox_handle_t outbox, int max_size)
@@ -190,16 +358,17 @@ esp_err_t outbox_cleanup(outbox_handle_t outbox, int max_size)
         if (item == NULL) {
             return ESP_FAIL;
         }
-        STAILQ_REMOVE(outbox, item, outbox_item, next);
-        free(item->buffer);
-        free(item);
+        item_remove(outbox, item);
     }
     return ESP_OK;
 }
 
 void outbox_destroy(outbox_handle_t outbox)
 {
-    outbox_cleanup(outbox, 0);
+    while (outbox->tick_list.first) {
+        item_remove(outbox, outbox->tick_list.first);
+    }
+    free(outbox->pool);
     free(outbox);
 }
 
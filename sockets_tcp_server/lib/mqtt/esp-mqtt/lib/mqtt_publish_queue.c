@@ -0,0 +1,108 @@
+#include "mqtt_publish_queue.h"
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "esp_log.h"
+
+static const char *TAG = "PUBLISH_QUEUE";
+
+/*
+ * Bounded MPSC ring with a sequence number per slot:
+ *  - slot at position `pos` is free for the producer which claims `pos` when seq == pos
+ *  - it is ready for the consumer when seq == pos + 1
+ *  - after release it becomes free for the next round, seq == pos + capacity
+ * Producers only contend on the compare-and-swap of `enqueue_pos`, a producer which is slow
+ * to serialize its packet holds back the consumer, but never the other producers.
+ */
+typedef struct {
+    publish_slot_t slot;
+    atomic_uint seq;
+} queue_slot_t;
+
+struct publish_queue {
+    queue_slot_t *slots;
+    unsigned mask;
+    int slot_size;
+    atomic_uint enqueue_pos;
+    unsigned dequeue_pos;
+};
+
+publish_queue_handle_t publish_queue_init(int slots, int slot_size)
+{
+    unsigned capacity = 1;
+    while (capacity < slots) {
+        capacity <<= 1;
+    }
+    publish_queue_handle_t queue = calloc(1, sizeof(struct publish_queue) + capacity * (sizeof(queue_slot_t) + slot_size));
+    ESP_MEM_CHECK(TAG, queue, return NULL);
+    queue->slots = (queue_slot_t *)(queue + 1);
+    uint8_t *storage = (uint8_t *)(queue->slots + capacity);
+    for (unsigned i = 0; i < capacity; i++) {
+        queue->slots[i].slot.buffer = storage + i * slot_size;
+        atomic_init(&queue->slots[i].seq, i);
+    }
+    queue->mask = capacity - 1;
+    queue->slot_size = slot_size;
+    atomic_init(&queue->enqueue_pos, 0);
+    return queue;
+}
+
+int publish_queue_get_slot_size(publish_queue_handle_t queue)
+{
+    return queue->slot_size;
+}
+
+publish_slot_t *publish_queue_claim(publish_queue_handle_t queue)
+{
+    unsigned pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        queue_slot_t *qslot = &queue->slots[pos & queue->mask];
+        unsigned seq = atomic_load_explicit(&qslot->seq, memory_order_acquire);
+        int diff = (int)(seq - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                return &qslot->slot;
+            }
+            // pos was updated by the failed compare-and-swap, try again
+        } else if (diff < 0) {
+            // consumer did not release this slot yet, the queue is full
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+void publish_queue_commit(publish_queue_handle_t queue, publish_slot_t *slot)
+{
+    queue_slot_t *qslot = (queue_slot_t *)slot;
+    unsigned seq = atomic_load_explicit(&qslot->seq, memory_order_relaxed);
+    atomic_store_explicit(&qslot->seq, seq + 1, memory_order_release);
+}
+
+publish_slot_t *publish_queue_peek(publish_queue_handle_t queue)
+{
+    queue_slot_t *qslot = &queue->slots[queue->dequeue_pos & queue->mask];
+    unsigned seq = atomic_load_explicit(&qslot->seq, memory_order_acquire);
+    if (seq != queue->dequeue_pos + 1) {
+        return NULL;
+    }
+    return &qslot->slot;
+}
+
+void publish_queue_release(publish_queue_handle_t queue, publish_slot_t *slot)
+{
+    queue_slot_t *qslot = (queue_slot_t *)slot;
+    atomic_store_explicit(&qslot->seq, queue->dequeue_pos + queue->mask + 1, memory_order_release);
+    queue->dequeue_pos++;
+}
+
+bool publish_queue_is_empty(publish_queue_handle_t queue)
+{
+    return atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed) == queue->dequeue_pos;
+}
+
+void publish_queue_destroy(publish_queue_handle_t queue)
+{
+    free(queue);
+}
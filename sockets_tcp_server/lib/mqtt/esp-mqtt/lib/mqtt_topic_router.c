@@ -0,0 +1,431 @@
+#include "mqtt_topic_router.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+
+static const char *TAG = "TOPIC_ROUTER";
+
+#define TOPIC_ROUTER_INITIAL_BUCKETS    (16)
+#define TOPIC_ROUTER_INITIAL_FRONTIER   (8)
+#define TOPIC_ROUTER_INITIAL_MATCHES    (8)
+
+typedef struct topic_subscription {
+    esp_mqtt_topic_handler_t handler;
+    void *handler_arg;
+    struct topic_subscription *next;
+} topic_subscription_t;
+
+typedef struct topic_node {
+    struct topic_node *parent;
+    struct topic_node *hash_next;           /*!< next node in the same bucket of the level table */
+    struct topic_node *single_level;        /*!< `+` child */
+    struct topic_node *multi_level;         /*!< `#` child */
+    topic_subscription_t *subscriptions;    /*!< handlers of the filter ending at this node */
+    int children;
+    uint32_t hash;
+    int level_len;
+    char level[];
+} topic_node_t;
+
+typedef struct {
+    esp_mqtt_topic_handler_t handler;
+    void *handler_arg;
+} topic_match_t;
+
+struct topic_router {
+    topic_node_t *root;
+    topic_node_t **buckets;
+    unsigned bucket_mask;
+    int nodes;
+    topic_node_t **frontier[2];
+    int frontier_capacity[2];
+    topic_match_t *matches;
+    int match_count;
+    int match_capacity;
+};
+
+static uint32_t level_hash(const topic_node_t *parent, const char *level, int level_len)
+{
+    uint32_t hash = 2166136261u ^ (uint32_t)(uintptr_t)parent;
+    for (int i = 0; i < level_len; i++) {
+        hash ^= (uint8_t)level[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool level_is(const char *level, int level_len, char wildcard)
+{
+    return level_len == 1 && level[0] == wildcard;
+}
+
+static int level_length(const char *level, const char *end)
+{
+    const char *separator = memchr(level, '/', end - level);
+    return separator ? separator - level : end - level;
+}
+
+static topic_node_t *node_create(topic_node_t *parent, const char *level, int level_len)
+{
+    topic_node_t *node = calloc(1, sizeof(topic_node_t) + level_len);
+    ESP_MEM_CHECK(TAG, node, return NULL);
+    node->parent = parent;
+    node->level_len = level_len;
+    memcpy(node->level, level, level_len);
+    return node;
+}
+
+static topic_node_t *find_child(topic_router_handle_t router, const topic_node_t *parent, const char *level, int level_len, uint32_t hash)
+{
+    topic_node_t *node = router->buckets[hash & router->bucket_mask];
+    while (node) {
+        if (node->hash == hash && node->parent == parent && node->level_len == level_len &&
+                memcmp(node->level, level, level_len) == 0) {
+            return node;
+        }
+        node = node->hash_next;
+    }
+    return NULL;
+}
+
+static void grow_buckets(topic_router_handle_t router)
+{
+    unsigned buckets = (router->bucket_mask + 1) * 2;
+    topic_node_t **table = calloc(buckets, sizeof(topic_node_t *));
+    if (table == NULL) {
+        // keep the current table, only chains get longer
+        return;
+    }
+    for (unsigned i = 0; i <= router->bucket_mask; i++) {
+        topic_node_t *node = router->buckets[i];
+        while (node) {
+            topic_node_t *next = node->hash_next;
+            node->hash_next = table[node->hash & (buckets - 1)];
+            table[node->hash & (buckets - 1)] = node;
+            node = next;
+        }
+    }
+    free(router->buckets);
+    router->buckets = table;
+    router->bucket_mask = buckets - 1;
+}
+
+static topic_node_t *get_or_create_child(topic_router_handle_t router, topic_node_t *parent, const char *level, int level_len)
+{
+    topic_node_t **wildcard = NULL;
+    if (level_is(level, level_len, '+')) {
+        wildcard = &parent->single_level;
+    } else if (level_is(level, level_len, '#')) {
+        wildcard = &parent->multi_level;
+    }
+    if (wildcard) {
+        if (*wildcard == NULL) {
+            *wildcard = node_create(parent, level, level_len);
+            if (*wildcard) {
+                parent->children++;
+            }
+        }
+        return *wildcard;
+    }
+    uint32_t hash = level_hash(parent, level, level_len);
+    topic_node_t *node = find_child(router, parent, level, level_len, hash);
+    if (node) {
+        return node;
+    }
+    node = node_create(parent, level, level_len);
+    if (node == NULL) {
+        return NULL;
+    }
+    node->hash = hash;
+    node->hash_next = router->buckets[hash & router->bucket_mask];
+    router->buckets[hash & router->bucket_mask] = node;
+    parent->children++;
+    if (++router->nodes > 2 * (int)(router->bucket_mask + 1)) {
+        grow_buckets(router);
+    }
+    return node;
+}
+
+static topic_node_t *find_filter(topic_router_handle_t router, const char *filter)
+{
+    topic_node_t *node = router->root;
+    const char *level = filter, *end = filter + strlen(filter);
+    for (;;) {
+        int level_len = level_length(level, end);
+        if (level_is(level, level_len, '+')) {
+            node = node->single_level;
+        } else if (level_is(level, level_len, '#')) {
+            node = node->multi_level;
+        } else {
+            node = find_child(router, node, level, level_len, level_hash(node, level, level_len));
+        }
+        if (node == NULL || level + level_len == end) {
+            return node;
+        }
+        level += level_len + 1;
+    }
+}
+
+/* Frees the nodes which neither end a filter nor lead to one, from `node` up to the root */
+static void prune(topic_router_handle_t router, topic_node_t *node)
+{
+    while (node != router->root && node->subscriptions == NULL && node->children == 0) {
+        topic_node_t *parent = node->parent;
+        if (parent->single_level == node) {
+            parent->single_level = NULL;
+        } else if (parent->multi_level == node) {
+            parent->multi_level = NULL;
+        } else {
+            topic_node_t **link = &router->buckets[node->hash & router->bucket_mask];
+            while (*link != node) {
+                link = &(*link)->hash_next;
+            }
+            *link = node->hash_next;
+            router->nodes--;
+        }
+        parent->children--;
+        free(node);
+        node = parent;
+    }
+}
+
+/* Frees the node with its wildcard children, regular children are owned by the level table */
+static void free_node(topic_node_t *node)
+{
+    topic_subscription_t *subscription = node->subscriptions;
+    while (subscription) {
+        topic_subscription_t *next = subscription->next;
+        free(subscription);
+        subscription = next;
+    }
+    if (node->single_level) {
+        free_node(node->single_level);
+    }
+    if (node->multi_level) {
+        free_node(node->multi_level);
+    }
+    free(node);
+}
+
+static bool filter_is_valid(const char *filter)
+{
+    const char *level = filter, *end = filter + strlen(filter);
+    if (level == end) {
+        return false;
+    }
+    for (;;) {
+        int level_len = level_length(level, end);
+        const char *wildcard = memchr(level, '+', level_len);
+        if (wildcard == NULL) {
+            wildcard = memchr(level, '#', level_len);
+        }
+        if (wildcard && level_len != 1) {
+            // wildcards have to occupy the entire level
+            return false;
+        }
+        if (level + level_len == end) {
+            return true;
+        }
+        if (level_is(level, level_len, '#')) {
+            // multi-level wildcard has to be the last level
+            return false;
+        }
+        level += level_len + 1;
+    }
+}
+
+topic_router_handle_t topic_router_create(void)
+{
+    topic_router_handle_t router = calloc(1, sizeof(struct topic_router));
+    ESP_MEM_CHECK(TAG, router, return NULL);
+    router->root = node_create(NULL, "", 0);
+    ESP_MEM_CHECK(TAG, router->root, goto _router_create_failed);
+    router->buckets = calloc(TOPIC_ROUTER_INITIAL_BUCKETS, sizeof(topic_node_t *));
+    ESP_MEM_CHECK(TAG, router->buckets, goto _router_create_failed);
+    router->bucket_mask = TOPIC_ROUTER_INITIAL_BUCKETS - 1;
+    return router;
+_router_create_failed:
+    topic_router_destroy(router);
+    return NULL;
+}
+
+esp_err_t topic_router_add(topic_router_handle_t router, const char *filter, esp_mqtt_topic_handler_t handler, void *handler_arg)
+{
+    if (filter == NULL || handler == NULL || !filter_is_valid(filter)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    topic_node_t *node = router->root;
+    const char *level = filter, *end = filter + strlen(filter);
+    for (;;) {
+        int level_len = level_length(level, end);
+        topic_node_t *child = get_or_create_child(router, node, level, level_len);
+        if (child == NULL) {
+            prune(router, node);
+            return ESP_ERR_NO_MEM;
+        }
+        node = child;
+        if (level + level_len == end) {
+            break;
+        }
+        level += level_len + 1;
+    }
+    topic_subscription_t **link = &node->subscriptions;
+    while (*link) {
+        if ((*link)->handler == handler) {
+            // same handler registered again for this filter, only update its argument
+            (*link)->handler_arg = handler_arg;
+            return ESP_OK;
+        }
+        link = &(*link)->next;
+    }
+    topic_subscription_t *subscription = calloc(1, sizeof(topic_subscription_t));
+    ESP_MEM_CHECK(TAG, subscription, {
+        prune(router, node);
+        return ESP_ERR_NO_MEM;
+    });
+    subscription->handler = handler;
+    subscription->handler_arg = handler_arg;
+    *link = subscription;
+    ESP_LOGD(TAG, "Registered handler for filter %s", filter);
+    return ESP_OK;
+}
+
+esp_err_t topic_router_remove(topic_router_handle_t router, const char *filter, esp_mqtt_topic_handler_t handler)
+{
+    if (filter == NULL || !filter_is_valid(filter)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    topic_node_t *node = find_filter(router, filter);
+    if (node == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    topic_subscription_t **link = &node->subscriptions;
+    while (*link && (*link)->handler != handler) {
+        link = &(*link)->next;
+    }
+    if (*link == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    topic_subscription_t *subscription = *link;
+    *link = subscription->next;
+    free(subscription);
+    prune(router, node);
+    ESP_LOGD(TAG, "Unregistered handler for filter %s", filter);
+    return ESP_OK;
+}
+
+bool topic_router_is_empty(topic_router_handle_t router)
+{
+    return router->root->children == 0 && router->root->subscriptions == NULL;
+}
+
+static bool frontier_push(topic_router_handle_t router, int frontier, int *count, topic_node_t *node)
+{
+    if (*count == router->frontier_capacity[frontier]) {
+        int capacity = *count ? *count * 2 : TOPIC_ROUTER_INITIAL_FRONTIER;
+        topic_node_t **nodes = realloc(router->frontier[frontier], capacity * sizeof(topic_node_t *));
+        ESP_MEM_CHECK(TAG, nodes, return false);
+        router->frontier[frontier] = nodes;
+        router->frontier_capacity[frontier] = capacity;
+    }
+    router->frontier[frontier][(*count)++] = node;
+    return true;
+}
+
+static void collect(topic_router_handle_t router, const topic_node_t *node)
+{
+    for (topic_subscription_t *subscription = node->subscriptions; subscription; subscription = subscription->next) {
+        if (router->match_count == router->match_capacity) {
+            int capacity = router->match_capacity ? router->match_capacity * 2 : TOPIC_ROUTER_INITIAL_MATCHES;
+            topic_match_t *matches = realloc(router->matches, capacity * sizeof(topic_match_t));
+            ESP_MEM_CHECK(TAG, matches, return);
+            router->matches = matches;
+            router->match_capacity = capacity;
+        }
+        router->matches[router->match_count].handler = subscription->handler;
+        router->matches[router->match_count].handler_arg = subscription->handler_arg;
+        router->match_count++;
+    }
+}
+
+int topic_router_match(topic_router_handle_t router, const char *topic, int topic_len)
+{
+    router->match_count = 0;
+    if (topic_router_is_empty(router)) {
+        return 0;
+    }
+    // walk the trie level by level, the frontier holds every node matching the topic so far
+    // (it branches only at `+` nodes)
+    int current = 0, count = 0;
+    if (!frontier_push(router, current, &count, router->root)) {
+        return 0;
+    }
+    // topics starting with `$` are not matched by filters starting with a wildcard
+    bool system_topic = topic_len > 0 && topic[0] == '$';
+    const char *level = topic, *end = topic + topic_len;
+    for (;;) {
+        int level_len = level_length(level, end);
+        int next = current ^ 1, next_count = 0;
+        for (int i = 0; i < count; i++) {
+            topic_node_t *node = router->frontier[current][i];
+            bool wildcards = !(system_topic && node == router->root);
+            if (node->multi_level && wildcards) {
+                collect(router, node->multi_level);
+            }
+            if (node->single_level && wildcards) {
+                frontier_push(router, next, &next_count, node->single_level);
+            }
+            topic_node_t *child = find_child(router, node, level, level_len, level_hash(node, level, level_len));
+            if (child) {
+                frontier_push(router, next, &next_count, child);
+            }
+        }
+        current = next;
+        count = next_count;
+        if (count == 0) {
+            return router->match_count;
+        }
+        if (level + level_len == end) {
+            break;
+        }
+        level += level_len + 1;
+    }
+    for (int i = 0; i < count; i++) {
+        topic_node_t *node = router->frontier[current][i];
+        collect(router, node);
+        // `#` also matches its parent level, i.e. "sport/#" matches "sport"
+        if (node->multi_level) {
+            collect(router, node->multi_level);
+        }
+    }
+    return router->match_count;
+}
+
+void topic_router_deliver(topic_router_handle_t router, esp_mqtt_event_handle_t event)
+{
+    for (int i = 0; i < router->match_count; i++) {
+        router->matches[i].handler(router->matches[i].handler_arg, event);
+    }
+}
+
+void topic_router_destroy(topic_router_handle_t router)
+{
+    if (router->buckets) {
+        for (unsigned i = 0; i <= router->bucket_mask; i++) {
+            topic_node_t *node = router->buckets[i];
+            while (node) {
+                topic_node_t *next = node->hash_next;
+                free_node(node);
+                node = next;
+            }
+        }
+    }
+    if (router->root) {
+        free_node(router->root);
+    }
+    free(router->buckets);
+    free(router->frontier[0]);
+    free(router->frontier[1]);
+    free(router->matches);
+    free(router);
+}
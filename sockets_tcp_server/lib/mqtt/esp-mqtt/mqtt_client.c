@@ -9,6 +9,8 @@
 #include "esp_transport_ws.h"
 #include "platform.h"
 #include "mqtt_outbox.h"
+#include "mqtt_publish_queue.h"
+#include "mqtt_topic_router.h"
 #include "mqtt_supported_features.h"
 
 /* using uri parser */
@@ -109,6 +111,13 @@ struct esp_mqtt_client {
     bool run;
     bool wait_for_ping_resp;
     outbox_handle_t outbox;
+#ifdef MQTT_PUBLISH_QUEUE_ENABLED
+    publish_queue_handle_t publish_queue;
+    uint8_t *publish_staging;
+    int publish_staging_length;
+    uint16_t publish_staged_ids[MQTT_PUBLISH_QUEUE_SIZE];
+#endif
+    topic_router_handle_t topic_router;
     EventGroupHandle_t status_bits;
     SemaphoreHandle_t  api_lock;
     TaskHandle_t       task_handle;
@@ -484,6 +493,13 @@ esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *co
     client->mqtt_state.connect_info = &client->connect_info;
     client->outbox = outbox_init();
     ESP_MEM_CHECK(TAG, client->outbox, goto _mqtt_init_failed);
+#ifdef MQTT_PUBLISH_QUEUE_ENABLED
+    client->publish_queue = publish_queue_init(MQTT_PUBLISH_QUEUE_SIZE, buffer_size);
+    ESP_MEM_CHECK(TAG, client->publish_queue, goto _mqtt_init_failed);
+    client->publish_staging = (uint8_t *)malloc(buffer_size);
+    ESP_MEM_CHECK(TAG, client->publish_staging, goto _mqtt_init_failed);
+    client->publish_staging_length = buffer_size;
+#endif
     client->status_bits = xEventGroupCreate();
     ESP_MEM_CHECK(TAG, client->status_bits, goto _mqtt_init_failed);
     return client;
@@ -505,6 +521,15 @@ esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client)
     if (client->outbox) {
         outbox_destroy(client->outbox);
     }
+#ifdef MQTT_PUBLISH_QUEUE_ENABLED
+    if (client->publish_queue) {
+        publish_queue_destroy(client->publish_queue);
+    }
+    free(client->publish_staging);
+#endif
+    if (client->topic_router) {
+        topic_router_destroy(client->topic_router);
+    }
     if (client->status_bits) {
         vEventGroupDelete(client->status_bits);
     }
@@ -648,6 +673,9 @@ static esp_err_t deliver_publish(esp_mqtt_client_handle_t client)
     }
     ESP_LOGD(TAG, "%s: msg_topic_len=%u", __func__, msg_topic_len);
 
+    // find the topic handlers once, the following chunks of the message do not contain the topic
+    int topic_handlers = client->topic_router ? topic_router_match(client->topic_router, msg_topic, msg_topic_len) : 0;
+
     // get payload
     msg_data = mqtt_get_publish_data(msg_buf, &msg_data_len);
     if (msg_data_len > 0 && msg_data == NULL) {
@@ -668,6 +696,11 @@ post_data_event:
     client->event.current_data_offset = msg_data_offset;
     client->event.topic = msg_topic;
     client->event.topic_len = msg_topic_len;
+    if (topic_handlers > 0) {
+        client->event.client = client;
+        client->event.user_context = client->config->user_context;
+        topic_router_deliver(client->topic_router, &client->event);
+    }
     esp_mqtt_dispatch_event(client);
 
     if (msg_read_len < msg_total_len) {
@@ -706,7 +739,7 @@ static bool is_valid_mqtt_msg(esp_mqtt_client_handle_t client, int msg_type, int
     return false;
 }
 
-static void mqtt_enqueue_oversized(esp_mqtt_client_handle_t client, uint8_t *remaining_data, int remaining_len)
+static esp_err_t mqtt_enqueue_oversized(esp_mqtt_client_handle_t client, uint8_t *remaining_data, int remaining_len)
 {
     ESP_LOGD(TAG, "mqtt_enqueue_oversized id: %d, type=%d successful",
              client->mqtt_state.pending_msg_id, client->mqtt_state.pending_msg_type);
@@ -720,12 +753,14 @@ static void mqtt_enqueue_oversized(esp_mqtt_client_handle_t client, uint8_t *rem
     msg.remaining_data = remaining_data;
     msg.remaining_len = remaining_len;
     //Copy to queue buffer
-    outbox_enqueue(client->outbox, &msg, platform_tick_get_ms());
-
+    if (outbox_enqueue(client->outbox, &msg, platform_tick_get_ms()) == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
     //unlock
+    return ESP_OK;
 }
 
-static void mqtt_enqueue(esp_mqtt_client_handle_t client)
+static esp_err_t mqtt_enqueue(esp_mqtt_client_handle_t client)
 {
     ESP_LOGD(TAG, "mqtt_enqueue id: %d, type=%d successful",
              client->mqtt_state.pending_msg_id, client->mqtt_state.pending_msg_type);
@@ -738,9 +773,12 @@ static void mqtt_enqueue(esp_mqtt_client_handle_t client)
         msg.msg_type = client->mqtt_state.pending_msg_type;
         msg.msg_qos = client->mqtt_state.pending_publish_qos;
         //Copy to queue buffer
-        outbox_enqueue(client->outbox, &msg, platform_tick_get_ms());
+        if (outbox_enqueue(client->outbox, &msg, platform_tick_get_ms()) == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
     }
     //unlock
+    return ESP_OK;
 }
 
 
@@ -978,6 +1016,98 @@ static esp_err_t mqtt_process_receive(esp_mqtt_client_handle_t client)
     return ESP_OK;
 }
 
+#ifdef MQTT_PUBLISH_QUEUE_ENABLED
+static esp_err_t mqtt_write_publish_staging(esp_mqtt_client_handle_t client, int staged_len, int staged_msgs)
+{
+    mqtt_message_t staged = {
+        .data = client->publish_staging,
+        .length = staged_len,
+    };
+    mqtt_message_t *outbound_message = client->mqtt_state.outbound_message;
+    client->mqtt_state.outbound_message = &staged;
+    esp_err_t err = mqtt_write_data(client);
+    client->mqtt_state.outbound_message = outbound_message;
+    if (err != ESP_OK) {
+        return err;
+    }
+    for (int i = 0; i < staged_msgs; i++) {
+        if (client->publish_staged_ids[i]) {
+            outbox_set_tick(client->outbox, client->publish_staged_ids[i], platform_tick_get_ms());
+            outbox_set_pending(client->outbox, client->publish_staged_ids[i], TRANSMITTED);
+        }
+    }
+    ESP_LOGD(TAG, "Sent %d enqueued messages in one write, len=%d", staged_msgs, staged_len);
+    return ESP_OK;
+}
+
+/*
+ * Drains the messages serialized by esp_mqtt_client_enqueue(), packets are copied back to back
+ * into the staging buffer, so that a burst of small publishes costs a single transport write.
+ * QoS>0 messages are stored in the outbox as usual; if the client is not connected they stay
+ * queued there for sending after reconnection, QoS0 messages are dropped.
+ */
+static esp_err_t mqtt_process_publish_queue(esp_mqtt_client_handle_t client)
+{
+    publish_slot_t *slot;
+    int staged_len = 0;
+    int staged_msgs = 0;
+    esp_err_t err = ESP_OK;
+    while ((slot = publish_queue_peek(client->publish_queue)) != NULL) {
+        if (slot->len > 0) {
+            if (slot->msg_qos > 0) {
+                outbox_message_t msg = {
+                    .data = slot->data,
+                    .len = slot->len,
+                    .msg_id = slot->msg_id,
+                    .msg_type = slot->msg_type,
+                    .msg_qos = slot->msg_qos,
+                };
+                if (outbox_enqueue(client->outbox, &msg, platform_tick_get_ms())) {
+                    client->mqtt_state.pending_msg_count ++;
+                }
+            }
+            if (client->state == MQTT_STATE_CONNECTED && err == ESP_OK) {
+                if (staged_len + slot->len > client->publish_staging_length || staged_msgs == MQTT_PUBLISH_QUEUE_SIZE) {
+                    err = mqtt_write_publish_staging(client, staged_len, staged_msgs);
+                    staged_len = 0;
+                    staged_msgs = 0;
+                }
+                if (err == ESP_OK) {
+                    memcpy(client->publish_staging + staged_len, slot->data, slot->len);
+                    staged_len += slot->len;
+                    client->publish_staged_ids[staged_msgs++] = slot->msg_qos > 0 ? slot->msg_id : 0;
+                }
+            } else if (slot->msg_qos == 0) {
+                ESP_LOGW(TAG, "Publish: Losing qos0 data when client not connected");
+            }
+        }
+        publish_queue_release(client->publish_queue, slot);
+    }
+    if (staged_len > 0 && err == ESP_OK) {
+        err = mqtt_write_publish_staging(client, staged_len, staged_msgs);
+    }
+    return err;
+}
+#endif /* MQTT_PUBLISH_QUEUE_ENABLED */
+
+static int mqtt_poll_read(esp_mqtt_client_handle_t client)
+{
+#ifdef MQTT_PUBLISH_QUEUE_ENABLED
+    // wait in short slices, so that enqueued messages are sent without waiting for the full poll timeout
+    int ret = 0;
+    for (int waited = 0; waited < MQTT_POLL_READ_TIMEOUT_MS && publish_queue_is_empty(client->publish_queue);
+            waited += MQTT_PUBLISH_QUEUE_FLUSH_MS) {
+        ret = esp_transport_poll_read(client->transport, MQTT_PUBLISH_QUEUE_FLUSH_MS);
+        if (ret != 0) {
+            break;
+        }
+    }
+    return ret;
+#else
+    return esp_transport_poll_read(client->transport, MQTT_POLL_READ_TIMEOUT_MS);
+#endif
+}
+
 static esp_err_t mqtt_resend_queued(esp_mqtt_client_handle_t client, outbox_item_handle_t item)
 {
     // decode queued data
@@ -1020,6 +1150,11 @@ static void esp_mqtt_task(void *pv)
     xEventGroupClearBits(client->status_bits, STOPPED_BIT);
     while (client->run) {
         MQTT_API_LOCK(client);
+#ifdef MQTT_PUBLISH_QUEUE_ENABLED
+        if (mqtt_process_publish_queue(client) != ESP_OK) {
+            esp_mqtt_abort_connection(client);
+        }
+#endif
         switch ((int)client->state) {
         case MQTT_STATE_INIT:
             xEventGroupClearBits(client->status_bits, RECONNECT_BIT);
@@ -1138,7 +1273,7 @@ static void esp_mqtt_task(void *pv)
         }
         MQTT_API_UNLOCK(client);
         if (MQTT_STATE_CONNECTED == client->state) {
-            if (esp_transport_poll_read(client->transport, MQTT_POLL_READ_TIMEOUT_MS) < 0) {
+            if (mqtt_poll_read(client) < 0) {
                 ESP_LOGE(TAG, "Poll read error: %d, aborting connection", errno);
                 esp_mqtt_abort_connection(client);
             }
@@ -1244,7 +1379,12 @@ int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic
 
     client->mqtt_state.pending_msg_type = mqtt_get_type(client->mqtt_state.outbound_message->data);
     client->mqtt_state.pending_msg_count ++;
-    mqtt_enqueue(client); //move pending msg to outbox (if have)
+    if (mqtt_enqueue(client) != ESP_OK) { //move pending msg to outbox (if have)
+        ESP_LOGE(TAG, "Cannot keep msg_id=%d for retransmission", client->mqtt_state.pending_msg_id);
+        client->mqtt_state.pending_msg_count --;
+        MQTT_API_UNLOCK_FROM_OTHER_TASK(client);
+        return -1;
+    }
     outbox_set_pending(client->outbox, client->mqtt_state.pending_msg_id, TRANSMITTED);
 
     if (mqtt_write_data(client) != ESP_OK) {
@@ -1273,7 +1413,12 @@ int esp_mqtt_client_unsubscribe(esp_mqtt_client_handle_t client, const char *top
 
     client->mqtt_state.pending_msg_type = mqtt_get_type(client->mqtt_state.outbound_message->data);
     client->mqtt_state.pending_msg_count ++;
-    mqtt_enqueue(client);
+    if (mqtt_enqueue(client) != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot keep msg_id=%d for retransmission", client->mqtt_state.pending_msg_id);
+        client->mqtt_state.pending_msg_count --;
+        MQTT_API_UNLOCK_FROM_OTHER_TASK(client);
+        return -1;
+    }
     outbox_set_pending(client->outbox, client->mqtt_state.pending_msg_id, TRANSMITTED);
 
     if (mqtt_write_data(client) != ESP_OK) {
@@ -1319,8 +1464,12 @@ int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic,
         client->mqtt_state.pending_publish_qos = qos;
         client->mqtt_state.pending_msg_count ++;
         // by default store as QUEUED (not transmitted yet) only for messages which would fit outbound buffer
-        if (client->mqtt_state.mqtt_connection.message.fragmented_msg_total_length == 0) {
-            mqtt_enqueue(client);
+        if (client->mqtt_state.mqtt_connection.message.fragmented_msg_total_length == 0 &&
+                mqtt_enqueue(client) != ESP_OK) {
+            ESP_LOGE(TAG, "Cannot keep msg_id=%d for retransmission", pending_msg_id);
+            client->mqtt_state.pending_msg_count --;
+            MQTT_API_UNLOCK_FROM_OTHER_TASK(client);
+            return -1;
         }
     } else {
         client->mqtt_state.outbound_message = publish_msg;
@@ -1336,6 +1485,7 @@ int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic,
     int remaining_len = len;
     const char *current_data = data;
     bool sending = true;
+    bool enqueue_failed = false;
 
     while (sending)  {
 
@@ -1357,7 +1507,12 @@ int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic,
                 connection->message.fragmented_msg_total_length = 0;
                 if (qos > 0) {
                     // internally enqueue all big messages, as they dont fit 'pending msg' structure
-                    mqtt_enqueue_oversized(client, (uint8_t *)current_data, remaining_len);
+                    if (mqtt_enqueue_oversized(client, (uint8_t *)current_data, remaining_len) != ESP_OK) {
+                        // the message is still sent completely, but cannot be retransmitted
+                        ESP_LOGE(TAG, "Cannot keep msg_id=%d for retransmission", pending_msg_id);
+                        client->mqtt_state.pending_msg_count --;
+                        enqueue_failed = true;
+                    }
                 }
             }
 
@@ -1379,6 +1534,10 @@ int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic,
         }
     }
 
+    if (enqueue_failed) {
+        MQTT_API_UNLOCK_FROM_OTHER_TASK(client);
+        return -1;
+    }
     if (qos > 0) {        
         //Tick is set after transmit to avoid retransmitting too early due slow network speed / big messages
         outbox_set_tick(client->outbox, pending_msg_id, platform_tick_get_ms());
@@ -1395,6 +1554,57 @@ cannot_publish:
     return 0;
 }
 
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain)
+{
+    if (client == NULL) {
+        return -1;
+    }
+#ifdef MQTT_PUBLISH_QUEUE_ENABLED
+    uint16_t msg_id = 0;
+    if (topic == NULL || topic[0] == '\0') {
+        ESP_LOGE(TAG, "Enqueue: invalid topic");
+        return -1;
+    }
+    if (len <= 0 && data != NULL) {
+        len = strlen(data);
+    }
+    // fixed header (up to 5 bytes), topic, message id and payload have to fit one slot
+    int slot_size = publish_queue_get_slot_size(client->publish_queue);
+    if (5 + 2 + (int)strlen(topic) + (qos > 0 ? 2 : 0) + len > slot_size) {
+        ESP_LOGE(TAG, "Enqueue: message does not fit the buffer (%d bytes), use esp_mqtt_client_publish()", slot_size);
+        return -1;
+    }
+
+    /* Serialize into a slot of the publish queue, no lock is taken and nothing is written to the
+       transport here; the mqtt task sends the message on its next iteration */
+    publish_slot_t *slot = publish_queue_claim(client->publish_queue);
+    if (slot == NULL) {
+        ESP_LOGW(TAG, "Enqueue: publish queue is full");
+        return -1;
+    }
+    mqtt_connection_t connection;
+    mqtt_msg_init(&connection, slot->buffer, slot_size);
+    mqtt_message_t *publish_msg = mqtt_msg_publish(&connection, topic, data, len, qos, retain, &msg_id);
+    int msg_len = publish_msg->length;
+    slot->data = publish_msg->data;
+    slot->len = msg_len;
+    slot->msg_id = msg_id;
+    slot->msg_type = MQTT_MSG_TYPE_PUBLISH;
+    slot->msg_qos = qos;
+    // the slot has to be committed even on failure (zero length), the task skips it;
+    // it belongs to the task after commit and must not be accessed anymore
+    publish_queue_commit(client->publish_queue, slot);
+    if (msg_len == 0) {
+        ESP_LOGE(TAG, "Enqueue: message cannot be created");
+        return -1;
+    }
+    return msg_id;
+#else
+    ESP_LOGE(TAG, "Enqueue: publish queue not enabled, please enable MQTT_PUBLISH_QUEUE");
+    return -1;
+#endif
+}
+
 
 esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event, esp_event_handler_t event_handler, void* event_handler_arg)
 {
@@ -1413,3 +1623,35 @@ esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mq
     return ESP_FAIL;
 #endif
 }
+
+esp_err_t esp_mqtt_client_register_topic_handler(esp_mqtt_client_handle_t client, const char *filter, esp_mqtt_topic_handler_t handler, void *handler_arg)
+{
+    if (client == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    MQTT_API_LOCK_FROM_OTHER_TASK(client);
+    if (client->topic_router == NULL) {
+        client->topic_router = topic_router_create();
+        ESP_MEM_CHECK(TAG, client->topic_router, {
+            MQTT_API_UNLOCK_FROM_OTHER_TASK(client);
+            return ESP_ERR_NO_MEM;
+        });
+    }
+    esp_err_t err = topic_router_add(client->topic_router, filter, handler, handler_arg);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register topic handler for %s, error=0x%x", filter ? filter : "(null)", err);
+    }
+    MQTT_API_UNLOCK_FROM_OTHER_TASK(client);
+    return err;
+}
+
+esp_err_t esp_mqtt_client_unregister_topic_handler(esp_mqtt_client_handle_t client, const char *filter, esp_mqtt_topic_handler_t handler)
+{
+    if (client == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    MQTT_API_LOCK_FROM_OTHER_TASK(client);
+    esp_err_t err = client->topic_router ? topic_router_remove(client->topic_router, filter, handler) : ESP_ERR_NOT_FOUND;
+    MQTT_API_UNLOCK_FROM_OTHER_TASK(client);
+    return err;
+}
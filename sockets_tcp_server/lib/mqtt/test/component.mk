@@ -1,4 +1,5 @@
 #
 #Component Makefile
 #
+COMPONENT_PRIV_INCLUDEDIRS := ../esp-mqtt/lib/include
 COMPONENT_ADD_LDFLAGS = -Wl,--whole-archive -l$(COMPONENT_NAME) -Wl,--no-whole-archive
\ No newline at end of file
@@ -2,8 +2,13 @@
 #include "mqtt_client.h"
 #include "unity.h"
 #include <sys/time.h>
+#include <string.h>
 #include "nvs_flash.h"
 #include "esp_ota_ops.h"
+#include "esp_timer.h"
+#include "mqtt_topic_router.h"
+#include "mqtt_msg.h"
+#include "mqtt_outbox.h"
 
 static void test_leak_setup(const char * file, long line)
 {
@@ -68,3 +73,175 @@ TEST_CASE("mqtt enqueue and destroy outbox", "[mqtt][leaks=0]")
 
     esp_mqtt_client_destroy(client);
 }
+
+#if !CONFIG_MQTT_CUSTOM_OUTBOX
+static outbox_item_handle_t test_outbox_enqueue(outbox_handle_t outbox, int msg_id, const char *data, int len)
+{
+    outbox_message_t msg = {
+        .data = (uint8_t *)data,
+        .len = len,
+        .msg_id = msg_id,
+        .msg_type = MQTT_MSG_TYPE_PUBLISH,
+        .msg_qos = 1,
+    };
+    return outbox_enqueue(outbox, &msg, 0);
+}
+
+TEST_CASE("mqtt outbox reuses the space of acknowledged messages", "[mqtt][leaks=0]")
+{
+    const char * bin_addr = this_bin_addr();
+    test_leak_setup(__FILE__, __LINE__);
+    // all messages fit the preallocated storage
+    const int messages = CONFIG_MQTT_OUTBOX_MAX_ITEMS;
+    const int size = CONFIG_MQTT_OUTBOX_DATA_SIZE / messages / 2;
+    outbox_handle_t outbox = outbox_init();
+    TEST_ASSERT_NOT_EQUAL(NULL, outbox);
+    // the first message allocates the outbox storage
+    TEST_ASSERT_NOT_EQUAL(NULL, test_outbox_enqueue(outbox, 1, bin_addr, size));
+    int bytes_before = esp_get_free_heap_size();
+    for (int i = 2; i <= messages; ++i) {
+        TEST_ASSERT_NOT_EQUAL(NULL, test_outbox_enqueue(outbox, i, bin_addr, size));
+    }
+    // an old message pending does not prevent the space of newer ones from being reused
+    for (int i = 0; i < CONFIG_MQTT_OUTBOX_MAX_ITEMS * 4; ++i) {
+        TEST_ASSERT_EQUAL(ESP_OK, outbox_delete(outbox, messages / 2, MQTT_MSG_TYPE_PUBLISH));
+        TEST_ASSERT_NOT_EQUAL(NULL, test_outbox_enqueue(outbox, messages / 2, bin_addr, size));
+    }
+    int bytes_after = esp_get_free_heap_size();
+    // check that outbox stored all messages in its preallocated storage, not on heap
+    TEST_ASSERT_EQUAL(bytes_before, bytes_after);
+    TEST_ASSERT_EQUAL(messages * size, outbox_get_size(outbox));
+    outbox_destroy(outbox);
+}
+
+TEST_CASE("mqtt outbox keeps messages on heap when its storage is full", "[mqtt][leaks=0]")
+{
+    const char * bin_addr = this_bin_addr();
+    test_leak_setup(__FILE__, __LINE__);
+    // more messages and more data than the preallocated storage
+    const int messages = CONFIG_MQTT_OUTBOX_MAX_ITEMS + 8;
+    const int size = CONFIG_MQTT_OUTBOX_DATA_SIZE / CONFIG_MQTT_OUTBOX_MAX_ITEMS * 2;
+    outbox_handle_t outbox = outbox_init();
+    TEST_ASSERT_NOT_EQUAL(NULL, outbox);
+    for (int i = 1; i <= messages; ++i) {
+        TEST_ASSERT_NOT_EQUAL(NULL, test_outbox_enqueue(outbox, i, bin_addr + i, size));
+    }
+    TEST_ASSERT_EQUAL(messages * size, outbox_get_size(outbox));
+    for (int i = 1; i <= messages; ++i) {
+        size_t len;
+        uint16_t msg_id;
+        int msg_type;
+        int qos;
+        uint8_t *data = outbox_item_get_data(outbox_get(outbox, i), &len, &msg_id, &msg_type, &qos);
+        TEST_ASSERT_NOT_EQUAL(NULL, data);
+        TEST_ASSERT_EQUAL(size, len);
+        TEST_ASSERT_EQUAL(i, msg_id);
+        TEST_ASSERT_EQUAL_MEMORY(bin_addr + i, data, size);
+    }
+    // deleting the oldest messages releases both preallocated and heap allocated ones
+    TEST_ASSERT_EQUAL(messages, outbox_delete_expired(outbox, 1, 0));
+    TEST_ASSERT_EQUAL(0, outbox_get_size(outbox));
+    outbox_destroy(outbox);
+}
+#endif
+
+#if CONFIG_MQTT_PUBLISH_QUEUE
+TEST_CASE("mqtt enqueue into publish queue", "[mqtt][leaks=0]")
+{
+    test_leak_setup(__FILE__, __LINE__);
+    const esp_mqtt_client_config_t mqtt_cfg = {
+            // no connection takes place, messages stay in the publish queue
+            .uri = "mqtts://localhost:8883",
+            .buffer_size = 256,
+    };
+    char oversized[300];
+    memset(oversized, 'x', sizeof(oversized));
+    esp_mqtt_client_handle_t client = esp_mqtt_client_init(&mqtt_cfg);
+    TEST_ASSERT_NOT_EQUAL(NULL, client );
+    TEST_ASSERT_EQUAL(-1, esp_mqtt_client_enqueue(NULL, "test", "data", 0, 1, 0));
+    TEST_ASSERT_EQUAL(-1, esp_mqtt_client_enqueue(client, "test", oversized, sizeof(oversized), 1, 0));
+    TEST_ASSERT_EQUAL(-1, esp_mqtt_client_enqueue(client, "", "data", 0, 1, 0));
+    TEST_ASSERT_EQUAL(0, esp_mqtt_client_enqueue(client, "test", "data", 0, 0, 0));
+    for (int i=1; i<CONFIG_MQTT_PUBLISH_QUEUE_SIZE; ++i) {
+        TEST_ASSERT_GREATER_THAN(0, esp_mqtt_client_enqueue(client, "test", "data", 0, 1, 0));
+    }
+    esp_mqtt_client_destroy(client);
+}
+#endif
+
+static void count_topic_handler(void *handler_arg, esp_mqtt_event_handle_t event)
+{
+    (*(int *)handler_arg)++;
+}
+
+TEST_CASE("mqtt topic handlers with wildcard filters", "[mqtt][leaks=0]")
+{
+    test_leak_setup(__FILE__, __LINE__);
+    const esp_mqtt_client_config_t mqtt_cfg = {
+            // no connection takes place, but the uri has to be valid for init() to succeed
+            .uri = "mqtts://localhost:8883",
+    };
+    int exact = 0, single = 0, multi = 0;
+    esp_mqtt_client_handle_t client = esp_mqtt_client_init(&mqtt_cfg);
+    TEST_ASSERT_NOT_EQUAL(NULL, client );
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_mqtt_client_register_topic_handler(client, "sport/#/player", count_topic_handler, &multi));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_mqtt_client_register_topic_handler(client, "sport/tennis+", count_topic_handler, &single));
+    TEST_ESP_OK(esp_mqtt_client_register_topic_handler(client, "sport/tennis/player1", count_topic_handler, &exact));
+    TEST_ESP_OK(esp_mqtt_client_register_topic_handler(client, "sport/+/player1", count_topic_handler, &single));
+    TEST_ESP_OK(esp_mqtt_client_register_topic_handler(client, "sport/#", count_topic_handler, &multi));
+    TEST_ESP_OK(esp_mqtt_client_unregister_topic_handler(client, "sport/#", count_topic_handler));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, esp_mqtt_client_unregister_topic_handler(client, "sport/#", count_topic_handler));
+    esp_mqtt_client_destroy(client);
+
+    // match the router directly, the client would need a broker to receive messages
+    topic_router_handle_t router = topic_router_create();
+    TEST_ASSERT_NOT_EQUAL(NULL, router);
+    TEST_ESP_OK(topic_router_add(router, "sport/tennis/player1", count_topic_handler, &exact));
+    TEST_ESP_OK(topic_router_add(router, "sport/+/player1", count_topic_handler, &single));
+    TEST_ESP_OK(topic_router_add(router, "sport/#", count_topic_handler, &multi));
+    TEST_ESP_OK(topic_router_add(router, "#", count_topic_handler, &multi));
+    const char *topics[] = { "sport/tennis/player1", "sport/golf/player1", "sport", "$SYS/broker" };
+    const int matches[] = { 4, 3, 2, 0 };
+    for (int i = 0; i < sizeof(topics) / sizeof(topics[0]); i++) {
+        TEST_ASSERT_EQUAL(matches[i], topic_router_match(router, topics[i], strlen(topics[i])));
+        topic_router_deliver(router, NULL);
+    }
+    TEST_ASSERT_EQUAL(1, exact);
+    TEST_ASSERT_EQUAL(2, single);
+    TEST_ASSERT_EQUAL(6, multi);
+    topic_router_destroy(router);
+}
+
+TEST_CASE("mqtt topic router performance", "[mqtt][timeout=60]")
+{
+    const int filters = 2000;
+    const int messages = 20000;
+    char topic[64];
+    int routed = 0;
+    topic_router_handle_t router = topic_router_create();
+    TEST_ASSERT_NOT_EQUAL(NULL, router);
+    for (int i = 0; i < filters; i++) {
+        snprintf(topic, sizeof(topic), "building/%d/floor/%d/sensor/%d", i % 20, (i / 20) % 10, i);
+        TEST_ESP_OK(topic_router_add(router, topic, count_topic_handler, &routed));
+    }
+    for (int i = 0; i < 20; i++) {
+        snprintf(topic, sizeof(topic), "building/%d/+/+/alarm", i);
+        TEST_ESP_OK(topic_router_add(router, topic, count_topic_handler, &routed));
+        snprintf(topic, sizeof(topic), "building/%d/floor/#", i);
+        TEST_ESP_OK(topic_router_add(router, topic, count_topic_handler, &routed));
+    }
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < messages; i++) {
+        int n = i % filters;
+        int len = snprintf(topic, sizeof(topic), "building/%d/floor/%d/sensor/%d", n % 20, (n / 20) % 10, n);
+        topic_router_match(router, topic, len);
+        topic_router_deliver(router, NULL);
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    topic_router_destroy(router);
+
+    // every message matches its own filter and the "building/x/floor/#" one
+    TEST_ASSERT_EQUAL(2 * messages, routed);
+    int routed_per_second = (int)(messages * 1000000LL / elapsed);
+    TEST_PERFORMANCE_GREATER_THAN(MQTT_TOPIC_ROUTING, "%d", routed_per_second);
+}
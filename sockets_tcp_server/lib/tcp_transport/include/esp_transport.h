@@ -66,6 +66,20 @@ esp_err_t esp_transport_list_destroy(esp_transport_list_handle_t list);
  */
 esp_err_t esp_transport_list_add(esp_transport_list_handle_t list, esp_transport_handle_t t, const char *scheme);
 
+/**
+ * @brief      Remove a transport from the list without destroying it, the caller takes over its ownership.
+ *             The transport no longer shares the error tracker of the list.
+ *
+ * @param[in]  list  The list
+ * @param[in]  t     The transport
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ *     - ESP_ERR_NOT_FOUND if the transport is not in the list
+ */
+esp_err_t esp_transport_list_remove(esp_transport_list_handle_t list, esp_transport_handle_t t);
+
 /**
  * @brief      This function will remove all transport from the list,
  *             invoke esp_transport_destroy of every transport have added this the list
@@ -0,0 +1,111 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_TRANSPORT_POOL_H_
+#define _ESP_TRANSPORT_POOL_H_
+
+#include <stdint.h>
+#include "esp_transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Pool of idle, connected transports keyed by scheme, host and port
+ *
+ * A client which is done with a kept-alive connection puts the transport to the pool, the next
+ * client connecting to the same endpoint gets it back instead of opening a new connection (and
+ * doing a new TLS handshake). Transports idle for longer than the configured timeout, or which
+ * became readable while idle (closed by the peer or out of sync), are closed and destroyed
+ * instead of being handed out.
+ */
+typedef struct esp_transport_pool *esp_transport_pool_handle_t;
+
+/**
+ * Transport pool configuration
+ */
+typedef struct {
+    int max_connections;    /*!< Maximum number of idle transports, the least recently used one is evicted */
+    int idle_timeout_ms;    /*!< Idle transports older than this are not reused */
+} esp_transport_pool_config_t;
+
+/**
+ * @brief      Create a transport pool
+ *
+ * @param[in]  config  The pool configuration
+ *
+ * @return     The pool handle, or NULL if it could not be allocated
+ */
+esp_transport_pool_handle_t esp_transport_pool_init(const esp_transport_pool_config_t *config);
+
+/**
+ * @brief      Put a connected transport to the pool
+ *
+ * The pool takes the ownership of the transport in all cases: if it can not be stored, it is
+ * closed and destroyed. The transport must not belong to a transport list.
+ *
+ * @param[in]  pool       The pool handle
+ * @param[in]  t          The connected transport
+ * @param[in]  scheme     The scheme the transport was used for
+ * @param[in]  host       The host it is connected to
+ * @param[in]  port       The port it is connected to
+ * @param[in]  config_id  Identifier of the configuration of the transport (e.g. of its TLS settings),
+ *                        a transport is only reused by clients asking for the same one
+ *
+ * @return
+ *     - ESP_OK if the transport was stored
+ *     - ESP_ERR_INVALID_ARG
+ *     - ESP_ERR_NO_MEM if the transport was destroyed
+ */
+esp_err_t esp_transport_pool_put(esp_transport_pool_handle_t pool, esp_transport_handle_t t,
+                                 const char *scheme, const char *host, int port, uint32_t config_id);
+
+/**
+ * @brief      Take an idle transport connected to the endpoint out of the pool
+ *
+ * @param[in]  pool       The pool handle
+ * @param[in]  scheme     The scheme
+ * @param[in]  host       The host (compared case insensitively)
+ * @param[in]  port       The port
+ * @param[in]  config_id  The configuration identifier given to esp_transport_pool_put()
+ *
+ * @return     The connected transport, owned by the caller, or NULL if there is none
+ */
+esp_transport_handle_t esp_transport_pool_get(esp_transport_pool_handle_t pool,
+                                              const char *scheme, const char *host, int port, uint32_t config_id);
+
+/**
+ * @brief      Close and destroy all the idle transports of the pool
+ *
+ * @param[in]  pool  The pool handle
+ */
+void esp_transport_pool_flush(esp_transport_pool_handle_t pool);
+
+/**
+ * @brief      Flush and free the pool
+ *
+ * @param[in]  pool  The pool handle
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t esp_transport_pool_destroy(esp_transport_pool_handle_t pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_TRANSPORT_POOL_H_ */
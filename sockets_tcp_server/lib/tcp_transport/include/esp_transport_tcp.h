@@ -28,6 +28,24 @@ extern "C" {
  */
 esp_transport_handle_t esp_transport_tcp_init(void);
 
+struct pbuf;
+
+/**
+ * @brief      Read from a TCP transport without copying: the received pbuf chain of the
+ *             TCP/IP stack is handed over to the caller, who releases it with pbuf_free()
+ *
+ * @param      t           The transport handle, created by esp_transport_tcp_init()
+ * @param[out] p           Set to the received pbuf chain, or NULL if nothing was received
+ * @param[in]  len         Maximum number of bytes to receive
+ * @param[in]  timeout_ms  The timeout milliseconds (-1 indicates wait forever)
+ *
+ * @return
+ *  - Number of bytes in the pbuf chain
+ *  - 0 on timeout
+ *  - (-1) if there are any errors or the connection was closed, should check errno
+ */
+int esp_transport_tcp_read_pbuf(esp_transport_handle_t t, struct pbuf **p, int len, int timeout_ms);
+
 
 #ifdef __cplusplus
 }
@@ -7,6 +7,7 @@
 #ifndef _ESP_TRANSPORT_WS_H_
 #define _ESP_TRANSPORT_WS_H_
 
+#include <stdbool.h>
 #include "esp_transport.h"
 
 #ifdef __cplusplus
@@ -21,8 +22,19 @@ typedef enum ws_transport_opcodes {
     WS_TRANSPORT_OPCODES_PING = 0x09,
     WS_TRANSPORT_OPCODES_PONG = 0x0a,
     WS_TRANSPORT_OPCODES_FIN = 0x80,
+    WS_TRANSPORT_OPCODES_RSV1 = 0x40,  /*!< Set on the first frame of a compressed message (permessage-deflate) */
 } ws_transport_opcodes_t;
 
+/**
+ * @brief permessage-deflate extension parameters (RFC 7692)
+ */
+typedef struct {
+    int client_max_window_bits;         /*!< LZ77 window (8..15) of the messages sent by the client */
+    int server_max_window_bits;         /*!< LZ77 window (8..15) of the messages sent by the server */
+    bool client_no_context_takeover;    /*!< Client messages are compressed independently of the previous ones */
+    bool server_no_context_takeover;    /*!< Server messages are compressed independently of the previous ones */
+} esp_transport_ws_deflate_config_t;
+
 /**
  * @brief      Create web socket transport
  *
@@ -117,6 +129,58 @@ ws_transport_opcodes_t esp_transport_ws_get_read_opcode(esp_transport_handle_t t
  */
 int esp_transport_ws_get_read_payload_len(esp_transport_handle_t t);
 
+/**
+ * @brief               Returns whether the last received frame is the final fragment of its message
+ *
+ * @param t             websocket transport handle
+ *
+ * @return
+ *      - FIN flag of the last received frame
+ */
+bool esp_transport_ws_get_fin_flag(esp_transport_handle_t t);
+
+/**
+ * @brief               Returns the RSV1 bit of the last received frame, set on the first frame
+ *                      of a compressed message when permessage-deflate is negotiated
+ *
+ * @param t             websocket transport handle
+ *
+ * @return
+ *      - RSV1 flag of the last received frame
+ */
+bool esp_transport_ws_get_rsv1_flag(esp_transport_handle_t t);
+
+/**
+ * @brief               Offer the permessage-deflate extension in the upgrade request
+ *
+ * The transport only negotiates the extension, the messages are compressed and decompressed by
+ * the user of the transport, which sends them with WS_TRANSPORT_OPCODES_RSV1 set.
+ * If the server answers with parameters which were not offered (or with an other extension),
+ * the connection fails.
+ *
+ * @param t             websocket transport handle
+ * @param config        parameters to offer, the window bits are the maximum accepted values;
+ *                      NULL stops offering the extension
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if the window bits are not within 8..15
+ *      - ESP_ERR_NO_MEM
+ */
+esp_err_t esp_transport_ws_set_permessage_deflate(esp_transport_handle_t t, const esp_transport_ws_deflate_config_t *config);
+
+/**
+ * @brief               Get the permessage-deflate parameters agreed with the server on the last connection
+ *
+ * @param t             websocket transport handle
+ * @param[out] agreed   parameters in use, the window bits are the ones each side may use at most
+ *
+ * @return
+ *      - ESP_OK if the extension is in use
+ *      - ESP_ERR_NOT_FOUND if the extension was not negotiated
+ */
+esp_err_t esp_transport_ws_get_permessage_deflate(esp_transport_handle_t t, esp_transport_ws_deflate_config_t *agreed);
+
 
 #ifdef __cplusplus
 }
@@ -1,9 +1,11 @@
+#include <string.h>
 #include "unity.h"
 
 #include "esp_transport.h"
 #include "esp_transport_tcp.h"
 #include "esp_transport_ssl.h"
 #include "esp_transport_ws.h"
+#include "esp_transport_pool.h"
 #include "test_utils.h"
 #include "esp_log.h"
 #include "lwip/err.h"
@@ -11,6 +13,7 @@
 #include "lwip/sys.h"
 #include <lwip/netdb.h>
 #include "freertos/event_groups.h"
+#include "esp_timer.h"
 
 #define TCP_CONNECT_DONE (1)
 #define TCP_LISTENER_DONE (2)
@@ -177,3 +180,228 @@ TEST_CASE("tcp_transport: connect timeout", "[tcp_transport]")
     test_utils_task_delete(localhost_listener_task_handle);
     test_utils_task_delete(tcp_connect_task_handle);
 }
+
+/* Parent transport of the websocket tests, stores the written bytes (if `sink` is set) and serves reads from `source` */
+static struct {
+    char *sink;
+    int sink_len;
+    const char *source;
+    int source_len;
+    int source_pos;
+} s_ws_parent;
+
+static int ws_parent_poll(esp_transport_handle_t t, int timeout_ms)
+{
+    return 1;
+}
+
+static int ws_parent_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    if (s_ws_parent.sink) {
+        memcpy(s_ws_parent.sink + s_ws_parent.sink_len, buffer, len);
+    }
+    s_ws_parent.sink_len += len;
+    return len;
+}
+
+static int ws_parent_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+{
+    if (len > s_ws_parent.source_len - s_ws_parent.source_pos) {
+        len = s_ws_parent.source_len - s_ws_parent.source_pos;
+    }
+    memcpy(buffer, s_ws_parent.source + s_ws_parent.source_pos, len);
+    s_ws_parent.source_pos += len;
+    return len;
+}
+
+static esp_transport_handle_t ws_parent_init(void)
+{
+    esp_transport_handle_t parent = esp_transport_init();
+    esp_transport_set_func(parent, NULL, ws_parent_read, ws_parent_write, NULL, ws_parent_poll, ws_parent_poll, NULL);
+    memset(&s_ws_parent, 0, sizeof(s_ws_parent));
+    return parent;
+}
+
+TEST_CASE("tcp_transport: ws frames are masked without modifying the data", "[tcp_transport][leaks=0]")
+{
+    const int sizes[] = { 0, 1, 5, 125, 126, 300, 4095, 4096, 10000, 70000 };
+    esp_transport_handle_t parent = ws_parent_init();
+    esp_transport_handle_t ws = esp_transport_ws_init(parent);
+    TEST_ASSERT_NOT_NULL(ws);
+    for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        // payload at an odd address, the transport still masks it word-wise in its own buffer
+        const int len = sizes[i];
+        uint8_t *data = malloc(len + 1);
+        uint8_t *frame = malloc(len + 14);
+        char *received = malloc(len + 1);
+        TEST_ASSERT_NOT_NULL(data);
+        TEST_ASSERT_NOT_NULL(frame);
+        TEST_ASSERT_NOT_NULL(received);
+        for (int j = 0; j < len + 1; j++) {
+            data[j] = j * 7;
+        }
+        s_ws_parent.sink = (char *)frame;
+        s_ws_parent.sink_len = 0;
+        TEST_ASSERT_EQUAL(len, esp_transport_ws_send_raw(ws, WS_TRANSPORT_OPCODES_BINARY | WS_TRANSPORT_OPCODES_FIN, (char *)data + 1, len, 100));
+        for (int j = 0; j < len + 1; j++) {
+            TEST_ASSERT_EQUAL_UINT8((uint8_t)(j * 7), data[j]);
+        }
+
+        int header_len = len <= 125 ? 2 : (len < 65536 ? 4 : 10);
+        TEST_ASSERT_EQUAL(header_len + 4 + len, s_ws_parent.sink_len);
+        TEST_ASSERT_EQUAL_HEX8(0x82, frame[0]);
+        TEST_ASSERT_EQUAL_HEX8(0x80, frame[1] & 0x80);
+        const uint8_t *mask = frame + header_len;
+        for (int j = 0; j < len; j++) {
+            TEST_ASSERT_EQUAL_UINT8(data[j + 1], frame[header_len + 4 + j] ^ mask[j % 4]);
+        }
+
+        // read the masked frame back in chunks not aligned to the mask
+        s_ws_parent.source = (char *)frame;
+        s_ws_parent.source_len = s_ws_parent.sink_len;
+        s_ws_parent.source_pos = 0;
+        int received_len = 0;
+        do {
+            int chunk = len - received_len > 333 ? 333 : len - received_len;
+            int rlen = esp_transport_read(ws, received + received_len, chunk, 100);
+            TEST_ASSERT_EQUAL(chunk, rlen);
+            received_len += rlen;
+        } while (received_len < len);
+        TEST_ASSERT_EQUAL_MEMORY(data + 1, received, len);
+        free(data);
+        free(frame);
+        free(received);
+    }
+    esp_transport_destroy(ws);
+    esp_transport_destroy(parent);
+}
+
+TEST_CASE("tcp_transport: ws masking and framing performance", "[tcp_transport]")
+{
+    const int frame_size = 64 * 1024;
+    const int frames = 64;
+    esp_transport_handle_t parent = ws_parent_init();
+    esp_transport_handle_t ws = esp_transport_ws_init(parent);
+    char *data = calloc(1, frame_size);
+    TEST_ASSERT_NOT_NULL(ws);
+    TEST_ASSERT_NOT_NULL(data);
+
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < frames; i++) {
+        TEST_ASSERT_EQUAL(frame_size, esp_transport_write(ws, data, frame_size, 100));
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    TEST_ASSERT_EQUAL(frames * (frame_size + 14), s_ws_parent.sink_len);
+
+    free(data);
+    esp_transport_destroy(ws);
+    esp_transport_destroy(parent);
+    int throughput = (int)((int64_t)frames * frame_size / elapsed);
+    TEST_PERFORMANCE_GREATER_THAN(WS_MASKING_THROUGHPUT_MBSEC, "%d MB/s", throughput);
+}
+
+/* Fake connected transports of the pool tests, counting the close and destroy calls */
+typedef struct {
+    int readable;
+    int closed;
+    int destroyed;
+} pool_fake_state_t;
+
+static int pool_fake_poll_read(esp_transport_handle_t t, int timeout_ms)
+{
+    pool_fake_state_t *state = esp_transport_get_context_data(t);
+    return state->readable;
+}
+
+static int pool_fake_close(esp_transport_handle_t t)
+{
+    pool_fake_state_t *state = esp_transport_get_context_data(t);
+    state->closed++;
+    return 0;
+}
+
+static int pool_fake_destroy(esp_transport_handle_t t)
+{
+    pool_fake_state_t *state = esp_transport_get_context_data(t);
+    state->destroyed++;
+    return 0;
+}
+
+static esp_transport_handle_t pool_fake_init(pool_fake_state_t *state)
+{
+    memset(state, 0, sizeof(pool_fake_state_t));
+    esp_transport_handle_t t = esp_transport_init();
+    TEST_ASSERT_NOT_NULL(t);
+    esp_transport_set_func(t, NULL, NULL, NULL, pool_fake_close, pool_fake_poll_read, NULL, pool_fake_destroy);
+    esp_transport_set_context_data(t, state);
+    return t;
+}
+
+TEST_CASE("tcp_transport: pool reuses idle transports of the same endpoint", "[tcp_transport][leaks=0]")
+{
+    esp_transport_pool_config_t config = { .max_connections = 2, .idle_timeout_ms = 10000 };
+    esp_transport_pool_handle_t pool = esp_transport_pool_init(&config);
+    TEST_ASSERT_NOT_NULL(pool);
+    pool_fake_state_t a, b, c;
+
+    esp_transport_handle_t ta = pool_fake_init(&a);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_transport_pool_put(pool, ta, "https", "example.com", 443, 1));
+    TEST_ASSERT_NULL(esp_transport_pool_get(pool, "https", "example.com", 8443, 1));
+    TEST_ASSERT_NULL(esp_transport_pool_get(pool, "http", "example.com", 443, 1));
+    TEST_ASSERT_NULL(esp_transport_pool_get(pool, "https", "example.org", 443, 1));
+    TEST_ASSERT_NULL(esp_transport_pool_get(pool, "https", "example.com", 443, 2));
+    TEST_ASSERT_EQUAL_PTR(ta, esp_transport_pool_get(pool, "https", "Example.COM", 443, 1));
+    TEST_ASSERT_NULL(esp_transport_pool_get(pool, "https", "example.com", 443, 1));
+    TEST_ASSERT_EQUAL(0, a.closed);
+
+    // a transport which became readable while idle was closed by the peer
+    TEST_ASSERT_EQUAL(ESP_OK, esp_transport_pool_put(pool, ta, "https", "example.com", 443, 1));
+    a.readable = 1;
+    TEST_ASSERT_NULL(esp_transport_pool_get(pool, "https", "example.com", 443, 1));
+    TEST_ASSERT_EQUAL(1, a.closed);
+    TEST_ASSERT_EQUAL(1, a.destroyed);
+
+    // the least recently used transport is evicted when the pool is full
+    ta = pool_fake_init(&a);
+    esp_transport_handle_t tb = pool_fake_init(&b);
+    esp_transport_handle_t tc = pool_fake_init(&c);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_transport_pool_put(pool, ta, "http", "example.com", 80, 0));
+    vTaskDelay(2);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_transport_pool_put(pool, tb, "http", "example.com", 80, 0));
+    vTaskDelay(2);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_transport_pool_put(pool, tc, "http", "example.com", 80, 0));
+    TEST_ASSERT_EQUAL(1, a.destroyed);
+    TEST_ASSERT_EQUAL_PTR(tc, esp_transport_pool_get(pool, "http", "example.com", 80, 0));
+    TEST_ASSERT_EQUAL_PTR(tb, esp_transport_pool_get(pool, "http", "example.com", 80, 0));
+    TEST_ASSERT_NULL(esp_transport_pool_get(pool, "http", "example.com", 80, 0));
+
+    // remaining transports are closed on destroy
+    TEST_ASSERT_EQUAL(ESP_OK, esp_transport_pool_put(pool, tb, "http", "example.com", 80, 0));
+    esp_transport_destroy(tc);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_transport_pool_destroy(pool));
+    TEST_ASSERT_EQUAL(1, b.closed);
+    TEST_ASSERT_EQUAL(1, b.destroyed);
+}
+
+TEST_CASE("tcp_transport: pool drops transports idle for too long", "[tcp_transport][leaks=0]")
+{
+    esp_transport_pool_config_t config = { .max_connections = 4, .idle_timeout_ms = 100 };
+    esp_transport_pool_handle_t pool = esp_transport_pool_init(&config);
+    TEST_ASSERT_NOT_NULL(pool);
+    pool_fake_state_t a, b;
+    esp_transport_handle_t ta = pool_fake_init(&a);
+    esp_transport_handle_t tb = pool_fake_init(&b);
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_transport_pool_put(pool, ta, "http", "10.0.0.1", 80, 0));
+    vTaskDelay(pdMS_TO_TICKS(150));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_transport_pool_put(pool, tb, "http", "10.0.0.2", 80, 0));
+    // expired transports are also collected when another one is stored
+    TEST_ASSERT_EQUAL(1, a.destroyed);
+    TEST_ASSERT_EQUAL_PTR(tb, esp_transport_pool_get(pool, "http", "10.0.0.2", 80, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_transport_pool_put(pool, tb, "http", "10.0.0.2", 80, 0));
+    vTaskDelay(pdMS_TO_TICKS(150));
+    TEST_ASSERT_NULL(esp_transport_pool_get(pool, "http", "10.0.0.2", 80, 0));
+    TEST_ASSERT_EQUAL(1, b.closed);
+    TEST_ASSERT_EQUAL(1, b.destroyed);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_transport_pool_destroy(pool));
+}
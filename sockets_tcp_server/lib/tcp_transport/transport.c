@@ -93,6 +93,24 @@ esp_err_t esp_transport_list_add(esp_transport_list_handle_t h, esp_transport_ha
     return ESP_OK;
 }
 
+esp_err_t esp_transport_list_remove(esp_transport_list_handle_t h, esp_transport_handle_t t)
+{
+    if (h == NULL || t == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_transport_handle_t item;
+    STAILQ_FOREACH(item, &h->list, next) {
+        if (item == t) {
+            STAILQ_REMOVE(&h->list, t, esp_transport_item_t, next);
+            free(t->scheme);
+            t->scheme = NULL;
+            t->error_handle = NULL;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
 esp_transport_handle_t esp_transport_list_get_transport(esp_transport_list_handle_t h, const char *scheme)
 {
     if (!h) {
@@ -302,7 +320,7 @@ esp_tls_error_handle_t esp_transport_get_error_handle(esp_transport_handle_t t)
 
 void esp_transport_set_errors(esp_transport_handle_t t, const esp_tls_error_handle_t error_handle)
 {
-    if (t)  {
+    if (t && t->error_handle)  {
         memcpy(t->error_handle, error_handle, sizeof(esp_tls_last_error_t));
     }
 }
\ No newline at end of file
@@ -0,0 +1,204 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/lock.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include "esp_transport_pool.h"
+#include "esp_transport_utils.h"
+
+static const char *TAG = "TRANSPORT_POOL";
+
+typedef struct {
+    esp_transport_handle_t t;   /*!< Idle transport, NULL if the slot is free */
+    char *scheme;
+    char *host;
+    int port;
+    uint32_t config_id;
+    TickType_t last_used;       /*!< Tick count when the transport was put to the pool */
+} pool_entry_t;
+
+struct esp_transport_pool {
+    _lock_t lock;
+    TickType_t idle_timeout;
+    int max_connections;
+    pool_entry_t entries[];
+};
+
+static bool entry_expired(esp_transport_pool_handle_t pool, const pool_entry_t *entry, TickType_t now)
+{
+    return (now - entry->last_used) >= pool->idle_timeout;
+}
+
+/* Clears the slot and returns its transport, which is closed and destroyed by the caller outside of the lock */
+static esp_transport_handle_t entry_take(pool_entry_t *entry)
+{
+    esp_transport_handle_t t = entry->t;
+    free(entry->scheme);
+    free(entry->host);
+    memset(entry, 0, sizeof(pool_entry_t));
+    return t;
+}
+
+static void transport_discard(esp_transport_handle_t t)
+{
+    if (t) {
+        esp_transport_close(t);
+        esp_transport_destroy(t);
+    }
+}
+
+esp_transport_pool_handle_t esp_transport_pool_init(const esp_transport_pool_config_t *config)
+{
+    if (config == NULL || config->max_connections <= 0) {
+        return NULL;
+    }
+    esp_transport_pool_handle_t pool = calloc(1, sizeof(struct esp_transport_pool) + config->max_connections * sizeof(pool_entry_t));
+    ESP_TRANSPORT_MEM_CHECK(TAG, pool, return NULL);
+    _lock_init(&pool->lock);
+    pool->max_connections = config->max_connections;
+    pool->idle_timeout = pdMS_TO_TICKS(config->idle_timeout_ms);
+    return pool;
+}
+
+esp_err_t esp_transport_pool_put(esp_transport_pool_handle_t pool, esp_transport_handle_t t,
+                                 const char *scheme, const char *host, int port, uint32_t config_id)
+{
+    if (t == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (pool == NULL || scheme == NULL || host == NULL) {
+        transport_discard(t);
+        return ESP_ERR_INVALID_ARG;
+    }
+    char *scheme_copy = strdup(scheme);
+    char *host_copy = strdup(host);
+    if (scheme_copy == NULL || host_copy == NULL) {
+        ESP_LOGE(TAG, "Error allocating memory");
+        free(scheme_copy);
+        free(host_copy);
+        transport_discard(t);
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_transport_handle_t evicted[pool->max_connections];
+    int evicted_count = 0;
+    TickType_t now = xTaskGetTickCount();
+    pool_entry_t *slot = NULL;
+
+    _lock_acquire(&pool->lock);
+    for (int i = 0; i < pool->max_connections; i++) {
+        pool_entry_t *entry = &pool->entries[i];
+        if (entry->t && entry_expired(pool, entry, now)) {
+            evicted[evicted_count++] = entry_take(entry);
+        }
+        if (entry->t == NULL) {
+            if (slot == NULL || slot->t) {
+                slot = entry;
+            }
+        } else if (slot == NULL || (slot->t && (now - entry->last_used) > (now - slot->last_used))) {
+            slot = entry;
+        }
+    }
+    if (slot->t) {
+        ESP_LOGD(TAG, "Evicting connection to %s:%d", slot->host, slot->port);
+        evicted[evicted_count++] = entry_take(slot);
+    }
+    slot->t = t;
+    slot->scheme = scheme_copy;
+    slot->host = host_copy;
+    slot->port = port;
+    slot->config_id = config_id;
+    slot->last_used = now;
+    _lock_release(&pool->lock);
+
+    for (int i = 0; i < evicted_count; i++) {
+        transport_discard(evicted[i]);
+    }
+    return ESP_OK;
+}
+
+esp_transport_handle_t esp_transport_pool_get(esp_transport_pool_handle_t pool,
+                                              const char *scheme, const char *host, int port, uint32_t config_id)
+{
+    if (pool == NULL || scheme == NULL || host == NULL) {
+        return NULL;
+    }
+    while (true) {
+        TickType_t now = xTaskGetTickCount();
+        pool_entry_t *found = NULL;
+        _lock_acquire(&pool->lock);
+        for (int i = 0; i < pool->max_connections; i++) {
+            pool_entry_t *entry = &pool->entries[i];
+            if (entry->t && entry->port == port && entry->config_id == config_id &&
+                strcasecmp(entry->scheme, scheme) == 0 && strcasecmp(entry->host, host) == 0 &&
+                (found == NULL || (now - entry->last_used) < (now - found->last_used))) {
+                found = entry;
+            }
+        }
+        bool expired = found && entry_expired(pool, found, now);
+        esp_transport_handle_t t = found ? entry_take(found) : NULL;
+        _lock_release(&pool->lock);
+
+        if (t == NULL) {
+            return NULL;
+        }
+        // An idle connection has nothing to read: if it is readable, the peer has closed it
+        // (or sent something we would misinterpret), so it can not be used for a new request
+        if (!expired && esp_transport_poll_read(t, 0) == 0) {
+            ESP_LOGD(TAG, "Reusing connection to %s:%d", host, port);
+            return t;
+        }
+        ESP_LOGD(TAG, "Dropping %s connection to %s:%d", expired ? "expired" : "stale", host, port);
+        transport_discard(t);
+    }
+}
+
+void esp_transport_pool_flush(esp_transport_pool_handle_t pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+    while (true) {
+        esp_transport_handle_t t = NULL;
+        _lock_acquire(&pool->lock);
+        for (int i = 0; i < pool->max_connections && t == NULL; i++) {
+            if (pool->entries[i].t) {
+                t = entry_take(&pool->entries[i]);
+            }
+        }
+        _lock_release(&pool->lock);
+        if (t == NULL) {
+            return;
+        }
+        transport_discard(t);
+    }
+}
+
+esp_err_t esp_transport_pool_destroy(esp_transport_pool_handle_t pool)
+{
+    if (pool == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_transport_pool_flush(pool);
+    _lock_close(&pool->lock);
+    free(pool);
+    return ESP_OK;
+}
@@ -16,6 +16,7 @@
 #include <string.h>
 
 #include "lwip/sockets.h"
+#include "lwip/pbuf.h"
 #include "lwip/dns.h"
 #include "lwip/netdb.h"
 
@@ -25,6 +26,7 @@
 
 #include "esp_transport_utils.h"
 #include "esp_transport.h"
+#include "esp_transport_tcp.h"
 
 static const char *TAG = "TRANS_TCP";
 
@@ -169,6 +171,21 @@ static int tcp_read(esp_transport_handle_t t, char *buffer, int len, int timeout
     return read_len;
 }
 
+int esp_transport_tcp_read_pbuf(esp_transport_handle_t t, struct pbuf **p, int len, int timeout_ms)
+{
+    transport_tcp_t *tcp = esp_transport_get_context_data(t);
+    int poll = -1;
+    *p = NULL;
+    if ((poll = esp_transport_poll_read(t, timeout_ms)) <= 0) {
+        return poll;
+    }
+    int read_len = lwip_recv_pbuf(tcp->sock, p, len, 0);
+    if (read_len == 0) {
+        return -1;
+    }
+    return read_len;
+}
+
 static int tcp_poll_read(esp_transport_handle_t t, int timeout_ms)
 {
     transport_tcp_t *tcp = esp_transport_get_context_data(t);
@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
 #include <ctype.h>
 #include <sys/random.h>
 #include "esp_log.h"
@@ -13,7 +14,11 @@
 static const char *TAG = "TRANSPORT_WS";
 
 #define DEFAULT_WS_BUFFER (1024)
+/* The transport buffer holds the upgrade request/response while connecting and
+   the outgoing frames (header and masked payload) once connected */
+#define WS_BUFFER_SIZE    (4 * DEFAULT_WS_BUFFER)
 #define WS_FIN            0x80
+#define WS_RSV1           0x40
 #define WS_OPCODE_CONT    0x00
 #define WS_OPCODE_TEXT    0x01
 #define WS_OPCODE_BINARY  0x02
@@ -27,10 +32,16 @@ static const char *TAG = "TRANSPORT_WS";
 #define WS_SIZE64         127
 #define MAX_WEBSOCKET_HEADER_SIZE 16
 #define WS_RESPONSE_OK    101
+#define WS_DEFLATE_MIN_WINDOW_BITS 8
+#define WS_DEFLATE_MAX_WINDOW_BITS 15
+#define WS_MAX_EXTENSIONS_HEADER   128
 
 
 typedef struct {
     uint8_t opcode;
+    bool fin;                           /*!< Frame is the last fragment of its message */
+    bool rsv1;                          /*!< Frame starts a compressed message */
+    bool masked;                        /*!< Whether the payload is masked */
     char mask_key[4];                   /*!< Mask key for this payload */
     int payload_len;                    /*!< Total length of the payload */
     int bytes_remaining;                /*!< Bytes left to read of the payload  */
@@ -42,6 +53,9 @@ typedef struct {
     char *sub_protocol;
     char *user_agent;
     char *headers;
+    esp_transport_ws_deflate_config_t *deflate_offer;   /*!< permessage-deflate parameters to offer, NULL if disabled */
+    esp_transport_ws_deflate_config_t deflate_agreed;
+    bool deflate_in_use;
     ws_transport_frame_state_t frame_state;
     esp_transport_handle_t parent;
 } transport_ws_t;
@@ -98,9 +112,108 @@ static char *get_http_header(const char *buffer, const char *key)
     return NULL;
 }
 
+static int ws_parse_window_bits(const char *value, int max_bits)
+{
+    if (value == NULL) {
+        return -1;
+    }
+    char *end;
+    long bits = strtol(value, &end, 10);
+    if (end == value || *end || bits < WS_DEFLATE_MIN_WINDOW_BITS || bits > max_bits) {
+        return -1;
+    }
+    return bits;
+}
+
+/*
+ * Check the Sec-WebSocket-Extensions header of the upgrade response against our permessage-deflate offer,
+ * the response may only narrow the offered parameters. Has to run before get_http_header(), which
+ * terminates the response buffer at the header it finds.
+ */
+static esp_err_t ws_negotiate_deflate(transport_ws_t *ws, const char *response)
+{
+    const char *key = "Sec-WebSocket-Extensions:";
+    const char *found = strcasestr(response, key);
+    if (found == NULL) {
+        ESP_LOGD(TAG, "Server declined permessage-deflate");
+        return ESP_OK;
+    }
+    found += strlen(key);
+    const char *found_end = strstr(found, "\r\n");
+    if (found_end == NULL || found_end - found >= WS_MAX_EXTENSIONS_HEADER) {
+        ESP_LOGE(TAG, "Invalid Sec-WebSocket-Extensions header");
+        return ESP_FAIL;
+    }
+    char extensions[WS_MAX_EXTENSIONS_HEADER];
+    memcpy(extensions, found, found_end - found);
+    extensions[found_end - found] = 0;
+    ESP_LOGD(TAG, "Sec-WebSocket-Extensions: %s", extensions);
+
+    if (strchr(extensions, ',')) {
+        ESP_LOGE(TAG, "Only permessage-deflate was offered, got %s", extensions);
+        return ESP_FAIL;
+    }
+    esp_transport_ws_deflate_config_t agreed = {
+        .client_max_window_bits = ws->deflate_offer->client_max_window_bits,
+        .server_max_window_bits = WS_DEFLATE_MAX_WINDOW_BITS,
+    };
+    char *saveptr;
+    char *param = strtok_r(extensions, ";", &saveptr);
+    if (param == NULL || strcasecmp(trimwhitespace(param), "permessage-deflate") != 0) {
+        ESP_LOGE(TAG, "Unexpected extension %s", param ? param : "");
+        return ESP_FAIL;
+    }
+    while ((param = strtok_r(NULL, ";", &saveptr)) != NULL) {
+        char *value = strchr(param, '=');
+        if (value) {
+            *value++ = 0;
+            value = trimwhitespace(value);
+            // Values may be sent as quoted strings
+            if (value[0] == '"' && strlen(value) > 1 && value[strlen(value) - 1] == '"') {
+                value[strlen(value) - 1] = 0;
+                value++;
+            }
+        }
+        param = trimwhitespace(param);
+        if (strcasecmp(param, "server_no_context_takeover") == 0 && value == NULL) {
+            agreed.server_no_context_takeover = true;
+        } else if (strcasecmp(param, "client_no_context_takeover") == 0 && value == NULL) {
+            agreed.client_no_context_takeover = true;
+        } else if (strcasecmp(param, "server_max_window_bits") == 0) {
+            agreed.server_max_window_bits = ws_parse_window_bits(value, ws->deflate_offer->server_max_window_bits);
+            if (agreed.server_max_window_bits < 0) {
+                ESP_LOGE(TAG, "Invalid server_max_window_bits=%s", value ? value : "");
+                return ESP_FAIL;
+            }
+        } else if (strcasecmp(param, "client_max_window_bits") == 0) {
+            agreed.client_max_window_bits = ws_parse_window_bits(value, ws->deflate_offer->client_max_window_bits);
+            if (agreed.client_max_window_bits < 0) {
+                ESP_LOGE(TAG, "Invalid client_max_window_bits=%s", value ? value : "");
+                return ESP_FAIL;
+            }
+        } else {
+            ESP_LOGE(TAG, "Unexpected permessage-deflate parameter %s", param);
+            return ESP_FAIL;
+        }
+    }
+    if (ws->deflate_offer->server_no_context_takeover && !agreed.server_no_context_takeover) {
+        ESP_LOGE(TAG, "server_no_context_takeover was not accepted");
+        return ESP_FAIL;
+    }
+    // Our own compressor may always reset its context more often than agreed
+    agreed.client_no_context_takeover |= ws->deflate_offer->client_no_context_takeover;
+    ws->deflate_agreed = agreed;
+    ws->deflate_in_use = true;
+    ESP_LOGD(TAG, "permessage-deflate in use, client window %d bits%s, server window %d bits%s",
+             agreed.client_max_window_bits, agreed.client_no_context_takeover ? " (no context takeover)" : "",
+             agreed.server_max_window_bits, agreed.server_no_context_takeover ? " (no context takeover)" : "");
+    return ESP_OK;
+}
+
 static int ws_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms)
 {
     transport_ws_t *ws = esp_transport_get_context_data(t);
+    ws->deflate_in_use = false;
     if (esp_transport_connect(ws->parent, host, port, timeout_ms) < 0) {
         ESP_LOGE(TAG, "Error connecting to host %s:%d", host, port);
         return -1;
@@ -141,6 +254,24 @@ static int ws_connect(esp_transport_handle_t t, const char *host, int port, int
             return -1;
         }
     }
+    if (ws->deflate_offer) {
+        const esp_transport_ws_deflate_config_t *offer = ws->deflate_offer;
+        char server_bits[32] = "";
+        if (offer->server_max_window_bits < WS_DEFLATE_MAX_WINDOW_BITS) {
+            snprintf(server_bits, sizeof(server_bits), "; server_max_window_bits=%d", offer->server_max_window_bits);
+        }
+        int r = snprintf(ws->buffer + len, DEFAULT_WS_BUFFER - len,
+                         "Sec-WebSocket-Extensions: permessage-deflate; client_max_window_bits=%d%s%s%s\r\n",
+                         offer->client_max_window_bits, server_bits,
+                         offer->client_no_context_takeover ? "; client_no_context_takeover" : "",
+                         offer->server_no_context_takeover ? "; server_no_context_takeover" : "");
+        len += r;
+        if (r <= 0 || len >= DEFAULT_WS_BUFFER) {
+            ESP_LOGE(TAG, "Error in request generation"
+                          "(snprintf of extensions returned %d, desired request len: %d, buffer size: %d", r, len, DEFAULT_WS_BUFFER);
+            return -1;
+        }
+    }
     if (ws->headers) {
         ESP_LOGD(TAG, "headers: %s", ws->headers);
         int r = snprintf(ws->buffer + len, DEFAULT_WS_BUFFER - len, "%s", ws->headers);
@@ -174,6 +305,10 @@ static int ws_connect(esp_transport_handle_t t, const char *host, int port, int
         ESP_LOGD(TAG, "Read header chunk %d, current header size: %d", len, header_len);
     } while (NULL == strstr(ws->buffer, "\r\n\r\n") && header_len < DEFAULT_WS_BUFFER);
 
+    if (ws->deflate_offer && ws_negotiate_deflate(ws, ws->buffer) != ESP_OK) {
+        return -1;
+    }
+
     char *server_key = get_http_header(ws->buffer, "Sec-WebSocket-Accept:");
     if (server_key == NULL) {
         ESP_LOGE(TAG, "Sec-WebSocket-Accept not found");
@@ -202,13 +337,59 @@ static int ws_connect(esp_transport_handle_t t, const char *host, int port, int
     return 0;
 }
 
+typedef uint32_t __attribute__((__may_alias__)) ws_word_t;
+
+/*
+ * XOR `len` bytes of `src` with the mask key into `dst` (which may be `src`), `offset` being the position
+ * of `src` within the payload. If both buffers share the same alignment, which _ws_write() arranges,
+ * the bulk of the payload is processed a word at a time.
+ */
+static void ws_mask_payload(char *dst, const char *src, int len, const char mask_key[4], int offset)
+{
+    int i = 0;
+    if (((uintptr_t)dst & 3) == ((uintptr_t)src & 3)) {
+        for (; i < len && ((uintptr_t)(dst + i) & 3); i++) {
+            dst[i] = src[i] ^ mask_key[(offset + i) & 3];
+        }
+        ws_word_t mask_word;
+        char *mask_bytes = (char *)&mask_word;
+        for (int j = 0; j < 4; j++) {
+            mask_bytes[j] = mask_key[(offset + i + j) & 3];
+        }
+        for (; i + 16 <= len; i += 16) {
+            ((ws_word_t *)(dst + i))[0] = ((const ws_word_t *)(src + i))[0] ^ mask_word;
+            ((ws_word_t *)(dst + i))[1] = ((const ws_word_t *)(src + i))[1] ^ mask_word;
+            ((ws_word_t *)(dst + i))[2] = ((const ws_word_t *)(src + i))[2] ^ mask_word;
+            ((ws_word_t *)(dst + i))[3] = ((const ws_word_t *)(src + i))[3] ^ mask_word;
+        }
+        for (; i + 4 <= len; i += 4) {
+            *(ws_word_t *)(dst + i) = *(const ws_word_t *)(src + i) ^ mask_word;
+        }
+    }
+    for (; i < len; i++) {
+        dst[i] = src[i] ^ mask_key[(offset + i) & 3];
+    }
+}
+
+static int ws_write_all(transport_ws_t *ws, const char *buffer, int len, int timeout_ms)
+{
+    int written = 0;
+    while (written < len) {
+        int ret = esp_transport_write(ws->parent, buffer + written, len - written, timeout_ms);
+        if (ret <= 0) {
+            return ret;
+        }
+        written += ret;
+    }
+    return written;
+}
+
 static int _ws_write(esp_transport_handle_t t, int opcode, int mask_flag, const char *b, int len, int timeout_ms)
 {
     transport_ws_t *ws = esp_transport_get_context_data(t);
-    char *buffer = (char *)b;
     char ws_header[MAX_WEBSOCKET_HEADER_SIZE];
-    char *mask;
-    int header_len = 0, i;
+    char *mask = NULL;
+    int header_len = 0;
 
     int poll_write;
     if ((poll_write = esp_transport_poll_write(ws->parent, timeout_ms)) <= 0) {
@@ -240,30 +421,35 @@ static int _ws_write(esp_transport_handle_t t, int opcode, int mask_flag, const
         mask = &ws_header[header_len];
         getrandom(ws_header + header_len, 4, 0);
         header_len += 4;
-
-        for (i = 0; i < len; ++i) {
-            buffer[i] = (buffer[i] ^ mask[i % 4]);
-        }
     }
 
-    if (esp_transport_write(ws->parent, ws_header, header_len, timeout_ms) != header_len) {
-        ESP_LOGE(TAG, "Error write header");
-        return -1;
-    }
-    if (len == 0) {
-        return 0;
-    }
-
-    int ret = esp_transport_write(ws->parent, buffer, len, timeout_ms);
-    // in case of masked transport we have to revert back to the original data, as ws layer
-    // does not create its own copy of data to be sent
-    if (mask_flag) {
-        mask = &ws_header[header_len-4];
-        for (i = 0; i < len; ++i) {
-            buffer[i] = (buffer[i] ^ mask[i % 4]);
+    // The frame is assembled in the transport buffer, so that the caller's data are never modified
+    // and the header goes out in the same write as the (first part of the) payload. The payload is
+    // placed at the same alignment as the caller's data to be masked word-wise.
+    int frame_len = header_len;
+    char *frame = ws->buffer + (((uintptr_t)b - header_len) & 3);
+    memcpy(frame, ws_header, header_len);
+    int payload_sent = 0;
+    do {
+        int chunk = WS_BUFFER_SIZE - (frame - ws->buffer) - frame_len;
+        if (chunk > len - payload_sent) {
+            chunk = len - payload_sent;
         }
-    }
-    return ret;
+        if (mask) {
+            ws_mask_payload(frame + frame_len, b + payload_sent, chunk, mask, payload_sent);
+        } else if (chunk > 0) {
+            memcpy(frame + frame_len, b + payload_sent, chunk);
+        }
+        frame_len += chunk;
+        if (ws_write_all(ws, frame, frame_len, timeout_ms) != frame_len) {
+            ESP_LOGE(TAG, "Error write frame");
+            return -1;
+        }
+        payload_sent += chunk;
+        frame = ws->buffer + ((uintptr_t)(b + payload_sent) & 3);
+        frame_len = 0;
+    } while (payload_sent < len);
+    return len;
 }
 
 int esp_transport_ws_send_raw(esp_transport_handle_t t, ws_transport_opcodes_t opcode, const char *b, int len, int timeout_ms)
@@ -310,13 +496,10 @@ static int ws_read_payload(esp_transport_handle_t t, char *buffer, int len, int
         ESP_LOGE(TAG, "Error read data");
         return rlen;
     }
-    ws->frame_state.bytes_remaining -= rlen;
-
-    if (ws->frame_state.mask_key) {
-        for (int i = 0; i < bytes_to_read; i++) {
-            buffer[i] = (buffer[i] ^ ws->frame_state.mask_key[i % 4]);
-        }
+    if (ws->frame_state.masked) {
+        ws_mask_payload(buffer, buffer, rlen, ws->frame_state.mask_key, ws->frame_state.payload_len - ws->frame_state.bytes_remaining);
     }
+    ws->frame_state.bytes_remaining -= rlen;
     return rlen;
 }
 
@@ -343,6 +526,8 @@ static int ws_read_header(esp_transport_handle_t t, char *buffer, int len, int t
         return rlen;
     }
     ws->frame_state.opcode = (*data_ptr & 0x0F);
+    ws->frame_state.fin = (*data_ptr & WS_FIN) != 0;
+    ws->frame_state.rsv1 = (*data_ptr & WS_RSV1) != 0;
     data_ptr ++;
     mask = ((*data_ptr >> 7) & 0x01);
     payload_len = (*data_ptr & 0x7F);
@@ -354,7 +539,7 @@ static int ws_read_header(esp_transport_handle_t t, char *buffer, int len, int t
             ESP_LOGE(TAG, "Error read data");
             return rlen;
         }
-        payload_len = data_ptr[0] << 8 | data_ptr[1];
+        payload_len = (uint8_t)data_ptr[0] << 8 | (uint8_t)data_ptr[1];
     } else if (payload_len == 127) {
         // headerLen += 8;
         header = 8;
@@ -367,7 +552,7 @@ static int ws_read_header(esp_transport_handle_t t, char *buffer, int len, int t
             // really too big!
             payload_len = 0xFFFFFFFF;
         } else {
-            payload_len = data_ptr[4] << 24 | data_ptr[5] << 16 | data_ptr[6] << 8 | data_ptr[7];
+            payload_len = (uint8_t)data_ptr[4] << 24 | (uint8_t)data_ptr[5] << 16 | (uint8_t)data_ptr[6] << 8 | (uint8_t)data_ptr[7];
         }
     }
 
@@ -378,7 +563,9 @@ static int ws_read_header(esp_transport_handle_t t, char *buffer, int len, int t
             return rlen;
         }
         memcpy(ws->frame_state.mask_key, buffer, mask_len);
+        ws->frame_state.masked = true;
     } else {
+        ws->frame_state.masked = false;
         memset(ws->frame_state.mask_key, 0, mask_len);
     }
 
@@ -439,6 +626,7 @@ static esp_err_t ws_destroy(esp_transport_handle_t t)
     free(ws->sub_protocol);
     free(ws->user_agent);
     free(ws->headers);
+    free(ws->deflate_offer);
     free(ws);
     return 0;
 }
@@ -461,7 +649,7 @@ esp_transport_handle_t esp_transport_ws_init(esp_transport_handle_t parent_handl
         free(ws);
         return NULL;
     });
-    ws->buffer = malloc(DEFAULT_WS_BUFFER);
+    ws->buffer = malloc(WS_BUFFER_SIZE);
     ESP_TRANSPORT_MEM_CHECK(TAG, ws->buffer, {
         free(ws->path);
         free(ws);
@@ -548,4 +736,50 @@ int esp_transport_ws_get_read_payload_len(esp_transport_handle_t t)
     return ws->frame_state.payload_len;
 }
 
+bool esp_transport_ws_get_fin_flag(esp_transport_handle_t t)
+{
+    transport_ws_t *ws = esp_transport_get_context_data(t);
+    return ws->frame_state.fin;
+}
 
+bool esp_transport_ws_get_rsv1_flag(esp_transport_handle_t t)
+{
+    transport_ws_t *ws = esp_transport_get_context_data(t);
+    return ws->frame_state.rsv1;
+}
+
+esp_err_t esp_transport_ws_set_permessage_deflate(esp_transport_handle_t t, const esp_transport_ws_deflate_config_t *config)
+{
+    if (t == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    transport_ws_t *ws = esp_transport_get_context_data(t);
+    if (config == NULL) {
+        free(ws->deflate_offer);
+        ws->deflate_offer = NULL;
+        return ESP_OK;
+    }
+    if (config->client_max_window_bits < WS_DEFLATE_MIN_WINDOW_BITS || config->client_max_window_bits > WS_DEFLATE_MAX_WINDOW_BITS ||
+        config->server_max_window_bits < WS_DEFLATE_MIN_WINDOW_BITS || config->server_max_window_bits > WS_DEFLATE_MAX_WINDOW_BITS) {
+        ESP_LOGE(TAG, "Invalid permessage-deflate window bits");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (ws->deflate_offer == NULL) {
+        ws->deflate_offer = malloc(sizeof(esp_transport_ws_deflate_config_t));
+        if (ws->deflate_offer == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    *ws->deflate_offer = *config;
+    return ESP_OK;
+}
+
+esp_err_t esp_transport_ws_get_permessage_deflate(esp_transport_handle_t t, esp_transport_ws_deflate_config_t *agreed)
+{
+    transport_ws_t *ws = esp_transport_get_context_data(t);
+    if (!ws->deflate_in_use) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *agreed = ws->deflate_agreed;
+    return ESP_OK;
+}